@@ -39,6 +39,8 @@
  *   OSMesaGetCurrentContext - return thread's current context ID
  *   OSMesaPixelStore - controls how pixels are stored in image buffer
  *   OSMesaGetIntegerv - return OSMesa state parameters
+ *   OSMesaMakeCurrentRing - like OSMesaMakeCurrent but with several buffers
+ *   OSMesaSwapBuffersAsync - hand over a frame without waiting for it
  *
  *
  * The limits on the width and height of an image buffer can be retrieved
@@ -110,6 +112,8 @@ extern "C" {
 
 typedef struct osmesa_context *OSMesaContext;
 
+typedef struct osmesa_fence *OSMesaFence;
+
 
 /*
  * Create an Off-Screen Mesa rendering context.  The only attribute needed is
@@ -324,6 +328,60 @@ OSMesaPostprocess(OSMesaContext osmesa, const char *filter,
                   unsigned enable_value);
 
 
+/*
+ * Like OSMesaMakeCurrent() but with a ring of count image buffers of the
+ * same size and type.  Rendering goes to buffers[0] until the first call
+ * to OSMesaSwapBuffersAsync(), then to buffers[1], etc, wrapping around.
+ * This lets the app consume one image while the next ones are rendered.
+ * Calling OSMesaMakeCurrent() or OSMesaMakeCurrentRing() again ends the
+ * ring.
+ * Return:  GL_TRUE if success, GL_FALSE if error.
+ * New in Mesa 12.1, only available with gallium drivers.
+ */
+GLAPI GLboolean GLAPIENTRY
+OSMesaMakeCurrentRing(OSMesaContext osmesa, void *const *buffers,
+                      GLsizei count, GLenum type,
+                      GLsizei width, GLsizei height);
+
+
+/*
+ * End the current frame of a ring set up with OSMesaMakeCurrentRing()
+ * and move on to the next buffer, without waiting for the frame to be
+ * rendered.  Returns a fence for the frame, and the buffer the image will
+ * be stored in in *buffer (if not NULL).  The image stays valid until the
+ * buffer is made current again by a later call, i.e. for count - 1 frames.
+ * If the previous frame of the next buffer hasn't completed yet, this
+ * waits for it.
+ * Return:  the fence, to be destroyed with OSMesaDestroyFence(), or NULL
+ *          if the current buffer isn't a ring.
+ * New in Mesa 12.1, only available with gallium drivers.
+ */
+GLAPI OSMesaFence GLAPIENTRY
+OSMesaSwapBuffersAsync(OSMesaContext osmesa, void **buffer);
+
+
+#define OSMESA_TIMEOUT_INFINITE 0xffffffffffffffffull
+
+/*
+ * Wait up to timeout nanoseconds (0 to just poll) for the frame of the
+ * fence to be stored in its buffer.  Must be called from the thread where
+ * the context the fence came from is current.
+ * Return:  GL_TRUE if the image is in the buffer, GL_FALSE on timeout.
+ * New in Mesa 12.1, only available with gallium drivers.
+ */
+GLAPI GLboolean GLAPIENTRY
+OSMesaClientWaitFence(OSMesaFence fence, GLuint64 timeout);
+
+
+/*
+ * Destroy a fence returned by OSMesaSwapBuffersAsync().  All fences must
+ * be destroyed before the context they came from.
+ * New in Mesa 12.1, only available with gallium drivers.
+ */
+GLAPI void GLAPIENTRY
+OSMesaDestroyFence(OSMesaFence fence);
+
+
 #ifdef __cplusplus
 }
 #endif
@@ -73,7 +73,11 @@ align_blob(struct blob *blob, size_t alignment)
    if (! grow_to_fit (blob, new_size - blob->size))
       return false;
 
-   blob->size = new_size;
+   /* Zero the padding so that equal data always makes equal blobs. */
+   if (new_size > blob->size) {
+      memset(blob->data + blob->size, 0, new_size - blob->size);
+      blob->size = new_size;
+   }
 
    return true;
 }
@@ -5656,10 +5656,22 @@ _mesa_glsl_find_builtin_function_by_name(const char *name)
    return f;
 }
 
+/**
+ * Get the shader holding the built-in functions.
+ *
+ * Shaders are compiled and linked on several threads at once, so this must
+ * go through the lock as well.  The shader stays valid until the built-ins
+ * are released, which only happens once no compile or link is running.
+ */
 gl_shader *
 _mesa_glsl_get_builtin_function_shader()
 {
-   return builtins.shader;
+   gl_shader *sh;
+
+   mtx_lock(&builtins_lock);
+   sh = builtins.shader;
+   mtx_unlock(&builtins_lock);
+   return sh;
 }
 
 
@@ -29,6 +29,7 @@
 #include "main/context.h"
 #include "main/debug_output.h"
 #include "main/shaderobj.h"
+#include "util/compile_profile.h"
 #include "util/u_atomic.h" /* for p_atomic_cmpxchg */
 #include "util/ralloc.h"
 #include "ast.h"
@@ -67,6 +68,8 @@ _mesa_glsl_parse_state::_mesa_glsl_parse_state(struct gl_context *_ctx,
    this->translation_unit.make_empty();
    this->symbols = new(mem_ctx) glsl_symbol_table;
 
+   this->linalloc = linear_alloc_parent(this, 0);
+
    this->info_log = ralloc_strdup(mem_ctx, "");
    this->error = false;
    this->loop_nesting_ast = NULL;
@@ -1592,7 +1595,8 @@ ast_struct_specifier::print(void) const
 }
 
 
-ast_struct_specifier::ast_struct_specifier(const char *identifier,
+ast_struct_specifier::ast_struct_specifier(void *lin_ctx,
+					   const char *identifier,
 					   ast_declarator_list *declarator_list)
 {
    if (identifier == NULL) {
@@ -1604,7 +1608,7 @@ ast_struct_specifier::ast_struct_specifier(const char *identifier,
       count = anon_count++;
       mtx_unlock(&mutex);
 
-      identifier = ralloc_asprintf(this, "#anon_struct_%04x", count);
+      identifier = linear_asprintf(lin_ctx, "#anon_struct_%04x", count);
    }
    name = identifier;
    this->declarations.push_degenerate_list_at_head(&declarator_list->link);
@@ -1835,6 +1839,10 @@ void
 _mesa_glsl_compile_shader(struct gl_context *ctx, struct gl_shader *shader,
                           bool dump_ast, bool dump_hir)
 {
+   compile_profile_shader_scope profile_shader("%s shader %u",
+      _mesa_shader_stage_to_string(shader->Stage), shader->Name);
+   struct compile_profile_timer timer;
+
    struct _mesa_glsl_parse_state *state =
       new(shader) _mesa_glsl_parse_state(ctx, shader->Stage, shader);
    const char *source = shader->Source;
@@ -1843,13 +1851,17 @@ _mesa_glsl_compile_shader(struct gl_context *ctx, struct gl_shader *shader,
       (void) p_atomic_cmpxchg(&ir_variable::temporaries_allocate_names,
                               false, true);
 
+   compile_profile_begin(&timer, "glsl", "glcpp_preprocess");
    state->error = glcpp_preprocess(state, &source, &state->info_log,
                              add_builtin_defines, state, ctx);
+   compile_profile_end(&timer, false);
 
    if (!state->error) {
+     compile_profile_begin(&timer, "glsl", "_mesa_glsl_parse");
      _mesa_glsl_lexer_ctor(state, source);
      _mesa_glsl_parse(state);
      _mesa_glsl_lexer_dtor(state);
+     compile_profile_end(&timer, false);
    }
 
    if (dump_ast) {
@@ -1861,8 +1873,11 @@ _mesa_glsl_compile_shader(struct gl_context *ctx, struct gl_shader *shader,
 
    ralloc_free(shader->ir);
    shader->ir = new(shader) exec_list;
-   if (!state->error && !state->translation_unit.is_empty())
+   if (!state->error && !state->translation_unit.is_empty()) {
+      compile_profile_begin(&timer, "glsl", "_mesa_ast_to_hir");
       _mesa_ast_to_hir(shader->ir, state);
+      compile_profile_end(&timer, false);
+   }
 
    if (!state->error) {
       validate_ir_tree(shader->ir);
@@ -1997,7 +2012,11 @@ do_common_optimization(exec_list *ir, bool linked,
          fprintf(stderr, "GLSL optimization %s: %s progress\n",         \
                  #PASS, opt_progress ? "made" : "no");                  \
       } else {                                                          \
-         progress = PASS(__VA_ARGS__) || progress;                      \
+         struct compile_profile_timer timer;                            \
+         compile_profile_begin(&timer, "glsl", #PASS);                  \
+         const bool opt_progress = PASS(__VA_ARGS__);                   \
+         compile_profile_end(&timer, opt_progress);                     \
+         progress = opt_progress || progress;                           \
       }                                                                 \
    } while (false)
 
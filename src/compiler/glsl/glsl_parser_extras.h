@@ -316,6 +316,12 @@ struct _mesa_glsl_parse_state {
    exec_list translation_unit;
    glsl_symbol_table *symbols;
 
+   /**
+    * Linear allocator for the AST and the identifier strings of the lexer,
+    * all of which are freed along with the parse state.
+    */
+   void *linalloc;
+
    unsigned num_supported_versions;
    struct {
       unsigned ver;
@@ -0,0 +1,922 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/** @file offline_compiler.cpp
+ *
+ * Offline compiler and benchmark for a corpus of GLSL shaders.  See
+ * offline_compiler.h.
+ */
+
+#include <dirent.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "c11/threads.h"
+#include "main/mtypes.h"
+#include "compiler/glsl_types.h"
+#include "compiler/nir/nir.h"
+#include "util/compile_profile.h"
+#include "util/u_atomic.h"
+#include "util/u_timer.h"
+#include "glsl_to_nir.h"
+#include "ir.h"
+#include "ir_optimization.h"
+#include "offline_compiler.h"
+#include "standalone.h"
+
+/** Most shaders that a .shader_test may have. */
+#define MAX_SOURCES 16
+
+namespace {
+
+struct stage_result {
+   bool compiled;
+   bool failed;
+   const char *error;
+   struct offline_stats stats;
+   int64_t time;
+};
+
+struct program_job {
+   void *mem_ctx;
+   const char *path;
+   int glsl_version;
+   unsigned num_sources;
+   struct standalone_shader_source sources[MAX_SOURCES];
+
+   /** Why the program was skipped, or NULL. */
+   const char *skipped;
+
+   /* Filled in by the first compile of the program. */
+   const char *error;
+   struct stage_result stages[MESA_SHADER_STAGES];
+};
+
+/** CPU time spent in each phase, in nanoseconds. */
+struct phase_times {
+   int64_t front_end;
+   int64_t to_nir;
+   int64_t backend[MESA_SHADER_STAGES];
+};
+
+struct corpus {
+   const struct offline_backend *backend;
+   void *compiler;
+   struct gl_shader_compiler_options options[MESA_SHADER_STAGES];
+
+   struct program_job *jobs;
+   unsigned num_jobs;
+   unsigned iterations;
+
+   /** Next job to compile, counting all the iterations. */
+   unsigned next;
+};
+
+struct worker {
+   struct corpus *corpus;
+   thrd_t thread;
+   struct phase_times times;
+};
+
+struct file_list {
+   void *mem_ctx;
+   char **paths;
+   unsigned count;
+};
+
+} /* namespace */
+
+static const struct {
+   const char *section;
+   gl_shader_stage stage;
+} shader_sections[] = {
+   { "[vertex shader]", MESA_SHADER_VERTEX },
+   { "[tessellation control shader]", MESA_SHADER_TESS_CTRL },
+   { "[tessellation evaluation shader]", MESA_SHADER_TESS_EVAL },
+   { "[geometry shader]", MESA_SHADER_GEOMETRY },
+   { "[fragment shader]", MESA_SHADER_FRAGMENT },
+   { "[compute shader]", MESA_SHADER_COMPUTE },
+};
+
+static const struct {
+   const char *extension;
+   gl_shader_stage stage;
+} shader_extensions[] = {
+   { ".vert", MESA_SHADER_VERTEX },
+   { ".tesc", MESA_SHADER_TESS_CTRL },
+   { ".tese", MESA_SHADER_TESS_EVAL },
+   { ".geom", MESA_SHADER_GEOMETRY },
+   { ".frag", MESA_SHADER_FRAGMENT },
+   { ".comp", MESA_SHADER_COMPUTE },
+};
+
+static bool
+has_suffix(const char *str, const char *suffix)
+{
+   size_t len = strlen(str), suffix_len = strlen(suffix);
+
+   return len >= suffix_len && strcmp(str + len - suffix_len, suffix) == 0;
+}
+
+static bool
+is_glsl_file(const char *path, gl_shader_stage *stage)
+{
+   for (unsigned i = 0; i < ARRAY_SIZE(shader_extensions); i++) {
+      if (has_suffix(path, shader_extensions[i].extension)) {
+         *stage = shader_extensions[i].stage;
+         return true;
+      }
+   }
+
+   return false;
+}
+
+static void
+add_file(struct file_list *files, const char *path)
+{
+   files->paths = reralloc(files->mem_ctx, files->paths, char *,
+                           files->count + 1);
+   files->paths[files->count++] = ralloc_strdup(files->mem_ctx, path);
+}
+
+/**
+ * Adds a file given on the command line, or all the .shader_test files
+ * under a directory.
+ */
+static bool
+add_path(struct file_list *files, const char *path, bool from_dir)
+{
+   struct stat st;
+   gl_shader_stage stage;
+
+   if (stat(path, &st) != 0) {
+      fprintf(stderr, "Couldn't stat %s\n", path);
+      return false;
+   }
+
+   if (!S_ISDIR(st.st_mode)) {
+      if (has_suffix(path, ".shader_test"))
+         add_file(files, path);
+      else if (from_dir)
+         return true;
+      else if (is_glsl_file(path, &stage))
+         add_file(files, path);
+      else {
+         fprintf(stderr, "%s is neither a .shader_test nor a GLSL file\n",
+                 path);
+         return false;
+      }
+      return true;
+   }
+
+   DIR *dir = opendir(path);
+   if (!dir) {
+      fprintf(stderr, "Couldn't open %s\n", path);
+      return false;
+   }
+
+   bool ok = true;
+   struct dirent *entry;
+   while (ok && (entry = readdir(dir)) != NULL) {
+      if (entry->d_name[0] == '.')
+         continue;
+
+      char *child = ralloc_asprintf(NULL, "%s/%s", path, entry->d_name);
+      ok = add_path(files, child, true);
+      ralloc_free(child);
+   }
+
+   closedir(dir);
+   return ok;
+}
+
+static int
+compare_paths(const void *a, const void *b)
+{
+   return strcmp(*(char *const *) a, *(char *const *) b);
+}
+
+static char *
+read_file(void *mem_ctx, const char *path)
+{
+   FILE *f = fopen(path, "rb");
+   if (!f)
+      return NULL;
+
+   fseek(f, 0, SEEK_END);
+   long size = ftell(f);
+   fseek(f, 0, SEEK_SET);
+
+   char *text = (char *) ralloc_size(mem_ctx, size + 1);
+   if (fread(text, 1, size, f) != (size_t) size) {
+      ralloc_free(text);
+      text = NULL;
+   } else {
+      text[size] = '\0';
+   }
+
+   fclose(f);
+   return text;
+}
+
+static void
+add_source(struct program_job *job, gl_shader_stage stage, const char *source)
+{
+   if (job->num_sources == MAX_SOURCES) {
+      job->skipped = "too many shaders";
+      return;
+   }
+
+   job->sources[job->num_sources].stage = stage;
+   job->sources[job->num_sources].source = source;
+   job->num_sources++;
+}
+
+/**
+ * Splits a .shader_test into its shaders, in place, and reads the GLSL
+ * version out of its [require] section.
+ */
+static void
+parse_shader_test(struct program_job *job, char *text)
+{
+   enum { OTHER, REQUIRE, SHADER } section = OTHER;
+   unsigned major, minor;
+
+   job->glsl_version = 110;
+
+   char *next;
+   for (char *line = text; *line; line = next) {
+      next = strchr(line, '\n');
+      next = next ? next + 1 : line + strlen(line);
+
+      if (line[0] != '[') {
+         if (section != REQUIRE)
+            continue;
+
+         if (sscanf(line, "GLSL ES >= %u.%u", &major, &minor) == 2)
+            job->glsl_version = major * 100 + minor;
+         else if (sscanf(line, "GLSL >= %u.%u", &major, &minor) == 2)
+            job->glsl_version = major * 100 + minor;
+         continue;
+      }
+
+      if (strncmp(line, "[vertex program]", 16) == 0 ||
+          strncmp(line, "[fragment program]", 18) == 0)
+         job->skipped = "ARB programs aren't supported";
+
+      section = strncmp(line, "[require]", 9) == 0 ? REQUIRE : OTHER;
+
+      for (unsigned i = 0; i < ARRAY_SIZE(shader_sections); i++) {
+         const char *name = shader_sections[i].section;
+
+         if (strncmp(line, name, strlen(name)) == 0) {
+            add_source(job, shader_sections[i].stage, next);
+            section = SHADER;
+            break;
+         }
+      }
+
+      /* This ends the text of the previous shader, if any. */
+      line[0] = '\0';
+   }
+
+   if (job->num_sources == 0 && !job->skipped)
+      job->skipped = "no GLSL shaders";
+}
+
+static bool
+load_job(struct program_job *job, const char *path, int glsl_version)
+{
+   job->mem_ctx = ralloc_context(NULL);
+   job->path = path;
+
+   char *text = read_file(job->mem_ctx, path);
+   if (!text) {
+      fprintf(stderr, "Couldn't read %s\n", path);
+      return false;
+   }
+
+   gl_shader_stage stage;
+   if (is_glsl_file(path, &stage)) {
+      job->glsl_version = glsl_version;
+      add_source(job, stage, text);
+   } else {
+      parse_shader_test(job, text);
+   }
+
+   return true;
+}
+
+void
+offline_lower_glsl_ir(const struct gl_shader_compiler_options *options,
+                      struct gl_linked_shader *shader)
+{
+   exec_list *ir = shader->ir;
+
+   do_mat_op_to_vec(ir);
+   lower_instructions(ir, DIV_TO_MUL_RCP |
+                          SUB_TO_ADD_NEG |
+                          EXP_TO_EXP2 |
+                          LOG_TO_LOG2 |
+                          DFREXP_DLDEXP_TO_ARITH);
+
+   do_lower_texture_projection(ir);
+   do_vec_index_to_cond_assign(ir);
+   lower_vector_insert(ir, true);
+   lower_offset_arrays(ir);
+   lower_noise(ir);
+   lower_quadop_vector(ir, false);
+
+   do_copy_propagation(ir);
+
+   lower_variable_index_to_cond_assign(shader->Stage, ir,
+                                       options->EmitNoIndirectInput,
+                                       options->EmitNoIndirectOutput,
+                                       options->EmitNoIndirectTemp,
+                                       options->EmitNoIndirectUniform);
+
+   bool progress;
+   do {
+      progress = do_lower_jumps(ir, true, true, options->EmitNoMainReturn,
+                                options->EmitNoCont, options->EmitNoLoops);
+      progress = do_common_optimization(ir, true, true, options, true) ||
+                 progress;
+   } while (progress);
+
+   validate_ir_tree(ir);
+}
+
+/**
+ * Fills in the parts of the stage's gl_program that glsl_to_nir reads, as
+ * the driver's link step and _mesa_copy_linked_program_data would.
+ */
+static void
+set_program_info(const struct gl_shader_program *prog,
+                 struct gl_linked_shader *shader)
+{
+   struct gl_program *glprog = shader->Program;
+
+   do_set_program_inouts(shader->ir, glprog, shader->Stage);
+   glprog->SamplersUsed = shader->active_samplers;
+   glprog->ShadowSamplers = shader->shadow_samplers;
+
+   switch (shader->Stage) {
+   case MESA_SHADER_VERTEX:
+      glprog->ClipDistanceArraySize = prog->Vert.ClipDistanceArraySize;
+      glprog->CullDistanceArraySize = prog->Vert.CullDistanceArraySize;
+      break;
+   case MESA_SHADER_TESS_EVAL:
+      glprog->ClipDistanceArraySize = prog->TessEval.ClipDistanceArraySize;
+      glprog->CullDistanceArraySize = prog->TessEval.CullDistanceArraySize;
+      break;
+   case MESA_SHADER_GEOMETRY:
+      glprog->ClipDistanceArraySize = prog->Geom.ClipDistanceArraySize;
+      glprog->CullDistanceArraySize = prog->Geom.CullDistanceArraySize;
+      break;
+   case MESA_SHADER_FRAGMENT:
+      ((struct gl_fragment_program *) glprog)->FragDepthLayout =
+         prog->FragDepthLayout;
+      break;
+   case MESA_SHADER_COMPUTE: {
+      struct gl_compute_program *cp = (struct gl_compute_program *) glprog;
+      for (unsigned i = 0; i < 3; i++)
+         cp->LocalSize[i] = prog->Comp.LocalSize[i];
+      cp->SharedSize = prog->Comp.SharedSize;
+      break;
+   }
+   default:
+      break;
+   }
+}
+
+static nir_shader *
+lower_to_nir(const struct corpus *corpus, struct gl_shader_program *prog,
+             struct gl_linked_shader *shader)
+{
+   const struct gl_shader_compiler_options *options =
+      &corpus->options[shader->Stage];
+
+   {
+      compile_profile_scope profile("glsl", "offline_lower_glsl_ir");
+      if (corpus->backend->lower_glsl)
+         corpus->backend->lower_glsl(corpus->compiler, options, prog, shader);
+      else
+         offline_lower_glsl_ir(options, shader);
+   }
+
+   set_program_info(prog, shader);
+
+   compile_profile_scope profile("nir", "glsl_to_nir");
+   return glsl_to_nir(prog, shader->Stage, options->NirOptions);
+}
+
+static void *
+nir_backend_create(const char *arg)
+{
+   nir_shader_compiler_options *options =
+      rzalloc(NULL, nir_shader_compiler_options);
+
+   options->native_integers = true;
+   return options;
+}
+
+static void
+nir_backend_destroy(void *compiler)
+{
+   ralloc_free(compiler);
+}
+
+static void
+nir_backend_get_options(void *compiler,
+                        struct gl_shader_compiler_options *options)
+{
+   for (unsigned i = 0; i < MESA_SHADER_STAGES; i++)
+      options[i].NirOptions = (const nir_shader_compiler_options *) compiler;
+}
+
+static void
+count_nir_instrs(nir_shader *nir, struct offline_stats *stats)
+{
+   nir_foreach_function(function, nir) {
+      if (!function->impl)
+         continue;
+
+      nir_foreach_block(block, function->impl) {
+         if (block->cf_node.parent->type == nir_cf_node_loop &&
+             nir_cf_node_is_first(&block->cf_node))
+            stats->loops++;
+
+         nir_foreach_instr(instr, block) {
+            if (instr->type != nir_instr_type_phi &&
+                instr->type != nir_instr_type_ssa_undef)
+               stats->instructions++;
+         }
+      }
+   }
+}
+
+static bool
+nir_backend_compile(void *compiler, void *mem_ctx,
+                    struct gl_shader_program *prog, nir_shader *nir,
+                    struct offline_stats *stats, char **error)
+{
+   bool progress;
+
+   NIR_PASS_V(nir, nir_lower_io_to_temporaries,
+              nir_shader_get_entrypoint(nir), true, false);
+   NIR_PASS_V(nir, nir_lower_global_vars_to_local);
+   NIR_PASS_V(nir, nir_split_var_copies);
+   NIR_PASS_V(nir, nir_lower_var_copies);
+   NIR_PASS_V(nir, nir_lower_system_values);
+
+   do {
+      progress = false;
+
+      NIR_PASS_V(nir, nir_lower_vars_to_ssa);
+      NIR_PASS(progress, nir, nir_copy_prop);
+      NIR_PASS(progress, nir, nir_opt_remove_phis);
+      NIR_PASS(progress, nir, nir_opt_dce);
+      NIR_PASS(progress, nir, nir_opt_dead_cf);
+      NIR_PASS(progress, nir, nir_opt_cse);
+      NIR_PASS(progress, nir, nir_opt_peephole_select);
+      NIR_PASS(progress, nir, nir_opt_algebraic);
+      NIR_PASS(progress, nir, nir_opt_constant_folding);
+      NIR_PASS(progress, nir, nir_opt_undef);
+   } while (progress);
+
+   NIR_PASS_V(nir, nir_opt_algebraic_late);
+   NIR_PASS_V(nir, nir_copy_prop);
+   NIR_PASS_V(nir, nir_opt_dce);
+   NIR_PASS_V(nir, nir_remove_dead_variables, nir_var_local);
+
+   count_nir_instrs(nir, stats);
+   return true;
+}
+
+const struct offline_backend offline_nir_backend = {
+   "nir",
+   (1 << MESA_SHADER_STAGES) - 1,
+   nir_backend_create,
+   nir_backend_destroy,
+   nir_backend_get_options,
+   NULL,
+   nir_backend_compile,
+};
+
+static const char *
+program_error(const struct gl_shader_program *prog)
+{
+   for (unsigned i = 0; i < prog->NumShaders; i++) {
+      if (!prog->Shaders[i]->CompileStatus)
+         return prog->Shaders[i]->InfoLog;
+   }
+
+   return prog->LinkStatus ? NULL : prog->InfoLog;
+}
+
+/**
+ * Compiles one program.  Only the first compile of each program, \p record,
+ * stores its results, so that the job is only written by one thread.
+ */
+static void
+compile_program(const struct corpus *corpus, struct program_job *job,
+                struct phase_times *times, bool record)
+{
+   const struct offline_backend *backend = corpus->backend;
+   struct standalone_options options;
+
+   compile_profile_shader_scope profile_shader("%s", job->path);
+
+   memset(&options, 0, sizeof(options));
+   options.glsl_version = job->glsl_version;
+   options.do_link = true;
+   options.compiler_options = corpus->options;
+
+   int64_t start = util_timer_get_nano();
+   struct gl_shader_program *prog =
+      standalone_compile_sources(&options, job->num_sources, job->sources);
+   times->front_end += util_timer_get_nano() - start;
+
+   if (!prog) {
+      if (record) {
+         job->error = ralloc_asprintf(job->mem_ctx,
+                                      "GLSL %d isn't supported",
+                                      job->glsl_version);
+      }
+      return;
+   }
+
+   const char *error = program_error(prog);
+   if (error) {
+      if (record)
+         job->error = ralloc_strdup(job->mem_ctx, error);
+      standalone_free_program(prog);
+      return;
+   }
+
+   for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
+      struct gl_linked_shader *shader = prog->_LinkedShaders[i];
+
+      if (!shader || !(backend->stages & (1 << i)))
+         continue;
+
+      void *mem_ctx = ralloc_context(NULL);
+      struct stage_result result;
+      char *stage_error = NULL;
+
+      memset(&result, 0, sizeof(result));
+
+      start = util_timer_get_nano();
+      nir_shader *nir = lower_to_nir(corpus, prog, shader);
+      ralloc_steal(mem_ctx, nir);
+      int64_t lowered = util_timer_get_nano();
+
+      result.failed = !backend->compile(corpus->compiler, mem_ctx, prog, nir,
+                                        &result.stats, &stage_error);
+      int64_t end = util_timer_get_nano();
+
+      times->to_nir += lowered - start;
+      times->backend[i] += end - lowered;
+
+      if (record) {
+         result.compiled = true;
+         result.time = end - start;
+         if (result.failed) {
+            result.error = ralloc_strdup(job->mem_ctx, stage_error ?
+                                         stage_error : "unknown error");
+         }
+         job->stages[i] = result;
+      }
+
+      ralloc_free(mem_ctx);
+   }
+
+   standalone_free_program(prog);
+}
+
+static int
+compile_worker(void *data)
+{
+   struct worker *worker = (struct worker *) data;
+   struct corpus *corpus = worker->corpus;
+   const unsigned total = corpus->num_jobs * corpus->iterations;
+
+   for (;;) {
+      unsigned i = p_atomic_inc_return(&corpus->next) - 1;
+      if (i >= total)
+         break;
+
+      struct program_job *job = &corpus->jobs[i % corpus->num_jobs];
+      if (!job->skipped)
+         compile_program(corpus, job, &worker->times, i < corpus->num_jobs);
+   }
+
+   return 0;
+}
+
+static void
+print_results(const struct corpus *corpus, bool quiet)
+{
+   for (unsigned j = 0; j < corpus->num_jobs; j++) {
+      const struct program_job *job = &corpus->jobs[j];
+
+      if (job->skipped) {
+         fprintf(stderr, "%s: skipped, %s\n", job->path, job->skipped);
+         continue;
+      }
+
+      if (job->error) {
+         fprintf(stderr, "%s: FAIL\n%s\n", job->path, job->error);
+         continue;
+      }
+
+      for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
+         const struct stage_result *result = &job->stages[i];
+
+         if (!result->compiled)
+            continue;
+
+         if (result->failed) {
+            fprintf(stderr, "%s - %s shader: FAIL\n%s\n", job->path,
+                    _mesa_shader_stage_to_abbrev(i), result->error);
+         } else if (!quiet) {
+            printf("%s - %s shader: %u inst, %u loops, %u:%u spills:fills, "
+                   "%.3f ms\n", job->path, _mesa_shader_stage_to_abbrev(i),
+                   result->stats.instructions, result->stats.loops,
+                   result->stats.spills, result->stats.fills,
+                   result->time / 1000000.0);
+         }
+      }
+   }
+}
+
+static void
+print_summary(const struct corpus *corpus, const struct phase_times *times,
+              unsigned num_threads, int64_t wall_time)
+{
+   unsigned skipped = 0, failed = 0;
+   unsigned shaders[MESA_SHADER_STAGES] = { 0 };
+   struct offline_stats totals[MESA_SHADER_STAGES];
+   const double ms = 1000000.0 * corpus->iterations;
+
+   memset(totals, 0, sizeof(totals));
+
+   for (unsigned j = 0; j < corpus->num_jobs; j++) {
+      const struct program_job *job = &corpus->jobs[j];
+      bool job_failed = job->error != NULL;
+
+      if (job->skipped) {
+         skipped++;
+         continue;
+      }
+
+      for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
+         const struct stage_result *result = &job->stages[i];
+
+         if (!result->compiled)
+            continue;
+
+         if (result->failed) {
+            job_failed = true;
+            continue;
+         }
+
+         shaders[i]++;
+         totals[i].instructions += result->stats.instructions;
+         totals[i].loops += result->stats.loops;
+         totals[i].spills += result->stats.spills;
+         totals[i].fills += result->stats.fills;
+      }
+
+      if (job_failed)
+         failed++;
+   }
+
+   printf("\n%s backend, %u thread%s, %u iteration%s\n",
+          corpus->backend->name, num_threads, num_threads == 1 ? "" : "s",
+          corpus->iterations, corpus->iterations == 1 ? "" : "s");
+   printf("%u programs: %u compiled, %u failed, %u skipped\n\n",
+          corpus->num_jobs, corpus->num_jobs - failed - skipped, failed,
+          skipped);
+
+   printf("stage  shaders  instructions    loops   spills    fills  backend ms\n");
+   for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
+      if (!shaders[i])
+         continue;
+
+      printf("%-5s %8u %13u %8u %8u %8u %11.3f\n",
+             _mesa_shader_stage_to_abbrev(i), shaders[i],
+             totals[i].instructions, totals[i].loops, totals[i].spills,
+             totals[i].fills, times->backend[i] / ms);
+   }
+
+   int64_t backend_time = 0;
+   for (unsigned i = 0; i < MESA_SHADER_STAGES; i++)
+      backend_time += times->backend[i];
+
+   printf("\nCPU time per iteration:\n");
+   printf("   GLSL front end and linker:     %10.3f ms\n", times->front_end / ms);
+   printf("   GLSL lowering and glsl_to_nir: %10.3f ms\n", times->to_nir / ms);
+   printf("   backend:                       %10.3f ms\n", backend_time / ms);
+   printf("Wall time per iteration:          %10.3f ms\n", wall_time / ms);
+}
+
+static void
+usage(const char *name, const struct offline_backend *const *backends,
+      unsigned num_backends)
+{
+   fprintf(stderr,
+           "usage: %s [options] <file.shader_test | file.vert ... | directory>...\n"
+           "\n"
+           "Compiles every .shader_test under the given directories, and the\n"
+           "given files, and prints the instruction counts and compile times.\n"
+           "\n"
+           "Options:\n"
+           "    -b <backend>[:<arg>]  backend to compile with:", name);
+   for (unsigned i = 0; i < num_backends; i++)
+      fprintf(stderr, " %s", backends[i]->name);
+   fprintf(stderr,
+           "\n"
+           "    -j <threads>          number of threads (default: one per CPU)\n"
+           "    -n <iterations>       compile the corpus that many times\n"
+           "    -v <version>          GLSL version for plain GLSL files (default: 450)\n"
+           "    -q                    only print failures and the summary\n");
+}
+
+int
+offline_compiler_main(int argc, char **argv,
+                      const struct offline_backend *const *backends,
+                      unsigned num_backends)
+{
+   const struct offline_backend *backend = backends[0];
+   const char *backend_arg = NULL;
+   unsigned num_threads = 0;
+   int glsl_version = 450;
+   bool quiet = false;
+   struct corpus corpus;
+   int c;
+
+   memset(&corpus, 0, sizeof(corpus));
+   corpus.iterations = 1;
+
+   while ((c = getopt(argc, argv, "b:j:n:v:q")) != -1) {
+      switch (c) {
+      case 'b': {
+         const char *colon = strchr(optarg, ':');
+         size_t len = colon ? (size_t) (colon - optarg) : strlen(optarg);
+
+         backend = NULL;
+         for (unsigned i = 0; i < num_backends; i++) {
+            if (strlen(backends[i]->name) == len &&
+                strncmp(backends[i]->name, optarg, len) == 0)
+               backend = backends[i];
+         }
+         if (!backend) {
+            fprintf(stderr, "Unknown backend `%s'\n", optarg);
+            return EXIT_FAILURE;
+         }
+         backend_arg = colon ? colon + 1 : NULL;
+         break;
+      }
+      case 'j':
+         num_threads = atoi(optarg);
+         break;
+      case 'n':
+         corpus.iterations = MAX2(atoi(optarg), 1);
+         break;
+      case 'v':
+         glsl_version = atoi(optarg);
+         break;
+      case 'q':
+         quiet = true;
+         break;
+      default:
+         usage(argv[0], backends, num_backends);
+         return EXIT_FAILURE;
+      }
+   }
+
+   if (optind == argc) {
+      usage(argv[0], backends, num_backends);
+      return EXIT_FAILURE;
+   }
+
+   struct file_list files;
+   files.mem_ctx = ralloc_context(NULL);
+   files.paths = NULL;
+   files.count = 0;
+
+   for (int i = optind; i < argc; i++) {
+      if (!add_path(&files, argv[i], false))
+         return EXIT_FAILURE;
+   }
+
+   if (files.count == 0) {
+      fprintf(stderr, "No shaders found\n");
+      return EXIT_FAILURE;
+   }
+
+   qsort(files.paths, files.count, sizeof(files.paths[0]), compare_paths);
+
+   corpus.jobs = rzalloc_array(files.mem_ctx, struct program_job, files.count);
+   for (unsigned i = 0; i < files.count; i++) {
+      if (!load_job(&corpus.jobs[i], files.paths[i], glsl_version))
+         return EXIT_FAILURE;
+   }
+   corpus.num_jobs = files.count;
+
+   corpus.backend = backend;
+   corpus.compiler = backend->create(backend_arg);
+   if (!corpus.compiler) {
+      fprintf(stderr, "Couldn't create the %s backend\n", backend->name);
+      return EXIT_FAILURE;
+   }
+
+   /* The defaults of standalone_scaffolding.cpp, with the buffer lowering
+    * that every driver asks for.
+    */
+   for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
+      corpus.options[i].MaxUnrollIterations = 32;
+      corpus.options[i].MaxIfDepth = UINT_MAX;
+      corpus.options[i].LowerBufferInterfaceBlocks = true;
+   }
+   backend->get_options(corpus.compiler, corpus.options);
+
+   if (num_threads == 0)
+      num_threads = MAX2(sysconf(_SC_NPROCESSORS_ONLN), 1);
+   num_threads = MIN2(num_threads, corpus.num_jobs * corpus.iterations);
+
+   struct worker *workers = rzalloc_array(files.mem_ctx, struct worker,
+                                          num_threads);
+
+   int64_t start = util_timer_get_nano();
+   for (unsigned i = 0; i < num_threads; i++) {
+      workers[i].corpus = &corpus;
+      if (i > 0 &&
+          thrd_create(&workers[i].thread, compile_worker,
+                      &workers[i]) != thrd_success) {
+         /* The workers share the job list, so just run with the threads
+          * that did start.
+          */
+         num_threads = i;
+         break;
+      }
+   }
+   compile_worker(&workers[0]);
+   for (unsigned i = 1; i < num_threads; i++)
+      thrd_join(workers[i].thread, NULL);
+   int64_t wall_time = util_timer_get_nano() - start;
+
+   struct phase_times times;
+   memset(&times, 0, sizeof(times));
+   for (unsigned i = 0; i < num_threads; i++) {
+      times.front_end += workers[i].times.front_end;
+      times.to_nir += workers[i].times.to_nir;
+      for (unsigned s = 0; s < MESA_SHADER_STAGES; s++)
+         times.backend[s] += workers[i].times.backend[s];
+   }
+
+   print_results(&corpus, quiet);
+   print_summary(&corpus, &times, num_threads, wall_time);
+
+   bool failed = false;
+   for (unsigned j = 0; j < corpus.num_jobs; j++) {
+      if (corpus.jobs[j].error)
+         failed = true;
+      for (unsigned i = 0; i < MESA_SHADER_STAGES; i++)
+         failed |= corpus.jobs[j].stages[i].failed;
+      ralloc_free(corpus.jobs[j].mem_ctx);
+   }
+
+   backend->destroy(corpus.compiler);
+   ralloc_free(files.mem_ctx);
+
+   _mesa_glsl_release_types();
+   _mesa_glsl_release_builtin_functions();
+
+   return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
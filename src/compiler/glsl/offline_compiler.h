@@ -0,0 +1,128 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef GLSL_OFFLINE_COMPILER_H
+#define GLSL_OFFLINE_COMPILER_H
+
+#include <stdbool.h>
+#include "compiler/shader_enums.h"
+
+/** @file offline_compiler.h
+ *
+ * Offline compiler and benchmark for a corpus of GLSL shaders.
+ *
+ * Each .shader_test file (shader-db style) found in the given files and
+ * directories, or each plain GLSL file, is compiled and linked by the GLSL
+ * front end, turned into NIR and compiled by one of the backends, without
+ * any hardware.  The programs are spread over all CPUs.  The instruction
+ * counts of every shader and the time spent in each phase are printed.
+ *
+ * Drivers build their own offline compiler by passing their backend, and
+ * usually offline_nir_backend as well, to offline_compiler_main().
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct gl_linked_shader;
+struct gl_shader_compiler_options;
+struct gl_shader_program;
+struct nir_shader;
+
+struct offline_stats {
+   unsigned instructions;
+   unsigned loops;
+   unsigned spills;
+   unsigned fills;
+};
+
+struct offline_backend {
+   const char *name;
+
+   /** Mask of (1 << gl_shader_stage) of the stages the backend compiles. */
+   unsigned stages;
+
+   /**
+    * Creates the backend's compiler.  \p arg is what followed "name:" on the
+    * command line, or NULL.  Returns NULL on failure.
+    */
+   void *(*create)(const char *arg);
+   void (*destroy)(void *compiler);
+
+   /**
+    * Fills in the GLSL compiler options of each stage, including the NIR
+    * options.  \p options is an array of MESA_SHADER_STAGES, already set to
+    * the defaults.
+    */
+   void (*get_options)(void *compiler,
+                       struct gl_shader_compiler_options *options);
+
+   /**
+    * Lowers the linked GLSL IR of one stage before it is turned into NIR.
+    * NULL uses offline_lower_glsl_ir().
+    */
+   void (*lower_glsl)(void *compiler,
+                      const struct gl_shader_compiler_options *options,
+                      struct gl_shader_program *prog,
+                      struct gl_linked_shader *shader);
+
+   /**
+    * Compiles one stage of a program, which the backend may modify.  This is
+    * called from several threads at once.
+    *
+    * On failure, returns false and sets \p error to a message allocated out
+    * of \p mem_ctx.
+    */
+   bool (*compile)(void *compiler, void *mem_ctx,
+                   struct gl_shader_program *prog, struct nir_shader *nir,
+                   struct offline_stats *stats, char **error);
+};
+
+/**
+ * Runs the NIR optimization loop that most drivers share, and counts the
+ * NIR instructions that are left.
+ */
+extern const struct offline_backend offline_nir_backend;
+
+/**
+ * The GLSL IR lowering that glsl_to_nir() needs, done the way the drivers'
+ * link steps do it.
+ */
+void offline_lower_glsl_ir(const struct gl_shader_compiler_options *options,
+                           struct gl_linked_shader *shader);
+
+/**
+ * Parses the command line, compiles the corpus with the selected backend
+ * (the first one by default) and prints the results.  Returns the exit
+ * status.
+ */
+int offline_compiler_main(int argc, char **argv,
+                          const struct offline_backend *const *backends,
+                          unsigned num_backends);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GLSL_OFFLINE_COMPILER_H */
@@ -38,10 +38,9 @@
 #include "standalone_scaffolding.h"
 #include "standalone.h"
 
-static const struct standalone_options *options;
-
 static void
-initialize_context(struct gl_context *ctx, gl_api api)
+initialize_context(struct gl_context *ctx, gl_api api,
+                   const struct standalone_options *options)
 {
    initialize_context_to_defaults(ctx, api);
 
@@ -153,6 +152,12 @@ initialize_context(struct gl_context *ctx, gl_api api)
       break;
    case 150:
    case 330:
+   case 400:
+   case 410:
+   case 420:
+   case 430:
+   case 440:
+   case 450:
       ctx->Const.MaxClipPlanes = 8;
       ctx->Const.MaxDrawBuffers = 8;
       ctx->Const.MinProgramTexelOffset = -8;
@@ -226,6 +231,11 @@ initialize_context(struct gl_context *ctx, gl_api api)
    ctx->Const.MaxUserAssignableUniformLocations =
       4 * MESA_SHADER_STAGES * MAX_UNIFORMS;
 
+   if (options->compiler_options) {
+      for (unsigned i = 0; i < MESA_SHADER_STAGES; i++)
+         ctx->Const.ShaderCompilerOptions[i] = options->compiler_options[i];
+   }
+
    ctx->Driver.NewShader = _mesa_new_linked_shader;
 }
 
@@ -273,8 +283,9 @@ load_text_file(void *ctx, const char *file_name)
    return text;
 }
 
-void
-compile_shader(struct gl_context *ctx, struct gl_shader *shader)
+static void
+compile_shader(struct gl_context *ctx, struct gl_shader *shader,
+               const struct standalone_options *options)
 {
    struct _mesa_glsl_parse_state *state =
       new(shader) _mesa_glsl_parse_state(ctx, shader->Stage, shader);
@@ -289,7 +300,7 @@ compile_shader(struct gl_context *ctx, struct gl_shader *shader)
    return;
 }
 
-void
+static void
 init_gl_program(struct gl_program *prog, GLenum target)
 {
    mtx_init(&prog->Mutex, mtx_plain);
@@ -302,16 +313,35 @@ init_gl_program(struct gl_program *prog, GLenum target)
       prog->SamplerUnits[i] = i;
 }
 
-extern "C" struct gl_shader_program *
-standalone_compile_shader(const struct standalone_options *_options,
-      unsigned num_files, char* const* files)
+/* Code that looks at the stage's own program struct, like glsl_to_nir and
+ * do_set_program_inouts, needs the whole derived struct to be there.
+ */
+static struct gl_program *
+new_gl_program(void *mem_ctx, gl_shader_stage stage)
 {
-   int status = EXIT_SUCCESS;
-   static struct gl_context local_ctx;
-   struct gl_context *ctx = &local_ctx;
-   bool glsl_es = false;
+   switch (stage) {
+   case MESA_SHADER_VERTEX:
+      return &rzalloc(mem_ctx, gl_vertex_program)->Base;
+   case MESA_SHADER_TESS_CTRL:
+      return &rzalloc(mem_ctx, gl_tess_ctrl_program)->Base;
+   case MESA_SHADER_TESS_EVAL:
+      return &rzalloc(mem_ctx, gl_tess_eval_program)->Base;
+   case MESA_SHADER_GEOMETRY:
+      return &rzalloc(mem_ctx, gl_geometry_program)->Base;
+   case MESA_SHADER_FRAGMENT:
+      return &rzalloc(mem_ctx, gl_fragment_program)->Base;
+   case MESA_SHADER_COMPUTE:
+      return &rzalloc(mem_ctx, gl_compute_program)->Base;
+   }
+
+   unreachable("not reached");
+}
 
-   options = _options;
+static struct gl_shader_program *
+create_program(const struct standalone_options *options,
+               struct gl_context **ctx)
+{
+   bool glsl_es = false;
 
    switch (options->glsl_version) {
    case 100:
@@ -324,6 +354,12 @@ standalone_compile_shader(const struct standalone_options *_options,
    case 140:
    case 150:
    case 330:
+   case 400:
+   case 410:
+   case 420:
+   case 430:
+   case 440:
+   case 450:
       glsl_es = false;
       break;
    default:
@@ -331,8 +367,6 @@ standalone_compile_shader(const struct standalone_options *_options,
       return NULL;
    }
 
-   initialize_context(ctx, (glsl_es) ? API_OPENGLES2 : API_OPENGL_COMPAT);
-
    struct gl_shader_program *whole_program;
 
    whole_program = rzalloc (NULL, struct gl_shader_program);
@@ -344,38 +378,110 @@ standalone_compile_shader(const struct standalone_options *_options,
    whole_program->FragDataBindings = new string_to_uint_map;
    whole_program->FragDataIndexBindings = new string_to_uint_map;
 
-   for (unsigned i = 0; i < num_files; i++) {
-      whole_program->Shaders =
-            reralloc(whole_program, whole_program->Shaders,
-                  struct gl_shader *, whole_program->NumShaders + 1);
-      assert(whole_program->Shaders != NULL);
+   /* Each program gets its own context, so that several can be compiled
+    * at once.
+    */
+   *ctx = rzalloc(whole_program, struct gl_context);
+   initialize_context(*ctx, (glsl_es) ? API_OPENGLES2 : API_OPENGL_COMPAT,
+                      options);
 
-      struct gl_shader *shader = rzalloc(whole_program, gl_shader);
+   return whole_program;
+}
 
-      whole_program->Shaders[whole_program->NumShaders] = shader;
-      whole_program->NumShaders++;
+static GLenum
+shader_type(gl_shader_stage stage)
+{
+   switch (stage) {
+   case MESA_SHADER_VERTEX:
+      return GL_VERTEX_SHADER;
+   case MESA_SHADER_TESS_CTRL:
+      return GL_TESS_CONTROL_SHADER;
+   case MESA_SHADER_TESS_EVAL:
+      return GL_TESS_EVALUATION_SHADER;
+   case MESA_SHADER_GEOMETRY:
+      return GL_GEOMETRY_SHADER;
+   case MESA_SHADER_FRAGMENT:
+      return GL_FRAGMENT_SHADER;
+   case MESA_SHADER_COMPUTE:
+      return GL_COMPUTE_SHADER;
+   }
+
+   unreachable("not reached");
+}
+
+static struct gl_shader *
+add_shader(struct gl_shader_program *whole_program, gl_shader_stage stage)
+{
+   whole_program->Shaders =
+         reralloc(whole_program, whole_program->Shaders,
+               struct gl_shader *, whole_program->NumShaders + 1);
+   assert(whole_program->Shaders != NULL);
+
+   struct gl_shader *shader = rzalloc(whole_program, gl_shader);
+
+   whole_program->Shaders[whole_program->NumShaders] = shader;
+   whole_program->NumShaders++;
 
+   shader->Stage = stage;
+   shader->Type = shader_type(stage);
+
+   return shader;
+}
+
+static void
+link_program(struct gl_context *ctx, struct gl_shader_program *whole_program)
+{
+   _mesa_clear_shader_program_data(whole_program);
+
+   link_shaders(ctx, whole_program);
+
+   for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
+      struct gl_linked_shader *shader = whole_program->_LinkedShaders[i];
+
+      if (!shader)
+         continue;
+
+      shader->Program = new_gl_program(shader, shader->Stage);
+      init_gl_program(shader->Program, shader->Stage);
+   }
+}
+
+extern "C" struct gl_shader_program *
+standalone_compile_shader(const struct standalone_options *options,
+      unsigned num_files, char* const* files)
+{
+   int status = EXIT_SUCCESS;
+   struct gl_context *ctx;
+   struct gl_shader_program *whole_program;
+
+   whole_program = create_program(options, &ctx);
+   if (!whole_program)
+      return NULL;
+
+   for (unsigned i = 0; i < num_files; i++) {
       const unsigned len = strlen(files[i]);
       if (len < 6)
          goto fail;
 
+      gl_shader_stage stage;
       const char *const ext = & files[i][len - 5];
       /* TODO add support to read a .shader_test */
       if (strncmp(".vert", ext, 5) == 0 || strncmp(".glsl", ext, 5) == 0)
-	 shader->Type = GL_VERTEX_SHADER;
+	 stage = MESA_SHADER_VERTEX;
       else if (strncmp(".tesc", ext, 5) == 0)
-	 shader->Type = GL_TESS_CONTROL_SHADER;
+	 stage = MESA_SHADER_TESS_CTRL;
       else if (strncmp(".tese", ext, 5) == 0)
-	 shader->Type = GL_TESS_EVALUATION_SHADER;
+	 stage = MESA_SHADER_TESS_EVAL;
       else if (strncmp(".geom", ext, 5) == 0)
-	 shader->Type = GL_GEOMETRY_SHADER;
+	 stage = MESA_SHADER_GEOMETRY;
       else if (strncmp(".frag", ext, 5) == 0)
-	 shader->Type = GL_FRAGMENT_SHADER;
+	 stage = MESA_SHADER_FRAGMENT;
       else if (strncmp(".comp", ext, 5) == 0)
-         shader->Type = GL_COMPUTE_SHADER;
+         stage = MESA_SHADER_COMPUTE;
       else
          goto fail;
-      shader->Stage = _mesa_shader_enum_to_shader_stage(shader->Type);
+
+      struct gl_shader *shader = add_shader(whole_program, stage);
 
       shader->Source = load_text_file(whole_program, files[i]);
       if (shader->Source == NULL) {
@@ -383,7 +489,7 @@ standalone_compile_shader(const struct standalone_options *_options,
          exit(EXIT_FAILURE);
       }
 
-      compile_shader(ctx, shader);
+      compile_shader(ctx, shader, options);
 
       if (strlen(shader->InfoLog) > 0) {
          if (!options->just_log)
@@ -401,9 +507,7 @@ standalone_compile_shader(const struct standalone_options *_options,
    }
 
    if ((status == EXIT_SUCCESS) && options->do_link)  {
-      _mesa_clear_shader_program_data(whole_program);
-
-      link_shaders(ctx, whole_program);
+      link_program(ctx, whole_program);
       status = (whole_program->LinkStatus) ? EXIT_SUCCESS : EXIT_FAILURE;
 
       if (strlen(whole_program->InfoLog) > 0) {
@@ -414,27 +518,45 @@ standalone_compile_shader(const struct standalone_options *_options,
          if (!options->just_log)
             printf("\n");
       }
-
-      for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
-         struct gl_linked_shader *shader = whole_program->_LinkedShaders[i];
-
-         if (!shader)
-            continue;
-
-         shader->Program = rzalloc(shader, gl_program);
-         init_gl_program(shader->Program, shader->Stage);
-      }
    }
 
    return whole_program;
 
 fail:
-   ralloc_free(whole_program);
+   standalone_free_program(whole_program);
    return NULL;
 }
 
+extern "C" struct gl_shader_program *
+standalone_compile_sources(const struct standalone_options *options,
+                           unsigned num_sources,
+                           const struct standalone_shader_source *sources)
+{
+   struct gl_context *ctx;
+   struct gl_shader_program *whole_program;
+
+   whole_program = create_program(options, &ctx);
+   if (!whole_program)
+      return NULL;
+
+   for (unsigned i = 0; i < num_sources; i++) {
+      struct gl_shader *shader = add_shader(whole_program, sources[i].stage);
+
+      shader->Source = ralloc_strdup(shader, sources[i].source);
+      compile_shader(ctx, shader, options);
+
+      if (!shader->CompileStatus)
+         return whole_program;
+   }
+
+   if (options->do_link)
+      link_program(ctx, whole_program);
+
+   return whole_program;
+}
+
 extern "C" void
-standalone_compiler_cleanup(struct gl_shader_program *whole_program)
+standalone_free_program(struct gl_shader_program *whole_program)
 {
    for (unsigned i = 0; i < MESA_SHADER_STAGES; i++)
       ralloc_free(whole_program->_LinkedShaders[i]);
@@ -444,6 +566,13 @@ standalone_compiler_cleanup(struct gl_shader_program *whole_program)
    delete whole_program->FragDataIndexBindings;
 
    ralloc_free(whole_program);
+}
+
+extern "C" void
+standalone_compiler_cleanup(struct gl_shader_program *whole_program)
+{
+   standalone_free_program(whole_program);
+
    _mesa_glsl_release_types();
    _mesa_glsl_release_builtin_functions();
 }
@@ -24,10 +24,14 @@
 #ifndef GLSL_STANDALONE_H
 #define GLSL_STANDALONE_H
 
+#include "compiler/shader_enums.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+struct gl_shader_compiler_options;
+
 struct standalone_options {
    int glsl_version;
    int dump_ast;
@@ -35,6 +39,19 @@ struct standalone_options {
    int dump_lir;
    int do_link;
    int just_log;
+
+   /**
+    * Array of compiler options indexed by gl_shader_stage, or NULL for the
+    * defaults.  Drivers pass their own to get the lowering their link step
+    * asks for.
+    */
+   const struct gl_shader_compiler_options *compiler_options;
+};
+
+/** One shader of a program compiled from memory. */
+struct standalone_shader_source {
+   gl_shader_stage stage;
+   const char *source;
 };
 
 struct gl_shader_program;
@@ -43,6 +60,21 @@ struct gl_shader_program * standalone_compile_shader(
       const struct standalone_options *options,
       unsigned num_files, char* const* files);
 
+/**
+ * Compiles and, if options->do_link is set, links the given shaders without
+ * printing the info logs.  The caller checks the shaders' CompileStatus, the
+ * program's LinkStatus and their info logs.
+ *
+ * Unlike standalone_compile_shader, this may be called from several threads
+ * at once.  Returns NULL only if the GLSL version isn't supported.
+ */
+struct gl_shader_program * standalone_compile_sources(
+      const struct standalone_options *options,
+      unsigned num_sources, const struct standalone_shader_source *sources);
+
+/** Frees a program, but not the global compiler state. */
+void standalone_free_program(struct gl_shader_program *prog);
+
 void standalone_compiler_cleanup(struct gl_shader_program *prog);
 
 #ifdef __cplusplus
@@ -25,6 +25,7 @@
 #include "main/macros.h"
 #include "compiler/glsl/glsl_parser_extras.h"
 #include "glsl_types.h"
+#include "compiler/glsl/blob.h"
 #include "util/hash_table.h"
 
 
@@ -422,8 +423,8 @@ void
 _mesa_glsl_release_types(void)
 {
    /* Should only be called during atexit (either when unloading shared
-    * object, or if process terminates), so no mutex-locking should be
-    * necessary.
+    * object, or if process terminates), after the shader compiler queue has
+    * been drained, so no mutex-locking should be necessary.
     */
    if (glsl_type::array_types != NULL) {
       _mesa_hash_table_destroy(glsl_type::array_types, NULL);
@@ -2012,3 +2013,179 @@ glsl_type::coordinate_components() const
 
 #include "compiler/builtin_type_macros.h"
 /** @} */
+
+
+/* Written in place of a type pointer for NULL */
+#define ENCODED_NULL_TYPE ~0u
+
+void
+encode_type_to_blob(struct blob *blob, const glsl_type *type)
+{
+   if (type == NULL) {
+      blob_write_uint32(blob, ENCODED_NULL_TYPE);
+      return;
+   }
+
+   blob_write_uint32(blob, type->base_type);
+
+   switch (type->base_type) {
+   case GLSL_TYPE_UINT:
+   case GLSL_TYPE_INT:
+   case GLSL_TYPE_FLOAT:
+   case GLSL_TYPE_DOUBLE:
+   case GLSL_TYPE_BOOL:
+      blob_write_uint32(blob, (type->vector_elements << 8) |
+                              type->matrix_columns);
+      return;
+   case GLSL_TYPE_SAMPLER:
+   case GLSL_TYPE_IMAGE:
+      blob_write_uint32(blob, (type->sampler_dimensionality << 4) |
+                              (type->sampler_shadow << 3) |
+                              (type->sampler_array << 2) |
+                              type->sampled_type);
+      return;
+   case GLSL_TYPE_SUBROUTINE:
+      blob_write_string(blob, type->name);
+      return;
+   case GLSL_TYPE_ARRAY:
+      blob_write_uint32(blob, type->length);
+      encode_type_to_blob(blob, type->fields.array);
+      return;
+   case GLSL_TYPE_STRUCT:
+   case GLSL_TYPE_INTERFACE:
+      blob_write_string(blob, type->name);
+      blob_write_uint32(blob, type->length);
+      blob_write_uint32(blob, type->interface_packing);
+      for (unsigned i = 0; i < type->length; i++) {
+         const glsl_struct_field *f = &type->fields.structure[i];
+
+         encode_type_to_blob(blob, f->type);
+         blob_write_string(blob, f->name);
+         blob_write_uint32(blob, f->location);
+         blob_write_uint32(blob, f->offset);
+         blob_write_uint32(blob, f->xfb_buffer);
+         blob_write_uint32(blob, f->xfb_stride);
+         blob_write_uint32(blob, f->interpolation |
+                                 f->centroid << 2 |
+                                 f->sample << 3 |
+                                 f->matrix_layout << 4 |
+                                 f->patch << 6 |
+                                 f->precision << 7 |
+                                 f->image_read_only << 9 |
+                                 f->image_write_only << 10 |
+                                 f->image_coherent << 11 |
+                                 f->image_volatile << 12 |
+                                 f->image_restrict << 13 |
+                                 f->explicit_xfb_buffer << 14 |
+                                 f->implicit_sized_array << 15);
+      }
+      return;
+   case GLSL_TYPE_ATOMIC_UINT:
+   case GLSL_TYPE_VOID:
+   case GLSL_TYPE_ERROR:
+      return;
+   case GLSL_TYPE_FUNCTION:
+      break;
+   }
+
+   assert(!"Cannot encode type!");
+}
+
+const glsl_type *
+decode_type_from_blob(struct blob_reader *blob)
+{
+   uint32_t base_type = blob_read_uint32(blob);
+
+   if (blob->overrun || base_type == ENCODED_NULL_TYPE)
+      return NULL;
+
+   switch (base_type) {
+   case GLSL_TYPE_UINT:
+   case GLSL_TYPE_INT:
+   case GLSL_TYPE_FLOAT:
+   case GLSL_TYPE_DOUBLE:
+   case GLSL_TYPE_BOOL: {
+      uint32_t dims = blob_read_uint32(blob);
+      return glsl_type::get_instance(base_type, dims >> 8, dims & 0xff);
+   }
+   case GLSL_TYPE_SAMPLER:
+   case GLSL_TYPE_IMAGE: {
+      uint32_t bits = blob_read_uint32(blob);
+      enum glsl_sampler_dim dim = (enum glsl_sampler_dim) (bits >> 4);
+      glsl_base_type sampled = (glsl_base_type) (bits & 0x3);
+
+      if (base_type == GLSL_TYPE_SAMPLER)
+         return glsl_type::get_sampler_instance(dim, (bits >> 3) & 1,
+                                                (bits >> 2) & 1, sampled);
+      return glsl_type::get_image_instance(dim, (bits >> 2) & 1, sampled);
+   }
+   case GLSL_TYPE_SUBROUTINE:
+      return glsl_type::get_subroutine_instance(blob_read_string(blob));
+   case GLSL_TYPE_ARRAY: {
+      unsigned length = blob_read_uint32(blob);
+      const glsl_type *element = decode_type_from_blob(blob);
+      if (element == NULL)
+         return NULL;
+      return glsl_type::get_array_instance(element, length);
+   }
+   case GLSL_TYPE_STRUCT:
+   case GLSL_TYPE_INTERFACE: {
+      const char *name = blob_read_string(blob);
+      unsigned num_fields = blob_read_uint32(blob);
+      unsigned packing = blob_read_uint32(blob);
+
+      if (blob->overrun)
+         return NULL;
+
+      glsl_struct_field *fields = new glsl_struct_field[num_fields];
+      for (unsigned i = 0; i < num_fields; i++) {
+         glsl_struct_field *f = &fields[i];
+
+         f->type = decode_type_from_blob(blob);
+         f->name = blob_read_string(blob);
+         f->location = blob_read_uint32(blob);
+         f->offset = blob_read_uint32(blob);
+         f->xfb_buffer = blob_read_uint32(blob);
+         f->xfb_stride = blob_read_uint32(blob);
+
+         uint32_t flags = blob_read_uint32(blob);
+         f->interpolation = flags & 0x3;
+         f->centroid = (flags >> 2) & 1;
+         f->sample = (flags >> 3) & 1;
+         f->matrix_layout = (flags >> 4) & 0x3;
+         f->patch = (flags >> 6) & 1;
+         f->precision = (flags >> 7) & 0x3;
+         f->image_read_only = (flags >> 9) & 1;
+         f->image_write_only = (flags >> 10) & 1;
+         f->image_coherent = (flags >> 11) & 1;
+         f->image_volatile = (flags >> 12) & 1;
+         f->image_restrict = (flags >> 13) & 1;
+         f->explicit_xfb_buffer = (flags >> 14) & 1;
+         f->implicit_sized_array = (flags >> 15) & 1;
+
+         if (f->type == NULL || f->name == NULL) {
+            delete[] fields;
+            return NULL;
+         }
+      }
+
+      const glsl_type *t;
+      if (base_type == GLSL_TYPE_STRUCT)
+         t = glsl_type::get_record_instance(fields, num_fields, name);
+      else
+         t = glsl_type::get_interface_instance(fields, num_fields,
+                                               (glsl_interface_packing) packing,
+                                               name);
+      delete[] fields;
+      return t;
+   }
+   case GLSL_TYPE_ATOMIC_UINT:
+      return glsl_type::atomic_uint_type;
+   case GLSL_TYPE_VOID:
+      return glsl_type::void_type;
+   case GLSL_TYPE_ERROR:
+      return glsl_type::error_type;
+   default:
+      return NULL;
+   }
+}
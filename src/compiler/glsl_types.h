@@ -35,6 +35,9 @@ extern "C" {
 
 struct _mesa_glsl_parse_state;
 struct glsl_symbol_table;
+struct glsl_type;
+struct blob;
+struct blob_reader;
 
 extern void
 _mesa_glsl_initialize_types(struct _mesa_glsl_parse_state *state);
@@ -42,6 +45,16 @@ _mesa_glsl_initialize_types(struct _mesa_glsl_parse_state *state);
 extern void
 _mesa_glsl_release_types(void);
 
+/**
+ * Serialize a type (which may be NULL) so that it can be recreated by
+ * decode_type_from_blob(), possibly in another process.
+ */
+void
+encode_type_to_blob(struct blob *blob, const struct glsl_type *type);
+
+const struct glsl_type *
+decode_type_from_blob(struct blob_reader *blob);
+
 #ifdef __cplusplus
 }
 #endif
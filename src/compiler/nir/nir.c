@@ -56,6 +56,7 @@ nir_shader_create(void *mem_ctx,
    shader->num_shared = 0;
 
    shader->stage = stage;
+   shader->pass_stats = NULL;
 
    return shader;
 }
@@ -283,6 +284,7 @@ nir_function_impl_create_bare(nir_shader *shader)
    impl->reg_alloc = 0;
    impl->ssa_alloc = 0;
    impl->valid_metadata = nir_metadata_none;
+   impl->live_ssa_defs_dirty = NULL;
 
    /* create start & end blocks */
    nir_block *start_block = nir_block_create(shader);
@@ -1607,6 +1607,12 @@ typedef struct {
    unsigned num_blocks;
 
    nir_metadata valid_metadata;
+
+   /**
+    * SSA values whose uses changed since the live sets were last brought up
+    * to date, or NULL if there are none.  See nir_live_ssa_defs_dirty_def().
+    */
+   struct set *live_ssa_defs_dirty;
 } nir_function_impl;
 
 ATTRIBUTE_RETURNS_NONNULL static inline nir_block *
@@ -1894,6 +1900,9 @@ typedef struct nir_shader {
 
    /** The shader stage, such as MESA_SHADER_VERTEX. */
    gl_shader_stage stage;
+
+   /** Statistics of the NIR_PASS currently running, if they are gathered */
+   struct nir_pass_stats *pass_stats;
 } nir_shader;
 
 static inline nir_function *
@@ -2325,16 +2334,51 @@ static inline bool should_clone_nir(void) { return false; }
    }                                                                 \
 } while (0)
 
+/**
+ * Counters for one NIR pass.
+ *
+ * When the NIR_PASS_STATS environment variable is set, NIR_PASS and
+ * NIR_PASS_V time each pass they run and count the metadata it had to
+ * compute, and the totals for each pass are printed at exit.  With
+ * MESA_COMPILE_PROFILE, the pass times go to the compile profile.
+ */
+typedef struct nir_pass_stats {
+   const char *name;
+   unsigned runs;
+   unsigned progress;
+   int64_t start;
+   int64_t time;
+
+   /** Indexed by the bit number of the nir_metadata flag */
+   struct {
+      unsigned full;        /**< recomputed from scratch */
+      unsigned incremental; /**< brought up to date in place */
+      int64_t time;
+   } metadata[3];
+} nir_pass_stats;
+
+void nir_pass_stats_begin(nir_shader *shader, nir_pass_stats *stats,
+                          const char *name);
+void nir_pass_stats_end(nir_shader *shader, nir_pass_stats *stats,
+                        bool progress);
+
 #define NIR_PASS(progress, nir, pass, ...) _PASS(nir,                \
+   nir_pass_stats _pass_stats;                                       \
+   nir_pass_stats_begin(nir, &_pass_stats, #pass);                   \
    nir_metadata_set_validation_flag(nir);                            \
-   if (pass(nir, ##__VA_ARGS__)) {                                   \
+   bool _pass_progress = pass(nir, ##__VA_ARGS__);                   \
+   nir_pass_stats_end(nir, &_pass_stats, _pass_progress);            \
+   if (_pass_progress) {                                             \
       progress = true;                                               \
       nir_metadata_check_validation_flag(nir);                       \
    }                                                                 \
 )
 
 #define NIR_PASS_V(nir, pass, ...) _PASS(nir,                        \
+   nir_pass_stats _pass_stats;                                       \
+   nir_pass_stats_begin(nir, &_pass_stats, #pass);                   \
    pass(nir, ##__VA_ARGS__);                                         \
+   nir_pass_stats_end(nir, &_pass_stats, false);                     \
 )
 
 void nir_calc_dominance_impl(nir_function_impl *impl);
@@ -2544,6 +2588,9 @@ void nir_lower_double_pack(nir_shader *shader);
 bool nir_normalize_cubemap_coords(nir_shader *shader);
 
 void nir_live_ssa_defs_impl(nir_function_impl *impl);
+void nir_live_ssa_defs_update_impl(nir_function_impl *impl);
+void nir_live_ssa_defs_dirty_def(nir_function_impl *impl, nir_ssa_def *def);
+void nir_live_ssa_defs_dirty_instr(nir_function_impl *impl, nir_instr *instr);
 bool nir_ssa_defs_interfere(nir_ssa_def *a, nir_ssa_def *b);
 
 void nir_convert_to_ssa_impl(nir_function_impl *impl);
@@ -26,6 +26,7 @@
 
 from __future__ import print_function
 import ast
+from collections import namedtuple
 import itertools
 import struct
 import sys
@@ -494,6 +495,149 @@ class SearchAndReplace(object):
 
       BitSizeValidator(varset).validate(self.search, self.replace)
 
+class TreeAutomaton(object):
+   """A bottom-up tree automaton matching the search expressions of a pass.
+
+   Rather than trying every transform for an opcode in turn, the generated
+   pass first walks the shader once, labeling every SSA value with a state
+   of this automaton, and then only tries the transforms whose search
+   expression the state says could match.
+
+   The automaton works on "items", search expressions with the details that
+   nir_search still checks at match time (bit sizes, variable types and
+   conditions, the exact flag, swizzles, actual constant values) stripped
+   off: a variable becomes the wildcard item, which matches any value, and
+   a constant or a constant variable becomes the const item, which matches
+   any load_const.  Expressions become (opcode, source items) tuples.
+
+   A state is the set of items that match a value.  Every state contains
+   the wildcard, state 0 is that of any value not produced by a load_const
+   or an ALU instruction in a search expression, and state 1 is that of
+   load_const values.  The state of an ALU instruction only depends on its
+   opcode and the states of its sources.  To keep the transition tables
+   small, the source states are first mapped through a per-opcode filter to
+   only the items that appear as sources of that opcode's items.
+   """
+
+   Item = namedtuple('Item', ['opcode', 'sources'])
+
+   def __init__(self, transforms):
+      self.wildcard = self.Item('__wildcard', ())
+      self.const = self.Item('__const', ())
+
+      # Items of each opcode, in the order they were first seen.
+      self.opcode_items = {}
+      self.root_items = [self._add_item(xform.search) for xform in transforms]
+      self.opcodes = sorted(self.opcode_items.keys())
+
+      # The users of a replacement read the imov nir_replace_instr() adds,
+      # nir_algebraic_automaton_replaced() relies on that not matching.
+      assert 'imov' not in self.opcodes
+
+      self._build()
+
+      # For each state, the indices of the transforms which could match.
+      self.state_xforms = []
+      for state in self.states:
+         self.state_xforms.append(tuple(i for (i, item)
+                                        in enumerate(self.root_items)
+                                        if item in state))
+
+   def _add_item(self, val):
+      if isinstance(val, Constant):
+         return self.const
+      elif isinstance(val, Variable):
+         return self.const if val.is_constant else self.wildcard
+
+      num_inputs = opcodes[val.opcode].num_inputs
+      item = self.Item(val.opcode,
+                       tuple(self._add_item(src)
+                             for src in val.sources[:num_inputs]))
+
+      items = self.opcode_items.setdefault(val.opcode, [])
+      if item not in items:
+         items.append(item)
+      return item
+
+   def _match(self, opcode, srcs):
+      """Returns the state of an opcode with sources in the given filtered
+      states."""
+      commutative = 'commutative' in opcodes[opcode].algebraic_properties
+      state = set([self.wildcard])
+
+      for item in self.opcode_items[opcode]:
+         if all(src in srcs[i] for (i, src) in enumerate(item.sources)):
+            state.add(item)
+         elif commutative and len(srcs) == 2 and \
+              item.sources[0] in srcs[1] and item.sources[1] in srcs[0]:
+            state.add(item)
+
+      return frozenset(state)
+
+   def _add_state(self, state):
+      if state not in self.state_index:
+         self.state_index[state] = len(self.states)
+         self.states.append(state)
+      return self.state_index[state]
+
+   def _build(self):
+      self.states = []
+      self.state_index = {}
+      self._add_state(frozenset([self.wildcard]))
+      self._add_state(frozenset([self.wildcard, self.const]))
+
+      src_items = {}
+      filtered_index = {}
+      # Per opcode: the filtered states, the filtered state index of every
+      # state, and the transition table indexed by tuples of filtered states.
+      self.filtered_states = {}
+      self.filters = {}
+      self.tables = {}
+      for opcode in self.opcodes:
+         src_items[opcode] = frozenset(src for item in self.opcode_items[opcode]
+                                       for src in item.sources)
+         filtered_index[opcode] = {}
+         self.filtered_states[opcode] = []
+         self.filters[opcode] = []
+         self.tables[opcode] = {}
+
+      # New states can only come from new filtered states, so every state
+      # is run through the filters once, and the transitions involving a
+      # new filtered state are computed when it shows up.
+      i = 0
+      while i < len(self.states):
+         for opcode in self.opcodes:
+            filtered = self.states[i] & src_items[opcode]
+            index = filtered_index[opcode].get(filtered)
+            if index is None:
+               index = len(self.filtered_states[opcode])
+               filtered_index[opcode][filtered] = index
+               self.filtered_states[opcode].append(filtered)
+
+               num_inputs = opcodes[opcode].num_inputs
+               count = len(self.filtered_states[opcode])
+               for srcs in itertools.product(range(count), repeat=num_inputs):
+                  if index not in srcs:
+                     continue
+
+                  state = self._match(opcode, [self.filtered_states[opcode][s]
+                                               for s in srcs])
+                  self.tables[opcode][srcs] = self._add_state(state)
+
+            self.filters[opcode].append(index)
+         i += 1
+
+      # States are stored as uint16_t.
+      assert len(self.states) <= 0x10000
+
+   def table(self, opcode):
+      """Returns the transition table of an opcode, flattened in row-major
+      order."""
+      count = len(self.filtered_states[opcode])
+      num_inputs = opcodes[opcode].num_inputs
+      return [self.tables[opcode][srcs] for srcs
+              in itertools.product(range(count), repeat=num_inputs)]
+
 _algebraic_pass_template = mako.template.Template("""
 #include "nir.h"
 #include "nir_search.h"
@@ -507,9 +651,145 @@ struct transform {
    unsigned condition_offset;
 };
 
+/* The transforms that could match a value in a given automaton state, as
+ * a range of a list of transform indices.
+ */
+struct state_xforms {
+   uint16_t offset;
+   uint16_t count;
+};
+
 #endif
 
-% for (opcode, xform_list) in xform_dict.iteritems():
+% if automaton:
+% for xform in xforms:
+   ${xform.search.render()}
+   ${xform.replace.render()}
+% endfor
+
+static const struct transform ${pass_name}_xforms[] = {
+% for xform in xforms:
+   { &${xform.search.name}, ${xform.replace.c_ptr}, ${xform.condition_index} },
+% endfor
+};
+
+% for opcode in automaton.opcodes:
+static const uint16_t ${pass_name}_filter_${opcode}[] = {
+% for i in range(0, len(automaton.filters[opcode]), 16):
+   ${', '.join(str(f) for f in automaton.filters[opcode][i:i + 16])},
+% endfor
+};
+
+<% table = automaton.table(opcode) %>
+static const uint16_t ${pass_name}_table_${opcode}[] = {
+% for i in range(0, len(table), 16):
+   ${', '.join(str(s) for s in table[i:i + 16])},
+% endfor
+};
+
+% endfor
+static const nir_algebraic_op_table ${pass_name}_op_tables[nir_num_opcodes] = {
+% for opcode in automaton.opcodes:
+   [nir_op_${opcode}] = {
+      ${pass_name}_filter_${opcode},
+      ${len(automaton.filtered_states[opcode])},
+      ${pass_name}_table_${opcode},
+   },
+% endfor
+};
+
+static const uint16_t ${pass_name}_state_xform_list[] = {
+% for xform_list in state_xform_lists:
+% if xform_list:
+   ${', '.join(str(i) for i in xform_list)},
+% endif
+% endfor
+   0, /* keeps the array from being empty */
+};
+
+/* Indexed by automaton state */
+static const struct state_xforms ${pass_name}_state_xforms[] = {
+% for xform_list in automaton.state_xforms:
+   { ${state_xform_offsets[xform_list]}, ${len(xform_list)} },
+% endfor
+};
+
+static bool
+${pass_name}_instr(nir_alu_instr *alu, const bool *condition_flags,
+                   nir_function_impl *impl,
+                   nir_algebraic_automaton *automaton, void *mem_ctx)
+{
+   const struct state_xforms *state =
+      &${pass_name}_state_xforms[nir_algebraic_automaton_state(automaton, alu)];
+
+   for (unsigned i = 0; i < state->count; i++) {
+      const struct transform *xform =
+         &${pass_name}_xforms[${pass_name}_state_xform_list[state->offset + i]];
+      if (!condition_flags[xform->condition_offset])
+         continue;
+
+      unsigned first_new_index = impl->ssa_alloc;
+      nir_alu_instr *replacement =
+         nir_replace_instr(alu, xform->search, xform->replace, mem_ctx);
+      if (replacement) {
+         nir_algebraic_automaton_replaced(automaton, impl, alu, replacement,
+                                          first_new_index);
+         return true;
+      }
+   }
+
+   return false;
+}
+
+static bool
+${pass_name}_block(nir_block *block, const bool *condition_flags,
+                   nir_function_impl *impl,
+                   nir_algebraic_automaton *automaton, void *mem_ctx)
+{
+   bool progress = false;
+
+   /* Replacements are inserted before the instruction they replace, so the
+    * reverse walk never gets to them.
+    */
+   nir_foreach_instr_reverse_safe(instr, block) {
+      if (instr->type != nir_instr_type_alu)
+         continue;
+
+      nir_alu_instr *alu = nir_instr_as_alu(instr);
+      if (!alu->dest.dest.is_ssa)
+         continue;
+
+      progress |= ${pass_name}_instr(alu, condition_flags, impl, automaton,
+                                     mem_ctx);
+   }
+
+   return progress;
+}
+
+static bool
+${pass_name}_impl(nir_function_impl *impl, const bool *condition_flags)
+{
+   void *mem_ctx = ralloc_parent(impl);
+   bool progress = false;
+   nir_algebraic_automaton automaton;
+
+   nir_algebraic_automaton_init(&automaton, impl, ${pass_name}_op_tables);
+
+   nir_foreach_block_reverse(block, impl) {
+      progress |= ${pass_name}_block(block, condition_flags, impl,
+                                     &automaton, mem_ctx);
+   }
+
+   nir_algebraic_automaton_finish(&automaton);
+
+   if (progress)
+      nir_metadata_preserve(impl, nir_metadata_block_index |
+                                  nir_metadata_dominance);
+
+   return progress;
+}
+% else:
+% for (opcode, xform_list) in sorted(xform_dict.items()):
 % for xform in xform_list:
    ${xform.search.render()}
    ${xform.replace.render()}
@@ -537,7 +817,7 @@ ${pass_name}_block(nir_block *block, const bool *condition_flags,
          continue;
 
       switch (alu->op) {
-      % for opcode in xform_dict.keys():
+      % for opcode in sorted(xform_dict.keys()):
       case nir_op_${opcode}:
          for (unsigned i = 0; i < ARRAY_SIZE(${pass_name}_${opcode}_xforms); i++) {
             const struct transform *xform = &${pass_name}_${opcode}_xforms[i];
@@ -574,6 +854,7 @@ ${pass_name}_impl(nir_function_impl *impl, const bool *condition_flags)
 
    return progress;
 }
+% endif
 
 
 bool
@@ -598,8 +879,17 @@ ${pass_name}(nir_shader *shader)
 """)
 
 class AlgebraicPass(object):
-   def __init__(self, pass_name, transforms):
-      self.xform_dict = {}
+   """An algebraic pass applying the given transforms.
+
+   By default the generated pass labels the shader with a tree automaton
+   (see TreeAutomaton) to find the transforms which could match an
+   instruction.  With automaton=False it simply tries all the transforms
+   for the opcode of the instruction instead, which is cheaper for passes
+   with only a few transforms.
+   """
+
+   def __init__(self, pass_name, transforms, automaton=True):
+      self.xforms = []
       self.pass_name = pass_name
 
       error = False
@@ -616,15 +906,37 @@ class AlgebraicPass(object):
                error = True
                continue
 
-         if xform.search.opcode not in self.xform_dict:
-            self.xform_dict[xform.search.opcode] = []
-
-         self.xform_dict[xform.search.opcode].append(xform)
+         self.xforms.append(xform)
 
       if error:
          sys.exit(1)
 
+      self.xform_dict = {}
+      for xform in self.xforms:
+         self.xform_dict.setdefault(xform.search.opcode, []).append(xform)
+
+      self.automaton = None
+      self.state_xform_lists = []
+      self.state_xform_offsets = {}
+      if not automaton:
+         return
+
+      self.automaton = TreeAutomaton(self.xforms)
+
+      # States tend to share transform lists, so each list is emitted once.
+      offset = 0
+      for xform_list in self.automaton.state_xforms:
+         if xform_list not in self.state_xform_offsets:
+            self.state_xform_offsets[xform_list] = offset
+            self.state_xform_lists.append(xform_list)
+            offset += len(xform_list)
+      assert offset <= 0x10000
+
    def render(self):
       return _algebraic_pass_template.render(pass_name=self.pass_name,
+                                             xforms=self.xforms,
                                              xform_dict=self.xform_dict,
+                                             automaton=self.automaton,
+                                             state_xform_lists=self.state_xform_lists,
+                                             state_xform_offsets=self.state_xform_offsets,
                                              condition_list=condition_list)
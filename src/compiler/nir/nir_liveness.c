@@ -227,6 +227,167 @@ nir_live_ssa_defs_impl(nir_function_impl *impl)
    }
 
    nir_block_worklist_fini(&state.worklist);
+
+   if (impl->live_ssa_defs_dirty) {
+      _mesa_set_destroy(impl->live_ssa_defs_dirty, NULL);
+      impl->live_ssa_defs_dirty = NULL;
+   }
+}
+
+/*
+ * Incremental liveness.
+ *
+ * The live range of an SSA value only depends on the CFG and on where the
+ * value is used.  A pass that neither changes the CFG nor adds SSA values
+ * can therefore keep the liveness information by reporting every value
+ * whose uses it changed (including the values it deletes) with
+ * nir_live_ssa_defs_dirty_def() or nir_live_ssa_defs_dirty_instr() and
+ * preserving nir_metadata_live_ssa_defs.  The next nir_metadata_require()
+ * then recomputes the live ranges of only those values, by walking up the
+ * CFG from each of their uses to their definition.
+ */
+
+/** Reports that the uses of def changed or that def was deleted */
+void
+nir_live_ssa_defs_dirty_def(nir_function_impl *impl, nir_ssa_def *def)
+{
+   if (!(impl->valid_metadata & nir_metadata_live_ssa_defs))
+      return;
+
+   /* Undefined values are never live */
+   if (def->live_index == 0)
+      return;
+
+   if (impl->live_ssa_defs_dirty == NULL) {
+      impl->live_ssa_defs_dirty =
+         _mesa_set_create(impl, _mesa_hash_pointer, _mesa_key_pointer_equal);
+   }
+
+   _mesa_set_add(impl->live_ssa_defs_dirty, def);
+}
+
+static bool
+dirty_src_cb(nir_src *src, void *impl)
+{
+   if (src->is_ssa)
+      nir_live_ssa_defs_dirty_def(impl, src->ssa);
+
+   return true;
+}
+
+static bool
+dirty_def_cb(nir_ssa_def *def, void *impl)
+{
+   nir_live_ssa_defs_dirty_def(impl, def);
+   return true;
+}
+
+/**
+ * Reports every SSA value read or written by instr.  Call this before
+ * removing instr or rewriting the uses of the values it defines.
+ */
+void
+nir_live_ssa_defs_dirty_instr(nir_function_impl *impl, nir_instr *instr)
+{
+   if (!(impl->valid_metadata & nir_metadata_live_ssa_defs))
+      return;
+
+   nir_foreach_src(instr, dirty_src_cb, impl);
+   nir_foreach_ssa_def(instr, dirty_def_cb, impl);
+}
+
+static void
+mark_live_out(nir_block *block, unsigned index, nir_block_worklist *worklist)
+{
+   if (BITSET_TEST(block->live_out, index))
+      return;
+
+   BITSET_SET(block->live_out, index);
+   nir_block_worklist_push_tail(worklist, block);
+}
+
+static void
+update_ssa_def_liveness(nir_function_impl *impl, nir_ssa_def *def,
+                        nir_block_worklist *worklist)
+{
+   const unsigned index = def->live_index;
+
+   nir_foreach_block(block, impl) {
+      BITSET_CLEAR(block->live_in, index);
+      BITSET_CLEAR(block->live_out, index);
+   }
+
+   /* A deleted value has no uses left, so it is dead everywhere. */
+   if (list_empty(&def->uses) && list_empty(&def->if_uses))
+      return;
+
+   /* The worklist holds the blocks in which the value is used, and from
+    * there the walk goes up the CFG until it reaches the definition.  Phi
+    * sources are used at the end of their predecessor and if conditions at
+    * the end of the block before the if.
+    */
+   nir_foreach_use(use, def) {
+      if (use->parent_instr->type == nir_instr_type_phi) {
+         nir_phi_src *phi_src = exec_node_data(nir_phi_src, use, src);
+         mark_live_out(phi_src->pred, index, worklist);
+      } else {
+         nir_block_worklist_push_tail(worklist, use->parent_instr->block);
+      }
+   }
+
+   nir_foreach_if_use(use, def) {
+      nir_cf_node *prev = nir_cf_node_prev(&use->parent_if->cf_node);
+      nir_block_worklist_push_tail(worklist, nir_cf_node_as_block(prev));
+   }
+
+   nir_block *def_block = def->parent_instr->block;
+   const bool is_phi = def->parent_instr->type == nir_instr_type_phi;
+
+   while (!nir_block_worklist_is_empty(worklist)) {
+      nir_block *block = nir_block_worklist_pop_head(worklist);
+
+      /* Phi destinations are in the live in of their block, see above.
+       * Anything else is killed by its definition.
+       */
+      if (block == def_block && !is_phi)
+         continue;
+
+      if (BITSET_TEST(block->live_in, index))
+         continue;
+
+      BITSET_SET(block->live_in, index);
+
+      if (block == def_block)
+         continue;
+
+      struct set_entry *entry;
+      set_foreach(block->predecessors, entry)
+         mark_live_out((nir_block *)entry->key, index, worklist);
+   }
+}
+
+/**
+ * Brings the live sets up to date after the edits reported with
+ * nir_live_ssa_defs_dirty_def().  The values keep their live_index.
+ */
+void
+nir_live_ssa_defs_update_impl(nir_function_impl *impl)
+{
+   struct set *dirty = impl->live_ssa_defs_dirty;
+   if (dirty == NULL)
+      return;
+
+   nir_block_worklist worklist;
+   nir_block_worklist_init(&worklist, impl->num_blocks, NULL);
+
+   struct set_entry *entry;
+   set_foreach(dirty, entry)
+      update_ssa_def_liveness(impl, (nir_ssa_def *)entry->key, &worklist);
+
+   nir_block_worklist_fini(&worklist);
+
+   _mesa_set_destroy(dirty, NULL);
+   impl->live_ssa_defs_dirty = NULL;
 }
 
 static bool
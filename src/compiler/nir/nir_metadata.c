@@ -24,23 +24,78 @@
  *    Jason Ekstrand (jason@jlekstrand.net)
  */
 
+#include <stdlib.h>
+
 #include "nir.h"
+#include "c11/threads.h"
+#include "util/bitscan.h"
+#include "util/compile_profile.h"
+#include "util/debug.h"
+#include "util/hash_table.h"
+#include "util/u_timer.h"
 
 /*
  * Handles management of the metadata.
  */
 
+static bool pass_stats_enabled(void);
+static void pass_stats_add(const nir_pass_stats *stats);
+
+static void
+update_metadata(nir_function_impl *impl, nir_metadata metadata, bool full,
+                void (*update)(nir_function_impl *impl))
+{
+   if (!pass_stats_enabled()) {
+      update(impl);
+      return;
+   }
+
+   int64_t start = util_timer_get_nano();
+   update(impl);
+   int64_t time = util_timer_get_nano() - start;
+
+   /* Metadata required outside of NIR_PASS is charged to a pseudo-pass */
+   nir_pass_stats *stats = impl->function->shader->pass_stats;
+   nir_pass_stats outside;
+   if (stats == NULL) {
+      memset(&outside, 0, sizeof(outside));
+      outside.name = "(outside NIR_PASS)";
+      stats = &outside;
+   }
+
+   unsigned i = ffs(metadata) - 1;
+   assert(i < ARRAY_SIZE(stats->metadata));
+   if (full)
+      stats->metadata[i].full++;
+   else
+      stats->metadata[i].incremental++;
+   stats->metadata[i].time += time;
+
+   if (stats == &outside)
+      pass_stats_add(&outside);
+}
+
 void
 nir_metadata_require(nir_function_impl *impl, nir_metadata required)
 {
 #define NEEDS_UPDATE(X) ((required & ~impl->valid_metadata) & (X))
 
-   if (NEEDS_UPDATE(nir_metadata_block_index))
-      nir_index_blocks(impl);
-   if (NEEDS_UPDATE(nir_metadata_dominance))
-      nir_calc_dominance_impl(impl);
-   if (NEEDS_UPDATE(nir_metadata_live_ssa_defs))
-      nir_live_ssa_defs_impl(impl);
+   if (NEEDS_UPDATE(nir_metadata_block_index)) {
+      update_metadata(impl, nir_metadata_block_index, true,
+                      nir_index_blocks);
+   }
+   if (NEEDS_UPDATE(nir_metadata_dominance)) {
+      update_metadata(impl, nir_metadata_dominance, true,
+                      nir_calc_dominance_impl);
+   }
+   if (NEEDS_UPDATE(nir_metadata_live_ssa_defs)) {
+      update_metadata(impl, nir_metadata_live_ssa_defs, true,
+                      nir_live_ssa_defs_impl);
+   } else if ((required & nir_metadata_live_ssa_defs) &&
+              impl->live_ssa_defs_dirty) {
+      update_metadata(impl, nir_metadata_live_ssa_defs, false,
+                      nir_live_ssa_defs_update_impl);
+   }
 
 #undef NEEDS_UPDATE
 
@@ -51,6 +106,167 @@ void
 nir_metadata_preserve(nir_function_impl *impl, nir_metadata preserved)
 {
    impl->valid_metadata &= preserved;
+
+   /* The reported edits are only useful to update valid liveness */
+   if (!(preserved & nir_metadata_live_ssa_defs) &&
+       impl->live_ssa_defs_dirty) {
+      _mesa_set_destroy(impl->live_ssa_defs_dirty, NULL);
+      impl->live_ssa_defs_dirty = NULL;
+   }
+}
+
+/*
+ * Pass statistics, gathered when NIR_PASS_STATS is set.  Each NIR_PASS
+ * collects its own counters in a nir_pass_stats on the stack, and they are
+ * added to the process-wide totals for that pass when it returns.
+ */
+
+static once_flag pass_stats_once = ONCE_FLAG_INIT;
+static bool pass_stats_on;
+static mtx_t pass_stats_mutex;
+static struct hash_table *pass_stats_totals;
+
+static int
+compare_pass_time(const void *a, const void *b)
+{
+   const nir_pass_stats *sa = *(const nir_pass_stats **)a;
+   const nir_pass_stats *sb = *(const nir_pass_stats **)b;
+
+   if (sa->time != sb->time)
+      return sa->time < sb->time ? 1 : -1;
+   return strcmp(sa->name, sb->name);
+}
+
+static void
+pass_stats_print(void)
+{
+   static const char *metadata_names[] = {
+      "block index", "dominance", "live SSA defs"
+   };
+   unsigned count = 0;
+
+   mtx_lock(&pass_stats_mutex);
+
+   const nir_pass_stats **passes =
+      malloc(pass_stats_totals->entries * sizeof(*passes));
+   if (passes == NULL) {
+      mtx_unlock(&pass_stats_mutex);
+      return;
+   }
+
+   struct hash_entry *entry;
+   hash_table_foreach(pass_stats_totals, entry)
+      passes[count++] = entry->data;
+
+   qsort(passes, count, sizeof(*passes), compare_pass_time);
+
+   fprintf(stderr, "NIR pass statistics (times in ms):\n%65s", "");
+   for (unsigned i = 0; i < ARRAY_SIZE(metadata_names); i++)
+      fprintf(stderr, "  %-23s", metadata_names[i]);
+   fprintf(stderr, "\n%-36s %8s %8s %10s", "pass", "runs", "progress", "time");
+   for (unsigned i = 0; i < ARRAY_SIZE(metadata_names); i++)
+      fprintf(stderr, "  %6s %5s %10s", "full", "incr", "time");
+   fprintf(stderr, "\n");
+
+   for (unsigned p = 0; p < count; p++) {
+      const nir_pass_stats *stats = passes[p];
+
+      fprintf(stderr, "%-36s %8u %8u %10.3f", stats->name, stats->runs,
+              stats->progress, stats->time / 1000000.0);
+      for (unsigned i = 0; i < ARRAY_SIZE(stats->metadata); i++) {
+         fprintf(stderr, "  %6u %5u %10.3f", stats->metadata[i].full,
+                 stats->metadata[i].incremental,
+                 stats->metadata[i].time / 1000000.0);
+      }
+      fprintf(stderr, "\n");
+   }
+
+   free(passes);
+   mtx_unlock(&pass_stats_mutex);
+}
+
+static void
+pass_stats_init(void)
+{
+   pass_stats_on = env_var_as_boolean("NIR_PASS_STATS", false);
+   if (!pass_stats_on)
+      return;
+
+   mtx_init(&pass_stats_mutex, mtx_plain);
+   pass_stats_totals = _mesa_hash_table_create(NULL, _mesa_key_hash_string,
+                                               _mesa_key_string_equal);
+   atexit(pass_stats_print);
+}
+
+static bool
+pass_stats_enabled(void)
+{
+   call_once(&pass_stats_once, pass_stats_init);
+   return pass_stats_on;
+}
+
+static void
+pass_stats_add(const nir_pass_stats *stats)
+{
+   mtx_lock(&pass_stats_mutex);
+
+   nir_pass_stats *total;
+   struct hash_entry *entry =
+      _mesa_hash_table_search(pass_stats_totals, stats->name);
+   if (entry) {
+      total = entry->data;
+   } else {
+      total = rzalloc(pass_stats_totals, nir_pass_stats);
+      total->name = stats->name;
+      _mesa_hash_table_insert(pass_stats_totals, total->name, total);
+   }
+
+   total->runs += stats->runs;
+   total->progress += stats->progress;
+   total->time += stats->time;
+   for (unsigned i = 0; i < ARRAY_SIZE(total->metadata); i++) {
+      total->metadata[i].full += stats->metadata[i].full;
+      total->metadata[i].incremental += stats->metadata[i].incremental;
+      total->metadata[i].time += stats->metadata[i].time;
+   }
+
+   mtx_unlock(&pass_stats_mutex);
+}
+
+/**
+ * Starts gathering statistics for the pass called name, which should be a
+ * string literal.  Passes run from within another pass are not counted on
+ * their own.  The time of the pass also goes to the compile profile when
+ * MESA_COMPILE_PROFILE is set.
+ */
+void
+nir_pass_stats_begin(nir_shader *shader, nir_pass_stats *stats,
+                     const char *name)
+{
+   if (!(pass_stats_enabled() || compile_profile_enabled()) ||
+       shader->pass_stats)
+      return;
+
+   memset(stats, 0, sizeof(*stats));
+   stats->name = name;
+   stats->runs = 1;
+   stats->start = util_timer_get_nano();
+   shader->pass_stats = stats;
+}
+
+void
+nir_pass_stats_end(nir_shader *shader, nir_pass_stats *stats, bool progress)
+{
+   if (shader->pass_stats != stats)
+      return;
+
+   stats->time = util_timer_get_nano() - stats->start;
+   stats->progress = progress;
+   shader->pass_stats = NULL;
+
+   if (pass_stats_enabled())
+      pass_stats_add(stats);
+   compile_profile_add("nir", stats->name, stats->time, progress);
 }
 
 #ifdef DEBUG
@@ -489,4 +489,5 @@ late_optimizations = [
 
 print nir_algebraic.AlgebraicPass("nir_opt_algebraic", optimizations).render()
 print nir_algebraic.AlgebraicPass("nir_opt_algebraic_late",
-                                  late_optimizations).render()
+                                  late_optimizations,
+                                  automaton=False).render()
@@ -99,11 +99,13 @@ is_swizzleless_move(nir_alu_instr *instr)
 }
 
 static bool
-copy_prop_src(nir_src *src, nir_instr *parent_instr, nir_if *parent_if)
+copy_prop_src(nir_function_impl *impl, nir_src *src, nir_instr *parent_instr,
+              nir_if *parent_if)
 {
    if (!src->is_ssa) {
       if (src->reg.indirect)
-         return copy_prop_src(src->reg.indirect, parent_instr, parent_if);
+         return copy_prop_src(impl, src->reg.indirect, parent_instr,
+                              parent_if);
       return false;
    }
 
@@ -127,6 +129,9 @@ copy_prop_src(nir_src *src, nir_instr *parent_instr, nir_if *parent_if)
          return false;
    }
 
+   nir_live_ssa_defs_dirty_def(impl, src->ssa);
+   nir_live_ssa_defs_dirty_def(impl, alu_instr->src[0].src.ssa);
+
    if (parent_instr) {
       nir_instr_rewrite_src(parent_instr, src,
                             nir_src_for_ssa(alu_instr->src[0].src.ssa));
@@ -140,13 +145,14 @@ copy_prop_src(nir_src *src, nir_instr *parent_instr, nir_if *parent_if)
 }
 
 static bool
-copy_prop_alu_src(nir_alu_instr *parent_alu_instr, unsigned index)
+copy_prop_alu_src(nir_function_impl *impl, nir_alu_instr *parent_alu_instr,
+                  unsigned index)
 {
    nir_alu_src *src = &parent_alu_instr->src[index];
    if (!src->src.is_ssa) {
       if (src->src.reg.indirect)
-         return copy_prop_src(src->src.reg.indirect, &parent_alu_instr->instr,
-                              NULL);
+         return copy_prop_src(impl, src->src.reg.indirect,
+                              &parent_alu_instr->instr, NULL);
       return false;
    }
 
@@ -187,6 +193,9 @@ copy_prop_alu_src(nir_alu_instr *parent_alu_instr, unsigned index)
    for (unsigned i = 0; i < 4; i++)
       src->swizzle[i] = new_swizzle[i];
 
+   nir_live_ssa_defs_dirty_def(impl, src->src.ssa);
+   nir_live_ssa_defs_dirty_def(impl, def);
+
    nir_instr_rewrite_src(&parent_alu_instr->instr, &src->src,
                          nir_src_for_ssa(def));
 
@@ -194,6 +203,7 @@ copy_prop_alu_src(nir_alu_instr *parent_alu_instr, unsigned index)
 }
 
 typedef struct {
+   nir_function_impl *impl;
    nir_instr *parent_instr;
    bool progress;
 } copy_prop_state;
@@ -202,31 +212,33 @@ static bool
 copy_prop_src_cb(nir_src *src, void *_state)
 {
    copy_prop_state *state = (copy_prop_state *) _state;
-   while (copy_prop_src(src, state->parent_instr, NULL))
+   while (copy_prop_src(state->impl, src, state->parent_instr, NULL))
       state->progress = true;
 
    return true;
 }
 
 static bool
-copy_prop_instr(nir_instr *instr)
+copy_prop_instr(nir_function_impl *impl, nir_instr *instr)
 {
    if (instr->type == nir_instr_type_alu) {
       nir_alu_instr *alu_instr = nir_instr_as_alu(instr);
       bool progress = false;
 
       for (unsigned i = 0; i < nir_op_infos[alu_instr->op].num_inputs; i++)
-         while (copy_prop_alu_src(alu_instr, i))
+         while (copy_prop_alu_src(impl, alu_instr, i))
             progress = true;
 
       if (!alu_instr->dest.dest.is_ssa && alu_instr->dest.dest.reg.indirect)
-         while (copy_prop_src(alu_instr->dest.dest.reg.indirect, instr, NULL))
+         while (copy_prop_src(impl, alu_instr->dest.dest.reg.indirect, instr,
+                              NULL))
             progress = true;
 
       return progress;
    }
 
    copy_prop_state state;
+   state.impl = impl;
    state.parent_instr = instr;
    state.progress = false;
    nir_foreach_src(instr, copy_prop_src_cb, &state);
@@ -235,9 +247,9 @@ copy_prop_instr(nir_instr *instr)
 }
 
 static bool
-copy_prop_if(nir_if *if_stmt)
+copy_prop_if(nir_function_impl *impl, nir_if *if_stmt)
 {
-   return copy_prop_src(&if_stmt->condition, NULL, if_stmt);
+   return copy_prop_src(impl, &if_stmt->condition, NULL, if_stmt);
 }
 
 static bool
@@ -247,18 +259,19 @@ nir_copy_prop_impl(nir_function_impl *impl)
 
    nir_foreach_block(block, impl) {
       nir_foreach_instr(instr, block) {
-         if (copy_prop_instr(instr))
+         if (copy_prop_instr(impl, instr))
             progress = true;
       }
 
       nir_if *if_stmt = nir_block_get_following_if(block);
-      if (if_stmt && copy_prop_if(if_stmt))
+      if (if_stmt && copy_prop_if(impl, if_stmt))
          progress = true;
       }
 
    if (progress) {
       nir_metadata_preserve(impl, nir_metadata_block_index |
-                                  nir_metadata_dominance);
+                                  nir_metadata_dominance |
+                                  nir_metadata_live_ssa_defs);
    }
 
    return progress;
@@ -39,12 +39,19 @@
  */
 
 static bool
-cse_block(nir_block *block, struct set *instr_set)
+cse_block(nir_function_impl *impl, nir_block *block, struct set *instr_set)
 {
    bool progress = false;
 
    nir_foreach_instr_safe(instr, block) {
       if (nir_instr_set_add_or_rewrite(instr_set, instr)) {
+         /* The uses of instr moved to the instruction it matched, which is
+          * still the one in the set.
+          */
+         struct set_entry *match = _mesa_set_search(instr_set, instr);
+         nir_live_ssa_defs_dirty_instr(impl, (nir_instr *) match->key);
+         nir_live_ssa_defs_dirty_instr(impl, instr);
+
          progress = true;
          nir_instr_remove(instr);
       }
@@ -52,7 +59,7 @@ cse_block(nir_block *block, struct set *instr_set)
 
    for (unsigned i = 0; i < block->num_dom_children; i++) {
       nir_block *child = block->dom_children[i];
-      progress |= cse_block(child, instr_set);
+      progress |= cse_block(impl, child, instr_set);
    }
 
    nir_foreach_instr(instr, block)
@@ -68,11 +75,12 @@ nir_opt_cse_impl(nir_function_impl *impl)
 
    nir_metadata_require(impl, nir_metadata_dominance);
 
-   bool progress = cse_block(nir_start_block(impl), instr_set);
+   bool progress = cse_block(impl, nir_start_block(impl), instr_set);
 
    if (progress)
       nir_metadata_preserve(impl, nir_metadata_block_index |
-                                  nir_metadata_dominance);
+                                  nir_metadata_dominance |
+                                  nir_metadata_live_ssa_defs);
 
    nir_instr_set_destroy(instr_set);
    return progress;
@@ -150,6 +150,7 @@ nir_opt_dce_impl(nir_function_impl *impl)
    nir_foreach_block(block, impl) {
       nir_foreach_instr_safe(instr, block) {
          if (!instr->pass_flags) {
+            nir_live_ssa_defs_dirty_instr(impl, instr);
             nir_instr_remove(instr);
             progress = true;
          }
@@ -158,7 +159,8 @@ nir_opt_dce_impl(nir_function_impl *impl)
 
    if (progress)
       nir_metadata_preserve(impl, nir_metadata_block_index |
-                                  nir_metadata_dominance);
+                                  nir_metadata_dominance |
+                                  nir_metadata_live_ssa_defs);
 
    return progress;
 }
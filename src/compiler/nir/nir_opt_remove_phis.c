@@ -63,7 +63,7 @@ matching_mov(nir_alu_instr *mov1, nir_ssa_def *ssa)
  */
 
 static bool
-remove_phis_block(nir_block *block)
+remove_phis_block(nir_function_impl *impl, nir_block *block)
 {
    bool progress = false;
 
@@ -114,6 +114,8 @@ remove_phis_block(nir_block *block)
       assert(def != NULL);
 
       assert(phi->dest.is_ssa);
+      nir_live_ssa_defs_dirty_instr(impl, instr);
+      nir_live_ssa_defs_dirty_def(impl, def);
       nir_ssa_def_rewrite_uses(&phi->dest.ssa, nir_src_for_ssa(def));
       nir_instr_remove(instr);
 
@@ -129,12 +131,13 @@ remove_phis_impl(nir_function_impl *impl)
    bool progress = false;
 
    nir_foreach_block(block, impl) {
-      progress |= remove_phis_block(block);
+      progress |= remove_phis_block(impl, block);
    }
 
    if (progress) {
       nir_metadata_preserve(impl, nir_metadata_block_index |
-                                  nir_metadata_dominance);
+                                  nir_metadata_dominance |
+                                  nir_metadata_live_ssa_defs);
    }
 
    return progress;
@@ -616,3 +616,154 @@ nir_replace_instr(nir_alu_instr *instr, const nir_search_expression *search,
 
    return mov;
 }
+
+static unsigned
+automaton_alu_state(const nir_algebraic_automaton *automaton,
+                    const nir_alu_instr *alu)
+{
+   const nir_algebraic_op_table *tbl = &automaton->op_tables[alu->op];
+
+   if (!alu->dest.dest.is_ssa || !tbl->table)
+      return 0;
+
+   unsigned index = 0;
+   for (unsigned i = 0; i < nir_op_infos[alu->op].num_inputs; i++) {
+      unsigned src_state = alu->src[i].src.is_ssa ?
+                           automaton->states[alu->src[i].src.ssa->index] : 0;
+
+      index = index * tbl->num_filtered_states + tbl->filter[src_state];
+   }
+
+   return tbl->table[index];
+}
+
+/* Labels a load_const or ALU instruction, returns whether its state
+ * changed.
+ */
+static bool
+automaton_label(nir_algebraic_automaton *automaton, nir_instr *instr)
+{
+   unsigned index, state;
+
+   if (instr->type == nir_instr_type_load_const) {
+      index = nir_instr_as_load_const(instr)->def.index;
+      state = 1;
+   } else if (instr->type == nir_instr_type_alu &&
+              nir_instr_as_alu(instr)->dest.dest.is_ssa) {
+      nir_alu_instr *alu = nir_instr_as_alu(instr);
+      index = alu->dest.dest.ssa.index;
+      state = automaton_alu_state(automaton, alu);
+   } else {
+      return false;
+   }
+
+   if (automaton->states[index] == state)
+      return false;
+
+   automaton->states[index] = state;
+   return true;
+}
+
+/* Labels the ALU users of def again, and theirs if their state changed.
+ * A state only depends on the values as deep as the deepest search
+ * expression, so this doesn't recurse further than that.
+ */
+static void
+automaton_relabel_users(nir_algebraic_automaton *automaton, nir_ssa_def *def)
+{
+   nir_foreach_use(src, def) {
+      if (src->parent_instr->type != nir_instr_type_alu)
+         continue;
+
+      nir_alu_instr *user = nir_instr_as_alu(src->parent_instr);
+      if (automaton_label(automaton, &user->instr))
+         automaton_relabel_users(automaton, &user->dest.dest.ssa);
+   }
+}
+
+/**
+ * Labels every SSA value of impl with its state in the matching automaton
+ * of an algebraic pass.
+ *
+ * Values that are neither load_const nor ALU results stay in state 0, and
+ * load_const values are in state 1.  Sources come before their uses in
+ * block order except through phis, which are in state 0, so one walk is
+ * enough.
+ */
+void
+nir_algebraic_automaton_init(nir_algebraic_automaton *automaton,
+                             nir_function_impl *impl,
+                             const nir_algebraic_op_table *op_tables)
+{
+   automaton->op_tables = op_tables;
+   automaton->num_states = impl->ssa_alloc;
+   automaton->states = rzalloc_array(NULL, uint16_t, automaton->num_states);
+
+   nir_foreach_block(block, impl) {
+      nir_foreach_instr(instr, block)
+         automaton_label(automaton, instr);
+   }
+}
+
+void
+nir_algebraic_automaton_finish(nir_algebraic_automaton *automaton)
+{
+   ralloc_free(automaton->states);
+}
+
+/**
+ * Updates the states after nir_replace_instr() replaced instr.
+ *
+ * The instructions of the replacement, which got SSA indices starting at
+ * first_new_index and were inserted right before instr, are labeled, and
+ * so are the users of the replacement, as far as the states change.  The
+ * users now read the mov nir_replace_instr() ends the replacement with,
+ * which nir_algebraic.py doesn't allow in search expressions, so they can
+ * only lose matches and don't have to be tried again.  instr itself goes
+ * to state 0.
+ */
+void
+nir_algebraic_automaton_replaced(nir_algebraic_automaton *automaton,
+                                 nir_function_impl *impl,
+                                 nir_alu_instr *instr,
+                                 nir_alu_instr *replacement,
+                                 unsigned first_new_index)
+{
+   if (impl->ssa_alloc > automaton->num_states) {
+      unsigned num_states = MAX2(impl->ssa_alloc, automaton->num_states * 2);
+
+      automaton->states = reralloc(NULL, automaton->states, uint16_t,
+                                   num_states);
+      memset(automaton->states + automaton->num_states, 0,
+             (num_states - automaton->num_states) * sizeof(uint16_t));
+      automaton->num_states = num_states;
+   }
+
+   automaton->states[instr->dest.dest.ssa.index] = 0;
+
+   /* The replacement is the last of the new instructions */
+   nir_instr *first = &replacement->instr;
+   for (nir_instr *prev = nir_instr_prev(first); prev;
+        prev = nir_instr_prev(prev)) {
+      unsigned index;
+
+      if (prev->type == nir_instr_type_load_const)
+         index = nir_instr_as_load_const(prev)->def.index;
+      else if (prev->type == nir_instr_type_alu &&
+               nir_instr_as_alu(prev)->dest.dest.is_ssa)
+         index = nir_instr_as_alu(prev)->dest.dest.ssa.index;
+      else
+         break;
+
+      if (index < first_new_index)
+         break;
+      first = prev;
+   }
+
+   for (nir_instr *new_instr = first; new_instr != &replacement->instr;
+        new_instr = nir_instr_next(new_instr))
+      automaton_label(automaton, new_instr);
+   automaton_label(automaton, &replacement->instr);
+
+   automaton_relabel_users(automaton, &replacement->dest.dest.ssa);
+}
@@ -112,8 +112,54 @@ NIR_DEFINE_CAST(nir_search_value_as_constant, nir_search_value,
 NIR_DEFINE_CAST(nir_search_value_as_expression, nir_search_value,
                 nir_search_expression, value)
 
+/** Transitions of the matching automaton of an algebraic pass for one
+ * opcode
+ *
+ * These are generated by nir_algebraic.py.  The state of an instruction is
+ * table[filter[state of src0] * num_filtered_states^(n-1) + ... +
+ * filter[state of src(n-1)]].
+ */
+typedef struct {
+   const uint16_t *filter;
+   unsigned num_filtered_states;
+   const uint16_t *table;
+} nir_algebraic_op_table;
+
 nir_alu_instr *
 nir_replace_instr(nir_alu_instr *instr, const nir_search_expression *search,
                   const nir_search_value *replace, void *mem_ctx);
 
+/** The states of the SSA values of a function in the matching automaton
+ * of an algebraic pass
+ */
+typedef struct {
+   const nir_algebraic_op_table *op_tables;
+
+   /** Indexed by SSA index */
+   uint16_t *states;
+   unsigned num_states;
+} nir_algebraic_automaton;
+
+void
+nir_algebraic_automaton_init(nir_algebraic_automaton *automaton,
+                             nir_function_impl *impl,
+                             const nir_algebraic_op_table *op_tables);
+
+void
+nir_algebraic_automaton_finish(nir_algebraic_automaton *automaton);
+
+void
+nir_algebraic_automaton_replaced(nir_algebraic_automaton *automaton,
+                                 nir_function_impl *impl,
+                                 nir_alu_instr *instr,
+                                 nir_alu_instr *replacement,
+                                 unsigned first_new_index);
+
+static inline unsigned
+nir_algebraic_automaton_state(const nir_algebraic_automaton *automaton,
+                              const nir_alu_instr *instr)
+{
+   return automaton->states[instr->dest.dest.ssa.index];
+}
+
 #endif /* _NIR_SEARCH_ */
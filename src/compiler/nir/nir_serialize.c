@@ -0,0 +1,1159 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "nir_serialize.h"
+#include "nir_control_flow.h"
+#include "compiler/glsl_types.h"
+#include "util/macros.h"
+
+/* The layout follows nir_clone.c: write_foo() and read_foo() handle the
+ * same object in the same order.
+ *
+ * Every variable, register, function, block and SSA value gets an index
+ * the first time it is written, and references to it are written as that
+ * index.  The reader assigns indices in the same order, so definitions
+ * don't have to store their own index.  The only forward references are
+ * phi sources, which can name a block or SSA value that comes later in a
+ * loop; blocks and SSA values of a function_impl are therefore numbered
+ * up front, and the reader fixes phi sources up at the end of the impl,
+ * just like nir_shader_clone() does.
+ */
+
+typedef struct {
+   struct blob *blob;
+
+   /* maps pointer -> index (stored in the data pointer) */
+   struct hash_table *remap_table;
+
+   /* the next index to assign */
+   uint32_t next_idx;
+} write_ctx;
+
+typedef struct {
+   nir_shader *nir;
+
+   struct blob_reader *blob;
+
+   /* maps index -> pointer */
+   void **idx_table;
+   uint32_t idx_table_len;
+
+   /* the next index to assign */
+   uint32_t next_idx;
+
+   /* List of phi sources. */
+   struct list_head phi_srcs;
+} read_ctx;
+
+static void
+write_add_object(write_ctx *ctx, const void *obj)
+{
+   uint32_t index = ctx->next_idx++;
+   _mesa_hash_table_insert(ctx->remap_table, obj, (void *)(uintptr_t) index);
+}
+
+static uint32_t
+write_lookup_object(write_ctx *ctx, const void *obj)
+{
+   struct hash_entry *entry = _mesa_hash_table_search(ctx->remap_table, obj);
+   assert(entry && "Failed to find object!");
+   return (uint32_t)(uintptr_t) entry->data;
+}
+
+static void
+write_object(write_ctx *ctx, const void *obj)
+{
+   blob_write_uint32(ctx->blob, write_lookup_object(ctx, obj));
+}
+
+static void
+read_add_object(read_ctx *ctx, void *obj)
+{
+   assert(ctx->next_idx < ctx->idx_table_len);
+   if (ctx->next_idx < ctx->idx_table_len)
+      ctx->idx_table[ctx->next_idx++] = obj;
+}
+
+static void *
+read_lookup_object(read_ctx *ctx, uint32_t idx)
+{
+   assert(idx < ctx->idx_table_len);
+   return idx < ctx->idx_table_len ? ctx->idx_table[idx] : NULL;
+}
+
+static void *
+read_object(read_ctx *ctx)
+{
+   return read_lookup_object(ctx, blob_read_uint32(ctx->blob));
+}
+
+/* Strings that may be NULL */
+static void
+write_name(write_ctx *ctx, const char *name)
+{
+   blob_write_uint32(ctx->blob, name != NULL);
+   if (name)
+      blob_write_string(ctx->blob, name);
+}
+
+static char *
+read_name(read_ctx *ctx, void *mem_ctx)
+{
+   if (!blob_read_uint32(ctx->blob))
+      return NULL;
+
+   const char *name = blob_read_string(ctx->blob);
+   return name ? ralloc_strdup(mem_ctx, name) : NULL;
+}
+
+static void
+write_constant(write_ctx *ctx, const nir_constant *c)
+{
+   blob_write_bytes(ctx->blob, &c->value, sizeof(c->value));
+   blob_write_uint32(ctx->blob, c->num_elements);
+   for (unsigned i = 0; i < c->num_elements; i++)
+      write_constant(ctx, c->elements[i]);
+}
+
+static nir_constant *
+read_constant(read_ctx *ctx, nir_variable *nvar)
+{
+   nir_constant *c = ralloc(nvar, nir_constant);
+
+   blob_copy_bytes(ctx->blob, (uint8_t *) &c->value, sizeof(c->value));
+   c->num_elements = blob_read_uint32(ctx->blob);
+   c->elements = ralloc_array(nvar, nir_constant *, c->num_elements);
+   for (unsigned i = 0; i < c->num_elements; i++)
+      c->elements[i] = read_constant(ctx, nvar);
+
+   return c;
+}
+
+static void
+write_variable(write_ctx *ctx, const nir_variable *var)
+{
+   write_add_object(ctx, var);
+   encode_type_to_blob(ctx->blob, var->type);
+   write_name(ctx, var->name);
+   blob_write_bytes(ctx->blob, &var->data, sizeof(var->data));
+   blob_write_uint32(ctx->blob, var->num_state_slots);
+   blob_write_bytes(ctx->blob, var->state_slots,
+                    var->num_state_slots * sizeof(nir_state_slot));
+   blob_write_uint32(ctx->blob, var->constant_initializer != NULL);
+   if (var->constant_initializer)
+      write_constant(ctx, var->constant_initializer);
+   encode_type_to_blob(ctx->blob, var->interface_type);
+}
+
+static nir_variable *
+read_variable(read_ctx *ctx)
+{
+   nir_variable *var = rzalloc(ctx->nir, nir_variable);
+   read_add_object(ctx, var);
+
+   var->type = decode_type_from_blob(ctx->blob);
+   var->name = read_name(ctx, var);
+   blob_copy_bytes(ctx->blob, (uint8_t *) &var->data, sizeof(var->data));
+   var->num_state_slots = blob_read_uint32(ctx->blob);
+   var->state_slots = ralloc_array(var, nir_state_slot, var->num_state_slots);
+   blob_copy_bytes(ctx->blob, (uint8_t *) var->state_slots,
+                   var->num_state_slots * sizeof(nir_state_slot));
+   if (blob_read_uint32(ctx->blob))
+      var->constant_initializer = read_constant(ctx, var);
+   var->interface_type = decode_type_from_blob(ctx->blob);
+
+   return var;
+}
+
+static void
+write_var_list(write_ctx *ctx, const struct exec_list *list)
+{
+   blob_write_uint32(ctx->blob, exec_list_length(list));
+   foreach_list_typed(nir_variable, var, node, list)
+      write_variable(ctx, var);
+}
+
+static void
+read_var_list(read_ctx *ctx, struct exec_list *dst)
+{
+   exec_list_make_empty(dst);
+   unsigned num_vars = blob_read_uint32(ctx->blob);
+   for (unsigned i = 0; i < num_vars; i++) {
+      nir_variable *var = read_variable(ctx);
+      exec_list_push_tail(dst, &var->node);
+   }
+}
+
+static void
+write_register(write_ctx *ctx, const nir_register *reg)
+{
+   write_add_object(ctx, reg);
+   blob_write_uint32(ctx->blob, reg->num_components);
+   blob_write_uint32(ctx->blob, reg->bit_size);
+   blob_write_uint32(ctx->blob, reg->num_array_elems);
+   blob_write_uint32(ctx->blob, reg->index);
+   write_name(ctx, reg->name);
+   blob_write_uint32(ctx->blob, reg->is_global << 1 | reg->is_packed);
+}
+
+static nir_register *
+read_register(read_ctx *ctx)
+{
+   nir_register *reg = rzalloc(ctx->nir, nir_register);
+   read_add_object(ctx, reg);
+
+   reg->num_components = blob_read_uint32(ctx->blob);
+   reg->bit_size = blob_read_uint32(ctx->blob);
+   reg->num_array_elems = blob_read_uint32(ctx->blob);
+   reg->index = blob_read_uint32(ctx->blob);
+   reg->name = read_name(ctx, reg);
+   unsigned flags = blob_read_uint32(ctx->blob);
+   reg->is_global = flags & 2;
+   reg->is_packed = flags & 1;
+
+   /* reconstructing uses/defs/if_uses handled by nir_instr_insert() */
+   list_inithead(&reg->uses);
+   list_inithead(&reg->defs);
+   list_inithead(&reg->if_uses);
+
+   return reg;
+}
+
+static void
+write_reg_list(write_ctx *ctx, const struct exec_list *list)
+{
+   blob_write_uint32(ctx->blob, exec_list_length(list));
+   foreach_list_typed(nir_register, reg, node, list)
+      write_register(ctx, reg);
+}
+
+static void
+read_reg_list(read_ctx *ctx, struct exec_list *dst)
+{
+   exec_list_make_empty(dst);
+   unsigned num_regs = blob_read_uint32(ctx->blob);
+   for (unsigned i = 0; i < num_regs; i++) {
+      nir_register *reg = read_register(ctx);
+      exec_list_push_tail(dst, &reg->node);
+   }
+}
+
+/* Sources and destinations start with a word holding an is_ssa bit:
+ *
+ *   SSA source:       index << 1 | 1
+ *   SSA destination:  bit_size << 8 | num_components << 2 | has_name << 1 | 1
+ *   register:         index << 2 | has_indirect << 1, then base_offset and
+ *                     the indirect source, if any
+ */
+static void write_src(write_ctx *ctx, const nir_src *src);
+
+static void
+write_reg_ref(write_ctx *ctx, const nir_register *reg,
+              const nir_src *indirect, unsigned base_offset)
+{
+   blob_write_uint32(ctx->blob, write_lookup_object(ctx, reg) << 2 |
+                                (indirect != NULL) << 1);
+   blob_write_uint32(ctx->blob, base_offset);
+   if (indirect)
+      write_src(ctx, indirect);
+}
+
+static void
+write_src(write_ctx *ctx, const nir_src *src)
+{
+   if (src->is_ssa) {
+      blob_write_uint32(ctx->blob, write_lookup_object(ctx, src->ssa) << 1 | 1);
+   } else {
+      write_reg_ref(ctx, src->reg.reg, src->reg.indirect,
+                    src->reg.base_offset);
+   }
+}
+
+static void read_src(read_ctx *ctx, nir_src *src, void *mem_ctx);
+
+static void
+read_reg_ref(read_ctx *ctx, uint32_t val, nir_register **reg,
+             nir_src **indirect, unsigned *base_offset, void *mem_ctx)
+{
+   *reg = read_lookup_object(ctx, val >> 2);
+   *base_offset = blob_read_uint32(ctx->blob);
+   if (val & 2) {
+      *indirect = ralloc(mem_ctx, nir_src);
+      read_src(ctx, *indirect, mem_ctx);
+   } else {
+      *indirect = NULL;
+   }
+}
+
+static void
+read_src(read_ctx *ctx, nir_src *src, void *mem_ctx)
+{
+   uint32_t val = blob_read_uint32(ctx->blob);
+
+   src->is_ssa = val & 1;
+   if (src->is_ssa) {
+      src->ssa = read_lookup_object(ctx, val >> 1);
+   } else {
+      read_reg_ref(ctx, val, &src->reg.reg, &src->reg.indirect,
+                   &src->reg.base_offset, mem_ctx);
+   }
+}
+
+static void
+write_dest(write_ctx *ctx, const nir_dest *dst)
+{
+   if (dst->is_ssa) {
+      blob_write_uint32(ctx->blob, dst->ssa.bit_size << 8 |
+                                   dst->ssa.num_components << 2 |
+                                   (dst->ssa.name != NULL) << 1 | 1);
+      if (dst->ssa.name)
+         blob_write_string(ctx->blob, dst->ssa.name);
+   } else {
+      write_reg_ref(ctx, dst->reg.reg, dst->reg.indirect,
+                    dst->reg.base_offset);
+   }
+}
+
+static void
+read_dest(read_ctx *ctx, nir_dest *dst, nir_instr *instr)
+{
+   uint32_t val = blob_read_uint32(ctx->blob);
+
+   dst->is_ssa = val & 1;
+   if (dst->is_ssa) {
+      const char *name = (val & 2) ? blob_read_string(ctx->blob) : NULL;
+      nir_ssa_dest_init(instr, dst, (val >> 2) & 0x3f, val >> 8, name);
+      read_add_object(ctx, &dst->ssa);
+   } else {
+      read_reg_ref(ctx, val, &dst->reg.reg, &dst->reg.indirect,
+                   &dst->reg.base_offset, instr);
+   }
+}
+
+static void
+write_deref_chain(write_ctx *ctx, const nir_deref_var *deref_var)
+{
+   write_object(ctx, deref_var->var);
+
+   uint32_t len = 0;
+   for (const nir_deref *d = deref_var->deref.child; d; d = d->child)
+      len++;
+   blob_write_uint32(ctx->blob, len);
+
+   for (const nir_deref *d = deref_var->deref.child; d; d = d->child) {
+      encode_type_to_blob(ctx->blob, d->type);
+
+      switch (d->deref_type) {
+      case nir_deref_type_array: {
+         const nir_deref_array *deref_array = nir_deref_as_array(d);
+         blob_write_uint32(ctx->blob, deref_array->deref_array_type << 4 |
+                                      d->deref_type);
+         blob_write_uint32(ctx->blob, deref_array->base_offset);
+         if (deref_array->deref_array_type == nir_deref_array_type_indirect)
+            write_src(ctx, &deref_array->indirect);
+         break;
+      }
+      case nir_deref_type_struct:
+         blob_write_uint32(ctx->blob, d->deref_type);
+         blob_write_uint32(ctx->blob, nir_deref_as_struct(d)->index);
+         break;
+      default:
+         unreachable("bad deref type");
+      }
+   }
+}
+
+static nir_deref_var *
+read_deref_chain(read_ctx *ctx, nir_instr *instr)
+{
+   nir_variable *var = read_object(ctx);
+   nir_deref_var *deref_var = nir_deref_var_create(instr, var);
+
+   uint32_t len = blob_read_uint32(ctx->blob);
+
+   nir_deref *tail = &deref_var->deref;
+   for (uint32_t i = 0; i < len; i++) {
+      const struct glsl_type *type = decode_type_from_blob(ctx->blob);
+      uint32_t val = blob_read_uint32(ctx->blob);
+
+      switch ((nir_deref_type) (val & 0xf)) {
+      case nir_deref_type_array: {
+         nir_deref_array *deref_array = nir_deref_array_create(tail);
+         deref_array->deref_array_type = val >> 4;
+         deref_array->base_offset = blob_read_uint32(ctx->blob);
+         if (deref_array->deref_array_type == nir_deref_array_type_indirect)
+            read_src(ctx, &deref_array->indirect, instr);
+         tail->child = &deref_array->deref;
+         break;
+      }
+      case nir_deref_type_struct:
+         tail->child =
+            &nir_deref_struct_create(tail, blob_read_uint32(ctx->blob))->deref;
+         break;
+      default:
+         unreachable("bad deref type");
+      }
+
+      tail = tail->child;
+      tail->type = type;
+   }
+
+   return deref_var;
+}
+
+static void
+write_alu(write_ctx *ctx, const nir_alu_instr *alu)
+{
+   blob_write_uint32(ctx->blob, alu->dest.write_mask << 18 |
+                                alu->dest.saturate << 17 |
+                                alu->exact << 16 | alu->op);
+   write_dest(ctx, &alu->dest.dest);
+
+   for (unsigned i = 0; i < nir_op_infos[alu->op].num_inputs; i++) {
+      const nir_alu_src *src = &alu->src[i];
+
+      write_src(ctx, &src->src);
+      blob_write_uint32(ctx->blob, src->swizzle[3] << 8 |
+                                   src->swizzle[2] << 6 |
+                                   src->swizzle[1] << 4 |
+                                   src->swizzle[0] << 2 |
+                                   src->abs << 1 | src->negate);
+   }
+}
+
+static nir_alu_instr *
+read_alu(read_ctx *ctx)
+{
+   uint32_t val = blob_read_uint32(ctx->blob);
+   nir_alu_instr *alu = nir_alu_instr_create(ctx->nir, val & 0xffff);
+
+   alu->exact = (val >> 16) & 1;
+   alu->dest.saturate = (val >> 17) & 1;
+   alu->dest.write_mask = val >> 18;
+   read_dest(ctx, &alu->dest.dest, &alu->instr);
+
+   for (unsigned i = 0; i < nir_op_infos[alu->op].num_inputs; i++) {
+      nir_alu_src *src = &alu->src[i];
+
+      read_src(ctx, &src->src, &alu->instr);
+      uint32_t packed = blob_read_uint32(ctx->blob);
+      src->negate = packed & 1;
+      src->abs = (packed >> 1) & 1;
+      for (unsigned c = 0; c < 4; c++)
+         src->swizzle[c] = (packed >> (2 + 2 * c)) & 3;
+   }
+
+   return alu;
+}
+
+static void
+write_intrinsic(write_ctx *ctx, const nir_intrinsic_instr *intrin)
+{
+   const nir_intrinsic_info *info = &nir_intrinsic_infos[intrin->intrinsic];
+
+   blob_write_uint32(ctx->blob, intrin->num_components << 16 |
+                                intrin->intrinsic);
+
+   if (info->has_dest)
+      write_dest(ctx, &intrin->dest);
+
+   for (unsigned i = 0; i < info->num_indices; i++)
+      blob_write_uint32(ctx->blob, intrin->const_index[i]);
+
+   for (unsigned i = 0; i < info->num_variables; i++)
+      write_deref_chain(ctx, intrin->variables[i]);
+
+   for (unsigned i = 0; i < info->num_srcs; i++)
+      write_src(ctx, &intrin->src[i]);
+}
+
+static nir_intrinsic_instr *
+read_intrinsic(read_ctx *ctx)
+{
+   uint32_t val = blob_read_uint32(ctx->blob);
+   nir_intrinsic_instr *intrin =
+      nir_intrinsic_instr_create(ctx->nir, val & 0xffff);
+   const nir_intrinsic_info *info = &nir_intrinsic_infos[intrin->intrinsic];
+
+   intrin->num_components = val >> 16;
+
+   if (info->has_dest)
+      read_dest(ctx, &intrin->dest, &intrin->instr);
+
+   for (unsigned i = 0; i < info->num_indices; i++)
+      intrin->const_index[i] = blob_read_uint32(ctx->blob);
+
+   for (unsigned i = 0; i < info->num_variables; i++)
+      intrin->variables[i] = read_deref_chain(ctx, &intrin->instr);
+
+   for (unsigned i = 0; i < info->num_srcs; i++)
+      read_src(ctx, &intrin->src[i], &intrin->instr);
+
+   return intrin;
+}
+
+static unsigned
+const_value_size(const nir_ssa_def *def)
+{
+   return def->num_components *
+          (def->bit_size == 64 ? sizeof(uint64_t) : sizeof(uint32_t));
+}
+
+static void
+write_load_const(write_ctx *ctx, const nir_load_const_instr *lc)
+{
+   blob_write_uint32(ctx->blob, lc->def.bit_size << 8 |
+                                lc->def.num_components);
+   blob_write_bytes(ctx->blob, &lc->value, const_value_size(&lc->def));
+}
+
+static nir_load_const_instr *
+read_load_const(read_ctx *ctx)
+{
+   uint32_t val = blob_read_uint32(ctx->blob);
+   nir_load_const_instr *lc =
+      nir_load_const_instr_create(ctx->nir, val & 0xff, val >> 8);
+
+   blob_copy_bytes(ctx->blob, (uint8_t *) &lc->value,
+                   const_value_size(&lc->def));
+   read_add_object(ctx, &lc->def);
+
+   return lc;
+}
+
+static void
+write_ssa_undef(write_ctx *ctx, const nir_ssa_undef_instr *undef)
+{
+   blob_write_uint32(ctx->blob, undef->def.bit_size << 8 |
+                                undef->def.num_components);
+}
+
+static nir_ssa_undef_instr *
+read_ssa_undef(read_ctx *ctx)
+{
+   uint32_t val = blob_read_uint32(ctx->blob);
+   nir_ssa_undef_instr *undef =
+      nir_ssa_undef_instr_create(ctx->nir, val & 0xff, val >> 8);
+
+   read_add_object(ctx, &undef->def);
+
+   return undef;
+}
+
+union packed_tex_data {
+   uint32_t u32;
+   struct {
+      unsigned sampler_dim:4;
+      unsigned dest_type:8;
+      unsigned op:4;
+      unsigned coord_components:3;
+      unsigned is_array:1;
+      unsigned is_shadow:1;
+      unsigned is_new_style_shadow:1;
+      unsigned component:2;
+      unsigned has_texture_deref:1;
+      unsigned has_sampler_deref:1;
+      unsigned unused:6;
+   } u;
+};
+
+static void
+write_tex(write_ctx *ctx, const nir_tex_instr *tex)
+{
+   STATIC_ASSERT(sizeof(union packed_tex_data) == sizeof(uint32_t));
+   union packed_tex_data packed = {
+      .u.sampler_dim = tex->sampler_dim,
+      .u.dest_type = tex->dest_type,
+      .u.op = tex->op,
+      .u.coord_components = tex->coord_components,
+      .u.is_array = tex->is_array,
+      .u.is_shadow = tex->is_shadow,
+      .u.is_new_style_shadow = tex->is_new_style_shadow,
+      .u.component = tex->component,
+      .u.has_texture_deref = tex->texture != NULL,
+      .u.has_sampler_deref = tex->sampler != NULL,
+   };
+
+   blob_write_uint32(ctx->blob, tex->num_srcs);
+   blob_write_uint32(ctx->blob, packed.u32);
+   blob_write_uint32(ctx->blob, tex->texture_index);
+   blob_write_uint32(ctx->blob, tex->texture_array_size);
+   blob_write_uint32(ctx->blob, tex->sampler_index);
+
+   write_dest(ctx, &tex->dest);
+   for (unsigned i = 0; i < tex->num_srcs; i++) {
+      blob_write_uint32(ctx->blob, tex->src[i].src_type);
+      write_src(ctx, &tex->src[i].src);
+   }
+
+   if (tex->texture)
+      write_deref_chain(ctx, tex->texture);
+   if (tex->sampler)
+      write_deref_chain(ctx, tex->sampler);
+}
+
+static nir_tex_instr *
+read_tex(read_ctx *ctx)
+{
+   unsigned num_srcs = blob_read_uint32(ctx->blob);
+   nir_tex_instr *tex = nir_tex_instr_create(ctx->nir, num_srcs);
+
+   union packed_tex_data packed;
+   packed.u32 = blob_read_uint32(ctx->blob);
+   tex->sampler_dim = packed.u.sampler_dim;
+   tex->dest_type = packed.u.dest_type;
+   tex->op = packed.u.op;
+   tex->coord_components = packed.u.coord_components;
+   tex->is_array = packed.u.is_array;
+   tex->is_shadow = packed.u.is_shadow;
+   tex->is_new_style_shadow = packed.u.is_new_style_shadow;
+   tex->component = packed.u.component;
+
+   tex->texture_index = blob_read_uint32(ctx->blob);
+   tex->texture_array_size = blob_read_uint32(ctx->blob);
+   tex->sampler_index = blob_read_uint32(ctx->blob);
+
+   read_dest(ctx, &tex->dest, &tex->instr);
+   for (unsigned i = 0; i < tex->num_srcs; i++) {
+      tex->src[i].src_type = blob_read_uint32(ctx->blob);
+      read_src(ctx, &tex->src[i].src, &tex->instr);
+   }
+
+   tex->texture = packed.u.has_texture_deref ?
+                  read_deref_chain(ctx, &tex->instr) : NULL;
+   tex->sampler = packed.u.has_sampler_deref ?
+                  read_deref_chain(ctx, &tex->instr) : NULL;
+
+   return tex;
+}
+
+static void
+write_phi(write_ctx *ctx, const nir_phi_instr *phi)
+{
+   write_dest(ctx, &phi->dest);
+
+   blob_write_uint32(ctx->blob, exec_list_length(&phi->srcs));
+   nir_foreach_phi_src(src, phi) {
+      assert(src->src.is_ssa);
+      write_object(ctx, src->pred);
+      write_object(ctx, src->src.ssa);
+   }
+}
+
+static void
+read_phi(read_ctx *ctx, nir_block *blk)
+{
+   nir_phi_instr *phi = nir_phi_instr_create(ctx->nir);
+
+   read_dest(ctx, &phi->dest, &phi->instr);
+
+   /* As in clone_phi(), the sources may refer to blocks and SSA values that
+    * don't exist yet.  Store their indices for now, and insert the phi
+    * before the sources are set up so that nir_instr_insert() doesn't try
+    * to add them to use lists.
+    */
+   nir_instr_insert_after_block(blk, &phi->instr);
+
+   unsigned num_srcs = blob_read_uint32(ctx->blob);
+   for (unsigned i = 0; i < num_srcs; i++) {
+      nir_phi_src *src = ralloc(phi, nir_phi_src);
+
+      src->pred = (nir_block *)(uintptr_t) blob_read_uint32(ctx->blob);
+      src->src.is_ssa = true;
+      src->src.ssa = (nir_ssa_def *)(uintptr_t) blob_read_uint32(ctx->blob);
+      src->src.parent_instr = &phi->instr;
+
+      /* Stash it in the list of phi sources.  We'll walk this list and fix up
+       * sources at the very end of read_function_impl.
+       */
+      list_add(&src->src.use_link, &ctx->phi_srcs);
+
+      exec_list_push_tail(&phi->srcs, &src->node);
+   }
+}
+
+static void
+write_jump(write_ctx *ctx, const nir_jump_instr *jmp)
+{
+   blob_write_uint32(ctx->blob, jmp->type);
+}
+
+static nir_jump_instr *
+read_jump(read_ctx *ctx)
+{
+   nir_jump_type type = blob_read_uint32(ctx->blob);
+   return nir_jump_instr_create(ctx->nir, type);
+}
+
+static void
+write_call(write_ctx *ctx, const nir_call_instr *call)
+{
+   write_object(ctx, call->callee);
+
+   for (unsigned i = 0; i < call->num_params; i++)
+      write_deref_chain(ctx, call->params[i]);
+
+   blob_write_uint32(ctx->blob, call->return_deref != NULL);
+   if (call->return_deref)
+      write_deref_chain(ctx, call->return_deref);
+}
+
+static nir_call_instr *
+read_call(read_ctx *ctx)
+{
+   nir_function *callee = read_object(ctx);
+   nir_call_instr *call = nir_call_instr_create(ctx->nir, callee);
+
+   for (unsigned i = 0; i < call->num_params; i++)
+      call->params[i] = read_deref_chain(ctx, &call->instr);
+
+   if (blob_read_uint32(ctx->blob))
+      call->return_deref = read_deref_chain(ctx, &call->instr);
+
+   return call;
+}
+
+static void
+write_instr(write_ctx *ctx, const nir_instr *instr)
+{
+   blob_write_uint32(ctx->blob, instr->type);
+   switch (instr->type) {
+   case nir_instr_type_alu:
+      write_alu(ctx, nir_instr_as_alu(instr));
+      break;
+   case nir_instr_type_intrinsic:
+      write_intrinsic(ctx, nir_instr_as_intrinsic(instr));
+      break;
+   case nir_instr_type_load_const:
+      write_load_const(ctx, nir_instr_as_load_const(instr));
+      break;
+   case nir_instr_type_ssa_undef:
+      write_ssa_undef(ctx, nir_instr_as_ssa_undef(instr));
+      break;
+   case nir_instr_type_tex:
+      write_tex(ctx, nir_instr_as_tex(instr));
+      break;
+   case nir_instr_type_phi:
+      write_phi(ctx, nir_instr_as_phi(instr));
+      break;
+   case nir_instr_type_jump:
+      write_jump(ctx, nir_instr_as_jump(instr));
+      break;
+   case nir_instr_type_call:
+      write_call(ctx, nir_instr_as_call(instr));
+      break;
+   case nir_instr_type_parallel_copy:
+      unreachable("Cannot write parallel copies");
+   default:
+      unreachable("bad instr type");
+   }
+}
+
+static void
+read_instr(read_ctx *ctx, nir_block *block)
+{
+   nir_instr_type type = blob_read_uint32(ctx->blob);
+   nir_instr *instr;
+
+   switch (type) {
+   case nir_instr_type_alu:
+      instr = &read_alu(ctx)->instr;
+      break;
+   case nir_instr_type_intrinsic:
+      instr = &read_intrinsic(ctx)->instr;
+      break;
+   case nir_instr_type_load_const:
+      instr = &read_load_const(ctx)->instr;
+      break;
+   case nir_instr_type_ssa_undef:
+      instr = &read_ssa_undef(ctx)->instr;
+      break;
+   case nir_instr_type_tex:
+      instr = &read_tex(ctx)->instr;
+      break;
+   case nir_instr_type_phi:
+      /* Phi instructions insert themselves; see read_phi(). */
+      read_phi(ctx, block);
+      return;
+   case nir_instr_type_jump:
+      instr = &read_jump(ctx)->instr;
+      break;
+   case nir_instr_type_call:
+      instr = &read_call(ctx)->instr;
+      break;
+   case nir_instr_type_parallel_copy:
+      unreachable("Cannot read parallel copies");
+   default:
+      unreachable("bad instr type");
+   }
+
+   nir_instr_insert_after_block(block, instr);
+}
+
+static void
+write_block(write_ctx *ctx, const nir_block *block)
+{
+   blob_write_uint32(ctx->blob, exec_list_length(&block->instr_list));
+   nir_foreach_instr(instr, block)
+      write_instr(ctx, instr);
+}
+
+static void
+read_block(read_ctx *ctx, struct exec_list *cf_list)
+{
+   /* Don't actually create a new block.  Just use the one from the tail of
+    * the list.  NIR guarantees that the tail of the list is a block and that
+    * no two blocks are side-by-side in the IR;  It should be empty.
+    */
+   nir_block *block =
+      exec_node_data(nir_block, exec_list_get_tail(cf_list), cf_node.node);
+   assert(block->cf_node.type == nir_cf_node_block);
+   assert(exec_list_is_empty(&block->instr_list));
+
+   read_add_object(ctx, block);
+
+   unsigned num_instrs = blob_read_uint32(ctx->blob);
+   for (unsigned i = 0; i < num_instrs; i++)
+      read_instr(ctx, block);
+}
+
+static void write_cf_list(write_ctx *ctx, const struct exec_list *cf_list);
+static void read_cf_list(read_ctx *ctx, struct exec_list *cf_list);
+
+static void
+write_if(write_ctx *ctx, const nir_if *nif)
+{
+   write_src(ctx, &nif->condition);
+   write_cf_list(ctx, &nif->then_list);
+   write_cf_list(ctx, &nif->else_list);
+}
+
+static void
+read_if(read_ctx *ctx, struct exec_list *cf_list)
+{
+   nir_if *nif = nir_if_create(ctx->nir);
+
+   read_src(ctx, &nif->condition, nif);
+
+   nir_cf_node_insert_end(cf_list, &nif->cf_node);
+
+   read_cf_list(ctx, &nif->then_list);
+   read_cf_list(ctx, &nif->else_list);
+}
+
+static void
+write_loop(write_ctx *ctx, const nir_loop *loop)
+{
+   write_cf_list(ctx, &loop->body);
+}
+
+static void
+read_loop(read_ctx *ctx, struct exec_list *cf_list)
+{
+   nir_loop *loop = nir_loop_create(ctx->nir);
+
+   nir_cf_node_insert_end(cf_list, &loop->cf_node);
+
+   read_cf_list(ctx, &loop->body);
+}
+
+static void
+write_cf_node(write_ctx *ctx, const nir_cf_node *cf)
+{
+   blob_write_uint32(ctx->blob, cf->type);
+
+   switch (cf->type) {
+   case nir_cf_node_block:
+      write_block(ctx, nir_cf_node_as_block(cf));
+      break;
+   case nir_cf_node_if:
+      write_if(ctx, nir_cf_node_as_if(cf));
+      break;
+   case nir_cf_node_loop:
+      write_loop(ctx, nir_cf_node_as_loop(cf));
+      break;
+   default:
+      unreachable("bad cf type");
+   }
+}
+
+static void
+read_cf_node(read_ctx *ctx, struct exec_list *cf_list)
+{
+   nir_cf_node_type type = blob_read_uint32(ctx->blob);
+
+   switch (type) {
+   case nir_cf_node_block:
+      read_block(ctx, cf_list);
+      break;
+   case nir_cf_node_if:
+      read_if(ctx, cf_list);
+      break;
+   case nir_cf_node_loop:
+      read_loop(ctx, cf_list);
+      break;
+   default:
+      unreachable("bad cf type");
+   }
+}
+
+static void
+write_cf_list(write_ctx *ctx, const struct exec_list *cf_list)
+{
+   blob_write_uint32(ctx->blob, exec_list_length(cf_list));
+   foreach_list_typed(nir_cf_node, cf, node, cf_list)
+      write_cf_node(ctx, cf);
+}
+
+static void
+read_cf_list(read_ctx *ctx, struct exec_list *cf_list)
+{
+   uint32_t num_cf_nodes = blob_read_uint32(ctx->blob);
+   for (unsigned i = 0; i < num_cf_nodes; i++)
+      read_cf_node(ctx, cf_list);
+}
+
+static bool
+add_ssa_def_cb(nir_ssa_def *def, void *state)
+{
+   write_add_object(state, def);
+   return true;
+}
+
+static void
+write_function_impl(write_ctx *ctx, const nir_function_impl *fi)
+{
+   write_var_list(ctx, &fi->locals);
+   write_reg_list(ctx, &fi->registers);
+   blob_write_uint32(ctx->blob, fi->reg_alloc);
+
+   blob_write_uint32(ctx->blob, fi->num_params);
+   for (unsigned i = 0; i < fi->num_params; i++)
+      write_variable(ctx, fi->params[i]);
+
+   blob_write_uint32(ctx->blob, fi->return_var != NULL);
+   if (fi->return_var)
+      write_variable(ctx, fi->return_var);
+
+   /* Number the blocks and SSA values in the order the reader creates
+    * them, so that phi sources can refer to ones that are defined later.
+    */
+   nir_foreach_block(block, (nir_function_impl *) fi) {
+      write_add_object(ctx, block);
+      nir_foreach_instr(instr, block)
+         nir_foreach_ssa_def(instr, add_ssa_def_cb, ctx);
+   }
+
+   write_cf_list(ctx, &fi->body);
+}
+
+static nir_function_impl *
+read_function_impl(read_ctx *ctx, nir_function *fxn)
+{
+   nir_function_impl *fi = nir_function_impl_create_bare(ctx->nir);
+   fi->function = fxn;
+
+   read_var_list(ctx, &fi->locals);
+   read_reg_list(ctx, &fi->registers);
+   fi->reg_alloc = blob_read_uint32(ctx->blob);
+
+   fi->num_params = blob_read_uint32(ctx->blob);
+   fi->params = ralloc_array(ctx->nir, nir_variable *, fi->num_params);
+   for (unsigned i = 0; i < fi->num_params; i++)
+      fi->params[i] = read_variable(ctx);
+
+   if (blob_read_uint32(ctx->blob))
+      fi->return_var = read_variable(ctx);
+
+   assert(list_empty(&ctx->phi_srcs));
+
+   read_cf_list(ctx, &fi->body);
+
+   /* Now that every block and SSA value exists, fix up the phi sources and
+    * put them in the use lists of their SSA values.
+    */
+   list_for_each_entry_safe(nir_phi_src, src, &ctx->phi_srcs, src.use_link) {
+      src->pred = read_lookup_object(ctx, (uintptr_t) src->pred);
+      src->src.ssa = read_lookup_object(ctx, (uintptr_t) src->src.ssa);
+
+      list_del(&src->src.use_link);
+      list_addtail(&src->src.use_link, &src->src.ssa->uses);
+   }
+   assert(list_empty(&ctx->phi_srcs));
+
+   fi->valid_metadata = 0;
+
+   return fi;
+}
+
+static void
+write_function(write_ctx *ctx, const nir_function *fxn)
+{
+   write_add_object(ctx, fxn);
+
+   write_name(ctx, fxn->name);
+
+   blob_write_uint32(ctx->blob, fxn->num_params);
+   for (unsigned i = 0; i < fxn->num_params; i++) {
+      blob_write_uint32(ctx->blob, fxn->params[i].param_type);
+      encode_type_to_blob(ctx->blob, fxn->params[i].type);
+   }
+
+   encode_type_to_blob(ctx->blob, fxn->return_type);
+
+   /* The impls are written in a second pass, so that call instructions can
+    * refer to any function.
+    */
+}
+
+static void
+read_function(read_ctx *ctx)
+{
+   const char *name = NULL;
+   if (blob_read_uint32(ctx->blob))
+      name = blob_read_string(ctx->blob);
+
+   nir_function *fxn = nir_function_create(ctx->nir, name);
+   read_add_object(ctx, fxn);
+
+   fxn->num_params = blob_read_uint32(ctx->blob);
+   fxn->params = ralloc_array(fxn, nir_parameter, fxn->num_params);
+   for (unsigned i = 0; i < fxn->num_params; i++) {
+      fxn->params[i].param_type = blob_read_uint32(ctx->blob);
+      fxn->params[i].type = decode_type_from_blob(ctx->blob);
+   }
+
+   fxn->return_type = decode_type_from_blob(ctx->blob);
+}
+
+void
+nir_serialize(struct blob *blob, const nir_shader *nir)
+{
+   write_ctx ctx;
+   ctx.blob = blob;
+   ctx.remap_table = _mesa_hash_table_create(NULL, _mesa_hash_pointer,
+                                             _mesa_key_pointer_equal);
+   ctx.next_idx = 0;
+
+   /* The number of objects, so the reader can size its table up front */
+   size_t idx_size_offset = blob->size;
+   blob_write_uint32(blob, 0);
+
+   blob_write_uint32(blob, nir->stage);
+
+   /* Leave the name pointers out of the blob, so the same shader always
+    * serializes to the same bytes.
+    */
+   nir_shader_info info;
+   memcpy(&info, &nir->info, sizeof(info));
+   info.name = NULL;
+   info.label = NULL;
+   blob_write_bytes(blob, &info, sizeof(info));
+   write_name(&ctx, nir->info.name);
+   write_name(&ctx, nir->info.label);
+
+   write_var_list(&ctx, &nir->uniforms);
+   write_var_list(&ctx, &nir->inputs);
+   write_var_list(&ctx, &nir->outputs);
+   write_var_list(&ctx, &nir->shared);
+   write_var_list(&ctx, &nir->globals);
+   write_var_list(&ctx, &nir->system_values);
+
+   write_reg_list(&ctx, &nir->registers);
+   blob_write_uint32(blob, nir->reg_alloc);
+
+   blob_write_uint32(blob, exec_list_length(&nir->functions));
+   nir_foreach_function(fxn, nir)
+      write_function(&ctx, fxn);
+
+   nir_foreach_function(fxn, nir) {
+      blob_write_uint32(blob, fxn->impl != NULL);
+      if (fxn->impl)
+         write_function_impl(&ctx, fxn->impl);
+   }
+
+   blob_write_uint32(blob, nir->num_inputs);
+   blob_write_uint32(blob, nir->num_uniforms);
+   blob_write_uint32(blob, nir->num_outputs);
+   blob_write_uint32(blob, nir->num_shared);
+
+   blob_overwrite_uint32(blob, idx_size_offset, ctx.next_idx);
+
+   _mesa_hash_table_destroy(ctx.remap_table, NULL);
+}
+
+nir_shader *
+nir_deserialize(void *mem_ctx,
+                const struct nir_shader_compiler_options *options,
+                struct blob_reader *blob)
+{
+   read_ctx ctx;
+   ctx.blob = blob;
+   list_inithead(&ctx.phi_srcs);
+   ctx.idx_table_len = blob_read_uint32(blob);
+   ctx.idx_table = calloc(ctx.idx_table_len, sizeof(void *));
+   ctx.next_idx = 0;
+
+   if (ctx.idx_table_len && !ctx.idx_table)
+      return NULL;
+
+   gl_shader_stage stage = blob_read_uint32(blob);
+   ctx.nir = nir_shader_create(mem_ctx, stage, options);
+
+   blob_copy_bytes(blob, (uint8_t *) &ctx.nir->info, sizeof(ctx.nir->info));
+   ctx.nir->info.name = read_name(&ctx, ctx.nir);
+   ctx.nir->info.label = read_name(&ctx, ctx.nir);
+
+   read_var_list(&ctx, &ctx.nir->uniforms);
+   read_var_list(&ctx, &ctx.nir->inputs);
+   read_var_list(&ctx, &ctx.nir->outputs);
+   read_var_list(&ctx, &ctx.nir->shared);
+   read_var_list(&ctx, &ctx.nir->globals);
+   read_var_list(&ctx, &ctx.nir->system_values);
+
+   read_reg_list(&ctx, &ctx.nir->registers);
+   ctx.nir->reg_alloc = blob_read_uint32(blob);
+
+   unsigned num_functions = blob_read_uint32(blob);
+   for (unsigned i = 0; i < num_functions; i++)
+      read_function(&ctx);
+
+   nir_foreach_function(fxn, ctx.nir) {
+      if (blob_read_uint32(blob))
+         fxn->impl = read_function_impl(&ctx, fxn);
+   }
+
+   ctx.nir->num_inputs = blob_read_uint32(blob);
+   ctx.nir->num_uniforms = blob_read_uint32(blob);
+   ctx.nir->num_outputs = blob_read_uint32(blob);
+   ctx.nir->num_shared = blob_read_uint32(blob);
+
+   free(ctx.idx_table);
+
+   if (blob->overrun) {
+      ralloc_free(ctx.nir);
+      return NULL;
+   }
+
+   return ctx.nir;
+}
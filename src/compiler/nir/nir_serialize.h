@@ -0,0 +1,59 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "nir.h"
+#include "compiler/glsl/blob.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Binary serialization of NIR shaders
+ *
+ * nir_serialize() writes a shader to a blob in a compact form: variables,
+ * registers, blocks, functions and SSA values are referred to by index
+ * rather than by pointer, and small per-instruction fields are packed
+ * together.  nir_deserialize() rebuilds an equivalent shader from it; like
+ * nir_shader_clone(), all metadata of the new shader is invalid.
+ *
+ * The format depends on the build of Mesa (opcode numbers, struct layouts,
+ * ...), so a serialized shader should only be stored together with the
+ * build it came from, as the disk cache does.  The shader may not contain
+ * parallel copies.
+ */
+void nir_serialize(struct blob *blob, const nir_shader *nir);
+
+/** Reads a shader written by nir_serialize()
+ *
+ * \return  the new shader, allocated out of \p mem_ctx, or NULL if the blob
+ *          was truncated.
+ */
+nir_shader *nir_deserialize(void *mem_ctx,
+                            const struct nir_shader_compiler_options *options,
+                            struct blob_reader *blob);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
@@ -0,0 +1,357 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Measures the time spent in nir_opt_algebraic and nir_opt_algebraic_late
+ * over a corpus of shaders.
+ *
+ *    algebraic_bench [-n iterations] [-p] [shader...]
+ *
+ * The shaders are files written by nir_serialize().  Without any, a fixed
+ * synthetic corpus of random ALU expression graphs is used.  Each shader is
+ * run through nir_opt_algebraic, copy propagation, constant folding and dead
+ * code elimination until it stops changing, then through
+ * nir_opt_algebraic_late, and only the algebraic passes are timed.  -p prints the optimized shaders, so that
+ * changes to the pass can be checked for differences in the results.
+ */
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "nir.h"
+#include "nir_builder.h"
+#include "nir_serialize.h"
+
+typedef std::chrono::steady_clock bench_clock;
+
+static nir_shader_compiler_options options;
+
+namespace {
+
+/* A small PRNG, so that the synthetic corpus is the same everywhere. */
+struct random_source {
+   uint32_t state;
+
+   unsigned next(unsigned n)
+   {
+      state ^= state << 13;
+      state ^= state >> 17;
+      state ^= state << 5;
+      return state % n;
+   }
+};
+
+struct corpus_builder {
+   nir_builder b;
+   random_source rand;
+   std::vector<nir_ssa_def *> floats, ints, bools;
+
+   nir_ssa_def *pick(std::vector<nir_ssa_def *> &values,
+                     nir_ssa_def *(*imm)(nir_builder *, unsigned));
+   nir_ssa_def *pick_float();
+   nir_ssa_def *pick_int();
+   nir_ssa_def *pick_bool();
+   void add_instr();
+};
+
+static nir_ssa_def *
+float_imm(nir_builder *b, unsigned i)
+{
+   static const float values[] = { 0.0, 1.0, -1.0, 2.0, 0.5 };
+   return nir_imm_float(b, values[i % ARRAY_SIZE(values)]);
+}
+
+static nir_ssa_def *
+int_imm(nir_builder *b, unsigned i)
+{
+   static const int values[] = { 0, 1, -1, 2, 8, 0xff };
+   return nir_imm_int(b, values[i % ARRAY_SIZE(values)]);
+}
+
+/* Picks a recent value most of the time, for deep expressions, and a
+ * constant now and then.
+ */
+nir_ssa_def *
+corpus_builder::pick(std::vector<nir_ssa_def *> &values,
+                     nir_ssa_def *(*imm)(nir_builder *, unsigned))
+{
+   if (values.empty() || rand.next(4) == 0)
+      return imm(&b, rand.next(16));
+
+   unsigned window = MIN2(values.size(), 16);
+   return values[values.size() - 1 - rand.next(window)];
+}
+
+nir_ssa_def *
+corpus_builder::pick_float()
+{
+   return pick(floats, float_imm);
+}
+
+nir_ssa_def *
+corpus_builder::pick_int()
+{
+   return pick(ints, int_imm);
+}
+
+nir_ssa_def *
+corpus_builder::pick_bool()
+{
+   if (bools.empty())
+      return nir_flt(&b, pick_float(), pick_float());
+
+   return bools[bools.size() - 1 - rand.next(MIN2(bools.size(), 8))];
+}
+
+void
+corpus_builder::add_instr()
+{
+   static const nir_op float_unops[] = {
+      nir_op_fneg, nir_op_fabs, nir_op_fsat, nir_op_frcp, nir_op_fsqrt,
+      nir_op_frsq, nir_op_ffloor, nir_op_ffract, nir_op_fexp2, nir_op_flog2,
+   };
+   static const nir_op float_binops[] = {
+      nir_op_fadd, nir_op_fsub, nir_op_fmul, nir_op_fdiv, nir_op_fmin,
+      nir_op_fmax, nir_op_fpow,
+   };
+   static const nir_op int_binops[] = {
+      nir_op_iadd, nir_op_isub, nir_op_imul, nir_op_iand, nir_op_ior,
+      nir_op_ixor, nir_op_ishl, nir_op_ishr, nir_op_ushr, nir_op_imin,
+      nir_op_imax,
+   };
+   static const nir_op compares[] = {
+      nir_op_flt, nir_op_fge, nir_op_feq, nir_op_fne,
+   };
+
+   switch (rand.next(12)) {
+   case 0: case 1: case 2:
+      floats.push_back(nir_build_alu(&b, float_unops[rand.next(ARRAY_SIZE(float_unops))],
+                                     pick_float(), NULL, NULL, NULL));
+      break;
+   case 3: case 4: case 5: case 6:
+      floats.push_back(nir_build_alu(&b, float_binops[rand.next(ARRAY_SIZE(float_binops))],
+                                     pick_float(), pick_float(), NULL, NULL));
+      break;
+   case 7:
+      floats.push_back(rand.next(2) ?
+                       nir_ffma(&b, pick_float(), pick_float(), pick_float()) :
+                       nir_flrp(&b, pick_float(), pick_float(), pick_float()));
+      break;
+   case 8:
+      floats.push_back(rand.next(2) ?
+                       nir_bcsel(&b, pick_bool(), pick_float(), pick_float()) :
+                       nir_b2f(&b, pick_bool()));
+      break;
+   case 9:
+      ints.push_back(nir_build_alu(&b, int_binops[rand.next(ARRAY_SIZE(int_binops))],
+                                   pick_int(), pick_int(), NULL, NULL));
+      break;
+   case 10:
+      if (rand.next(2))
+         ints.push_back(nir_f2i(&b, pick_float()));
+      else
+         floats.push_back(nir_i2f(&b, pick_int()));
+      break;
+   case 11:
+      bools.push_back(rand.next(3) ?
+                      nir_build_alu(&b, compares[rand.next(ARRAY_SIZE(compares))],
+                                    pick_float(), pick_float(), NULL, NULL) :
+                      nir_ine(&b, pick_int(), pick_int()));
+      break;
+   }
+}
+
+} /* namespace */
+
+static nir_shader *
+build_synthetic_shader(unsigned seed)
+{
+   corpus_builder c;
+   nir_variable *out[4];
+
+   nir_builder_init_simple_shader(&c.b, NULL, MESA_SHADER_FRAGMENT, &options);
+   c.rand.state = 0x9e3779b9u * (seed + 1);
+
+   for (unsigned i = 0; i < 4; i++) {
+      nir_variable *in =
+         nir_variable_create(c.b.shader, nir_var_shader_in, glsl_vec4_type(),
+                             "in");
+      in->data.location = VARYING_SLOT_VAR0 + i;
+      c.floats.push_back(nir_load_var(&c.b, in));
+
+      out[i] = nir_variable_create(c.b.shader, nir_var_shader_out,
+                                   glsl_vec4_type(), "out");
+      out[i]->data.location = FRAG_RESULT_DATA0 + i;
+   }
+
+   unsigned num_instrs = 200 + c.rand.next(1800);
+   for (unsigned i = 0; i < num_instrs; i++)
+      c.add_instr();
+
+   /* Sum up a sample of the values so that most of them stay alive. */
+   nir_ssa_def *sum[4];
+   for (unsigned i = 0; i < 4; i++)
+      sum[i] = c.floats[c.floats.size() - 1 - i];
+   for (unsigned i = 0; i + 4 < c.floats.size(); i += 3)
+      sum[i % 4] = nir_fadd(&c.b, sum[i % 4], c.floats[i]);
+   for (unsigned i = 0; i < 4; i++)
+      nir_store_var(&c.b, out[i], sum[i], 0xf);
+
+   return c.b.shader;
+}
+
+static nir_shader *
+read_shader(const char *path)
+{
+   FILE *f = fopen(path, "rb");
+   if (!f) {
+      fprintf(stderr, "Couldn't open %s\n", path);
+      return NULL;
+   }
+
+   fseek(f, 0, SEEK_END);
+   long size = ftell(f);
+   fseek(f, 0, SEEK_SET);
+
+   uint8_t *data = (uint8_t *) malloc(size);
+   nir_shader *shader = NULL;
+   if (data && fread(data, 1, size, f) == (size_t) size) {
+      struct blob_reader reader;
+      blob_reader_init(&reader, data, size);
+      shader = nir_deserialize(NULL, &options, &reader);
+   }
+
+   if (!shader)
+      fprintf(stderr, "%s is not a serialized NIR shader\n", path);
+
+   free(data);
+   fclose(f);
+   return shader;
+}
+
+static unsigned
+count_alu_instrs(nir_shader *shader)
+{
+   unsigned count = 0;
+
+   nir_foreach_function(function, shader) {
+      if (!function->impl)
+         continue;
+
+      nir_foreach_block(block, function->impl) {
+         nir_foreach_instr(instr, block) {
+            if (instr->type == nir_instr_type_alu)
+               count++;
+         }
+      }
+   }
+
+   return count;
+}
+
+int
+main(int argc, char **argv)
+{
+   std::vector<nir_shader *> corpus;
+   unsigned iterations = 10;
+   bool print = false;
+   int i;
+
+   options.fuse_ffma = true;
+   options.lower_fpow = true;
+
+   for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+      if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+         iterations = atoi(argv[++i]);
+      } else if (strcmp(argv[i], "-p") == 0) {
+         print = true;
+      } else {
+         fprintf(stderr, "usage: %s [-n iterations] [-p] [shader...]\n",
+                 argv[0]);
+         return 1;
+      }
+   }
+
+   if (i == argc) {
+      for (unsigned seed = 0; seed < 200; seed++)
+         corpus.push_back(build_synthetic_shader(seed));
+   } else {
+      for (; i < argc; i++) {
+         nir_shader *shader = read_shader(argv[i]);
+         if (!shader)
+            return 1;
+         corpus.push_back(shader);
+      }
+   }
+
+   unsigned alu_instrs = 0;
+   for (nir_shader *shader : corpus)
+      alu_instrs += count_alu_instrs(shader);
+
+   bench_clock::duration algebraic(0), late(0);
+   unsigned passes = 0;
+
+   for (unsigned iter = 0; iter < iterations; iter++) {
+      for (nir_shader *orig : corpus) {
+         nir_shader *shader = nir_shader_clone(NULL, orig);
+         bool progress;
+
+         do {
+            bench_clock::time_point start = bench_clock::now();
+            progress = nir_opt_algebraic(shader);
+            algebraic += bench_clock::now() - start;
+            passes++;
+
+            progress |= nir_copy_prop(shader);
+            progress |= nir_opt_constant_folding(shader);
+            progress |= nir_opt_dce(shader);
+         } while (progress);
+
+         bench_clock::time_point start = bench_clock::now();
+         nir_opt_algebraic_late(shader);
+         late += bench_clock::now() - start;
+
+         if (print && iter == 0)
+            nir_print_shader(shader, stdout);
+
+         ralloc_free(shader);
+      }
+   }
+
+   for (nir_shader *shader : corpus)
+      ralloc_free(shader);
+
+   typedef std::chrono::duration<double, std::milli> ms;
+   fprintf(print ? stderr : stdout,
+           "%u shaders, %u ALU instructions, %u nir_opt_algebraic runs\n"
+           "nir_opt_algebraic:      %8.3f ms per iteration\n"
+           "nir_opt_algebraic_late: %8.3f ms per iteration\n",
+           (unsigned) corpus.size(), alu_instrs, passes / MAX2(iterations, 1),
+           ms(algebraic).count() / MAX2(iterations, 1),
+           ms(late).count() / MAX2(iterations, 1));
+
+   return 0;
+}
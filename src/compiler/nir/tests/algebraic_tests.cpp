@@ -0,0 +1,166 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/* Checks that the matching automaton of nir_opt_algebraic routes
+ * instructions to the transforms that apply to them.
+ */
+
+#include <gtest/gtest.h>
+#include "nir.h"
+#include "nir_builder.h"
+
+namespace {
+
+class nir_algebraic_test : public ::testing::Test {
+protected:
+   nir_algebraic_test();
+   ~nir_algebraic_test();
+
+   nir_ssa_def *input(unsigned i);
+   void output(nir_ssa_def *def);
+   unsigned count(nir_op op);
+   void optimize();
+
+   nir_shader_compiler_options options;
+   nir_builder b;
+   unsigned num_outputs;
+};
+
+nir_algebraic_test::nir_algebraic_test()
+{
+   memset(&options, 0, sizeof(options));
+   options.fuse_ffma = true;
+   nir_builder_init_simple_shader(&b, NULL, MESA_SHADER_FRAGMENT, &options);
+   num_outputs = 0;
+}
+
+nir_algebraic_test::~nir_algebraic_test()
+{
+   ralloc_free(b.shader);
+}
+
+nir_ssa_def *
+nir_algebraic_test::input(unsigned i)
+{
+   nir_variable *var =
+      nir_variable_create(b.shader, nir_var_shader_in, glsl_vec4_type(),
+                          "in");
+   var->data.location = VARYING_SLOT_VAR0 + i;
+   return nir_load_var(&b, var);
+}
+
+void
+nir_algebraic_test::output(nir_ssa_def *def)
+{
+   nir_variable *var =
+      nir_variable_create(b.shader, nir_var_shader_out, glsl_vec4_type(),
+                          "out");
+   var->data.location = FRAG_RESULT_DATA0 + num_outputs++;
+   nir_store_var(&b, var, def, 0xf);
+}
+
+unsigned
+nir_algebraic_test::count(nir_op op)
+{
+   unsigned n = 0;
+
+   nir_foreach_block(block, b.impl) {
+      nir_foreach_instr(instr, block) {
+         if (instr->type == nir_instr_type_alu &&
+             nir_instr_as_alu(instr)->op == op)
+            n++;
+      }
+   }
+
+   return n;
+}
+
+void
+nir_algebraic_test::optimize()
+{
+   bool progress;
+
+   do {
+      progress = nir_opt_algebraic(b.shader);
+      progress |= nir_copy_prop(b.shader);
+      progress |= nir_opt_constant_folding(b.shader);
+      progress |= nir_opt_dce(b.shader);
+   } while (progress);
+
+   nir_validate_shader(b.shader);
+}
+
+} /* namespace */
+
+TEST_F(nir_algebraic_test, constant_source)
+{
+   output(nir_fmul(&b, input(0), nir_imm_float(&b, 1.0)));
+   output(nir_fmul(&b, nir_imm_float(&b, 1.0), input(1)));
+   optimize();
+
+   EXPECT_EQ(0, count(nir_op_fmul));
+}
+
+TEST_F(nir_algebraic_test, nested_expression)
+{
+   output(nir_fneg(&b, nir_fneg(&b, input(0))));
+   output(nir_fneg(&b, nir_fabs(&b, input(1))));
+   optimize();
+
+   EXPECT_EQ(1, count(nir_op_fneg));
+   EXPECT_EQ(1, count(nir_op_fabs));
+}
+
+TEST_F(nir_algebraic_test, commuted_nested_expression)
+{
+   nir_ssa_def *mul = nir_fmul(&b, input(0), input(1));
+
+   output(nir_fadd(&b, input(2), mul));
+   optimize();
+
+   EXPECT_EQ(1, count(nir_op_ffma));
+   EXPECT_EQ(0, count(nir_op_fadd));
+}
+
+TEST_F(nir_algebraic_test, repeated_variable)
+{
+   nir_ssa_def *a = nir_f2i(&b, input(0));
+
+   output(nir_i2f(&b, nir_iand(&b, a, a)));
+   output(nir_i2f(&b, nir_iand(&b, a, nir_f2i(&b, input(1)))));
+   optimize();
+
+   EXPECT_EQ(1, count(nir_op_iand));
+}
+
+TEST_F(nir_algebraic_test, constant_variable)
+{
+   nir_ssa_def *a = nir_f2i(&b, input(0));
+
+   output(nir_i2f(&b, nir_imul(&b, a, nir_imm_int(&b, 8))));
+   output(nir_i2f(&b, nir_imul(&b, a, nir_f2i(&b, input(1)))));
+   optimize();
+
+   EXPECT_EQ(1, count(nir_op_imul));
+   EXPECT_EQ(1, count(nir_op_ishl));
+}
@@ -0,0 +1,344 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/* Checks that the passes which keep the live SSA sets up to date produce
+ * the same sets as recomputing them from scratch.
+ */
+
+#include <gtest/gtest.h>
+#include <map>
+#include <vector>
+#include "nir.h"
+#include "nir_builder.h"
+
+namespace {
+
+class nir_liveness_test : public ::testing::Test {
+protected:
+   nir_liveness_test();
+   ~nir_liveness_test();
+
+   nir_ssa_def *input(unsigned i);
+   void output(nir_ssa_def *def);
+   nir_if *push_if(nir_ssa_def *condition);
+   void push_else(nir_if *nif);
+   nir_loop *push_loop();
+   void pop_cf(nir_cf_node *node);
+   void add_break();
+
+   void build_shader();
+   void check_liveness(const char *pass);
+
+   nir_shader_compiler_options options;
+   nir_builder b;
+   unsigned num_outputs;
+};
+
+nir_liveness_test::nir_liveness_test()
+{
+   memset(&options, 0, sizeof(options));
+   nir_builder_init_simple_shader(&b, NULL, MESA_SHADER_FRAGMENT, &options);
+   num_outputs = 0;
+}
+
+nir_liveness_test::~nir_liveness_test()
+{
+   ralloc_free(b.shader);
+}
+
+nir_ssa_def *
+nir_liveness_test::input(unsigned i)
+{
+   nir_variable *var =
+      nir_variable_create(b.shader, nir_var_shader_in, glsl_vec4_type(),
+                          "in");
+   var->data.location = VARYING_SLOT_VAR0 + i;
+   return nir_load_var(&b, var);
+}
+
+void
+nir_liveness_test::output(nir_ssa_def *def)
+{
+   nir_variable *var =
+      nir_variable_create(b.shader, nir_var_shader_out, glsl_vec4_type(),
+                          "out");
+   var->data.location = FRAG_RESULT_DATA0 + num_outputs++;
+   nir_store_var(&b, var, def, 0xf);
+}
+
+nir_if *
+nir_liveness_test::push_if(nir_ssa_def *condition)
+{
+   nir_if *nif = nir_if_create(b.shader);
+   nif->condition = nir_src_for_ssa(condition);
+   nir_builder_cf_insert(&b, &nif->cf_node);
+   b.cursor = nir_after_cf_list(&nif->then_list);
+   return nif;
+}
+
+void
+nir_liveness_test::push_else(nir_if *nif)
+{
+   b.cursor = nir_after_cf_list(&nif->else_list);
+}
+
+nir_loop *
+nir_liveness_test::push_loop()
+{
+   nir_loop *loop = nir_loop_create(b.shader);
+   nir_builder_cf_insert(&b, &loop->cf_node);
+   b.cursor = nir_after_cf_list(&loop->body);
+   return loop;
+}
+
+void
+nir_liveness_test::pop_cf(nir_cf_node *node)
+{
+   b.cursor = nir_after_cf_node(node);
+}
+
+void
+nir_liveness_test::add_break()
+{
+   nir_jump_instr *jump = nir_jump_instr_create(b.shader, nir_jump_break);
+   nir_builder_instr_insert(&b, &jump->instr);
+}
+
+/* Builds, in SSA form, a shader with the redundant moves, duplicate
+ * expressions, trivial phis and dead values that the passes clean up, and
+ * with values that live across ifs and loop back edges.
+ */
+void
+nir_liveness_test::build_shader()
+{
+   nir_variable *a =
+      nir_local_variable_create(b.impl, glsl_vec4_type(), "a");
+   nir_variable *c =
+      nir_local_variable_create(b.impl, glsl_vec4_type(), "c");
+   nir_variable *d =
+      nir_local_variable_create(b.impl, glsl_vec4_type(), "d");
+
+   nir_ssa_def *in0 = input(0), *in1 = input(1), *in2 = input(2);
+
+   nir_ssa_def *x = nir_fmul(&b, in0, in1);
+   nir_ssa_def *x_mov = nir_fmov(&b, x);
+   nir_store_var(&b, a, x_mov, 0xf);
+   nir_store_var(&b, c, in2, 0xf);
+   nir_store_var(&b, d, nir_fadd(&b, in0, in2), 0xf);
+
+   nir_loop *loop = push_loop();
+   {
+      nir_ssa_def *a_val = nir_load_var(&b, a);
+      nir_ssa_def *s0 = nir_fadd(&b, a_val, in2);
+      nir_ssa_def *s1 = nir_fadd(&b, a_val, in2);
+
+      /* Dead, but only once its user is gone */
+      nir_fsqrt(&b, nir_fabs(&b, s1));
+
+      nir_if *nif = push_if(nir_flt(&b, nir_channel(&b, s0, 0),
+                                    nir_channel(&b, in0, 0)));
+      {
+         nir_store_var(&b, a, nir_fmul(&b, s1, nir_fmov(&b, x_mov)), 0xf);
+         nir_store_var(&b, d, x, 0xf);
+      }
+      push_else(nif);
+      {
+         nir_store_var(&b, d, x, 0xf);
+         add_break();
+      }
+      pop_cf(&nif->cf_node);
+
+      nir_store_var(&b, c, nir_fadd(&b, nir_load_var(&b, c), a_val), 0xf);
+   }
+   pop_cf(&loop->cf_node);
+
+   /* Keeps in1 alive through the loop until it is removed */
+   nir_fsqrt(&b, in1);
+
+   nir_ssa_def *fin = nir_fadd(&b, nir_load_var(&b, a), nir_load_var(&b, c));
+   nir_if *nif = push_if(nir_fne(&b, nir_channel(&b, fin, 1),
+                                 nir_channel(&b, x_mov, 1)));
+   {
+      nir_store_var(&b, d, nir_fmov(&b, nir_load_var(&b, d)), 0xf);
+   }
+   push_else(nif);
+   {
+      nir_store_var(&b, d, nir_load_var(&b, d), 0xf);
+   }
+   pop_cf(&nif->cf_node);
+
+   output(nir_fadd(&b, fin, nir_load_var(&b, d)));
+
+   nir_lower_vars_to_ssa(b.shader);
+   nir_validate_shader(b.shader);
+}
+
+struct live_sets {
+   nir_function_impl *impl;
+   std::map<std::pair<nir_ssa_def *, nir_block *>, unsigned> sets;
+};
+
+static bool
+record_def_liveness(nir_ssa_def *def, void *void_state)
+{
+   live_sets *state = (live_sets *) void_state;
+
+   nir_foreach_block(block, state->impl) {
+      unsigned live = 0;
+      if (def->live_index != 0) {
+         live = (BITSET_TEST(block->live_in, def->live_index) ? 1 : 0) |
+                (BITSET_TEST(block->live_out, def->live_index) ? 2 : 0);
+      }
+      state->sets[std::make_pair(def, block)] = live;
+   }
+
+   return true;
+}
+
+static void
+record_liveness(nir_function_impl *impl, live_sets *state)
+{
+   state->impl = impl;
+   state->sets.clear();
+
+   nir_foreach_block(block, impl) {
+      nir_foreach_instr(instr, block)
+         nir_foreach_ssa_def(instr, record_def_liveness, state);
+   }
+}
+
+void
+nir_liveness_test::check_liveness(const char *pass)
+{
+   SCOPED_TRACE(pass);
+
+   EXPECT_TRUE(b.impl->valid_metadata & nir_metadata_live_ssa_defs);
+
+   live_sets updated, recomputed;
+   nir_metadata_require(b.impl, nir_metadata_live_ssa_defs);
+   EXPECT_EQ(NULL, b.impl->live_ssa_defs_dirty);
+   record_liveness(b.impl, &updated);
+
+   nir_metadata_preserve(b.impl, (nir_metadata) (nir_metadata_block_index |
+                                                 nir_metadata_dominance));
+   nir_metadata_require(b.impl, nir_metadata_live_ssa_defs);
+   record_liveness(b.impl, &recomputed);
+
+   EXPECT_TRUE(updated.sets == recomputed.sets);
+}
+
+} /* namespace */
+
+TEST_F(nir_liveness_test, optimization_loop)
+{
+   build_shader();
+
+   bool progress;
+   unsigned iterations = 0;
+   do {
+      progress = false;
+
+      nir_metadata_require(b.impl, nir_metadata_live_ssa_defs);
+      if (nir_copy_prop(b.shader)) {
+         check_liveness("nir_copy_prop");
+         progress = true;
+      }
+      if (nir_opt_remove_phis(b.shader)) {
+         check_liveness("nir_opt_remove_phis");
+         progress = true;
+      }
+      if (nir_opt_cse(b.shader)) {
+         check_liveness("nir_opt_cse");
+         progress = true;
+      }
+      if (nir_opt_dce(b.shader)) {
+         check_liveness("nir_opt_dce");
+         progress = true;
+      }
+
+      nir_validate_shader(b.shader);
+      iterations++;
+   } while (progress);
+
+   /* Every pass should have had something to do */
+   EXPECT_LT(1u, iterations);
+}
+
+TEST_F(nir_liveness_test, loop_phis)
+{
+   build_shader();
+
+   nir_metadata_require(b.impl, (nir_metadata) (nir_metadata_block_index |
+                                                nir_metadata_live_ssa_defs));
+
+   /* Replace the phis at the top of the loop by the values they get on
+    * entry, which shortens the live ranges of the values from the back
+    * edge, and report the change by hand.
+    */
+   nir_block *header = NULL;
+   nir_foreach_block(block, b.impl) {
+      nir_foreach_instr(instr, block) {
+         if (instr->type == nir_instr_type_phi && !header)
+            header = block;
+      }
+   }
+   ASSERT_TRUE(header != NULL);
+
+   nir_foreach_instr_safe(instr, header) {
+      if (instr->type != nir_instr_type_phi)
+         break;
+
+      nir_phi_instr *phi = nir_instr_as_phi(instr);
+      nir_ssa_def *entry = NULL;
+      nir_foreach_phi_src(src, phi) {
+         if (src->pred->index < header->index)
+            entry = src->src.ssa;
+      }
+      ASSERT_TRUE(entry != NULL);
+
+      nir_live_ssa_defs_dirty_instr(b.impl, instr);
+      nir_live_ssa_defs_dirty_def(b.impl, entry);
+      nir_ssa_def_rewrite_uses(&phi->dest.ssa, nir_src_for_ssa(entry));
+      nir_instr_remove(instr);
+   }
+
+   check_liveness("loop phi removal");
+}
+
+TEST_F(nir_liveness_test, invalidated)
+{
+   build_shader();
+
+   nir_metadata_require(b.impl, nir_metadata_live_ssa_defs);
+
+   nir_foreach_block(block, b.impl) {
+      nir_foreach_instr(instr, block) {
+         nir_live_ssa_defs_dirty_instr(b.impl, instr);
+      }
+   }
+   EXPECT_TRUE(b.impl->live_ssa_defs_dirty != NULL);
+
+   /* Not preserving the live sets throws the reported edits away */
+   nir_metadata_preserve(b.impl, nir_metadata_block_index);
+   EXPECT_EQ(NULL, b.impl->live_ssa_defs_dirty);
+}
@@ -0,0 +1,387 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#include <chrono>
+#include <gtest/gtest.h>
+#include "nir.h"
+#include "nir_builder.h"
+#include "nir_serialize.h"
+
+class nir_serialize_test : public ::testing::Test {
+protected:
+   nir_serialize_test();
+   ~nir_serialize_test();
+
+   /* Serializes b.shader, reads it back into res and checks that res
+    * serializes to exactly the same bytes.
+    */
+   void round_trip();
+
+   nir_builder b;
+   nir_shader *res;
+   struct blob *blob;
+};
+
+nir_serialize_test::nir_serialize_test()
+{
+   static const nir_shader_compiler_options options = { };
+   nir_builder_init_simple_shader(&b, NULL, MESA_SHADER_FRAGMENT, &options);
+   res = NULL;
+   blob = blob_create(b.shader);
+}
+
+nir_serialize_test::~nir_serialize_test()
+{
+   ralloc_free(b.shader);
+}
+
+void
+nir_serialize_test::round_trip()
+{
+   nir_validate_shader(b.shader);
+
+   blob->size = 0;
+   nir_serialize(blob, b.shader);
+
+   struct blob_reader reader;
+   blob_reader_init(&reader, blob->data, blob->size);
+   res = nir_deserialize(b.shader, b.shader->options, &reader);
+   ASSERT_TRUE(res != NULL);
+   EXPECT_EQ(reader.end, reader.current);
+
+   nir_validate_shader(res);
+
+   struct blob *res_blob = blob_create(b.shader);
+   nir_serialize(res_blob, res);
+   ASSERT_EQ(blob->size, res_blob->size);
+   EXPECT_EQ(0, memcmp(blob->data, res_blob->data, blob->size));
+}
+
+/* Adds a source to a phi that hasn't been inserted yet. */
+static void
+add_phi_src(nir_phi_instr *phi, nir_block *pred, nir_ssa_def *def)
+{
+   nir_phi_src *src = ralloc(phi, nir_phi_src);
+   src->pred = pred;
+   src->src = nir_src_for_ssa(def);
+   exec_list_push_tail(&phi->srcs, &src->node);
+}
+
+TEST_F(nir_serialize_test, empty)
+{
+   round_trip();
+
+   EXPECT_EQ(MESA_SHADER_FRAGMENT, res->stage);
+   EXPECT_EQ(1u, exec_list_length(&res->functions));
+}
+
+TEST_F(nir_serialize_test, variables_and_alu)
+{
+   b.shader->info.name = ralloc_strdup(b.shader, "alu");
+   b.shader->info.inputs_read = 1;
+   b.shader->num_inputs = 1;
+
+   nir_variable *in = nir_variable_create(b.shader, nir_var_shader_in,
+                                          glsl_vec4_type(), "in");
+   nir_variable *out = nir_variable_create(b.shader, nir_var_shader_out,
+                                           glsl_vec4_type(), "out");
+   nir_variable *u = nir_variable_create(b.shader, nir_var_uniform,
+                                         glsl_float_type(), NULL);
+   u->data.location = 3;
+
+   nir_ssa_def *v = nir_load_var(&b, in);
+   nir_ssa_def *x = nir_fadd(&b, v, nir_imm_float(&b, 1.0f));
+   nir_alu_instr *mul =
+      nir_instr_as_alu(nir_fmul(&b, x, nir_load_var(&b, u))->parent_instr);
+   mul->src[0].negate = true;
+   mul->src[1].swizzle[1] = mul->src[1].swizzle[2] = 0;
+   mul->dest.saturate = true;
+   nir_store_var(&b, out, &mul->dest.dest.ssa, 0x7);
+
+   round_trip();
+
+   EXPECT_STREQ("alu", res->info.name);
+   EXPECT_EQ(1u, res->info.inputs_read);
+   EXPECT_EQ(1u, res->num_inputs);
+   EXPECT_EQ(1u, exec_list_length(&res->inputs));
+   EXPECT_EQ(1u, exec_list_length(&res->outputs));
+   EXPECT_EQ(1u, exec_list_length(&res->uniforms));
+
+   nir_variable *res_u = exec_node_data(nir_variable,
+                                        exec_list_get_head(&res->uniforms),
+                                        node);
+   EXPECT_TRUE(res_u->name == NULL);
+   EXPECT_EQ(3, res_u->data.location);
+   EXPECT_EQ(glsl_float_type(), res_u->type);
+}
+
+TEST_F(nir_serialize_test, if_phi)
+{
+   nir_variable *out = nir_variable_create(b.shader, nir_var_shader_out,
+                                           glsl_float_type(), "out");
+
+   nir_ssa_def *x = nir_imm_float(&b, 2.0f);
+   nir_if *nif = nir_if_create(b.shader);
+   nif->condition = nir_src_for_ssa(nir_flt(&b, x, nir_imm_float(&b, 1.0f)));
+   nir_builder_cf_insert(&b, &nif->cf_node);
+
+   b.cursor = nir_after_cf_list(&nif->then_list);
+   nir_ssa_def *then_val = nir_fmul(&b, x, x);
+   nir_block *then_block = nir_cursor_current_block(b.cursor);
+
+   b.cursor = nir_after_cf_list(&nif->else_list);
+   nir_ssa_def *else_val = nir_fadd(&b, x, x);
+   nir_block *else_block = nir_cursor_current_block(b.cursor);
+
+   b.cursor = nir_after_cf_node(&nif->cf_node);
+   nir_phi_instr *phi = nir_phi_instr_create(b.shader);
+   nir_ssa_dest_init(&phi->instr, &phi->dest, 1, 32, NULL);
+   add_phi_src(phi, then_block, then_val);
+   add_phi_src(phi, else_block, else_val);
+   nir_builder_instr_insert(&b, &phi->instr);
+   nir_store_var(&b, out, &phi->dest.ssa, 0x1);
+
+   round_trip();
+}
+
+TEST_F(nir_serialize_test, loop_phi)
+{
+   /* The loop header phi uses a value that is defined later in the loop. */
+   nir_variable *out = nir_variable_create(b.shader, nir_var_shader_out,
+                                           glsl_int_type(), "out");
+
+   nir_ssa_def *init = nir_imm_int(&b, 0);
+   nir_block *pre_block = nir_cursor_current_block(b.cursor);
+
+   nir_loop *loop = nir_loop_create(b.shader);
+   nir_builder_cf_insert(&b, &loop->cf_node);
+   nir_block *header = nir_cf_node_as_block(nir_loop_first_cf_node(loop));
+
+   b.cursor = nir_after_cf_list(&loop->body);
+   nir_phi_instr *phi = nir_phi_instr_create(b.shader);
+   nir_ssa_dest_init(&phi->instr, &phi->dest, 1, 32, "i");
+   nir_ssa_def *next = nir_iadd(&b, &phi->dest.ssa, nir_imm_int(&b, 1));
+
+   nir_if *nif = nir_if_create(b.shader);
+   nif->condition = nir_src_for_ssa(nir_ige(&b, next, nir_imm_int(&b, 10)));
+   nir_builder_cf_insert(&b, &nif->cf_node);
+   b.cursor = nir_after_cf_list(&nif->then_list);
+   nir_jump(&b, nir_jump_break);
+   b.cursor = nir_after_cf_node(&nif->cf_node);
+   nir_block *latch = nir_cursor_current_block(b.cursor);
+
+   add_phi_src(phi, pre_block, init);
+   add_phi_src(phi, latch, next);
+   nir_instr_insert(nir_before_block(header), &phi->instr);
+
+   b.cursor = nir_after_cf_node(&loop->cf_node);
+   nir_store_var(&b, out, next, 0x1);
+
+   round_trip();
+
+   nir_function_impl *impl = nir_shader_get_entrypoint(res)->impl;
+   nir_loop *res_loop =
+      nir_cf_node_as_loop(nir_cf_node_next(&nir_start_block(impl)->cf_node));
+   nir_block *res_header =
+      nir_cf_node_as_block(nir_loop_first_cf_node(res_loop));
+   nir_instr *res_instr = nir_block_first_instr(res_header);
+   ASSERT_EQ(nir_instr_type_phi, res_instr->type);
+
+   nir_phi_instr *res_phi = nir_instr_as_phi(res_instr);
+   EXPECT_STREQ("i", res_phi->dest.ssa.name);
+   ASSERT_EQ(2u, exec_list_length(&res_phi->srcs));
+   nir_foreach_phi_src(src, res_phi) {
+      if (src->pred == nir_start_block(impl)) {
+         EXPECT_EQ(nir_instr_type_load_const, src->src.ssa->parent_instr->type);
+      } else {
+         EXPECT_EQ(&res_loop->cf_node, src->pred->cf_node.parent);
+         EXPECT_EQ(nir_instr_type_alu, src->src.ssa->parent_instr->type);
+      }
+   }
+}
+
+TEST_F(nir_serialize_test, derefs_and_tex)
+{
+   nir_variable *arr = nir_local_variable_create(b.impl,
+      glsl_array_type(glsl_float_type(), 4), "arr");
+   nir_variable *tex_var = nir_variable_create(b.shader, nir_var_uniform,
+      glsl_sampler_type(GLSL_SAMPLER_DIM_2D, false, false, GLSL_TYPE_FLOAT),
+      "tex");
+   nir_variable *out = nir_variable_create(b.shader, nir_var_shader_out,
+                                           glsl_vec4_type(), "out");
+
+   nir_ssa_def *idx = nir_imm_int(&b, 2);
+
+   nir_deref_var *deref = nir_deref_var_create(b.shader, arr);
+   nir_deref_array *deref_array = nir_deref_array_create(deref);
+   deref_array->deref_array_type = nir_deref_array_type_indirect;
+   deref_array->base_offset = 1;
+   deref_array->indirect = nir_src_for_ssa(idx);
+   deref_array->deref.type = glsl_float_type();
+   deref->deref.child = &deref_array->deref;
+   nir_store_deref_var(&b, deref, nir_imm_float(&b, 0.5f), 0x1);
+
+   nir_intrinsic_instr *load =
+      nir_intrinsic_instr_create(b.shader, nir_intrinsic_load_var);
+   load->num_components = 1;
+   load->variables[0] = nir_deref_as_var(nir_copy_deref(load, &deref->deref));
+   nir_ssa_dest_init(&load->instr, &load->dest, 1, 32, NULL);
+   nir_builder_instr_insert(&b, &load->instr);
+
+   nir_ssa_def *coord = nir_vec2(&b, &load->dest.ssa,
+                                 nir_imm_float(&b, 0.25f));
+
+   nir_tex_instr *tex = nir_tex_instr_create(b.shader, 1);
+   tex->op = nir_texop_tex;
+   tex->sampler_dim = GLSL_SAMPLER_DIM_2D;
+   tex->dest_type = nir_type_float;
+   tex->coord_components = 2;
+   tex->src[0].src_type = nir_tex_src_coord;
+   tex->src[0].src = nir_src_for_ssa(coord);
+   tex->texture = nir_deref_var_create(tex, tex_var);
+   tex->texture_index = 3;
+   tex->sampler_index = 3;
+   nir_ssa_dest_init(&tex->instr, &tex->dest, 4, 32, NULL);
+   nir_builder_instr_insert(&b, &tex->instr);
+
+   nir_store_var(&b, out, &tex->dest.ssa, 0xf);
+
+   round_trip();
+
+   nir_function_impl *impl = nir_shader_get_entrypoint(res)->impl;
+   EXPECT_EQ(1u, exec_list_length(&impl->locals));
+
+   nir_foreach_block(block, impl) {
+      nir_foreach_instr(instr, block) {
+         if (instr->type != nir_instr_type_tex)
+            continue;
+
+         nir_tex_instr *res_tex = nir_instr_as_tex(instr);
+         EXPECT_EQ(nir_texop_tex, res_tex->op);
+         EXPECT_EQ(2u, res_tex->coord_components);
+         EXPECT_EQ(3u, res_tex->texture_index);
+         ASSERT_TRUE(res_tex->texture != NULL);
+         EXPECT_STREQ("tex", res_tex->texture->var->name);
+         EXPECT_TRUE(res_tex->sampler == NULL);
+      }
+   }
+}
+
+TEST_F(nir_serialize_test, registers)
+{
+   nir_variable *out = nir_variable_create(b.shader, nir_var_shader_out,
+                                           glsl_vec4_type(), "out");
+   nir_register *reg = nir_local_reg_create(b.impl);
+   reg->num_components = 4;
+
+   nir_alu_instr *mov = nir_alu_instr_create(b.shader, nir_op_fmov);
+   mov->dest.dest = nir_dest_for_reg(reg);
+   mov->dest.write_mask = 0xf;
+   mov->src[0].src = nir_src_for_ssa(nir_imm_float(&b, 1.0f));
+   memset(mov->src[0].swizzle, 0, sizeof(mov->src[0].swizzle));
+   nir_builder_instr_insert(&b, &mov->instr);
+
+   mov = nir_alu_instr_create(b.shader, nir_op_fmov);
+   mov->src[0].src = nir_src_for_reg(reg);
+   nir_ssa_dest_init(&mov->instr, &mov->dest.dest, 4, 32, NULL);
+   mov->dest.write_mask = 0xf;
+   nir_builder_instr_insert(&b, &mov->instr);
+
+   nir_store_var(&b, out, &mov->dest.dest.ssa, 0xf);
+
+   round_trip();
+
+   nir_function_impl *impl = nir_shader_get_entrypoint(res)->impl;
+   ASSERT_EQ(1u, exec_list_length(&impl->registers));
+   nir_register *res_reg = exec_node_data(nir_register,
+                                          exec_list_get_head(&impl->registers),
+                                          node);
+   EXPECT_EQ(4u, res_reg->num_components);
+   EXPECT_EQ(1u, list_length(&res_reg->defs));
+   EXPECT_EQ(1u, list_length(&res_reg->uses));
+}
+
+TEST_F(nir_serialize_test, truncated)
+{
+   nir_variable *out = nir_variable_create(b.shader, nir_var_shader_out,
+                                           glsl_float_type(), "out");
+   nir_store_var(&b, out, nir_imm_float(&b, 1.0f), 0x1);
+
+   nir_serialize(blob, b.shader);
+
+   struct blob_reader reader;
+   blob_reader_init(&reader, blob->data, blob->size - 1);
+   EXPECT_TRUE(nir_deserialize(b.shader, b.shader->options, &reader) == NULL);
+}
+
+/* Not a correctness test as much as a benchmark: reports the size of the
+ * serialized form of a long shader and how long it takes to write and read
+ * it, next to the time nir_shader_clone() takes for the same shader.
+ */
+TEST_F(nir_serialize_test, large_shader)
+{
+   static const unsigned num_ops = 4096;
+   static const unsigned num_iters = 16;
+
+   nir_variable *in = nir_variable_create(b.shader, nir_var_shader_in,
+                                          glsl_vec4_type(), "in");
+   nir_variable *out = nir_variable_create(b.shader, nir_var_shader_out,
+                                           glsl_vec4_type(), "out");
+
+   nir_ssa_def *v = nir_load_var(&b, in);
+   for (unsigned i = 0; i < num_ops; i++) {
+      nir_ssa_def *c = nir_imm_float(&b, i);
+      v = (i & 1) ? nir_fmul(&b, v, c) : nir_fadd(&b, v, c);
+   }
+   nir_store_var(&b, out, v, 0xf);
+
+   round_trip();
+
+   typedef std::chrono::steady_clock clock;
+   clock::time_point start = clock::now();
+   for (unsigned i = 0; i < num_iters; i++) {
+      blob->size = 0;
+      nir_serialize(blob, b.shader);
+   }
+   clock::time_point serialized = clock::now();
+   for (unsigned i = 0; i < num_iters; i++) {
+      struct blob_reader reader;
+      blob_reader_init(&reader, blob->data, blob->size);
+      ralloc_free(nir_deserialize(NULL, b.shader->options, &reader));
+   }
+   clock::time_point deserialized = clock::now();
+   for (unsigned i = 0; i < num_iters; i++)
+      ralloc_free(nir_shader_clone(NULL, b.shader));
+   clock::time_point cloned = clock::now();
+
+   using std::chrono::duration_cast;
+   using std::chrono::microseconds;
+   RecordProperty("bytes", (int) blob->size);
+   RecordProperty("bytes_per_instr", (int) blob->size / (2 * num_ops + 2));
+   RecordProperty("serialize_us", (int)
+      (duration_cast<microseconds>(serialized - start).count() / num_iters));
+   RecordProperty("deserialize_us", (int)
+      (duration_cast<microseconds>(deserialized - serialized).count() /
+       num_iters));
+   RecordProperty("clone_us", (int)
+      (duration_cast<microseconds>(cloned - deserialized).count() / num_iters));
+}
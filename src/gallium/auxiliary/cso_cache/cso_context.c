@@ -42,6 +42,7 @@
 #include "util/u_math.h"
 #include "util/u_memory.h"
 #include "util/u_vbuf.h"
+#include "util/u_atomic.h"
 #include "tgsi/tgsi_parse.h"
 
 #include "cso_cache/cso_context.h"
@@ -57,6 +58,11 @@ struct sampler_info
 {
    void *samplers[PIPE_MAX_SAMPLERS];
    unsigned nr_samplers;
+
+   /** What the driver has bound, to skip rebinding unchanged samplers */
+   void *bound[PIPE_MAX_SAMPLERS];
+   /** Set when a bound sampler may have been destroyed and recreated */
+   boolean rebind;
 };
 
 
@@ -84,6 +90,11 @@ struct cso_context {
 
    struct sampler_info samplers[PIPE_SHADER_TYPES];
 
+   /** Changes whenever sampler CSOs are deleted, see
+    * cso_get_sampler_generation().
+    */
+   unsigned sampler_generation;
+
    struct pipe_vertex_buffer aux_vertex_buffer_current;
    struct pipe_vertex_buffer aux_vertex_buffer_saved;
    unsigned aux_vertex_buffer_index;
@@ -154,9 +165,27 @@ static boolean delete_depth_stencil_state(struct cso_context *ctx, void *state)
    return TRUE;
 }
 
+/**
+ * Source of sampler generation numbers.  Shared by all contexts so that a
+ * (context, generation) pair is never reused, even when a new context is
+ * allocated at the address of a destroyed one.
+ */
+static unsigned cso_sampler_generation_seq;
+
 static boolean delete_sampler_state(struct cso_context *ctx, void *state)
 {
    struct cso_sampler *cso = (struct cso_sampler *)state;
+   unsigned i;
+
+   /* Handles returned by cso_lookup_sampler() may be cached by the state
+    * tracker, let it know they may now be stale.
+    */
+   ctx->sampler_generation = p_atomic_inc_return(&cso_sampler_generation_seq);
+
+   /* A new sampler may get the same handle, so don't trust "bound". */
+   for (i = 0; i < PIPE_SHADER_TYPES; i++)
+      ctx->samplers[i].rebind = TRUE;
+
    if (cso->delete_state)
       cso->delete_state(cso->context, cso->data);
    FREE(state);
@@ -262,6 +291,7 @@ struct cso_context *cso_create_context( struct pipe_context *pipe )
 
    ctx->pipe = pipe;
    ctx->sample_mask = ~0;
+   ctx->sampler_generation = p_atomic_inc_return(&cso_sampler_generation_seq);
 
    ctx->aux_vertex_buffer_index = 0; /* 0 for now */
 
@@ -1160,6 +1190,59 @@ unsigned cso_get_aux_vertex_buffer_slot(struct cso_context *ctx)
 
 
 
+/**
+ * Return the driver sampler object for the given template, creating it if
+ * it isn't in the cache yet.  Returns NULL if out of memory.
+ *
+ * The handle stays valid until cso_get_sampler_generation() changes.
+ */
+void *
+cso_lookup_sampler(struct cso_context *ctx,
+                   const struct pipe_sampler_state *templ)
+{
+   unsigned key_size = sizeof(struct pipe_sampler_state);
+   unsigned hash_key = cso_construct_key((void*)templ, key_size);
+   struct cso_hash_iter iter =
+      cso_find_state_template(ctx->cache,
+                              hash_key, CSO_SAMPLER,
+                              (void *) templ, key_size);
+
+   if (cso_hash_iter_is_null(iter)) {
+      struct cso_sampler *cso = MALLOC(sizeof(struct cso_sampler));
+      if (!cso)
+         return NULL;
+
+      memcpy(&cso->state, templ, sizeof(*templ));
+      cso->data = ctx->pipe->create_sampler_state(ctx->pipe, &cso->state);
+      cso->delete_state =
+         (cso_state_callback) ctx->pipe->delete_sampler_state;
+      cso->context = ctx->pipe;
+
+      iter = cso_insert_state(ctx->cache, hash_key, CSO_SAMPLER, cso);
+      if (cso_hash_iter_is_null(iter)) {
+         FREE(cso);
+         return NULL;
+      }
+
+      return cso->data;
+   }
+   else {
+      return ((struct cso_sampler *)cso_hash_iter_data(iter))->data;
+   }
+}
+
+
+/**
+ * Returns a number which changes whenever sampler objects previously
+ * returned by cso_lookup_sampler() may have been destroyed.
+ */
+unsigned
+cso_get_sampler_generation(const struct cso_context *ctx)
+{
+   return ctx->sampler_generation;
+}
+
+
 enum pipe_error
 cso_single_sampler(struct cso_context *ctx, unsigned shader_stage,
                    unsigned idx, const struct pipe_sampler_state *templ)
@@ -1167,35 +1250,9 @@ cso_single_sampler(struct cso_context *ctx, unsigned shader_stage,
    void *handle = NULL;
 
    if (templ) {
-      unsigned key_size = sizeof(struct pipe_sampler_state);
-      unsigned hash_key = cso_construct_key((void*)templ, key_size);
-      struct cso_hash_iter iter =
-         cso_find_state_template(ctx->cache,
-                                 hash_key, CSO_SAMPLER,
-                                 (void *) templ, key_size);
-
-      if (cso_hash_iter_is_null(iter)) {
-         struct cso_sampler *cso = MALLOC(sizeof(struct cso_sampler));
-         if (!cso)
-            return PIPE_ERROR_OUT_OF_MEMORY;
-
-         memcpy(&cso->state, templ, sizeof(*templ));
-         cso->data = ctx->pipe->create_sampler_state(ctx->pipe, &cso->state);
-         cso->delete_state =
-            (cso_state_callback) ctx->pipe->delete_sampler_state;
-         cso->context = ctx->pipe;
-
-         iter = cso_insert_state(ctx->cache, hash_key, CSO_SAMPLER, cso);
-         if (cso_hash_iter_is_null(iter)) {
-            FREE(cso);
-            return PIPE_ERROR_OUT_OF_MEMORY;
-         }
-
-         handle = cso->data;
-      }
-      else {
-         handle = ((struct cso_sampler *)cso_hash_iter_data(iter))->data;
-      }
+      handle = cso_lookup_sampler(ctx, templ);
+      if (!handle)
+         return PIPE_ERROR_OUT_OF_MEMORY;
    }
 
    ctx->samplers[shader_stage].samplers[idx] = handle;
@@ -1203,6 +1260,18 @@ cso_single_sampler(struct cso_context *ctx, unsigned shader_stage,
 }
 
 
+/**
+ * Like cso_single_sampler(), but with a handle that was already obtained
+ * from cso_lookup_sampler().
+ */
+void
+cso_single_sampler_handle(struct cso_context *ctx, unsigned shader_stage,
+                          unsigned idx, void *handle)
+{
+   ctx->samplers[shader_stage].samplers[idx] = handle;
+}
+
+
 /**
  * Send staged sampler state to the driver.
  */
@@ -1211,7 +1280,7 @@ cso_single_sampler_done(struct cso_context *ctx, unsigned shader_stage)
 {
    struct sampler_info *info = &ctx->samplers[shader_stage];
    const unsigned old_nr_samplers = info->nr_samplers;
-   unsigned i;
+   unsigned i, count;
 
    /* find highest non-null sampler */
    for (i = PIPE_MAX_SAMPLERS; i > 0; i--) {
@@ -1220,9 +1289,19 @@ cso_single_sampler_done(struct cso_context *ctx, unsigned shader_stage)
    }
 
    info->nr_samplers = i;
-   ctx->pipe->bind_sampler_states(ctx->pipe, shader_stage, 0,
-                                  MAX2(old_nr_samplers, info->nr_samplers),
+   count = MAX2(old_nr_samplers, info->nr_samplers);
+
+   /* Several drivers only handle binding from slot 0, so always bind the
+    * whole range, but only if anything changed.
+    */
+   if (!info->rebind &&
+       !memcmp(info->samplers, info->bound, count * sizeof(info->samplers[0])))
+      return;
+
+   ctx->pipe->bind_sampler_states(ctx->pipe, shader_stage, 0, count,
                                   info->samplers);
+   memcpy(info->bound, info->samplers, count * sizeof(info->samplers[0]));
+   info->rebind = FALSE;
 }
 
 
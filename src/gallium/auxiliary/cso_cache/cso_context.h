@@ -75,6 +75,18 @@ cso_single_sampler(struct cso_context *cso, unsigned shader_stage,
 void
 cso_single_sampler_done(struct cso_context *cso, unsigned shader_stage);
 
+/* For state trackers which cache sampler handles on their own objects: */
+void *
+cso_lookup_sampler(struct cso_context *cso,
+                   const struct pipe_sampler_state *state);
+
+unsigned
+cso_get_sampler_generation(const struct cso_context *cso);
+
+void
+cso_single_sampler_handle(struct cso_context *cso, unsigned shader_stage,
+                          unsigned idx, void *handle);
+
 
 enum pipe_error cso_set_vertex_elements(struct cso_context *ctx,
                                         unsigned count,
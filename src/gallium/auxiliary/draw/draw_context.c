@@ -44,6 +44,7 @@
 #include "draw_prim_assembler.h"
 #include "draw_vs.h"
 #include "draw_gs.h"
+#include "draw_tess.h"
 
 #if HAVE_LLVM
 #include "gallivm/lp_bld_init.h"
@@ -163,6 +164,13 @@ boolean draw_init(struct draw_context *draw)
    if (!draw_gs_init( draw ))
       return FALSE;
 
+   draw->default_outer_tess_level[0] =
+   draw->default_outer_tess_level[1] =
+   draw->default_outer_tess_level[2] =
+   draw->default_outer_tess_level[3] = 1.0f;
+   draw->default_inner_tess_level[0] =
+   draw->default_inner_tess_level[1] = 1.0f;
+
    draw->quads_always_flatshade_last = !draw->pipe->screen->get_param(
       draw->pipe->screen, PIPE_CAP_QUADS_FOLLOW_PROVOKING_VERTEX_CONVENTION);
 
@@ -182,6 +190,7 @@ boolean draw_init(struct draw_context *draw)
 void draw_new_instance(struct draw_context *draw)
 {
    draw_geometry_shader_new_instance(draw->gs.geometry_shader);
+   draw_tess_new_instance(draw);
    draw_prim_assembler_new_instance(draw->ia);
 }
 
@@ -446,7 +455,9 @@ draw_set_mapped_constant_buffer(struct draw_context *draw,
                                 unsigned size )
 {
    debug_assert(shader_type == PIPE_SHADER_VERTEX ||
-                shader_type == PIPE_SHADER_GEOMETRY);
+                shader_type == PIPE_SHADER_GEOMETRY ||
+                shader_type == PIPE_SHADER_TESS_CTRL ||
+                shader_type == PIPE_SHADER_TESS_EVAL);
    debug_assert(slot < PIPE_MAX_CONSTANT_BUFFERS);
 
    draw_do_flush(draw, DRAW_FLUSH_PARAMETER_CHANGE);
@@ -460,6 +471,14 @@ draw_set_mapped_constant_buffer(struct draw_context *draw,
       draw->pt.user.gs_constants[slot] = buffer;
       draw->pt.user.gs_constants_size[slot] = size;
       break;
+   case PIPE_SHADER_TESS_CTRL:
+      draw->pt.user.tcs_constants[slot] = buffer;
+      draw->pt.user.tcs_constants_size[slot] = size;
+      break;
+   case PIPE_SHADER_TESS_EVAL:
+      draw->pt.user.tes_constants[slot] = buffer;
+      draw->pt.user.tes_constants_size[slot] = size;
+      break;
    default:
       assert(0 && "invalid shader type in draw_set_mapped_constant_buffer");
    }
@@ -579,8 +598,8 @@ draw_remove_extra_vertex_attribs(struct draw_context *draw)
 
 
 /**
- * If a geometry shader is present, return its info, else the vertex shader's
- * info.
+ * Return the info of the last shader stage: the geometry shader if present,
+ * else the tessellation evaluation shader if present, else the vertex shader.
  */
 struct tgsi_shader_info *
 draw_get_shader_info(const struct draw_context *draw)
@@ -588,6 +607,8 @@ draw_get_shader_info(const struct draw_context *draw)
 
    if (draw->gs.geometry_shader) {
       return &draw->gs.geometry_shader->info;
+   } else if (draw->tes.tess_eval_shader) {
+      return &draw->tes.tess_eval_shader->info;
    } else {
       return &draw->vs.vertex_shader->info;
    }
@@ -712,6 +733,41 @@ draw_total_gs_outputs(const struct draw_context *draw)
    return info->num_outputs + draw->extra_shader_outputs.num;
 }
 
+/**
+ * Return total number of the tessellation evaluation shader outputs,
+ * including the extra output attributes, like draw_total_gs_outputs().
+ */
+uint
+draw_total_tes_outputs(const struct draw_context *draw)
+{
+   const struct tgsi_shader_info *info;
+
+   if (!draw->tes.tess_eval_shader)
+      return 0;
+
+   info = &draw->tes.tess_eval_shader->info;
+
+   return info->num_outputs + draw->extra_shader_outputs.num;
+}
+
+
+/**
+ * Set the default tessellation levels, used when there's no tessellation
+ * control shader.
+ */
+void
+draw_set_tess_state(struct draw_context *draw,
+                    const float default_outer_level[4],
+                    const float default_inner_level[2])
+{
+   draw_do_flush(draw, DRAW_FLUSH_PARAMETER_CHANGE);
+
+   memcpy(draw->default_outer_tess_level, default_outer_level,
+          sizeof draw->default_outer_tess_level);
+   memcpy(draw->default_inner_tess_level, default_inner_level,
+          sizeof draw->default_inner_tess_level);
+}
+
 
 /**
  * Provide TGSI sampler objects for vertex/geometry shaders that use
@@ -830,6 +886,8 @@ draw_current_shader_outputs(const struct draw_context *draw)
 {
    if (draw->gs.geometry_shader)
       return draw->gs.num_gs_outputs;
+   if (draw->tes.tess_eval_shader)
+      return draw->tes.num_tes_outputs;
    return draw->vs.num_vs_outputs;
 }
 
@@ -843,6 +901,8 @@ draw_current_shader_position_output(const struct draw_context *draw)
 {
    if (draw->gs.geometry_shader)
       return draw->gs.position_output;
+   if (draw->tes.tess_eval_shader)
+      return draw->tes.position_output;
    return draw->vs.position_output;
 }
 
@@ -856,6 +916,8 @@ draw_current_shader_viewport_index_output(const struct draw_context *draw)
 {
    if (draw->gs.geometry_shader)
       return draw->gs.geometry_shader->viewport_index_output;
+   if (draw->tes.tess_eval_shader)
+      return draw->tes.tess_eval_shader->viewport_index_output;
    return draw->vs.vertex_shader->viewport_index_output;
 }
 
@@ -868,6 +930,8 @@ draw_current_shader_uses_viewport_index(const struct draw_context *draw)
 {
    if (draw->gs.geometry_shader)
       return draw->gs.geometry_shader->info.writes_viewport_index;
+   if (draw->tes.tess_eval_shader)
+      return draw->tes.tess_eval_shader->info.writes_viewport_index;
    return draw->vs.vertex_shader->info.writes_viewport_index;
 }
 
@@ -883,6 +947,8 @@ draw_current_shader_clipvertex_output(const struct draw_context *draw)
 {
    if (draw->gs.geometry_shader)
       return draw->gs.position_output;
+   if (draw->tes.tess_eval_shader)
+      return draw->tes.tess_eval_shader->clipvertex_output;
    return draw->vs.clipvertex_output;
 }
 
@@ -892,6 +958,8 @@ draw_current_shader_ccdistance_output(const struct draw_context *draw, int index
    debug_assert(index < PIPE_MAX_CLIP_OR_CULL_DISTANCE_ELEMENT_COUNT);
    if (draw->gs.geometry_shader)
       return draw->gs.geometry_shader->ccdistance_output[index];
+   if (draw->tes.tess_eval_shader)
+      return draw->tes.tess_eval_shader->ccdistance_output[index];
    return draw->vs.ccdistance_output[index];
 }
 
@@ -901,6 +969,8 @@ draw_current_shader_num_written_clipdistances(const struct draw_context *draw)
 {
    if (draw->gs.geometry_shader)
       return draw->gs.geometry_shader->info.num_written_clipdistance;
+   if (draw->tes.tess_eval_shader)
+      return draw->tes.tess_eval_shader->info.num_written_clipdistance;
    return draw->vs.vertex_shader->info.num_written_clipdistance;
 }
 
@@ -909,6 +979,8 @@ draw_current_shader_num_written_culldistances(const struct draw_context *draw)
 {
    if (draw->gs.geometry_shader)
       return draw->gs.geometry_shader->info.num_written_culldistance;
+   if (draw->tes.tess_eval_shader)
+      return draw->tes.tess_eval_shader->info.num_written_culldistance;
    return draw->vs.vertex_shader->info.num_written_culldistance;
 }
 
@@ -1062,6 +1134,8 @@ draw_get_shader_param(unsigned shader, enum pipe_shader_cap param)
       switch(shader) {
       case PIPE_SHADER_VERTEX:
       case PIPE_SHADER_GEOMETRY:
+      case PIPE_SHADER_TESS_CTRL:
+      case PIPE_SHADER_TESS_EVAL:
          return gallivm_get_shader_param(param);
       default:
          return 0;
@@ -47,9 +47,11 @@
 #include "gallivm/lp_bld_type.h"
 #include "gallivm/lp_bld_pack.h"
 #include "gallivm/lp_bld_format.h"
+#include "gallivm/lp_bld_disk_cache.h"
 
 #include "tgsi/tgsi_exec.h"
 #include "tgsi/tgsi_dump.h"
+#include "tgsi/tgsi_parse.h"
 
 #include "util/u_math.h"
 #include "util/u_pointer.h"
@@ -511,6 +513,12 @@ draw_llvm_create(struct draw_context *draw, LLVMContextRef context)
    llvm->nr_gs_variants = 0;
    make_empty_list(&llvm->gs_variants_list);
 
+   llvm->nr_tcs_variants = 0;
+   make_empty_list(&llvm->tcs_variants_list);
+
+   llvm->nr_tes_variants = 0;
+   make_empty_list(&llvm->tes_variants_list);
+
    return llvm;
 
 fail:
@@ -547,6 +555,8 @@ draw_llvm_create_variant(struct draw_llvm *llvm,
       llvm_vertex_shader(llvm->draw->vs.vertex_shader);
    LLVMTypeRef vertex_header;
    char module_name[64];
+   struct lp_cached_code cached;
+   struct mesa_sha1 *key_ctx;
 
    variant = MALLOC(sizeof *variant +
                     shader->variant_key_size -
@@ -560,7 +570,27 @@ draw_llvm_create_variant(struct draw_llvm *llvm,
    util_snprintf(module_name, sizeof(module_name), "draw_llvm_vs_variant%u",
                  variant->shader->variants_cached);
 
+   /*
+    * Besides the key, the generated code depends on the vertex elements
+    * and on a few outputs which are derived from the shader.
+    */
+   key_ctx = lp_cached_code_key_begin("vs");
+   lp_cached_code_key_update(key_ctx, shader->base.state.tokens,
+                             tgsi_num_tokens(shader->base.state.tokens) *
+                             sizeof(struct tgsi_token));
+   lp_cached_code_key_update(key_ctx, key, shader->variant_key_size);
+   lp_cached_code_key_update(key_ctx, &num_inputs, sizeof num_inputs);
+   lp_cached_code_key_update(key_ctx, &llvm->draw->vs.position_output,
+                             sizeof llvm->draw->vs.position_output);
+   lp_cached_code_key_update(key_ctx, &llvm->draw->vs.clipvertex_output,
+                             sizeof llvm->draw->vs.clipvertex_output);
+   lp_cached_code_key_update(key_ctx, llvm->draw->pt.vertex_element,
+                             llvm->draw->pt.nr_vertex_elements *
+                             sizeof llvm->draw->pt.vertex_element[0]);
+   lp_cached_code_init(&cached, key_ctx);
+
    variant->gallivm = gallivm_create(module_name, llvm->context);
+   variant->gallivm->cache = &cached;
 
    create_jit_types(variant);
 
@@ -588,6 +618,8 @@ draw_llvm_create_variant(struct draw_llvm *llvm,
 
    gallivm_free_ir(variant->gallivm);
 
+   lp_cached_code_finish(&cached);
+
    variant->list_item_global.base = variant;
    variant->list_item_local.base = variant;
    /*variant->no = */shader->variants_created++;
@@ -628,6 +660,8 @@ generate_vs(struct draw_llvm_variant *variant,
                      NULL,
                      draw_sampler,
                      &llvm->draw->vs.vertex_shader->info,
+                     NULL,
+                     NULL,
                      NULL);
 
    {
@@ -1555,19 +1589,21 @@ draw_llvm_generate(struct draw_llvm *llvm, struct draw_llvm_variant *variant,
    struct lp_build_sampler_soa *sampler = 0;
    LLVMValueRef ret, clipmask_bool_ptr;
    struct draw_llvm_variant_key *key = &variant->key;
-   /* If geometry shader is present we need to skip both the viewport
-    * transformation and clipping otherwise the inputs to the geometry
-    * shader will be incorrect.
+   /* If geometry or tessellation shaders are present we need to skip both
+    * the viewport transformation and clipping otherwise the inputs to the
+    * next shader stage will be incorrect.
     * The code can't handle vp transform when vs writes vp index neither
     * (though this would be fixable here, but couldn't just broadcast
     * the values).
     */
-   const boolean bypass_viewport = key->has_gs || key->bypass_viewport ||
+   const boolean bypass_viewport = key->has_gs || key->has_tes ||
+                                   key->bypass_viewport ||
                                    llvm->draw->vs.vertex_shader->info.writes_viewport_index;
-   const boolean enable_cliptest = !key->has_gs && (key->clip_xy ||
-                                                    key->clip_z ||
-                                                    key->clip_user ||
-                                                    key->need_edgeflags);
+   const boolean enable_cliptest = !key->has_gs && !key->has_tes &&
+                                   (key->clip_xy ||
+                                    key->clip_z ||
+                                    key->clip_user ||
+                                    key->need_edgeflags);
    LLVMValueRef variant_func;
    const unsigned pos = llvm->draw->vs.position_output;
    const unsigned cv = llvm->draw->vs.clipvertex_output;
@@ -1885,6 +1921,7 @@ draw_llvm_make_variant_key(struct draw_llvm *llvm, char *store)
    key->need_edgeflags = (llvm->draw->vs.edgeflag_output ? TRUE : FALSE);
    key->ucp_enable = llvm->draw->rasterizer->clip_plane_enable;
    key->has_gs = llvm->draw->gs.geometry_shader != NULL;
+   key->has_tes = llvm->draw->tes.tess_eval_shader != NULL;
    key->num_outputs = draw_total_vs_outputs(llvm->draw);
 
    /* All variants of this shader will have the same value for
@@ -1935,6 +1972,7 @@ draw_llvm_dump_variant_key(struct draw_llvm_variant_key *key)
    debug_printf("clip_halfz = %u\n", key->clip_halfz);
    debug_printf("need_edgeflags = %u\n", key->need_edgeflags);
    debug_printf("has_gs = %u\n", key->has_gs);
+   debug_printf("has_tes = %u\n", key->has_tes);
    debug_printf("ucp_enable = %u\n", key->ucp_enable);
 
    for (i = 0 ; i < key->nr_vertex_elements; i++) {
@@ -1965,7 +2003,9 @@ draw_llvm_set_mapped_texture(struct draw_context *draw,
    struct draw_jit_texture *jit_tex;
 
    assert(shader_stage == PIPE_SHADER_VERTEX ||
-          shader_stage == PIPE_SHADER_GEOMETRY);
+          shader_stage == PIPE_SHADER_GEOMETRY ||
+          shader_stage == PIPE_SHADER_TESS_CTRL ||
+          shader_stage == PIPE_SHADER_TESS_EVAL);
 
    if (shader_stage == PIPE_SHADER_VERTEX) {
       assert(sview_idx < ARRAY_SIZE(draw->llvm->jit_context.textures));
@@ -1975,6 +2015,14 @@ draw_llvm_set_mapped_texture(struct draw_context *draw,
       assert(sview_idx < ARRAY_SIZE(draw->llvm->gs_jit_context.textures));
 
       jit_tex = &draw->llvm->gs_jit_context.textures[sview_idx];
+   } else if (shader_stage == PIPE_SHADER_TESS_CTRL) {
+      assert(sview_idx < ARRAY_SIZE(draw->llvm->tcs_jit_context.textures));
+
+      jit_tex = &draw->llvm->tcs_jit_context.textures[sview_idx];
+   } else if (shader_stage == PIPE_SHADER_TESS_EVAL) {
+      assert(sview_idx < ARRAY_SIZE(draw->llvm->tes_jit_context.textures));
+
+      jit_tex = &draw->llvm->tes_jit_context.textures[sview_idx];
    } else {
       assert(0);
       return;
@@ -2027,6 +2075,24 @@ draw_llvm_set_sampler_state(struct draw_context *draw,
             COPY_4V(jit_sam->border_color, s->border_color.f);
          }
       }
+   } else if (shader_type == PIPE_SHADER_TESS_CTRL ||
+              shader_type == PIPE_SHADER_TESS_EVAL) {
+      struct draw_tess_jit_context *jit_context =
+         shader_type == PIPE_SHADER_TESS_CTRL ? &draw->llvm->tcs_jit_context :
+                                                &draw->llvm->tes_jit_context;
+
+      for (i = 0; i < draw->num_samplers[shader_type]; i++) {
+         struct draw_jit_sampler *jit_sam = &jit_context->samplers[i];
+
+         if (draw->samplers[shader_type][i]) {
+            const struct pipe_sampler_state *s
+               = draw->samplers[shader_type][i];
+            jit_sam->min_lod = s->min_lod;
+            jit_sam->max_lod = s->max_lod;
+            jit_sam->lod_bias = s->lod_bias;
+            COPY_4V(jit_sam->border_color, s->border_color.f);
+         }
+      }
    }
 }
 
@@ -2232,7 +2298,9 @@ draw_gs_llvm_generate(struct draw_llvm *llvm,
                      NULL,
                      sampler,
                      &llvm->draw->gs.geometry_shader->info,
-                     (const struct lp_build_tgsi_gs_iface *)&gs_iface);
+                     (const struct lp_build_tgsi_gs_iface *)&gs_iface,
+                     NULL,
+                     NULL);
 
    sampler->destroy(sampler);
 
@@ -2254,6 +2322,8 @@ draw_gs_llvm_create_variant(struct draw_llvm *llvm,
       llvm_geometry_shader(llvm->draw->gs.geometry_shader);
    LLVMTypeRef vertex_header;
    char module_name[64];
+   struct lp_cached_code cached;
+   struct mesa_sha1 *key_ctx;
 
    variant = MALLOC(sizeof *variant +
                     shader->variant_key_size -
@@ -2267,7 +2337,16 @@ draw_gs_llvm_create_variant(struct draw_llvm *llvm,
    util_snprintf(module_name, sizeof(module_name), "draw_llvm_gs_variant%u",
                  variant->shader->variants_cached);
 
+   key_ctx = lp_cached_code_key_begin("gs");
+   lp_cached_code_key_update(key_ctx, shader->base.state.tokens,
+                             tgsi_num_tokens(shader->base.state.tokens) *
+                             sizeof(struct tgsi_token));
+   lp_cached_code_key_update(key_ctx, key, shader->variant_key_size);
+   lp_cached_code_key_update(key_ctx, &num_outputs, sizeof num_outputs);
+   lp_cached_code_init(&cached, key_ctx);
+
    variant->gallivm = gallivm_create(module_name, llvm->context);
+   variant->gallivm->cache = &cached;
 
    create_gs_jit_types(variant);
 
@@ -2286,6 +2365,8 @@ draw_gs_llvm_create_variant(struct draw_llvm *llvm,
 
    gallivm_free_ir(variant->gallivm);
 
+   lp_cached_code_finish(&cached);
+
    variant->list_item_global.base = variant;
    variant->list_item_local.base = variant;
    /*variant->no = */shader->variants_created++;
@@ -2361,3 +2442,860 @@ draw_gs_llvm_dump_variant_key(struct draw_gs_llvm_variant_key *key)
                    util_format_name(sampler[i].texture_state.format));
    }
 }
+
+
+/**
+ * Create LLVM types for the tessellation shaders.
+ */
+static LLVMTypeRef
+create_tess_jit_context_ptr_type(struct gallivm_state *gallivm)
+{
+   LLVMTypeRef texture_type, sampler_type, context_type;
+
+   texture_type = create_jit_texture_type(gallivm, "texture");
+   sampler_type = create_jit_sampler_type(gallivm, "sampler");
+
+   /* draw_tess_jit_context has the same layout as draw_jit_context */
+   context_type = create_jit_context_type(gallivm, texture_type, sampler_type,
+                                          "draw_tess_jit_context");
+
+   return LLVMPointerType(context_type, 0);
+}
+
+
+/**
+ * Per-lane load of the floats at offsets from base_ptr.
+ *
+ * If the offsets are constant, all the lanes are reading the same attribute
+ * of the same vertex, and a single load is enough.
+ */
+static LLVMValueRef
+draw_tess_llvm_gather(struct lp_build_context *bld,
+                      LLVMValueRef base_ptr,
+                      LLVMValueRef offsets)
+{
+   struct gallivm_state *gallivm = bld->gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMValueRef res;
+   unsigned i;
+
+   if (LLVMIsConstant(offsets)) {
+      LLVMValueRef offset =
+         LLVMBuildExtractElement(builder, offsets,
+                                 lp_build_const_int32(gallivm, 0), "");
+      res = LLVMBuildLoad(builder,
+                          LLVMBuildGEP(builder, base_ptr, &offset, 1, ""), "");
+      return lp_build_broadcast_scalar(bld, res);
+   }
+
+   res = bld->undef;
+   for (i = 0; i < bld->type.length; ++i) {
+      LLVMValueRef idx = lp_build_const_int32(gallivm, i);
+      LLVMValueRef offset = LLVMBuildExtractElement(builder, offsets, idx, "");
+      LLVMValueRef value =
+         LLVMBuildLoad(builder,
+                       LLVMBuildGEP(builder, base_ptr, &offset, 1, ""), "");
+      res = LLVMBuildInsertElement(builder, res, value, idx, "");
+   }
+
+   return res;
+}
+
+
+/**
+ * Offsets, in floats, of an attribute channel in the [vertex][attrib][4]
+ * arrays passed to the tessellation shaders.
+ */
+static LLVMValueRef
+draw_tess_llvm_offsets(struct lp_build_context *uint_bld,
+                       LLVMValueRef vertex_index,
+                       LLVMValueRef attrib_index,
+                       unsigned num_attribs,
+                       unsigned swizzle)
+{
+   struct gallivm_state *gallivm = uint_bld->gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMValueRef offsets;
+
+   offsets = LLVMBuildMul(builder, vertex_index,
+                          lp_build_const_int_vec(gallivm, uint_bld->type,
+                                                 num_attribs), "");
+   offsets = LLVMBuildAdd(builder, offsets, attrib_index, "");
+   offsets = LLVMBuildMul(builder, offsets,
+                          lp_build_const_int_vec(gallivm, uint_bld->type, 4), "");
+   return LLVMBuildAdd(builder, offsets,
+                       lp_build_const_int_vec(gallivm, uint_bld->type,
+                                              swizzle), "");
+}
+
+
+struct draw_tcs_llvm_iface {
+   struct lp_build_tgsi_tess_iface base;
+
+   struct draw_tcs_llvm_variant *variant;
+   LLVMValueRef input;
+   LLVMValueRef output;
+   LLVMValueRef vertices_in;
+};
+
+static inline const struct draw_tcs_llvm_iface *
+draw_tcs_llvm_iface(const struct lp_build_tgsi_tess_iface *iface)
+{
+   return (const struct draw_tcs_llvm_iface *)iface;
+}
+
+
+/**
+ * Index of a control shader output row, [patch][vertices_out + 1], the
+ * per-patch outputs coming first.
+ */
+static LLVMValueRef
+draw_tcs_llvm_output_row(const struct draw_tcs_llvm_iface *tcs,
+                         struct lp_build_context *uint_bld,
+                         LLVMValueRef patch_index,
+                         LLVMValueRef vertex_index)
+{
+   struct gallivm_state *gallivm = uint_bld->gallivm;
+   unsigned vertices_out = tcs->variant->shader->base.vertices_out;
+   LLVMValueRef row;
+
+   row = lp_build_mul_imm(uint_bld, patch_index, vertices_out + 1);
+   if (vertex_index) {
+      vertex_index = lp_build_min(uint_bld, vertex_index,
+                                  lp_build_const_int_vec(gallivm, uint_bld->type,
+                                                         vertices_out - 1));
+      row = lp_build_add(uint_bld, row, vertex_index);
+      row = lp_build_add(uint_bld, row, uint_bld->one);
+   }
+   return row;
+}
+
+
+static LLVMValueRef
+draw_tcs_llvm_fetch_input(const struct lp_build_tgsi_tess_iface *tess_iface,
+                          struct lp_build_tgsi_context *bld_base,
+                          LLVMValueRef patch_index,
+                          LLVMValueRef vertex_index,
+                          LLVMValueRef attrib_index,
+                          unsigned swizzle)
+{
+   const struct draw_tcs_llvm_iface *tcs = draw_tcs_llvm_iface(tess_iface);
+   struct lp_build_context *uint_bld = &bld_base->uint_bld;
+   LLVMValueRef vertices_in = tcs->vertices_in;
+   LLVMValueRef row, offsets;
+
+   /* control shaders have no per-patch inputs */
+   if (!vertex_index)
+      return bld_base->base.zero;
+
+   vertex_index = lp_build_min(uint_bld, vertex_index,
+                               lp_build_sub(uint_bld, vertices_in,
+                                            uint_bld->one));
+   row = lp_build_mul(uint_bld, patch_index, vertices_in);
+   row = lp_build_add(uint_bld, row, vertex_index);
+
+   offsets = draw_tess_llvm_offsets(uint_bld, row, attrib_index,
+                                    tcs->variant->shader->base.info.num_inputs,
+                                    swizzle);
+   return draw_tess_llvm_gather(&bld_base->base, tcs->input, offsets);
+}
+
+
+static LLVMValueRef
+draw_tcs_llvm_fetch_output(const struct lp_build_tgsi_tess_iface *tess_iface,
+                           struct lp_build_tgsi_context *bld_base,
+                           LLVMValueRef patch_index,
+                           LLVMValueRef vertex_index,
+                           LLVMValueRef attrib_index,
+                           unsigned swizzle)
+{
+   const struct draw_tcs_llvm_iface *tcs = draw_tcs_llvm_iface(tess_iface);
+   struct lp_build_context *uint_bld = &bld_base->uint_bld;
+   LLVMValueRef row, offsets;
+
+   row = draw_tcs_llvm_output_row(tcs, uint_bld, patch_index, vertex_index);
+   offsets = draw_tess_llvm_offsets(uint_bld, row, attrib_index,
+                                    tcs->variant->shader->base.info.num_outputs,
+                                    swizzle);
+   return draw_tess_llvm_gather(&bld_base->base, tcs->output, offsets);
+}
+
+
+static void
+draw_tcs_llvm_store_output(const struct lp_build_tgsi_tess_iface *tess_iface,
+                           struct lp_build_tgsi_context *bld_base,
+                           LLVMValueRef patch_index,
+                           LLVMValueRef vertex_index,
+                           LLVMValueRef attrib_index,
+                           unsigned swizzle,
+                           LLVMValueRef value,
+                           LLVMValueRef mask)
+{
+   const struct draw_tcs_llvm_iface *tcs = draw_tcs_llvm_iface(tess_iface);
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_build_context *uint_bld = &bld_base->uint_bld;
+   LLVMValueRef row, offsets;
+   unsigned i;
+
+   row = draw_tcs_llvm_output_row(tcs, uint_bld, patch_index, vertex_index);
+   offsets = draw_tess_llvm_offsets(uint_bld, row, attrib_index,
+                                    tcs->variant->shader->base.info.num_outputs,
+                                    swizzle);
+
+   /*
+    * Lanes may write to the same location (e.g. the per-patch outputs), so
+    * they are stored one at a time, in order.
+    */
+   for (i = 0; i < bld_base->base.type.length; ++i) {
+      LLVMValueRef idx = lp_build_const_int32(gallivm, i);
+      LLVMValueRef offset = LLVMBuildExtractElement(builder, offsets, idx, "");
+      LLVMValueRef ptr = LLVMBuildGEP(builder, tcs->output, &offset, 1, "");
+      LLVMValueRef cond = LLVMBuildExtractElement(builder, mask, idx, "");
+      LLVMValueRef val = LLVMBuildExtractElement(builder, value, idx, "");
+      LLVMValueRef old = LLVMBuildLoad(builder, ptr, "");
+
+      cond = LLVMBuildICmp(builder, LLVMIntNE, cond,
+                           LLVMConstNull(LLVMTypeOf(cond)), "");
+      LLVMBuildStore(builder, LLVMBuildSelect(builder, cond, val, old, ""), ptr);
+   }
+}
+
+
+static void
+draw_tcs_llvm_generate(struct draw_llvm *llvm,
+                       struct draw_tcs_llvm_variant *variant)
+{
+   struct gallivm_state *gallivm = variant->gallivm;
+   LLVMContextRef context = gallivm->context;
+   LLVMTypeRef int32_type = LLVMInt32TypeInContext(context);
+   LLVMTypeRef float_ptr_type =
+      LLVMPointerType(LLVMFloatTypeInContext(context), 0);
+   LLVMTypeRef arg_types[6];
+   LLVMTypeRef func_type;
+   LLVMValueRef variant_func;
+   LLVMValueRef context_ptr, input_ptr, output_ptr, vertices_in, prim_id;
+   LLVMValueRef scratch_ptr;
+   LLVMBasicBlockRef block;
+   LLVMBuilderRef builder;
+   LLVMValueRef consts_ptr, num_consts_ptr;
+   struct lp_build_sampler_soa *sampler;
+   struct lp_build_context uint_bld;
+   struct lp_bld_tgsi_system_values system_values;
+   struct lp_build_tgsi_cs_params cs_params;
+   struct draw_tcs_llvm_iface tcs_iface;
+   const struct draw_tess_ctrl_shader *tcs = &variant->shader->base;
+   const struct tgsi_token *tokens = tcs->state.tokens;
+   char func_name[64];
+   struct lp_type tcs_type;
+   unsigned i;
+
+   memset(&system_values, 0, sizeof(system_values));
+   memset(&cs_params, 0, sizeof(cs_params));
+
+   util_snprintf(func_name, sizeof(func_name), "draw_llvm_tcs_variant%u",
+                 variant->shader->variants_cached);
+
+   arg_types[0] = variant->context_ptr_type;           /* context */
+   arg_types[1] = float_ptr_type;                      /* input */
+   arg_types[2] = float_ptr_type;                      /* output */
+   arg_types[3] = int32_type;                          /* vertices_in */
+   arg_types[4] = int32_type;                          /* prim_id */
+   arg_types[5] = LLVMPointerType(LLVMInt8TypeInContext(context), 0); /* scratch */
+
+   func_type = LLVMFunctionType(LLVMVoidTypeInContext(context), arg_types,
+                                ARRAY_SIZE(arg_types), 0);
+
+   variant_func = LLVMAddFunction(gallivm->module, func_name, func_type);
+
+   variant->function = variant_func;
+
+   LLVMSetFunctionCallConv(variant_func, LLVMCCallConv);
+
+   for (i = 0; i < ARRAY_SIZE(arg_types); ++i)
+      if (LLVMGetTypeKind(arg_types[i]) == LLVMPointerTypeKind)
+         LLVMAddAttribute(LLVMGetParam(variant_func, i),
+                          LLVMNoAliasAttribute);
+
+   context_ptr  = LLVMGetParam(variant_func, 0);
+   input_ptr    = LLVMGetParam(variant_func, 1);
+   output_ptr   = LLVMGetParam(variant_func, 2);
+   vertices_in  = LLVMGetParam(variant_func, 3);
+   prim_id      = LLVMGetParam(variant_func, 4);
+   scratch_ptr  = LLVMGetParam(variant_func, 5);
+
+   lp_build_name(context_ptr, "context");
+   lp_build_name(input_ptr, "input");
+   lp_build_name(output_ptr, "output");
+   lp_build_name(vertices_in, "vertices_in");
+   lp_build_name(prim_id, "prim_id");
+   lp_build_name(scratch_ptr, "scratch");
+
+   /*
+    * Function body
+    */
+
+   block = LLVMAppendBasicBlockInContext(gallivm->context, variant_func, "entry");
+   builder = gallivm->builder;
+   LLVMPositionBuilderAtEnd(builder, block);
+
+   memset(&tcs_type, 0, sizeof tcs_type);
+   tcs_type.floating = TRUE; /* floating point values */
+   tcs_type.sign = TRUE;     /* values are signed */
+   tcs_type.norm = FALSE;    /* values are not limited to [0,1] or [-1,1] */
+   tcs_type.width = 32;      /* 32-bit float */
+   tcs_type.length = tcs->vector_length;
+
+   lp_build_context_init(&uint_bld, gallivm, lp_uint_type(tcs_type));
+
+   system_values.prim_id = lp_build_broadcast_scalar(&uint_bld, prim_id);
+   system_values.vertices_in = lp_build_broadcast_scalar(&uint_bld, vertices_in);
+
+   /* one invocation per output vertex, of vector_length patches */
+   cs_params.block_size[0] = tcs->vertices_out;
+   cs_params.block_size[1] = tcs->vector_length;
+   cs_params.block_size[2] = 1;
+   cs_params.regs_ptr = scratch_ptr;
+
+   tcs_iface.base.fetch_input = draw_tcs_llvm_fetch_input;
+   tcs_iface.base.fetch_output = draw_tcs_llvm_fetch_output;
+   tcs_iface.base.store_output = draw_tcs_llvm_store_output;
+   tcs_iface.variant = variant;
+   tcs_iface.input = input_ptr;
+   tcs_iface.output = output_ptr;
+   tcs_iface.vertices_in = system_values.vertices_in;
+
+   consts_ptr = draw_jit_context_vs_constants(gallivm, context_ptr);
+   num_consts_ptr = draw_jit_context_num_vs_constants(gallivm, context_ptr);
+
+   /* code generated texture sampling */
+   sampler = draw_llvm_sampler_soa_create(variant->key.samplers);
+
+   if (gallivm_debug & (GALLIVM_DEBUG_TGSI | GALLIVM_DEBUG_IR)) {
+      tgsi_dump(tokens, 0);
+      draw_tess_llvm_dump_variant_key(&variant->key);
+   }
+
+   lp_build_tgsi_soa(gallivm,
+                     tokens,
+                     tcs_type,
+                     NULL,
+                     consts_ptr,
+                     num_consts_ptr,
+                     &system_values,
+                     NULL,
+                     NULL,
+                     context_ptr,
+                     NULL,
+                     sampler,
+                     &tcs->info,
+                     NULL,
+                     (const struct lp_build_tgsi_tess_iface *)&tcs_iface,
+                     &cs_params);
+
+   sampler->destroy(sampler);
+
+   LLVMBuildRetVoid(builder);
+
+   gallivm_verify_function(gallivm, variant_func);
+}
+
+
+struct draw_tcs_llvm_variant *
+draw_tcs_llvm_create_variant(struct draw_llvm *llvm,
+                             const struct draw_tess_llvm_variant_key *key)
+{
+   struct draw_tcs_llvm_variant *variant;
+   struct llvm_tess_ctrl_shader *shader =
+      llvm_tess_ctrl_shader(llvm->draw->tcs.tess_ctrl_shader);
+   const struct draw_tess_ctrl_shader *tcs = &shader->base;
+   char module_name[64];
+   struct lp_cached_code cached;
+   struct mesa_sha1 *key_ctx;
+   struct lp_type tcs_type;
+   unsigned block_size[3];
+
+   variant = MALLOC(sizeof *variant +
+                    shader->variant_key_size -
+                    sizeof variant->key);
+   if (!variant)
+      return NULL;
+
+   variant->llvm = llvm;
+   variant->shader = shader;
+
+   memset(&tcs_type, 0, sizeof tcs_type);
+   tcs_type.floating = TRUE;
+   tcs_type.sign = TRUE;
+   tcs_type.width = 32;
+   tcs_type.length = tcs->vector_length;
+
+   block_size[0] = tcs->vertices_out;
+   block_size[1] = tcs->vector_length;
+   block_size[2] = 1;
+
+   variant->scratch_size = lp_build_tgsi_cs_regs_size(&tcs->info, tcs_type,
+                                                      block_size);
+   variant->scratch = NULL;
+   if (variant->scratch_size) {
+      variant->scratch = align_malloc(variant->scratch_size, 16);
+      if (!variant->scratch) {
+         FREE(variant);
+         return NULL;
+      }
+   }
+
+   util_snprintf(module_name, sizeof(module_name), "draw_llvm_tcs_variant%u",
+                 variant->shader->variants_cached);
+
+   key_ctx = lp_cached_code_key_begin("tcs");
+   lp_cached_code_key_update(key_ctx, tcs->state.tokens,
+                             tgsi_num_tokens(tcs->state.tokens) *
+                             sizeof(struct tgsi_token));
+   lp_cached_code_key_update(key_ctx, key, shader->variant_key_size);
+   lp_cached_code_key_update(key_ctx, &tcs->vector_length,
+                             sizeof tcs->vector_length);
+   lp_cached_code_init(&cached, key_ctx);
+
+   variant->gallivm = gallivm_create(module_name, llvm->context);
+   variant->gallivm->cache = &cached;
+
+   variant->context_ptr_type =
+      create_tess_jit_context_ptr_type(variant->gallivm);
+
+   memcpy(&variant->key, key, shader->variant_key_size);
+
+   draw_tcs_llvm_generate(llvm, variant);
+
+   gallivm_compile_module(variant->gallivm);
+
+   variant->jit_func = (draw_tcs_jit_func)
+         gallivm_jit_function(variant->gallivm, variant->function);
+
+   gallivm_free_ir(variant->gallivm);
+
+   lp_cached_code_finish(&cached);
+
+   variant->list_item_global.base = variant;
+   variant->list_item_local.base = variant;
+   /*variant->no = */shader->variants_created++;
+
+   return variant;
+}
+
+
+void
+draw_tcs_llvm_destroy_variant(struct draw_tcs_llvm_variant *variant)
+{
+   struct draw_llvm *llvm = variant->llvm;
+
+   gallivm_destroy(variant->gallivm);
+
+   remove_from_list(&variant->list_item_local);
+   variant->shader->variants_cached--;
+   remove_from_list(&variant->list_item_global);
+   llvm->nr_tcs_variants--;
+   align_free(variant->scratch);
+   FREE(variant);
+}
+
+
+struct draw_tes_llvm_iface {
+   struct lp_build_tgsi_tess_iface base;
+
+   struct draw_tes_llvm_variant *variant;
+   LLVMValueRef input;
+};
+
+static inline const struct draw_tes_llvm_iface *
+draw_tes_llvm_iface(const struct lp_build_tgsi_tess_iface *iface)
+{
+   return (const struct draw_tes_llvm_iface *)iface;
+}
+
+
+static LLVMValueRef
+draw_tes_llvm_fetch_input(const struct lp_build_tgsi_tess_iface *tess_iface,
+                          struct lp_build_tgsi_context *bld_base,
+                          LLVMValueRef patch_index,
+                          LLVMValueRef vertex_index,
+                          LLVMValueRef attrib_index,
+                          unsigned swizzle)
+{
+   const struct draw_tes_llvm_iface *tes = draw_tes_llvm_iface(tess_iface);
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   struct lp_build_context *uint_bld = &bld_base->uint_bld;
+   LLVMValueRef row, offsets;
+
+   /* the per-patch inputs are in the first row, patch_index is always 0 */
+   (void) patch_index;
+   if (vertex_index) {
+      if (!LLVMIsConstant(vertex_index)) {
+         vertex_index =
+            lp_build_min(uint_bld, vertex_index,
+                         lp_build_const_int_vec(gallivm, uint_bld->type,
+                                                DRAW_TESS_MAX_PATCH_VERTICES - 1));
+      }
+      row = LLVMBuildAdd(gallivm->builder, vertex_index, uint_bld->one, "");
+   }
+   else {
+      row = uint_bld->zero;
+   }
+
+   offsets = draw_tess_llvm_offsets(uint_bld, row, attrib_index,
+                                    tes->variant->shader->base.info.num_inputs,
+                                    swizzle);
+   return draw_tess_llvm_gather(&bld_base->base, tes->input, offsets);
+}
+
+
+static void
+draw_tes_llvm_generate(struct draw_llvm *llvm,
+                       struct draw_tes_llvm_variant *variant)
+{
+   struct gallivm_state *gallivm = variant->gallivm;
+   LLVMContextRef context = gallivm->context;
+   LLVMTypeRef int32_type = LLVMInt32TypeInContext(context);
+   LLVMTypeRef float_ptr_type =
+      LLVMPointerType(LLVMFloatTypeInContext(context), 0);
+   LLVMTypeRef arg_types[10];
+   LLVMTypeRef func_type;
+   LLVMValueRef variant_func;
+   LLVMValueRef context_ptr, input_ptr, io_ptr, u_ptr, v_ptr;
+   LLVMValueRef num_points, vertices_in, prim_id, outer_ptr, inner_ptr;
+   LLVMBasicBlockRef block;
+   LLVMBuilderRef builder;
+   LLVMValueRef consts_ptr, num_consts_ptr;
+   LLVMTypeRef vec_ptr_type;
+   struct lp_build_sampler_soa *sampler;
+   struct lp_build_context bld, uint_bld;
+   struct lp_build_loop_state lp_loop;
+   struct lp_bld_tgsi_system_values system_values;
+   struct draw_tes_llvm_iface tes_iface;
+   LLVMValueRef outputs[PIPE_MAX_SHADER_OUTPUTS][TGSI_NUM_CHANNELS];
+   const struct draw_tess_eval_shader *tes = &variant->shader->base;
+   const struct tgsi_token *tokens = tes->state.tokens;
+   const unsigned vector_length = lp_native_vector_width / 32;
+   char func_name[64];
+   struct lp_type tes_type;
+   unsigned i;
+
+   memset(&system_values, 0, sizeof(system_values));
+
+   util_snprintf(func_name, sizeof(func_name), "draw_llvm_tes_variant%u",
+                 variant->shader->variants_cached);
+
+   arg_types[0] = variant->context_ptr_type;           /* context */
+   arg_types[1] = float_ptr_type;                      /* input */
+   arg_types[2] = variant->vertex_header_ptr_type;     /* vertex_header */
+   arg_types[3] = float_ptr_type;                      /* tess_coord_u */
+   arg_types[4] = float_ptr_type;                      /* tess_coord_v */
+   arg_types[5] = int32_type;                          /* num_points */
+   arg_types[6] = int32_type;                          /* vertices_in */
+   arg_types[7] = int32_type;                          /* prim_id */
+   arg_types[8] = float_ptr_type;                      /* tess_outer */
+   arg_types[9] = float_ptr_type;                      /* tess_inner */
+
+   func_type = LLVMFunctionType(LLVMVoidTypeInContext(context), arg_types,
+                                ARRAY_SIZE(arg_types), 0);
+
+   variant_func = LLVMAddFunction(gallivm->module, func_name, func_type);
+
+   variant->function = variant_func;
+
+   LLVMSetFunctionCallConv(variant_func, LLVMCCallConv);
+
+   for (i = 0; i < ARRAY_SIZE(arg_types); ++i)
+      if (LLVMGetTypeKind(arg_types[i]) == LLVMPointerTypeKind)
+         LLVMAddAttribute(LLVMGetParam(variant_func, i),
+                          LLVMNoAliasAttribute);
+
+   context_ptr  = LLVMGetParam(variant_func, 0);
+   input_ptr    = LLVMGetParam(variant_func, 1);
+   io_ptr       = LLVMGetParam(variant_func, 2);
+   u_ptr        = LLVMGetParam(variant_func, 3);
+   v_ptr        = LLVMGetParam(variant_func, 4);
+   num_points   = LLVMGetParam(variant_func, 5);
+   vertices_in  = LLVMGetParam(variant_func, 6);
+   prim_id      = LLVMGetParam(variant_func, 7);
+   outer_ptr    = LLVMGetParam(variant_func, 8);
+   inner_ptr    = LLVMGetParam(variant_func, 9);
+
+   lp_build_name(context_ptr, "context");
+   lp_build_name(input_ptr, "input");
+   lp_build_name(io_ptr, "io");
+   lp_build_name(u_ptr, "tess_coord_u");
+   lp_build_name(v_ptr, "tess_coord_v");
+   lp_build_name(num_points, "num_points");
+   lp_build_name(vertices_in, "vertices_in");
+   lp_build_name(prim_id, "prim_id");
+   lp_build_name(outer_ptr, "tess_outer");
+   lp_build_name(inner_ptr, "tess_inner");
+
+   /*
+    * Function body
+    */
+
+   block = LLVMAppendBasicBlockInContext(gallivm->context, variant_func, "entry");
+   builder = gallivm->builder;
+   LLVMPositionBuilderAtEnd(builder, block);
+
+   memset(&tes_type, 0, sizeof tes_type);
+   tes_type.floating = TRUE; /* floating point values */
+   tes_type.sign = TRUE;     /* values are signed */
+   tes_type.norm = FALSE;    /* values are not limited to [0,1] or [-1,1] */
+   tes_type.width = 32;      /* 32-bit float */
+   tes_type.length = vector_length;
+
+   lp_build_context_init(&bld, gallivm, tes_type);
+   lp_build_context_init(&uint_bld, gallivm, lp_uint_type(tes_type));
+
+   /* The per-patch system values are the same for all the points */
+   system_values.prim_id = lp_build_broadcast_scalar(&uint_bld, prim_id);
+   system_values.vertices_in = lp_build_broadcast_scalar(&uint_bld, vertices_in);
+   for (i = 0; i < 4; i++) {
+      LLVMValueRef idx = lp_build_const_int32(gallivm, i);
+      system_values.tess_outer[i] =
+         lp_build_broadcast_scalar(&bld,
+            LLVMBuildLoad(builder, LLVMBuildGEP(builder, outer_ptr, &idx, 1, ""), ""));
+   }
+   for (i = 0; i < 2; i++) {
+      LLVMValueRef idx = lp_build_const_int32(gallivm, i);
+      system_values.tess_inner[i] =
+         lp_build_broadcast_scalar(&bld,
+            LLVMBuildLoad(builder, LLVMBuildGEP(builder, inner_ptr, &idx, 1, ""), ""));
+   }
+
+   tes_iface.base.fetch_input = draw_tes_llvm_fetch_input;
+   tes_iface.base.fetch_output = NULL;
+   tes_iface.base.store_output = NULL;
+   tes_iface.variant = variant;
+   tes_iface.input = input_ptr;
+
+   consts_ptr = draw_jit_context_vs_constants(gallivm, context_ptr);
+   num_consts_ptr = draw_jit_context_num_vs_constants(gallivm, context_ptr);
+
+   /* code generated texture sampling */
+   sampler = draw_llvm_sampler_soa_create(variant->key.samplers);
+
+   if (gallivm_debug & (GALLIVM_DEBUG_TGSI | GALLIVM_DEBUG_IR)) {
+      tgsi_dump(tokens, 0);
+      draw_tess_llvm_dump_variant_key(&variant->key);
+   }
+
+   vec_ptr_type = LLVMPointerType(bld.vec_type, 0);
+
+   /*
+    * The domain points are processed a vector at a time, the coordinate
+    * arrays being padded accordingly, and so are the vertices.
+    */
+   lp_build_loop_begin(&lp_loop, gallivm, lp_build_const_int32(gallivm, 0));
+   {
+      LLVMValueRef io, u, v, zero = lp_build_const_int32(gallivm, 0);
+
+      io = LLVMBuildGEP(builder, io_ptr, &lp_loop.counter, 1, "");
+
+      u = LLVMBuildGEP(builder, u_ptr, &lp_loop.counter, 1, "");
+      u = LLVMBuildBitCast(builder, u, vec_ptr_type, "");
+      u = lp_build_pointer_get_unaligned(builder, u, zero, sizeof(float));
+      v = LLVMBuildGEP(builder, v_ptr, &lp_loop.counter, 1, "");
+      v = LLVMBuildBitCast(builder, v, vec_ptr_type, "");
+      v = lp_build_pointer_get_unaligned(builder, v, zero, sizeof(float));
+
+      system_values.tess_coord[0] = u;
+      system_values.tess_coord[1] = v;
+      if (tes->prim_mode == PIPE_PRIM_TRIANGLES)
+         system_values.tess_coord[2] =
+            lp_build_sub(&bld, lp_build_sub(&bld, bld.one, u), v);
+      else
+         system_values.tess_coord[2] = bld.zero;
+
+      lp_build_tgsi_soa(gallivm,
+                        tokens,
+                        tes_type,
+                        NULL,
+                        consts_ptr,
+                        num_consts_ptr,
+                        &system_values,
+                        NULL,
+                        outputs,
+                        context_ptr,
+                        NULL,
+                        sampler,
+                        &tes->info,
+                        NULL,
+                        (const struct lp_build_tgsi_tess_iface *)&tes_iface,
+                        NULL);
+
+      convert_to_aos(gallivm, io, NULL, outputs,
+                     lp_build_const_int_vec(gallivm, lp_int_type(tes_type), 0),
+                     tes->info.num_outputs, tes_type, FALSE);
+   }
+   lp_build_loop_end_cond(&lp_loop, num_points,
+                          lp_build_const_int32(gallivm, vector_length),
+                          LLVMIntUGE);
+
+   sampler->destroy(sampler);
+
+   LLVMBuildRetVoid(builder);
+
+   gallivm_verify_function(gallivm, variant_func);
+}
+
+
+struct draw_tes_llvm_variant *
+draw_tes_llvm_create_variant(struct draw_llvm *llvm,
+                             unsigned num_outputs,
+                             const struct draw_tess_llvm_variant_key *key)
+{
+   struct draw_tes_llvm_variant *variant;
+   struct llvm_tess_eval_shader *shader =
+      llvm_tess_eval_shader(llvm->draw->tes.tess_eval_shader);
+   const struct draw_tess_eval_shader *tes = &shader->base;
+   LLVMTypeRef vertex_header;
+   char module_name[64];
+   struct lp_cached_code cached;
+   struct mesa_sha1 *key_ctx;
+   unsigned vector_length = lp_native_vector_width / 32;
+
+   variant = MALLOC(sizeof *variant +
+                    shader->variant_key_size -
+                    sizeof variant->key);
+   if (!variant)
+      return NULL;
+
+   variant->llvm = llvm;
+   variant->shader = shader;
+
+   util_snprintf(module_name, sizeof(module_name), "draw_llvm_tes_variant%u",
+                 variant->shader->variants_cached);
+
+   key_ctx = lp_cached_code_key_begin("tes");
+   lp_cached_code_key_update(key_ctx, tes->state.tokens,
+                             tgsi_num_tokens(tes->state.tokens) *
+                             sizeof(struct tgsi_token));
+   lp_cached_code_key_update(key_ctx, key, shader->variant_key_size);
+   lp_cached_code_key_update(key_ctx, &num_outputs, sizeof num_outputs);
+   lp_cached_code_key_update(key_ctx, &vector_length, sizeof vector_length);
+   lp_cached_code_init(&cached, key_ctx);
+
+   variant->gallivm = gallivm_create(module_name, llvm->context);
+   variant->gallivm->cache = &cached;
+
+   variant->context_ptr_type =
+      create_tess_jit_context_ptr_type(variant->gallivm);
+
+   memcpy(&variant->key, key, shader->variant_key_size);
+
+   vertex_header = create_jit_vertex_header(variant->gallivm, num_outputs);
+
+   variant->vertex_header_ptr_type = LLVMPointerType(vertex_header, 0);
+
+   draw_tes_llvm_generate(llvm, variant);
+
+   gallivm_compile_module(variant->gallivm);
+
+   variant->jit_func = (draw_tes_jit_func)
+         gallivm_jit_function(variant->gallivm, variant->function);
+
+   gallivm_free_ir(variant->gallivm);
+
+   lp_cached_code_finish(&cached);
+
+   variant->list_item_global.base = variant;
+   variant->list_item_local.base = variant;
+   /*variant->no = */shader->variants_created++;
+
+   return variant;
+}
+
+
+void
+draw_tes_llvm_destroy_variant(struct draw_tes_llvm_variant *variant)
+{
+   struct draw_llvm *llvm = variant->llvm;
+
+   gallivm_destroy(variant->gallivm);
+
+   remove_from_list(&variant->list_item_local);
+   variant->shader->variants_cached--;
+   remove_from_list(&variant->list_item_global);
+   llvm->nr_tes_variants--;
+   FREE(variant);
+}
+
+
+static struct draw_tess_llvm_variant_key *
+draw_tess_llvm_make_variant_key(struct draw_llvm *llvm, char *store,
+                                unsigned shader_type,
+                                const struct tgsi_shader_info *info,
+                                unsigned num_outputs)
+{
+   unsigned i;
+   struct draw_tess_llvm_variant_key *key;
+   struct draw_sampler_static_state *draw_sampler;
+
+   key = (struct draw_tess_llvm_variant_key *)store;
+
+   memset(key, 0, offsetof(struct draw_tess_llvm_variant_key, samplers[0]));
+
+   key->num_outputs = num_outputs;
+
+   /* All variants of this shader will have the same value for
+    * nr_samplers.  Not yet trying to compact away holes in the
+    * sampler array.
+    */
+   key->nr_samplers = info->file_max[TGSI_FILE_SAMPLER] + 1;
+   if (info->file_max[TGSI_FILE_SAMPLER_VIEW] != -1) {
+      key->nr_sampler_views = info->file_max[TGSI_FILE_SAMPLER_VIEW] + 1;
+   }
+   else {
+      key->nr_sampler_views = key->nr_samplers;
+   }
+
+   draw_sampler = key->samplers;
+
+   memset(draw_sampler, 0, MAX2(key->nr_samplers, key->nr_sampler_views) * sizeof *draw_sampler);
+
+   for (i = 0 ; i < key->nr_samplers; i++) {
+      lp_sampler_static_sampler_state(&draw_sampler[i].sampler_state,
+                                      llvm->draw->samplers[shader_type][i]);
+   }
+   for (i = 0 ; i < key->nr_sampler_views; i++) {
+      lp_sampler_static_texture_state(&draw_sampler[i].texture_state,
+                                      llvm->draw->sampler_views[shader_type][i]);
+   }
+
+   return key;
+}
+
+struct draw_tess_llvm_variant_key *
+draw_tcs_llvm_make_variant_key(struct draw_llvm *llvm, char *store)
+{
+   const struct draw_tess_ctrl_shader *tcs = llvm->draw->tcs.tess_ctrl_shader;
+
+   return draw_tess_llvm_make_variant_key(llvm, store, PIPE_SHADER_TESS_CTRL,
+                                          &tcs->info, tcs->info.num_outputs);
+}
+
+struct draw_tess_llvm_variant_key *
+draw_tes_llvm_make_variant_key(struct draw_llvm *llvm, char *store)
+{
+   const struct draw_tess_eval_shader *tes = llvm->draw->tes.tess_eval_shader;
+
+   return draw_tess_llvm_make_variant_key(llvm, store, PIPE_SHADER_TESS_EVAL,
+                                          &tes->info,
+                                          draw_total_tes_outputs(llvm->draw));
+}
+
+void
+draw_tess_llvm_dump_variant_key(struct draw_tess_llvm_variant_key *key)
+{
+   unsigned i;
+   struct draw_sampler_static_state *sampler = key->samplers;
+
+   for (i = 0 ; i < key->nr_sampler_views; i++) {
+      debug_printf("sampler[%i].src_format = %s\n", i,
+                   util_format_name(sampler[i].texture_state.format));
+   }
+}
@@ -32,6 +32,7 @@
 
 #include "draw/draw_vs.h"
 #include "draw/draw_gs.h"
+#include "draw/draw_tess.h"
 
 #include "gallivm/lp_bld_sample.h"
 #include "gallivm/lp_bld_limits.h"
@@ -43,6 +44,8 @@
 struct draw_llvm;
 struct llvm_vertex_shader;
 struct llvm_geometry_shader;
+struct llvm_tess_ctrl_shader;
+struct llvm_tess_eval_shader;
 
 struct draw_jit_texture
 {
@@ -261,6 +264,26 @@ enum {
 
 
 
+/**
+ * This structure is passed directly to the generated tessellation control
+ * and evaluation shaders.
+ *
+ * It has the same layout as draw_jit_context, so that the same LLVM type
+ * and accessors can be used, and in particular the textures and samplers
+ * are at DRAW_JIT_CTX_TEXTURES and DRAW_JIT_CTX_SAMPLERS.
+ */
+struct draw_tess_jit_context
+{
+   const float *constants[LP_MAX_TGSI_CONST_BUFFERS];
+   int num_constants[LP_MAX_TGSI_CONST_BUFFERS];
+   float (*planes) [DRAW_TOTAL_CLIP_PLANES][4];
+   struct pipe_viewport_state *viewports;
+
+   struct draw_jit_texture textures[PIPE_MAX_SHADER_SAMPLER_VIEWS];
+   struct draw_jit_sampler samplers[PIPE_MAX_SAMPLERS];
+};
+
+
 typedef int
 (*draw_jit_vert_func)(struct draw_jit_context *context,
                       struct vertex_header *io,
@@ -297,6 +320,43 @@ typedef int
                     int *prim_ids,
                     unsigned invocation_id);
 
+/**
+ * Process a batch of draw_tess_ctrl_shader::vector_length patches.
+ *
+ * \param input  per-vertex inputs, [patch][vertices_in][num_inputs][4]
+ * \param output  outputs, [patch][vertices_out + 1][num_outputs][4], the
+ *                per-patch outputs being the first row of each patch
+ * \param prim_id  primitive id of the first patch of the batch
+ * \param scratch  draw_tcs_llvm_variant::scratch_size bytes
+ */
+typedef void
+(*draw_tcs_jit_func)(struct draw_tess_jit_context *context,
+                     const float *input,
+                     float *output,
+                     unsigned vertices_in,
+                     unsigned prim_id,
+                     void *scratch);
+
+/**
+ * Evaluate num_points domain points of a patch.
+ *
+ * \param input  [vertices_in + 1][num_inputs][4], the per-patch inputs
+ *               being the first row
+ * \param tess_coord_u  u coordinates, padded to the vector length
+ * \param tess_coord_v  v coordinates, padded to the vector length
+ */
+typedef void
+(*draw_tes_jit_func)(struct draw_tess_jit_context *context,
+                     const float *input,
+                     struct vertex_header *io,
+                     const float *tess_coord_u,
+                     const float *tess_coord_v,
+                     unsigned num_points,
+                     unsigned vertices_in,
+                     unsigned prim_id,
+                     const float *tess_outer,
+                     const float *tess_inner);
+
 struct draw_llvm_variant_key
 {
    unsigned nr_vertex_elements:8;
@@ -310,6 +370,7 @@ struct draw_llvm_variant_key
    unsigned bypass_viewport:1;
    unsigned need_edgeflags:1;
    unsigned has_gs:1;
+   unsigned has_tes:1;
    unsigned num_outputs:8;
    unsigned ucp_enable:PIPE_MAX_CLIP_PLANES;
    /* note padding here - must use memset */
@@ -333,6 +394,16 @@ struct draw_gs_llvm_variant_key
    struct draw_sampler_static_state samplers[1];
 };
 
+struct draw_tess_llvm_variant_key
+{
+   unsigned nr_samplers:8;
+   unsigned nr_sampler_views:8;
+   unsigned num_outputs:8;
+   /* note padding here - must use memset */
+
+   struct draw_sampler_static_state samplers[1];
+};
+
 #define DRAW_LLVM_MAX_VARIANT_KEY_SIZE \
    (sizeof(struct draw_llvm_variant_key) +	\
     PIPE_MAX_SHADER_SAMPLER_VIEWS * sizeof(struct draw_sampler_static_state) +	\
@@ -342,6 +413,10 @@ struct draw_gs_llvm_variant_key
    (sizeof(struct draw_gs_llvm_variant_key) +	\
     PIPE_MAX_SHADER_SAMPLER_VIEWS * sizeof(struct draw_sampler_static_state))
 
+#define DRAW_TESS_LLVM_MAX_VARIANT_KEY_SIZE \
+   (sizeof(struct draw_tess_llvm_variant_key) +	\
+    PIPE_MAX_SHADER_SAMPLER_VIEWS * sizeof(struct draw_sampler_static_state))
+
 
 static inline size_t
 draw_llvm_variant_key_size(unsigned nr_vertex_elements,
@@ -361,6 +436,14 @@ draw_gs_llvm_variant_key_size(unsigned nr_samplers)
 }
 
 
+static inline size_t
+draw_tess_llvm_variant_key_size(unsigned nr_samplers)
+{
+   return (sizeof(struct draw_tess_llvm_variant_key) +
+           (nr_samplers - 1) * sizeof(struct draw_sampler_static_state));
+}
+
+
 static inline struct draw_sampler_static_state *
 draw_llvm_variant_key_samplers(struct draw_llvm_variant_key *key)
 {
@@ -381,6 +464,18 @@ struct draw_gs_llvm_variant_list_item
    struct draw_gs_llvm_variant_list_item *next, *prev;
 };
 
+struct draw_tcs_llvm_variant_list_item
+{
+   struct draw_tcs_llvm_variant *base;
+   struct draw_tcs_llvm_variant_list_item *next, *prev;
+};
+
+struct draw_tes_llvm_variant_list_item
+{
+   struct draw_tes_llvm_variant *base;
+   struct draw_tes_llvm_variant_list_item *next, *prev;
+};
+
 
 struct draw_llvm_variant
 {
@@ -433,6 +528,52 @@ struct draw_gs_llvm_variant
    struct draw_gs_llvm_variant_key key;
 };
 
+struct draw_tcs_llvm_variant
+{
+   struct gallivm_state *gallivm;
+
+   /* LLVM JIT builder types */
+   LLVMTypeRef context_ptr_type;
+
+   LLVMValueRef function;
+   draw_tcs_jit_func jit_func;
+
+   /** Storage for the temporaries, if the shader has barriers */
+   unsigned scratch_size;
+   void *scratch;
+
+   struct llvm_tess_ctrl_shader *shader;
+
+   struct draw_llvm *llvm;
+   struct draw_tcs_llvm_variant_list_item list_item_global;
+   struct draw_tcs_llvm_variant_list_item list_item_local;
+
+   /* key is variable-sized, must be last */
+   struct draw_tess_llvm_variant_key key;
+};
+
+
+struct draw_tes_llvm_variant
+{
+   struct gallivm_state *gallivm;
+
+   /* LLVM JIT builder types */
+   LLVMTypeRef context_ptr_type;
+   LLVMTypeRef vertex_header_ptr_type;
+
+   LLVMValueRef function;
+   draw_tes_jit_func jit_func;
+
+   struct llvm_tess_eval_shader *shader;
+
+   struct draw_llvm *llvm;
+   struct draw_tes_llvm_variant_list_item list_item_global;
+   struct draw_tes_llvm_variant_list_item list_item_local;
+
+   /* key is variable-sized, must be last */
+   struct draw_tess_llvm_variant_key key;
+};
+
 struct llvm_vertex_shader {
    struct draw_vertex_shader base;
 
@@ -451,6 +592,24 @@ struct llvm_geometry_shader {
    unsigned variants_cached;
 };
 
+struct llvm_tess_ctrl_shader {
+   struct draw_tess_ctrl_shader base;
+
+   unsigned variant_key_size;
+   struct draw_tcs_llvm_variant_list_item variants;
+   unsigned variants_created;
+   unsigned variants_cached;
+};
+
+struct llvm_tess_eval_shader {
+   struct draw_tess_eval_shader base;
+
+   unsigned variant_key_size;
+   struct draw_tes_llvm_variant_list_item variants;
+   unsigned variants_created;
+   unsigned variants_cached;
+};
+
 
 struct draw_llvm {
    struct draw_context *draw;
@@ -460,12 +619,20 @@ struct draw_llvm {
 
    struct draw_jit_context jit_context;
    struct draw_gs_jit_context gs_jit_context;
+   struct draw_tess_jit_context tcs_jit_context;
+   struct draw_tess_jit_context tes_jit_context;
 
    struct draw_llvm_variant_list_item vs_variants_list;
    int nr_variants;
 
    struct draw_gs_llvm_variant_list_item gs_variants_list;
    int nr_gs_variants;
+
+   struct draw_tcs_llvm_variant_list_item tcs_variants_list;
+   int nr_tcs_variants;
+
+   struct draw_tes_llvm_variant_list_item tes_variants_list;
+   int nr_tes_variants;
 };
 
 
@@ -482,6 +649,19 @@ llvm_geometry_shader(struct draw_geometry_shader *gs)
 }
 
 
+static inline struct llvm_tess_ctrl_shader *
+llvm_tess_ctrl_shader(struct draw_tess_ctrl_shader *tcs)
+{
+   return (struct llvm_tess_ctrl_shader *)tcs;
+}
+
+static inline struct llvm_tess_eval_shader *
+llvm_tess_eval_shader(struct draw_tess_eval_shader *tes)
+{
+   return (struct llvm_tess_eval_shader *)tes;
+}
+
+
 
 
 struct draw_llvm *
@@ -519,6 +699,30 @@ draw_gs_llvm_make_variant_key(struct draw_llvm *llvm, char *store);
 void
 draw_gs_llvm_dump_variant_key(struct draw_gs_llvm_variant_key *key);
 
+struct draw_tcs_llvm_variant *
+draw_tcs_llvm_create_variant(struct draw_llvm *llvm,
+                             const struct draw_tess_llvm_variant_key *key);
+
+void
+draw_tcs_llvm_destroy_variant(struct draw_tcs_llvm_variant *variant);
+
+struct draw_tess_llvm_variant_key *
+draw_tcs_llvm_make_variant_key(struct draw_llvm *llvm, char *store);
+
+struct draw_tes_llvm_variant *
+draw_tes_llvm_create_variant(struct draw_llvm *llvm,
+                             unsigned num_vertex_header_attribs,
+                             const struct draw_tess_llvm_variant_key *key);
+
+void
+draw_tes_llvm_destroy_variant(struct draw_tes_llvm_variant *variant);
+
+struct draw_tess_llvm_variant_key *
+draw_tes_llvm_make_variant_key(struct draw_llvm *llvm, char *store);
+
+void
+draw_tess_llvm_dump_variant_key(struct draw_tess_llvm_variant_key *key);
+
 struct lp_build_sampler_soa *
 draw_llvm_sampler_soa_create(const struct draw_sampler_static_state *static_state);
 
@@ -185,6 +185,9 @@ struct draw_context
       struct pipe_vertex_element vertex_element[PIPE_MAX_ATTRIBS];
       unsigned nr_vertex_elements;
 
+      /** Number of vertices of each patch, for PIPE_PRIM_PATCHES */
+      unsigned vertices_per_patch;
+
       /* user-space vertex data, buffers */
       struct {
          /** vertex element/index buffer (ex: glDrawElements) */
@@ -200,11 +203,15 @@ struct draw_context
          /** vertex arrays */
          struct draw_vertex_buffer vbuffer[PIPE_MAX_ATTRIBS];
          
-         /** constant buffers (for vertex/geometry shader) */
+         /** constant buffers (for each shader stage) */
          const void *vs_constants[PIPE_MAX_CONSTANT_BUFFERS];
          unsigned vs_constants_size[PIPE_MAX_CONSTANT_BUFFERS];
          const void *gs_constants[PIPE_MAX_CONSTANT_BUFFERS];
          unsigned gs_constants_size[PIPE_MAX_CONSTANT_BUFFERS];
+         const void *tcs_constants[PIPE_MAX_CONSTANT_BUFFERS];
+         unsigned tcs_constants_size[PIPE_MAX_CONSTANT_BUFFERS];
+         const void *tes_constants[PIPE_MAX_CONSTANT_BUFFERS];
+         unsigned tes_constants_size[PIPE_MAX_CONSTANT_BUFFERS];
          
          /* pointer to planes */
          float (*planes)[DRAW_TOTAL_CLIP_PLANES][4]; 
@@ -296,6 +303,25 @@ struct draw_context
 
    } gs;
 
+   /** Tessellation control shader state */
+   struct {
+      struct draw_tess_ctrl_shader *tess_ctrl_shader;
+   } tcs;
+
+   /** Tessellation evaluation shader state */
+   struct {
+      struct draw_tess_eval_shader *tess_eval_shader;
+      uint num_tes_outputs;  /**< convenience, from tess_eval_shader */
+      uint position_output;
+
+      /** Primitive id of the next patch */
+      unsigned patch_id;
+   } tes;
+
+   /** Tessellation levels used when no control shader is bound */
+   float default_outer_tess_level[4];
+   float default_inner_tess_level[2];
+
    /** Fragment shader state */
    struct {
       struct draw_fragment_shader *fragment_shader;
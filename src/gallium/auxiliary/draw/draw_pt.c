@@ -34,6 +34,7 @@
 #include "draw/draw_gs.h"
 #include "draw/draw_private.h"
 #include "draw/draw_pt.h"
+#include "draw/draw_tess.h"
 #include "draw/draw_vbuf.h"
 #include "draw/draw_vs.h"
 #include "tgsi/tgsi_dump.h"
@@ -66,7 +67,14 @@ draw_pt_arrays(struct draw_context *draw,
     */
    {
       unsigned first, incr;
-      draw_pt_split_prim(prim, &first, &incr);
+
+      if (prim == PIPE_PRIM_PATCHES) {
+         first = draw->pt.vertices_per_patch;
+         incr = draw->pt.vertices_per_patch;
+      }
+      else {
+         draw_pt_split_prim(prim, &first, &incr);
+      }
       count = draw_pt_trim_count(count, first, incr);
       if (count < first)
          return TRUE;
@@ -75,6 +83,8 @@ draw_pt_arrays(struct draw_context *draw,
    if (!draw->force_passthrough) {
       unsigned gs_out_prim = (draw->gs.geometry_shader ? 
                               draw->gs.geometry_shader->output_primitive :
+                              draw->tes.tess_eval_shader ?
+                              draw->tes.tess_eval_shader->output_prim :
                               prim);
 
       if (!draw->render) {
@@ -482,6 +492,7 @@ draw_vbo(struct draw_context *draw,
    draw->pt.user.min_index = info->min_index;
    draw->pt.user.max_index = info->max_index;
    draw->pt.user.eltSize = info->indexed ? draw->pt.user.eltSizeIB : 0;
+   draw->pt.vertices_per_patch = info->vertices_per_patch;
 
    if (0)
       debug_printf("draw_vbo(mode=%u start=%u count=%u):\n",
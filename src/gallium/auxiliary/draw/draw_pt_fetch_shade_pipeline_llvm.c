@@ -30,6 +30,7 @@
 #include "util/u_prim.h"
 #include "draw/draw_context.h"
 #include "draw/draw_gs.h"
+#include "draw/draw_tess.h"
 #include "draw/draw_vbuf.h"
 #include "draw/draw_vertex.h"
 #include "draw/draw_pt.h"
@@ -132,6 +133,132 @@ llvm_middle_end_prepare_gs(struct llvm_middle_end *fpme)
    gs->current_variant = variant;
 }
 
+static void
+llvm_middle_end_prepare_tcs(struct llvm_middle_end *fpme)
+{
+   struct draw_context *draw = fpme->draw;
+   struct draw_tess_ctrl_shader *tcs = draw->tcs.tess_ctrl_shader;
+   struct draw_tess_llvm_variant_key *key;
+   struct draw_tcs_llvm_variant *variant = NULL;
+   struct draw_tcs_llvm_variant_list_item *li;
+   struct llvm_tess_ctrl_shader *shader = llvm_tess_ctrl_shader(tcs);
+   char store[DRAW_TESS_LLVM_MAX_VARIANT_KEY_SIZE];
+   unsigned i;
+
+   key = draw_tcs_llvm_make_variant_key(fpme->llvm, store);
+
+   /* Search shader's list of variants for the key */
+   li = first_elem(&shader->variants);
+   while (!at_end(&shader->variants, li)) {
+      if (memcmp(&li->base->key, key, shader->variant_key_size) == 0) {
+         variant = li->base;
+         break;
+      }
+      li = next_elem(li);
+   }
+
+   if (variant) {
+      /* found the variant, move to head of global list (for LRU) */
+      move_to_head(&fpme->llvm->tcs_variants_list,
+                   &variant->list_item_global);
+   }
+   else {
+      /* Need to create new variant */
+
+      /* First check if we've created too many variants.  If so, free
+       * 25% of the LRU to avoid using too much memory.
+       */
+      if (fpme->llvm->nr_tcs_variants >= DRAW_MAX_SHADER_VARIANTS) {
+         for (i = 0; i < DRAW_MAX_SHADER_VARIANTS / 4; i++) {
+            struct draw_tcs_llvm_variant_list_item *item;
+            if (is_empty_list(&fpme->llvm->tcs_variants_list)) {
+               break;
+            }
+            item = last_elem(&fpme->llvm->tcs_variants_list);
+            assert(item);
+            assert(item->base);
+            draw_tcs_llvm_destroy_variant(item->base);
+         }
+      }
+
+      variant = draw_tcs_llvm_create_variant(fpme->llvm, key);
+
+      if (variant) {
+         insert_at_head(&shader->variants, &variant->list_item_local);
+         insert_at_head(&fpme->llvm->tcs_variants_list,
+                        &variant->list_item_global);
+         fpme->llvm->nr_tcs_variants++;
+         shader->variants_cached++;
+      }
+   }
+
+   tcs->current_variant = variant;
+}
+
+static void
+llvm_middle_end_prepare_tes(struct llvm_middle_end *fpme)
+{
+   struct draw_context *draw = fpme->draw;
+   struct draw_tess_eval_shader *tes = draw->tes.tess_eval_shader;
+   struct draw_tess_llvm_variant_key *key;
+   struct draw_tes_llvm_variant *variant = NULL;
+   struct draw_tes_llvm_variant_list_item *li;
+   struct llvm_tess_eval_shader *shader = llvm_tess_eval_shader(tes);
+   char store[DRAW_TESS_LLVM_MAX_VARIANT_KEY_SIZE];
+   unsigned i;
+
+   key = draw_tes_llvm_make_variant_key(fpme->llvm, store);
+
+   /* Search shader's list of variants for the key */
+   li = first_elem(&shader->variants);
+   while (!at_end(&shader->variants, li)) {
+      if (memcmp(&li->base->key, key, shader->variant_key_size) == 0) {
+         variant = li->base;
+         break;
+      }
+      li = next_elem(li);
+   }
+
+   if (variant) {
+      /* found the variant, move to head of global list (for LRU) */
+      move_to_head(&fpme->llvm->tes_variants_list,
+                   &variant->list_item_global);
+   }
+   else {
+      /* Need to create new variant */
+
+      /* First check if we've created too many variants.  If so, free
+       * 25% of the LRU to avoid using too much memory.
+       */
+      if (fpme->llvm->nr_tes_variants >= DRAW_MAX_SHADER_VARIANTS) {
+         for (i = 0; i < DRAW_MAX_SHADER_VARIANTS / 4; i++) {
+            struct draw_tes_llvm_variant_list_item *item;
+            if (is_empty_list(&fpme->llvm->tes_variants_list)) {
+               break;
+            }
+            item = last_elem(&fpme->llvm->tes_variants_list);
+            assert(item);
+            assert(item->base);
+            draw_tes_llvm_destroy_variant(item->base);
+         }
+      }
+
+      variant = draw_tes_llvm_create_variant(fpme->llvm,
+                                             draw_total_tes_outputs(draw),
+                                             key);
+
+      if (variant) {
+         insert_at_head(&shader->variants, &variant->list_item_local);
+         insert_at_head(&fpme->llvm->tes_variants_list,
+                        &variant->list_item_global);
+         fpme->llvm->nr_tes_variants++;
+         shader->variants_cached++;
+      }
+   }
+
+   tes->current_variant = variant;
+}
+
 /**
  * Prepare/validate middle part of the vertex pipeline.
  * NOTE: if you change this function, also look at the non-LLVM
@@ -147,7 +274,10 @@ llvm_middle_end_prepare( struct draw_pt_middle_end *middle,
    struct draw_context *draw = fpme->draw;
    struct draw_vertex_shader *vs = draw->vs.vertex_shader;
    struct draw_geometry_shader *gs = draw->gs.geometry_shader;
+   struct draw_tess_ctrl_shader *tcs = draw->tcs.tess_ctrl_shader;
+   struct draw_tess_eval_shader *tes = draw->tes.tess_eval_shader;
    const unsigned out_prim = gs ? gs->output_primitive :
+      tes ? tes->output_prim :
       u_assembled_prim(in_prim);
    unsigned point_clip = draw->rasterizer->fill_front == PIPE_POLYGON_MODE_POINT ||
                          out_prim == PIPE_PRIM_POINTS;
@@ -166,7 +296,7 @@ llvm_middle_end_prepare( struct draw_pt_middle_end *middle,
                             draw->rasterizer->clip_halfz,
                             (draw->vs.edgeflag_output ? TRUE : FALSE) );
 
-   draw_pt_so_emit_prepare( fpme->so_emit, gs == NULL );
+   draw_pt_so_emit_prepare( fpme->so_emit, gs == NULL && tes == NULL );
 
    if (!(opt & PT_PIPELINE)) {
       draw_pt_emit_prepare( fpme->emit, out_prim,
@@ -256,6 +386,12 @@ llvm_middle_end_prepare( struct draw_pt_middle_end *middle,
       fpme->current_variant = variant;
    }
 
+   if (tcs) {
+      llvm_middle_end_prepare_tcs(fpme);
+   }
+   if (tes) {
+      llvm_middle_end_prepare_tes(fpme);
+   }
    if (gs) {
       llvm_middle_end_prepare_gs(fpme);
    }
@@ -296,13 +432,38 @@ llvm_middle_end_bind_parameters(struct draw_pt_middle_end *middle)
       }
    }
 
+   for (i = 0; i < ARRAY_SIZE(llvm->tcs_jit_context.constants); ++i) {
+      int num_consts =
+         draw->pt.user.tcs_constants_size[i] / (sizeof(float) * 4);
+      llvm->tcs_jit_context.constants[i] = draw->pt.user.tcs_constants[i];
+      llvm->tcs_jit_context.num_constants[i] = num_consts;
+      if (num_consts == 0) {
+         llvm->tcs_jit_context.constants[i] = fake_const_buf;
+      }
+   }
+   for (i = 0; i < ARRAY_SIZE(llvm->tes_jit_context.constants); ++i) {
+      int num_consts =
+         draw->pt.user.tes_constants_size[i] / (sizeof(float) * 4);
+      llvm->tes_jit_context.constants[i] = draw->pt.user.tes_constants[i];
+      llvm->tes_jit_context.num_constants[i] = num_consts;
+      if (num_consts == 0) {
+         llvm->tes_jit_context.constants[i] = fake_const_buf;
+      }
+   }
+
    llvm->jit_context.planes =
       (float (*)[DRAW_TOTAL_CLIP_PLANES][4]) draw->pt.user.planes[0];
    llvm->gs_jit_context.planes =
       (float (*)[DRAW_TOTAL_CLIP_PLANES][4]) draw->pt.user.planes[0];
+   llvm->tcs_jit_context.planes =
+      (float (*)[DRAW_TOTAL_CLIP_PLANES][4]) draw->pt.user.planes[0];
+   llvm->tes_jit_context.planes =
+      (float (*)[DRAW_TOTAL_CLIP_PLANES][4]) draw->pt.user.planes[0];
 
    llvm->jit_context.viewports = draw->viewports;
    llvm->gs_jit_context.viewports = draw->viewports;
+   llvm->tcs_jit_context.viewports = draw->viewports;
+   llvm->tes_jit_context.viewports = draw->viewports;
 }
 
 
@@ -336,80 +497,34 @@ emit(struct pt_emit *emit,
 }
 
 
+/**
+ * Run the stages following the vertex or tessellation shaders: geometry
+ * shader or primitive assembler, stream output, clipping, then the
+ * pipeline or emit.  The vertices are freed.
+ */
 static void
-llvm_pipeline_generic(struct draw_pt_middle_end *middle,
-                      const struct draw_fetch_info *fetch_info,
-                      const struct draw_prim_info *in_prim_info)
+llvm_pipeline_post_shader(struct llvm_middle_end *fpme,
+                          struct draw_vertex_info *vert_info,
+                          const struct draw_prim_info *prim_info,
+                          const struct tgsi_shader_info *input_info,
+                          unsigned opt,
+                          unsigned clipped)
 {
-   struct llvm_middle_end *fpme = llvm_middle_end(middle);
    struct draw_context *draw = fpme->draw;
    struct draw_geometry_shader *gshader = draw->gs.geometry_shader;
    struct draw_prim_info gs_prim_info;
-   struct draw_vertex_info llvm_vert_info;
    struct draw_vertex_info gs_vert_info;
-   struct draw_vertex_info *vert_info;
    struct draw_prim_info ia_prim_info;
    struct draw_vertex_info ia_vert_info;
-   const struct draw_prim_info *prim_info = in_prim_info;
    boolean free_prim_info = FALSE;
-   unsigned opt = fpme->opt;
-   unsigned clipped = 0;
-
-   llvm_vert_info.count = fetch_info->count;
-   llvm_vert_info.vertex_size = fpme->vertex_size;
-   llvm_vert_info.stride = fpme->vertex_size;
-   llvm_vert_info.verts = (struct vertex_header *)
-      MALLOC(fpme->vertex_size *
-             align(fetch_info->count, lp_native_vector_width / 32));
-   if (!llvm_vert_info.verts) {
-      assert(0);
-      return;
-   }
-
-   if (draw->collect_statistics) {
-      draw->statistics.ia_vertices += prim_info->count;
-      draw->statistics.ia_primitives +=
-         u_decomposed_prims_for_vertices(prim_info->prim, prim_info->count);
-      draw->statistics.vs_invocations += fetch_info->count;
-   }
-
-   if (fetch_info->linear)
-      clipped = fpme->current_variant->jit_func( &fpme->llvm->jit_context,
-                                       llvm_vert_info.verts,
-                                       draw->pt.user.vbuffer,
-                                       fetch_info->start,
-                                       fetch_info->count,
-                                       fpme->vertex_size,
-                                       draw->pt.vertex_buffer,
-                                       draw->instance_id,
-                                       draw->start_index,
-                                       draw->start_instance);
-   else
-      clipped = fpme->current_variant->jit_func_elts( &fpme->llvm->jit_context,
-                                            llvm_vert_info.verts,
-                                            draw->pt.user.vbuffer,
-                                            fetch_info->elts,
-                                            draw->pt.user.eltMax,
-                                            fetch_info->count,
-                                            fpme->vertex_size,
-                                            draw->pt.vertex_buffer,
-                                            draw->instance_id,
-                                            draw->pt.user.eltBias,
-                                            draw->start_instance);
-
-   /* Finished with fetch and vs:
-    */
-   fetch_info = NULL;
-   vert_info = &llvm_vert_info;
 
    if ((opt & PT_SHADE) && gshader) {
-      struct draw_vertex_shader *vshader = draw->vs.vertex_shader;
       draw_geometry_shader_run(gshader,
                                draw->pt.user.gs_constants,
                                draw->pt.user.gs_constants_size,
                                vert_info,
                                prim_info,
-                               &vshader->info,
+                               input_info,
                                &gs_vert_info,
                                &gs_prim_info);
 
@@ -450,6 +565,7 @@ llvm_pipeline_generic(struct draw_pt_middle_end *middle,
     */
    if (draw_current_shader_position_output(draw) != -1) {
       if ((opt & PT_SHADE) && (gshader ||
+                               draw->tes.tess_eval_shader ||
                                draw->vs.vertex_shader->info.writes_viewport_index)) {
          clipped = draw_pt_post_vs_run( fpme->post_vs, vert_info, prim_info );
       }
@@ -474,6 +590,105 @@ llvm_pipeline_generic(struct draw_pt_middle_end *middle,
 }
 
 
+static void
+llvm_pipeline_generic(struct draw_pt_middle_end *middle,
+                      const struct draw_fetch_info *fetch_info,
+                      const struct draw_prim_info *in_prim_info)
+{
+   struct llvm_middle_end *fpme = llvm_middle_end(middle);
+   struct draw_context *draw = fpme->draw;
+   struct draw_vertex_shader *vshader = draw->vs.vertex_shader;
+   struct draw_vertex_info llvm_vert_info;
+   const struct draw_prim_info *prim_info = in_prim_info;
+   unsigned opt = fpme->opt;
+   unsigned clipped = 0;
+
+   llvm_vert_info.count = fetch_info->count;
+   llvm_vert_info.vertex_size = fpme->vertex_size;
+   llvm_vert_info.stride = fpme->vertex_size;
+   llvm_vert_info.verts = (struct vertex_header *)
+      MALLOC(fpme->vertex_size *
+             align(fetch_info->count, lp_native_vector_width / 32));
+   if (!llvm_vert_info.verts) {
+      assert(0);
+      return;
+   }
+
+   if (draw->collect_statistics) {
+      draw->statistics.ia_vertices += prim_info->count;
+      if (prim_info->prim == PIPE_PRIM_PATCHES)
+         draw->statistics.ia_primitives +=
+            prim_info->count / draw->pt.vertices_per_patch;
+      else
+         draw->statistics.ia_primitives +=
+            u_decomposed_prims_for_vertices(prim_info->prim, prim_info->count);
+      draw->statistics.vs_invocations += fetch_info->count;
+   }
+
+   if (fetch_info->linear)
+      clipped = fpme->current_variant->jit_func( &fpme->llvm->jit_context,
+                                       llvm_vert_info.verts,
+                                       draw->pt.user.vbuffer,
+                                       fetch_info->start,
+                                       fetch_info->count,
+                                       fpme->vertex_size,
+                                       draw->pt.vertex_buffer,
+                                       draw->instance_id,
+                                       draw->start_index,
+                                       draw->start_instance);
+   else
+      clipped = fpme->current_variant->jit_func_elts( &fpme->llvm->jit_context,
+                                            llvm_vert_info.verts,
+                                            draw->pt.user.vbuffer,
+                                            fetch_info->elts,
+                                            draw->pt.user.eltMax,
+                                            fetch_info->count,
+                                            fpme->vertex_size,
+                                            draw->pt.vertex_buffer,
+                                            draw->instance_id,
+                                            draw->pt.user.eltBias,
+                                            draw->start_instance);
+
+   /* Finished with fetch and vs:
+    */
+   fetch_info = NULL;
+
+   if ((opt & PT_SHADE) && draw->tes.tess_eval_shader) {
+      /*
+       * The tessellation stages may amplify the geometry a lot, so the
+       * patches are processed in chunks, each going through the rest of
+       * the pipeline before the next one is tessellated.
+       */
+      struct draw_vertex_info tes_vert_info;
+      struct draw_prim_info tes_prim_info;
+      unsigned patch = 0;
+      boolean more;
+
+      do {
+         more = draw_tess_run(draw, &llvm_vert_info, prim_info,
+                              &vshader->info, &patch,
+                              &tes_vert_info, &tes_prim_info);
+
+         /* all the patches of the chunk may have been culled */
+         if (tes_prim_info.count) {
+            llvm_pipeline_post_shader(fpme, &tes_vert_info, &tes_prim_info,
+                                      &draw->tes.tess_eval_shader->info,
+                                      opt, 0);
+         }
+         else {
+            FREE(tes_vert_info.verts);
+         }
+      } while (more);
+
+      FREE(llvm_vert_info.verts);
+   }
+   else {
+      llvm_pipeline_post_shader(fpme, &llvm_vert_info, prim_info,
+                                &vshader->info, opt, clipped);
+   }
+}
+
+
 static inline unsigned
 prim_type(unsigned prim, unsigned flags)
 {
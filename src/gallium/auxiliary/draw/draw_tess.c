@@ -0,0 +1,645 @@
+/**************************************************************************
+ *
+ * Copyright 2016 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Tessellation stages.
+ *
+ * The patches assembled from the vertex shader outputs go through the
+ * control shader, a batch of them at a time, then each patch is subdivided
+ * by the fixed-function tessellator, and the evaluation shader is run over
+ * the resulting domain points.  Without a control shader, the input patch
+ * is passed through unchanged, with the default tessellation levels.
+ *
+ * The evaluation shader outputs are indexed with ushorts, so the patches
+ * are returned in chunks of at most 64K vertices.
+ */
+
+#include "draw_tess.h"
+#include "draw_tessellator.h"
+
+#include "draw_private.h"
+#include "draw_context.h"
+#ifdef HAVE_LLVM
+#include "draw_llvm.h"
+#include "gallivm/lp_bld_init.h"
+#endif
+
+#include "tgsi/tgsi_parse.h"
+
+#include "pipe/p_shader_tokens.h"
+
+#include "util/u_math.h"
+#include "util/u_memory.h"
+
+
+/* The evaluation shader output is indexed with ushorts */
+#define DRAW_TESS_MAX_CHUNK_VERTICES 0xffff
+
+
+static int
+draw_tess_find_output(const struct tgsi_shader_info *info,
+                      unsigned semantic_name, unsigned semantic_index)
+{
+   unsigned i;
+
+   for (i = 0; i < info->num_outputs; i++) {
+      if (info->output_semantic_name[i] == semantic_name &&
+          info->output_semantic_index[i] == semantic_index)
+         return i;
+   }
+   return -1;
+}
+
+
+static inline boolean
+draw_tess_is_patch_semantic(unsigned semantic_name)
+{
+   return semantic_name == TGSI_SEMANTIC_PATCH ||
+          semantic_name == TGSI_SEMANTIC_TESSOUTER ||
+          semantic_name == TGSI_SEMANTIC_TESSINNER;
+}
+
+
+static inline const float (*
+draw_tess_vertex_data(const struct draw_vertex_info *verts, unsigned index))[4]
+{
+   const struct vertex_header *vh = (const struct vertex_header *)
+      ((const char *)verts->verts + index * verts->stride);
+   return (const float (*)[4])vh->data;
+}
+
+
+static inline unsigned
+draw_tess_input_index(const struct draw_prim_info *prims, unsigned i)
+{
+   return prims->linear ? prims->start + i : prims->elts[prims->start + i];
+}
+
+
+#ifdef HAVE_LLVM
+
+/**
+ * Gather the inputs of a batch of patches, starting at patch, and run the
+ * control shader over them.
+ */
+static void
+draw_tcs_run_batch(struct draw_context *draw,
+                   struct draw_tess_ctrl_shader *tcs,
+                   const struct draw_vertex_info *input_verts,
+                   const struct draw_prim_info *input_prim,
+                   const int *input_map,
+                   unsigned patch,
+                   unsigned num_patches)
+{
+   const unsigned vertices_in = draw->pt.vertices_per_patch;
+   const unsigned num_inputs = tcs->info.num_inputs;
+   float (*dst)[4] = (float (*)[4])tcs->input;
+   unsigned p, v, i;
+
+   for (p = 0; p < num_patches; p++) {
+      for (v = 0; v < vertices_in; v++) {
+         unsigned index =
+            draw_tess_input_index(input_prim, (patch + p) * vertices_in + v);
+         const float (*src)[4] = draw_tess_vertex_data(input_verts, index);
+
+         for (i = 0; i < num_inputs; i++) {
+            if (input_map[i] >= 0)
+               memcpy(dst[i], src[input_map[i]], sizeof dst[i]);
+            else
+               memset(dst[i], 0, sizeof dst[i]);
+         }
+         dst += num_inputs;
+      }
+   }
+
+   tcs->current_variant->jit_func(&draw->llvm->tcs_jit_context,
+                                  tcs->input, tcs->output,
+                                  vertices_in,
+                                  draw->tes.patch_id,
+                                  tcs->current_variant->scratch);
+
+   tcs->batch_start = patch;
+   tcs->batch_count = num_patches;
+
+   if (draw->collect_statistics)
+      draw->statistics.hs_invocations += num_patches * tcs->vertices_out;
+}
+
+
+/**
+ * Make sure the output buffers can hold the given number of vertices and
+ * indices.
+ */
+static boolean
+draw_tess_grow_output(struct draw_tess_eval_shader *tes,
+                      struct draw_vertex_info *output_verts,
+                      unsigned *max_verts,
+                      unsigned num_verts,
+                      unsigned num_elts)
+{
+   if (num_verts > *max_verts) {
+      unsigned new_max = MAX2(*max_verts * 2, num_verts);
+      void *verts = REALLOC(output_verts->verts,
+                            *max_verts * output_verts->stride,
+                            new_max * output_verts->stride);
+      if (!verts)
+         return FALSE;
+      output_verts->verts = verts;
+      *max_verts = new_max;
+   }
+
+   if (num_elts > tes->max_elts) {
+      unsigned new_max = MAX2(tes->max_elts * 2, num_elts);
+      ushort *elts = REALLOC(tes->elts,
+                             tes->max_elts * sizeof(ushort),
+                             new_max * sizeof(ushort));
+      if (!elts)
+         return FALSE;
+      tes->elts = elts;
+      tes->max_elts = new_max;
+   }
+
+   return TRUE;
+}
+
+#endif /* HAVE_LLVM */
+
+
+/**
+ * Run the tessellation stages over the patches of input_prim, starting at
+ * *patch, until they're all done or the output is full.
+ *
+ * The output vertices must be freed by the caller, while the output
+ * primitives remain valid until the next call.
+ *
+ * \return TRUE if there are patches left to process.
+ */
+boolean
+draw_tess_run(struct draw_context *draw,
+              const struct draw_vertex_info *input_verts,
+              const struct draw_prim_info *input_prim,
+              const struct tgsi_shader_info *input_info,
+              unsigned *patch,
+              struct draw_vertex_info *output_verts,
+              struct draw_prim_info *output_prims)
+{
+   struct draw_tess_ctrl_shader *tcs = draw->tcs.tess_ctrl_shader;
+   struct draw_tess_eval_shader *tes = draw->tes.tess_eval_shader;
+   const unsigned vertices_in = draw->pt.vertices_per_patch;
+   const unsigned num_patches = vertices_in ?
+      input_prim->count / vertices_in : 0;
+   unsigned num_outputs = draw_total_tes_outputs(draw);
+   unsigned num_verts = 0, num_elts = 0;
+
+   output_verts->vertex_size =
+      sizeof(struct vertex_header) + num_outputs * 4 * sizeof(float);
+   output_verts->stride = output_verts->vertex_size;
+   output_verts->verts = NULL;
+   output_verts->count = 0;
+
+#ifdef HAVE_LLVM
+   if (draw->llvm && tes && tes->current_variant &&
+       (!tcs || tcs->current_variant)) {
+      const unsigned vector_length = lp_native_vector_width / 32;
+      const unsigned vertices_out = tcs ? tcs->vertices_out : vertices_in;
+      const struct tgsi_shader_info *tes_src_info =
+         tcs ? &tcs->info : input_info;
+      const unsigned tes_num_inputs = tes->info.num_inputs;
+      int tcs_input_map[PIPE_MAX_SHADER_INPUTS];
+      int tes_input_map[PIPE_MAX_SHADER_INPUTS];
+      unsigned max_verts = 0;
+      unsigned i, v;
+
+      assert(vertices_in <= DRAW_TESS_MAX_PATCH_VERTICES);
+      assert(vertices_out <= DRAW_TESS_MAX_PATCH_VERTICES);
+
+      /* Match the inputs of each stage with the outputs of the previous */
+      if (tcs) {
+         for (i = 0; i < tcs->info.num_inputs; i++) {
+            tcs_input_map[i] =
+               draw_tess_find_output(input_info,
+                                     tcs->info.input_semantic_name[i],
+                                     tcs->info.input_semantic_index[i]);
+         }
+
+         /* a new draw, the previous outputs are stale */
+         if (*patch == 0)
+            tcs->batch_count = 0;
+      }
+      for (i = 0; i < tes_num_inputs; i++) {
+         tes_input_map[i] =
+            draw_tess_find_output(tes_src_info,
+                                  tes->info.input_semantic_name[i],
+                                  tes->info.input_semantic_index[i]);
+      }
+
+      while (*patch < num_patches) {
+         const unsigned p = *patch;
+         const float (*src_patch)[4] = NULL;
+         const float (*src_verts[DRAW_TESS_MAX_PATCH_VERTICES])[4];
+         float (*dst)[4] = (float (*)[4])tes->input;
+         const struct draw_tess_output *domain;
+         float outer[4], inner[2];
+
+         memcpy(outer, draw->default_outer_tess_level, sizeof outer);
+         memcpy(inner, draw->default_inner_tess_level, sizeof inner);
+
+         if (tcs) {
+            const unsigned row = tcs->info.num_outputs;
+            const float (*out)[4];
+
+            if (p < tcs->batch_start ||
+                p >= tcs->batch_start + tcs->batch_count) {
+               draw_tcs_run_batch(draw, tcs, input_verts, input_prim,
+                                  tcs_input_map, p,
+                                  MIN2(tcs->vector_length, num_patches - p));
+            }
+
+            out = (const float (*)[4])tcs->output +
+               (p - tcs->batch_start) * (vertices_out + 1) * row;
+
+            src_patch = out;
+            for (v = 0; v < vertices_out; v++)
+               src_verts[v] = out + (v + 1) * row;
+
+            if (tcs->tess_outer_output >= 0)
+               memcpy(outer, out[tcs->tess_outer_output], sizeof outer);
+            if (tcs->tess_inner_output >= 0)
+               memcpy(inner, out[tcs->tess_inner_output], sizeof inner);
+         }
+         else {
+            for (v = 0; v < vertices_out; v++) {
+               unsigned index =
+                  draw_tess_input_index(input_prim, p * vertices_in + v);
+               src_verts[v] = draw_tess_vertex_data(input_verts, index);
+            }
+         }
+
+         domain = draw_tessellate(tes->tessellator, outer, inner);
+         if (!domain) {
+            /* culled */
+            (*patch)++;
+            draw->tes.patch_id++;
+            continue;
+         }
+
+         if (num_verts &&
+             num_verts + domain->num_points > DRAW_TESS_MAX_CHUNK_VERTICES)
+            break;
+
+         /* the shader writes whole vectors of vertices */
+         if (!draw_tess_grow_output(tes, output_verts, &max_verts,
+                                    num_verts + align(domain->num_points,
+                                                      vector_length),
+                                    num_elts + domain->num_indices))
+            break;
+
+         /* Gather the inputs of the patch, the per-patch ones first */
+         for (i = 0; i < tes_num_inputs; i++) {
+            const int slot = tes_input_map[i];
+
+            if (draw_tess_is_patch_semantic(tes->info.input_semantic_name[i])) {
+               if (src_patch && slot >= 0)
+                  memcpy(dst[i], src_patch[slot], sizeof dst[i]);
+               else
+                  memset(dst[i], 0, sizeof dst[i]);
+            }
+         }
+         for (v = 0; v < vertices_out; v++) {
+            dst += tes_num_inputs;
+            for (i = 0; i < tes_num_inputs; i++) {
+               const int slot = tes_input_map[i];
+
+               if (!draw_tess_is_patch_semantic(tes->info.input_semantic_name[i]) &&
+                   slot >= 0)
+                  memcpy(dst[i], src_verts[v][slot], sizeof dst[i]);
+               else
+                  memset(dst[i], 0, sizeof dst[i]);
+            }
+         }
+
+         tes->current_variant->jit_func(&draw->llvm->tes_jit_context,
+                                        tes->input,
+                                        (struct vertex_header *)
+                                        ((char *)output_verts->verts +
+                                         num_verts * output_verts->stride),
+                                        domain->u, domain->v,
+                                        domain->num_points,
+                                        vertices_out,
+                                        draw->tes.patch_id,
+                                        outer, inner);
+
+         for (i = 0; i < domain->num_indices; i++)
+            tes->elts[num_elts + i] = (ushort)(domain->indices[i] + num_verts);
+
+         if (draw->collect_statistics)
+            draw->statistics.ds_invocations += domain->num_points;
+
+         num_verts += domain->num_points;
+         num_elts += domain->num_indices;
+         (*patch)++;
+         draw->tes.patch_id++;
+      }
+   }
+   else
+#endif
+   {
+      /* Nothing can be drawn */
+      *patch = num_patches;
+   }
+
+   output_verts->count = num_verts;
+
+   tes->prim_length = num_elts;
+   output_prims->linear = FALSE;
+   output_prims->start = 0;
+   output_prims->count = num_elts;
+   output_prims->elts = tes->elts;
+   output_prims->prim = tes->output_prim;
+   output_prims->flags = 0;
+   output_prims->primitive_lengths = &tes->prim_length;
+   output_prims->primitive_count = 1;
+
+   return *patch < num_patches;
+}
+
+
+/*
+ * Called at the beginning of each instance, like
+ * draw_geometry_shader_new_instance().
+ */
+void
+draw_tess_new_instance(struct draw_context *draw)
+{
+   draw->tes.patch_id = 0;
+}
+
+
+struct draw_tess_ctrl_shader *
+draw_create_tess_ctrl_shader(struct draw_context *draw,
+                             const struct pipe_shader_state *state)
+{
+#ifdef HAVE_LLVM
+   struct llvm_tess_ctrl_shader *llvm_tcs;
+   struct draw_tess_ctrl_shader *tcs;
+   unsigned num_inputs, num_outputs;
+
+   /* tessellation is only implemented with llvm */
+   if (!draw->llvm)
+      return NULL;
+
+   llvm_tcs = CALLOC_STRUCT(llvm_tess_ctrl_shader);
+   if (!llvm_tcs)
+      return NULL;
+
+   tcs = &llvm_tcs->base;
+   make_empty_list(&llvm_tcs->variants);
+
+   tcs->draw = draw;
+   tcs->state = *state;
+   tcs->state.tokens = tgsi_dup_tokens(state->tokens);
+   if (!tcs->state.tokens) {
+      FREE(llvm_tcs);
+      return NULL;
+   }
+
+   tgsi_scan_shader(state->tokens, &tcs->info);
+
+   tcs->vertices_out = tcs->info.properties[TGSI_PROPERTY_TCS_VERTICES_OUT];
+   tcs->vector_length = lp_native_vector_width / 32;
+   tcs->tess_outer_output =
+      draw_tess_find_output(&tcs->info, TGSI_SEMANTIC_TESSOUTER, 0);
+   tcs->tess_inner_output =
+      draw_tess_find_output(&tcs->info, TGSI_SEMANTIC_TESSINNER, 0);
+
+   num_inputs = MAX2(tcs->info.num_inputs, 1);
+   num_outputs = MAX2(tcs->info.num_outputs, 1);
+   tcs->input = align_malloc(tcs->vector_length *
+                             DRAW_TESS_MAX_PATCH_VERTICES *
+                             num_inputs * 4 * sizeof(float), 16);
+   tcs->output = align_malloc(tcs->vector_length *
+                              (tcs->vertices_out + 1) *
+                              num_outputs * 4 * sizeof(float), 16);
+   if (!tcs->input || !tcs->output) {
+      align_free(tcs->input);
+      align_free(tcs->output);
+      FREE((void *) tcs->state.tokens);
+      FREE(llvm_tcs);
+      return NULL;
+   }
+
+   llvm_tcs->variant_key_size =
+      draw_tess_llvm_variant_key_size(
+         MAX2(tcs->info.file_max[TGSI_FILE_SAMPLER]+1,
+              tcs->info.file_max[TGSI_FILE_SAMPLER_VIEW]+1));
+
+   return tcs;
+#else
+   return NULL;
+#endif
+}
+
+
+void
+draw_bind_tess_ctrl_shader(struct draw_context *draw,
+                           struct draw_tess_ctrl_shader *dtcs)
+{
+   draw_do_flush(draw, DRAW_FLUSH_STATE_CHANGE);
+
+   draw->tcs.tess_ctrl_shader = dtcs;
+}
+
+
+void
+draw_delete_tess_ctrl_shader(struct draw_context *draw,
+                             struct draw_tess_ctrl_shader *dtcs)
+{
+   if (!dtcs)
+      return;
+
+#ifdef HAVE_LLVM
+   if (draw->llvm) {
+      struct llvm_tess_ctrl_shader *shader = llvm_tess_ctrl_shader(dtcs);
+      struct draw_tcs_llvm_variant_list_item *li;
+
+      li = first_elem(&shader->variants);
+      while (!at_end(&shader->variants, li)) {
+         struct draw_tcs_llvm_variant_list_item *next = next_elem(li);
+         draw_tcs_llvm_destroy_variant(li->base);
+         li = next;
+      }
+
+      assert(shader->variants_cached == 0);
+   }
+#endif
+
+   align_free(dtcs->input);
+   align_free(dtcs->output);
+   FREE((void *) dtcs->state.tokens);
+   FREE(dtcs);
+}
+
+
+struct draw_tess_eval_shader *
+draw_create_tess_eval_shader(struct draw_context *draw,
+                             const struct pipe_shader_state *state)
+{
+#ifdef HAVE_LLVM
+   struct llvm_tess_eval_shader *llvm_tes;
+   struct draw_tess_eval_shader *tes;
+   boolean found_clipvertex = FALSE;
+   unsigned i;
+
+   /* tessellation is only implemented with llvm */
+   if (!draw->llvm)
+      return NULL;
+
+   llvm_tes = CALLOC_STRUCT(llvm_tess_eval_shader);
+   if (!llvm_tes)
+      return NULL;
+
+   tes = &llvm_tes->base;
+   make_empty_list(&llvm_tes->variants);
+
+   tes->draw = draw;
+   tes->state = *state;
+   tes->state.tokens = tgsi_dup_tokens(state->tokens);
+   if (!tes->state.tokens) {
+      FREE(llvm_tes);
+      return NULL;
+   }
+
+   tgsi_scan_shader(state->tokens, &tes->info);
+
+   tes->prim_mode = tes->info.properties[TGSI_PROPERTY_TES_PRIM_MODE];
+   tes->spacing = tes->info.properties[TGSI_PROPERTY_TES_SPACING];
+   tes->vertex_order_cw = tes->info.properties[TGSI_PROPERTY_TES_VERTEX_ORDER_CW];
+   tes->point_mode = tes->info.properties[TGSI_PROPERTY_TES_POINT_MODE];
+
+   if (tes->point_mode)
+      tes->output_prim = PIPE_PRIM_POINTS;
+   else if (tes->prim_mode == PIPE_PRIM_LINES)
+      tes->output_prim = PIPE_PRIM_LINES;
+   else
+      tes->output_prim = PIPE_PRIM_TRIANGLES;
+
+   tes->position_output = -1;
+   for (i = 0; i < tes->info.num_outputs; i++) {
+      if (tes->info.output_semantic_name[i] == TGSI_SEMANTIC_POSITION &&
+          tes->info.output_semantic_index[i] == 0)
+         tes->position_output = i;
+      else if (tes->info.output_semantic_name[i] == TGSI_SEMANTIC_CLIPVERTEX &&
+               tes->info.output_semantic_index[i] == 0) {
+         found_clipvertex = TRUE;
+         tes->clipvertex_output = i;
+      }
+      else if (tes->info.output_semantic_name[i] == TGSI_SEMANTIC_VIEWPORT_INDEX)
+         tes->viewport_index_output = i;
+      else if (tes->info.output_semantic_name[i] == TGSI_SEMANTIC_CLIPDIST) {
+         debug_assert(tes->info.output_semantic_index[i] <
+                      PIPE_MAX_CLIP_OR_CULL_DISTANCE_ELEMENT_COUNT);
+         tes->ccdistance_output[tes->info.output_semantic_index[i]] = i;
+      }
+   }
+   if (!found_clipvertex)
+      tes->clipvertex_output = tes->position_output;
+
+   tes->tessellator = draw_tessellator_create(tes->prim_mode,
+                                              tes->spacing,
+                                              tes->vertex_order_cw,
+                                              tes->point_mode);
+   tes->input = align_malloc((DRAW_TESS_MAX_PATCH_VERTICES + 1) *
+                             MAX2(tes->info.num_inputs, 1) *
+                             4 * sizeof(float), 16);
+   if (!tes->tessellator || !tes->input) {
+      if (tes->tessellator)
+         draw_tessellator_destroy(tes->tessellator);
+      align_free(tes->input);
+      FREE((void *) tes->state.tokens);
+      FREE(llvm_tes);
+      return NULL;
+   }
+
+   llvm_tes->variant_key_size =
+      draw_tess_llvm_variant_key_size(
+         MAX2(tes->info.file_max[TGSI_FILE_SAMPLER]+1,
+              tes->info.file_max[TGSI_FILE_SAMPLER_VIEW]+1));
+
+   return tes;
+#else
+   return NULL;
+#endif
+}
+
+
+void
+draw_bind_tess_eval_shader(struct draw_context *draw,
+                           struct draw_tess_eval_shader *dtes)
+{
+   draw_do_flush(draw, DRAW_FLUSH_STATE_CHANGE);
+
+   if (dtes) {
+      draw->tes.tess_eval_shader = dtes;
+      draw->tes.num_tes_outputs = dtes->info.num_outputs;
+      draw->tes.position_output = dtes->position_output;
+   }
+   else {
+      draw->tes.tess_eval_shader = NULL;
+      draw->tes.num_tes_outputs = 0;
+   }
+}
+
+
+void
+draw_delete_tess_eval_shader(struct draw_context *draw,
+                             struct draw_tess_eval_shader *dtes)
+{
+   if (!dtes)
+      return;
+
+#ifdef HAVE_LLVM
+   if (draw->llvm) {
+      struct llvm_tess_eval_shader *shader = llvm_tess_eval_shader(dtes);
+      struct draw_tes_llvm_variant_list_item *li;
+
+      li = first_elem(&shader->variants);
+      while (!at_end(&shader->variants, li)) {
+         struct draw_tes_llvm_variant_list_item *next = next_elem(li);
+         draw_tes_llvm_destroy_variant(li->base);
+         li = next;
+      }
+
+      assert(shader->variants_cached == 0);
+   }
+#endif
+
+   draw_tessellator_destroy(dtes->tessellator);
+   align_free(dtes->input);
+   FREE(dtes->elts);
+   FREE((void *) dtes->state.tokens);
+   FREE(dtes);
+}
@@ -0,0 +1,125 @@
+/**************************************************************************
+ *
+ * Copyright 2016 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+#ifndef DRAW_TESS_H
+#define DRAW_TESS_H
+
+#include "draw_context.h"
+#include "draw_private.h"
+#include "tgsi/tgsi_scan.h"
+
+/* Maximum number of vertices of an input or output patch */
+#define DRAW_TESS_MAX_PATCH_VERTICES 32
+
+struct draw_context;
+struct draw_tessellator;
+
+#ifdef HAVE_LLVM
+struct draw_tcs_llvm_variant;
+struct draw_tes_llvm_variant;
+#endif
+
+/**
+ * Private version of the compiled tessellation control shader.
+ *
+ * Tessellation is only supported with LLVM: the control shader processes
+ * whole batches of patches at once (see draw_tcs_jit_func).
+ */
+struct draw_tess_ctrl_shader {
+   struct draw_context *draw;
+
+   struct pipe_shader_state state;
+   struct tgsi_shader_info info;
+
+   unsigned vertices_out;
+   /** Number of patches processed at once */
+   unsigned vector_length;
+   int tess_outer_output;
+   int tess_inner_output;
+
+   /* Inputs and outputs of a batch of patches */
+   float *input;
+   float *output;
+
+   /* The patches whose outputs are currently in output */
+   unsigned batch_start;
+   unsigned batch_count;
+
+#ifdef HAVE_LLVM
+   struct draw_tcs_llvm_variant *current_variant;
+#endif
+};
+
+/**
+ * Private version of the compiled tessellation evaluation shader
+ */
+struct draw_tess_eval_shader {
+   struct draw_context *draw;
+
+   struct pipe_shader_state state;
+   struct tgsi_shader_info info;
+
+   unsigned prim_mode;
+   unsigned spacing;
+   boolean vertex_order_cw;
+   boolean point_mode;
+
+   unsigned output_prim;
+   unsigned position_output;
+   unsigned viewport_index_output;
+   unsigned clipvertex_output;
+   unsigned ccdistance_output[PIPE_MAX_CLIP_OR_CULL_DISTANCE_ELEMENT_COUNT];
+
+   struct draw_tessellator *tessellator;
+
+   /* Inputs of a single patch, the per-patch ones first */
+   float *input;
+
+   /* Output primitives */
+   ushort *elts;
+   unsigned max_elts;
+   unsigned prim_length;
+
+#ifdef HAVE_LLVM
+   struct draw_tes_llvm_variant *current_variant;
+#endif
+};
+
+
+boolean
+draw_tess_run(struct draw_context *draw,
+              const struct draw_vertex_info *input_verts,
+              const struct draw_prim_info *input_prim,
+              const struct tgsi_shader_info *input_info,
+              unsigned *patch,
+              struct draw_vertex_info *output_verts,
+              struct draw_prim_info *output_prims);
+
+void
+draw_tess_new_instance(struct draw_context *draw);
+
+#endif
@@ -0,0 +1,672 @@
+/**************************************************************************
+ *
+ * Copyright 2016 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * The triangle and quad domains are subdivided into concentric rings: the
+ * outermost one is subdivided according to the outer levels, and the inner
+ * ones according to the inner levels, each inner ring having two segments
+ * less per edge than the previous one.  Consecutive rings are then stitched
+ * together edge by edge, walking both edges in parallel and always advancing
+ * on the edge whose next point comes first.
+ *
+ * Ring corners are always visited in counter-clockwise order in (u, v)
+ * space, which makes all the triangles counter-clockwise by construction;
+ * they're simply flipped when clockwise order is requested.
+ */
+
+#include <float.h>
+#include <math.h>
+
+#include "draw_tessellator.h"
+
+#include "pipe/p_defines.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+
+
+/* Triangles are at most twice as many as points */
+#define DRAW_TESS_MAX_INDICES (6 * DRAW_TESS_MAX_POINTS)
+
+
+/**
+ * An edge of a ring.
+ */
+struct tess_edge
+{
+   unsigned num_segments;
+   /** Points of the edge, num_segments + 1 of them */
+   ushort idx[DRAW_TESS_MAX_LEVEL + 1];
+   /** Position of each point along the edge, for stitching */
+   float pos[DRAW_TESS_MAX_LEVEL + 1];
+};
+
+
+struct tess_ring
+{
+   struct tess_edge edge[4];
+};
+
+
+struct draw_tessellator
+{
+   unsigned prim_mode;
+   unsigned spacing;
+   boolean vertex_order_cw;
+   boolean point_mode;
+
+   /* Levels of the last patch, and whether it was culled */
+   boolean valid;
+   boolean culled;
+   float outer[4];
+   float inner[2];
+
+   struct draw_tess_output output;
+
+   /* Only two rings are live at any time */
+   struct tess_ring rings[2];
+
+   unsigned num_points;
+   unsigned num_indices;
+   float u[DRAW_TESS_MAX_POINTS + DRAW_TESS_POINT_ALIGN];
+   float v[DRAW_TESS_MAX_POINTS + DRAW_TESS_POINT_ALIGN];
+   ushort indices[DRAW_TESS_MAX_INDICES];
+};
+
+
+/**
+ * Compute the number of segments a level subdivides an edge into, and the
+ * position of the points along the edge, in [0, 1].
+ *
+ * With fractional spacing, all the segments have a length of 1/level but
+ * two shorter ones, placed symmetrically around the middle of the edge so
+ * that shared edges match regardless of the direction they're walked in.
+ */
+static unsigned
+tess_segments(unsigned spacing, float level, float *pos)
+{
+   float lo, hi, f;
+   unsigned n, i;
+
+   switch (spacing) {
+   case PIPE_TESS_SPACING_FRACTIONAL_ODD:
+      lo = 1.0f;
+      hi = DRAW_TESS_MAX_LEVEL - 1;
+      break;
+   case PIPE_TESS_SPACING_FRACTIONAL_EVEN:
+      lo = 2.0f;
+      hi = DRAW_TESS_MAX_LEVEL;
+      break;
+   case PIPE_TESS_SPACING_EQUAL:
+   default:
+      lo = 1.0f;
+      hi = DRAW_TESS_MAX_LEVEL;
+      break;
+   }
+
+   /* also catches NaNs */
+   if (!(level > lo))
+      f = lo;
+   else if (level > hi)
+      f = hi;
+   else
+      f = level;
+
+   switch (spacing) {
+   case PIPE_TESS_SPACING_FRACTIONAL_ODD:
+      n = 2 * (unsigned) ceilf((f - 1.0f) * 0.5f) + 1;
+      break;
+   case PIPE_TESS_SPACING_FRACTIONAL_EVEN:
+      n = 2 * (unsigned) ceilf(f * 0.5f);
+      break;
+   case PIPE_TESS_SPACING_EQUAL:
+   default:
+      n = (unsigned) ceilf(f);
+      f = (float) n;
+      break;
+   }
+
+   if (!pos)
+      return n;
+
+   if ((float) n == f) {
+      for (i = 0; i <= n; i++)
+         pos[i] = (float) i / (float) n;
+   }
+   else {
+      const float long_segment = 1.0f / f;
+      const float short_segment = (1.0f - (n - 2) * long_segment) * 0.5f;
+      unsigned short0, short1;
+
+      if (n & 1) {
+         /* around the middle segment */
+         short0 = n / 2 - 1;
+         short1 = n / 2 + 1;
+      }
+      else {
+         short0 = n / 2 - 1;
+         short1 = n / 2;
+      }
+
+      pos[0] = 0.0f;
+      for (i = 0; i < n; i++) {
+         pos[i + 1] = pos[i] + (i == short0 || i == short1 ?
+                                short_segment : long_segment);
+      }
+   }
+
+   /* make rounding errors symmetric too */
+   for (i = 0; i < (n + 1) / 2; i++)
+      pos[n - i] = 1.0f - pos[i];
+   if (!(n & 1))
+      pos[n / 2] = 0.5f;
+
+   return n;
+}
+
+
+static inline ushort
+tess_add_point(struct draw_tessellator *tess, float u, float v)
+{
+   assert(tess->num_points < DRAW_TESS_MAX_POINTS);
+   tess->u[tess->num_points] = u;
+   tess->v[tess->num_points] = v;
+   return (ushort) tess->num_points++;
+}
+
+
+/**
+ * Emit a triangle given in counter-clockwise order.
+ */
+static inline void
+tess_emit_tri(struct draw_tessellator *tess, ushort a, ushort b, ushort c)
+{
+   ushort *indices = &tess->indices[tess->num_indices];
+
+   assert(tess->num_indices + 3 <= DRAW_TESS_MAX_INDICES);
+
+   indices[0] = a;
+   if (tess->vertex_order_cw) {
+      indices[1] = c;
+      indices[2] = b;
+   }
+   else {
+      indices[1] = b;
+      indices[2] = c;
+   }
+   tess->num_indices += 3;
+}
+
+
+/**
+ * Emit the counter-clockwise quad abcd as two triangles.
+ */
+static inline void
+tess_emit_quad(struct draw_tessellator *tess,
+               ushort a, ushort b, ushort c, ushort d)
+{
+   tess_emit_tri(tess, a, b, c);
+   tess_emit_tri(tess, a, c, d);
+}
+
+
+/**
+ * Triangulate the strip between an edge of a ring and the corresponding
+ * edge of the next inner ring.  Both edges go in the same direction.
+ */
+static void
+tess_stitch_edges(struct draw_tessellator *tess,
+                  const struct tess_edge *outer,
+                  const struct tess_edge *inner)
+{
+   unsigned i = 0, j = 0;
+
+   while (i < outer->num_segments || j < inner->num_segments) {
+      if (j == inner->num_segments ||
+          (i < outer->num_segments &&
+           outer->pos[i + 1] <= inner->pos[j + 1])) {
+         tess_emit_tri(tess, outer->idx[i], outer->idx[i + 1], inner->idx[j]);
+         i++;
+      }
+      else {
+         tess_emit_tri(tess, outer->idx[i], inner->idx[j + 1], inner->idx[j]);
+         j++;
+      }
+   }
+}
+
+
+/**
+ * Subdivide the edge between points a and b, according to the given
+ * positions.  The first and last points must already exist.
+ */
+static void
+tess_build_edge(struct draw_tessellator *tess,
+                struct tess_edge *edge,
+                ushort a, ushort b,
+                unsigned num_segments,
+                const float *pos,
+                float pos_start, float pos_scale)
+{
+   const float u0 = tess->u[a], v0 = tess->v[a];
+   const float du = tess->u[b] - u0, dv = tess->v[b] - v0;
+   unsigned j;
+
+   edge->num_segments = num_segments;
+   edge->idx[0] = a;
+   edge->pos[0] = pos[0];
+   for (j = 1; j < num_segments; j++) {
+      float s = (pos[j] - pos_start) * pos_scale;
+      edge->idx[j] = tess_add_point(tess, u0 + s * du, v0 + s * dv);
+      edge->pos[j] = pos[j];
+   }
+   edge->idx[num_segments] = b;
+   edge->pos[num_segments] = pos[num_segments];
+}
+
+
+/**
+ * Build the outer ring of a triangle or quad domain, from its corners and
+ * the outer levels of its edges, in counter-clockwise order.
+ */
+static void
+tess_build_outer_ring(struct draw_tessellator *tess,
+                      struct tess_ring *ring,
+                      unsigned num_edges,
+                      const float (*corners)[2],
+                      const float *levels)
+{
+   float pos[DRAW_TESS_MAX_LEVEL + 1];
+   ushort idx[4];
+   unsigned e;
+
+   for (e = 0; e < num_edges; e++)
+      idx[e] = tess_add_point(tess, corners[e][0], corners[e][1]);
+
+   for (e = 0; e < num_edges; e++) {
+      unsigned n = tess_segments(tess->spacing, levels[e], pos);
+      tess_build_edge(tess, &ring->edge[e], idx[e], idx[(e + 1) % num_edges],
+                      n, pos, 0.0f, 1.0f);
+   }
+}
+
+
+/**
+ * Make all the edges of a ring collapse to a single point.
+ */
+static void
+tess_build_point_ring(struct tess_ring *ring, unsigned num_edges,
+                      ushort idx, float pos)
+{
+   unsigned e;
+
+   for (e = 0; e < num_edges; e++) {
+      ring->edge[e].num_segments = 0;
+      ring->edge[e].idx[0] = idx;
+      ring->edge[e].pos[0] = pos;
+   }
+}
+
+
+static void
+tess_triangles(struct draw_tessellator *tess,
+               const float outer[4], const float inner[2])
+{
+   static const float corners[3][2] = { {1.0f, 0.0f},
+                                        {0.0f, 1.0f},
+                                        {0.0f, 0.0f} };
+   /* edge w = 0, then u = 0, then v = 0 */
+   const float levels[3] = { outer[2], outer[0], outer[1] };
+   float pos[DRAW_TESS_MAX_LEVEL + 1];
+   unsigned n, k, e;
+
+   n = tess_segments(tess->spacing, inner[0], pos);
+   if (n == 1) {
+      if (tess_segments(tess->spacing, outer[0], NULL) == 1 &&
+          tess_segments(tess->spacing, outer[1], NULL) == 1 &&
+          tess_segments(tess->spacing, outer[2], NULL) == 1) {
+         ushort a = tess_add_point(tess, 1.0f, 0.0f);
+         ushort b = tess_add_point(tess, 0.0f, 1.0f);
+         ushort c = tess_add_point(tess, 0.0f, 0.0f);
+         tess_emit_tri(tess, a, b, c);
+         return;
+      }
+      /* as if the inner level was slightly greater than one */
+      n = tess_segments(tess->spacing, 1.0f + FLT_EPSILON, pos);
+   }
+
+   tess_build_outer_ring(tess, &tess->rings[0], 3, corners, levels);
+
+   for (k = 1; ; k++) {
+      const struct tess_ring *prev = &tess->rings[(k - 1) & 1];
+      struct tess_ring *ring = &tess->rings[k & 1];
+      const unsigned m = n - 2 * k;
+
+      if (m == 0) {
+         ushort center = tess_add_point(tess, 1.0f / 3.0f, 1.0f / 3.0f);
+         tess_build_point_ring(ring, 3, center, pos[k]);
+      }
+      else {
+         /*
+          * The corners of ring k have barycentric coordinates
+          * (1 - 2d, d, d), so that its edges are (n - 2k) inner segments
+          * long.
+          */
+         const float d = pos[k] * (2.0f / 3.0f);
+         ushort idx[3];
+
+         idx[0] = tess_add_point(tess, 1.0f - 2.0f * d, d);
+         idx[1] = tess_add_point(tess, d, 1.0f - 2.0f * d);
+         idx[2] = tess_add_point(tess, d, d);
+
+         for (e = 0; e < 3; e++) {
+            tess_build_edge(tess, &ring->edge[e], idx[e], idx[(e + 1) % 3],
+                            m, &pos[k], pos[k], 1.0f / (1.0f - 2.0f * pos[k]));
+         }
+      }
+
+      for (e = 0; e < 3; e++)
+         tess_stitch_edges(tess, &prev->edge[e], &ring->edge[e]);
+
+      if (m <= 1) {
+         if (m == 1) {
+            tess_emit_tri(tess, ring->edge[0].idx[0],
+                          ring->edge[1].idx[0], ring->edge[2].idx[0]);
+         }
+         break;
+      }
+   }
+}
+
+
+static void
+tess_quads(struct draw_tessellator *tess,
+           const float outer[4], const float inner[2])
+{
+   static const float corners[4][2] = { {0.0f, 0.0f},
+                                        {1.0f, 0.0f},
+                                        {1.0f, 1.0f},
+                                        {0.0f, 1.0f} };
+   /* edge v = 0, then u = 1, then v = 1, then u = 0 */
+   const float levels[4] = { outer[1], outer[2], outer[3], outer[0] };
+   float pu[DRAW_TESS_MAX_LEVEL + 1];
+   float pv[DRAW_TESS_MAX_LEVEL + 1];
+   unsigned nu, nv, k, e, i;
+
+   nu = tess_segments(tess->spacing, inner[0], pu);
+   nv = tess_segments(tess->spacing, inner[1], pv);
+
+   if (nu == 1 || nv == 1) {
+      if (nu == 1 && nv == 1 &&
+          tess_segments(tess->spacing, outer[0], NULL) == 1 &&
+          tess_segments(tess->spacing, outer[1], NULL) == 1 &&
+          tess_segments(tess->spacing, outer[2], NULL) == 1 &&
+          tess_segments(tess->spacing, outer[3], NULL) == 1) {
+         ushort a = tess_add_point(tess, 0.0f, 0.0f);
+         ushort b = tess_add_point(tess, 1.0f, 0.0f);
+         ushort c = tess_add_point(tess, 1.0f, 1.0f);
+         ushort d = tess_add_point(tess, 0.0f, 1.0f);
+         tess_emit_quad(tess, a, b, c, d);
+         return;
+      }
+      if (nu == 1)
+         nu = tess_segments(tess->spacing, 1.0f + FLT_EPSILON, pu);
+      if (nv == 1)
+         nv = tess_segments(tess->spacing, 1.0f + FLT_EPSILON, pv);
+   }
+
+   tess_build_outer_ring(tess, &tess->rings[0], 4, corners, levels);
+
+   for (k = 1; ; k++) {
+      const struct tess_ring *prev = &tess->rings[(k - 1) & 1];
+      struct tess_ring *ring = &tess->rings[k & 1];
+      const unsigned mu = nu - 2 * k;
+      const unsigned mv = nv - 2 * k;
+      const float u0 = pu[k], u1 = pu[nu - k];
+      const float v0 = pv[k], v1 = pv[nv - k];
+
+      if (mu == 0 && mv == 0) {
+         ushort center = tess_add_point(tess, 0.5f, 0.5f);
+         tess_build_point_ring(ring, 4, center, pu[k]);
+      }
+      else if (mv == 0) {
+         /* the ring collapses to a horizontal line */
+         struct tess_edge *bottom = &ring->edge[0];
+         struct tess_edge *top = &ring->edge[2];
+
+         bottom->num_segments = top->num_segments = mu;
+         for (i = 0; i <= mu; i++) {
+            bottom->idx[i] = tess_add_point(tess, pu[k + i], 0.5f);
+            bottom->pos[i] = top->pos[i] = pu[k + i];
+         }
+         for (i = 0; i <= mu; i++)
+            top->idx[i] = bottom->idx[mu - i];
+
+         ring->edge[1].num_segments = ring->edge[3].num_segments = 0;
+         ring->edge[1].idx[0] = bottom->idx[mu];
+         ring->edge[3].idx[0] = bottom->idx[0];
+         ring->edge[1].pos[0] = ring->edge[3].pos[0] = pv[k];
+      }
+      else if (mu == 0) {
+         /* the ring collapses to a vertical line */
+         struct tess_edge *right = &ring->edge[1];
+         struct tess_edge *left = &ring->edge[3];
+
+         right->num_segments = left->num_segments = mv;
+         for (i = 0; i <= mv; i++) {
+            right->idx[i] = tess_add_point(tess, 0.5f, pv[k + i]);
+            right->pos[i] = left->pos[i] = pv[k + i];
+         }
+         for (i = 0; i <= mv; i++)
+            left->idx[i] = right->idx[mv - i];
+
+         ring->edge[0].num_segments = ring->edge[2].num_segments = 0;
+         ring->edge[0].idx[0] = right->idx[0];
+         ring->edge[2].idx[0] = right->idx[mv];
+         ring->edge[0].pos[0] = ring->edge[2].pos[0] = pu[k];
+      }
+      else {
+         const float su = 1.0f / (1.0f - 2.0f * pu[k]);
+         const float sv = 1.0f / (1.0f - 2.0f * pv[k]);
+         ushort idx[4];
+
+         idx[0] = tess_add_point(tess, u0, v0);
+         idx[1] = tess_add_point(tess, u1, v0);
+         idx[2] = tess_add_point(tess, u1, v1);
+         idx[3] = tess_add_point(tess, u0, v1);
+
+         tess_build_edge(tess, &ring->edge[0], idx[0], idx[1],
+                         mu, &pu[k], pu[k], su);
+         tess_build_edge(tess, &ring->edge[1], idx[1], idx[2],
+                         mv, &pv[k], pv[k], sv);
+         tess_build_edge(tess, &ring->edge[2], idx[2], idx[3],
+                         mu, &pu[k], pu[k], su);
+         tess_build_edge(tess, &ring->edge[3], idx[3], idx[0],
+                         mv, &pv[k], pv[k], sv);
+      }
+
+      for (e = 0; e < 4; e++)
+         tess_stitch_edges(tess, &prev->edge[e], &ring->edge[e]);
+
+      if (mu <= 1 || mv <= 1) {
+         /* fill what remains with a single row or column of quads */
+         if (mv == 1 && mu != 0) {
+            const struct tess_edge *bottom = &ring->edge[0];
+            const struct tess_edge *top = &ring->edge[2];
+            for (i = 0; i < mu; i++) {
+               tess_emit_quad(tess, bottom->idx[i], bottom->idx[i + 1],
+                              top->idx[mu - i - 1], top->idx[mu - i]);
+            }
+         }
+         else if (mu == 1 && mv != 0) {
+            const struct tess_edge *right = &ring->edge[1];
+            const struct tess_edge *left = &ring->edge[3];
+            for (i = 0; i < mv; i++) {
+               tess_emit_quad(tess, left->idx[mv - i], right->idx[i],
+                              right->idx[i + 1], left->idx[mv - i - 1]);
+            }
+         }
+         break;
+      }
+   }
+}
+
+
+static void
+tess_isolines(struct draw_tessellator *tess, const float outer[4])
+{
+   float pos[DRAW_TESS_MAX_LEVEL + 1];
+   unsigned num_lines, n, i, j;
+
+   /* the number of lines always uses equal spacing */
+   num_lines = tess_segments(PIPE_TESS_SPACING_EQUAL, outer[0], NULL);
+   n = tess_segments(tess->spacing, outer[1], pos);
+
+   for (i = 0; i < num_lines; i++) {
+      const float v = (float) i / (float) num_lines;
+      const unsigned first = tess->num_points;
+
+      for (j = 0; j <= n; j++)
+         tess_add_point(tess, pos[j], v);
+
+      for (j = 0; j < n; j++) {
+         tess->indices[tess->num_indices++] = (ushort) (first + j);
+         tess->indices[tess->num_indices++] = (ushort) (first + j + 1);
+      }
+   }
+}
+
+
+struct draw_tessellator *
+draw_tessellator_create(unsigned prim_mode,
+                        unsigned spacing,
+                        boolean vertex_order_cw,
+                        boolean point_mode)
+{
+   struct draw_tessellator *tess = CALLOC_STRUCT(draw_tessellator);
+
+   if (!tess)
+      return NULL;
+
+   tess->prim_mode = prim_mode;
+   tess->spacing = spacing;
+   tess->vertex_order_cw = vertex_order_cw;
+   tess->point_mode = point_mode;
+
+   tess->output.u = tess->u;
+   tess->output.v = tess->v;
+   tess->output.indices = tess->indices;
+
+   return tess;
+}
+
+
+void
+draw_tessellator_destroy(struct draw_tessellator *tess)
+{
+   FREE(tess);
+}
+
+
+/**
+ * Tessellate a patch.
+ *
+ * \return the domain points and primitives, or NULL if the patch is culled
+ *         (any relevant outer level zero, negative or NaN).  The result is
+ *         valid until the next call.
+ */
+const struct draw_tess_output *
+draw_tessellate(struct draw_tessellator *tess,
+                const float outer[4],
+                const float inner[2])
+{
+   unsigned num_outer, i;
+
+   if (tess->valid &&
+       memcmp(tess->outer, outer, sizeof tess->outer) == 0 &&
+       memcmp(tess->inner, inner, sizeof tess->inner) == 0)
+      return tess->culled ? NULL : &tess->output;
+
+   memcpy(tess->outer, outer, sizeof tess->outer);
+   memcpy(tess->inner, inner, sizeof tess->inner);
+   tess->valid = TRUE;
+
+   switch (tess->prim_mode) {
+   case PIPE_PRIM_TRIANGLES:
+      num_outer = 3;
+      break;
+   case PIPE_PRIM_QUADS:
+      num_outer = 4;
+      break;
+   case PIPE_PRIM_LINES:
+   default:
+      num_outer = 2;
+      break;
+   }
+
+   tess->culled = FALSE;
+   for (i = 0; i < num_outer; i++) {
+      if (!(outer[i] > 0.0f))
+         tess->culled = TRUE;
+   }
+   if (tess->culled)
+      return NULL;
+
+   tess->num_points = 0;
+   tess->num_indices = 0;
+
+   switch (tess->prim_mode) {
+   case PIPE_PRIM_TRIANGLES:
+      tess_triangles(tess, outer, inner);
+      break;
+   case PIPE_PRIM_QUADS:
+      tess_quads(tess, outer, inner);
+      break;
+   case PIPE_PRIM_LINES:
+   default:
+      tess_isolines(tess, outer);
+      break;
+   }
+
+   if (tess->point_mode) {
+      /* all the points are distinct */
+      for (i = 0; i < tess->num_points; i++)
+         tess->indices[i] = (ushort) i;
+      tess->num_indices = tess->num_points;
+   }
+
+   /* pad with copies of the last point */
+   for (i = tess->num_points;
+        i < align(tess->num_points, DRAW_TESS_POINT_ALIGN); i++) {
+      tess->u[i] = tess->u[tess->num_points - 1];
+      tess->v[i] = tess->v[tess->num_points - 1];
+   }
+
+   tess->output.num_points = tess->num_points;
+   tess->output.num_indices = tess->num_indices;
+
+   return &tess->output;
+}
@@ -0,0 +1,90 @@
+/**************************************************************************
+ *
+ * Copyright 2016 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Fixed-function tessellation primitive generator.
+ *
+ * Subdivides the triangle, quad or isoline domain of a patch according to
+ * the tessellation levels, producing the domain points in SoA form (so that
+ * the evaluation shader can load them as whole vectors) and the indices of
+ * the resulting primitives.
+ *
+ * The output only depends on the levels, and patches drawn with the same
+ * levels are common, so the result of the last patch is kept and returned
+ * again as long as the levels don't change.
+ */
+
+#ifndef DRAW_TESSELLATOR_H
+#define DRAW_TESSELLATOR_H
+
+#include "pipe/p_compiler.h"
+
+
+#define DRAW_TESS_MAX_LEVEL 64
+
+/* Enough for the quad domain, which has the most points */
+#define DRAW_TESS_MAX_POINTS ((DRAW_TESS_MAX_LEVEL + 1) * \
+                              (DRAW_TESS_MAX_LEVEL + 1))
+
+/*
+ * The coordinate arrays are padded to a multiple of this, so that they can
+ * be read with vectors of any supported length.
+ */
+#define DRAW_TESS_POINT_ALIGN 16
+
+
+struct draw_tessellator;
+
+
+struct draw_tess_output
+{
+   unsigned num_points;
+   const float *u;
+   const float *v;
+
+   /** 3 indices per triangle, 2 per line, 1 per point */
+   unsigned num_indices;
+   const ushort *indices;
+};
+
+
+struct draw_tessellator *
+draw_tessellator_create(unsigned prim_mode,
+                        unsigned spacing,
+                        boolean vertex_order_cw,
+                        boolean point_mode);
+
+void
+draw_tessellator_destroy(struct draw_tessellator *tess);
+
+const struct draw_tess_output *
+draw_tessellate(struct draw_tessellator *tess,
+                const float outer[4],
+                const float inner[2]);
+
+
+#endif /* DRAW_TESSELLATOR_H */
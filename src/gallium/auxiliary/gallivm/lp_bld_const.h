@@ -40,6 +40,7 @@
 #include "pipe/p_compiler.h"
 #include "gallivm/lp_bld.h"
 #include "gallivm/lp_bld_init.h"
+#include "gallivm/lp_bld_disk_cache.h"
 
 
 
@@ -141,6 +142,10 @@ lp_build_const_int_pointer(struct gallivm_state *gallivm, const void *ptr)
    LLVMTypeRef int_type;
    LLVMValueRef v;
 
+   /* The address is only valid in this process */
+   if (gallivm->cache)
+      gallivm->cache->dont_cache = TRUE;
+
    /* int type large enough to hold a pointer */
    int_type = LLVMIntTypeInContext(gallivm->context, 8 * sizeof(void *));
    v = LLVMConstInt(int_type, (uintptr_t) ptr, 0);
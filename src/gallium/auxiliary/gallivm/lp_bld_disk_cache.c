@@ -0,0 +1,187 @@
+/**************************************************************************
+ *
+ * Copyright 2016 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "c11/threads.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_debug.h"
+#include "util/mesa-sha1.h"
+#include "util/disk_cache.h"
+
+#include "lp_bld_debug.h"
+#include "lp_bld_format.h"
+#include "lp_bld_type.h"
+#include "lp_bld_misc.h"
+#include "lp_bld_disk_cache.h"
+
+
+/**
+ * Default size limit, can be overridden with MESA_SHADER_CACHE_MAX_SIZE.
+ */
+#define LP_DISK_CACHE_DEFAULT_SIZE (256 * 1024 * 1024)
+
+
+static struct disk_cache *lp_disk_cache = NULL;
+static uint32_t lp_disk_cache_timestamp = 0;
+static once_flag lp_disk_cache_once_flag = ONCE_FLAG_INIT;
+
+
+static void
+lp_disk_cache_init(void)
+{
+   /*
+    * The generated IR depends on the gallivm code itself, so entries must be
+    * invalidated whenever the driver is rebuilt.  Don't cache anything if we
+    * can't tell builds apart.
+    */
+   if (!disk_cache_get_function_timestamp((void *) lp_disk_cache_init,
+                                          &lp_disk_cache_timestamp))
+      return;
+
+   lp_disk_cache = disk_cache_create("gallivm", LP_DISK_CACHE_DEFAULT_SIZE);
+}
+
+
+/**
+ * Start computing a cache key.  The caller must add everything the IR of
+ * the module depends on (e.g. TGSI tokens and variant key) with
+ * lp_cached_code_key_update(), and then pass the context to lp_cached_code_init().
+ *
+ * \param kind  distinguishes the different users of the cache
+ * \return  NULL if the disk cache is unavailable.
+ */
+struct mesa_sha1 *
+lp_cached_code_key_begin(const char *kind)
+{
+#if HAVE_LLVM >= 0x0306 && defined(HAVE_SHA1)
+   struct util_cpu_caps caps;
+   struct mesa_sha1 *ctx;
+   unsigned llvm_version = HAVE_LLVM;
+   unsigned debug_flags = gallivm_debug;
+
+   call_once(&lp_disk_cache_once_flag, lp_disk_cache_init);
+   if (!lp_disk_cache)
+      return NULL;
+
+   ctx = _mesa_sha1_init();
+   if (!ctx)
+      return NULL;
+
+   /*
+    * The number of CPUs doesn't affect code generation, so leave it out to
+    * share the cache between machines with the same CPU features.
+    */
+   caps = util_cpu_caps;
+   caps.nr_cpus = 0;
+
+   _mesa_sha1_update(ctx, kind, strlen(kind) + 1);
+   _mesa_sha1_update(ctx, &lp_disk_cache_timestamp,
+                     sizeof lp_disk_cache_timestamp);
+   _mesa_sha1_update(ctx, &llvm_version, sizeof llvm_version);
+   _mesa_sha1_update(ctx, &caps, sizeof caps);
+   _mesa_sha1_update(ctx, &lp_native_vector_width,
+                     sizeof lp_native_vector_width);
+   _mesa_sha1_update(ctx, &lp_build_format_cache_size,
+                     sizeof lp_build_format_cache_size);
+   _mesa_sha1_update(ctx, &debug_flags, sizeof debug_flags);
+
+   return ctx;
+#else
+   /* Only MCJIT supports object caches */
+   return NULL;
+#endif
+}
+
+
+/**
+ * Add \p size bytes of \p data to the key being computed.
+ */
+void
+lp_cached_code_key_update(struct mesa_sha1 *key_ctx,
+                          const void *data, size_t size)
+{
+#ifdef HAVE_SHA1
+   if (key_ctx)
+      _mesa_sha1_update(key_ctx, data, size);
+#endif
+}
+
+
+/**
+ * Finish computing the key and look it up in the disk cache.
+ *
+ * \param key_ctx  as returned by lp_cached_code_key_begin(), or NULL to
+ *                 disable caching.
+ */
+void
+lp_cached_code_init(struct lp_cached_code *cache, struct mesa_sha1 *key_ctx)
+{
+   memset(cache, 0, sizeof *cache);
+
+#ifdef HAVE_SHA1
+   if (!key_ctx)
+      return;
+
+   _mesa_sha1_final(key_ctx, cache->key);
+   cache->enabled = TRUE;
+
+   cache->data = disk_cache_get(lp_disk_cache, cache->key, &cache->data_size);
+   cache->loaded = cache->data != NULL;
+
+   if (gallivm_debug & GALLIVM_DEBUG_PERF) {
+      char buf[41];
+      debug_printf("gallivm disk cache %s for %s\n",
+                   cache->loaded ? "hit" : "miss",
+                   _mesa_sha1_format(buf, cache->key));
+   }
+#endif
+}
+
+
+/**
+ * Store newly generated code in the disk cache and release all resources.
+ * Must be called after the execution engine has been disposed, i.e., after
+ * gallivm_free_ir().
+ */
+void
+lp_cached_code_finish(struct lp_cached_code *cache)
+{
+   if (cache->enabled && !cache->loaded && !cache->dont_cache &&
+       cache->data_size) {
+      disk_cache_put(lp_disk_cache, cache->key, cache->data, cache->data_size);
+   }
+
+   if (cache->jit_obj_cache)
+      lp_free_objcache(cache->jit_obj_cache);
+
+   free(cache->data);
+
+   memset(cache, 0, sizeof *cache);
+}
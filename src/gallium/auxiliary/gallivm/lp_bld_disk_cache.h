@@ -0,0 +1,102 @@
+/**************************************************************************
+ *
+ * Copyright 2016 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * On-disk cache of the object code generated by MCJIT.
+ *
+ * Users compute a key describing everything the generated IR depends on,
+ * attach the resulting lp_cached_code to the gallivm state before building
+ * the IR, and call lp_cached_code_finish() once the gallivm IR has been
+ * freed.  On a hit, the optimization passes and the code generation are
+ * skipped, and MCJIT loads the cached object instead.
+ *
+ * The IR still has to be built, as MCJIT needs the module to resolve the
+ * function addresses.
+ */
+
+#ifndef LP_BLD_DISK_CACHE_H
+#define LP_BLD_DISK_CACHE_H
+
+
+#include "pipe/p_compiler.h"
+#include "util/disk_cache.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+struct mesa_sha1;
+
+
+struct lp_cached_code
+{
+   cache_key key;
+
+   /** The key is valid and the disk cache is available */
+   boolean enabled;
+
+   /** The object code was loaded from disk */
+   boolean loaded;
+
+   /**
+    * The IR embeds addresses which are only valid in this process (e.g.
+    * pointers to C helper functions), so the code must not be stored.
+    */
+   boolean dont_cache;
+
+   /** Object code */
+   void *data;
+   size_t data_size;
+
+   /** llvm::ObjectCache hooked to the execution engine */
+   void *jit_obj_cache;
+};
+
+
+struct mesa_sha1 *
+lp_cached_code_key_begin(const char *kind);
+
+void
+lp_cached_code_key_update(struct mesa_sha1 *key_ctx,
+                          const void *data, size_t size);
+
+void
+lp_cached_code_init(struct lp_cached_code *cache, struct mesa_sha1 *key_ctx);
+
+void
+lp_cached_code_finish(struct lp_cached_code *cache);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* LP_BLD_DISK_CACHE_H */
@@ -37,11 +37,9 @@ lp_build_format_cache_type(struct gallivm_state *gallivm)
    LLVMTypeRef s;
 
    elem_types[LP_BUILD_FORMAT_CACHE_MEMBER_DATA] =
-         LLVMArrayType(LLVMInt32TypeInContext(gallivm->context),
-                       LP_BUILD_FORMAT_CACHE_SIZE * 16);
+         LLVMPointerType(LLVMInt32TypeInContext(gallivm->context), 0);
    elem_types[LP_BUILD_FORMAT_CACHE_MEMBER_TAGS] =
-         LLVMArrayType(LLVMInt64TypeInContext(gallivm->context),
-                       LP_BUILD_FORMAT_CACHE_SIZE);
+         LLVMPointerType(LLVMInt64TypeInContext(gallivm->context), 0);
 #if LP_BUILD_FORMAT_CACHE_DEBUG
    elem_types[LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_TOTAL] =
          LLVMInt64TypeInContext(gallivm->context);
@@ -48,19 +48,27 @@ struct lp_build_context;
 /*
  * Block cache
  *
- * Optional block cache to be used when unpacking big pixel blocks.
- * Must be a power of 2
+ * Optional block cache to be used when unpacking compressed pixel blocks,
+ * see lp_build_format_cache_supported().
+ * The number of blocks must be a power of 2.  This is the default, it can be
+ * overridden with the LP_TEXTURE_CACHE_SIZE environment variable (0 disables
+ * the cache).
  */
 
 #define LP_BUILD_FORMAT_CACHE_SIZE 128
+#define LP_BUILD_FORMAT_CACHE_MAX_SIZE 4096
+
+/** Number of blocks in a cache, 0 if disabled. */
+extern unsigned lp_build_format_cache_size;
 
 /*
+ * The decoded blocks are stored as 4x4 rgba8 texels, row by row.
  * Note: cache_data needs 16 byte alignment.
  */
 struct lp_build_format_cache
 {
-   PIPE_ALIGN_VAR(16) uint32_t cache_data[LP_BUILD_FORMAT_CACHE_SIZE][4][4];
-   uint64_t cache_tags[LP_BUILD_FORMAT_CACHE_SIZE];
+   uint32_t *cache_data;    /**< lp_build_format_cache_size * 16 texels */
+   uint64_t *cache_tags;    /**< address of each cached block, or 0 */
 #if LP_BUILD_FORMAT_CACHE_DEBUG
    uint64_t cache_access_total;
    uint64_t cache_access_miss;
@@ -82,6 +90,18 @@ enum {
 LLVMTypeRef
 lp_build_format_cache_type(struct gallivm_state *gallivm);
 
+struct lp_build_format_cache *
+lp_build_format_cache_create(void);
+
+void
+lp_build_format_cache_clear(struct lp_build_format_cache *cache);
+
+void
+lp_build_format_cache_destroy(struct lp_build_format_cache *cache);
+
+boolean
+lp_build_format_cache_supported(const struct util_format_description *format_desc);
+
 
 /*
  * AoS
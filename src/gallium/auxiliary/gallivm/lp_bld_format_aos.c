@@ -504,10 +504,10 @@ lp_build_fetch_rgba_aos(struct gallivm_state *gallivm,
    }
 
    /*
-    * s3tc rgb formats
+    * compressed formats with a block cache
     */
 
-   if (format_desc->layout == UTIL_FORMAT_LAYOUT_S3TC && cache) {
+   if (cache && lp_build_format_cache_supported(format_desc)) {
       struct lp_type tmp_type;
       LLVMValueRef tmp;
 
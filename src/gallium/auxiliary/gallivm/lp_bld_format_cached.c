@@ -32,7 +32,9 @@
 #include "lp_bld_flow.h"
 #include "lp_bld_swizzle.h"
 
+#include "util/u_format.h"
 #include "util/u_math.h"
+#include "util/u_memory.h"
 
 
 /**
@@ -51,6 +53,85 @@
  */
 
 
+unsigned lp_build_format_cache_size = LP_BUILD_FORMAT_CACHE_SIZE;
+
+
+/**
+ * Allocate a cache with lp_build_format_cache_size blocks.
+ * Returns NULL if the cache is disabled.
+ */
+struct lp_build_format_cache *
+lp_build_format_cache_create(void)
+{
+   struct lp_build_format_cache *cache;
+   unsigned size = lp_build_format_cache_size;
+
+   if (!size)
+      return NULL;
+
+   assert(util_is_power_of_two(size));
+
+   cache = CALLOC_STRUCT(lp_build_format_cache);
+   if (!cache)
+      return NULL;
+
+   cache->cache_data = align_malloc(size * 16 * sizeof(uint32_t), 16);
+   cache->cache_tags = CALLOC(size, sizeof(uint64_t));
+   if (!cache->cache_data || !cache->cache_tags) {
+      lp_build_format_cache_destroy(cache);
+      return NULL;
+   }
+
+   return cache;
+}
+
+
+/**
+ * Invalidate all cached blocks.  Must be done whenever the memory of a
+ * texture which may have been cached could have changed.
+ */
+void
+lp_build_format_cache_clear(struct lp_build_format_cache *cache)
+{
+   memset(cache->cache_tags, 0,
+          lp_build_format_cache_size * sizeof(uint64_t));
+}
+
+
+void
+lp_build_format_cache_destroy(struct lp_build_format_cache *cache)
+{
+   if (cache->cache_data)
+      align_free(cache->cache_data);
+   FREE(cache->cache_tags);
+   FREE(cache);
+}
+
+
+/**
+ * Whether lp_build_fetch_cached_texels() can handle the format.
+ *
+ * This is the case for the 4x4 block compressed formats which decode
+ * exactly to rgba8 (S3TC, unsigned RGTC/LATC, ETC1, and the sRGB variants
+ * which are cached before the sRGB conversion).
+ */
+boolean
+lp_build_format_cache_supported(const struct util_format_description *format_desc)
+{
+   if (format_desc->colorspace == UTIL_FORMAT_COLORSPACE_SRGB) {
+      format_desc = util_format_description(
+         util_format_linear(format_desc->format));
+   }
+
+   return format_desc->layout != UTIL_FORMAT_LAYOUT_PLAIN &&
+          format_desc->layout != UTIL_FORMAT_LAYOUT_SUBSAMPLED &&
+          format_desc->block.width == 4 &&
+          format_desc->block.height == 4 &&
+          format_desc->unpack_rgba_8unorm != NULL &&
+          util_format_fits_8unorm(format_desc);
+}
+
+
 #if LP_BUILD_FORMAT_CACHE_DEBUG
 static void
 update_cache_access(struct gallivm_state *gallivm,
@@ -74,36 +155,23 @@ update_cache_access(struct gallivm_state *gallivm,
 #endif
 
 
-static void
-store_cached_block(struct gallivm_state *gallivm,
-                   LLVMValueRef *col,
-                   LLVMValueRef tag_value,
-                   LLVMValueRef hash_index,
-                   LLVMValueRef cache)
+/**
+ * Return a pointer to the element at index of the cache_data (i32) or
+ * cache_tags (i64) array.
+ */
+static LLVMValueRef
+cache_member_elem_ptr(struct gallivm_state *gallivm,
+                      LLVMValueRef cache,
+                      unsigned member,
+                      LLVMValueRef index)
 {
    LLVMBuilderRef builder = gallivm->builder;
-   LLVMValueRef ptr, indices[3];
-   LLVMTypeRef type_ptr4x32;
-   unsigned count;
-
-   type_ptr4x32 = LLVMPointerType(LLVMVectorType(LLVMInt32TypeInContext(gallivm->context), 4), 0);
-   indices[0] = lp_build_const_int32(gallivm, 0);
-   indices[1] = lp_build_const_int32(gallivm, LP_BUILD_FORMAT_CACHE_MEMBER_TAGS);
-   indices[2] = hash_index;
-   ptr = LLVMBuildGEP(builder, cache, indices, ARRAY_SIZE(indices), "");
-   LLVMBuildStore(builder, tag_value, ptr);
-
-   indices[1] = lp_build_const_int32(gallivm, LP_BUILD_FORMAT_CACHE_MEMBER_DATA);
-   hash_index = LLVMBuildMul(builder, hash_index,
-                             lp_build_const_int32(gallivm, 16), "");
-   for (count = 0; count < 4; count++) {
-      indices[2] = hash_index;
-      ptr = LLVMBuildGEP(builder, cache, indices, ARRAY_SIZE(indices), "");
-      ptr = LLVMBuildBitCast(builder, ptr, type_ptr4x32, "");
-      LLVMBuildStore(builder, col[count], ptr);
-      hash_index = LLVMBuildAdd(builder, hash_index,
-                                lp_build_const_int32(gallivm, 4), "");
-   }
+   LLVMValueRef array;
+
+   array = lp_build_struct_get(gallivm, cache, member,
+                               member == LP_BUILD_FORMAT_CACHE_MEMBER_DATA ?
+                               "cache_data" : "cache_tags");
+   return LLVMBuildGEP(builder, array, &index, 1, "");
 }
 
 
@@ -112,14 +180,11 @@ lookup_cached_pixel(struct gallivm_state *gallivm,
                     LLVMValueRef ptr,
                     LLVMValueRef index)
 {
-   LLVMBuilderRef builder = gallivm->builder;
-   LLVMValueRef member_ptr, indices[3];
+   LLVMValueRef elem_ptr;
 
-   indices[0] = lp_build_const_int32(gallivm, 0);
-   indices[1] = lp_build_const_int32(gallivm, LP_BUILD_FORMAT_CACHE_MEMBER_DATA);
-   indices[2] = index;
-   member_ptr = LLVMBuildGEP(builder, ptr, indices, ARRAY_SIZE(indices), "");
-   return LLVMBuildLoad(builder, member_ptr, "cache_data");
+   elem_ptr = cache_member_elem_ptr(gallivm, ptr,
+                                    LP_BUILD_FORMAT_CACHE_MEMBER_DATA, index);
+   return LLVMBuildLoad(gallivm->builder, elem_ptr, "cache_data");
 }
 
 
@@ -128,17 +193,18 @@ lookup_tag_data(struct gallivm_state *gallivm,
                 LLVMValueRef ptr,
                 LLVMValueRef index)
 {
-   LLVMBuilderRef builder = gallivm->builder;
-   LLVMValueRef member_ptr, indices[3];
+   LLVMValueRef elem_ptr;
 
-   indices[0] = lp_build_const_int32(gallivm, 0);
-   indices[1] = lp_build_const_int32(gallivm, LP_BUILD_FORMAT_CACHE_MEMBER_TAGS);
-   indices[2] = index;
-   member_ptr = LLVMBuildGEP(builder, ptr, indices, ARRAY_SIZE(indices), "");
-   return LLVMBuildLoad(builder, member_ptr, "tag_data");
+   elem_ptr = cache_member_elem_ptr(gallivm, ptr,
+                                    LP_BUILD_FORMAT_CACHE_MEMBER_TAGS, index);
+   return LLVMBuildLoad(gallivm->builder, elem_ptr, "tag_data");
 }
 
 
+/**
+ * Decode the block at ptr_addr into the cache entry hash_index, and update
+ * its tag.
+ */
 static void
 update_cached_block(struct gallivm_state *gallivm,
                     const struct util_format_description *format_desc,
@@ -151,41 +217,41 @@ update_cached_block(struct gallivm_state *gallivm,
    LLVMTypeRef i8t = LLVMInt8TypeInContext(gallivm->context);
    LLVMTypeRef pi8t = LLVMPointerType(i8t, 0);
    LLVMTypeRef i32t = LLVMInt32TypeInContext(gallivm->context);
-   LLVMTypeRef i32x4 = LLVMVectorType(LLVMInt32TypeInContext(gallivm->context), 4);
    LLVMValueRef function;
-   LLVMValueRef tag_value, tmp_ptr;
-   LLVMValueRef col[4];
-   unsigned i, j;
+   LLVMValueRef tag_value, dst_ptr, tag_ptr;
+   LLVMValueRef args[6];
 
    /*
-    * Use format_desc->fetch_rgba_8unorm() for each pixel in the block.
-    * This doesn't actually make any sense whatsoever, someone would need
-    * to write a function doing this for all pixels in a block (either as
-    * an external c function or with generated code). Don't ask.
+    * Decode the whole block at once with format_desc->unpack_rgba_8unorm(),
+    * straight into the cache (16 bytes per row of 4 texels).
     */
 
    {
       /*
        * Function to call looks like:
-       *   fetch(uint8_t *dst, const uint8_t *src, unsigned i, unsigned j)
+       *   unpack(uint8_t *dst, unsigned dst_stride,
+       *          const uint8_t *src, unsigned src_stride,
+       *          unsigned width, unsigned height)
        */
       LLVMTypeRef ret_type;
-      LLVMTypeRef arg_types[4];
+      LLVMTypeRef arg_types[6];
       LLVMTypeRef function_type;
 
-      assert(format_desc->fetch_rgba_8unorm);
+      assert(format_desc->unpack_rgba_8unorm);
 
       ret_type = LLVMVoidTypeInContext(gallivm->context);
       arg_types[0] = pi8t;
-      arg_types[1] = pi8t;
-      arg_types[2] = i32t;
+      arg_types[1] = i32t;
+      arg_types[2] = pi8t;
       arg_types[3] = i32t;
+      arg_types[4] = i32t;
+      arg_types[5] = i32t;
       function_type = LLVMFunctionType(ret_type, arg_types,
                                        ARRAY_SIZE(arg_types), 0);
 
-      /* make const pointer for the C fetch_rgba_8unorm function */
+      /* make const pointer for the C unpack_rgba_8unorm function */
       function = lp_build_const_int_pointer(gallivm,
-         func_to_pointer((func_pointer) format_desc->fetch_rgba_8unorm));
+         func_to_pointer((func_pointer) format_desc->unpack_rgba_8unorm));
 
       /* cast the callee pointer to the function's type */
       function = LLVMBuildBitCast(builder, function,
@@ -193,45 +259,25 @@ update_cached_block(struct gallivm_state *gallivm,
                                   "cast callee");
    }
 
-   tmp_ptr = lp_build_array_alloca(gallivm, i32x4,
-                                   lp_build_const_int32(gallivm, 16),
-                                   "tmp_decode_store");
-   tmp_ptr = LLVMBuildBitCast(builder, tmp_ptr, pi8t, "");
-
-   /*
-    * Invoke format_desc->fetch_rgba_8unorm() for each pixel.
-    * This is going to be really really slow.
-    * Note: the block store format is actually
-    * x0y0x0y1x0y2x0y3 x1y0x1y1x1y2x1y3 ...
-    */
-   for (i = 0; i < 4; ++i) {
-      for (j = 0; j < 4; ++j) {
-         LLVMValueRef args[4];
-         LLVMValueRef dst_offset = lp_build_const_int32(gallivm, (i * 4 + j) * 4);
-
-         /*
-          * Note we actually supply a pointer to the start of the block,
-          * not the start of the texture.
-          */
-         args[0] = LLVMBuildGEP(gallivm->builder, tmp_ptr, &dst_offset, 1, "");
-         args[1] = ptr_addr;
-         args[2] = LLVMConstInt(i32t, i, 0);
-         args[3] = LLVMConstInt(i32t, j, 0);
-         LLVMBuildCall(builder, function, args, ARRAY_SIZE(args), "");
-      }
-   }
+   dst_ptr = LLVMBuildMul(builder, hash_index,
+                          lp_build_const_int32(gallivm, 16), "");
+   dst_ptr = cache_member_elem_ptr(gallivm, cache,
+                                   LP_BUILD_FORMAT_CACHE_MEMBER_DATA, dst_ptr);
 
-   /* Finally store the block - pointless mem copy + update tag. */
-   tmp_ptr = LLVMBuildBitCast(builder, tmp_ptr, LLVMPointerType(i32x4, 0), "");
-   for (i = 0; i < 4; ++i) {
-      LLVMValueRef tmp_offset = lp_build_const_int32(gallivm, i);
-      LLVMValueRef ptr = LLVMBuildGEP(gallivm->builder, tmp_ptr, &tmp_offset, 1, "");
-      col[i] = LLVMBuildLoad(builder, ptr, "");
-   }
+   args[0] = LLVMBuildBitCast(builder, dst_ptr, pi8t, "");
+   args[1] = lp_build_const_int32(gallivm, 4 * 4);
+   args[2] = ptr_addr;
+   args[3] = lp_build_const_int32(gallivm, format_desc->block.bits / 8);
+   args[4] = lp_build_const_int32(gallivm, 4);
+   args[5] = lp_build_const_int32(gallivm, 4);
+   LLVMBuildCall(builder, function, args, ARRAY_SIZE(args), "");
 
    tag_value = LLVMBuildPtrToInt(gallivm->builder, ptr_addr,
                                  LLVMInt64TypeInContext(gallivm->context), "");
-   store_cached_block(gallivm, col, tag_value, hash_index, cache);
+   tag_ptr = cache_member_elem_ptr(gallivm, cache,
+                                   LP_BUILD_FORMAT_CACHE_MEMBER_TAGS,
+                                   hash_index);
+   LLVMBuildStore(builder, tag_value, tag_ptr);
 }
 
 
@@ -264,8 +310,13 @@ lp_build_fetch_cached_texels(struct gallivm_state *gallivm,
    type.width = 32;
    type.length = n;
 
-   assert(format_desc->block.width == 4);
-   assert(format_desc->block.height == 4);
+   assert(lp_build_format_cache_supported(format_desc));
+
+   /* The cache holds the raw decoded texels, sRGB is handled by the caller */
+   if (format_desc->colorspace == UTIL_FORMAT_COLORSPACE_SRGB) {
+      format_desc = util_format_description(
+         util_format_linear(format_desc->format));
+   }
 
    lp_build_context_init(&bld32, gallivm, type);
 
@@ -282,7 +333,7 @@ lp_build_fetch_cached_texels(struct gallivm_state *gallivm,
    /* TODO: not ideal with 32bit pointers... */
 
    low_bit = util_logbase2(format_desc->block.bits / 8);
-   log2size = util_logbase2(LP_BUILD_FORMAT_CACHE_SIZE);
+   log2size = util_logbase2(lp_build_format_cache_size);
    addr = LLVMBuildPtrToInt(builder, base_ptr, i64t, "");
    ptr_addrtrunc = LLVMBuildPtrToInt(builder, base_ptr, i32t, "");
    ptr_addrtrunc = lp_build_broadcast_scalar(&bld32, ptr_addrtrunc);
@@ -300,10 +351,11 @@ lp_build_fetch_cached_texels(struct gallivm_state *gallivm,
                        lp_build_const_int_vec(gallivm, type, log2size), "");
    hash_index = LLVMBuildXor(builder, hash_index, tmp, "");
 
-   hash_mask = lp_build_const_int_vec(gallivm, type, LP_BUILD_FORMAT_CACHE_SIZE - 1);
+   hash_mask = lp_build_const_int_vec(gallivm, type, lp_build_format_cache_size - 1);
    hash_index = LLVMBuildAnd(builder, hash_index, hash_mask, "");
-   ij_index = LLVMBuildShl(builder, i, lp_build_const_int_vec(gallivm, type, 2), "");
-   ij_index = LLVMBuildAdd(builder, ij_index, j, "");
+   /* the blocks are stored row by row */
+   ij_index = LLVMBuildShl(builder, j, lp_build_const_int_vec(gallivm, type, 2), "");
+   ij_index = LLVMBuildAdd(builder, ij_index, i, "");
    block_index = LLVMBuildShl(builder, hash_index,
                               lp_build_const_int_vec(gallivm, type, 4), "");
    block_index = LLVMBuildAdd(builder, ij_index, block_index, "");
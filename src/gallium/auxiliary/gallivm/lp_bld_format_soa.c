@@ -485,9 +485,9 @@ lp_build_fetch_rgba_soa(struct gallivm_state *gallivm,
       return;
    }
 
-   if (format_desc->layout == UTIL_FORMAT_LAYOUT_S3TC &&
-       /* non-srgb case is already handled above */
+   if (/* non-srgb case is already handled above */
        format_desc->colorspace == UTIL_FORMAT_COLORSPACE_SRGB &&
+       lp_build_format_cache_supported(format_desc) &&
        type.floating && type.width == 32 &&
        (type.length == 1 || (type.length % 4 == 0)) &&
        cache) {
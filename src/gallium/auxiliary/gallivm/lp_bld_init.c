@@ -30,12 +30,16 @@
 #include "pipe/p_compiler.h"
 #include "util/u_cpu_detect.h"
 #include "util/u_debug.h"
+#include "util/u_math.h"
 #include "util/u_memory.h"
 #include "util/simple_list.h"
 #include "os/os_time.h"
+#include "util/compile_profile.h"
 #include "lp_bld.h"
 #include "lp_bld_debug.h"
 #include "lp_bld_misc.h"
+#include "lp_bld_disk_cache.h"
+#include "lp_bld_format.h"
 #include "lp_bld_init.h"
 
 #include <llvm-c/Analysis.h>
@@ -210,6 +214,7 @@ gallivm_free_ir(struct gallivm_state *gallivm)
    gallivm->passmgr = NULL;
    gallivm->context = NULL;
    gallivm->builder = NULL;
+   gallivm->cache = NULL;
 }
 
 
@@ -247,6 +252,7 @@ init_gallivm_engine(struct gallivm_state *gallivm)
                                                     &gallivm->code,
                                                     gallivm->module,
                                                     gallivm->memorymgr,
+                                                    gallivm->cache,
                                                     (unsigned) optlevel,
                                                     USE_MCJIT,
                                                     &error);
@@ -458,6 +464,15 @@ lp_build_init(void)
       util_cpu_caps.has_fma = 0;
    }
 
+   lp_build_format_cache_size =
+      debug_get_num_option("LP_TEXTURE_CACHE_SIZE",
+                           LP_BUILD_FORMAT_CACHE_SIZE);
+   if (lp_build_format_cache_size) {
+      lp_build_format_cache_size =
+         util_next_power_of_two(MIN2(lp_build_format_cache_size,
+                                     LP_BUILD_FORMAT_CACHE_MAX_SIZE));
+   }
+
 #ifdef PIPE_ARCH_PPC_64
    /* Set the NJ bit in VSCR to 0 so denormalized values are handled as
     * specified by IEEE standard (PowerISA 2.06 - Section 6.3). This guarantees
@@ -553,9 +568,13 @@ gallivm_compile_module(struct gallivm_state *gallivm)
 {
    LLVMValueRef func;
    int64_t time_begin = 0;
+   struct compile_profile_timer timer;
 
    assert(!gallivm->compiled);
 
+   compile_profile_shader_begin("gallivm %s", gallivm->module_name ?
+                                gallivm->module_name : "unnamed");
+
    if (gallivm->builder) {
       LLVMDisposeBuilder(gallivm->builder);
       gallivm->builder = NULL;
@@ -564,9 +583,15 @@ gallivm_compile_module(struct gallivm_state *gallivm)
    if (gallivm_debug & GALLIVM_DEBUG_PERF)
       time_begin = os_time_get();
 
-   /* Run optimization passes */
+   /*
+    * Run optimization passes, unless MCJIT is going to load the object code
+    * from the disk cache anyway.
+    */
+   compile_profile_begin(&timer, "gallivm", "LLVMRunFunctionPassManager");
    LLVMInitializeFunctionPassManager(gallivm->passmgr);
    func = LLVMGetFirstFunction(gallivm->module);
+   if (gallivm->cache && gallivm->cache->loaded)
+      func = NULL;
    while (func) {
       if (0) {
          debug_printf("optimizing func %s...\n", LLVMGetValueName(func));
@@ -585,6 +610,7 @@ gallivm_compile_module(struct gallivm_state *gallivm)
       func = LLVMGetNextFunction(func);
    }
    LLVMFinalizeFunctionPassManager(gallivm->passmgr);
+   compile_profile_end(&timer, false);
 
    if (gallivm_debug & GALLIVM_DEBUG_PERF) {
       int64_t time_end = os_time_get();
@@ -606,9 +632,11 @@ gallivm_compile_module(struct gallivm_state *gallivm)
 
    if (USE_MCJIT) {
       assert(!gallivm->engine);
+      compile_profile_begin(&timer, "gallivm", "init_gallivm_engine");
       if (!init_gallivm_engine(gallivm)) {
          assert(0);
       }
+      compile_profile_end(&timer, false);
    }
    assert(gallivm->engine);
 
@@ -644,6 +672,8 @@ gallivm_compile_module(struct gallivm_state *gallivm)
       }
    }
 #endif
+
+   compile_profile_shader_end();
 }
 
 
@@ -654,11 +684,18 @@ gallivm_jit_function(struct gallivm_state *gallivm,
 {
    void *code;
    func_pointer jit_func;
+   struct compile_profile_timer timer;
 
    assert(gallivm->compiled);
    assert(gallivm->engine);
 
+   /* This is where MCJIT generates the machine code. */
+   compile_profile_shader_begin("gallivm %s", gallivm->module_name ?
+                                gallivm->module_name : "unnamed");
+   compile_profile_begin(&timer, "gallivm", "LLVMGetPointerToGlobal");
    code = LLVMGetPointerToGlobal(gallivm->engine, func);
+   compile_profile_end(&timer, false);
+   compile_profile_shader_end();
    assert(code);
    jit_func = pointer_to_func(code);
 
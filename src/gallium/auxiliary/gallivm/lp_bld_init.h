@@ -39,6 +39,8 @@
 extern "C" {
 #endif
 
+struct lp_cached_code;
+
 struct gallivm_state
 {
    char *module_name;
@@ -50,6 +52,7 @@ struct gallivm_state
    LLVMBuilderRef builder;
    LLVMMCJITMemoryManagerRef memorymgr;
    struct lp_generated_code *code;
+   struct lp_cached_code *cache;
    unsigned compiled;
 };
 
@@ -70,6 +70,7 @@
 #include <llvm/ExecutionEngine/JITMemoryManager.h>
 #else
 #include <llvm/ExecutionEngine/SectionMemoryManager.h>
+#include <llvm/ExecutionEngine/ObjectCache.h>
 #endif
 #include <llvm/Support/CommandLine.h>
 #include <llvm/Support/Host.h>
@@ -98,6 +99,7 @@
 #include "util/u_cpu_detect.h"
 
 #include "lp_bld_misc.h"
+#include "lp_bld_disk_cache.h"
 
 namespace {
 
@@ -455,6 +457,47 @@ class ShaderMemoryManager : public DelegatingJITMemoryManager {
 };
 
 
+#if HAVE_LLVM >= 0x0306
+/**
+ * Object cache used by MCJIT to either load the object code of a module
+ * from an lp_cached_code, or to hand over newly generated object code so
+ * it can be stored on disk.
+ */
+class LPObjectCache : public llvm::ObjectCache {
+private:
+   struct lp_cached_code *cache;
+
+public:
+   LPObjectCache(struct lp_cached_code *cache) : cache(cache) {}
+
+   virtual ~LPObjectCache() {}
+
+   virtual void notifyObjectCompiled(const llvm::Module *M,
+                                     llvm::MemoryBufferRef Obj)
+   {
+      /* We only ever compile one module per engine */
+      assert(!cache->data);
+
+      cache->data = malloc(Obj.getBufferSize());
+      if (cache->data) {
+         memcpy(cache->data, Obj.getBufferStart(), Obj.getBufferSize());
+         cache->data_size = Obj.getBufferSize();
+      }
+   }
+
+   virtual std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module *M)
+   {
+      if (!cache->loaded)
+         return NULL;
+
+      return llvm::MemoryBuffer::getMemBuffer(
+         llvm::StringRef((const char *) cache->data, cache->data_size),
+         "", false);
+   }
+};
+#endif
+
+
 /**
  * Same as LLVMCreateJITCompilerForModule, but:
  * - allows using MCJIT and enabling AVX feature where available.
@@ -471,6 +514,7 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
                                         lp_generated_code **OutCode,
                                         LLVMModuleRef M,
                                         LLVMMCJITMemoryManagerRef CMM,
+                                        struct lp_cached_code *cache,
                                         unsigned OptLevel,
                                         int useMCJIT,
                                         char **OutError)
@@ -660,6 +704,13 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
    JIT->RegisterJITEventListener(JEL);
 #endif
    if (JIT) {
+#if HAVE_LLVM >= 0x0306
+      if (cache && cache->enabled && useMCJIT) {
+         LPObjectCache *objcache = new LPObjectCache(cache);
+         JIT->setObjectCache(objcache);
+         cache->jit_obj_cache = (void *) objcache;
+      }
+#endif
       *OutJIT = wrap(JIT);
       return 0;
    }
@@ -698,6 +749,16 @@ lp_free_memory_manager(LLVMMCJITMemoryManagerRef memorymgr)
    delete reinterpret_cast<BaseMemoryManager*>(memorymgr);
 }
 
+extern "C"
+void
+lp_free_objcache(void *objcache_ptr)
+{
+#if HAVE_LLVM >= 0x0306
+   LPObjectCache *objcache = (LPObjectCache *) objcache_ptr;
+   delete objcache;
+#endif
+}
+
 extern "C" void
 lp_add_attr_dereferenceable(LLVMValueRef val, uint64_t bytes)
 {
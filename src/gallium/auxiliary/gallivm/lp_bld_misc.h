@@ -41,6 +41,7 @@ extern "C" {
 
 
 struct lp_generated_code;
+struct lp_cached_code;
 
 extern void
 gallivm_init_llvm_targets(void);
@@ -60,6 +61,7 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
                                         struct lp_generated_code **OutCode,
                                         LLVMModuleRef M,
                                         LLVMMCJITMemoryManagerRef MM,
+                                        struct lp_cached_code *cache,
                                         unsigned OptLevel,
                                         int useMCJIT,
                                         char **OutError);
@@ -73,6 +75,9 @@ lp_get_default_memory_manager();
 extern void
 lp_free_memory_manager(LLVMMCJITMemoryManagerRef memorymgr);
 
+extern void
+lp_free_objcache(void *objcache);
+
 extern void
 lp_add_attr_dereferenceable(LLVMValueRef val, uint64_t bytes);
 
@@ -39,6 +39,7 @@
 
 #include "gallivm/lp_bld.h"
 #include "gallivm/lp_bld_tgsi_action.h"
+#include "gallivm/lp_bld_flow.h"
 #include "gallivm/lp_bld_limits.h"
 #include "gallivm/lp_bld_sample.h"
 #include "lp_bld_type.h"
@@ -67,6 +68,7 @@ struct lp_build_mask_context;
 struct gallivm_state;
 struct lp_derivatives;
 struct lp_build_tgsi_gs_iface;
+struct lp_build_tgsi_tess_iface;
 
 
 enum lp_build_tex_modifier {
@@ -170,6 +172,33 @@ struct lp_bld_tgsi_system_values {
    LLVMValueRef prim_id;
    LLVMValueRef basevertex;
    LLVMValueRef invocation_id;
+   LLVMValueRef thread_id[3];
+   /* tessellation shaders, as vectors */
+   LLVMValueRef tess_coord[3];
+   LLVMValueRef tess_outer[4];
+   LLVMValueRef tess_inner[2];
+   LLVMValueRef vertices_in;
+};
+
+
+/**
+ * Work group state.
+ *
+ * When passed to lp_build_tgsi_soa(), the generated code runs a whole work
+ * group, type.length invocations at a time, and thread_id is computed
+ * internally.  This is how tessellation control shaders are run.
+ */
+struct lp_build_tgsi_cs_params
+{
+   /** Work group size, fixed at compile time */
+   unsigned block_size[3];
+
+   /**
+    * Storage for the temporaries of all the invocations of the work group,
+    * lp_build_tgsi_cs_regs_size() bytes.  Only needed if the shader has
+    * barriers.
+    */
+   LLVMValueRef regs_ptr;
 };
 
 
@@ -230,7 +259,15 @@ lp_build_tgsi_soa(struct gallivm_state *gallivm,
                   LLVMValueRef thread_data_ptr,
                   struct lp_build_sampler_soa *sampler,
                   const struct tgsi_shader_info *info,
-                  const struct lp_build_tgsi_gs_iface *gs_iface);
+                  const struct lp_build_tgsi_gs_iface *gs_iface,
+                  const struct lp_build_tgsi_tess_iface *tess_iface,
+                  const struct lp_build_tgsi_cs_params *cs_params);
+
+
+unsigned
+lp_build_tgsi_cs_regs_size(const struct tgsi_shader_info *info,
+                           struct lp_type type,
+                           const unsigned block_size[3]);
 
 
 void
@@ -393,6 +430,12 @@ struct lp_build_tgsi_context
      */
    void (*emit_prologue)(struct lp_build_tgsi_context*);
 
+   /** This function allows the user to insert some instructions after the
+     * declarations and immediates have been processed, right before the
+     * first instruction.  It is optional.
+     */
+   void (*emit_prologue_post_decl)(struct lp_build_tgsi_context*);
+
    /** This function allows the user to insert some instructions at the end of
      * the program.  This callback is intended to be used for emitting
      * instructions to handle the export for the output registers, but it can
@@ -425,6 +468,43 @@ struct lp_build_tgsi_gs_iface
                        LLVMValueRef emitted_prims_vec);
 };
 
+/**
+ * Tessellation shader interface.
+ *
+ * Control shaders are run as a work group of TCS_VERTICES_OUT x N
+ * invocations (see lp_build_tgsi_cs_params), so that N patches are processed
+ * at once, thread_id.x being the invocation and thread_id.y the patch within
+ * the batch.  Evaluation shaders process type.length domain points of a
+ * single patch at a time, and patch_index is zero.
+ *
+ * All the indices are vectors, and a NULL vertex_index denotes a per-patch
+ * attribute.
+ */
+struct lp_build_tgsi_tess_iface
+{
+   LLVMValueRef (*fetch_input)(const struct lp_build_tgsi_tess_iface *tess_iface,
+                               struct lp_build_tgsi_context * bld_base,
+                               LLVMValueRef patch_index,
+                               LLVMValueRef vertex_index,
+                               LLVMValueRef attrib_index,
+                               unsigned swizzle);
+   /* control shaders only */
+   LLVMValueRef (*fetch_output)(const struct lp_build_tgsi_tess_iface *tess_iface,
+                                struct lp_build_tgsi_context * bld_base,
+                                LLVMValueRef patch_index,
+                                LLVMValueRef vertex_index,
+                                LLVMValueRef attrib_index,
+                                unsigned swizzle);
+   void (*store_output)(const struct lp_build_tgsi_tess_iface *tess_iface,
+                        struct lp_build_tgsi_context * bld_base,
+                        LLVMValueRef patch_index,
+                        LLVMValueRef vertex_index,
+                        LLVMValueRef attrib_index,
+                        unsigned swizzle,
+                        LLVMValueRef value,
+                        LLVMValueRef mask);
+};
+
 struct lp_build_tgsi_soa_context
 {
    struct lp_build_tgsi_context bld_base;
@@ -438,6 +518,8 @@ struct lp_build_tgsi_soa_context
    LLVMValueRef emitted_vertices_vec_ptr;
    LLVMValueRef max_output_vertices_vec;
 
+   const struct lp_build_tgsi_tess_iface *tess_iface;
+
    LLVMValueRef consts_ptr;
    LLVMValueRef const_sizes_ptr;
    LLVMValueRef consts[LP_MAX_TGSI_CONST_BUFFERS];
@@ -490,6 +572,14 @@ struct lp_build_tgsi_soa_context
 
    uint num_immediates;
    boolean use_immediates_array;
+
+   /* Work groups */
+   const struct lp_build_tgsi_cs_params *cs_params;
+   struct lp_build_loop_state cs_loop;
+   struct lp_build_mask_context cs_mask;
+   unsigned cs_num_vectors;
+   /* temporaries are kept in cs_params->regs_ptr to survive barriers */
+   boolean cs_regs_in_memory;
 };
 
 void
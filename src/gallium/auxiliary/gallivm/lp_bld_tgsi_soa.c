@@ -1082,28 +1082,20 @@ emit_mask_scatter(struct lp_build_tgsi_soa_context *bld,
 
 
 /**
- * Read the current value of the ADDR register, convert the floats to
- * ints, add the base index and return the vector of offsets.
- * The offsets will be used to index into the constant buffer or
- * temporary register file.
+ * Read the current value of the ADDR register.
  */
 static LLVMValueRef
-get_indirect_index(struct lp_build_tgsi_soa_context *bld,
-                   unsigned reg_file, unsigned reg_index,
-                   const struct tgsi_ind_register *indirect_reg)
+mask_vec(struct lp_build_tgsi_context *bld_base);
+
+static LLVMValueRef
+get_indirect_rel(struct lp_build_tgsi_soa_context *bld,
+                 const struct tgsi_ind_register *indirect_reg)
 {
    LLVMBuilderRef builder = bld->bld_base.base.gallivm->builder;
    struct lp_build_context *uint_bld = &bld->bld_base.uint_bld;
    /* always use X component of address register */
    unsigned swizzle = indirect_reg->Swizzle;
-   LLVMValueRef base;
    LLVMValueRef rel;
-   LLVMValueRef max_index;
-   LLVMValueRef index;
-
-   assert(bld->indirect_files & (1 << reg_file));
-
-   base = lp_build_const_int_vec(bld->bld_base.base.gallivm, uint_bld->type, reg_index);
 
    assert(swizzle < 4);
    switch (indirect_reg->File) {
@@ -1125,6 +1117,31 @@ get_indirect_index(struct lp_build_tgsi_soa_context *bld,
       rel = uint_bld->zero;
    }
 
+   return rel;
+}
+
+/**
+ * Read the current value of the ADDR register, convert the floats to
+ * ints, add the base index and return the vector of offsets.
+ * The offsets will be used to index into the constant buffer or
+ * temporary register file.
+ */
+static LLVMValueRef
+get_indirect_index(struct lp_build_tgsi_soa_context *bld,
+                   unsigned reg_file, unsigned reg_index,
+                   const struct tgsi_ind_register *indirect_reg)
+{
+   struct lp_build_context *uint_bld = &bld->bld_base.uint_bld;
+   LLVMValueRef base;
+   LLVMValueRef rel;
+   LLVMValueRef max_index;
+   LLVMValueRef index;
+
+   assert(bld->indirect_files & (1 << reg_file));
+
+   base = lp_build_const_int_vec(bld->bld_base.base.gallivm, uint_bld->type, reg_index);
+   rel = get_indirect_rel(bld, indirect_reg);
+
    index = lp_build_add(uint_bld, base, rel);
 
    /*
@@ -1148,6 +1165,39 @@ get_indirect_index(struct lp_build_tgsi_soa_context *bld,
    return index;
 }
 
+/**
+ * Vertex index of a per-vertex input or output of the tessellation shaders.
+ * Unlike get_indirect_index() it's not clamped to the register file size,
+ * the tessellation interface takes care of that.
+ */
+static LLVMValueRef
+get_tess_vertex_index(struct lp_build_tgsi_soa_context *bld,
+                      const struct tgsi_dimension *dim,
+                      const struct tgsi_ind_register *dim_indirect)
+{
+   struct lp_build_context *uint_bld = &bld->bld_base.uint_bld;
+   LLVMValueRef index;
+
+   index = lp_build_const_int_vec(bld->bld_base.base.gallivm, uint_bld->type,
+                                  dim->Index);
+   if (dim->Indirect) {
+      index = lp_build_add(uint_bld, index, get_indirect_rel(bld, dim_indirect));
+   }
+
+   return index;
+}
+
+/**
+ * The patch within the batch processed by a tessellation shader.
+ */
+static LLVMValueRef
+get_tess_patch_index(struct lp_build_tgsi_soa_context *bld)
+{
+   if (bld->cs_params)
+      return bld->system_values.thread_id[1];
+   return bld->bld_base.uint_bld.zero;
+}
+
 static struct lp_build_context *
 stype_to_fetch(struct lp_build_tgsi_context * bld_base,
 	       enum tgsi_opcode_type stype)
@@ -1562,6 +1612,65 @@ emit_fetch_gs_input(
    return res;
 }
 
+/**
+ * Fetch a tessellation shader input, or a control shader output.
+ */
+static LLVMValueRef
+emit_fetch_tess_reg(
+   struct lp_build_tgsi_context * bld_base,
+   const struct tgsi_full_src_register * reg,
+   enum tgsi_opcode_type stype,
+   unsigned swizzle)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   struct gallivm_state *gallivm = bld->bld_base.base.gallivm;
+   const struct lp_build_tgsi_tess_iface *tess_iface = bld->tess_iface;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMValueRef patch_index = get_tess_patch_index(bld);
+   LLVMValueRef vertex_index = NULL;
+   LLVMValueRef attrib_index;
+   LLVMValueRef res;
+   LLVMValueRef (*fetch)(const struct lp_build_tgsi_tess_iface *,
+                         struct lp_build_tgsi_context *,
+                         LLVMValueRef, LLVMValueRef, LLVMValueRef, unsigned);
+
+   fetch = reg->Register.File == TGSI_FILE_OUTPUT ?
+           tess_iface->fetch_output : tess_iface->fetch_input;
+
+   if (reg->Register.Indirect) {
+      attrib_index = get_indirect_index(bld,
+                                        reg->Register.File,
+                                        reg->Register.Index,
+                                        &reg->Indirect);
+   } else {
+      attrib_index = lp_build_const_int_vec(gallivm, bld_base->uint_bld.type,
+                                            reg->Register.Index);
+   }
+
+   if (reg->Register.Dimension) {
+      vertex_index = get_tess_vertex_index(bld, &reg->Dimension,
+                                           &reg->DimIndirect);
+   }
+
+   res = fetch(tess_iface, bld_base, patch_index, vertex_index,
+               attrib_index, swizzle);
+   assert(res);
+
+   if (tgsi_type_is_64bit(stype)) {
+      LLVMValueRef res2;
+      res2 = fetch(tess_iface, bld_base, patch_index, vertex_index,
+                   attrib_index, swizzle + 1);
+      assert(res2);
+      res = emit_fetch_64bit(bld_base, stype, res, res2);
+   } else if (stype == TGSI_TYPE_UNSIGNED) {
+      res = LLVMBuildBitCast(builder, res, bld_base->uint_bld.vec_type, "");
+   } else if (stype == TGSI_TYPE_SIGNED) {
+      res = LLVMBuildBitCast(builder, res, bld_base->int_bld.vec_type, "");
+   }
+
+   return res;
+}
+
 static LLVMValueRef
 emit_fetch_temporary(
    struct lp_build_tgsi_context * bld_base,
@@ -1664,11 +1773,44 @@ emit_fetch_system_value(
 
    case TGSI_SEMANTIC_PRIMID:
       res = bld->system_values.prim_id;
+      if (bld->tess_iface && bld->cs_params) {
+         /* prim_id is the first patch of the batch */
+         res = LLVMBuildAdd(builder, res, get_tess_patch_index(bld), "");
+      }
       atype = TGSI_TYPE_UNSIGNED;
       break;
 
    case TGSI_SEMANTIC_INVOCATIONID:
-      res = lp_build_broadcast_scalar(&bld_base->uint_bld, bld->system_values.invocation_id);
+      if (bld->tess_iface && bld->cs_params)
+         res = bld->system_values.thread_id[0];
+      else
+         res = lp_build_broadcast_scalar(&bld_base->uint_bld, bld->system_values.invocation_id);
+      atype = TGSI_TYPE_UNSIGNED;
+      break;
+
+   case TGSI_SEMANTIC_TESSCOORD:
+      if (swizzle < 3)
+         res = bld->system_values.tess_coord[swizzle];
+      else
+         res = bld_base->base.zero;
+      atype = TGSI_TYPE_FLOAT;
+      break;
+
+   case TGSI_SEMANTIC_TESSOUTER:
+      res = bld->system_values.tess_outer[swizzle];
+      atype = TGSI_TYPE_FLOAT;
+      break;
+
+   case TGSI_SEMANTIC_TESSINNER:
+      if (swizzle < 2)
+         res = bld->system_values.tess_inner[swizzle];
+      else
+         res = bld_base->base.zero;
+      atype = TGSI_TYPE_FLOAT;
+      break;
+
+   case TGSI_SEMANTIC_VERTICESIN:
+      res = bld->system_values.vertices_in;
       atype = TGSI_TYPE_UNSIGNED;
       break;
 
@@ -1784,26 +1926,23 @@ emit_fetch_predicate(
 }
 
 /**
- * store an array of 8 64-bit into two arrays of 8 floats
+ * Split an array of 8 64-bit into two arrays of 8 floats
  * i.e.
  * value is d0, d1, d2, d3 etc.
  * each 64-bit has high and low pieces x, y
- * so gets stored into the separate channels as:
- * chan_ptr = d0.x, d1.x, d2.x, d3.x
- * chan_ptr2 = d0.y, d1.y, d2.y, d3.y
+ * so gets split into:
+ * temp = d0.x, d1.x, d2.x, d3.x
+ * temp2 = d0.y, d1.y, d2.y, d3.y
  */
 static void
-emit_store_64bit_chan(struct lp_build_tgsi_context *bld_base,
-                      LLVMValueRef chan_ptr, LLVMValueRef chan_ptr2,
-                      LLVMValueRef pred,
-                      LLVMValueRef value)
+split_64bit_value(struct lp_build_tgsi_context *bld_base,
+                  LLVMValueRef value,
+                  LLVMValueRef *temp,
+                  LLVMValueRef *temp2)
 {
-   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
    struct gallivm_state *gallivm = bld_base->base.gallivm;
    LLVMBuilderRef builder = gallivm->builder;
-   struct lp_build_context *float_bld = &bld_base->base;
    unsigned i;
-   LLVMValueRef temp, temp2;
    LLVMValueRef shuffles[8];
    LLVMValueRef shuffles2[8];
 
@@ -1812,21 +1951,95 @@ emit_store_64bit_chan(struct lp_build_tgsi_context *bld_base,
       shuffles2[i] = lp_build_const_int32(gallivm, (i * 2) + 1);
    }
 
-   temp = LLVMBuildShuffleVector(builder, value,
-                                 LLVMGetUndef(LLVMTypeOf(value)),
-                                 LLVMConstVector(shuffles,
-                                                 bld_base->base.type.length),
-                                 "");
-   temp2 = LLVMBuildShuffleVector(builder, value,
+   *temp = LLVMBuildShuffleVector(builder, value,
                                   LLVMGetUndef(LLVMTypeOf(value)),
-                                  LLVMConstVector(shuffles2,
+                                  LLVMConstVector(shuffles,
                                                   bld_base->base.type.length),
                                   "");
+   *temp2 = LLVMBuildShuffleVector(builder, value,
+                                   LLVMGetUndef(LLVMTypeOf(value)),
+                                   LLVMConstVector(shuffles2,
+                                                   bld_base->base.type.length),
+                                   "");
+}
+
+/**
+ * store an array of 8 64-bit into two arrays of 8 floats
+ * i.e.
+ * value is d0, d1, d2, d3 etc.
+ * each 64-bit has high and low pieces x, y
+ * so gets stored into the separate channels as:
+ * chan_ptr = d0.x, d1.x, d2.x, d3.x
+ * chan_ptr2 = d0.y, d1.y, d2.y, d3.y
+ */
+static void
+emit_store_64bit_chan(struct lp_build_tgsi_context *bld_base,
+                      LLVMValueRef chan_ptr, LLVMValueRef chan_ptr2,
+                      LLVMValueRef pred,
+                      LLVMValueRef value)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   struct lp_build_context *float_bld = &bld_base->base;
+   LLVMValueRef temp, temp2;
+
+   split_64bit_value(bld_base, value, &temp, &temp2);
 
    lp_exec_mask_store(&bld->exec_mask, float_bld, pred, temp, chan_ptr);
    lp_exec_mask_store(&bld->exec_mask, float_bld, pred, temp2, chan_ptr2);
 }
 
+/**
+ * Store a tessellation control shader output.
+ */
+static void
+emit_store_tcs_output(struct lp_build_tgsi_context *bld_base,
+                      const struct tgsi_full_dst_register *reg,
+                      LLVMValueRef indirect_index,
+                      unsigned chan_index,
+                      LLVMValueRef pred,
+                      LLVMValueRef value,
+                      boolean is_64bit)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   const struct lp_build_tgsi_tess_iface *tess_iface = bld->tess_iface;
+   LLVMValueRef patch_index = get_tess_patch_index(bld);
+   LLVMValueRef vertex_index = NULL;
+   LLVMValueRef attrib_index;
+   LLVMValueRef mask;
+
+   mask = mask_vec(bld_base);
+   if (pred)
+      mask = LLVMBuildAnd(builder, mask, pred, "");
+
+   if (reg->Register.Indirect) {
+      attrib_index = indirect_index;
+   } else {
+      attrib_index = lp_build_const_int_vec(gallivm, bld_base->uint_bld.type,
+                                            reg->Register.Index);
+   }
+
+   if (reg->Register.Dimension) {
+      vertex_index = get_tess_vertex_index(bld, &reg->Dimension,
+                                           &reg->DimIndirect);
+   }
+
+   if (is_64bit) {
+      LLVMValueRef temp, temp2;
+
+      split_64bit_value(bld_base, value, &temp, &temp2);
+      tess_iface->store_output(tess_iface, bld_base, patch_index, vertex_index,
+                               attrib_index, chan_index, temp, mask);
+      tess_iface->store_output(tess_iface, bld_base, patch_index, vertex_index,
+                               attrib_index, chan_index + 1, temp2, mask);
+   } else {
+      value = LLVMBuildBitCast(builder, value, bld_base->base.vec_type, "");
+      tess_iface->store_output(tess_iface, bld_base, patch_index, vertex_index,
+                               attrib_index, chan_index, value, mask);
+   }
+}
+
 /**
  * Register store.
  */
@@ -1881,6 +2094,12 @@ emit_store_chan(
 
    switch( reg->Register.File ) {
    case TGSI_FILE_OUTPUT:
+      if (bld->tess_iface && bld->cs_params) {
+         emit_store_tcs_output(bld_base, reg, indirect_index, chan_index,
+                               pred, value, tgsi_type_is_64bit(dtype));
+         break;
+      }
+
       /* Outputs are always stored as floats */
       value = LLVMBuildBitCast(builder, value, float_bld->vec_type, "");
 
@@ -3735,12 +3954,136 @@ cont_emit(
    lp_exec_continue(&bld->exec_mask);
 }
 
+/*
+ * Work groups (see lp_build_tgsi_cs_params).
+ *
+ * The invocations of a work group are run type.length at a time in a loop.
+ * A barrier ends the loop and starts a new one, so that all the invocations
+ * reach it before any proceeds.  The temporaries are then kept in memory,
+ * separately for each vector of invocations.
+ */
+
+static void
+cs_begin_phase(struct lp_build_tgsi_soa_context *bld)
+{
+   struct gallivm_state *gallivm = bld->bld_base.base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_build_context *uint_bld = &bld->bld_base.uint_bld;
+   const struct lp_build_tgsi_cs_params *cs = bld->cs_params;
+   const unsigned length = uint_bld->type.length;
+   LLVMValueRef lanes[LP_MAX_VECTOR_LENGTH];
+   LLVMValueRef vec_index, ids, tmp, block_width, block_height, valid;
+   unsigned i;
+
+   lp_build_loop_begin(&bld->cs_loop, gallivm, lp_build_const_int32(gallivm, 0));
+   vec_index = bld->cs_loop.counter;
+
+   /* Linear ids of the invocations */
+   for (i = 0; i < length; i++)
+      lanes[i] = lp_build_const_int32(gallivm, i);
+   tmp = LLVMBuildMul(builder, vec_index,
+                      lp_build_const_int32(gallivm, length), "");
+   ids = LLVMBuildAdd(builder, lp_build_broadcast_scalar(uint_bld, tmp),
+                      LLVMConstVector(lanes, length), "");
+
+   block_width = lp_build_const_int_vec(gallivm, uint_bld->type,
+                                        cs->block_size[0]);
+   block_height = lp_build_const_int_vec(gallivm, uint_bld->type,
+                                         cs->block_size[1]);
+
+   bld->system_values.thread_id[0] = LLVMBuildURem(builder, ids, block_width, "");
+   tmp = LLVMBuildUDiv(builder, ids, block_width, "");
+   bld->system_values.thread_id[1] = LLVMBuildURem(builder, tmp, block_height, "");
+   bld->system_values.thread_id[2] = LLVMBuildUDiv(builder, tmp, block_height, "");
+
+   if (bld->cs_regs_in_memory) {
+      unsigned stride = (bld->bld_base.info->file_max[TGSI_FILE_TEMPORARY] + 1) * 4;
+      LLVMTypeRef vec_ptr_type = LLVMPointerType(bld->bld_base.base.vec_type, 0);
+      LLVMValueRef regs = LLVMBuildBitCast(builder, cs->regs_ptr, vec_ptr_type, "");
+
+      tmp = LLVMBuildMul(builder, vec_index,
+                         lp_build_const_int32(gallivm, stride), "");
+      bld->temps_array = LLVMBuildGEP(builder, regs, &tmp, 1, "temp_array");
+   }
+
+   valid = lp_build_cmp(uint_bld, PIPE_FUNC_LESS, ids,
+                        lp_build_const_int_vec(gallivm, uint_bld->type,
+                                               cs->block_size[0] *
+                                               cs->block_size[1] *
+                                               cs->block_size[2]));
+   lp_build_mask_begin(&bld->cs_mask, gallivm, bld->bld_base.base.type, valid);
+}
+
+
+static void
+cs_end_phase(struct lp_build_tgsi_soa_context *bld)
+{
+   struct gallivm_state *gallivm = bld->bld_base.base.gallivm;
+
+   lp_build_mask_end(&bld->cs_mask);
+   lp_build_loop_end(&bld->cs_loop,
+                     lp_build_const_int32(gallivm, bld->cs_num_vectors),
+                     NULL);
+}
+
+
+/**
+ * Size of the storage needed for the temporaries of a work group.
+ */
+unsigned
+lp_build_tgsi_cs_regs_size(const struct tgsi_shader_info *info,
+                           struct lp_type type,
+                           const unsigned block_size[3])
+{
+   unsigned num_invocations = block_size[0] * block_size[1] * block_size[2];
+   unsigned num_vectors = (num_invocations + type.length - 1) / type.length;
+   unsigned stride = (info->file_max[TGSI_FILE_TEMPORARY] + 1) * 4;
+
+   if (!info->opcode_count[TGSI_OPCODE_BARRIER])
+      return 0;
+
+   return num_vectors * stride * type.length * (type.width / 8);
+}
+
+
+static void
+barrier_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   struct lp_exec_mask *mask = &bld->exec_mask;
+   struct function_ctx *ctx = func_ctx(mask);
+
+   if (!bld->cs_params)
+      return;
+
+   /*
+    * Splitting the loop is only possible outside of any control flow,
+    * which is the only place GLSL allows barrier() in control shaders.
+    */
+   if (mask->function_stack_size > 1 ||
+       mask->ret_in_main ||
+       ctx->cond_stack_size ||
+       ctx->loop_stack_size ||
+       ctx->switch_stack_size) {
+      assert(!"BARRIER inside control flow");
+      return;
+   }
+
+   cs_end_phase(bld);
+   cs_begin_phase(bld);
+}
+
+
 static void emit_prologue(struct lp_build_tgsi_context * bld_base)
 {
    struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
    struct gallivm_state * gallivm = bld_base->base.gallivm;
 
-   if (bld->indirect_files & (1 << TGSI_FILE_TEMPORARY)) {
+   if ((bld->indirect_files & (1 << TGSI_FILE_TEMPORARY)) &&
+       !bld->cs_regs_in_memory) {
       LLVMValueRef array_size =
          lp_build_const_int32(gallivm,
                          bld_base->info->file_max[TGSI_FILE_TEMPORARY] * 4 + 4);
@@ -3749,7 +4092,8 @@ static void emit_prologue(struct lp_build_tgsi_context * bld_base)
                                               "temp_array");
    }
 
-   if (bld->indirect_files & (1 << TGSI_FILE_OUTPUT)) {
+   if ((bld->indirect_files & (1 << TGSI_FILE_OUTPUT)) &&
+       !(bld->tess_iface && bld->cs_params)) {
       LLVMValueRef array_size =
          lp_build_const_int32(gallivm,
                             bld_base->info->file_max[TGSI_FILE_OUTPUT] * 4 + 4);
@@ -3769,7 +4113,8 @@ static void emit_prologue(struct lp_build_tgsi_context * bld_base)
 
    /* If we have indirect addressing in inputs we need to copy them into
     * our alloca array to be able to iterate over them */
-   if (bld->indirect_files & (1 << TGSI_FILE_INPUT) && !bld->gs_iface) {
+   if (bld->indirect_files & (1 << TGSI_FILE_INPUT) &&
+       !bld->gs_iface && !bld->tess_iface) {
       unsigned index, chan;
       LLVMTypeRef vec_type = bld_base->base.vec_type;
       LLVMValueRef array_size = lp_build_const_int32(gallivm,
@@ -3821,22 +4166,34 @@ static void emit_prologue(struct lp_build_tgsi_context * bld_base)
    if (DEBUG_EXECUTION) {
       lp_build_printf(gallivm, "\n");
       emit_dump_file(bld, TGSI_FILE_CONSTANT);
-      if (!bld->gs_iface)
+      if (!bld->gs_iface && !bld->tess_iface)
          emit_dump_file(bld, TGSI_FILE_INPUT);
    }
 }
 
+static void emit_prologue_post_decl(struct lp_build_tgsi_context * bld_base)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+
+   if (bld->cs_params)
+      cs_begin_phase(bld);
+}
+
 static void emit_epilogue(struct lp_build_tgsi_context * bld_base)
 {
    struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
    LLVMBuilderRef builder = bld_base->base.gallivm->builder;
 
+   if (bld->cs_params)
+      cs_end_phase(bld);
+
    if (DEBUG_EXECUTION) {
       /* for debugging */
       if (0) {
          emit_dump_file(bld, TGSI_FILE_TEMPORARY);
       }
-      emit_dump_file(bld, TGSI_FILE_OUTPUT);
+      if (!(bld->tess_iface && bld->cs_params))
+         emit_dump_file(bld, TGSI_FILE_OUTPUT);
       lp_build_printf(bld_base->base.gallivm, "\n");
    }
 
@@ -3859,7 +4216,7 @@ static void emit_epilogue(struct lp_build_tgsi_context * bld_base)
                                  &bld->bld_base,
                                  total_emitted_vertices_vec,
                                  emitted_prims_vec);
-   } else {
+   } else if (!(bld->tess_iface && bld->cs_params)) {
       gather_outputs(bld);
    }
 }
@@ -3878,7 +4235,9 @@ lp_build_tgsi_soa(struct gallivm_state *gallivm,
                   LLVMValueRef thread_data_ptr,
                   struct lp_build_sampler_soa *sampler,
                   const struct tgsi_shader_info *info,
-                  const struct lp_build_tgsi_gs_iface *gs_iface)
+                  const struct lp_build_tgsi_gs_iface *gs_iface,
+                  const struct lp_build_tgsi_tess_iface *tess_iface,
+                  const struct lp_build_tgsi_cs_params *cs_params)
 {
    struct lp_build_tgsi_soa_context bld;
 
@@ -3921,6 +4280,14 @@ lp_build_tgsi_soa(struct gallivm_state *gallivm,
    if (info->file_max[TGSI_FILE_TEMPORARY] >= LP_MAX_INLINED_TEMPS) {
       bld.indirect_files |= (1 << TGSI_FILE_TEMPORARY);
    }
+   /*
+    * The temporaries of work groups with barriers must survive across
+    * the invocation loops, so they live in memory provided by the caller.
+    */
+   if (cs_params && info->opcode_count[TGSI_OPCODE_BARRIER]) {
+      bld.indirect_files |= (1 << TGSI_FILE_TEMPORARY);
+      bld.cs_regs_in_memory = TRUE;
+   }
    /*
     * For performance reason immediates are always backed in a static
     * array, but if their number is too great, we have to use just
@@ -3946,6 +4313,7 @@ lp_build_tgsi_soa(struct gallivm_state *gallivm,
    bld.bld_base.emit_immediate = lp_emit_immediate_soa;
 
    bld.bld_base.emit_prologue = emit_prologue;
+   bld.bld_base.emit_prologue_post_decl = emit_prologue_post_decl;
    bld.bld_base.emit_epilogue = emit_epilogue;
 
    /* Set opcode actions */
@@ -4019,6 +4387,31 @@ lp_build_tgsi_soa(struct gallivm_state *gallivm,
                                 max_output_vertices);
    }
 
+   if (tess_iface) {
+      /* inputs are always indirect with tessellation */
+      bld.indirect_files |= (1 << TGSI_FILE_INPUT);
+      bld.tess_iface = tess_iface;
+      bld.bld_base.emit_fetch_funcs[TGSI_FILE_INPUT] = emit_fetch_tess_reg;
+      if (cs_params) {
+         /* control shaders can read back their outputs */
+         bld.indirect_files |= (1 << TGSI_FILE_OUTPUT);
+         bld.bld_base.emit_fetch_funcs[TGSI_FILE_OUTPUT] = emit_fetch_tess_reg;
+      }
+   }
+
+   if (cs_params) {
+      unsigned num_invocations = cs_params->block_size[0] *
+                                 cs_params->block_size[1] *
+                                 cs_params->block_size[2];
+
+      assert(!mask);
+      bld.cs_params = cs_params;
+      bld.cs_num_vectors = (num_invocations + type.length - 1) / type.length;
+      bld.mask = &bld.cs_mask;
+
+      bld.bld_base.op_actions[TGSI_OPCODE_BARRIER].emit = barrier_emit;
+   }
+
    lp_exec_mask_init(&bld.exec_mask, &bld.bld_base.int_bld);
 
    bld.system_values = *system_values;
@@ -35,6 +35,7 @@
 #include "u_math.h"
 #include "u_memory.h"
 #include "u_format.h"
+#include "u_format_convert.h"
 #include "u_format_s3tc.h"
 #include "u_surface.h"
 
@@ -537,6 +538,11 @@ util_format_fits_8unorm(const struct util_format_description *format_desc)
          return TRUE;
       return FALSE;
 
+   case UTIL_FORMAT_LAYOUT_ETC:
+      if (format_desc->format == PIPE_FORMAT_ETC1_RGB8)
+         return TRUE;
+      return FALSE;
+
    case UTIL_FORMAT_LAYOUT_PLAIN:
       /*
        * For these we can find a generic rule.
@@ -632,7 +638,6 @@ util_format_translate(enum pipe_format dst_format,
 
    /*
     * TODO: double formats will loose precision
-    * TODO: Add a special case for formats that are mere swizzles of each other
     */
 
    if (src_format_desc->colorspace == UTIL_FORMAT_COLORSPACE_ZS ||
@@ -675,6 +680,17 @@ util_format_translate(enum pipe_format dst_format,
       return TRUE;
    }
 
+   /*
+    * Formats that are swizzles of each other, or that differ in the width
+    * of their unorm channels, are converted directly.
+    */
+
+   if (util_format_convert_rows(dst_format_desc, dst_row, dst_stride,
+                                src_format_desc, src_row, src_stride,
+                                width, height)) {
+      return TRUE;
+   }
+
    if (util_format_fits_8unorm(src_format_desc) ||
        util_format_fits_8unorm(dst_format_desc)) {
       unsigned tmp_stride;
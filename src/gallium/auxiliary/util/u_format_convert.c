@@ -0,0 +1,579 @@
+/**************************************************************************
+ *
+ * Copyright 2016 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+
+/**
+ * @file
+ * Direct conversions between plain unorm formats.
+ *
+ * A conversion is described as a few masks and shifts applied to whole
+ * pixel words, which is what the generated pack and unpack functions do one
+ * channel at a time, so the SIMD kernels handle any pair of formats of the
+ * same kind with the same code.
+ */
+
+
+#include "util/u_cpu_detect.h"
+#include "util/u_format.h"
+#include "util/u_format_convert.h"
+#include "util/u_sse.h"
+
+
+/**
+ * Values for _mm_mulhi_epu16(x << (16 - bits), mul) >> shift to be
+ * x * 0xff / ((1 << bits) - 1), rounded down like the generated unpack
+ * functions do, for every x that fits in bits.
+ */
+const uint16_t util_format_widen_mul[9] = {
+   0, 510, 340, 583, 272, 1053, 4145, 16449, 256
+};
+
+const uint8_t util_format_widen_shift[9] = {
+   0, 0, 0, 1, 0, 2, 4, 6, 0
+};
+
+
+static boolean
+is_plain_unorm(const struct util_format_description *desc)
+{
+   unsigned i;
+
+   if (desc->layout != UTIL_FORMAT_LAYOUT_PLAIN ||
+       desc->colorspace != UTIL_FORMAT_COLORSPACE_RGB ||
+       desc->block.width != 1 ||
+       desc->block.height != 1 ||
+       (desc->block.bits != 16 && desc->block.bits != 32)) {
+      return FALSE;
+   }
+
+   for (i = 0; i < desc->nr_channels; i++) {
+      const struct util_format_channel_description *chan = &desc->channel[i];
+
+      if (chan->type == UTIL_FORMAT_TYPE_VOID)
+         continue;
+
+      if (chan->type != UTIL_FORMAT_TYPE_UNSIGNED ||
+          !chan->normalized ||
+          chan->pure_integer ||
+          chan->size > 8) {
+         return FALSE;
+      }
+   }
+
+   return TRUE;
+}
+
+
+static void
+add_move(struct util_format_convert *conv, uint32_t mask, int shift)
+{
+   unsigned i;
+
+   for (i = 0; i < conv->num_moves; i++) {
+      if (conv->moves[i].shift == shift) {
+         conv->moves[i].mask |= mask;
+         return;
+      }
+   }
+
+   conv->moves[conv->num_moves].mask = mask;
+   conv->moves[conv->num_moves].shift = shift;
+   conv->num_moves++;
+}
+
+
+/**
+ * Describes the conversion from src_desc to dst_desc, or returns FALSE if
+ * it isn't one of the supported kinds.
+ */
+boolean
+util_format_convert_init(struct util_format_convert *conv,
+                         const struct util_format_description *dst_desc,
+                         const struct util_format_description *src_desc)
+{
+   unsigned i, j;
+
+   memset(conv, 0, sizeof *conv);
+
+   if (!is_plain_unorm(src_desc) || !is_plain_unorm(dst_desc))
+      return FALSE;
+
+   if (src_desc->block.bits == 32)
+      conv->kind = dst_desc->block.bits == 32 ? UTIL_FORMAT_CONVERT_32_32 :
+                                                UTIL_FORMAT_CONVERT_32_16;
+   else
+      conv->kind = dst_desc->block.bits == 32 ? UTIL_FORMAT_CONVERT_16_32 :
+                                                UTIL_FORMAT_CONVERT_16_16;
+
+   for (i = 0; i < dst_desc->nr_channels; i++) {
+      const struct util_format_channel_description *dst_chan =
+         &dst_desc->channel[i];
+      const struct util_format_channel_description *src_chan;
+      unsigned component = 4;
+      unsigned swizzle;
+
+      if (dst_chan->type == UTIL_FORMAT_TYPE_VOID)
+         continue;
+
+      /* The component that is packed into this channel.  Like the pack
+       * functions, use the first one when there are several, so that L8
+       * gets red.
+       */
+      for (j = 0; j < 4; j++) {
+         if (dst_desc->swizzle[j] == i) {
+            component = j;
+            break;
+         }
+      }
+      if (component == 4)
+         continue;
+
+      swizzle = src_desc->swizzle[component];
+      if (swizzle == PIPE_SWIZZLE_1) {
+         conv->constant |= ((1u << dst_chan->size) - 1) << dst_chan->shift;
+         continue;
+      }
+      if (swizzle > PIPE_SWIZZLE_W)
+         continue;
+
+      src_chan = &src_desc->channel[swizzle];
+
+      if (conv->kind == UTIL_FORMAT_CONVERT_16_32) {
+         if (dst_chan->size != 8)
+            return FALSE;
+
+         conv->widens[conv->num_widens].src_shift = src_chan->shift;
+         conv->widens[conv->num_widens].src_bits = src_chan->size;
+         conv->widens[conv->num_widens].dst_shift = dst_chan->shift;
+         conv->num_widens++;
+      } else if (src_chan->size == dst_chan->size) {
+         add_move(conv, ((1u << src_chan->size) - 1) << src_chan->shift,
+                  (int)dst_chan->shift - (int)src_chan->shift);
+      } else if (src_chan->size == 8) {
+         /* Narrowing from 8 bits keeps the top bits. */
+         unsigned shift = src_chan->shift + 8 - dst_chan->size;
+
+         add_move(conv, ((1u << dst_chan->size) - 1) << shift,
+                  (int)dst_chan->shift - (int)shift);
+      } else {
+         return FALSE;
+      }
+   }
+
+   return TRUE;
+}
+
+
+/*
+ * C kernels.
+ */
+
+struct c_moves {
+   uint32_t mask[4];
+   unsigned left[4];
+   unsigned right[4];
+};
+
+
+/* The unused moves have an empty mask, so that the loops in move_bits()
+ * have a fixed count and get unrolled.
+ */
+static inline void
+c_moves_init(struct c_moves *m, const struct util_format_convert *conv)
+{
+   unsigned i;
+
+   memset(m, 0, sizeof *m);
+
+   for (i = 0; i < conv->num_moves; i++) {
+      int shift = conv->moves[i].shift;
+
+      m->mask[i] = conv->moves[i].mask;
+      m->left[i] = shift > 0 ? shift : 0;
+      m->right[i] = shift < 0 ? -shift : 0;
+   }
+}
+
+
+static inline uint32_t
+move_bits(const struct c_moves *m, uint32_t constant, uint32_t value)
+{
+   uint32_t result = constant;
+   unsigned i;
+
+   for (i = 0; i < 4; i++)
+      result |= ((value & m->mask[i]) >> m->right[i]) << m->left[i];
+
+   return result;
+}
+
+
+static unsigned
+convert_32_32_c(const struct util_format_convert *conv,
+                uint8_t *dst, const uint8_t *src, unsigned width)
+{
+   const uint32_t constant = conv->constant;
+   struct c_moves m;
+   unsigned x;
+
+   c_moves_init(&m, conv);
+
+   for (x = 0; x < width; x++)
+      ((uint32_t *)dst)[x] = move_bits(&m, constant, ((const uint32_t *)src)[x]);
+
+   return width;
+}
+
+
+static unsigned
+convert_32_16_c(const struct util_format_convert *conv,
+                uint8_t *dst, const uint8_t *src, unsigned width)
+{
+   const uint32_t constant = conv->constant;
+   struct c_moves m;
+   unsigned x;
+
+   c_moves_init(&m, conv);
+
+   for (x = 0; x < width; x++)
+      ((uint16_t *)dst)[x] = move_bits(&m, constant, ((const uint32_t *)src)[x]);
+
+   return width;
+}
+
+
+static unsigned
+convert_16_16_c(const struct util_format_convert *conv,
+                uint8_t *dst, const uint8_t *src, unsigned width)
+{
+   const uint32_t constant = conv->constant;
+   struct c_moves m;
+   unsigned x;
+
+   c_moves_init(&m, conv);
+
+   for (x = 0; x < width; x++)
+      ((uint16_t *)dst)[x] = move_bits(&m, constant, ((const uint16_t *)src)[x]);
+
+   return width;
+}
+
+
+static unsigned
+convert_16_32_c(const struct util_format_convert *conv,
+                uint8_t *dst, const uint8_t *src, unsigned width)
+{
+   unsigned x, i;
+
+   for (x = 0; x < width; x++) {
+      uint32_t value = ((const uint16_t *)src)[x];
+      uint32_t result = conv->constant;
+
+      for (i = 0; i < conv->num_widens; i++) {
+         uint32_t max = (1u << conv->widens[i].src_bits) - 1;
+         uint32_t c = (value >> conv->widens[i].src_shift) & max;
+
+         result |= (c * 0xff / max) << conv->widens[i].dst_shift;
+      }
+
+      ((uint32_t *)dst)[x] = result;
+   }
+
+   return width;
+}
+
+
+#if defined(PIPE_ARCH_SSE)
+
+/*
+ * SSE2 kernels.  The shift counts are loop invariant, so they are kept in
+ * registers and applied with the variable count shifts.  Each move is
+ * shifted both right and left, one of them by zero, to avoid branching.
+ */
+
+struct sse2_moves {
+   __m128i mask[4];
+   __m128i left[4];
+   __m128i right[4];
+};
+
+
+static inline void
+sse2_moves_init(struct sse2_moves *m, const struct util_format_convert *conv,
+                boolean words16)
+{
+   unsigned i;
+
+   for (i = 0; i < conv->num_moves; i++) {
+      int shift = conv->moves[i].shift;
+
+      m->mask[i] = words16 ? _mm_set1_epi16(conv->moves[i].mask) :
+                             _mm_set1_epi32(conv->moves[i].mask);
+      m->left[i] = _mm_cvtsi32_si128(shift > 0 ? shift : 0);
+      m->right[i] = _mm_cvtsi32_si128(shift < 0 ? -shift : 0);
+   }
+}
+
+
+static inline __m128i
+sse2_move_bits_32(const struct sse2_moves *m, unsigned num_moves,
+                  __m128i value, __m128i result)
+{
+   unsigned i;
+
+   for (i = 0; i < num_moves; i++) {
+      __m128i bits = _mm_and_si128(value, m->mask[i]);
+      bits = _mm_srl_epi32(bits, m->right[i]);
+      result = _mm_or_si128(result, _mm_sll_epi32(bits, m->left[i]));
+   }
+
+   return result;
+}
+
+
+static unsigned
+convert_32_32_sse2(const struct util_format_convert *conv,
+                   uint8_t *dst, const uint8_t *src, unsigned width)
+{
+   const __m128i constant = _mm_set1_epi32(conv->constant);
+   const unsigned num_moves = conv->num_moves;
+   struct sse2_moves m;
+   unsigned x;
+
+   sse2_moves_init(&m, conv, FALSE);
+
+   for (x = 0; x + 4 <= width; x += 4) {
+      __m128i value = _mm_loadu_si128((const __m128i *)(src + x * 4));
+
+      _mm_storeu_si128((__m128i *)(dst + x * 4),
+                       sse2_move_bits_32(&m, num_moves, value, constant));
+   }
+
+   return x;
+}
+
+
+static unsigned
+convert_32_16_sse2(const struct util_format_convert *conv,
+                   uint8_t *dst, const uint8_t *src, unsigned width)
+{
+   const __m128i constant = _mm_set1_epi32(conv->constant);
+   const unsigned num_moves = conv->num_moves;
+   struct sse2_moves m;
+   unsigned x;
+
+   sse2_moves_init(&m, conv, FALSE);
+
+   for (x = 0; x + 8 <= width; x += 8) {
+      __m128i lo = _mm_loadu_si128((const __m128i *)(src + x * 4));
+      __m128i hi = _mm_loadu_si128((const __m128i *)(src + x * 4 + 16));
+
+      lo = sse2_move_bits_32(&m, num_moves, lo, constant);
+      hi = sse2_move_bits_32(&m, num_moves, hi, constant);
+
+      /* There is no unsigned saturating pack in SSE2, so sign extend the
+       * low 16 bits for the signed one to keep them as they are.
+       */
+      lo = _mm_srai_epi32(_mm_slli_epi32(lo, 16), 16);
+      hi = _mm_srai_epi32(_mm_slli_epi32(hi, 16), 16);
+
+      _mm_storeu_si128((__m128i *)(dst + x * 2), _mm_packs_epi32(lo, hi));
+   }
+
+   return x;
+}
+
+
+static unsigned
+convert_16_16_sse2(const struct util_format_convert *conv,
+                   uint8_t *dst, const uint8_t *src, unsigned width)
+{
+   const __m128i constant = _mm_set1_epi16(conv->constant);
+   const unsigned num_moves = conv->num_moves;
+   struct sse2_moves m;
+   unsigned x, i;
+
+   sse2_moves_init(&m, conv, TRUE);
+
+   for (x = 0; x + 8 <= width; x += 8) {
+      __m128i value = _mm_loadu_si128((const __m128i *)(src + x * 2));
+      __m128i result = constant;
+
+      for (i = 0; i < num_moves; i++) {
+         __m128i bits = _mm_and_si128(value, m.mask[i]);
+         bits = _mm_srl_epi16(bits, m.right[i]);
+         result = _mm_or_si128(result, _mm_sll_epi16(bits, m.left[i]));
+      }
+
+      _mm_storeu_si128((__m128i *)(dst + x * 2), result);
+   }
+
+   return x;
+}
+
+
+/**
+ * Widens 8 pixels at a time in 16 bit lanes: each channel is moved to the
+ * top of the lane, scaled with a multiply high, and put in the low or the
+ * high half of the destination words, which are interleaved at the end.
+ */
+static unsigned
+convert_16_32_sse2(const struct util_format_convert *conv,
+                   uint8_t *dst, const uint8_t *src, unsigned width)
+{
+   const __m128i constant_lo = _mm_set1_epi16(conv->constant & 0xffff);
+   const __m128i constant_hi = _mm_set1_epi16(conv->constant >> 16);
+   const unsigned num_widens = conv->num_widens;
+   __m128i top[4], top_mask[4], mul[4], shift[4], place[4];
+   boolean high[4];
+   unsigned x, i;
+
+   for (i = 0; i < num_widens; i++) {
+      unsigned bits = conv->widens[i].src_bits;
+      unsigned dst_shift = conv->widens[i].dst_shift;
+
+      top[i] = _mm_cvtsi32_si128(16 - bits - conv->widens[i].src_shift);
+      top_mask[i] = _mm_set1_epi16(((1u << bits) - 1) << (16 - bits));
+      mul[i] = _mm_set1_epi16(util_format_widen_mul[bits]);
+      shift[i] = _mm_cvtsi32_si128(util_format_widen_shift[bits]);
+      place[i] = _mm_cvtsi32_si128(dst_shift % 16);
+      high[i] = dst_shift >= 16;
+   }
+
+   for (x = 0; x + 8 <= width; x += 8) {
+      __m128i value = _mm_loadu_si128((const __m128i *)(src + x * 2));
+      __m128i lo = constant_lo;
+      __m128i hi = constant_hi;
+
+      for (i = 0; i < num_widens; i++) {
+         __m128i c = _mm_and_si128(_mm_sll_epi16(value, top[i]), top_mask[i]);
+         c = _mm_srl_epi16(_mm_mulhi_epu16(c, mul[i]), shift[i]);
+         c = _mm_sll_epi16(c, place[i]);
+         if (high[i])
+            hi = _mm_or_si128(hi, c);
+         else
+            lo = _mm_or_si128(lo, c);
+      }
+
+      _mm_storeu_si128((__m128i *)(dst + x * 4), _mm_unpacklo_epi16(lo, hi));
+      _mm_storeu_si128((__m128i *)(dst + x * 4 + 16),
+                       _mm_unpackhi_epi16(lo, hi));
+   }
+
+   return x;
+}
+
+#endif /* PIPE_ARCH_SSE */
+
+
+static const util_format_convert_func
+c_kernels[] = {
+   convert_32_32_c,
+   convert_32_16_c,
+   convert_16_16_c,
+   convert_16_32_c
+};
+
+
+static util_format_convert_func
+simd_kernel(enum util_format_convert_kind kind)
+{
+#if defined(USE_AVX2)
+   static const util_format_convert_func avx2_kernels[] = {
+      util_format_convert_32_32_avx2,
+      util_format_convert_32_16_avx2,
+      util_format_convert_16_16_avx2,
+      util_format_convert_16_32_avx2
+   };
+#endif
+#if defined(PIPE_ARCH_SSE)
+   static const util_format_convert_func sse2_kernels[] = {
+      convert_32_32_sse2,
+      convert_32_16_sse2,
+      convert_16_16_sse2,
+      convert_16_32_sse2
+   };
+#endif
+
+   util_cpu_detect();
+
+#if defined(USE_AVX2)
+   if (util_cpu_caps.has_avx2)
+      return avx2_kernels[kind];
+#endif
+#if defined(PIPE_ARCH_SSE)
+   if (util_cpu_caps.has_sse2)
+      return sse2_kernels[kind];
+#endif
+
+   return NULL;
+}
+
+
+/**
+ * Converts a rectangle of pixels between two formats of a supported kind,
+ * or returns FALSE if they aren't or the CPU has no SIMD kernel for them.
+ */
+boolean
+util_format_convert_rows(const struct util_format_description *dst_desc,
+                         uint8_t *dst_row, unsigned dst_stride,
+                         const struct util_format_description *src_desc,
+                         const uint8_t *src_row, unsigned src_stride,
+                         unsigned width, unsigned height)
+{
+   struct util_format_convert conv;
+   util_format_convert_func simd, c;
+   unsigned dst_bytes = dst_desc->block.bits / 8;
+   unsigned src_bytes = src_desc->block.bits / 8;
+
+   if (!util_format_convert_init(&conv, dst_desc, src_desc))
+      return FALSE;
+
+   /* The generated functions, specialized for each format, beat the C
+    * kernels, which only do the ends of the rows.
+    */
+   simd = simd_kernel(conv.kind);
+   if (!simd)
+      return FALSE;
+
+   c = c_kernels[conv.kind];
+
+   while (height--) {
+      unsigned done = simd(&conv, dst_row, src_row, width);
+
+      if (done < width) {
+         c(&conv, dst_row + done * dst_bytes, src_row + done * src_bytes,
+           width - done);
+      }
+
+      dst_row += dst_stride;
+      src_row += src_stride;
+   }
+
+   return TRUE;
+}
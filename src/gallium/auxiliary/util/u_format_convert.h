@@ -0,0 +1,159 @@
+/**************************************************************************
+ *
+ * Copyright 2016 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+
+/**
+ * @file
+ * Direct row conversions between plain unorm formats that are swizzles of
+ * each other (BGRA8 <-> RGBA8, RGBX8 -> RGBA8) or that only differ in the
+ * width of their channels (B5G6R5 <-> RGBA8), for util_format_translate().
+ *
+ * The results are the same, bit for bit, as going through
+ * unpack_rgba_8unorm and pack_rgba_8unorm.  The kernels work on whole
+ * pixel words with SSE2 or AVX2, and are only used when the CPU has one of
+ * them.
+ */
+
+#ifndef U_FORMAT_CONVERT_H
+#define U_FORMAT_CONVERT_H
+
+#include "pipe/p_compiler.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+struct util_format_description;
+
+
+enum util_format_convert_kind
+{
+   /** 32bpp to 32bpp, 8 bit channels moved around. */
+   UTIL_FORMAT_CONVERT_32_32,
+   /** 32bpp with 8 bit channels to 16bpp, narrowing the channels. */
+   UTIL_FORMAT_CONVERT_32_16,
+   /** 16bpp to 16bpp, channels of the same widths moved around. */
+   UTIL_FORMAT_CONVERT_16_16,
+   /** 16bpp to 32bpp with 8 bit channels, widening the channels. */
+   UTIL_FORMAT_CONVERT_16_32
+};
+
+
+/**
+ * How each destination pixel word is computed from the source pixel word.
+ */
+struct util_format_convert
+{
+   enum util_format_convert_kind kind;
+
+   /**
+    * For all kinds but UTIL_FORMAT_CONVERT_16_32: the destination is the OR
+    * of the source bits in mask, shifted left by shift (right when
+    * negative), for each move.  Channels that go to the same place are
+    * merged into one move.
+    */
+   unsigned num_moves;
+   struct {
+      uint32_t mask;
+      int shift;
+   } moves[4];
+
+   /**
+    * For UTIL_FORMAT_CONVERT_16_32: each destination byte at dst_shift is
+    * the source channel of src_bits bits at src_shift, scaled to 8 bits.
+    */
+   unsigned num_widens;
+   struct {
+      unsigned src_shift;
+      unsigned src_bits;
+      unsigned dst_shift;
+   } widens[4];
+
+   /** ORed into every destination word, for constant channels. */
+   uint32_t constant;
+};
+
+
+boolean
+util_format_convert_init(struct util_format_convert *conv,
+                         const struct util_format_description *dst_desc,
+                         const struct util_format_description *src_desc);
+
+boolean
+util_format_convert_rows(const struct util_format_description *dst_desc,
+                         uint8_t *dst_row, unsigned dst_stride,
+                         const struct util_format_description *src_desc,
+                         const uint8_t *src_row, unsigned src_stride,
+                         unsigned width, unsigned height);
+
+
+/*
+ * The kernels convert up to width pixels of a row, and return how many they
+ * did.  The SIMD ones leave the last few pixels to the C ones.
+ */
+
+typedef unsigned
+(*util_format_convert_func)(const struct util_format_convert *conv,
+                            uint8_t *dst, const uint8_t *src,
+                            unsigned width);
+
+unsigned
+util_format_convert_32_32_avx2(const struct util_format_convert *conv,
+                               uint8_t *dst, const uint8_t *src,
+                               unsigned width);
+
+unsigned
+util_format_convert_32_16_avx2(const struct util_format_convert *conv,
+                               uint8_t *dst, const uint8_t *src,
+                               unsigned width);
+
+unsigned
+util_format_convert_16_16_avx2(const struct util_format_convert *conv,
+                               uint8_t *dst, const uint8_t *src,
+                               unsigned width);
+
+unsigned
+util_format_convert_16_32_avx2(const struct util_format_convert *conv,
+                               uint8_t *dst, const uint8_t *src,
+                               unsigned width);
+
+/**
+ * The multiplier and shift that scale a channel of \p bits bits, in the top
+ * bits of a 16 bit lane, to 8 bits with _mm_mulhi_epu16.
+ */
+extern const uint16_t util_format_widen_mul[9];
+extern const uint8_t util_format_widen_shift[9];
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* U_FORMAT_CONVERT_H */
@@ -0,0 +1,222 @@
+/**************************************************************************
+ *
+ * Copyright 2016 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+
+/**
+ * @file
+ * AVX2 versions of the u_format_convert.c kernels, built with -mavx2 and
+ * only called when the CPU has it.
+ */
+
+
+#include <immintrin.h>
+
+#include "util/u_format_convert.h"
+
+
+struct avx2_moves {
+   __m256i mask[4];
+   __m128i left[4];
+   __m128i right[4];
+};
+
+
+static inline void
+avx2_moves_init(struct avx2_moves *m, const struct util_format_convert *conv,
+                boolean words16)
+{
+   unsigned i;
+
+   for (i = 0; i < conv->num_moves; i++) {
+      int shift = conv->moves[i].shift;
+
+      m->mask[i] = words16 ? _mm256_set1_epi16(conv->moves[i].mask) :
+                             _mm256_set1_epi32(conv->moves[i].mask);
+      m->left[i] = _mm_cvtsi32_si128(shift > 0 ? shift : 0);
+      m->right[i] = _mm_cvtsi32_si128(shift < 0 ? -shift : 0);
+   }
+}
+
+
+static inline __m256i
+avx2_move_bits_32(const struct avx2_moves *m, unsigned num_moves,
+                  __m256i value, __m256i result)
+{
+   unsigned i;
+
+   for (i = 0; i < num_moves; i++) {
+      __m256i bits = _mm256_and_si256(value, m->mask[i]);
+      bits = _mm256_srl_epi32(bits, m->right[i]);
+      result = _mm256_or_si256(result, _mm256_sll_epi32(bits, m->left[i]));
+   }
+
+   return result;
+}
+
+
+unsigned
+util_format_convert_32_32_avx2(const struct util_format_convert *conv,
+                               uint8_t *dst, const uint8_t *src,
+                               unsigned width)
+{
+   const __m256i constant = _mm256_set1_epi32(conv->constant);
+   const unsigned num_moves = conv->num_moves;
+   struct avx2_moves m;
+   unsigned x;
+
+   avx2_moves_init(&m, conv, FALSE);
+
+   for (x = 0; x + 8 <= width; x += 8) {
+      __m256i value = _mm256_loadu_si256((const __m256i *)(src + x * 4));
+
+      _mm256_storeu_si256((__m256i *)(dst + x * 4),
+                          avx2_move_bits_32(&m, num_moves, value, constant));
+   }
+
+   return x;
+}
+
+
+unsigned
+util_format_convert_32_16_avx2(const struct util_format_convert *conv,
+                               uint8_t *dst, const uint8_t *src,
+                               unsigned width)
+{
+   const __m256i constant = _mm256_set1_epi32(conv->constant);
+   const unsigned num_moves = conv->num_moves;
+   struct avx2_moves m;
+   unsigned x;
+
+   avx2_moves_init(&m, conv, FALSE);
+
+   for (x = 0; x + 16 <= width; x += 16) {
+      __m256i lo = _mm256_loadu_si256((const __m256i *)(src + x * 4));
+      __m256i hi = _mm256_loadu_si256((const __m256i *)(src + x * 4 + 32));
+      __m256i packed;
+
+      lo = avx2_move_bits_32(&m, num_moves, lo, constant);
+      hi = avx2_move_bits_32(&m, num_moves, hi, constant);
+
+      /* The words are below 0x10000, so the unsigned pack keeps them.  It
+       * works within 128 bit lanes, which the permute puts back in order.
+       */
+      packed = _mm256_packus_epi32(lo, hi);
+      packed = _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0));
+
+      _mm256_storeu_si256((__m256i *)(dst + x * 2), packed);
+   }
+
+   return x;
+}
+
+
+unsigned
+util_format_convert_16_16_avx2(const struct util_format_convert *conv,
+                               uint8_t *dst, const uint8_t *src,
+                               unsigned width)
+{
+   const __m256i constant = _mm256_set1_epi16(conv->constant);
+   const unsigned num_moves = conv->num_moves;
+   struct avx2_moves m;
+   unsigned x, i;
+
+   avx2_moves_init(&m, conv, TRUE);
+
+   for (x = 0; x + 16 <= width; x += 16) {
+      __m256i value = _mm256_loadu_si256((const __m256i *)(src + x * 2));
+      __m256i result = constant;
+
+      for (i = 0; i < num_moves; i++) {
+         __m256i bits = _mm256_and_si256(value, m.mask[i]);
+         bits = _mm256_srl_epi16(bits, m.right[i]);
+         result = _mm256_or_si256(result, _mm256_sll_epi16(bits, m.left[i]));
+      }
+
+      _mm256_storeu_si256((__m256i *)(dst + x * 2), result);
+   }
+
+   return x;
+}
+
+
+unsigned
+util_format_convert_16_32_avx2(const struct util_format_convert *conv,
+                               uint8_t *dst, const uint8_t *src,
+                               unsigned width)
+{
+   const __m256i constant_lo = _mm256_set1_epi16(conv->constant & 0xffff);
+   const __m256i constant_hi = _mm256_set1_epi16(conv->constant >> 16);
+   const unsigned num_widens = conv->num_widens;
+   __m256i top_mask[4], mul[4];
+   __m128i top[4], shift[4], place[4];
+   boolean high[4];
+   unsigned x, i;
+
+   for (i = 0; i < num_widens; i++) {
+      unsigned bits = conv->widens[i].src_bits;
+      unsigned dst_shift = conv->widens[i].dst_shift;
+
+      top[i] = _mm_cvtsi32_si128(16 - bits - conv->widens[i].src_shift);
+      top_mask[i] = _mm256_set1_epi16(((1u << bits) - 1) << (16 - bits));
+      mul[i] = _mm256_set1_epi16(util_format_widen_mul[bits]);
+      shift[i] = _mm_cvtsi32_si128(util_format_widen_shift[bits]);
+      place[i] = _mm_cvtsi32_si128(dst_shift % 16);
+      high[i] = dst_shift >= 16;
+   }
+
+   for (x = 0; x + 16 <= width; x += 16) {
+      __m256i value = _mm256_loadu_si256((const __m256i *)(src + x * 2));
+      __m256i lo = constant_lo;
+      __m256i hi = constant_hi;
+      __m256i first, second;
+
+      for (i = 0; i < num_widens; i++) {
+         __m256i c = _mm256_and_si256(_mm256_sll_epi16(value, top[i]),
+                                      top_mask[i]);
+         c = _mm256_srl_epi16(_mm256_mulhi_epu16(c, mul[i]), shift[i]);
+         c = _mm256_sll_epi16(c, place[i]);
+         if (high[i])
+            hi = _mm256_or_si256(hi, c);
+         else
+            lo = _mm256_or_si256(lo, c);
+      }
+
+      /* The unpacks work within 128 bit lanes, giving pixels 0-3 and 8-11,
+       * then 4-7 and 12-15.
+       */
+      first = _mm256_unpacklo_epi16(lo, hi);
+      second = _mm256_unpackhi_epi16(lo, hi);
+
+      _mm256_storeu_si256((__m256i *)(dst + x * 4),
+                          _mm256_permute2x128_si256(first, second, 0x20));
+      _mm256_storeu_si256((__m256i *)(dst + x * 4 + 32),
+                          _mm256_permute2x128_si256(first, second, 0x31));
+   }
+
+   return x;
+}
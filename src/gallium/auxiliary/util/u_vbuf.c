@@ -89,6 +89,7 @@
 
 #include "util/u_dump.h"
 #include "util/u_format.h"
+#include "util/u_index_range.h"
 #include "util/u_inlines.h"
 #include "util/u_memory.h"
 #include "util/u_upload_mgr.h"
@@ -1038,7 +1039,7 @@ static void u_vbuf_get_minmax_index(struct pipe_context *pipe,
 {
    struct pipe_transfer *transfer = NULL;
    const void *indices;
-   unsigned i;
+   unsigned min_index, max_index;
 
    if (ib->user_buffer) {
       indices = (uint8_t*)ib->user_buffer +
@@ -1050,78 +1051,10 @@ static void u_vbuf_get_minmax_index(struct pipe_context *pipe,
                                       PIPE_TRANSFER_READ, &transfer);
    }
 
-   switch (ib->index_size) {
-   case 4: {
-      const unsigned *ui_indices = (const unsigned*)indices;
-      unsigned max_ui = 0;
-      unsigned min_ui = ~0U;
-      if (primitive_restart) {
-         for (i = 0; i < count; i++) {
-            if (ui_indices[i] != restart_index) {
-               if (ui_indices[i] > max_ui) max_ui = ui_indices[i];
-               if (ui_indices[i] < min_ui) min_ui = ui_indices[i];
-            }
-         }
-      }
-      else {
-         for (i = 0; i < count; i++) {
-            if (ui_indices[i] > max_ui) max_ui = ui_indices[i];
-            if (ui_indices[i] < min_ui) min_ui = ui_indices[i];
-         }
-      }
-      *out_min_index = min_ui;
-      *out_max_index = max_ui;
-      break;
-   }
-   case 2: {
-      const unsigned short *us_indices = (const unsigned short*)indices;
-      unsigned max_us = 0;
-      unsigned min_us = ~0U;
-      if (primitive_restart) {
-         for (i = 0; i < count; i++) {
-            if (us_indices[i] != restart_index) {
-               if (us_indices[i] > max_us) max_us = us_indices[i];
-               if (us_indices[i] < min_us) min_us = us_indices[i];
-            }
-         }
-      }
-      else {
-         for (i = 0; i < count; i++) {
-            if (us_indices[i] > max_us) max_us = us_indices[i];
-            if (us_indices[i] < min_us) min_us = us_indices[i];
-         }
-      }
-      *out_min_index = min_us;
-      *out_max_index = max_us;
-      break;
-   }
-   case 1: {
-      const unsigned char *ub_indices = (const unsigned char*)indices;
-      unsigned max_ub = 0;
-      unsigned min_ub = ~0U;
-      if (primitive_restart) {
-         for (i = 0; i < count; i++) {
-            if (ub_indices[i] != restart_index) {
-               if (ub_indices[i] > max_ub) max_ub = ub_indices[i];
-               if (ub_indices[i] < min_ub) min_ub = ub_indices[i];
-            }
-         }
-      }
-      else {
-         for (i = 0; i < count; i++) {
-            if (ub_indices[i] > max_ub) max_ub = ub_indices[i];
-            if (ub_indices[i] < min_ub) min_ub = ub_indices[i];
-         }
-      }
-      *out_min_index = min_ub;
-      *out_max_index = max_ub;
-      break;
-   }
-   default:
-      assert(0);
-      *out_min_index = 0;
-      *out_max_index = 0;
-   }
+   util_index_range_scan(indices, ib->index_size, count, primitive_restart,
+                         restart_index, &min_index, &max_index);
+   *out_min_index = min_index;
+   *out_max_index = max_index;
 
    if (transfer) {
       pipe_buffer_unmap(pipe, transfer);
@@ -0,0 +1,143 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * The offline compiler (see compiler/glsl/offline_compiler.h) with the ir3
+ * backend, for the GPU given as "-b ir3:<gpu id>".  Shaders are compiled
+ * the way ir3_compiler does it, with the default shader key.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "main/mtypes.h"
+#include "compiler/glsl/offline_compiler.h"
+#include "util/ralloc.h"
+
+#include "ir3_compiler.h"
+#include "ir3_nir.h"
+#include "ir3.h"
+
+int st_glsl_type_size(const struct glsl_type *type);
+
+static void *
+ir3_offline_create(const char *arg)
+{
+	uint32_t gpu_id = arg ? strtol(arg, NULL, 0) : 320;
+
+	return ir3_compiler_create(NULL, gpu_id);
+}
+
+static void
+ir3_offline_destroy(void *compiler)
+{
+	ir3_compiler_destroy(compiler);
+}
+
+static void
+ir3_offline_get_options(void *compiler,
+		struct gl_shader_compiler_options *options)
+{
+	for (unsigned i = 0; i < MESA_SHADER_STAGES; i++)
+		options[i].NirOptions = ir3_get_compiler_options();
+}
+
+static bool
+ir3_offline_compile(void *data, void *mem_ctx,
+		struct gl_shader_program *prog, nir_shader *nir,
+		struct offline_stats *stats, char **error)
+{
+	struct ir3_compiler *compiler = data;
+	struct ir3_shader s = {0};
+	struct ir3_shader_variant v = {0};
+	void *bin;
+
+	/* required NIR passes, as in ir3_cmdline.c: */
+	NIR_PASS_V(nir, nir_lower_io_to_temporaries,
+			nir_shader_get_entrypoint(nir),
+			true, true);
+	NIR_PASS_V(nir, nir_lower_global_vars_to_local);
+	NIR_PASS_V(nir, nir_split_var_copies);
+	NIR_PASS_V(nir, nir_lower_var_copies);
+	NIR_PASS_V(nir, nir_lower_io_types);
+	NIR_PASS_V(nir, nir_lower_system_values);
+	NIR_PASS_V(nir, nir_lower_io, nir_var_all, st_glsl_type_size);
+	NIR_PASS_V(nir, nir_lower_samplers, prog);
+
+	switch (nir->stage) {
+	case MESA_SHADER_FRAGMENT:
+		s.type = v.type = SHADER_FRAGMENT;
+		break;
+	case MESA_SHADER_VERTEX:
+		s.type = v.type = SHADER_VERTEX;
+		break;
+	case MESA_SHADER_COMPUTE:
+		s.type = v.type = SHADER_COMPUTE;
+		break;
+	default:
+		unreachable("stage not in ir3_offline_backend.stages");
+	}
+
+	s.compiler = compiler;
+	s.nir = ir3_optimize_nir(&s, nir, NULL);
+	v.shader = &s;
+
+	if (ir3_compile_shader_nir(compiler, &v)) {
+		*error = ralloc_strdup(mem_ctx, "compiler failed");
+		return false;
+	}
+
+	/* The instruction counts are only known once assembled: */
+	bin = ir3_shader_assemble(&v, compiler->gpu_id);
+	ir3_destroy(v.ir);
+	if (!bin) {
+		*error = ralloc_strdup(mem_ctx, "assembler failed");
+		return false;
+	}
+	free(bin);
+
+	stats->instructions = v.info.instrs_count;
+	return true;
+}
+
+static const struct offline_backend ir3_offline_backend = {
+	.name = "ir3",
+	.stages = (1 << MESA_SHADER_VERTEX) |
+	          (1 << MESA_SHADER_FRAGMENT) |
+	          (1 << MESA_SHADER_COMPUTE),
+	.create = ir3_offline_create,
+	.destroy = ir3_offline_destroy,
+	.get_options = ir3_offline_get_options,
+	.compile = ir3_offline_compile,
+};
+
+static const struct offline_backend *const backends[] = {
+	&ir3_offline_backend,
+	&offline_nir_backend,
+};
+
+int
+main(int argc, char **argv)
+{
+	return offline_compiler_main(argc, argv, backends, ARRAY_SIZE(backends));
+}
@@ -0,0 +1,391 @@
+/**************************************************************************
+ *
+ * Copyright 2016 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/**
+ * Screen-wide fragment shader variant cache.
+ *
+ * The cache is a hash table keyed by the shader tokens and the variant key,
+ * plus a list of all entries in least recently used order.  All accesses
+ * are serialized with a single mutex, which is only taken when a context
+ * misses in its own variant list, so it is never contended on the draw
+ * path.
+ */
+
+#include "util/u_memory.h"
+#include "util/u_hash.h"
+#include "util/u_hash_table.h"
+#include "util/list.h"
+#include "os/os_thread.h"
+#include "tgsi/tgsi_parse.h"
+#include "gallivm/lp_bld_init.h"
+
+#include "lp_debug.h"
+#include "lp_jit.h"
+#include "lp_state_fs.h"
+#include "lp_fs_cache.h"
+
+
+struct lp_fs_cache_key
+{
+   unsigned hash;
+   const struct tgsi_token *tokens;
+   unsigned num_tokens;
+   const struct lp_fragment_shader_variant_key *key;
+   unsigned key_size;
+};
+
+
+struct lp_fs_cache_item
+{
+   struct lp_fs_cache_entry base;
+
+   struct lp_fs_cache_key k;
+
+   /** Position in the LRU list, most recently used first */
+   struct list_head list;
+
+   /** One for the cache itself while cached, plus one per variant */
+   unsigned refcount;
+   boolean cached;
+
+   struct tgsi_token *tokens;
+   struct lp_fragment_shader_variant_key key;
+};
+
+
+struct lp_fs_cache
+{
+   pipe_mutex mutex;
+
+   struct util_hash_table *ht;
+   struct list_head lru;
+
+   unsigned max_entries;
+
+   struct lp_fs_cache_stats stats;
+};
+
+
+static unsigned
+key_hash(void *key)
+{
+   const struct lp_fs_cache_key *k = key;
+   return k->hash;
+}
+
+
+static int
+key_compare(void *key1, void *key2)
+{
+   const struct lp_fs_cache_key *k1 = key1;
+   const struct lp_fs_cache_key *k2 = key2;
+
+   if (k1->hash != k2->hash ||
+       k1->num_tokens != k2->num_tokens ||
+       k1->key_size != k2->key_size)
+      return 1;
+
+   if (memcmp(k1->key, k2->key, k1->key_size) != 0)
+      return 1;
+
+   return memcmp(k1->tokens, k2->tokens,
+                 k1->num_tokens * sizeof(struct tgsi_token));
+}
+
+
+static void
+init_key(struct lp_fs_cache_key *k,
+         const struct tgsi_token *tokens,
+         unsigned tokens_hash,
+         const struct lp_fragment_shader_variant_key *key,
+         unsigned key_size)
+{
+   k->tokens = tokens;
+   k->num_tokens = tgsi_num_tokens(tokens);
+   k->key = key;
+   k->key_size = key_size;
+   k->hash = tokens_hash ^ util_hash_crc32(key, key_size);
+}
+
+
+struct lp_fs_cache *
+lp_fs_cache_create(unsigned max_entries)
+{
+   struct lp_fs_cache *cache;
+
+   cache = CALLOC_STRUCT(lp_fs_cache);
+   if (!cache)
+      return NULL;
+
+   cache->ht = util_hash_table_create(key_hash, key_compare);
+   if (!cache->ht) {
+      FREE(cache);
+      return NULL;
+   }
+
+   LIST_INITHEAD(&cache->lru);
+   cache->max_entries = max_entries;
+   pipe_mutex_init(cache->mutex);
+
+   return cache;
+}
+
+
+static void
+item_unreference_locked(struct lp_fs_cache_item *item)
+{
+   assert(item->refcount > 0);
+   if (--item->refcount == 0) {
+      assert(!item->cached);
+      gallivm_destroy(item->base.gallivm);
+      FREE(item->tokens);
+      FREE(item);
+   }
+}
+
+
+/**
+ * Drop the cache's reference to the least recently used entry.
+ */
+static void
+evict_locked(struct lp_fs_cache *cache, struct lp_fs_cache_item *item)
+{
+   assert(item->cached);
+
+   util_hash_table_remove(cache->ht, &item->k);
+   LIST_DEL(&item->list);
+   item->cached = FALSE;
+   cache->stats.entries--;
+   item_unreference_locked(item);
+}
+
+
+void
+lp_fs_cache_destroy(struct lp_fs_cache *cache)
+{
+   struct lp_fs_cache_item *item, *next;
+
+   if (!cache)
+      return;
+
+   /*
+    * All contexts must have been destroyed by now, so the cache should hold
+    * the only remaining references.
+    */
+   LIST_FOR_EACH_ENTRY_SAFE(item, next, &cache->lru, list) {
+      assert(item->refcount == 1);
+      evict_locked(cache, item);
+   }
+
+   util_hash_table_destroy(cache->ht);
+   pipe_mutex_destroy(cache->mutex);
+   FREE(cache);
+}
+
+
+/**
+ * Hash the shader tokens.  This is done once per shader, not per lookup.
+ */
+unsigned
+lp_fs_cache_hash_tokens(const struct tgsi_token *tokens)
+{
+   return util_hash_crc32(tokens,
+                          tgsi_num_tokens(tokens) * sizeof(struct tgsi_token));
+}
+
+
+/**
+ * Look for compiled code matching the shader and variant key.
+ * \return  a new reference to the cached code, or NULL.
+ */
+struct lp_fs_cache_entry *
+lp_fs_cache_lookup(struct lp_fs_cache *cache,
+                   const struct tgsi_token *tokens,
+                   unsigned tokens_hash,
+                   const struct lp_fragment_shader_variant_key *key,
+                   unsigned key_size)
+{
+   struct lp_fs_cache_key k;
+   struct lp_fs_cache_item *item;
+
+   if (!cache)
+      return NULL;
+
+   init_key(&k, tokens, tokens_hash, key, key_size);
+
+   pipe_mutex_lock(cache->mutex);
+
+   item = util_hash_table_get(cache->ht, &k);
+   if (item) {
+      /* Move to the head of the list to implement LRU eviction */
+      LIST_DEL(&item->list);
+      LIST_ADD(&item->list, &cache->lru);
+      item->refcount++;
+      cache->stats.hits++;
+   }
+   else {
+      cache->stats.misses++;
+   }
+
+   pipe_mutex_unlock(cache->mutex);
+
+   return item ? &item->base : NULL;
+}
+
+
+/**
+ * Add newly compiled code to the cache.  The cache takes ownership of the
+ * gallivm state, whose IR must have already been freed.
+ *
+ * If another context inserted the same variant in the meantime, the passed
+ * code is destroyed and the already cached entry is returned instead.
+ *
+ * \return  a new reference to the cached code, or NULL on out of memory
+ *          (in which case the gallivm state is still owned by the caller).
+ */
+struct lp_fs_cache_entry *
+lp_fs_cache_insert(struct lp_fs_cache *cache,
+                   const struct tgsi_token *tokens,
+                   unsigned tokens_hash,
+                   const struct lp_fragment_shader_variant_key *key,
+                   unsigned key_size,
+                   struct gallivm_state *gallivm,
+                   lp_jit_frag_func jit_function[2],
+                   unsigned nr_instrs)
+{
+   struct lp_fs_cache_item *item, *existing;
+
+   if (!cache || !cache->max_entries)
+      return NULL;
+
+   assert(!gallivm->module);
+
+   item = CALLOC_STRUCT(lp_fs_cache_item);
+   if (!item)
+      return NULL;
+
+   item->tokens = (struct tgsi_token *) tgsi_dup_tokens(tokens);
+   if (!item->tokens) {
+      FREE(item);
+      return NULL;
+   }
+
+   memcpy(&item->key, key, key_size);
+   init_key(&item->k, item->tokens, tokens_hash, &item->key, key_size);
+
+   item->base.gallivm = gallivm;
+   item->base.jit_function[RAST_WHOLE] = jit_function[RAST_WHOLE];
+   item->base.jit_function[RAST_EDGE_TEST] = jit_function[RAST_EDGE_TEST];
+   item->base.nr_instrs = nr_instrs;
+
+   pipe_mutex_lock(cache->mutex);
+
+   existing = util_hash_table_get(cache->ht, &item->k);
+   if (existing) {
+      /* Lost the race against another context compiling the same thing */
+      LIST_DEL(&existing->list);
+      LIST_ADD(&existing->list, &cache->lru);
+      existing->refcount++;
+      cache->stats.collisions++;
+      pipe_mutex_unlock(cache->mutex);
+
+      gallivm_destroy(gallivm);
+      FREE(item->tokens);
+      FREE(item);
+      return &existing->base;
+   }
+
+   while (cache->stats.entries >= cache->max_entries &&
+          !LIST_IS_EMPTY(&cache->lru)) {
+      struct lp_fs_cache_item *lru =
+         LIST_ENTRY(struct lp_fs_cache_item, cache->lru.prev, list);
+      evict_locked(cache, lru);
+      cache->stats.evictions++;
+   }
+
+   if (util_hash_table_set(cache->ht, &item->k, item) != PIPE_OK) {
+      pipe_mutex_unlock(cache->mutex);
+      FREE(item->tokens);
+      FREE(item);
+      return NULL;
+   }
+
+   LIST_ADD(&item->list, &cache->lru);
+   item->cached = TRUE;
+   item->refcount = 2;
+   cache->stats.entries++;
+   cache->stats.inserts++;
+
+   pipe_mutex_unlock(cache->mutex);
+
+   return &item->base;
+}
+
+
+/**
+ * Drop a reference obtained from lp_fs_cache_lookup/insert.
+ */
+void
+lp_fs_cache_release(struct lp_fs_cache *cache,
+                    struct lp_fs_cache_entry *entry)
+{
+   struct lp_fs_cache_item *item = (struct lp_fs_cache_item *) entry;
+
+   pipe_mutex_lock(cache->mutex);
+   item_unreference_locked(item);
+   pipe_mutex_unlock(cache->mutex);
+}
+
+
+void
+lp_fs_cache_get_stats(struct lp_fs_cache *cache,
+                      struct lp_fs_cache_stats *stats)
+{
+   pipe_mutex_lock(cache->mutex);
+   *stats = cache->stats;
+   pipe_mutex_unlock(cache->mutex);
+}
+
+
+void
+lp_fs_cache_print_stats(struct lp_fs_cache *cache)
+{
+   struct lp_fs_cache_stats stats;
+   unsigned lookups;
+
+   lp_fs_cache_get_stats(cache, &stats);
+   lookups = stats.hits + stats.misses;
+
+   debug_printf("llvmpipe: fs variant cache: %u entries (max %u), "
+                "%u hits, %u misses (%.1f%% hit rate), "
+                "%u inserts, %u evictions, %u collisions\n",
+                stats.entries, cache->max_entries,
+                stats.hits, stats.misses,
+                lookups ? 100.0 * stats.hits / lookups : 0.0,
+                stats.inserts, stats.evictions, stats.collisions);
+}
@@ -0,0 +1,115 @@
+/**************************************************************************
+ *
+ * Copyright 2016 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/**
+ * Screen-wide cache of compiled fragment shader variants.
+ *
+ * The code generated for a fragment shader variant only depends on the
+ * shader tokens and on the variant key, not on the context that created it,
+ * so it can be shared by all the contexts of a screen.  Entries are
+ * reference counted: the cache holds one reference, and every context
+ * variant using the code holds another.  Evicted entries are destroyed once
+ * the last variant using them goes away.
+ */
+
+#ifndef LP_FS_CACHE_H
+#define LP_FS_CACHE_H
+
+#include "pipe/p_compiler.h"
+#include "lp_jit.h"
+
+
+struct tgsi_token;
+struct gallivm_state;
+struct lp_fragment_shader_variant_key;
+struct lp_fs_cache;
+
+
+/**
+ * Compiled code shared between variants of different contexts.
+ */
+struct lp_fs_cache_entry
+{
+   struct gallivm_state *gallivm;
+   lp_jit_frag_func jit_function[2];
+
+   /* Total number of LLVM instructions generated */
+   unsigned nr_instrs;
+};
+
+
+struct lp_fs_cache_stats
+{
+   unsigned entries;
+   unsigned hits;
+   unsigned misses;
+   unsigned inserts;
+   unsigned evictions;
+   unsigned collisions;  /**< concurrent compiles of the same variant */
+};
+
+
+struct lp_fs_cache *
+lp_fs_cache_create(unsigned max_entries);
+
+void
+lp_fs_cache_destroy(struct lp_fs_cache *cache);
+
+unsigned
+lp_fs_cache_hash_tokens(const struct tgsi_token *tokens);
+
+struct lp_fs_cache_entry *
+lp_fs_cache_lookup(struct lp_fs_cache *cache,
+                   const struct tgsi_token *tokens,
+                   unsigned tokens_hash,
+                   const struct lp_fragment_shader_variant_key *key,
+                   unsigned key_size);
+
+struct lp_fs_cache_entry *
+lp_fs_cache_insert(struct lp_fs_cache *cache,
+                   const struct tgsi_token *tokens,
+                   unsigned tokens_hash,
+                   const struct lp_fragment_shader_variant_key *key,
+                   unsigned key_size,
+                   struct gallivm_state *gallivm,
+                   lp_jit_frag_func jit_function[2],
+                   unsigned nr_instrs);
+
+void
+lp_fs_cache_release(struct lp_fs_cache *cache,
+                    struct lp_fs_cache_entry *entry);
+
+void
+lp_fs_cache_get_stats(struct lp_fs_cache *cache,
+                      struct lp_fs_cache_stats *stats);
+
+void
+lp_fs_cache_print_stats(struct lp_fs_cache *cache);
+
+
+#endif /* LP_FS_CACHE_H */
@@ -61,7 +61,7 @@
 #define LP_MAX_WIDTH  (1 << (LP_MAX_TEXTURE_LEVELS - 1))
 
 
-#define LP_MAX_THREADS 16
+#define LP_MAX_THREADS 128
 
 
 /**
@@ -75,6 +75,13 @@
  */
 #define LP_MAX_SHADER_VARIANTS 1024
 
+/**
+ * Default max number of compiled fragment shader variants kept in the
+ * screen-wide cache shared by all contexts.  Can be overridden with the
+ * LP_FS_CACHE_SIZE environment variable (0 disables the cache).
+ */
+#define LP_MAX_CACHED_SHADER_VARIANTS 1024
+
 /**
  * Max number of instructions (for all fragment shaders combined per context)
  * that will be kept around (counted in terms of llvm ir).
@@ -0,0 +1,221 @@
+/**************************************************************************
+ *
+ * Copyright 2016 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/**
+ * CPU topology and NUMA helpers.
+ *
+ * Nothing here depends on libnuma: the topology is read from sysfs and the
+ * memory policy is set with the raw system call.
+ */
+
+#include <stdio.h>
+
+#include "pipe/p_config.h"
+#include "util/u_debug.h"
+#include "util/u_memory.h"
+#include "util/u_math.h"
+#include "util/u_string.h"
+#include "lp_numa.h"
+
+#if defined(PIPE_OS_LINUX) && defined(HAVE_PTHREAD)
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#define LP_HAVE_NUMA 1
+#else
+#define LP_HAVE_NUMA 0
+#endif
+
+#if LP_HAVE_NUMA
+
+/* From linux/mempolicy.h, which isn't always installed */
+#define LP_MPOL_INTERLEAVE 3
+
+
+/**
+ * Add the CPUs of a sysfs cpulist ("0-3,8,10-11") to the topology.
+ */
+static void
+add_cpulist(struct lp_cpu_topology *topo, FILE *f, unsigned node)
+{
+   unsigned first, last;
+   int c;
+
+   while (fscanf(f, "%u", &first) == 1) {
+      last = first;
+      c = fgetc(f);
+      if (c == '-') {
+         if (fscanf(f, "%u", &last) != 1)
+            return;
+         c = fgetc(f);
+      }
+
+      for (; first <= last && topo->num_cpus < LP_MAX_CPUS; first++) {
+         topo->cpu[topo->num_cpus] = first;
+         topo->node[topo->num_cpus] = node;
+         topo->num_cpus++;
+      }
+
+      if (c != ',')
+         return;
+   }
+}
+
+#endif /* LP_HAVE_NUMA */
+
+
+/**
+ * Find the online CPUs and the NUMA node each belongs to.
+ * Returns FALSE if the topology is unknown.
+ */
+boolean
+lp_get_cpu_topology(struct lp_cpu_topology *topo)
+{
+   topo->num_cpus = 0;
+   topo->num_nodes = 0;
+
+#if LP_HAVE_NUMA
+   {
+      unsigned node;
+
+      for (node = 0; node < LP_MAX_NUMA_NODES; node++) {
+         char path[64];
+         FILE *f;
+
+         util_snprintf(path, sizeof path,
+                       "/sys/devices/system/node/node%u/cpulist", node);
+         f = fopen(path, "r");
+         if (!f)
+            continue;
+
+         add_cpulist(topo, f, node);
+         topo->num_nodes++;
+         fclose(f);
+      }
+
+      if (topo->num_cpus) {
+         return TRUE;
+      }
+
+      /* No NUMA support in the kernel, assume a single node */
+      {
+         long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+         unsigned cpu;
+
+         for (cpu = 0; cpu < num_cpus && cpu < LP_MAX_CPUS; cpu++) {
+            topo->cpu[cpu] = cpu;
+            topo->node[cpu] = 0;
+         }
+         topo->num_cpus = cpu;
+         topo->num_nodes = 1;
+         return topo->num_cpus > 0;
+      }
+   }
+#else
+   return FALSE;
+#endif
+}
+
+
+/**
+ * Restrict the calling thread to the given CPU.
+ */
+boolean
+lp_bind_thread_to_cpu(unsigned cpu)
+{
+#if LP_HAVE_NUMA
+   cpu_set_t cpuset;
+
+   if (cpu >= CPU_SETSIZE)
+      return FALSE;
+
+   CPU_ZERO(&cpuset);
+   CPU_SET(cpu, &cpuset);
+
+   return pthread_setaffinity_np(pthread_self(), sizeof cpuset, &cpuset) == 0;
+#else
+   (void)cpu;
+   return FALSE;
+#endif
+}
+
+
+/**
+ * Allocate memory interleaved page by page between the NUMA nodes in
+ * node_mask, for data that is read by threads running on all of them.
+ * Falls back to a plain allocation when node_mask covers a single node.
+ */
+void *
+lp_numa_alloc(size_t size, uint64_t node_mask)
+{
+#if LP_HAVE_NUMA
+   if (util_bitcount64(node_mask) > 1) {
+      const unsigned long_bits = sizeof(unsigned long) * 8;
+      unsigned long mask[LP_MAX_NUMA_NODES / (sizeof(unsigned long) * 8)];
+      unsigned i;
+      void *ptr;
+
+      ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (ptr == MAP_FAILED)
+         return NULL;
+
+      for (i = 0; i < ARRAY_SIZE(mask); i++)
+         mask[i] = (unsigned long)(node_mask >> (i * long_bits));
+
+      /* The policy applies when the pages are first touched.  If it fails
+       * the memory is still usable, just not interleaved.
+       */
+      syscall(SYS_mbind, ptr, size, LP_MPOL_INTERLEAVE,
+              mask, LP_MAX_NUMA_NODES + 1, 0);
+
+      return ptr;
+   }
+#endif
+
+   return MALLOC(size);
+}
+
+
+void
+lp_numa_free(void *ptr, size_t size, uint64_t node_mask)
+{
+   if (!ptr)
+      return;
+
+#if LP_HAVE_NUMA
+   if (util_bitcount64(node_mask) > 1) {
+      munmap(ptr, size);
+      return;
+   }
+#endif
+
+   FREE(ptr);
+}
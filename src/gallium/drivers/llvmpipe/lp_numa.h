@@ -0,0 +1,70 @@
+/**************************************************************************
+ *
+ * Copyright 2016 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/**
+ * CPU topology and NUMA helpers for placing the rasterizer threads.
+ *
+ * These are only implemented on Linux; elsewhere the topology is unknown,
+ * threads aren't pinned and memory is allocated normally.
+ */
+
+#ifndef LP_NUMA_H
+#define LP_NUMA_H
+
+#include "pipe/p_compiler.h"
+
+
+#define LP_MAX_CPUS 1024
+#define LP_MAX_NUMA_NODES 64
+
+
+struct lp_cpu_topology
+{
+   unsigned num_cpus;
+   unsigned num_nodes;
+
+   /** The online CPUs, sorted by NUMA node, and the node of each */
+   uint16_t cpu[LP_MAX_CPUS];
+   uint8_t node[LP_MAX_CPUS];
+};
+
+
+boolean
+lp_get_cpu_topology(struct lp_cpu_topology *topo);
+
+boolean
+lp_bind_thread_to_cpu(unsigned cpu);
+
+void *
+lp_numa_alloc(size_t size, uint64_t node_mask);
+
+void
+lp_numa_free(void *ptr, size_t size, uint64_t node_mask);
+
+
+#endif /* LP_NUMA_H */
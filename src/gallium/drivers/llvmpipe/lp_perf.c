@@ -102,6 +102,11 @@ lp_print_counters(void)
       debug_printf("llvmpipe: nr_color_tile_load:           %9u\n", lp_count.nr_color_tile_load);
       debug_printf("llvmpipe: nr_color_tile_store:          %9u\n", lp_count.nr_color_tile_store);
 
+      debug_printf("llvmpipe: nr_scenes:                    %9u\n", lp_count.nr_scenes);
+      debug_printf("llvmpipe:   nr_scenes_overlapped:       %9u (%3.0f%% of %u)\n", lp_count.nr_scenes_overlapped, 100.0 * (float) lp_count.nr_scenes_overlapped / (float) lp_count.nr_scenes, lp_count.nr_scenes);
+      debug_printf("llvmpipe:   nr_scene_waits:             %9u\n", lp_count.nr_scene_waits);
+      debug_printf("llvmpipe: total scene wait time:        %.2f sec\n", lp_count.scene_wait_time / 1000000.0);
+
       debug_printf("llvmpipe: nr_llvm_compiles:             %u\n", lp_count.nr_llvm_compiles);
       debug_printf("llvmpipe: total LLVM compile time:      %.2f sec\n", lp_count.llvm_compile_time / 1000000.0);
       debug_printf("llvmpipe: average LLVM compile time:    %.2f sec\n", lp_count.llvm_compile_time / 1000000.0 / lp_count.nr_llvm_compiles);
@@ -62,6 +62,11 @@ struct lp_counters
    unsigned nr_color_tile_clear;
    unsigned nr_color_tile_load;
    unsigned nr_color_tile_store;
+
+   unsigned nr_scenes;
+   unsigned nr_scenes_overlapped;  /**< binned while another was rasterized */
+   unsigned nr_scene_waits;        /**< had to wait for a free scene */
+   int64_t scene_wait_time;        /**< total, in microseconds */
 };
 
 
@@ -39,6 +39,7 @@
 #include "lp_context.h"
 #include "lp_debug.h"
 #include "lp_fence.h"
+#include "lp_numa.h"
 #include "lp_perf.h"
 #include "lp_query.h"
 #include "lp_rast.h"
@@ -69,16 +70,30 @@ lp_rast_begin( struct lp_rasterizer *rast,
    LP_DBG(DEBUG_RAST, "%s\n", __FUNCTION__);
 
    lp_scene_begin_rasterization( scene );
-   lp_scene_bin_iter_begin( scene );
+   lp_scene_bin_iter_begin( scene, MAX2(1, rast->num_threads) );
 }
 
 
 static void
 lp_rast_end( struct lp_rasterizer *rast )
 {
-   lp_scene_end_rasterization( rast->curr_scene );
+   struct lp_scene *scene = rast->curr_scene;
+   struct lp_fence *fence = NULL;
+
+   /* Unmap the render targets and drop the resource references before the
+    * fence signals, so that whoever waited on it can map or present them.
+    * The scene may be reused by setup as soon as the fence is signalled.
+    */
+   lp_fence_reference(&fence, scene->fence);
+
+   lp_scene_end_rasterization( scene );
 
    rast->curr_scene = NULL;
+
+   if (fence) {
+      lp_fence_signal(fence);
+      lp_fence_reference(&fence, NULL);
+   }
 }
 
 
@@ -655,6 +670,19 @@ is_empty_bin( const struct cmd_bin *bin )
 }
 
 
+/**
+ * Clear the tags of the thread's texture cache.  Textures can't change
+ * while a scene references them, so this only needs to be done at the
+ * start of each scene.
+ */
+static inline void
+clear_texture_cache(struct lp_rasterizer_task *task)
+{
+   if (task->thread_data.cache)
+      lp_build_format_cache_clear(task->thread_data.cache);
+}
+
+
 /**
  * Rasterize/execute all bins within a scene.
  * Called per thread.
@@ -665,50 +693,27 @@ rasterize_scene(struct lp_rasterizer_task *task,
 {
    task->scene = scene;
 
-   /* Clear the cache tags. This should not always be necessary but
-      simpler for now. */
-#if LP_USE_TEXTURE_CACHE
-   memset(task->thread_data.cache->cache_tags, 0,
-          sizeof(task->thread_data.cache->cache_tags));
-#if LP_BUILD_FORMAT_CACHE_DEBUG
-   task->thread_data.cache->cache_access_total = 0;
-   task->thread_data.cache->cache_access_miss = 0;
-#endif
-#endif
+   clear_texture_cache(task);
 
    if (!task->rast->no_rast && !scene->discard) {
       /* loop over scene bins, rasterize each */
       {
          struct cmd_bin *bin;
+         boolean stolen;
          int i, j;
 
          assert(scene);
-         while ((bin = lp_scene_bin_iter_next(scene, &i, &j))) {
+         while ((bin = lp_scene_bin_iter_next(scene, task->thread_index,
+                                              &i, &j, &stolen))) {
             if (!is_empty_bin( bin ))
                rasterize_bin(task, bin, i, j);
+            task->bins_processed++;
+            if (stolen)
+               task->bins_stolen++;
          }
       }
    }
 
-
-#if LP_BUILD_FORMAT_CACHE_DEBUG
-   {
-      uint64_t total, miss;
-      total = task->thread_data.cache->cache_access_total;
-      miss = task->thread_data.cache->cache_access_miss;
-      if (total) {
-         debug_printf("thread %d cache access %llu miss %llu hit rate %f\n",
-                 task->thread_index, (long long unsigned)total,
-                 (long long unsigned)miss,
-                 (float)(total - miss)/(float)total);
-      }
-   }
-#endif
-
-   if (scene->fence) {
-      lp_fence_signal(scene->fence);
-   }
-
    task->scene = NULL;
 }
 
@@ -738,13 +743,13 @@ lp_rast_queue_scene( struct lp_rasterizer *rast,
       lp_rast_end( rast );
 
       util_fpstate_set(fpstate);
-
-      rast->curr_scene = NULL;
    }
    else {
       /* threaded rendering! */
       unsigned i;
 
+      lp_fence_reference(&rast->last_fence, scene->fence);
+
       lp_scene_enqueue( rast->full_scenes, scene );
 
       /* signal the threads that there's work to do */
@@ -757,19 +762,16 @@ lp_rast_queue_scene( struct lp_rasterizer *rast,
 }
 
 
+/**
+ * Wait until all the scenes queued so far have been rasterized.
+ * The caller must hold the screen's rast_mutex.
+ */
 void
-lp_rast_finish( struct lp_rasterizer *rast )
+lp_rast_wait_scenes( struct lp_rasterizer *rast )
 {
-   if (rast->num_threads == 0) {
-      /* nothing to do */
-   }
-   else {
-      int i;
-
-      /* wait for work to complete */
-      for (i = 0; i < rast->num_threads; i++) {
-         pipe_semaphore_wait(&rast->tasks[i].work_done);
-      }
+   if (rast->last_fence) {
+      lp_fence_wait(rast->last_fence);
+      lp_fence_reference(&rast->last_fence, NULL);
    }
 }
 
@@ -788,10 +790,16 @@ static PIPE_THREAD_ROUTINE( thread_function, init_data )
    boolean debug = false;
    char thread_name[16];
    unsigned fpstate;
+   int64_t start;
 
    util_snprintf(thread_name, sizeof thread_name, "llvmpipe-%u", task->thread_index);
    pipe_thread_setname(thread_name);
 
+   if (task->cpu >= 0 && !lp_bind_thread_to_cpu(task->cpu)) {
+      debug_printf("llvmpipe: failed to pin thread %u to cpu %d\n",
+                   task->thread_index, task->cpu);
+   }
+
    /* Make sure that denorms are treated like zeros. This is 
     * the behavior required by D3D10. OpenGL doesn't care.
     */
@@ -819,7 +827,9 @@ static PIPE_THREAD_ROUTINE( thread_function, init_data )
       /* Wait for all threads to get here so that threads[1+] don't
        * get a null rast->curr_scene pointer.
        */
+      start = os_time_get_nano();
       pipe_barrier_wait( &rast->barrier );
+      task->idle_time += os_time_get_nano() - start;
 
       /* do work */
       if (debug)
@@ -829,19 +839,22 @@ static PIPE_THREAD_ROUTINE( thread_function, init_data )
                       rast->curr_scene);
       
       /* wait for all threads to finish with this scene */
+      start = os_time_get_nano();
       pipe_barrier_wait( &rast->barrier );
+      task->idle_time += os_time_get_nano() - start;
 
-      /* XXX: shouldn't be necessary:
+      /* thread[0]:
+       *  - unmap the framebuffer surfaces and signal the scene fence
        */
       if (task->thread_index == 0) {
          lp_rast_end( rast );
       }
 
-      /* signal done with work */
+      /* Nobody waits for scenes through work_done, but through the scene
+       * fences, which were signalled in lp_rast_end().
+       */
       if (debug)
          debug_printf("thread %d done working\n", task->thread_index);
-
-      pipe_semaphore_signal(&task->work_done);
    }
 
 #ifdef _WIN32
@@ -852,6 +865,46 @@ static PIPE_THREAD_ROUTINE( thread_function, init_data )
 }
 
 
+/**
+ * Choose the CPUs to pin the threads to, when LP_PIN_THREADS is set.
+ *
+ * The threads are spread evenly over the CPUs in NUMA node order, so that
+ * threads with consecutive indices, which are given neighbouring bins and
+ * steal from each other first, share a node.
+ */
+static void
+place_rast_threads(struct lp_rasterizer *rast)
+{
+   struct lp_cpu_topology *topo;
+   unsigned i;
+
+   for (i = 0; i < MAX2(1, rast->num_threads); i++) {
+      rast->tasks[i].cpu = -1;
+   }
+   rast->node_mask = 0;
+
+   if (rast->num_threads == 0 ||
+       !debug_get_bool_option("LP_PIN_THREADS", FALSE)) {
+      return;
+   }
+
+   topo = MALLOC_STRUCT(lp_cpu_topology);
+   if (topo && lp_get_cpu_topology(topo)) {
+      for (i = 0; i < rast->num_threads; i++) {
+         unsigned j = i * topo->num_cpus / rast->num_threads;
+
+         rast->tasks[i].cpu = topo->cpu[j];
+         rast->node_mask |= (uint64_t)1 << topo->node[j];
+      }
+
+      LP_DBG(DEBUG_RAST, "%u threads pinned over %u cpus, node mask 0x%llx\n",
+             rast->num_threads, topo->num_cpus,
+             (unsigned long long)rast->node_mask);
+   }
+   FREE(topo);
+}
+
+
 /**
  * Initialize semaphores and spawn the threads.
  */
@@ -896,10 +949,11 @@ lp_rast_create( unsigned num_threads )
       struct lp_rasterizer_task *task = &rast->tasks[i];
       task->rast = rast;
       task->thread_index = i;
-      task->thread_data.cache = align_malloc(sizeof(struct lp_build_format_cache),
-                                             16);
-      if (!task->thread_data.cache) {
-         goto no_thread_data_cache;
+      if (lp_build_format_cache_size) {
+         task->thread_data.cache = lp_build_format_cache_create();
+         if (!task->thread_data.cache) {
+            goto no_thread_data_cache;
+         }
       }
    }
 
@@ -907,6 +961,7 @@ lp_rast_create( unsigned num_threads )
 
    rast->no_rast = debug_get_bool_option("LP_NO_RAST", FALSE);
 
+   place_rast_threads(rast);
    create_rast_threads(rast);
 
    /* for synchronizing rasterization threads */
@@ -921,7 +976,7 @@ lp_rast_create( unsigned num_threads )
 no_thread_data_cache:
    for (i = 0; i < MAX2(1, rast->num_threads); i++) {
       if (rast->tasks[i].thread_data.cache) {
-         align_free(rast->tasks[i].thread_data.cache);
+         lp_build_format_cache_destroy(rast->tasks[i].thread_data.cache);
       }
    }
 
@@ -933,6 +988,17 @@ no_rast:
 }
 
 
+/**
+ * NUMA nodes the rasterizer threads run on, for placing the scene data
+ * they read.  Zero unless the threads are pinned.
+ */
+uint64_t
+lp_rast_get_node_mask( const struct lp_rasterizer *rast )
+{
+   return rast->node_mask;
+}
+
+
 /* Shutdown:
  */
 void lp_rast_destroy( struct lp_rasterizer *rast )
@@ -959,13 +1025,45 @@ void lp_rast_destroy( struct lp_rasterizer *rast )
 #endif
    }
 
+   if (LP_DEBUG & DEBUG_COUNTERS) {
+      for (i = 0; i < MAX2(1, rast->num_threads); i++) {
+         const struct lp_rasterizer_task *task = &rast->tasks[i];
+         debug_printf("llvmpipe: thread %2u: %9llu bins, %9llu stolen, "
+                      "%.2f ms idle\n", i,
+                      (unsigned long long)task->bins_processed,
+                      (unsigned long long)task->bins_stolen,
+                      task->idle_time / 1000000.0);
+      }
+   }
+
+#if LP_BUILD_FORMAT_CACHE_DEBUG
+   for (i = 0; i < MAX2(1, rast->num_threads); i++) {
+      const struct lp_build_format_cache *cache = rast->tasks[i].thread_data.cache;
+      uint64_t total, miss;
+
+      if (!cache)
+         continue;
+
+      total = cache->cache_access_total;
+      miss = cache->cache_access_miss;
+      if (total) {
+         debug_printf("thread %d texture cache access %llu miss %llu "
+                      "hit rate %f\n",
+                      i, (long long unsigned)total,
+                      (long long unsigned)miss,
+                      (float)(total - miss)/(float)total);
+      }
+   }
+#endif
+
    /* Clean up per-thread data */
    for (i = 0; i < rast->num_threads; i++) {
       pipe_semaphore_destroy(&rast->tasks[i].work_ready);
       pipe_semaphore_destroy(&rast->tasks[i].work_done);
    }
    for (i = 0; i < MAX2(1, rast->num_threads); i++) {
-      align_free(rast->tasks[i].thread_data.cache);
+      if (rast->tasks[i].thread_data.cache)
+         lp_build_format_cache_destroy(rast->tasks[i].thread_data.cache);
    }
 
    /* for synchronizing rasterization threads */
@@ -973,6 +1071,8 @@ void lp_rast_destroy( struct lp_rasterizer *rast )
       pipe_barrier_destroy( &rast->barrier );
    }
 
+   lp_fence_reference(&rast->last_fence, NULL);
+
    lp_scene_queue_destroy(rast->full_scenes);
 
    FREE(rast);
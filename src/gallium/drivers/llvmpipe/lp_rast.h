@@ -162,13 +162,15 @@ lp_rast_create( unsigned num_threads );
 void
 lp_rast_destroy( struct lp_rasterizer * );
 
-void 
-lp_rast_queue_scene( struct lp_rasterizer *rast,
-                     struct lp_scene *scene );
+uint64_t
+lp_rast_get_node_mask( const struct lp_rasterizer *rast );
 
 void
-lp_rast_finish( struct lp_rasterizer *rast );
+lp_rast_wait_scenes( struct lp_rasterizer *rast );
 
+void 
+lp_rast_queue_scene( struct lp_rasterizer *rast,
+                     struct lp_scene *scene );
 
 union lp_rast_cmd_arg {
    const struct lp_rast_shader_inputs *shade_tile;
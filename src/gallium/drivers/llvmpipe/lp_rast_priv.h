@@ -97,11 +97,19 @@ struct lp_rasterizer_task
    /** "my" index */
    unsigned thread_index;
 
+   /** CPU the thread is pinned to, or -1 */
+   int cpu;
+
    /** Non-interpolated passthru state and occlude counter for visible pixels */
    struct lp_jit_thread_data thread_data;
    uint64_t ps_invocations;
    uint8_t ps_inv_multiplier;
 
+   /** Scheduling statistics, printed with LP_DEBUG=counters */
+   uint64_t bins_processed;
+   uint64_t bins_stolen;
+   int64_t idle_time;  /**< waiting for the other threads, in nanoseconds */
+
    pipe_semaphore work_ready;
    pipe_semaphore work_done;
 };
@@ -123,12 +131,18 @@ struct lp_rasterizer
    /** The scene currently being rasterized by the threads */
    struct lp_scene *curr_scene;
 
+   /** Fence of the last scene queued, for lp_rast_wait_scenes() */
+   struct lp_fence *last_fence;
+
    /** A task object for each rasterization thread */
    struct lp_rasterizer_task tasks[LP_MAX_THREADS];
 
    unsigned num_threads;
    pipe_thread threads[LP_MAX_THREADS];
 
+   /** NUMA nodes of the CPUs the threads are pinned to, if any */
+   uint64_t node_mask;
+
    /** For synchronizing the rasterization threads */
    pipe_barrier barrier;
 };
@@ -25,6 +25,7 @@
  *
  **************************************************************************/
 
+#include "util/u_atomic.h"
 #include "util/u_framebuffer.h"
 #include "util/u_math.h"
 #include "util/u_memory.h"
@@ -34,6 +35,7 @@
 #include "lp_scene.h"
 #include "lp_fence.h"
 #include "lp_debug.h"
+#include "lp_numa.h"
 
 
 #define RESOURCE_REF_SZ 32
@@ -48,21 +50,30 @@ struct resource_ref {
 
 /**
  * Create a new scene object.
- * \param queue  the queue to put newly rendered/emptied scenes into
+ * \param node_mask  NUMA nodes of the rasterizer threads
  */
 struct lp_scene *
-lp_scene_create( struct pipe_context *pipe )
+lp_scene_create( struct pipe_context *pipe, uint64_t node_mask )
 {
    struct lp_scene *scene = CALLOC_STRUCT(lp_scene);
    if (!scene)
       return NULL;
 
    scene->pipe = pipe;
+   scene->node_mask = node_mask;
+   pipe_mutex_init(scene->mutex);
 
-   scene->data.head =
-      CALLOC_STRUCT(data_block);
+   /* Data blocks are allocated with lp_numa_alloc(), all of them, since
+    * the first one isn't necessarily the one kept at the end of a scene.
+    */
+   scene->data.head = lp_numa_alloc(sizeof *scene->data.head, node_mask);
+   if (!scene->data.head) {
+      FREE(scene);
+      return NULL;
+   }
+   scene->data.head->used = 0;
+   scene->data.head->next = NULL;
 
-   pipe_mutex_init(scene->mutex);
 
 #ifdef DEBUG
    /* Do some scene limit sanity checks here */
@@ -92,7 +103,7 @@ lp_scene_destroy(struct lp_scene *scene)
    lp_fence_reference(&scene->fence, NULL);
    pipe_mutex_destroy(scene->mutex);
    assert(scene->data.head->next == NULL);
-   FREE(scene->data.head);
+   lp_numa_free(scene->data.head, sizeof *scene->data.head, scene->node_mask);
    FREE(scene);
 }
 
@@ -205,12 +216,15 @@ lp_scene_begin_rasterization(struct lp_scene *scene)
 
 /**
  * Free all the temporary data in a scene.
+ * The fence is kept, it's dropped when the scene is reused.
  */
 void
 lp_scene_end_rasterization(struct lp_scene *scene )
 {
    int i, j;
 
+   pipe_mutex_lock(scene->mutex);
+
    /* Unmap color buffers */
    for (i = 0; i < scene->fb.nr_cbufs; i++) {
       if (scene->cbufs[i].map) {
@@ -282,15 +296,13 @@ lp_scene_end_rasterization(struct lp_scene *scene )
 
       for (block = list->head->next; block; block = tmp) {
          tmp = block->next;
-	 FREE(block);
+         lp_numa_free(block, sizeof *block, scene->node_mask);
       }
 
       list->head->next = NULL;
       list->head->used = 0;
    }
 
-   lp_fence_reference(&scene->fence, NULL);
-
    scene->resources = NULL;
    scene->scene_size = 0;
    scene->resource_reference_size = 0;
@@ -298,6 +310,8 @@ lp_scene_end_rasterization(struct lp_scene *scene )
    scene->alloc_failed = FALSE;
 
    util_unreference_framebuffer_state( &scene->fb );
+
+   pipe_mutex_unlock(scene->mutex);
 }
 
 
@@ -336,7 +350,8 @@ lp_scene_new_data_block( struct lp_scene *scene )
       return NULL;
    }
    else {
-      struct data_block *block = MALLOC_STRUCT(data_block);
+      struct data_block *block = lp_numa_alloc(sizeof *block,
+                                               scene->node_mask);
       if (!block)
          return NULL;
       
@@ -449,61 +464,160 @@ lp_scene_is_resource_referenced(const struct lp_scene *scene,
 
 
 
-/** advance curr_x,y to the next bin */
-static boolean
-next_bin(struct lp_scene *scene)
+#define BIN_RANGE(head, tail) (((uint32_t)(head) << 16) | (tail))
+#define BIN_RANGE_HEAD(range) ((range) >> 16)
+#define BIN_RANGE_TAIL(range) ((range) & 0xffff)
+
+
+/** Gather the even bits of a Morton code */
+static inline unsigned
+morton_compact(unsigned v)
 {
-   scene->curr_x++;
-   if (scene->curr_x >= scene->tiles_x) {
-      scene->curr_x = 0;
-      scene->curr_y++;
+   v &= 0x55555555;
+   v = (v | (v >> 1)) & 0x33333333;
+   v = (v | (v >> 2)) & 0x0f0f0f0f;
+   v = (v | (v >> 4)) & 0x00ff00ff;
+   v = (v | (v >> 8)) & 0x0000ffff;
+   return v;
+}
+
+
+/**
+ * Prepare for iterating over the bins with the given number of threads.
+ * Must be called by a single thread, before any lp_scene_bin_iter_next().
+ */
+void
+lp_scene_bin_iter_begin( struct lp_scene *scene, unsigned num_queues )
+{
+   unsigned size = util_next_power_of_two(MAX2(scene->tiles_x,
+                                                scene->tiles_y));
+   unsigned num_bins = 0;
+   unsigned d, i;
+
+   STATIC_ASSERT(TILES_X * TILES_Y <= 0xffff);
+
+   /* Walk the bins along a Z-order curve, skipping empty ones */
+   for (d = 0; d < size * size; d++) {
+      unsigned x = morton_compact(d);
+      unsigned y = morton_compact(d >> 1);
+
+      if (x < scene->tiles_x && y < scene->tiles_y &&
+          scene->tile[x][y].head != NULL) {
+         scene->bin_order[num_bins].x = x;
+         scene->bin_order[num_bins].y = y;
+         num_bins++;
+      }
    }
-   if (scene->curr_y >= scene->tiles_y) {
-      /* no more bins */
-      return FALSE;
+
+   /* Give each thread a cluster of neighbouring bins */
+   num_queues = CLAMP(num_queues, 1, LP_MAX_THREADS);
+   for (i = 0; i < num_queues; i++) {
+      unsigned head = num_bins * i / num_queues;
+      unsigned tail = num_bins * (i + 1) / num_queues;
+      scene->queues[i].range = BIN_RANGE(head, tail);
    }
-   return TRUE;
+   scene->num_queues = num_queues;
 }
 
 
-void
-lp_scene_bin_iter_begin( struct lp_scene *scene )
+/** Take the bin at the head of a queue */
+static boolean
+pop_bin(struct lp_bin_queue *queue, unsigned *pos)
+{
+   uint32_t range = p_atomic_read(&queue->range);
+
+   while (1) {
+      unsigned head = BIN_RANGE_HEAD(range);
+      unsigned tail = BIN_RANGE_TAIL(range);
+      uint32_t old;
+
+      if (head >= tail)
+         return FALSE;
+
+      old = p_atomic_cmpxchg(&queue->range, range, BIN_RANGE(head + 1, tail));
+      if (old == range) {
+         *pos = head;
+         return TRUE;
+      }
+      range = old;
+   }
+}
+
+
+/**
+ * Steal the last half of another thread's remaining bins.  The first of
+ * them is returned and the rest become the new contents of our own queue,
+ * which must be empty.
+ *
+ * The queue before ours is tried first, since the end of its range is
+ * adjacent to the start of ours in the Morton order.
+ */
+static boolean
+steal_bins(struct lp_scene *scene, unsigned queue, unsigned *pos)
 {
-   scene->curr_x = scene->curr_y = -1;
+   const unsigned num_queues = scene->num_queues;
+   unsigned i;
+
+   for (i = 1; i < num_queues; i++) {
+      struct lp_bin_queue *victim =
+         &scene->queues[(queue + num_queues - i) % num_queues];
+      uint32_t range = p_atomic_read(&victim->range);
+
+      while (1) {
+         unsigned head = BIN_RANGE_HEAD(range);
+         unsigned tail = BIN_RANGE_TAIL(range);
+         unsigned first;
+         uint32_t old;
+
+         if (head >= tail)
+            break;
+
+         first = tail - (tail - head + 1) / 2;
+         old = p_atomic_cmpxchg(&victim->range, range,
+                                BIN_RANGE(head, first));
+         if (old == range) {
+            /* Nobody else modifies an empty queue, so a plain store is
+             * enough here.
+             */
+            p_atomic_set(&scene->queues[queue].range,
+                         BIN_RANGE(first + 1, tail));
+            *pos = first;
+            return TRUE;
+         }
+         range = old;
+      }
+   }
+
+   return FALSE;
 }
 
 
 /**
- * Return pointer to next bin to be rendered.
- * The lp_scene::curr_x and ::curr_y fields will be advanced.
+ * Return pointer to next bin to be rendered by the thread owning the
+ * given queue, or NULL when there are no bins left anywhere.
  * Multiple rendering threads will call this function to get a chunk
- * of work (a bin) to work on.
+ * of work (a bin) to work on.  This doesn't take any locks.
+ *
+ * \param stolen  set to TRUE if the bin was taken from another queue
  */
 struct cmd_bin *
-lp_scene_bin_iter_next( struct lp_scene *scene , int *x, int *y)
+lp_scene_bin_iter_next( struct lp_scene *scene, unsigned queue,
+                        int *x, int *y, boolean *stolen )
 {
-   struct cmd_bin *bin = NULL;
+   unsigned pos;
 
-   pipe_mutex_lock(scene->mutex);
+   assert(queue < scene->num_queues);
 
-   if (scene->curr_x < 0) {
-      /* first bin */
-      scene->curr_x = 0;
-      scene->curr_y = 0;
-   }
-   else if (!next_bin(scene)) {
-      /* no more bins left */
-      goto end;
+   *stolen = FALSE;
+   if (!pop_bin(&scene->queues[queue], &pos)) {
+      if (!steal_bins(scene, queue, &pos))
+         return NULL;
+      *stolen = TRUE;
    }
 
-   bin = lp_scene_get_bin(scene, scene->curr_x, scene->curr_y);
-   *x = scene->curr_x;
-   *y = scene->curr_y;
-
-end:
-   /*printf("return bin %p at %d, %d\n", (void *) bin, *bin_x, *bin_y);*/
-   pipe_mutex_unlock(scene->mutex);
-   return bin;
+   *x = scene->bin_order[pos].x;
+   *y = scene->bin_order[pos].y;
+   return lp_scene_get_bin(scene, *x, *y);
 }
 
 
@@ -117,6 +117,26 @@ struct data_block_list {
 
 struct resource_ref;
 
+/** Position of a bin, in tiles */
+struct lp_bin_pos {
+   uint16_t x, y;
+};
+
+
+/**
+ * A range [head, tail) of lp_scene::bin_order, packed as head << 16 | tail
+ * so that it can be updated with a single compare-and-swap.
+ *
+ * Each rasterizer thread takes bins from the head of its own queue, and
+ * once that is empty steals from the tail of the other threads' queues.
+ * Padded to a cache line, as each queue is mostly accessed by its owner.
+ */
+struct lp_bin_queue {
+   uint32_t range;
+   uint8_t pad[60];
+};
+
+
 /**
  * All bins and bin data are contained here.
  * Per-bin data goes into the 'tile' bins.
@@ -129,6 +149,11 @@ struct lp_scene {
    struct pipe_context *pipe;
    struct lp_fence *fence;
 
+   /* Held by the rasterizer while it cleans up fb and resources, which
+    * lp_setup_is_resource_referenced() looks at from the setup side.
+    */
+   pipe_mutex mutex;
+
    /* The queries still active at end of scene */
    struct llvmpipe_query *active_queries[LP_MAX_ACTIVE_BINNED_QUERIES];
    unsigned num_active_queries;
@@ -165,6 +190,9 @@ struct lp_scene {
     */
    unsigned resource_reference_size;
 
+   /** NUMA nodes to spread the data blocks over, see lp_numa_alloc() */
+   uint64_t node_mask;
+
    boolean alloc_failed;
    boolean discard;
    /**
@@ -173,8 +201,14 @@ struct lp_scene {
     */
    unsigned tiles_x, tiles_y;
 
-   int curr_x, curr_y;  /**< for iterating over bins */
-   pipe_mutex mutex;
+   /**
+    * For iterating over bins: the non-empty bins in Morton order, so that
+    * consecutive bins are close to each other, split into one contiguous
+    * range per rasterizer thread.
+    */
+   unsigned num_queues;
+   struct lp_bin_queue queues[LP_MAX_THREADS];
+   struct lp_bin_pos bin_order[TILES_X * TILES_Y];
 
    struct cmd_bin tile[TILES_X][TILES_Y];
    struct data_block_list data;
@@ -182,7 +216,8 @@ struct lp_scene {
 
 
 
-struct lp_scene *lp_scene_create(struct pipe_context *pipe);
+struct lp_scene *lp_scene_create(struct pipe_context *pipe,
+                                 uint64_t node_mask);
 
 void lp_scene_destroy(struct lp_scene *scene);
 
@@ -379,10 +414,11 @@ lp_scene_get_num_bins( const struct lp_scene *scene )
 
 
 void
-lp_scene_bin_iter_begin( struct lp_scene *scene );
+lp_scene_bin_iter_begin( struct lp_scene *scene, unsigned num_queues );
 
 struct cmd_bin *
-lp_scene_bin_iter_next( struct lp_scene *scene, int *x, int *y );
+lp_scene_bin_iter_next( struct lp_scene *scene, unsigned queue,
+                        int *x, int *y, boolean *stolen );
 
 
 
@@ -48,6 +48,7 @@
 #include "lp_public.h"
 #include "lp_limits.h"
 #include "lp_rast.h"
+#include "lp_fs_cache.h"
 
 #include "state_tracker/sw_winsys.h"
 
@@ -67,6 +68,7 @@ static const struct debug_named_value lp_debug_flags[] = {
    { "fence", DEBUG_FENCE, NULL },
    { "mem", DEBUG_MEM, NULL },
    { "fs", DEBUG_FS, NULL },
+   { "fs_cache", DEBUG_FS_CACHE, NULL },
    DEBUG_NAMED_VALUE_END
 };
 #endif
@@ -348,6 +350,8 @@ llvmpipe_get_shader_param(struct pipe_screen *screen, unsigned shader, enum pipe
       }
    case PIPE_SHADER_VERTEX:
    case PIPE_SHADER_GEOMETRY:
+   case PIPE_SHADER_TESS_CTRL:
+   case PIPE_SHADER_TESS_EVAL:
       switch (param) {
       case PIPE_SHADER_CAP_MAX_TEXTURE_SAMPLERS:
          /* At this time, the draw module and llvmpipe driver only
@@ -526,8 +530,16 @@ llvmpipe_flush_frontbuffer(struct pipe_screen *_screen,
    struct llvmpipe_resource *texture = llvmpipe_resource(resource);
 
    assert(texture->dt);
-   if (texture->dt)
+   if (texture->dt) {
+      /* Flushing doesn't wait for the rasterizer, the scenes drawing to
+       * the resource may still be in flight.
+       */
+      pipe_mutex_lock(screen->rast_mutex);
+      lp_rast_wait_scenes(screen->rast);
+      pipe_mutex_unlock(screen->rast_mutex);
+
       winsys->displaytarget_display(winsys, texture->dt, context_private, sub_box);
+   }
 }
 
 static void
@@ -539,6 +551,12 @@ llvmpipe_destroy_screen( struct pipe_screen *_screen )
    if (screen->rast)
       lp_rast_destroy(screen->rast);
 
+   if (screen->fs_cache) {
+      if (LP_DEBUG & DEBUG_FS_CACHE)
+         lp_fs_cache_print_stats(screen->fs_cache);
+      lp_fs_cache_destroy(screen->fs_cache);
+   }
+
    lp_jit_screen_cleanup(screen);
 
    if(winsys->destroy)
@@ -653,6 +671,11 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    }
    pipe_mutex_init(screen->rast_mutex);
 
+   /* Failing to create the cache is not fatal, variants just won't be shared */
+   screen->fs_cache =
+      lp_fs_cache_create(debug_get_num_option("LP_FS_CACHE_SIZE",
+                                              LP_MAX_CACHED_SHADER_VARIANTS));
+
    util_format_s3tc_init();
 
    return &screen->base;
@@ -41,6 +41,7 @@
 
 
 struct sw_winsys;
+struct lp_fs_cache;
 
 
 struct llvmpipe_screen
@@ -57,6 +58,9 @@ struct llvmpipe_screen
 
    struct lp_rasterizer *rast;
    pipe_mutex rast_mutex;
+
+   /* Fragment shader variants shared by all contexts */
+   struct lp_fs_cache *fs_cache;
 };
 
 
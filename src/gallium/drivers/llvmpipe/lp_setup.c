@@ -43,6 +43,7 @@
 #include "os/os_time.h"
 #include "lp_context.h"
 #include "lp_memory.h"
+#include "lp_perf.h"
 #include "lp_scene.h"
 #include "lp_texture.h"
 #include "lp_debug.h"
@@ -69,18 +70,35 @@ lp_setup_get_empty_scene(struct lp_setup_context *setup)
    assert(setup->scene == NULL);
 
    setup->scene_idx++;
-   setup->scene_idx %= ARRAY_SIZE(setup->scenes);
+   setup->scene_idx %= setup->num_scenes;
 
    setup->scene = setup->scenes[setup->scene_idx];
 
+   /* The rasterizer cleans scenes up before signalling their fence, so
+    * waiting for it is enough.  This only blocks when all the scenes are
+    * still queued for rasterization.
+    */
    if (setup->scene->fence) {
-      if (LP_DEBUG & DEBUG_SETUP)
-         debug_printf("%s: wait for scene %d\n",
-                      __FUNCTION__, setup->scene->fence->id);
+      if (!lp_fence_signalled(setup->scene->fence)) {
+         int64_t start = os_time_get();
+
+         if (LP_DEBUG & DEBUG_SETUP)
+            debug_printf("%s: wait for scene %d\n",
+                         __FUNCTION__, setup->scene->fence->id);
+
+         lp_fence_wait(setup->scene->fence);
+
+         LP_COUNT(nr_scene_waits);
+         LP_COUNT_ADD(scene_wait_time, os_time_get() - start);
+      }
 
-      lp_fence_wait(setup->scene->fence);
+      lp_fence_reference(&setup->scene->fence, NULL);
    }
 
+   /* Binning this scene overlaps with the rasterization of the last one */
+   if (setup->last_fence && !lp_fence_signalled(setup->last_fence))
+      LP_COUNT(nr_scenes_overlapped);
+
    lp_scene_begin_binning(setup->scene, &setup->fb, setup->rasterizer_discard);
 
 }
@@ -164,23 +182,17 @@ lp_setup_rasterize_scene( struct lp_setup_context *setup )
    if (setup->last_fence)
       setup->last_fence->issued = TRUE;
 
-   pipe_mutex_lock(screen->rast_mutex);
+   LP_COUNT(nr_scenes);
 
-   /* FIXME: We enqueue the scene then wait on the rasterizer to finish.
-    * This means we never actually run any vertex stuff in parallel to
-    * rasterization (not in the same context at least) which is what the
-    * multiple scenes per setup is about - when we get a new empty scene
-    * any old one is already empty again because we waited here for
-    * raster tasks to be finished. Ideally, we shouldn't need to wait here
-    * and rely on fences elsewhere when waiting is necessary.
-    * Certainly, lp_scene_end_rasterization() would need to be deferred too
-    * and there's probably other bits why this doesn't actually work.
+   /* Don't wait for the rasterizer to finish: the next scene can be binned
+    * in the meantime.  Whoever needs the results waits on the scene fence
+    * (see llvmpipe_flush_resource()), and the scene itself is cleaned up
+    * when it is reused.
     */
+   pipe_mutex_lock(screen->rast_mutex);
    lp_rast_queue_scene(screen->rast, scene);
-   lp_rast_finish(screen->rast);
    pipe_mutex_unlock(screen->rast_mutex);
 
-   lp_scene_end_rasterization(setup->scene);
    lp_setup_reset( setup );
 
    LP_DBG(DEBUG_SETUP, "%s done \n", __FUNCTION__);
@@ -200,7 +212,7 @@ begin_binning( struct lp_setup_context *setup )
 
    /* Always create a fence:
     */
-   scene->fence = lp_fence_create(MAX2(1, setup->num_threads));
+   scene->fence = lp_fence_create(1);
    if (!scene->fence)
       return FALSE;
 
@@ -342,6 +354,7 @@ set_scene_state( struct lp_setup_context *setup,
 fail:
    if (setup->scene) {
       lp_scene_end_rasterization(setup->scene);
+      lp_fence_reference(&setup->scene->fence, NULL);
       setup->scene = NULL;
    }
 
@@ -978,6 +991,7 @@ unsigned
 lp_setup_is_resource_referenced( const struct lp_setup_context *setup,
                                 const struct pipe_resource *texture )
 {
+   unsigned referenced = LP_UNREFERENCED;
    unsigned i;
 
    /* check the render targets */
@@ -989,14 +1003,40 @@ lp_setup_is_resource_referenced( const struct lp_setup_context *setup,
       return LP_REFERENCED_FOR_READ | LP_REFERENCED_FOR_WRITE;
    }
 
-   /* check textures referenced by the scene */
-   for (i = 0; i < ARRAY_SIZE(setup->scenes); i++) {
-      if (lp_scene_is_resource_referenced(setup->scenes[i], texture)) {
-         return LP_REFERENCED_FOR_READ;
+   /* check the scenes which haven't been rasterized yet */
+   for (i = 0; i < setup->num_scenes; i++) {
+      struct lp_scene *scene = setup->scenes[i];
+      unsigned scene_referenced = LP_UNREFERENCED;
+      unsigned j;
+
+      if (!scene->fence || lp_fence_signalled(scene->fence))
+         continue;
+
+      /* the rasterizer may be cleaning the scene up meanwhile */
+      pipe_mutex_lock(scene->mutex);
+
+      for (j = 0; j < scene->fb.nr_cbufs; j++) {
+         if (scene->fb.cbufs[j] && scene->fb.cbufs[j]->texture == texture)
+            scene_referenced = LP_REFERENCED_FOR_READ | LP_REFERENCED_FOR_WRITE;
+      }
+      if (scene->fb.zsbuf && scene->fb.zsbuf->texture == texture) {
+         scene_referenced = LP_REFERENCED_FOR_READ | LP_REFERENCED_FOR_WRITE;
+      }
+
+      if (!scene_referenced &&
+          lp_scene_is_resource_referenced(scene, texture)) {
+         scene_referenced = LP_REFERENCED_FOR_READ;
       }
+
+      pipe_mutex_unlock(scene->mutex);
+
+      if (scene_referenced & LP_REFERENCED_FOR_WRITE)
+         return scene_referenced;
+
+      referenced |= scene_referenced;
    }
 
-   return LP_UNREFERENCED;
+   return referenced;
 }
 
 
@@ -1291,8 +1331,8 @@ lp_setup_destroy( struct lp_setup_context *setup )
       pipe_resource_reference(&setup->constants[i].current.buffer, NULL);
    }
 
-   /* free the scenes in the 'empty' queue */
-   for (i = 0; i < ARRAY_SIZE(setup->scenes); i++) {
+   /* wait for the scenes still being rasterized, and free them all */
+   for (i = 0; i < setup->num_scenes; i++) {
       struct lp_scene *scene = setup->scenes[i];
 
       if (scene->fence)
@@ -1341,9 +1381,14 @@ lp_setup_create( struct pipe_context *pipe,
    draw_set_rasterize_stage(draw, setup->vbuf);
    draw_set_render(draw, &setup->base);
 
+   /* One scene means binning and rasterization never overlap */
+   setup->num_scenes = debug_get_num_option("LP_NUM_SCENES", MAX_SCENES);
+   setup->num_scenes = CLAMP(setup->num_scenes, 1, MAX_SCENES);
+
    /* create some empty scenes */
-   for (i = 0; i < MAX_SCENES; i++) {
-      setup->scenes[i] = lp_scene_create( pipe );
+   for (i = 0; i < setup->num_scenes; i++) {
+      setup->scenes[i] = lp_scene_create( pipe,
+                                          lp_rast_get_node_mask(screen->rast) );
       if (!setup->scenes[i]) {
          goto no_scenes;
       }
@@ -1358,7 +1403,7 @@ lp_setup_create( struct pipe_context *pipe,
    return setup;
 
 no_scenes:
-   for (i = 0; i < MAX_SCENES; i++) {
+   for (i = 0; i < setup->num_scenes; i++) {
       if (setup->scenes[i]) {
          lp_scene_destroy(setup->scenes[i]);
       }
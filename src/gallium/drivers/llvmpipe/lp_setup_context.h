@@ -54,9 +54,11 @@
 struct lp_setup_variant;
 
 
-/** Max number of scenes */
-/* XXX: make multiple scenes per context work, see lp_setup_rasterize_scene */
-#define MAX_SCENES 1
+/**
+ * Max number of scenes.  While one scene is being rasterized the next ones
+ * can be binned; see lp_setup_get_empty_scene().
+ */
+#define MAX_SCENES 4
 
 
 
@@ -87,6 +89,7 @@ struct lp_setup_context
     */
    struct draw_stage *vbuf;
    unsigned num_threads;
+   unsigned num_scenes;                  /**< LP_NUM_SCENES, <= MAX_SCENES */
    unsigned scene_idx;
    struct lp_scene *scenes[MAX_SCENES];  /**< all the scenes */
    struct lp_scene *scene;               /**< current scene being built */
@@ -56,6 +56,8 @@
 #define LP_NEW_GS            0x10000
 #define LP_NEW_SO            0x20000
 #define LP_NEW_SO_BUFFERS    0x40000
+#define LP_NEW_TCS           0x80000
+#define LP_NEW_TES           0x100000
 
 
 
@@ -71,6 +73,14 @@ struct lp_geometry_shader {
    struct draw_geometry_shader *dgs;
 };
 
+struct lp_tess_ctrl_shader {
+   struct draw_tess_ctrl_shader *dtcs;
+};
+
+struct lp_tess_eval_shader {
+   struct draw_tess_eval_shader *dtes;
+};
+
 /** Vertex element state */
 struct lp_velems_state
 {
@@ -120,6 +130,9 @@ llvmpipe_init_vs_funcs(struct llvmpipe_context *llvmpipe);
 void
 llvmpipe_init_gs_funcs(struct llvmpipe_context *llvmpipe);
 
+void
+llvmpipe_init_tess_funcs(struct llvmpipe_context *llvmpipe);
+
 void
 llvmpipe_init_rasterizer_funcs(struct llvmpipe_context *llvmpipe);
 
@@ -136,4 +149,14 @@ llvmpipe_prepare_geometry_sampling(struct llvmpipe_context *ctx,
                                    unsigned num,
                                    struct pipe_sampler_view **views);
 
+void
+llvmpipe_prepare_tess_ctrl_sampling(struct llvmpipe_context *ctx,
+                                    unsigned num,
+                                    struct pipe_sampler_view **views);
+
+void
+llvmpipe_prepare_tess_eval_sampling(struct llvmpipe_context *ctx,
+                                    unsigned num,
+                                    struct pipe_sampler_view **views);
+
 #endif
@@ -87,12 +87,14 @@
 #include "gallivm/lp_bld_pack.h"
 #include "gallivm/lp_bld_format.h"
 #include "gallivm/lp_bld_quad.h"
+#include "gallivm/lp_bld_disk_cache.h"
 
 #include "lp_bld_alpha.h"
 #include "lp_bld_blend.h"
 #include "lp_bld_depth.h"
 #include "lp_bld_interp.h"
 #include "lp_context.h"
+#include "lp_screen.h"
 #include "lp_debug.h"
 #include "lp_perf.h"
 #include "lp_setup.h"
@@ -100,6 +102,7 @@
 #include "lp_tex_sample.h"
 #include "lp_flush.h"
 #include "lp_state_fs.h"
+#include "lp_fs_cache.h"
 #include "lp_rast.h"
 
 
@@ -422,7 +425,7 @@ generate_fs_loop(struct gallivm_state *gallivm,
                      consts_ptr, num_consts_ptr, &system_values,
                      interp->inputs,
                      outputs, context_ptr, thread_data_ptr,
-                     sampler, &shader->info.base, NULL);
+                     sampler, &shader->info.base, NULL, NULL, NULL);
 
    /* Alpha test */
    if (key->alpha.enabled) {
@@ -2557,7 +2560,10 @@ generate_variant(struct llvmpipe_context *lp,
                  struct lp_fragment_shader *shader,
                  const struct lp_fragment_shader_variant_key *key)
 {
+   struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
    struct lp_fragment_shader_variant *variant;
+   struct lp_cached_code cached;
+   struct mesa_sha1 *key_ctx;
    const struct util_format_description *cbuf0_format_desc;
    boolean fullcolormask;
    char module_name[64];
@@ -2566,15 +2572,6 @@ generate_variant(struct llvmpipe_context *lp,
    if (!variant)
       return NULL;
 
-   util_snprintf(module_name, sizeof(module_name), "fs%u_variant%u",
-                 shader->no, shader->variants_created);
-
-   variant->gallivm = gallivm_create(module_name, lp->context);
-   if (!variant->gallivm) {
-      FREE(variant);
-      return NULL;
-   }
-
    variant->shader = shader;
    variant->list_item_global.base = variant;
    variant->list_item_local.base = variant;
@@ -2613,6 +2610,44 @@ generate_variant(struct llvmpipe_context *lp,
       lp_debug_fs_variant(variant);
    }
 
+   /*
+    * Another context may have already compiled this very variant.
+    */
+   variant->cache_entry = lp_fs_cache_lookup(screen->fs_cache,
+                                             shader->base.tokens,
+                                             shader->tokens_hash,
+                                             key, shader->variant_key_size);
+   if (variant->cache_entry) {
+      variant->jit_function[RAST_WHOLE] =
+         variant->cache_entry->jit_function[RAST_WHOLE];
+      variant->jit_function[RAST_EDGE_TEST] =
+         variant->cache_entry->jit_function[RAST_EDGE_TEST];
+      variant->nr_instrs = variant->cache_entry->nr_instrs;
+      return variant;
+   }
+
+   util_snprintf(module_name, sizeof(module_name), "fs%u_variant%u",
+                 shader->no, variant->no);
+
+   /*
+    * Otherwise look for code left over by a previous run.
+    */
+   key_ctx = lp_cached_code_key_begin("fs");
+   lp_cached_code_key_update(key_ctx, shader->base.tokens,
+                             tgsi_num_tokens(shader->base.tokens) *
+                             sizeof(struct tgsi_token));
+   lp_cached_code_key_update(key_ctx, key, shader->variant_key_size);
+   lp_cached_code_init(&cached, key_ctx);
+
+   variant->gallivm = gallivm_create(module_name, lp->context);
+   if (!variant->gallivm) {
+      lp_cached_code_finish(&cached);
+      FREE(variant);
+      return NULL;
+   }
+
+   variant->gallivm->cache = &cached;
+
    lp_jit_init_types(variant);
    
    if (variant->jit_function[RAST_EDGE_TEST] == NULL)
@@ -2649,6 +2684,27 @@ generate_variant(struct llvmpipe_context *lp,
 
    gallivm_free_ir(variant->gallivm);
 
+   lp_cached_code_finish(&cached);
+
+   /*
+    * Hand the code over to the screen so that other contexts can reuse it.
+    * If some other context beat us to it, use its code instead.
+    */
+   variant->cache_entry = lp_fs_cache_insert(screen->fs_cache,
+                                             shader->base.tokens,
+                                             shader->tokens_hash,
+                                             key, shader->variant_key_size,
+                                             variant->gallivm,
+                                             variant->jit_function,
+                                             variant->nr_instrs);
+   if (variant->cache_entry) {
+      variant->gallivm = NULL;
+      variant->jit_function[RAST_WHOLE] =
+         variant->cache_entry->jit_function[RAST_WHOLE];
+      variant->jit_function[RAST_EDGE_TEST] =
+         variant->cache_entry->jit_function[RAST_EDGE_TEST];
+   }
+
    return variant;
 }
 
@@ -2675,6 +2731,7 @@ llvmpipe_create_fs_state(struct pipe_context *pipe,
 
    /* we need to keep a local copy of the tokens */
    shader->base.tokens = tgsi_dup_tokens(templ->tokens);
+   shader->tokens_hash = lp_fs_cache_hash_tokens(shader->base.tokens);
 
    shader->draw_data = draw_create_fragment_shader(llvmpipe->draw, templ);
    if (shader->draw_data == NULL) {
@@ -2784,7 +2841,13 @@ llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
                    lp->nr_fs_variants);
    }
 
-   gallivm_destroy(variant->gallivm);
+   if (variant->cache_entry) {
+      struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
+      lp_fs_cache_release(screen->fs_cache, variant->cache_entry);
+   }
+   else {
+      gallivm_destroy(variant->gallivm);
+   }
 
    /* remove from shader's list */
    remove_from_list(&variant->list_item_local);
@@ -2855,7 +2918,9 @@ llvmpipe_set_constant_buffer(struct pipe_context *pipe,
    }
 
    if (shader == PIPE_SHADER_VERTEX ||
-       shader == PIPE_SHADER_GEOMETRY) {
+       shader == PIPE_SHADER_GEOMETRY ||
+       shader == PIPE_SHADER_TESS_CTRL ||
+       shader == PIPE_SHADER_TESS_EVAL) {
       /* Pass the constants to the 'draw' module */
       const unsigned size = cb ? cb->buffer_size : 0;
       const ubyte *data;
@@ -2912,8 +2977,8 @@ force_dst_alpha_one(unsigned factor, boolean clamped_zero)
  * We need to generate several variants of the fragment pipeline to match
  * all the combinations of the contributing state atoms.
  *
- * TODO: there is actually no reason to tie this to context state -- the
- * generated code could be cached globally in the screen.
+ * The key does not depend on the context, so the generated code is shared
+ * between contexts through the screen's variant cache (see lp_fs_cache.c).
  */
 static void
 make_variant_key(struct llvmpipe_context *lp,
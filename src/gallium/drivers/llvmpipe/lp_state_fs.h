@@ -40,6 +40,7 @@
 
 struct tgsi_token;
 struct lp_fragment_shader;
+struct lp_fs_cache_entry;
 
 
 /** Indexes into jit_function[] array */
@@ -102,6 +103,9 @@ struct lp_fragment_shader_variant
 
    struct gallivm_state *gallivm;
 
+   /* Code shared through the screen's variant cache, if any */
+   struct lp_fs_cache_entry *cache_entry;
+
    LLVMTypeRef jit_context_ptr_type;
    LLVMTypeRef jit_thread_data_ptr_type;
    LLVMTypeRef jit_linear_context_ptr_type;
@@ -128,6 +132,9 @@ struct lp_fragment_shader
 
    struct lp_tgsi_info info;
 
+   /* Hash of the tokens, for the screen's variant cache */
+   unsigned tokens_hash;
+
    struct lp_fs_variant_list_item variants;
 
    struct draw_fragment_shader *draw_data;
@@ -39,6 +39,7 @@
 #include "gallivm/lp_bld_intr.h"
 #include "gallivm/lp_bld_flow.h"
 #include "gallivm/lp_bld_type.h"
+#include "gallivm/lp_bld_disk_cache.h"
 
 #include "lp_perf.h"
 #include "lp_debug.h"
@@ -717,8 +718,12 @@ generate_setup_variant(struct lp_setup_variant_key *key,
    LLVMTypeRef arg_types[7];
    LLVMBasicBlockRef block;
    LLVMBuilderRef builder;
+   struct lp_cached_code cached;
+   struct mesa_sha1 *key_ctx;
    int64_t t0 = 0, t1;
 
+   memset(&cached, 0, sizeof cached);
+
    if (0)
       goto fail;
 
@@ -731,11 +736,17 @@ generate_setup_variant(struct lp_setup_variant_key *key,
    util_snprintf(func_name, sizeof(func_name), "setup_variant_%u",
                  variant->no);
 
+   key_ctx = lp_cached_code_key_begin("setup");
+   lp_cached_code_key_update(key_ctx, key, key->size);
+   lp_cached_code_init(&cached, key_ctx);
+
    variant->gallivm = gallivm = gallivm_create(func_name, lp->context);
    if (!variant->gallivm) {
       goto fail;
    }
 
+   gallivm->cache = &cached;
+
    builder = gallivm->builder;
 
    if (LP_DEBUG & DEBUG_COUNTERS) {
@@ -808,6 +819,8 @@ generate_setup_variant(struct lp_setup_variant_key *key,
 
    gallivm_free_ir(variant->gallivm);
 
+   lp_cached_code_finish(&cached);
+
    /*
     * Update timing information:
     */
@@ -827,6 +840,8 @@ fail:
       FREE(variant);
    }
 
+   lp_cached_code_finish(&cached);
+
    return NULL;
 }
 
@@ -36,6 +36,7 @@
 #include "util/u_format.h"
 #include "util/u_format_tests.h"
 #include "util/u_format_s3tc.h"
+#include "os/os_time.h"
 
 #include "gallivm/lp_bld.h"
 #include "gallivm/lp_bld_debug.h"
@@ -80,7 +81,7 @@ typedef void
 static LLVMValueRef
 add_fetch_rgba_test(struct gallivm_state *gallivm, unsigned verbose,
                     const struct util_format_description *desc,
-                    struct lp_type type)
+                    struct lp_type type, boolean use_cache)
 {
    char name[256];
    LLVMContextRef context = gallivm->context;
@@ -114,7 +115,7 @@ add_fetch_rgba_test(struct gallivm_state *gallivm, unsigned verbose,
    i = LLVMGetParam(func, 2);
    j = LLVMGetParam(func, 3);
 
-   if (cache_ptr) {
+   if (use_cache) {
       cache = LLVMGetParam(func, 4);
    }
 
@@ -152,7 +153,8 @@ test_format_float(unsigned verbose, FILE *fp,
    context = LLVMContextCreate();
    gallivm = gallivm_create("test_module_float", context);
 
-   fetch = add_fetch_rgba_test(gallivm, verbose, desc, lp_float32_vec4_type());
+   fetch = add_fetch_rgba_test(gallivm, verbose, desc, lp_float32_vec4_type(),
+                               cache_ptr != NULL);
 
    gallivm_compile_module(gallivm);
 
@@ -175,6 +177,10 @@ test_format_float(unsigned verbose, FILE *fp,
          /* To ensure it's 16-byte aligned */
          memcpy(packed, test->packed, sizeof packed);
 
+         /* The cache is keyed by address, and packed was reused */
+         if (cache_ptr)
+            lp_build_format_cache_clear(cache_ptr);
+
          for (i = 0; i < desc->block.height; ++i) {
             for (j = 0; j < desc->block.width; ++j) {
                boolean match = TRUE;
@@ -251,7 +257,8 @@ test_format_unorm8(unsigned verbose, FILE *fp,
    context = LLVMContextCreate();
    gallivm = gallivm_create("test_module_unorm8", context);
 
-   fetch = add_fetch_rgba_test(gallivm, verbose, desc, lp_unorm8_vec4_type());
+   fetch = add_fetch_rgba_test(gallivm, verbose, desc, lp_unorm8_vec4_type(),
+                               cache_ptr != NULL);
 
    gallivm_compile_module(gallivm);
 
@@ -274,6 +281,9 @@ test_format_unorm8(unsigned verbose, FILE *fp,
          /* Could skip this and use unaligned lp_build_fetch_rgba_aos */
          memcpy(packed, test->packed, sizeof packed);
 
+         if (cache_ptr)
+            lp_build_format_cache_clear(cache_ptr);
+
          for (i = 0; i < desc->block.height; ++i) {
             for (j = 0; j < desc->block.width; ++j) {
                boolean match;
@@ -360,7 +370,7 @@ test_all(unsigned verbose, FILE *fp)
    util_format_s3tc_init();
 
 #if USE_TEXTURE_CACHE
-   cache_ptr = align_malloc(sizeof(struct lp_build_format_cache), 16);
+   cache_ptr = lp_build_format_cache_create();
 #endif
 
    for (format = 1; format < PIPE_FORMAT_COUNT; ++format) {
@@ -405,7 +415,9 @@ test_all(unsigned verbose, FILE *fp)
       }
    }
 #if USE_TEXTURE_CACHE
-   align_free(cache_ptr);
+   if (cache_ptr)
+      lp_build_format_cache_destroy(cache_ptr);
+   cache_ptr = NULL;
 #endif
 
    return success;
@@ -420,9 +432,121 @@ test_some(unsigned verbose, FILE *fp,
 }
 
 
+#define BENCH_BLOCKS 1024
+#define BENCH_PASSES 16
+
+
+/**
+ * Time fetching every texel of BENCH_BLOCKS blocks (each texel four times,
+ * like bilinear filtering would), and return the time per fetch in ns.
+ */
+PIPE_ALIGN_STACK
+static double
+bench_fetch(const struct util_format_description *desc,
+            const uint8_t *blocks, boolean use_cache)
+{
+   LLVMContextRef context;
+   struct gallivm_state *gallivm;
+   LLVMValueRef fetch;
+   fetch_ptr_t fetch_ptr;
+   uint8_t unpacked[4];
+   unsigned block_size = desc->block.bits / 8;
+   unsigned pass, b, i, j, k;
+   int64_t start, end;
+
+   context = LLVMContextCreate();
+   gallivm = gallivm_create("bench_module", context);
+
+   fetch = add_fetch_rgba_test(gallivm, 0, desc, lp_unorm8_vec4_type(),
+                               use_cache);
+
+   gallivm_compile_module(gallivm);
+
+   fetch_ptr = (fetch_ptr_t) gallivm_jit_function(gallivm, fetch);
+
+   gallivm_free_ir(gallivm);
+
+   if (use_cache)
+      lp_build_format_cache_clear(cache_ptr);
+
+   start = os_time_get_nano();
+   for (pass = 0; pass < BENCH_PASSES; ++pass) {
+      for (b = 0; b < BENCH_BLOCKS; ++b) {
+         const uint8_t *block = blocks + b * block_size;
+         for (i = 0; i < 4; ++i) {
+            for (j = 0; j < 4; ++j) {
+               for (k = 0; k < 4; ++k) {
+                  fetch_ptr(unpacked, block, j, i,
+                            use_cache ? cache_ptr : NULL);
+               }
+            }
+         }
+      }
+   }
+   end = os_time_get_nano();
+
+   gallivm_destroy(gallivm);
+   LLVMContextDispose(context);
+
+   return (double)(end - start) / (BENCH_PASSES * BENCH_BLOCKS * 16 * 4);
+}
+
+
+/**
+ * Benchmark the block cache against decoding each texel on its own, for all
+ * the formats which can use the cache.
+ */
 boolean
 test_single(unsigned verbose, FILE *fp)
 {
-   printf("no test_single()");
+   enum pipe_format format;
+   uint8_t *blocks;
+   unsigned i;
+
+   util_format_s3tc_init();
+
+   cache_ptr = lp_build_format_cache_create();
+   if (!cache_ptr) {
+      printf("texture cache disabled\n");
+      return TRUE;
+   }
+
+   blocks = align_malloc(BENCH_BLOCKS * 16, 16);
+   if (!blocks) {
+      lp_build_format_cache_destroy(cache_ptr);
+      return FALSE;
+   }
+
+   srand(0);
+   for (i = 0; i < BENCH_BLOCKS * 16; ++i) {
+      blocks[i] = rand() & 0xff;
+   }
+
+   for (format = 1; format < PIPE_FORMAT_COUNT; ++format) {
+      const struct util_format_description *desc;
+      double uncached, cached;
+
+      desc = util_format_description(format);
+      if (!desc || !lp_build_format_cache_supported(desc) ||
+          desc->colorspace == UTIL_FORMAT_COLORSPACE_SRGB) {
+         continue;
+      }
+
+      if (desc->layout == UTIL_FORMAT_LAYOUT_S3TC &&
+          !util_format_s3tc_enabled) {
+         continue;
+      }
+
+      uncached = bench_fetch(desc, blocks, FALSE);
+      cached = bench_fetch(desc, blocks, TRUE);
+
+      printf("%-32s uncached %7.2f ns/texel  cached %7.2f ns/texel\n",
+             desc->short_name, uncached, cached);
+   }
+
+   align_free(blocks);
+   lp_build_format_cache_destroy(cache_ptr);
+   cache_ptr = NULL;
+
    return TRUE;
 }
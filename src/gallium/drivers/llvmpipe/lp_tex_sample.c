@@ -44,6 +44,7 @@
 #include "pipe/p_shader_tokens.h"
 #include "gallivm/lp_bld_debug.h"
 #include "gallivm/lp_bld_const.h"
+#include "gallivm/lp_bld_format.h"
 #include "gallivm/lp_bld_type.h"
 #include "gallivm/lp_bld_sample.h"
 #include "gallivm/lp_bld_tgsi.h"
@@ -221,7 +222,6 @@ LP_LLVM_SAMPLER_MEMBER(lod_bias,   LP_JIT_SAMPLER_LOD_BIAS, TRUE)
 LP_LLVM_SAMPLER_MEMBER(border_color, LP_JIT_SAMPLER_BORDER_COLOR, FALSE)
 
 
-#if LP_USE_TEXTURE_CACHE
 static LLVMValueRef
 lp_llvm_texture_cache_ptr(const struct lp_sampler_dynamic_state *base,
                           struct gallivm_state *gallivm,
@@ -233,7 +233,6 @@ lp_llvm_texture_cache_ptr(const struct lp_sampler_dynamic_state *base,
 
    return lp_jit_thread_data_cache(gallivm, thread_data_ptr);
 }
-#endif
 
 
 static void
@@ -315,9 +314,9 @@ lp_llvm_sampler_soa_create(const struct lp_sampler_static_state *static_state)
    sampler->dynamic_state.base.lod_bias = lp_llvm_sampler_lod_bias;
    sampler->dynamic_state.base.border_color = lp_llvm_sampler_border_color;
 
-#if LP_USE_TEXTURE_CACHE
-   sampler->dynamic_state.base.cache_ptr = lp_llvm_texture_cache_ptr;
-#endif
+   /* Compressed textures are decoded through a per-thread block cache */
+   if (lp_build_format_cache_size)
+      sampler->dynamic_state.base.cache_ptr = lp_llvm_texture_cache_ptr;
 
    sampler->dynamic_state.static_state = static_state;
 
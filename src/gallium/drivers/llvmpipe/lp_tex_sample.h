@@ -34,11 +34,6 @@
 
 struct lp_sampler_static_state;
 
-/**
- * Whether texture cache is used for s3tc textures.
- */
-#define LP_USE_TEXTURE_CACHE 0
-
 /**
  * Pure-LLVM texture sampling code generator.
  *
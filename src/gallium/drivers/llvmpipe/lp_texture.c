@@ -310,6 +310,62 @@ llvmpipe_resource_create(struct pipe_screen *_screen,
    return llvmpipe_resource_create_front(_screen, templat, NULL);
 }
 
+
+/**
+ * Create a texture whose storage is the given user memory.
+ *
+ * The memory must follow the layout llvmpipe_texture_layout would pick
+ * (the caller can check the resulting stride with a transfer).  Only
+ * single-level, single-layer textures are supported, and since the
+ * rasterizer reads and writes whole LP_RASTER_BLOCK_SIZE blocks, the height
+ * must be a multiple of that.  Like our own allocations the memory must be
+ * 16-byte aligned, which is what the generated code assumes.
+ */
+static struct pipe_resource *
+llvmpipe_resource_from_user_memory(struct pipe_screen *_screen,
+                                   const struct pipe_resource *templat,
+                                   void *user_memory)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(_screen);
+   struct llvmpipe_resource *lpr;
+
+   if ((uintptr_t)user_memory & 15 ||
+       templat->last_level != 0 ||
+       templat->depth0 != 1 ||
+       templat->array_size != 1 ||
+       templat->height0 % LP_RASTER_BLOCK_SIZE != 0 ||
+       (templat->bind & (PIPE_BIND_DISPLAY_TARGET |
+                         PIPE_BIND_SCANOUT |
+                         PIPE_BIND_SHARED)))
+      return NULL;
+
+   lpr = CALLOC_STRUCT(llvmpipe_resource);
+   if (!lpr)
+      return NULL;
+
+   lpr->base = *templat;
+   pipe_reference_init(&lpr->base.reference, 1);
+   lpr->base.screen = &screen->base;
+
+   if (!llvmpipe_resource_is_texture(&lpr->base) ||
+       !llvmpipe_texture_layout(screen, lpr, false))
+      goto fail;
+
+   lpr->tex_data = user_memory;
+   lpr->userBuffer = TRUE;
+   lpr->id = id_counter++;
+
+#ifdef DEBUG
+   insert_at_tail(&resource_list, lpr);
+#endif
+
+   return &lpr->base;
+
+ fail:
+   FREE(lpr);
+   return NULL;
+}
+
 static void
 llvmpipe_resource_destroy(struct pipe_screen *pscreen,
                           struct pipe_resource *pt)
@@ -324,7 +380,7 @@ llvmpipe_resource_destroy(struct pipe_screen *pscreen,
    }
    else if (llvmpipe_resource_is_texture(pt)) {
       /* free linear image data */
-      if (lpr->tex_data) {
+      if (lpr->tex_data && !lpr->userBuffer) {
          align_free(lpr->tex_data);
          lpr->tex_data = NULL;
       }
@@ -804,6 +860,7 @@ llvmpipe_init_screen_resource_funcs(struct pipe_screen *screen)
 /*   screen->resource_create_front = llvmpipe_resource_create_front; */
    screen->resource_destroy = llvmpipe_resource_destroy;
    screen->resource_from_handle = llvmpipe_resource_from_handle;
+   screen->resource_from_user_memory = llvmpipe_resource_from_user_memory;
    screen->resource_get_handle = llvmpipe_resource_get_handle;
    screen->can_create_resource = llvmpipe_can_create_resource;
 }
@@ -194,6 +194,54 @@ softpipe_resource_create(struct pipe_screen *screen,
    return softpipe_resource_create_front(screen, templat, NULL);
 }
 
+/**
+ * Create a texture whose storage is the given user memory, which must
+ * follow the layout softpipe_resource_layout would pick.
+ */
+static struct pipe_resource *
+softpipe_resource_from_user_memory(struct pipe_screen *screen,
+                                   const struct pipe_resource *templat,
+                                   void *user_memory)
+{
+   struct softpipe_resource *spr;
+
+   if ((uintptr_t)user_memory & 15 || templat->target == PIPE_BUFFER)
+      return NULL;
+
+   /* only a single image can be described by the user's pointer */
+   if (templat->target != PIPE_BUFFER &&
+       (templat->last_level != 0 ||
+        templat->depth0 != 1 ||
+        templat->array_size != 1 ||
+        (templat->bind & (PIPE_BIND_DISPLAY_TARGET |
+                          PIPE_BIND_SCANOUT |
+                          PIPE_BIND_SHARED))))
+      return NULL;
+
+   spr = CALLOC_STRUCT(softpipe_resource);
+   if (!spr)
+      return NULL;
+
+   spr->base = *templat;
+   pipe_reference_init(&spr->base.reference, 1);
+   spr->base.screen = screen;
+
+   spr->pot = (util_is_power_of_two(templat->width0) &&
+               util_is_power_of_two(templat->height0) &&
+               util_is_power_of_two(templat->depth0));
+
+   if (!softpipe_resource_layout(screen, spr, FALSE)) {
+      FREE(spr);
+      return NULL;
+   }
+
+   spr->userBuffer = TRUE;
+   spr->data = user_memory;
+
+   return &spr->base;
+}
+
+
 static void
 softpipe_resource_destroy(struct pipe_screen *pscreen,
 			  struct pipe_resource *pt)
@@ -529,6 +577,7 @@ softpipe_init_screen_texture_funcs(struct pipe_screen *screen)
    screen->resource_create_front = softpipe_resource_create_front;
    screen->resource_destroy = softpipe_resource_destroy;
    screen->resource_from_handle = softpipe_resource_from_handle;
+   screen->resource_from_user_memory = softpipe_resource_from_user_memory;
    screen->resource_get_handle = softpipe_resource_get_handle;
    screen->can_create_resource = softpipe_can_create_resource;
 }
@@ -311,6 +311,14 @@ struct st_framebuffer_iface
     */
    const struct st_visual *visual;
 
+   /**
+    * Whether the rows of the textures are stored bottom to top, i.e. in
+    * OpenGL window coordinates, instead of top to bottom.  Changes are
+    * picked up when the framebuffer is validated, so the stamp should be
+    * bumped with them.
+    */
+   boolean y_0_bottom;
+
    /**
     * Flush the front buffer.
     *
@@ -411,6 +419,22 @@ struct st_context_iface
     */
    boolean (*get_resource_for_egl_image)(struct st_context_iface *stctxi,
                                          struct st_context_resource *stres);
+
+   /**
+    * Start a worker thread that executes the API calls, if the API has one.
+    * Called once the context is fully created.
+    *
+    * This function is optional.
+    */
+   void (*start_thread)(struct st_context_iface *stctxi);
+
+   /**
+    * Wait until the worker thread has executed all queued calls.  The
+    * frontend must call this before using the pipe context itself.
+    *
+    * This function is optional.
+    */
+   void (*thread_finish)(struct st_context_iface *stctxi);
 };
 
 
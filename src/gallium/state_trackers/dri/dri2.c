@@ -1222,6 +1222,9 @@ dri2_blit_image(__DRIcontext *context, __DRIimage *dst, __DRIimage *src,
    struct pipe_fence_handle *fence;
    struct pipe_blit_info blit;
 
+   if (ctx->st->thread_finish)
+      ctx->st->thread_finish(ctx->st);
+
    if (!dst || !src)
       return;
 
@@ -1271,6 +1274,9 @@ dri2_map_image(__DRIcontext *context, __DRIimage *image,
    if (!image || !data || *data)
       return NULL;
 
+   if (ctx->st->thread_finish)
+      ctx->st->thread_finish(ctx->st);
+
    if (flags & __DRI_IMAGE_TRANSFER_READ)
          pipe_access |= PIPE_TRANSFER_READ;
    if (flags & __DRI_IMAGE_TRANSFER_WRITE)
@@ -1293,6 +1299,9 @@ dri2_unmap_image(__DRIcontext *context, __DRIimage *image, void *data)
    struct dri_context *ctx = dri_context(context);
    struct pipe_context *pipe = ctx->st->pipe;
 
+   if (ctx->st->thread_finish)
+      ctx->st->thread_finish(ctx->st);
+
    pipe_transfer_unmap(pipe, (struct pipe_transfer *)data);
 }
 
@@ -1382,12 +1391,16 @@ struct dri2_fence {
 static void *
 dri2_create_fence(__DRIcontext *_ctx)
 {
-   struct pipe_context *ctx = dri_context(_ctx)->st->pipe;
+   struct st_context_iface *st = dri_context(_ctx)->st;
+   struct pipe_context *ctx = st->pipe;
    struct dri2_fence *fence = CALLOC_STRUCT(dri2_fence);
 
    if (!fence)
       return NULL;
 
+   if (st->thread_finish)
+      st->thread_finish(st);
+
    ctx->flush(ctx, &fence->pipe_fence, 0);
 
    if (!fence->pipe_fence) {
@@ -1528,6 +1541,10 @@ dri2_interop_export_object(__DRIcontext *_ctx,
    if (in->version == 0 || out->version == 0)
       return MESA_GLINTEROP_INVALID_VERSION;
 
+   /* The object may still be queued for creation on the GL thread. */
+   if (st->thread_finish)
+      st->thread_finish(st);
+
    /* Validate the target. */
    switch (in->target) {
    case GL_TEXTURE_BUFFER:
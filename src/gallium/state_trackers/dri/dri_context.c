@@ -38,6 +38,7 @@
 
 #include "pipe/p_context.h"
 #include "state_tracker/st_context.h"
+#include "util/debug.h"
 
 GLboolean
 dri_create_context(gl_api api, const struct gl_config * visual,
@@ -156,6 +157,15 @@ dri_create_context(gl_api api, const struct gl_config * visual,
       ctx->hud = hud_create(ctx->st->pipe, ctx->st->cso_context);
    }
 
+   /* Start the GL thread last, once nothing else uses the pipe context
+    * from this thread without finishing it first.
+    */
+   if (ctx->st->start_thread &&
+       env_var_as_boolean("MESA_GLTHREAD",
+                          driQueryOptionb(&screen->optionCache,
+                                          "mesa_glthread")))
+      ctx->st->start_thread(ctx->st);
+
    *error = __DRI_CTX_ERROR_SUCCESS;
    return GL_TRUE;
 
@@ -172,6 +182,10 @@ dri_destroy_context(__DRIcontext * cPriv)
 {
    struct dri_context *ctx = dri_context(cPriv);
 
+   /* The HUD and the postprocessor use the pipe context directly. */
+   if (ctx->st->thread_finish)
+      ctx->st->thread_finish(ctx->st);
+
    if (ctx->hud) {
       hud_destroy(ctx->hud);
    }
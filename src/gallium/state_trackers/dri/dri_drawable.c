@@ -462,6 +462,10 @@ dri_flush(__DRIcontext *cPriv,
       flags &= ~__DRI2_FLUSH_DRAWABLE;
    }
 
+   /* Everything below uses the pipe context from this thread. */
+   if (ctx->st->thread_finish)
+      ctx->st->thread_finish(ctx->st);
+
    /* Flush the drawable. */
    if ((flags & __DRI2_FLUSH_DRAWABLE) &&
        drawable->textures[ST_ATTACHMENT_BACK_LEFT]) {
@@ -75,6 +75,7 @@ const __DRIconfigOptionsExtension gallium_config_options = {
       DRI_CONF_SECTION_MISCELLANEOUS
          DRI_CONF_ALWAYS_HAVE_DEPTH_BUFFER("false")
          DRI_CONF_GLSL_ZERO_INIT("false")
+         DRI_CONF_MESA_GLTHREAD("false")
       DRI_CONF_SECTION_END
    DRI_CONF_END
 };
@@ -31,16 +31,20 @@
  * Otherwise we use softpipe.  The GALLIUM_DRIVER environment variable
  * may be set to "softpipe" or "llvmpipe" to override.
  *
- * With softpipe we could render directly into the user's buffer by using a
- * display target resource.  However, softpipe doesn't support "upside-down"
- * rendering which would be needed for the OSMESA_Y_UP=TRUE case.
+ * We render in the orientation of the user's buffer: with OSMESA_Y_UP=TRUE
+ * (the default) the framebuffer tells the state tracker that its rows are
+ * stored bottom to top, so it renders without inverting Y, like for FBOs.
  *
- * With llvmpipe we could only render directly into the user's buffer when its
- * width and height is a multiple of the tile size (64 pixels).
+ * When the driver implements pipe_screen::resource_from_user_memory we try
+ * to render directly into the user's buffer by wrapping it as the storage
+ * of the color resource.  That's only possible when the buffer's layout
+ * matches the one the driver would pick itself (the driver rejects the
+ * memory otherwise, e.g. llvmpipe wants 16-byte aligned memory and a height
+ * that's a multiple of 4, and we check the resulting row stride).
  *
- * Because of these constraints we always render into ordinary resources then
- * copy the results to the user's buffer in the flush_front() function which
- * is called when the app calls glFlush/Finish.
+ * Otherwise we render into ordinary resources then copy the results to the
+ * user's buffer in the flush_front() function which is called when the app
+ * calls glFlush/Finish.
  *
  * In general, the OSMesa interface is pretty ugly and not a good match
  * for Gallium.  But we're interested in doing the best we can to preserve
@@ -62,6 +66,7 @@
 #include "util/u_box.h"
 #include "util/u_debug.h"
 #include "util/u_format.h"
+#include "util/u_inlines.h"
 #include "util/u_memory.h"
 
 #include "postprocess/filters.h"
@@ -77,6 +82,22 @@ osmesa_create_screen(void);
 
 
 
+/**
+ * One of the user's buffers set up with OSMesaMakeCurrentRing().
+ */
+struct osmesa_ring_slot
+{
+   void *map;
+
+   /** The color resource used while rendering to this buffer */
+   struct pipe_resource *color;
+   boolean user_memory;
+
+   /** The last frame rendered to this buffer, if still alive */
+   struct osmesa_fence *fence;
+};
+
+
 struct osmesa_buffer
 {
    struct st_framebuffer_iface *stfb;
@@ -86,11 +107,47 @@ struct osmesa_buffer
    struct pipe_resource *textures[ST_ATTACHMENT_COUNT];
 
    void *map;
+   unsigned stride;   /**< row stride of the user's buffer, in bytes */
+
+   /** Is the color resource rendering directly into map? */
+   boolean user_memory;
+
+   /**
+    * Buffer ring, see OSMesaMakeCurrentRing().  In that case the resources
+    * are kept across validations: one color resource per buffer, and the
+    * other attachments in ring_textures.
+    */
+   struct osmesa_ring_slot *ring;
+   unsigned ring_count;
+   unsigned ring_current;
+   struct pipe_resource *ring_textures[ST_ATTACHMENT_COUNT];
 
    struct osmesa_buffer *next;  /**< next in linked list */
 };
 
 
+/**
+ * A frame handed over with OSMesaSwapBuffersAsync().
+ */
+struct osmesa_fence
+{
+   struct osmesa_context *osmesa;
+
+   /** The ring buffer this frame was rendered to, NULL once it's reused */
+   struct osmesa_ring_slot *slot;
+
+   struct pipe_fence_handle *fence;
+
+   /** The resource to copy the image from, NULL if already in the buffer */
+   struct pipe_resource *color;
+
+   void *map;
+   unsigned stride;
+
+   boolean done;
+};
+
+
 struct osmesa_context
 {
    struct st_context_iface *stctx;
@@ -299,6 +356,71 @@ stfbi_to_osbuffer(struct st_framebuffer_iface *stfbi)
 }
 
 
+/**
+ * Run the postprocess stage(s), if any, on the given color resource.
+ */
+static void
+osmesa_run_pp(OSMesaContext osmesa, struct osmesa_buffer *osbuffer,
+              struct pipe_resource *res)
+{
+   struct pipe_resource *zsbuf = NULL;
+   unsigned i;
+
+   if (!osmesa->pp)
+      return;
+
+   /* Find the z/stencil buffer if there is one */
+   for (i = 0; i < ARRAY_SIZE(osbuffer->textures); i++) {
+      struct pipe_resource *res = osbuffer->textures[i];
+      if (res) {
+         const struct util_format_description *desc =
+            util_format_description(res->format);
+
+         if (util_format_has_depth(desc)) {
+            zsbuf = res;
+            break;
+         }
+      }
+   }
+
+   pp_run(osmesa->pp, res, res, zsbuf);
+}
+
+
+/**
+ * Copy the color buffer from the resource to the user's buffer.  The
+ * resource is already in the orientation of the user's buffer.
+ */
+static void
+osmesa_copy_to_user(struct pipe_context *pipe, struct pipe_resource *res,
+                    unsigned usage, void *user_map, unsigned user_stride)
+{
+   struct pipe_transfer *transfer = NULL;
+   struct pipe_box box;
+   void *map;
+   ubyte *src, *dst;
+   unsigned y, bytes;
+
+   u_box_2d(0, 0, res->width0, res->height0, &box);
+
+   map = pipe->transfer_map(pipe, res, 0, usage, &box, &transfer);
+   if (!map)
+      return;
+
+   src = map;
+   dst = user_map;
+   bytes = util_format_get_stride(res->format, res->width0);
+
+   for (y = 0; y < res->height0; y++) {
+      memcpy(dst, src, bytes);
+      dst += user_stride;
+      src += transfer->stride;
+   }
+
+   pipe->transfer_unmap(pipe, transfer);
+}
+
+
 /**
  * Called via glFlush/glFinish.  This is where we copy the contents
  * of the driver's color buffer into the user-specified buffer.
@@ -312,67 +434,90 @@ osmesa_st_framebuffer_flush_front(struct st_context_iface *stctx,
    struct osmesa_buffer *osbuffer = stfbi_to_osbuffer(stfbi);
    struct pipe_context *pipe = stctx->pipe;
    struct pipe_resource *res = osbuffer->textures[statt];
-   struct pipe_transfer *transfer = NULL;
-   struct pipe_box box;
-   void *map;
-   ubyte *src, *dst;
-   unsigned y, bytes, bpp;
-   int dst_stride;
 
-   if (osmesa->pp) {
-      struct pipe_resource *zsbuf = NULL;
-      unsigned i;
+   osmesa_run_pp(osmesa, osbuffer, res);
 
-      /* Find the z/stencil buffer if there is one */
-      for (i = 0; i < ARRAY_SIZE(osbuffer->textures); i++) {
-         struct pipe_resource *res = osbuffer->textures[i];
-         if (res) {
-            const struct util_format_description *desc =
-               util_format_description(res->format);
+   if (statt == ST_ATTACHMENT_FRONT_LEFT && osbuffer->user_memory) {
+      /*
+       * We rendered directly into the user's buffer, just make sure
+       * rendering is complete before the app looks at it.
+       */
+      struct pipe_screen *screen = pipe->screen;
+      struct pipe_fence_handle *fence = NULL;
 
-            if (util_format_has_depth(desc)) {
-               zsbuf = res;
-               break;
-            }
-         }
+      pipe->flush(pipe, &fence, 0);
+      if (fence) {
+         screen->fence_finish(screen, NULL, fence, PIPE_TIMEOUT_INFINITE);
+         screen->fence_reference(screen, &fence, NULL);
       }
-
-      /* run the postprocess stage(s) */
-      pp_run(osmesa->pp, res, res, zsbuf);
+      return TRUE;
    }
 
-   u_box_2d(0, 0, res->width0, res->height0, &box);
+   osmesa_copy_to_user(pipe, res, PIPE_TRANSFER_READ,
+                       osbuffer->map, osbuffer->stride);
+
+   return TRUE;
+}
+
+
+/**
+ * Can the color resource of the buffer use the user's buffer as storage?
+ * The driver may still reject it, see osmesa_wrap_user_buffer().
+ */
+static boolean
+osmesa_can_wrap_user_buffer(const struct osmesa_buffer *osbuffer)
+{
+   struct pipe_screen *screen = get_st_manager()->screen;
+
+   return screen->resource_from_user_memory != NULL;
+}
+
 
-   map = pipe->transfer_map(pipe, res, 0, PIPE_TRANSFER_READ, &box,
-                            &transfer);
+/**
+ * Try to create a color resource which renders directly into the user's
+ * buffer.  Returns NULL if the driver can't do that for this buffer.
+ */
+static struct pipe_resource *
+osmesa_wrap_user_buffer(struct pipe_context *pipe,
+                        const struct osmesa_buffer *osbuffer,
+                        void *user_map,
+                        const struct pipe_resource *templat)
+{
+   struct pipe_screen *screen = pipe->screen;
+   struct pipe_resource *res;
+   struct pipe_transfer *transfer = NULL;
+   struct pipe_box box;
+   void *map;
+
+   if (!osmesa_can_wrap_user_buffer(osbuffer))
+      return NULL;
+
+   res = screen->resource_from_user_memory(screen, templat, user_map);
+   if (!res)
+      return NULL;
 
    /*
-    * Copy the color buffer from the resource to the user's buffer.
+    * The driver lays the image out as it likes, check that this matches
+    * the row length the user gave us.
     */
-   bpp = util_format_get_blocksize(osbuffer->visual.color_format);
-   src = map;
-   dst = osbuffer->map;
-   if (osmesa->user_row_length)
-      dst_stride = bpp * osmesa->user_row_length;
-   else
-      dst_stride = bpp * osbuffer->width;
-   bytes = bpp * res->width0;
-
-   if (osmesa->y_up) {
-      /* need to flip image upside down */
-      dst = dst + (res->height0 - 1) * dst_stride;
-      dst_stride = -dst_stride;
+   u_box_2d(0, 0, res->width0, res->height0, &box);
+   map = pipe->transfer_map(pipe, res, 0,
+                            PIPE_TRANSFER_READ | PIPE_TRANSFER_UNSYNCHRONIZED,
+                            &box, &transfer);
+   if (!map) {
+      pipe_resource_reference(&res, NULL);
+      return NULL;
    }
 
-   for (y = 0; y < res->height0; y++) {
-      memcpy(dst, src, bytes);
-      dst += dst_stride;
-      src += transfer->stride;
+   if (map != user_map || transfer->stride != osbuffer->stride) {
+      pipe->transfer_unmap(pipe, transfer);
+      pipe_resource_reference(&res, NULL);
+      return NULL;
    }
 
    pipe->transfer_unmap(pipe, transfer);
 
-   return TRUE;
+   return res;
 }
 
 
@@ -432,6 +577,45 @@ osmesa_st_framebuffer_validate(struct st_context_iface *stctx,
 
       templat.format = format;
       templat.bind = bind;
+
+      if (osbuffer->ring) {
+         struct pipe_resource **res;
+
+         if (statts[i] == ST_ATTACHMENT_FRONT_LEFT) {
+            struct osmesa_ring_slot *slot =
+               &osbuffer->ring[osbuffer->ring_current];
+
+            if (!slot->color) {
+               slot->color = osmesa_wrap_user_buffer(stctx->pipe, osbuffer,
+                                                     slot->map, &templat);
+               slot->user_memory = slot->color != NULL;
+            }
+            osbuffer->user_memory = slot->user_memory;
+            res = &slot->color;
+         }
+         else {
+            res = &osbuffer->ring_textures[statts[i]];
+         }
+
+         if (!*res)
+            *res = screen->resource_create(screen, &templat);
+
+         out[i] = NULL;
+         pipe_resource_reference(&out[i], *res);
+         osbuffer->textures[statts[i]] = *res;
+         continue;
+      }
+
+      if (statts[i] == ST_ATTACHMENT_FRONT_LEFT) {
+         out[i] = osmesa_wrap_user_buffer(stctx->pipe, osbuffer,
+                                          osbuffer->map, &templat);
+         osbuffer->user_memory = out[i] != NULL;
+         if (out[i]) {
+            osbuffer->textures[statts[i]] = out[i];
+            continue;
+         }
+      }
+
       out[i] = osbuffer->textures[statts[i]] =
          screen->resource_create(screen, &templat);
    }
@@ -505,6 +689,126 @@ osmesa_find_buffer(enum pipe_format color_format,
 }
 
 
+/**
+ * Update the user's buffer pointer and layout for the buffer.  If we're
+ * rendering into the user's buffer, or could start doing so now, the
+ * resources have to be recreated.
+ */
+static void
+osmesa_set_buffer_layout(struct osmesa_buffer *osbuffer, void *map,
+                         unsigned stride, boolean y_up)
+{
+   if (osbuffer->map == map &&
+       osbuffer->stride == stride &&
+       osbuffer->stfb->y_0_bottom == y_up)
+      return;
+
+   if (osbuffer->stfb->y_0_bottom != y_up) {
+      /* The state tracker picks the new orientation up on validation */
+      osbuffer->stfb->y_0_bottom = y_up;
+      p_atomic_inc(&osbuffer->stfb->stamp);
+   }
+
+   if (osbuffer->ring && osbuffer->stride != stride) {
+      /* Whether and how the color resources use the buffers changed */
+      unsigned i;
+
+      for (i = 0; i < osbuffer->ring_count; i++) {
+         pipe_resource_reference(&osbuffer->ring[i].color, NULL);
+         osbuffer->ring[i].user_memory = FALSE;
+      }
+   }
+
+   osbuffer->map = map;
+   osbuffer->stride = stride;
+
+   if (osbuffer->ring || osbuffer->user_memory ||
+       osmesa_can_wrap_user_buffer(osbuffer))
+      p_atomic_inc(&osbuffer->stfb->stamp);
+}
+
+
+/**
+ * Stop using the buffer ring set up with OSMesaMakeCurrentRing().
+ * Outstanding fences stay valid.
+ */
+static void
+osmesa_release_ring(struct osmesa_buffer *osbuffer)
+{
+   unsigned i;
+
+   if (!osbuffer->ring)
+      return;
+
+   for (i = 0; i < osbuffer->ring_count; i++) {
+      struct osmesa_ring_slot *slot = &osbuffer->ring[i];
+
+      if (slot->fence)
+         slot->fence->slot = NULL;
+      pipe_resource_reference(&slot->color, NULL);
+   }
+
+   for (i = 0; i < ARRAY_SIZE(osbuffer->ring_textures); i++)
+      pipe_resource_reference(&osbuffer->ring_textures[i], NULL);
+
+   FREE(osbuffer->ring);
+   osbuffer->ring = NULL;
+   osbuffer->ring_count = 0;
+   osbuffer->ring_current = 0;
+   osbuffer->user_memory = FALSE;
+
+   p_atomic_inc(&osbuffer->stfb->stamp);
+}
+
+
+/**
+ * Wait for the frame of the fence to complete and make sure the image
+ * is in the user's buffer.
+ */
+static boolean
+osmesa_fence_finish(struct osmesa_fence *fence, uint64_t timeout)
+{
+   struct pipe_screen *screen = get_st_manager()->screen;
+
+   if (fence->done)
+      return TRUE;
+
+   if (fence->fence &&
+       !screen->fence_finish(screen, NULL, fence->fence, timeout))
+      return FALSE;
+
+   if (fence->color) {
+      /* If the rendering is complete there's no need to synchronize */
+      unsigned usage = PIPE_TRANSFER_READ;
+      if (fence->fence)
+         usage |= PIPE_TRANSFER_UNSYNCHRONIZED;
+
+      osmesa_copy_to_user(fence->osmesa->stctx->pipe, fence->color, usage,
+                          fence->map, fence->stride);
+      pipe_resource_reference(&fence->color, NULL);
+   }
+
+   fence->done = TRUE;
+   return TRUE;
+}
+
+
+/**
+ * Return the row stride of the user's buffer, in bytes.
+ */
+static unsigned
+osmesa_user_stride(const struct osmesa_context *osmesa,
+                   const struct osmesa_buffer *osbuffer)
+{
+   unsigned bpp = util_format_get_blocksize(osbuffer->visual.color_format);
+
+   if (osmesa->user_row_length)
+      return bpp * osmesa->user_row_length;
+   else
+      return bpp * osbuffer->width;
+}
+
+
 static void
 osmesa_destroy_buffer(struct osmesa_buffer *osbuffer)
 {
@@ -774,9 +1078,13 @@ OSMesaMakeCurrent(OSMesaContext osmesa, void *buffer, GLenum type,
                                       osmesa->accum_format);
    }
 
+   osmesa_release_ring(osbuffer);
+
    osbuffer->width = width;
    osbuffer->height = height;
-   osbuffer->map = buffer;
+   osmesa_set_buffer_layout(osbuffer, buffer,
+                            osmesa_user_stride(osmesa, osbuffer),
+                            osmesa->y_up);
 
    /* XXX unused for now */
    (void) osmesa_destroy_buffer;
@@ -814,6 +1122,145 @@ OSMesaMakeCurrent(OSMesaContext osmesa, void *buffer, GLenum type,
 
 
 
+/**
+ * Bind an OSMesaContext to a ring of image buffers, see osmesa.h.
+ */
+GLAPI GLboolean GLAPIENTRY
+OSMesaMakeCurrentRing(OSMesaContext osmesa, void *const *buffers,
+                      GLsizei count, GLenum type,
+                      GLsizei width, GLsizei height)
+{
+   struct osmesa_buffer *osbuffer;
+   struct osmesa_ring_slot *ring;
+   GLsizei i;
+
+   if (!buffers || count < 1) {
+      return GL_FALSE;
+   }
+
+   for (i = 0; i < count; i++) {
+      if (!buffers[i])
+         return GL_FALSE;
+   }
+
+   ring = CALLOC(count, sizeof(*ring));
+   if (!ring) {
+      return GL_FALSE;
+   }
+
+   if (!OSMesaMakeCurrent(osmesa, buffers[0], type, width, height)) {
+      FREE(ring);
+      return GL_FALSE;
+   }
+
+   for (i = 0; i < count; i++)
+      ring[i].map = buffers[i];
+
+   osbuffer = osmesa->current_buffer;
+   osbuffer->ring = ring;
+   osbuffer->ring_count = count;
+   osbuffer->ring_current = 0;
+   p_atomic_inc(&osbuffer->stfb->stamp);
+
+   return GL_TRUE;
+}
+
+
+/**
+ * Flush the current frame of the ring and move on to the next buffer,
+ * see osmesa.h.
+ */
+GLAPI OSMesaFence GLAPIENTRY
+OSMesaSwapBuffersAsync(OSMesaContext osmesa, void **buffer)
+{
+   struct osmesa_buffer *osbuffer = osmesa ? osmesa->current_buffer : NULL;
+   struct osmesa_ring_slot *slot, *next;
+   struct osmesa_fence *fence;
+
+   if (!osbuffer || !osbuffer->ring || osmesa != OSMesaGetCurrentContext()) {
+      return NULL;
+   }
+
+   fence = CALLOC_STRUCT(osmesa_fence);
+   if (!fence) {
+      return NULL;
+   }
+
+   slot = &osbuffer->ring[osbuffer->ring_current];
+
+   if (slot->color)
+      osmesa_run_pp(osmesa, osbuffer, slot->color);
+
+   /* Unlike glFlush this doesn't go through flush_front() */
+   osmesa->stctx->flush(osmesa->stctx, ST_FLUSH_END_OF_FRAME, &fence->fence);
+
+   fence->osmesa = osmesa;
+   fence->map = slot->map;
+   fence->stride = osbuffer->stride;
+   if (slot->color && !slot->user_memory)
+      pipe_resource_reference(&fence->color, slot->color);
+
+   if (slot->fence)
+      slot->fence->slot = NULL;
+   slot->fence = fence;
+   fence->slot = slot;
+
+   if (buffer)
+      *buffer = slot->map;
+
+   /*
+    * Move on to the next buffer.  The image of the previous frame rendered
+    * with it has to be stored before we start rendering to it again.
+    */
+   osbuffer->ring_current = (osbuffer->ring_current + 1) %
+                            osbuffer->ring_count;
+   next = &osbuffer->ring[osbuffer->ring_current];
+   if (next->fence) {
+      osmesa_fence_finish(next->fence, PIPE_TIMEOUT_INFINITE);
+      next->fence->slot = NULL;
+      next->fence = NULL;
+   }
+
+   osbuffer->map = next->map;
+   p_atomic_inc(&osbuffer->stfb->stamp);
+
+   return fence;
+}
+
+
+/**
+ * Wait for the image of a frame to be stored in its buffer, see osmesa.h.
+ */
+GLAPI GLboolean GLAPIENTRY
+OSMesaClientWaitFence(OSMesaFence fence, GLuint64 timeout)
+{
+   if (!fence) {
+      return GL_FALSE;
+   }
+
+   return osmesa_fence_finish(fence, timeout) ? GL_TRUE : GL_FALSE;
+}
+
+
+GLAPI void GLAPIENTRY
+OSMesaDestroyFence(OSMesaFence fence)
+{
+   struct pipe_screen *screen = get_st_manager()->screen;
+
+   if (!fence) {
+      return;
+   }
+
+   if (fence->slot)
+      fence->slot->fence = NULL;
+
+   pipe_resource_reference(&fence->color, NULL);
+   screen->fence_reference(screen, &fence->fence, NULL);
+   FREE(fence);
+}
+
+
+
 GLAPI OSMesaContext GLAPIENTRY
 OSMesaGetCurrentContext(void)
 {
@@ -840,6 +1287,13 @@ OSMesaPixelStore(GLint pname, GLint value)
       fprintf(stderr, "Invalid pname in OSMesaPixelStore()\n");
       return;
    }
+
+   if (osmesa->current_buffer) {
+      struct osmesa_buffer *osbuffer = osmesa->current_buffer;
+      osmesa_set_buffer_layout(osbuffer, osbuffer->map,
+                               osmesa_user_stride(osmesa, osbuffer),
+                               osmesa->y_up);
+   }
 }
 
 
@@ -982,6 +1436,10 @@ static struct name_function functions[] = {
    { "OSMesaGetProcAddress", (OSMESAproc) OSMesaGetProcAddress },
    { "OSMesaColorClamp", (OSMESAproc) OSMesaColorClamp },
    { "OSMesaPostprocess", (OSMESAproc) OSMesaPostprocess },
+   { "OSMesaMakeCurrentRing", (OSMESAproc) OSMesaMakeCurrentRing },
+   { "OSMesaSwapBuffersAsync", (OSMESAproc) OSMesaSwapBuffersAsync },
+   { "OSMesaClientWaitFence", (OSMESAproc) OSMesaClientWaitFence },
+   { "OSMesaDestroyFence", (OSMESAproc) OSMesaDestroyFence },
    { NULL, NULL }
 };
 
@@ -0,0 +1,316 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Measures how many draw calls per second the state tracker sustains when
+ * a single binding changes between draws:
+ *
+ *    osmesa_draw_bench [-n draws]
+ *
+ * Each test draws a degenerate triangle, so the time is spent in state
+ * validation rather than rasterization.  The tests are:
+ *
+ *    none     nothing changes between draws
+ *    texture  one of the texture units used by the shader is rebound
+ *    ubo      one of the uniform buffer bindings used by the shader is
+ *             rebound
+ *    vbo      one of the vertex attribute arrays is pointed at another
+ *             buffer
+ */
+
+#define GL_GLEXT_PROTOTYPES
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "GL/osmesa.h"
+#include "GL/gl.h"
+#include "GL/glext.h"
+#include "util/macros.h"
+#include "util/u_timer.h"
+
+#define WIDTH 64
+#define HEIGHT 64
+
+#define MAX_UNITS 16
+#define NUM_UBOS 8
+#define NUM_ATTRIBS 8
+
+enum test {
+   TEST_NONE,
+   TEST_TEXTURE,
+   TEST_UBO,
+   TEST_VBO,
+};
+
+static const char *test_names[] = {
+   "none",
+   "texture",
+   "ubo",
+   "vbo",
+};
+
+static GLuint textures[2][MAX_UNITS];
+static GLuint ubos[2][NUM_UBOS];
+static GLuint vbos[2][NUM_ATTRIBS];
+static unsigned num_units;
+
+static GLuint
+compile_shader(GLenum type, const char *source)
+{
+   GLuint shader = glCreateShader(type);
+   GLint status;
+
+   glShaderSource(shader, 1, &source, NULL);
+   glCompileShader(shader);
+   glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+   if (!status) {
+      char log[1024];
+
+      glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+      fprintf(stderr, "failed to compile shader:\n%s\n%s\n", source, log);
+      exit(1);
+   }
+   return shader;
+}
+
+/* All the textures, uniform blocks and attributes are used, so that the
+ * state tracker has to bind them all.
+ */
+static GLuint
+create_program(void)
+{
+   char vs[2048], fs[4096];
+   unsigned i, vs_len, fs_len;
+   GLuint prog;
+   GLint status;
+
+   vs_len = snprintf(vs, sizeof(vs), "#version 130\n");
+   for (i = 0; i < NUM_ATTRIBS; i++)
+      vs_len += snprintf(vs + vs_len, sizeof(vs) - vs_len,
+                         "in vec4 attr%u;\n", i);
+   vs_len += snprintf(vs + vs_len, sizeof(vs) - vs_len,
+                      "void main()\n{\n   gl_Position = vec4(0.0)");
+   for (i = 0; i < NUM_ATTRIBS; i++)
+      vs_len += snprintf(vs + vs_len, sizeof(vs) - vs_len, " + attr%u", i);
+   snprintf(vs + vs_len, sizeof(vs) - vs_len, ";\n}\n");
+
+   fs_len = snprintf(fs, sizeof(fs),
+                     "#version 130\n"
+                     "#extension GL_ARB_uniform_buffer_object : require\n");
+   for (i = 0; i < num_units; i++)
+      fs_len += snprintf(fs + fs_len, sizeof(fs) - fs_len,
+                         "uniform sampler2D tex%u;\n", i);
+   for (i = 0; i < NUM_UBOS; i++)
+      fs_len += snprintf(fs + fs_len, sizeof(fs) - fs_len,
+                         "uniform block%u { vec4 color%u; };\n", i, i);
+   fs_len += snprintf(fs + fs_len, sizeof(fs) - fs_len,
+                      "void main()\n{\n   gl_FragColor = vec4(0.0)");
+   for (i = 0; i < num_units; i++)
+      fs_len += snprintf(fs + fs_len, sizeof(fs) - fs_len,
+                         " + texture(tex%u, vec2(0.5))", i);
+   for (i = 0; i < NUM_UBOS; i++)
+      fs_len += snprintf(fs + fs_len, sizeof(fs) - fs_len, " + color%u", i);
+   snprintf(fs + fs_len, sizeof(fs) - fs_len, ";\n}\n");
+
+   prog = glCreateProgram();
+   glAttachShader(prog, compile_shader(GL_VERTEX_SHADER, vs));
+   glAttachShader(prog, compile_shader(GL_FRAGMENT_SHADER, fs));
+   for (i = 0; i < NUM_ATTRIBS; i++) {
+      char name[16];
+
+      snprintf(name, sizeof(name), "attr%u", i);
+      glBindAttribLocation(prog, i, name);
+   }
+   glLinkProgram(prog);
+   glGetProgramiv(prog, GL_LINK_STATUS, &status);
+   if (!status) {
+      char log[1024];
+
+      glGetProgramInfoLog(prog, sizeof(log), NULL, log);
+      fprintf(stderr, "failed to link program:\n%s\n", log);
+      exit(1);
+   }
+   glUseProgram(prog);
+
+   for (i = 0; i < num_units; i++) {
+      char name[16];
+
+      snprintf(name, sizeof(name), "tex%u", i);
+      glUniform1i(glGetUniformLocation(prog, name), i);
+   }
+   for (i = 0; i < NUM_UBOS; i++) {
+      char name[16];
+
+      snprintf(name, sizeof(name), "block%u", i);
+      glUniformBlockBinding(prog, glGetUniformBlockIndex(prog, name), i);
+   }
+
+   return prog;
+}
+
+static void
+create_objects(void)
+{
+   static const GLubyte texel[4] = { 0x10, 0x20, 0x30, 0x40 };
+   static const GLfloat zero[3 * 4];
+   unsigned i, j;
+
+   glGenTextures(2 * MAX_UNITS, &textures[0][0]);
+   glGenBuffers(2 * NUM_UBOS, &ubos[0][0]);
+   glGenBuffers(2 * NUM_ATTRIBS, &vbos[0][0]);
+
+   for (i = 0; i < 2; i++) {
+      for (j = 0; j < num_units; j++) {
+         glBindTexture(GL_TEXTURE_2D, textures[i][j]);
+         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA,
+                      GL_UNSIGNED_BYTE, texel);
+      }
+      for (j = 0; j < NUM_UBOS; j++) {
+         glBindBuffer(GL_UNIFORM_BUFFER, ubos[i][j]);
+         glBufferData(GL_UNIFORM_BUFFER, 4 * sizeof(GLfloat), zero,
+                      GL_STATIC_DRAW);
+      }
+      for (j = 0; j < NUM_ATTRIBS; j++) {
+         glBindBuffer(GL_ARRAY_BUFFER, vbos[i][j]);
+         glBufferData(GL_ARRAY_BUFFER, sizeof(zero), zero, GL_STATIC_DRAW);
+      }
+   }
+
+   for (i = 0; i < num_units; i++) {
+      glActiveTexture(GL_TEXTURE0 + i);
+      glBindTexture(GL_TEXTURE_2D, textures[0][i]);
+   }
+   for (i = 0; i < NUM_UBOS; i++)
+      glBindBufferBase(GL_UNIFORM_BUFFER, i, ubos[0][i]);
+   for (i = 0; i < NUM_ATTRIBS; i++) {
+      glBindBuffer(GL_ARRAY_BUFFER, vbos[0][i]);
+      glVertexAttribPointer(i, 3, GL_FLOAT, GL_FALSE, 0, NULL);
+      glEnableVertexAttribArray(i);
+   }
+}
+
+/* Change one binding, a different one every time.  Each slot switches
+ * between the two sets of objects whenever it is visited.
+ */
+static void
+change_binding(enum test test, unsigned draw)
+{
+   unsigned slot, set;
+
+   switch (test) {
+   case TEST_NONE:
+      break;
+   case TEST_TEXTURE:
+      slot = draw % num_units;
+      set = (draw / num_units + 1) & 1;
+      glActiveTexture(GL_TEXTURE0 + slot);
+      glBindTexture(GL_TEXTURE_2D, textures[set][slot]);
+      break;
+   case TEST_UBO:
+      slot = draw % NUM_UBOS;
+      set = (draw / NUM_UBOS + 1) & 1;
+      glBindBufferBase(GL_UNIFORM_BUFFER, slot, ubos[set][slot]);
+      break;
+   case TEST_VBO:
+      slot = draw % NUM_ATTRIBS;
+      set = (draw / NUM_ATTRIBS + 1) & 1;
+      glBindBuffer(GL_ARRAY_BUFFER, vbos[set][slot]);
+      glVertexAttribPointer(slot, 3, GL_FLOAT, GL_FALSE, 0, NULL);
+      break;
+   }
+}
+
+int
+main(int argc, char **argv)
+{
+   static const int attribs[] = {
+      OSMESA_FORMAT, OSMESA_RGBA,
+      OSMESA_DEPTH_BITS, 0,
+      OSMESA_PROFILE, OSMESA_COMPAT_PROFILE,
+      OSMESA_CONTEXT_MAJOR_VERSION, 3,
+      0
+   };
+   unsigned num_draws = 100000;
+   OSMesaContext ctx;
+   void *buffer;
+   GLint max_units;
+   unsigned i, test;
+
+   for (i = 1; i < argc; i++) {
+      if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+         num_draws = strtoul(argv[++i], NULL, 0);
+      }
+      else {
+         fprintf(stderr, "usage: %s [-n draws]\n", argv[0]);
+         return 1;
+      }
+   }
+
+   ctx = OSMesaCreateContextAttribs(attribs, NULL);
+   buffer = malloc(WIDTH * HEIGHT * 4);
+   if (!ctx || !buffer ||
+       !OSMesaMakeCurrent(ctx, buffer, GL_UNSIGNED_BYTE, WIDTH, HEIGHT)) {
+      fprintf(stderr, "failed to create an OSMesa context\n");
+      return 1;
+   }
+
+   glGetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS, &max_units);
+   num_units = max_units < MAX_UNITS ? max_units : MAX_UNITS;
+
+   printf("%s, %u texture units, %u uniform blocks, %u attributes\n",
+          (const char *) glGetString(GL_RENDERER), num_units, NUM_UBOS,
+          NUM_ATTRIBS);
+
+   create_program();
+   create_objects();
+
+   for (test = 0; test < ARRAY_SIZE(test_names); test++) {
+      int64_t start;
+      double secs;
+
+      /* Warm up, so that shader variants and samplers are created. */
+      for (i = 0; i < 256; i++) {
+         change_binding(test, i);
+         glDrawArrays(GL_TRIANGLES, 0, 3);
+      }
+      glFinish();
+
+      start = util_timer_get_nano();
+      for (i = 0; i < num_draws; i++) {
+         change_binding(test, i);
+         glDrawArrays(GL_TRIANGLES, 0, 3);
+      }
+      glFinish();
+      secs = (util_timer_get_nano() - start) / 1e9;
+
+      printf("%-8s %10.0f draws/s\n", test_names[test], num_draws / secs);
+   }
+
+   OSMesaDestroyContext(ctx);
+   free(buffer);
+   return 0;
+}
@@ -0,0 +1,149 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Checks that the image ends up in the user's buffer in the orientation
+ * given by OSMESA_Y_UP, both for the default (TRUE, first row of the buffer
+ * is the bottom of the image) and after switching it to FALSE.
+ *
+ * The bottom half of the window is drawn red over a green clear.  This is
+ * done with a 16-byte aligned buffer, which the driver may render into
+ * directly, and with a misaligned one, which it can't, so the results are
+ * copied to it on glFinish.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "GL/osmesa.h"
+#include "GL/gl.h"
+
+#define WIDTH 32
+#define HEIGHT 16
+
+static const GLubyte red[4] = { 0xff, 0x00, 0x00, 0xff };
+static const GLubyte green[4] = { 0x00, 0xff, 0x00, 0xff };
+
+static void
+draw(void)
+{
+   glClearColor(0.0, 1.0, 0.0, 1.0);
+   glClear(GL_COLOR_BUFFER_BIT);
+   glColor4f(1.0, 0.0, 0.0, 1.0);
+   glRectf(-1.0, -1.0, 1.0, 0.0);
+   glFinish();
+}
+
+static bool
+check_row(const char *name, const GLubyte *buffer, unsigned row,
+          const GLubyte *expected)
+{
+   unsigned x;
+
+   for (x = 0; x < WIDTH; x++) {
+      const GLubyte *p = buffer + (row * WIDTH + x) * 4;
+
+      if (memcmp(p, expected, 4)) {
+         fprintf(stderr, "%s: row %u, pixel %u is "
+                 "(%u, %u, %u, %u), expected (%u, %u, %u, %u)\n",
+                 name, row, x, p[0], p[1], p[2], p[3],
+                 expected[0], expected[1], expected[2], expected[3]);
+         return false;
+      }
+   }
+   return true;
+}
+
+static bool
+test_buffer(const char *name, GLubyte *buffer)
+{
+   OSMesaContext ctx;
+   GLubyte pixel[4];
+   GLint y_up = -1;
+   bool pass = true;
+
+   ctx = OSMesaCreateContextExt(OSMESA_RGBA, 0, 0, 0, NULL);
+   if (!ctx ||
+       !OSMesaMakeCurrent(ctx, buffer, GL_UNSIGNED_BYTE, WIDTH, HEIGHT)) {
+      fprintf(stderr, "%s: failed to create an OSMesa context\n", name);
+      return false;
+   }
+
+   OSMesaGetIntegerv(OSMESA_Y_UP, &y_up);
+   if (y_up != GL_TRUE) {
+      fprintf(stderr, "%s: OSMESA_Y_UP defaults to %d\n", name, y_up);
+      pass = false;
+   }
+
+   /* The first row of the buffer is the bottom of the image. */
+   draw();
+   pass = check_row(name, buffer, 0, red) && pass;
+   pass = check_row(name, buffer, HEIGHT - 1, green) && pass;
+
+   /* The first row of the buffer is the top of the image. */
+   OSMesaPixelStore(OSMESA_Y_UP, GL_FALSE);
+   draw();
+   pass = check_row(name, buffer, 0, green) && pass;
+   pass = check_row(name, buffer, HEIGHT - 1, red) && pass;
+
+   /* GL's window coordinates don't depend on the buffer's orientation. */
+   glReadPixels(0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixel);
+   if (memcmp(pixel, red, 4)) {
+      fprintf(stderr, "%s: glReadPixels at (0, 0) returned "
+              "(%u, %u, %u, %u)\n",
+              name, pixel[0], pixel[1], pixel[2], pixel[3]);
+      pass = false;
+   }
+
+   /* And back to the default. */
+   OSMesaPixelStore(OSMESA_Y_UP, GL_TRUE);
+   draw();
+   pass = check_row(name, buffer, 0, red) && pass;
+   pass = check_row(name, buffer, HEIGHT - 1, green) && pass;
+
+   OSMesaDestroyContext(ctx);
+   return pass;
+}
+
+int
+main(int argc, char **argv)
+{
+   /* Room for the image one pixel past a 16-byte boundary. */
+   GLubyte *storage = malloc(WIDTH * HEIGHT * 4 + 32);
+   GLubyte *aligned;
+   bool pass = true;
+
+   if (!storage)
+      return 1;
+
+   aligned = (GLubyte *) (((uintptr_t) storage + 15) & ~(uintptr_t) 15);
+
+   pass = test_buffer("aligned", aligned) && pass;
+   pass = test_buffer("misaligned", aligned + 4) && pass;
+
+   free(storage);
+   return pass ? 0 : 1;
+}
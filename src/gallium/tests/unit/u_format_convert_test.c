@@ -0,0 +1,318 @@
+/**************************************************************************
+ *
+ * Copyright 2016 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+
+/*
+ * Checks the direct conversions of util_format_translate() against
+ * unpack_rgba_8unorm and pack_rgba_8unorm for every pair of formats they
+ * handle, with each kernel the CPU supports, then measures their throughput
+ * on a few common pairs.  "generic" is the time through unpack_rgba_8unorm
+ * and pack_rgba_8unorm, which is also what util_format_translate() does on
+ * CPUs without SSE2.
+ *
+ *    u_format_convert_test [-n iterations]
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "os/os_time.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_format.h"
+#include "util/u_format_convert.h"
+#include "util/u_memory.h"
+#include "util/u_string.h"
+
+
+#define TEST_WIDTH 65536
+#define BENCH_WIDTH 1024
+#define BENCH_HEIGHT 1024
+
+
+enum isa {
+   ISA_SSE2,
+   ISA_AVX2,
+   ISA_COUNT
+};
+
+static const char *isa_names[ISA_COUNT] = { "SSE2", "AVX2" };
+
+static struct util_cpu_caps detected_caps;
+
+
+static boolean
+select_isa(enum isa isa)
+{
+   util_cpu_caps = detected_caps;
+
+   switch (isa) {
+   case ISA_SSE2:
+      util_cpu_caps.has_avx2 = 0;
+#if defined(PIPE_ARCH_SSE)
+      return detected_caps.has_sse2;
+#else
+      return FALSE;
+#endif
+   case ISA_AVX2:
+#if defined(USE_AVX2)
+      return detected_caps.has_avx2;
+#else
+      return FALSE;
+#endif
+   default:
+      return FALSE;
+   }
+}
+
+
+/**
+ * What util_format_translate() did before the direct conversions.
+ */
+static void
+translate_generic(enum pipe_format dst_format, uint8_t *dst,
+                  unsigned dst_stride,
+                  enum pipe_format src_format, const uint8_t *src,
+                  unsigned src_stride,
+                  unsigned width, unsigned height, uint8_t *tmp)
+{
+   const struct util_format_description *dst_desc =
+      util_format_description(dst_format);
+   const struct util_format_description *src_desc =
+      util_format_description(src_format);
+
+   while (height--) {
+      src_desc->unpack_rgba_8unorm(tmp, width * 4, src, src_stride, width, 1);
+      dst_desc->pack_rgba_8unorm(dst, dst_stride, tmp, width * 4, width, 1);
+      dst += dst_stride;
+      src += src_stride;
+   }
+}
+
+
+static void
+fill_source(uint8_t *src, unsigned bytes, unsigned size)
+{
+   unsigned i;
+
+   if (bytes == 2) {
+      /* Every value, to check the scaling of all the channel values. */
+      for (i = 0; i < size / 2; i++)
+         ((uint16_t *)src)[i] = i;
+   } else {
+      uint32_t state = 0x12345678;
+      for (i = 0; i < size / 4; i++) {
+         state = state * 1664525 + 1013904223;
+         ((uint32_t *)src)[i] = state;
+      }
+   }
+}
+
+
+static boolean
+test_pair(enum pipe_format dst_format, enum pipe_format src_format,
+          uint8_t *src, uint8_t *expected, uint8_t *dst, uint8_t *tmp)
+{
+   const struct util_format_description *dst_desc =
+      util_format_description(dst_format);
+   const struct util_format_description *src_desc =
+      util_format_description(src_format);
+   unsigned src_bytes = src_desc->block.bits / 8;
+   unsigned dst_bytes = dst_desc->block.bits / 8;
+   boolean success = TRUE;
+   unsigned isa, width;
+
+   fill_source(src, src_bytes, TEST_WIDTH * src_bytes);
+   translate_generic(dst_format, expected, TEST_WIDTH * dst_bytes,
+                     src_format, src, TEST_WIDTH * src_bytes,
+                     TEST_WIDTH, 1, tmp);
+
+   for (isa = 0; isa < ISA_COUNT; isa++) {
+      if (!select_isa(isa))
+         continue;
+
+      /* The odd widths leave the ends of the rows to the C kernels. */
+      for (width = TEST_WIDTH - 17; width <= TEST_WIDTH; width += 17) {
+         memset(dst, 0xcd, TEST_WIDTH * dst_bytes);
+
+         util_format_translate(dst_format, dst, TEST_WIDTH * dst_bytes, 0, 0,
+                               src_format, src, TEST_WIDTH * src_bytes, 0, 0,
+                               width, 1);
+
+         if (memcmp(dst, expected, width * dst_bytes) != 0) {
+            printf("FAILED: %s -> %s with %s, width %u\n",
+                   src_desc->short_name, dst_desc->short_name,
+                   isa_names[isa], width);
+            success = FALSE;
+            break;
+         }
+      }
+   }
+
+   return success;
+}
+
+
+static boolean
+test_all(void)
+{
+   uint8_t *src = MALLOC(TEST_WIDTH * 4);
+   uint8_t *expected = MALLOC(TEST_WIDTH * 4);
+   uint8_t *dst = MALLOC(TEST_WIDTH * 4);
+   uint8_t *tmp = MALLOC(TEST_WIDTH * 4);
+   enum pipe_format src_format, dst_format;
+   unsigned num_pairs = 0;
+   boolean success = TRUE;
+
+   for (src_format = 1; src_format < PIPE_FORMAT_COUNT; ++src_format) {
+      const struct util_format_description *src_desc =
+         util_format_description(src_format);
+      if (!src_desc)
+         continue;
+
+      for (dst_format = 1; dst_format < PIPE_FORMAT_COUNT; ++dst_format) {
+         const struct util_format_description *dst_desc =
+            util_format_description(dst_format);
+         struct util_format_convert conv;
+
+         if (!dst_desc ||
+             util_is_format_compatible(src_desc, dst_desc) ||
+             !util_format_convert_init(&conv, dst_desc, src_desc))
+            continue;
+
+         if (!test_pair(dst_format, src_format, src, expected, dst, tmp))
+            success = FALSE;
+         num_pairs++;
+      }
+   }
+
+   printf("%u pairs of formats converted directly\n", num_pairs);
+
+   FREE(src);
+   FREE(expected);
+   FREE(dst);
+   FREE(tmp);
+
+   return success;
+}
+
+
+static void
+bench_all(unsigned iterations)
+{
+   static const struct {
+      enum pipe_format src;
+      enum pipe_format dst;
+   } pairs[] = {
+      { PIPE_FORMAT_B8G8R8A8_UNORM, PIPE_FORMAT_R8G8B8A8_UNORM },
+      { PIPE_FORMAT_R8G8B8A8_UNORM, PIPE_FORMAT_B8G8R8A8_UNORM },
+      { PIPE_FORMAT_R8G8B8X8_UNORM, PIPE_FORMAT_R8G8B8A8_UNORM },
+      { PIPE_FORMAT_B8G8R8X8_UNORM, PIPE_FORMAT_R8G8B8A8_UNORM },
+      { PIPE_FORMAT_B5G6R5_UNORM, PIPE_FORMAT_B8G8R8A8_UNORM },
+      { PIPE_FORMAT_B5G6R5_UNORM, PIPE_FORMAT_R8G8B8A8_UNORM },
+      { PIPE_FORMAT_B8G8R8A8_UNORM, PIPE_FORMAT_B5G6R5_UNORM },
+      { PIPE_FORMAT_R8G8B8A8_UNORM, PIPE_FORMAT_B5G6R5_UNORM },
+   };
+   uint8_t *src = MALLOC(BENCH_WIDTH * BENCH_HEIGHT * 4);
+   uint8_t *dst = MALLOC(BENCH_WIDTH * BENCH_HEIGHT * 4);
+   uint8_t *tmp = MALLOC(BENCH_WIDTH * 4);
+   double pixels = (double)BENCH_WIDTH * BENCH_HEIGHT * iterations;
+   unsigned i, j, isa;
+
+   printf("\nMpixels/s, %ux%u:\n", BENCH_WIDTH, BENCH_HEIGHT);
+   printf("%-34s %9s", "", "generic");
+   for (isa = 0; isa < ISA_COUNT; isa++)
+      printf(" %9s", isa_names[isa]);
+   printf("\n");
+
+   for (i = 0; i < ARRAY_SIZE(pairs); i++) {
+      const struct util_format_description *src_desc =
+         util_format_description(pairs[i].src);
+      const struct util_format_description *dst_desc =
+         util_format_description(pairs[i].dst);
+      unsigned src_stride = BENCH_WIDTH * src_desc->block.bits / 8;
+      unsigned dst_stride = BENCH_WIDTH * dst_desc->block.bits / 8;
+      char name[64];
+      int64_t start;
+
+      fill_source(src, 4, BENCH_WIDTH * BENCH_HEIGHT * 4);
+
+      util_snprintf(name, sizeof name, "%s -> %s",
+                    src_desc->short_name, dst_desc->short_name);
+      printf("%-34s", name);
+
+      start = os_time_get_nano();
+      for (j = 0; j < iterations; j++) {
+         translate_generic(pairs[i].dst, dst, dst_stride,
+                           pairs[i].src, src, src_stride,
+                           BENCH_WIDTH, BENCH_HEIGHT, tmp);
+      }
+      printf(" %9.1f", pixels * 1000.0 / (os_time_get_nano() - start));
+
+      for (isa = 0; isa < ISA_COUNT; isa++) {
+         if (!select_isa(isa)) {
+            printf(" %9s", "-");
+            continue;
+         }
+
+         start = os_time_get_nano();
+         for (j = 0; j < iterations; j++) {
+            util_format_translate(pairs[i].dst, dst, dst_stride, 0, 0,
+                                  pairs[i].src, src, src_stride, 0, 0,
+                                  BENCH_WIDTH, BENCH_HEIGHT);
+         }
+         printf(" %9.1f", pixels * 1000.0 / (os_time_get_nano() - start));
+      }
+      printf("\n");
+   }
+
+   FREE(src);
+   FREE(dst);
+   FREE(tmp);
+}
+
+
+int main(int argc, char **argv)
+{
+   unsigned iterations = 10;
+   boolean success;
+
+   if (argc == 3 && strcmp(argv[1], "-n") == 0)
+      iterations = atoi(argv[2]);
+
+   util_cpu_detect();
+   detected_caps = util_cpu_caps;
+
+   success = test_all();
+   bench_all(iterations);
+
+   util_cpu_caps = detected_caps;
+
+   return success ? 0 : 1;
+}
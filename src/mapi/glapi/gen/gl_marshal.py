@@ -0,0 +1,427 @@
+#!/usr/bin/env python
+
+# Copyright (C) 2016 Intel Corporation
+#
+# Permission is hereby granted, free of charge, to any person obtaining a
+# copy of this software and associated documentation files (the "Software"),
+# to deal in the Software without restriction, including without limitation
+# the rights to use, copy, modify, merge, publish, distribute, sublicense,
+# and/or sell copies of the Software, and to permit persons to whom the
+# Software is furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice (including the next
+# paragraph) shall be included in all copies or substantial portions of the
+# Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+# THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+# FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+# IN THE SOFTWARE.
+
+# This script generates marshal_generated.c and marshal_generated.h, which
+# implement the dispatch table used by the GL marshalling thread (see
+# main/glthread.h).
+#
+# Each GL function is marshalled in one of these ways:
+#
+#  - "async": the parameters are copied into the current batch and the
+#    call is executed later on the worker thread.  Arrays whose size is
+#    known from the XML (a fixed count or a counter parameter) are copied
+#    along with the command.  Any other pointer is passed by value, so
+#    "async" may only be forced on functions that store the pointer
+#    without reading through it.
+#
+#  - "sync": the worker thread is drained and the call is executed on the
+#    application thread.  This is used for anything that returns data,
+#    writes through a pointer, reads memory of an unknown size, or takes
+#    pixel data.
+#
+#  - "custom": _mesa_marshal_<name> and _mesa_unmarshal_<name> are written
+#    by hand in main/marshal.c.
+#
+#  - "skip": the function is not implemented, so it isn't marshalled.
+#
+# The choice is made from the parameter descriptions, and can be overridden
+# with the "marshal" attribute of the function in the XML.  The
+# "marshal_sync" attribute is a C condition under which an otherwise
+# asynchronous call is executed synchronously, and "marshal_call_after" is
+# a C statement run on the application thread after the call has been
+# queued, for the little state the application thread has to track itself.
+
+import argparse
+import gl_XML
+import license
+
+
+class marshal_item_factory(gl_XML.gl_item_factory):
+    """Factory to create objects derived from gl_item containing
+    information necessary to generate marshalling code."""
+
+    def create_function(self, element, context):
+        return marshal_function(element, context)
+
+
+class marshal_function(gl_XML.gl_function):
+    def process_element(self, element):
+        gl_XML.gl_function.process_element(self, element)
+
+        # Only the canonical entry point carries the marshalling
+        # attributes.
+        if element.get('name') != self.name:
+            return
+
+        self.fixed_params = []
+        self.variable_params = []
+        for p in self.parameters:
+            if p.is_padding:
+                continue
+            if p.is_variable_length():
+                self.variable_params.append(p)
+            else:
+                self.fixed_params.append(p)
+
+        self.marshal = element.get('marshal')
+        self.marshal_sync = element.get('marshal_sync')
+        self.marshal_call_after = element.get('marshal_call_after')
+
+    def marshal_flavor(self):
+        """Find out how this function is marshalled between the
+        application thread and the worker thread."""
+        if self.marshal is not None:
+            return self.marshal
+        if self.exec_flavor == 'skip':
+            return 'skip'
+        if self.return_type != 'void':
+            return 'sync'
+        for p in self.parameters:
+            if p.is_output or p.is_image():
+                return 'sync'
+            if p.count_parameter_list:
+                # The size depends on enum parameters, which the
+                # application thread can't evaluate without the
+                # compsize functions.
+                return 'sync'
+            if p.is_pointer() and not (p.count or p.counter):
+                return 'sync'
+        return 'async'
+
+    def is_fixed_array(self, p):
+        return p.is_pointer() and p.count
+
+
+class PrintCode(gl_XML.gl_print_base):
+    def __init__(self):
+        gl_XML.gl_print_base.__init__(self)
+
+        self.name = 'gl_marshal.py'
+        self.license = license.bsd_license_template % (
+            'Copyright (C) 2016 Intel Corporation', 'Intel Corporation')
+
+    def printRealHeader(self):
+        print '#include "main/api_exec.h"'
+        print '#include "main/context.h"'
+        print '#include "main/dispatch.h"'
+        print '#include "main/glthread.h"'
+        print '#include "main/marshal.h"'
+        print '#include "main/marshal_generated.h"'
+        print ''
+
+    def call_string(self, func):
+        return 'CALL_{0}(ctx->CurrentDispatch, ({1}))'.format(
+            func.name, func.get_called_parameter_string())
+
+    def print_sync_call(self, func, indent):
+        """Print the synchronous path of a marshal function.  The
+        worker is drained, so the call can run on this thread."""
+        print '{0}_mesa_glthread_finish_before(ctx, DISPATCH_CMD_{1});'.format(
+            indent, func.name)
+        if func.return_type == 'void':
+            print '{0}{1};'.format(indent, self.call_string(func))
+            print '{0}_mesa_glthread_finish_after(ctx);'.format(indent)
+        else:
+            print '{0}{1} result = {2};'.format(
+                indent, func.return_type, self.call_string(func))
+            print '{0}_mesa_glthread_finish_after(ctx);'.format(indent)
+            print '{0}return result;'.format(indent)
+
+    def print_call_after(self, func, indent):
+        if func.marshal_call_after:
+            print '{0}{1}'.format(indent, func.marshal_call_after)
+
+    def print_sync_body(self, func):
+        print '/* {0}: marshalled synchronously */'.format(func.name)
+        print 'static {0} GLAPIENTRY'.format(func.return_type)
+        print '_mesa_marshal_{0}({1})'.format(
+            func.name, func.get_parameter_string())
+        print '{'
+        print '   GET_CURRENT_CONTEXT(ctx);'
+        if func.return_type == 'void':
+            print '   _mesa_glthread_finish_before(ctx, DISPATCH_CMD_{0});'.format(
+                func.name)
+            print '   {0};'.format(self.call_string(func))
+            print '   _mesa_glthread_finish_after(ctx);'
+            self.print_call_after(func, '   ')
+        else:
+            self.print_sync_call(func, '   ')
+        print '}'
+        print ''
+
+    def print_async_struct(self, func):
+        print 'struct marshal_cmd_{0}'.format(func.name)
+        print '{'
+        print '   struct marshal_cmd_base cmd_base;'
+        for p in func.fixed_params:
+            if func.is_fixed_array(p):
+                print '   {0} {1}[{2}];'.format(
+                    p.get_base_type_string(), p.name, p.get_element_count())
+            else:
+                print '   {0} {1};'.format(p.type_string(), p.name)
+        for p in func.variable_params:
+            if p.img_null_flag:
+                print '   bool {0}_null; /* If set, no data follows for "{0}" */'.format(
+                    p.name)
+        for p in func.variable_params:
+            print '   /* Next {0} * {1} bytes are {2} {3}[] */'.format(
+                p.counter, p.size(), p.get_base_type_string(), p.name)
+        print '};'
+
+    def print_async_unmarshal(self, func):
+        print 'static inline void'
+        print ('_mesa_unmarshal_{0}(struct gl_context *ctx, '
+               'const struct marshal_cmd_{0} *cmd)').format(func.name)
+        print '{'
+        for p in func.fixed_params:
+            if func.is_fixed_array(p):
+                print '   const {0} *{1} = cmd->{1};'.format(
+                    p.get_base_type_string(), p.name)
+            elif p.type_string().startswith('const '):
+                print '   {0} {1} = cmd->{1};'.format(
+                    p.type_string(), p.name)
+            else:
+                print '   const {0} {1} = cmd->{1};'.format(
+                    p.type_string(), p.name)
+        if func.variable_params:
+            for p in func.variable_params:
+                print '   const {0} *{1};'.format(
+                    p.get_base_type_string(), p.name)
+            print '   const char *variable_data = (const char *) (cmd + 1);'
+            for p in func.variable_params:
+                if p.img_null_flag:
+                    print '   if (cmd->{0}_null) {{'.format(p.name)
+                    print '      {0} = NULL;'.format(p.name)
+                    print '   } else {'
+                    indent = '      '
+                else:
+                    indent = '   '
+                print '{0}{1} = (const {2} *) variable_data;'.format(
+                    indent, p.name, p.get_base_type_string())
+                print '{0}variable_data += {1} * {2};'.format(
+                    indent, p.counter, p.size())
+                if p.img_null_flag:
+                    print '   }'
+        print '   {0};'.format(self.call_string(func))
+        print '}'
+
+    def print_async_marshal(self, func):
+        print 'static void GLAPIENTRY'
+        print '_mesa_marshal_{0}({1})'.format(
+            func.name, func.get_parameter_string())
+        print '{'
+        print '   GET_CURRENT_CONTEXT(ctx);'
+        for p in func.variable_params:
+            if p.img_null_flag:
+                # Nothing is copied for a NULL pointer, whatever the count.
+                print '   int {0}_size = {0} ? safe_mul({1}, {2}) : 0;'.format(
+                    p.name, p.counter, p.size())
+            else:
+                print '   int {0}_size = safe_mul({1}, {2});'.format(
+                    p.name, p.counter, p.size())
+        size_terms = ['sizeof(struct marshal_cmd_{0})'.format(func.name)]
+        size_terms += ['{0}_size'.format(p.name) for p in func.variable_params]
+        print '   size_t cmd_size = {0};'.format(' + '.join(size_terms))
+        if func.fixed_params or func.variable_params:
+            print '   struct marshal_cmd_{0} *cmd;'.format(func.name)
+
+        conditions = ['{0}_size < 0'.format(p.name)
+                      for p in func.variable_params]
+        if func.variable_params:
+            conditions.append('cmd_size > MARSHAL_MAX_CMD_SIZE')
+        if func.marshal_sync:
+            conditions.append(func.marshal_sync)
+        if conditions:
+            print '   if (unlikely({0})) {{'.format(' ||\n                '.join(conditions))
+            self.print_sync_call(func, '      ')
+            self.print_call_after(func, '      ')
+            print '      return;'
+            print '   }'
+
+        if func.fixed_params or func.variable_params:
+            print ('   cmd = _mesa_glthread_allocate_command(ctx, '
+                   'DISPATCH_CMD_{0}, cmd_size);').format(func.name)
+        else:
+            print ('   _mesa_glthread_allocate_command(ctx, '
+                   'DISPATCH_CMD_{0}, cmd_size);').format(func.name)
+        for p in func.fixed_params:
+            if func.is_fixed_array(p):
+                print '   memcpy(cmd->{0}, {0}, sizeof(cmd->{0}));'.format(p.name)
+            else:
+                print '   cmd->{0} = {0};'.format(p.name)
+        if func.variable_params:
+            print '   char *variable_data = (char *) (cmd + 1);'
+            for p in func.variable_params:
+                if p.img_null_flag:
+                    print '   cmd->{0}_null = !{0};'.format(p.name)
+                    print '   if (!cmd->{0}_null) {{'.format(p.name)
+                    indent = '      '
+                else:
+                    indent = '   '
+                print '{0}memcpy(variable_data, {1}, {1}_size);'.format(
+                    indent, p.name)
+                print '{0}variable_data += {1}_size;'.format(indent, p.name)
+                if p.img_null_flag:
+                    print '   }'
+        self.print_call_after(func, '   ')
+        print '}'
+
+    def print_async_body(self, func):
+        print '/* {0}: marshalled asynchronously */'.format(func.name)
+        self.print_async_struct(func)
+        self.print_async_unmarshal(func)
+        self.print_async_marshal(func)
+        print ''
+
+    def print_unmarshal_dispatch_cmd(self, api):
+        print 'size_t'
+        print ('_mesa_unmarshal_dispatch_cmd(struct gl_context *ctx, '
+               'const void *cmd)')
+        print '{'
+        print '   const struct marshal_cmd_base *cmd_base = cmd;'
+        print '   switch (cmd_base->cmd_id) {'
+        for func in api.functionIterateAll():
+            flavor = func.marshal_flavor()
+            if flavor not in ('async', 'custom'):
+                continue
+            print '   case DISPATCH_CMD_{0}:'.format(func.name)
+            print ('      _mesa_unmarshal_{0}(ctx, (const struct '
+                   'marshal_cmd_{0} *) cmd);').format(func.name)
+            print '      break;'
+        print '   default:'
+        print '      unreachable("Bad command ID in the marshalling batch");'
+        print '   }'
+        print ''
+        print '   return cmd_base->cmd_size;'
+        print '}'
+        print ''
+
+    def print_cmd_names(self, api):
+        print 'const char *const _mesa_marshal_cmd_names[NUM_DISPATCH_CMD] = {'
+        for func in api.functionIterateAll():
+            if func.marshal_flavor() != 'skip':
+                print '   "{0}",'.format(func.name)
+        print '};'
+        print ''
+
+    def print_create_marshal_table(self, api):
+        print 'struct _glapi_table *'
+        print '_mesa_create_marshal_table(const struct gl_context *ctx)'
+        print '{'
+        print '   struct _glapi_table *table;'
+        print ''
+        print '   table = _mesa_alloc_dispatch_table();'
+        print '   if (table == NULL)'
+        print '      return NULL;'
+        print ''
+        for func in api.functionIterateAll():
+            if func.marshal_flavor() == 'skip':
+                continue
+            print '   SET_{0}(table, _mesa_marshal_{0});'.format(func.name)
+        print ''
+        print '   return table;'
+        print '}'
+
+    def printBody(self, api):
+        for func in api.functionIterateAll():
+            flavor = func.marshal_flavor()
+            if flavor == 'async':
+                self.print_async_body(func)
+            elif flavor == 'sync':
+                self.print_sync_body(func)
+            elif flavor not in ('custom', 'skip'):
+                raise Exception('Unrecognized marshal flavor {0!r}'.format(
+                    flavor))
+        self.print_cmd_names(api)
+        self.print_unmarshal_dispatch_cmd(api)
+        self.print_create_marshal_table(api)
+
+
+class PrintHeader(gl_XML.gl_print_base):
+    def __init__(self):
+        gl_XML.gl_print_base.__init__(self)
+
+        self.name = 'gl_marshal.py'
+        self.header_tag = '_MARSHAL_GENERATED_H_'
+        self.license = license.bsd_license_template % (
+            'Copyright (C) 2016 Intel Corporation', 'Intel Corporation')
+
+    def printRealHeader(self):
+        print '#include "main/glheader.h"'
+        print ''
+        print 'struct gl_context;'
+        print ''
+
+    def printBody(self, api):
+        print 'enum marshal_dispatch_cmd_id'
+        print '{'
+        for func in api.functionIterateAll():
+            if func.marshal_flavor() != 'skip':
+                print '   DISPATCH_CMD_{0},'.format(func.name)
+        print '   NUM_DISPATCH_CMD,'
+        print '};'
+        print ''
+        print 'extern const char *const _mesa_marshal_cmd_names[NUM_DISPATCH_CMD];'
+        print ''
+        for func in api.functionIterateAll():
+            if func.marshal_flavor() != 'custom':
+                continue
+            print 'struct marshal_cmd_{0};'.format(func.name)
+            print ('void _mesa_unmarshal_{0}(struct gl_context *ctx, '
+                   'const struct marshal_cmd_{0} *cmd);').format(func.name)
+            print 'void GLAPIENTRY _mesa_marshal_{0}({1});'.format(
+                func.name, func.get_parameter_string())
+
+
+def _parser():
+    """Parse arguments and return a namespace."""
+    parser = argparse.ArgumentParser()
+    parser.add_argument('-f', '--filename',
+                        default='gl_and_es_API.xml',
+                        metavar="input_file_name",
+                        dest='file_name',
+                        help="Path to an XML description of OpenGL API.")
+    parser.add_argument('-m', '--mode',
+                        choices=['code', 'header'],
+                        default='code',
+                        metavar="mode",
+                        help="Generate either the code or the header")
+    return parser.parse_args()
+
+
+def main():
+    """Main function."""
+    args = _parser()
+
+    api = gl_XML.parse_GL_API(args.file_name, marshal_item_factory())
+
+    if args.mode == 'code':
+        printer = PrintCode()
+    else:
+        printer = PrintHeader()
+
+    printer.Print(api)
+
+
+if __name__ == '__main__':
+    main()
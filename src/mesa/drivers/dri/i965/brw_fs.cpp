@@ -41,6 +41,7 @@
 #include "compiler/glsl_types.h"
 #include "compiler/nir/nir_builder.h"
 #include "program/prog_parameter.h"
+#include "util/compile_profile.h"
 
 using namespace brw;
 
@@ -6499,6 +6500,11 @@ brw_compile_fs(const struct brw_compiler *compiler, void *log_data,
                unsigned *final_assembly_size,
                char **error_str)
 {
+   compile_profile_shader_scope profile_shader("i965 fragment shader %s",
+                                               src_shader->info.name);
+   compile_profile_scope profile("i965", "brw_compile_fs");
+   struct compile_profile_timer timer;
+
    nir_shader *shader = nir_shader_clone(mem_ctx, src_shader);
    shader = brw_nir_apply_sampler_key(shader, compiler->devinfo, &key->tex,
                                       true);
@@ -6540,7 +6546,10 @@ brw_compile_fs(const struct brw_compiler *compiler, void *log_data,
    fs_visitor v8(compiler, log_data, mem_ctx, key,
                  &prog_data->base, prog, shader, 8,
                  shader_time_index8);
-   if (!v8.run_fs(allow_spilling, false /* do_rep_send */)) {
+   compile_profile_begin(&timer, "i965", "fs_visitor::run_fs SIMD8");
+   const bool simd8_ok = v8.run_fs(allow_spilling, false /* do_rep_send */);
+   compile_profile_end(&timer, false);
+   if (!simd8_ok) {
       if (error_str)
          *error_str = ralloc_strdup(mem_ctx, v8.fail_msg);
 
@@ -6558,7 +6567,10 @@ brw_compile_fs(const struct brw_compiler *compiler, void *log_data,
                      &prog_data->base, prog, shader, 16,
                      shader_time_index16);
       v16.import_uniforms(&v8);
-      if (!v16.run_fs(allow_spilling, use_rep_send)) {
+      compile_profile_begin(&timer, "i965", "fs_visitor::run_fs SIMD16");
+      const bool simd16_ok = v16.run_fs(allow_spilling, use_rep_send);
+      compile_profile_end(&timer, false);
+      if (!simd16_ok) {
          compiler->shader_perf_log(log_data,
                                    "SIMD16 shader failed to compile: %s",
                                    v16.fail_msg);
@@ -6616,6 +6628,8 @@ brw_compile_fs(const struct brw_compiler *compiler, void *log_data,
                                      shader->info.name));
    }
 
+   compile_profile_begin(&timer, "i965", "fs_generator::generate_code");
+
    if (simd8_cfg) {
       prog_data->dispatch_8 = true;
       g.generate_code(simd8_cfg, 8);
@@ -6635,6 +6649,8 @@ brw_compile_fs(const struct brw_compiler *compiler, void *log_data,
       prog_data->reg_blocks_0 = brw_register_blocks(simd16_grf_used);
    }
 
+   compile_profile_end(&timer, false);
+
    return g.get_assembly(final_assembly_size);
 }
 
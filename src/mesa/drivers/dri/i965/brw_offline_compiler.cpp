@@ -0,0 +1,432 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/** @file brw_offline_compiler.cpp
+ *
+ * The offline compiler (see compiler/glsl/offline_compiler.h) with the i965
+ * backend.  Programs go through the steps of brw_link_shader() and of the
+ * precompiles at link time, with the same default program keys, for the
+ * device given as "-b i965:<PCI id>".
+ *
+ * The instruction counts are taken from the statistics that the generators
+ * report through shader_debug_log, like shader-db does.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "main/imports.h"
+#include "main/mtypes.h"
+#include "compiler/glsl/ir.h"
+#include "compiler/glsl/ir_optimization.h"
+#include "compiler/glsl/offline_compiler.h"
+#include "compiler/glsl/glsl_to_nir.h"
+#include "compiler/nir/nir.h"
+#include "program/prog_statevars.h"
+#include "util/bitscan.h"
+#include "util/ralloc.h"
+#include "brw_compiler.h"
+#include "brw_device_info.h"
+#include "brw_fs.h"
+#include "brw_nir.h"
+#include "brw_shader.h"
+
+/** Skylake GT2, when no PCI id is given. */
+#define DEFAULT_PCI_ID 0x1912
+
+namespace {
+
+/** Where the statistics of the shader being compiled go. */
+struct offline_log {
+   struct offline_stats *stats;
+   bool found;
+};
+
+} /* namespace */
+
+static void
+offline_debug_log(void *data, const char *fmt, ...)
+{
+   struct offline_log *log = (struct offline_log *) data;
+   unsigned width, inst, loops, spills, fills;
+   va_list args;
+
+   if (log == NULL || log->found)
+      return;
+
+   va_start(args, fmt);
+   char *msg = ralloc_vasprintf(NULL, fmt, args);
+   va_end(args);
+
+   /* The first program that the FS generator reports is the SIMD8 one, which
+    * is the one that shader-db counts as well.
+    */
+   const char *s = strchr(msg, ' ');
+   if (s && sscanf(s, " SIMD%u shader: %u inst, %u loops, %*u cycles, "
+                   "%u:%u spills:fills", &width, &inst, &loops,
+                   &spills, &fills) == 5) {
+      log->found = true;
+   } else if (s && sscanf(s, " vec4 shader: %u inst, %u loops",
+                          &inst, &loops) == 2) {
+      /* The vec4 generator doesn't report spills and fills. */
+      spills = fills = 0;
+      log->found = true;
+   }
+
+   if (log->found) {
+      log->stats->instructions = inst;
+      log->stats->loops = loops;
+      log->stats->spills = spills;
+      log->stats->fills = fills;
+   }
+
+   ralloc_free(msg);
+}
+
+static void
+offline_perf_log(void *data, const char *fmt, ...)
+{
+}
+
+static void *
+brw_offline_create(const char *arg)
+{
+   int pci_id = arg ? strtol(arg, NULL, 0) : DEFAULT_PCI_ID;
+   const struct brw_device_info *devinfo = brw_get_device_info(pci_id);
+
+   if (devinfo == NULL) {
+      fprintf(stderr, "Unknown PCI id 0x%x\n", pci_id);
+      return NULL;
+   }
+
+   /* The fixed function state of the earlier generations ends up in the
+    * program keys, which have no sensible defaults.
+    */
+   if (devinfo->gen < 6) {
+      fprintf(stderr, "The i965 offline compiler needs Gen6 or later\n");
+      return NULL;
+   }
+
+   struct brw_compiler *compiler = brw_compiler_create(NULL, devinfo);
+   compiler->shader_debug_log = offline_debug_log;
+   compiler->shader_perf_log = offline_perf_log;
+
+   return compiler;
+}
+
+static void
+brw_offline_destroy(void *compiler)
+{
+   ralloc_free(compiler);
+}
+
+static void
+brw_offline_get_options(void *data, struct gl_shader_compiler_options *options)
+{
+   const struct brw_compiler *compiler = (const struct brw_compiler *) data;
+
+   memcpy(options, compiler->glsl_compiler_options,
+          sizeof(compiler->glsl_compiler_options));
+}
+
+/**
+ * The lowering of process_glsl_ir() in brw_link.cpp, except for the texture
+ * gradient lowering, which wants a brw_context.
+ */
+static void
+brw_offline_lower_glsl(void *data,
+                       const struct gl_shader_compiler_options *options,
+                       struct gl_shader_program *prog,
+                       struct gl_linked_shader *shader)
+{
+   const struct brw_compiler *compiler = (const struct brw_compiler *) data;
+   exec_list *ir = shader->ir;
+
+   if (compiler->devinfo->gen < 7) {
+      lower_instructions(ir, BIT_COUNT_TO_MATH |
+                             EXTRACT_TO_SHIFTS |
+                             INSERT_TO_SHIFTS |
+                             REVERSE_TO_SHIFTS);
+   }
+
+   offline_lower_glsl_ir(options, shader);
+
+   bool progress;
+   do {
+      progress = false;
+
+      if (compiler->scalar_stage[shader->Stage]) {
+         if (shader->Stage == MESA_SHADER_VERTEX ||
+             shader->Stage == MESA_SHADER_FRAGMENT)
+            brw_do_channel_expressions(ir);
+         brw_do_vector_splitting(ir);
+      }
+
+      progress = do_lower_jumps(ir, true, true, true, false, false) || progress;
+      progress = do_common_optimization(ir, true, true, options, true) ||
+                 progress;
+   } while (progress);
+
+   validate_ir_tree(ir);
+}
+
+/** brw_nir_lower_uniforms() from brw_program.c. */
+static void
+lower_uniforms(nir_shader *nir, bool is_scalar)
+{
+   if (is_scalar) {
+      nir_assign_var_locations(&nir->uniforms, &nir->num_uniforms, 0,
+                               type_size_scalar_bytes);
+      nir_lower_io(nir, nir_var_uniform, type_size_scalar_bytes);
+   } else {
+      nir_assign_var_locations(&nir->uniforms, &nir->num_uniforms, 0,
+                               type_size_vec4_bytes);
+      nir_lower_io(nir, nir_var_uniform, type_size_vec4_bytes);
+   }
+}
+
+/**
+ * The rest of brw_create_nir().  The uniform of the window-space position
+ * transform is only declared, as nothing gets uploaded.
+ */
+static nir_shader *
+create_nir(const struct brw_compiler *compiler,
+           struct gl_shader_program *prog, nir_shader *nir)
+{
+   const bool is_scalar = compiler->scalar_stage[nir->stage];
+
+   nir_remove_dead_variables(nir, (nir_variable_mode) (nir_var_shader_in |
+                                                       nir_var_shader_out));
+   NIR_PASS_V(nir, nir_lower_io_to_temporaries,
+              nir_shader_get_entrypoint(nir), true, false);
+
+   nir = brw_preprocess_nir(compiler, nir);
+
+   if (nir->stage == MESA_SHADER_FRAGMENT) {
+      struct nir_lower_wpos_ytransform_options wpos_options;
+
+      memset(&wpos_options, 0, sizeof(wpos_options));
+      wpos_options.state_tokens[0] = STATE_INTERNAL;
+      wpos_options.state_tokens[1] = STATE_FB_WPOS_Y_TRANSFORM;
+      wpos_options.fs_coord_pixel_center_integer = 1;
+      wpos_options.fs_coord_origin_upper_left = 1;
+
+      NIR_PASS_V(nir, nir_lower_wpos_ytransform, &wpos_options);
+   }
+
+   NIR_PASS_V(nir, nir_lower_system_values);
+   NIR_PASS_V(nir, lower_uniforms, is_scalar);
+   NIR_PASS_V(nir, nir_lower_samplers, prog);
+   NIR_PASS_V(nir, nir_lower_atomics, prog);
+
+   return nir;
+}
+
+/**
+ * Allocates the parameter arrays that the brw_codegen_*_prog() functions
+ * set up.  The parameters themselves are left NULL.
+ */
+static void
+setup_prog_data(void *mem_ctx, struct gl_linked_shader *shader,
+                struct brw_stage_prog_data *prog_data, int param_count)
+{
+   prog_data->nr_image_params = shader->NumImages;
+   prog_data->param =
+      rzalloc_array(mem_ctx, const gl_constant_value *, param_count);
+   prog_data->pull_param =
+      rzalloc_array(mem_ctx, const gl_constant_value *, param_count);
+   prog_data->image_param =
+      rzalloc_array(mem_ctx, struct brw_image_param,
+                    prog_data->nr_image_params);
+   prog_data->nr_params = param_count;
+}
+
+/** brw_setup_tex_for_precompile() */
+static void
+setup_tex_key(const struct brw_compiler *compiler,
+              struct brw_sampler_prog_key_data *tex,
+              const struct gl_program *prog)
+{
+   const struct brw_device_info *devinfo = compiler->devinfo;
+   const bool has_shader_channel_select =
+      devinfo->is_haswell || devinfo->gen >= 8;
+   unsigned sampler_count = util_last_bit(prog->SamplersUsed);
+
+   for (unsigned i = 0; i < sampler_count; i++) {
+      if (!has_shader_channel_select && (prog->ShadowSamplers & (1 << i))) {
+         tex->swizzles[i] =
+            MAKE_SWIZZLE4(SWIZZLE_X, SWIZZLE_X, SWIZZLE_X, SWIZZLE_ONE);
+      } else {
+         tex->swizzles[i] = SWIZZLE_XYZW;
+      }
+   }
+}
+
+static const unsigned *
+compile_vs(const struct brw_compiler *compiler, struct offline_log *log,
+           void *mem_ctx, struct gl_shader_program *prog,
+           struct gl_linked_shader *shader, nir_shader *nir,
+           unsigned *size, char **error)
+{
+   struct gl_program *glprog = shader->Program;
+   struct brw_vs_prog_key key;
+   struct brw_vs_prog_data prog_data;
+
+   memset(&key, 0, sizeof(key));
+   memset(&prog_data, 0, sizeof(prog_data));
+   setup_tex_key(compiler, &key.tex, glprog);
+
+   brw_assign_common_binding_table_offsets(MESA_SHADER_VERTEX,
+                                           compiler->devinfo, prog, glprog,
+                                           &prog_data.base.base, 0);
+   setup_prog_data(mem_ctx, shader, &prog_data.base.base,
+                   nir->num_uniforms / 4);
+
+   prog_data.inputs_read = glprog->InputsRead;
+   prog_data.base.cull_distance_mask =
+      ((1 << glprog->CullDistanceArraySize) - 1) <<
+      glprog->ClipDistanceArraySize;
+   brw_compute_vue_map(compiler->devinfo, &prog_data.base.vue_map,
+                       glprog->OutputsWritten, prog->SeparateShader);
+
+   return brw_compile_vs(compiler, log, mem_ctx, &key, &prog_data, nir,
+                         NULL, false, -1, size, error);
+}
+
+static const unsigned *
+compile_fs(const struct brw_compiler *compiler, struct offline_log *log,
+           void *mem_ctx, struct gl_shader_program *prog,
+           struct gl_linked_shader *shader, nir_shader *nir,
+           unsigned *size, char **error)
+{
+   struct gl_program *glprog = shader->Program;
+   struct brw_wm_prog_key key;
+   struct brw_wm_prog_data prog_data;
+
+   memset(&key, 0, sizeof(key));
+   memset(&prog_data, 0, sizeof(prog_data));
+   setup_tex_key(compiler, &key.tex, glprog);
+
+   if (_mesa_bitcount_64(glprog->InputsRead & BRW_FS_VARYING_INPUT_MASK) > 16)
+      key.input_slots_valid = glprog->InputsRead | VARYING_BIT_POS;
+   key.nr_color_regions = _mesa_bitcount_64(glprog->OutputsWritten &
+         ~(BITFIELD64_BIT(FRAG_RESULT_DEPTH) |
+         BITFIELD64_BIT(FRAG_RESULT_SAMPLE_MASK)));
+
+   prog_data.binding_table.render_target_start = 0;
+   brw_assign_common_binding_table_offsets(MESA_SHADER_FRAGMENT,
+                                           compiler->devinfo, prog, glprog,
+                                           &prog_data.base,
+                                           MAX2(key.nr_color_regions, 1));
+   setup_prog_data(mem_ctx, shader, &prog_data.base,
+                   nir->num_uniforms / 4 + 2 * BRW_MAX_TEX_UNIT);
+
+   return brw_compile_fs(compiler, log, mem_ctx, &key, &prog_data, nir,
+                         glprog, -1, -1, true, false, size, error);
+}
+
+static const unsigned *
+compile_cs(const struct brw_compiler *compiler, struct offline_log *log,
+           void *mem_ctx, struct gl_shader_program *prog,
+           struct gl_linked_shader *shader, nir_shader *nir,
+           unsigned *size, char **error)
+{
+   struct gl_program *glprog = shader->Program;
+   struct brw_cs_prog_key key;
+   struct brw_cs_prog_data prog_data;
+
+   memset(&key, 0, sizeof(key));
+   memset(&prog_data, 0, sizeof(prog_data));
+   setup_tex_key(compiler, &key.tex, glprog);
+
+   prog_data.base.total_shared = prog->Comp.SharedSize;
+   prog_data.binding_table.work_groups_start = 0;
+   brw_assign_common_binding_table_offsets(MESA_SHADER_COMPUTE,
+                                           compiler->devinfo, prog, glprog,
+                                           &prog_data.base, 1);
+
+   int param_count = nir->num_uniforms / 4;
+   prog_data.thread_local_id_index = param_count++;
+   setup_prog_data(mem_ctx, shader, &prog_data.base,
+                   param_count + 2 * BRW_MAX_TEX_UNIT);
+
+   return brw_compile_cs(compiler, log, mem_ctx, &key, &prog_data, nir,
+                         -1, size, error);
+}
+
+static bool
+brw_offline_compile(void *data, void *mem_ctx,
+                    struct gl_shader_program *prog, nir_shader *nir,
+                    struct offline_stats *stats, char **error)
+{
+   const struct brw_compiler *compiler = (const struct brw_compiler *) data;
+   struct gl_linked_shader *shader = prog->_LinkedShaders[nir->stage];
+   struct offline_log log = { stats, false };
+   const unsigned *program = NULL;
+   unsigned size;
+
+   nir = create_nir(compiler, prog, nir);
+
+   switch (nir->stage) {
+   case MESA_SHADER_VERTEX:
+      program = compile_vs(compiler, &log, mem_ctx, prog, shader, nir,
+                           &size, error);
+      break;
+   case MESA_SHADER_FRAGMENT:
+      program = compile_fs(compiler, &log, mem_ctx, prog, shader, nir,
+                           &size, error);
+      break;
+   case MESA_SHADER_COMPUTE:
+      program = compile_cs(compiler, &log, mem_ctx, prog, shader, nir,
+                           &size, error);
+      break;
+   default:
+      unreachable("stage not in brw_offline_backend.stages");
+   }
+
+   return program != NULL;
+}
+
+static const struct offline_backend brw_offline_backend = {
+   "i965",
+   (1 << MESA_SHADER_VERTEX) |
+   (1 << MESA_SHADER_FRAGMENT) |
+   (1 << MESA_SHADER_COMPUTE),
+   brw_offline_create,
+   brw_offline_destroy,
+   brw_offline_get_options,
+   brw_offline_lower_glsl,
+   brw_offline_compile,
+};
+
+static const struct offline_backend *const backends[] = {
+   &brw_offline_backend,
+   &offline_nir_backend,
+};
+
+int
+main(int argc, char **argv)
+{
+   return offline_compiler_main(argc, argv, backends, ARRAY_SIZE(backends));
+}
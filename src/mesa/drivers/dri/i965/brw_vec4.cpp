@@ -30,6 +30,7 @@
 #include "brw_vec4_live_variables.h"
 #include "brw_dead_control_flow.h"
 #include "program/prog_parameter.h"
+#include "util/compile_profile.h"
 
 #define MAX_INSTRUCTION (1 << 30)
 
@@ -2077,6 +2078,11 @@ brw_compile_vs(const struct brw_compiler *compiler, void *log_data,
                unsigned *final_assembly_size,
                char **error_str)
 {
+   compile_profile_shader_scope profile_shader("i965 vertex shader %s",
+                                               src_shader->info.name);
+   compile_profile_scope profile("i965", "brw_compile_vs");
+   struct compile_profile_timer timer;
+
    const bool is_scalar = compiler->scalar_stage[MESA_SHADER_VERTEX];
    nir_shader *shader = nir_shader_clone(mem_ctx, src_shader);
    shader = brw_nir_apply_sampler_key(shader, compiler->devinfo, &key->tex,
@@ -2142,7 +2148,10 @@ brw_compile_vs(const struct brw_compiler *compiler, void *log_data,
       fs_visitor v(compiler, log_data, mem_ctx, key, &prog_data->base.base,
                    NULL, /* prog; Only used for TEXTURE_RECTANGLE on gen < 8 */
                    shader, 8, shader_time_index);
-      if (!v.run_vs(clip_planes)) {
+      compile_profile_begin(&timer, "i965", "fs_visitor::run_vs");
+      const bool ok = v.run_vs(clip_planes);
+      compile_profile_end(&timer, false);
+      if (!ok) {
          if (error_str)
             *error_str = ralloc_strdup(mem_ctx, v.fail_msg);
 
@@ -2162,7 +2171,9 @@ brw_compile_vs(const struct brw_compiler *compiler, void *log_data,
 
          g.enable_debug(debug_name);
       }
+      compile_profile_begin(&timer, "i965", "fs_generator::generate_code");
       g.generate_code(v.cfg, 8);
+      compile_profile_end(&timer, false);
       assembly = g.get_assembly(final_assembly_size);
    }
 
@@ -2172,16 +2183,21 @@ brw_compile_vs(const struct brw_compiler *compiler, void *log_data,
       vec4_vs_visitor v(compiler, log_data, key, prog_data,
                         shader, clip_planes, mem_ctx,
                         shader_time_index, use_legacy_snorm_formula);
-      if (!v.run()) {
+      compile_profile_begin(&timer, "i965", "vec4_visitor::run");
+      const bool ok = v.run();
+      compile_profile_end(&timer, false);
+      if (!ok) {
          if (error_str)
             *error_str = ralloc_strdup(mem_ctx, v.fail_msg);
 
          return NULL;
       }
 
+      compile_profile_begin(&timer, "i965", "brw_vec4_generate_assembly");
       assembly = brw_vec4_generate_assembly(compiler, log_data, mem_ctx,
                                             shader, &prog_data->base, v.cfg,
                                             final_assembly_size);
+      compile_profile_end(&timer, false);
    }
 
    return assembly;
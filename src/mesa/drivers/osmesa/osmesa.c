@@ -1229,6 +1229,10 @@ static struct name_function functions[] = {
    { "OSMesaGetProcAddress", (OSMESAproc) OSMesaGetProcAddress },
    { "OSMesaColorClamp", (OSMESAproc) OSMesaColorClamp },
    { "OSMesaPostprocess", (OSMESAproc) OSMesaPostprocess },
+   { "OSMesaMakeCurrentRing", (OSMESAproc) OSMesaMakeCurrentRing },
+   { "OSMesaSwapBuffersAsync", (OSMESAproc) OSMesaSwapBuffersAsync },
+   { "OSMesaClientWaitFence", (OSMESAproc) OSMesaClientWaitFence },
+   { "OSMesaDestroyFence", (OSMESAproc) OSMesaDestroyFence },
    { NULL, NULL }
 };
 
@@ -1268,6 +1272,37 @@ OSMesaPostprocess(OSMesaContext osmesa, const char *filter,
 }
 
 
+GLAPI GLboolean GLAPIENTRY
+OSMesaMakeCurrentRing(OSMesaContext osmesa, void *const *buffers,
+                      GLsizei count, GLenum type,
+                      GLsizei width, GLsizei height)
+{
+   fprintf(stderr,
+           "OSMesaMakeCurrentRing() is only available with gallium drivers\n");
+   return GL_FALSE;
+}
+
+
+GLAPI OSMesaFence GLAPIENTRY
+OSMesaSwapBuffersAsync(OSMesaContext osmesa, void **buffer)
+{
+   return NULL;
+}
+
+
+GLAPI GLboolean GLAPIENTRY
+OSMesaClientWaitFence(OSMesaFence fence, GLuint64 timeout)
+{
+   return GL_FALSE;
+}
+
+
+GLAPI void GLAPIENTRY
+OSMesaDestroyFence(OSMesaFence fence)
+{
+}
+
+
 
 /**
  * When GLX_INDIRECT_RENDERING is defined, some symbols are missing in
@@ -0,0 +1,54 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file avx2_minmax.c
+ * AVX2 versions of the index kernels in sse_minmax.c.
+ */
+
+#include "main/sse_minmax.h"
+#include <immintrin.h>
+
+#define VEC                __m256i
+#define VEC_BYTES          32
+#define LOADU(p)           _mm256_loadu_si256((const __m256i *)(p))
+#define STOREU(p, v)       _mm256_storeu_si256((__m256i *)(p), v)
+#define SET1_8(x)          _mm256_set1_epi8((char)(x))
+#define SET1_16(x)         _mm256_set1_epi16((short)(x))
+#define SET1_32(x)         _mm256_set1_epi32((int)(x))
+#define ZERO()             _mm256_setzero_si256()
+#define MIN_8(a, b)        _mm256_min_epu8(a, b)
+#define MIN_16(a, b)       _mm256_min_epu16(a, b)
+#define MIN_32(a, b)       _mm256_min_epu32(a, b)
+#define MAX_8(a, b)        _mm256_max_epu8(a, b)
+#define MAX_16(a, b)       _mm256_max_epu16(a, b)
+#define MAX_32(a, b)       _mm256_max_epu32(a, b)
+#define CMPEQ_8(a, b)      _mm256_cmpeq_epi8(a, b)
+#define CMPEQ_16(a, b)     _mm256_cmpeq_epi16(a, b)
+#define CMPEQ_32(a, b)     _mm256_cmpeq_epi32(a, b)
+#define OR(a, b)           _mm256_or_si256(a, b)
+#define ANDNOT(a, b)       _mm256_andnot_si256(a, b)
+#define MOVEMASK(v)        ((unsigned)_mm256_movemask_epi8(v))
+#define FUNC(name)         _mesa_avx2_##name
+
+#include "main/index_simd_tmp.h"
@@ -1571,7 +1571,7 @@ _mesa_buffer_storage(struct gl_context *ctx, struct gl_buffer_object *bufObj,
 
    bufObj->Written = GL_TRUE;
    bufObj->Immutable = GL_TRUE;
-   bufObj->MinMaxCacheDirty = true;
+   vbo_delete_minmax_cache(bufObj);
 
    assert(ctx->Driver.BufferData);
    if (!ctx->Driver.BufferData(ctx, target, size, data, GL_DYNAMIC_DRAW,
@@ -1685,7 +1685,7 @@ _mesa_buffer_data(struct gl_context *ctx, struct gl_buffer_object *bufObj,
    FLUSH_VERTICES(ctx, _NEW_BUFFER_OBJECT);
 
    bufObj->Written = GL_TRUE;
-   bufObj->MinMaxCacheDirty = true;
+   vbo_delete_minmax_cache(bufObj);
 
 #ifdef VBO_DEBUG
    printf("glBufferDataARB(%u, sz %ld, from %p, usage 0x%x)\n",
@@ -1798,7 +1798,7 @@ _mesa_buffer_sub_data(struct gl_context *ctx, struct gl_buffer_object *bufObj,
    }
 
    bufObj->Written = GL_TRUE;
-   bufObj->MinMaxCacheDirty = true;
+   vbo_invalidate_minmax_cache(bufObj, offset, size);
 
    assert(ctx->Driver.BufferSubData);
    ctx->Driver.BufferSubData(ctx, offset, size, data, bufObj);
@@ -1918,7 +1918,7 @@ _mesa_clear_buffer_sub_data(struct gl_context *ctx,
    if (size == 0)
       return;
 
-   bufObj->MinMaxCacheDirty = true;
+   vbo_invalidate_minmax_cache(bufObj, offset, size);
 
    if (data == NULL) {
       /* clear to zeros, per the spec */
@@ -2333,7 +2333,7 @@ _mesa_copy_buffer_sub_data(struct gl_context *ctx,
       }
    }
 
-   dst->MinMaxCacheDirty = true;
+   vbo_invalidate_minmax_cache(dst, writeOffset, size);
 
    ctx->Driver.CopyBufferSubData(ctx, src, dst, readOffset, writeOffset, size);
 }
@@ -2542,7 +2542,7 @@ _mesa_map_buffer_range(struct gl_context *ctx,
 
    if (access & GL_MAP_WRITE_BIT) {
       bufObj->Written = GL_TRUE;
-      bufObj->MinMaxCacheDirty = true;
+      vbo_invalidate_minmax_cache(bufObj, offset, length);
    }
 
 #ifdef VBO_DEBUG
@@ -2822,6 +2822,19 @@ set_ssbo_binding(struct gl_context *ctx,
       bufObj->UsageHistory |= USAGE_SHADER_STORAGE_BUFFER;
 }
 
+/**
+ * Mark binding points [first, first + count) in one of the
+ * gl_context::New*BufferBindings masks.
+ */
+static void
+flag_bindings(GLbitfield *mask, GLuint first, GLuint count)
+{
+   GLuint i;
+
+   for (i = first; i < first + count; i++)
+      mask[i / 32] |= 1u << (i % 32);
+}
+
 /**
  * Binds a buffer object to a uniform buffer binding point.
  *
@@ -2849,6 +2862,7 @@ bind_uniform_buffer(struct gl_context *ctx,
 
    FLUSH_VERTICES(ctx, 0);
    ctx->NewDriverState |= ctx->DriverFlags.NewUniformBuffer;
+   flag_bindings(ctx->NewUniformBufferBindings, index, 1);
 
    set_ubo_binding(ctx, binding, bufObj, offset, size, autoSize);
 }
@@ -2880,6 +2894,7 @@ bind_shader_storage_buffer(struct gl_context *ctx,
 
    FLUSH_VERTICES(ctx, 0);
    ctx->NewDriverState |= ctx->DriverFlags.NewShaderStorageBuffer;
+   flag_bindings(ctx->NewShaderStorageBufferBindings, index, 1);
 
    set_ssbo_binding(ctx, binding, bufObj, offset, size, autoSize);
 }
@@ -3205,6 +3220,7 @@ bind_uniform_buffers(struct gl_context *ctx, GLuint first, GLsizei count,
    /* Assume that at least one binding will be changed */
    FLUSH_VERTICES(ctx, 0);
    ctx->NewDriverState |= ctx->DriverFlags.NewUniformBuffer;
+   flag_bindings(ctx->NewUniformBufferBindings, first, count);
 
    if (!buffers) {
       /* The ARB_multi_bind spec says:
@@ -3317,6 +3333,7 @@ bind_shader_storage_buffers(struct gl_context *ctx, GLuint first,
    /* Assume that at least one binding will be changed */
    FLUSH_VERTICES(ctx, 0);
    ctx->NewDriverState |= ctx->DriverFlags.NewShaderStorageBuffer;
+   flag_bindings(ctx->NewShaderStorageBufferBindings, first, count);
 
    if (!buffers) {
       /* The ARB_multi_bind spec says:
@@ -35,6 +35,8 @@
 
 #include "glheader.h"
 
+struct blob;
+struct blob_reader;
 struct gl_bitmap_atlas;
 struct gl_buffer_object;
 struct gl_context;
@@ -515,6 +517,29 @@ struct dd_function_table {
     */
    GLboolean (*LinkShader)(struct gl_context *ctx,
                            struct gl_shader_program *shader);
+
+   /**
+    * Append the driver's compiled form of a linked program to a program
+    * cache entry (see program/shader_cache.h).
+    *
+    * Both this and ShaderCacheDeserialize must be set for the program cache
+    * to be used.  Returning false prevents the program from being cached.
+    */
+   GLboolean (*ShaderCacheSerialize)(struct gl_context *ctx,
+                                     struct gl_program *prog,
+                                     struct blob *blob);
+
+   /**
+    * Restore what ShaderCacheSerialize wrote, in place of LinkShader and
+    * ProgramStringNotify.  \p prog is a new program with the core Mesa
+    * state already filled in.
+    *
+    * Returning false makes the link fall back to compiling from source.
+    */
+   GLboolean (*ShaderCacheDeserialize)(struct gl_context *ctx,
+                                       struct gl_shader_program *shProg,
+                                       struct gl_program *prog,
+                                       struct blob_reader *blob);
    /*@}*/
 
    /**
@@ -32,6 +32,7 @@
 #include "imports.h"
 #include "hash.h"
 #include "mtypes.h"
+#include "shaderapi.h"
 #include "version.h"
 #include "util/hash_table.h"
 #include "util/simple_list.h"
@@ -732,8 +733,15 @@ _mesa_unlock_debug_state(struct gl_context *ctx)
 bool
 _mesa_set_debug_state_int(struct gl_context *ctx, GLenum pname, GLint val)
 {
-   struct gl_debug_state *debug = _mesa_lock_debug_state(ctx);
+   struct gl_debug_state *debug;
+
+   /* Shader compiles in the background may log messages, see
+    * _mesa_debug_output_is_synchronous().
+    */
+   if (pname == GL_DEBUG_OUTPUT_SYNCHRONOUS_ARB && val)
+      _mesa_finish_shader_queue();
 
+   debug = _mesa_lock_debug_state(ctx);
    if (!debug)
       return false;
 
@@ -754,6 +762,24 @@ _mesa_set_debug_state_int(struct gl_context *ctx, GLenum pname, GLint val)
    return true;
 }
 
+/**
+ * Whether debug messages must be raised on the thread that made the GL
+ * call, so that work that may log some can't be deferred to another thread.
+ * That is the case with GL_DEBUG_OUTPUT_SYNCHRONOUS, and with a callback,
+ * which applications rarely expect to be called from other threads.
+ */
+bool
+_mesa_debug_output_is_synchronous(struct gl_context *ctx)
+{
+   bool sync;
+
+   mtx_lock(&ctx->DebugMutex);
+   sync = ctx->Debug && (ctx->Debug->SyncOutput || ctx->Debug->Callback);
+   mtx_unlock(&ctx->DebugMutex);
+
+   return sync;
+}
+
 /**
  * Query the integer debug state specified by \p pname.  This can be called
  * _mesa_GetIntegerv for example.
@@ -1153,7 +1179,13 @@ void GLAPIENTRY
 _mesa_DebugMessageCallback(GLDEBUGPROC callback, const void *userParam)
 {
    GET_CURRENT_CONTEXT(ctx);
-   struct gl_debug_state *debug = _mesa_lock_debug_state(ctx);
+   struct gl_debug_state *debug;
+
+   /* No compile in the background may call the new callback. */
+   if (callback)
+      _mesa_finish_shader_queue();
+
+   debug = _mesa_lock_debug_state(ctx);
    if (debug) {
       debug->Callback = callback;
       debug->CallbackData = userParam;
@@ -57,6 +57,9 @@ _mesa_get_debug_state_int(struct gl_context *ctx, GLenum pname);
 void *
 _mesa_get_debug_state_ptr(struct gl_context *ctx, GLenum pname);
 
+bool
+_mesa_debug_output_is_synchronous(struct gl_context *ctx);
+
 void
 _mesa_log_msg(struct gl_context *ctx, enum mesa_debug_source source,
               enum mesa_debug_type type, GLuint id,
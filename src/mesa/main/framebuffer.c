@@ -133,6 +133,7 @@ _mesa_initialize_window_framebuffer(struct gl_framebuffer *fb,
    mtx_init(&fb->Mutex, mtx_plain);
 
    fb->RefCount = 1;
+   fb->FlipY = GL_TRUE;
 
    /* save the visual */
    fb->Visual = *visual;
@@ -0,0 +1,272 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/** @file glthread.c
+ *
+ * Support functions for the glthread feature of Mesa.
+ *
+ * In multicore systems, many applications end up CPU-bound with about half
+ * their time spent inside their rendering thread and half inside Mesa.  To
+ * alleviate this, we put a shim layer in Mesa at the GL dispatch level that
+ * quickly logs the GL commands to a buffer to be processed by a worker
+ * thread.
+ */
+
+#include <stdio.h>
+#include <inttypes.h>
+
+#include "main/mtypes.h"
+#include "main/glthread.h"
+#include "main/marshal.h"
+#include "main/marshal_generated.h"
+#include "util/debug.h"
+#include "util/hash_table.h"
+#include "util/ralloc.h"
+
+
+static void
+glthread_unmarshal_batch(void *job, int thread_index)
+{
+   struct glthread_batch *batch = job;
+   struct gl_context *ctx = batch->ctx;
+   size_t pos = 0;
+
+   /* Mesa functions find the context and the dispatch table of the thread
+    * they run on.
+    */
+   _glapi_set_context(ctx);
+   _glapi_set_dispatch(ctx->CurrentDispatch);
+
+   while (pos < batch->used)
+      pos += _mesa_unmarshal_dispatch_cmd(ctx, (uint8_t *) batch->buffer + pos);
+
+   assert(pos == batch->used);
+   batch->used = 0;
+}
+
+
+void
+_mesa_glthread_init(struct gl_context *ctx)
+{
+   struct glthread_state *glthread;
+   unsigned i;
+
+   if (ctx->GLThread)
+      return;
+
+   /* Debug output must reach the callback from the thread that made the
+    * call, which a debug context may rely on.  Other contexts stop
+    * marshalling once the application touches the debug output, see
+    * _mesa_glthread_disable().
+    */
+   if (ctx->Const.ContextFlags & GL_CONTEXT_FLAG_DEBUG_BIT)
+      return;
+
+   glthread = calloc(1, sizeof(*glthread));
+   if (!glthread)
+      return;
+
+   ctx->MarshalExec = _mesa_create_marshal_table(ctx);
+   if (!ctx->MarshalExec) {
+      free(glthread);
+      return;
+   }
+
+   glthread->vaos = _mesa_hash_table_create(NULL, _mesa_hash_pointer,
+                                            _mesa_key_pointer_equal);
+   if (!glthread->vaos ||
+       !util_queue_init(&glthread->queue, "glthread", MARSHAL_MAX_BATCHES, 1)) {
+      _mesa_hash_table_destroy(glthread->vaos, NULL);
+      free(ctx->MarshalExec);
+      ctx->MarshalExec = NULL;
+      free(glthread);
+      return;
+   }
+
+   for (i = 0; i < MARSHAL_MAX_BATCHES; i++) {
+      glthread->batches[i].ctx = ctx;
+      util_queue_fence_init(&glthread->batches[i].fence);
+   }
+   glthread->vao = &glthread->default_vao;
+
+   ctx->GLThread = glthread;
+
+   /* The worker starts with the context's state, so it has nothing to
+    * catch up with.  Install the marshalling table if the context is
+    * current on this thread.
+    */
+   if (_glapi_get_context() == ctx)
+      _glapi_set_dispatch(ctx->MarshalExec);
+}
+
+
+static void
+glthread_print_stats(struct gl_context *ctx)
+{
+   const struct glthread_stats *stats = &ctx->GLThread->stats;
+   uint64_t syncs = 0;
+   unsigned i;
+
+   for (i = 0; i < NUM_DISPATCH_CMD; i++)
+      syncs += stats->sync_calls[i];
+
+   fprintf(stderr, "glthread: %" PRIu64 " batches, %" PRIu64 " asynchronous "
+           "calls, %" PRIu64 " sync points, %" PRIu64 " with the worker "
+           "busy\n", stats->batches, stats->async_calls, syncs,
+           stats->stalls);
+
+   for (i = 0; i < NUM_DISPATCH_CMD; i++) {
+      if (stats->sync_calls[i]) {
+         fprintf(stderr, "glthread:   %-40s %10" PRIu64 "\n",
+                 _mesa_marshal_cmd_names[i], stats->sync_calls[i]);
+      }
+   }
+}
+
+
+void
+_mesa_glthread_destroy(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   unsigned i;
+
+   if (!glthread)
+      return;
+
+   _mesa_glthread_finish(ctx);
+
+   if (env_var_as_boolean("MESA_GLTHREAD_STATS", false))
+      glthread_print_stats(ctx);
+
+   util_queue_destroy(&glthread->queue);
+   for (i = 0; i < MARSHAL_MAX_BATCHES; i++)
+      util_queue_fence_destroy(&glthread->batches[i].fence);
+
+   _mesa_hash_table_destroy(glthread->vaos, NULL);
+   free(glthread);
+   ctx->GLThread = NULL;
+
+   _mesa_glthread_restore_dispatch(ctx);
+}
+
+
+/**
+ * Stops marshalling for good, e.g. because the application set a debug
+ * message callback.  Called by the application thread from a marshal
+ * function, after which the context uses direct dispatch.
+ */
+void
+_mesa_glthread_disable(struct gl_context *ctx)
+{
+   _mesa_glthread_destroy(ctx);
+}
+
+
+/**
+ * Reinstalls the dispatch table that executes the calls directly, for when
+ * the marshalling thread is stopped.
+ */
+void
+_mesa_glthread_restore_dispatch(struct gl_context *ctx)
+{
+   /* Remove ourselves from the dispatch table except if another ctx/thread
+    * already installed a new dispatch table.
+    *
+    * Typically glxMakeCurrent will bind a new context (install new table) then
+    * old context might be deleted.
+    */
+   if (_glapi_get_dispatch() == ctx->MarshalExec)
+      _glapi_set_dispatch(ctx->CurrentDispatch);
+
+   free(ctx->MarshalExec);
+   ctx->MarshalExec = NULL;
+}
+
+
+/**
+ * Hands the batch being filled to the worker, and waits until the next one
+ * is free.
+ */
+void
+_mesa_glthread_flush_batch(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   struct glthread_batch *batch;
+
+   if (!glthread)
+      return;
+
+   batch = &glthread->batches[glthread->next];
+   if (!batch->used)
+      return;
+
+   util_queue_add_job(&glthread->queue, batch, &batch->fence,
+                      glthread_unmarshal_batch, NULL);
+   glthread->stats.batches++;
+   glthread->last = glthread->next;
+   glthread->next = (glthread->next + 1) % MARSHAL_MAX_BATCHES;
+
+   util_queue_job_wait(&glthread->batches[glthread->next].fence);
+}
+
+
+/**
+ * Waits for all pending batches to be executed.  After this, the worker is
+ * idle and the context may be used on the application thread.
+ */
+void
+_mesa_glthread_finish(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   struct glthread_batch *last;
+
+   if (!glthread)
+      return;
+
+   /* The worker may get here through a driver callback.  There is nothing
+    * to wait for, and waiting for itself would deadlock.
+    */
+   if (thrd_equal(glthread->queue.threads[0], thrd_current()))
+      return;
+
+   _mesa_glthread_flush_batch(ctx);
+
+   last = &glthread->batches[glthread->last];
+   if (!util_queue_fence_is_signalled(&last->fence))
+      glthread->stats.stalls++;
+
+   /* Batches are executed in order, so the last one is enough. */
+   util_queue_job_wait(&last->fence);
+}
+
+
+/**
+ * Called before a call that is executed on the application thread.
+ */
+void
+_mesa_glthread_finish_before(struct gl_context *ctx,
+                             enum marshal_dispatch_cmd_id cmd_id)
+{
+   ctx->GLThread->stats.sync_calls[cmd_id]++;
+   _mesa_glthread_finish(ctx);
+}
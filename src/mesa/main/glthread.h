@@ -0,0 +1,180 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file glthread.h
+ * Optional marshalling thread for the GL API.
+ *
+ * When enabled, the application thread dispatches into ctx->MarshalExec.
+ * Those functions copy each call into a batch, and the batches are
+ * executed on a worker thread through ctx->CurrentDispatch, so the API
+ * entry points, state validation and draw calls of Mesa and the driver run
+ * in parallel with the application.  Calls that return data, or read
+ * application memory whose size is unknown, drain the worker first and run
+ * on the application thread.  Those are the sync points.
+ */
+
+#ifndef _GLTHREAD_H
+#define _GLTHREAD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "main/config.h"
+#include "main/glheader.h"
+#include "main/marshal_generated.h"
+#include "util/u_queue.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct gl_context;
+struct hash_table;
+
+/** Size of a batch.  Larger commands are executed synchronously. */
+#define MARSHAL_MAX_CMD_SIZE (8 * 1024)
+
+/**
+ * Number of batches.  The application thread can get this many batches
+ * ahead of the worker before it blocks.
+ */
+#define MARSHAL_MAX_BATCHES 4
+
+struct glthread_batch
+{
+   struct gl_context *ctx;
+
+   /** Signalled once the worker has executed the batch. */
+   struct util_queue_fence fence;
+
+   /** Number of bytes of the buffer that are in use. */
+   size_t used;
+
+   /** The commands, 8-byte aligned. */
+   uint64_t buffer[MARSHAL_MAX_CMD_SIZE / 8];
+};
+
+/**
+ * The state of a vertex array object that the application thread tracks,
+ * to find out whether a draw call reads application memory.
+ */
+struct glthread_vao
+{
+   GLuint name;
+
+   /** The element array buffer binding. */
+   GLuint element_array_buffer;
+
+   /**
+    * Whether an array of the object has ever been given a pointer into
+    * application memory.  Never cleared.
+    */
+   bool has_user_arrays;
+};
+
+/** The tracked state saved by glPushClientAttrib. */
+struct glthread_client_attrib
+{
+   /** Whether GL_CLIENT_VERTEX_ARRAY_BIT was pushed. */
+   bool valid;
+
+   GLuint vao;
+   GLuint array_buffer;
+   GLuint element_array_buffer;
+   bool has_user_arrays;
+};
+
+struct glthread_stats
+{
+   /** Batches handed to the worker. */
+   uint64_t batches;
+
+   /** Calls executed on the worker. */
+   uint64_t async_calls;
+
+   /** Sync points, per function. */
+   uint64_t sync_calls[NUM_DISPATCH_CMD];
+
+   /** Sync points at which the worker was still busy. */
+   uint64_t stalls;
+};
+
+struct glthread_state
+{
+   /** The worker thread. */
+   struct util_queue queue;
+
+   struct glthread_batch batches[MARSHAL_MAX_BATCHES];
+
+   /** The batch being filled. */
+   unsigned next;
+
+   /** The batch submitted last. */
+   unsigned last;
+
+   /** GL_ARRAY_BUFFER binding, as seen by the application thread. */
+   GLuint array_buffer;
+
+   /** The bound vertex array object, as seen by the application thread. */
+   struct glthread_vao *vao;
+
+   struct glthread_vao default_vao;
+
+   /** Vertex array objects by name. */
+   struct hash_table *vaos;
+
+   struct glthread_client_attrib client_attrib_stack[MAX_CLIENT_ATTRIB_STACK_DEPTH];
+   unsigned client_attrib_depth;
+
+   struct glthread_stats stats;
+};
+
+void
+_mesa_glthread_init(struct gl_context *ctx);
+
+void
+_mesa_glthread_destroy(struct gl_context *ctx);
+
+void
+_mesa_glthread_disable(struct gl_context *ctx);
+
+void
+_mesa_glthread_flush_batch(struct gl_context *ctx);
+
+void
+_mesa_glthread_finish(struct gl_context *ctx);
+
+void
+_mesa_glthread_finish_before(struct gl_context *ctx,
+                             enum marshal_dispatch_cmd_id cmd_id);
+
+void
+_mesa_glthread_restore_dispatch(struct gl_context *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _GLTHREAD_H */
@@ -0,0 +1,128 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file index_scan.c
+ * Min/max and restart index searches over index buffers, using the SSE4.1
+ * or AVX2 kernels in sse_minmax.c and avx2_minmax.c when the CPU has them.
+ */
+
+#include <stdint.h>
+
+#include "main/index_scan.h"
+#include "main/sse_minmax.h"
+#include "x86/common_x86_asm.h"
+#include "util/u_index_range.h"
+
+
+/**
+ * Whether \p value can appear in indices of \p index_size bytes.
+ */
+static inline bool
+fits_index_size(unsigned value, unsigned index_size)
+{
+   return index_size == 4 || (value >> (8 * index_size)) == 0;
+}
+
+
+/**
+ * Find the min/max of \p count indices of \p index_size bytes, ignoring
+ * \p restart_index if \p restart is set.  If every index is a restart
+ * index, the minimum is ~0 and the maximum 0.
+ */
+void
+_mesa_index_min_max(const void *indices, unsigned index_size, unsigned count,
+                    bool restart, unsigned restart_index,
+                    unsigned *min_index, unsigned *max_index)
+{
+   /* A restart index that doesn't fit in the type never matches. */
+   if (restart && !fits_index_size(restart_index, index_size))
+      restart = false;
+
+#if defined(USE_AVX2)
+   if (cpu_has_avx2) {
+      _mesa_avx2_index_min_max(indices, index_size, count, restart,
+                               restart_index, min_index, max_index);
+      return;
+   }
+#endif
+
+#if defined(USE_SSE41)
+   if (cpu_has_sse4_1) {
+      _mesa_sse41_index_min_max(indices, index_size, count, restart,
+                                restart_index, min_index, max_index);
+      return;
+   }
+#endif
+
+   util_index_range_scan(indices, index_size, count, restart, restart_index,
+                         min_index, max_index);
+}
+
+
+#define FIND_INDEX(TYPE)                                \
+   do {                                                 \
+      const TYPE *ind = (const TYPE *) indices;         \
+      for (i = 0; i < count; i++) {                     \
+         if (ind[i] == value)                           \
+            return i;                                   \
+      }                                                 \
+   } while (0)
+
+/**
+ * Return the position of the first index equal to \p value among \p count
+ * indices of \p index_size bytes, or \p count if there is none.
+ */
+unsigned
+_mesa_index_find(const void *indices, unsigned index_size, unsigned count,
+                 unsigned value)
+{
+   unsigned i;
+
+   if (!fits_index_size(value, index_size))
+      return count;
+
+#if defined(USE_AVX2)
+   if (cpu_has_avx2)
+      return _mesa_avx2_index_find(indices, index_size, count, value);
+#endif
+
+#if defined(USE_SSE41)
+   if (cpu_has_sse4_1)
+      return _mesa_sse41_index_find(indices, index_size, count, value);
+#endif
+
+   switch (index_size) {
+   case 1:
+      FIND_INDEX(uint8_t);
+      break;
+   case 2:
+      FIND_INDEX(uint16_t);
+      break;
+   default:
+      FIND_INDEX(uint32_t);
+      break;
+   }
+
+   return count;
+}
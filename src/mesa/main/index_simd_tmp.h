@@ -0,0 +1,179 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Index kernels shared by the SSE4.1 and AVX2 builds.  The including file
+ * defines the vector type and operations:
+ *
+ *    VEC                 the integer vector type
+ *    VEC_BYTES           its size in bytes
+ *    LOADU(p)            unaligned load
+ *    STOREU(p, v)        unaligned store
+ *    SET1_8/16/32(x)     broadcast
+ *    ZERO()              all zeros
+ *    MIN_8/16/32(a, b)   unsigned minimum
+ *    MAX_8/16/32(a, b)   unsigned maximum
+ *    CMPEQ_8/16/32(a, b) lane-wise equality mask
+ *    OR(a, b), ANDNOT(a, b) (~a & b)
+ *    MOVEMASK(v)         mask of the top bit of every byte
+ *    FUNC(name)          the name of an exported function
+ *
+ * Restart indices are removed from the min/max by or'ing them with all ones
+ * for the minimum and clearing them for the maximum, so the loops don't
+ * branch on them.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "util/bitscan.h"
+
+#define DEFINE_KERNELS(BITS, TYPE)                                        \
+static void                                                               \
+FUNC(min_max_u##BITS)(const TYPE *indices, unsigned count,                \
+                      bool restart, TYPE restart_index,                   \
+                      unsigned *min_index, unsigned *max_index)           \
+{                                                                         \
+   const unsigned lanes = VEC_BYTES / sizeof(TYPE);                       \
+   TYPE min = (TYPE) ~0u, max = 0;                                        \
+   unsigned i = 0;                                                        \
+                                                                          \
+   if (count >= 2 * lanes) {                                              \
+      TYPE min_arr[VEC_BYTES / sizeof(TYPE)];                             \
+      TYPE max_arr[VEC_BYTES / sizeof(TYPE)];                             \
+      VEC vmin0 = SET1_##BITS((TYPE) ~0u), vmin1 = vmin0;                 \
+      VEC vmax0 = ZERO(), vmax1 = vmax0;                                  \
+      unsigned j;                                                         \
+                                                                          \
+      /* Two accumulators to hide the latency of min and max. */          \
+      if (restart) {                                                      \
+         const VEC vrestart = SET1_##BITS(restart_index);                 \
+                                                                          \
+         for (; i + 2 * lanes <= count; i += 2 * lanes) {                 \
+            VEC v0 = LOADU(indices + i);                                  \
+            VEC v1 = LOADU(indices + i + lanes);                          \
+            VEC m0 = CMPEQ_##BITS(v0, vrestart);                          \
+            VEC m1 = CMPEQ_##BITS(v1, vrestart);                          \
+            vmin0 = MIN_##BITS(vmin0, OR(v0, m0));                        \
+            vmin1 = MIN_##BITS(vmin1, OR(v1, m1));                        \
+            vmax0 = MAX_##BITS(vmax0, ANDNOT(m0, v0));                    \
+            vmax1 = MAX_##BITS(vmax1, ANDNOT(m1, v1));                    \
+         }                                                                \
+      } else {                                                            \
+         for (; i + 2 * lanes <= count; i += 2 * lanes) {                 \
+            VEC v0 = LOADU(indices + i);                                  \
+            VEC v1 = LOADU(indices + i + lanes);                          \
+            vmin0 = MIN_##BITS(vmin0, v0);                                \
+            vmin1 = MIN_##BITS(vmin1, v1);                                \
+            vmax0 = MAX_##BITS(vmax0, v0);                                \
+            vmax1 = MAX_##BITS(vmax1, v1);                                \
+         }                                                                \
+      }                                                                   \
+                                                                          \
+      STOREU(min_arr, MIN_##BITS(vmin0, vmin1));                          \
+      STOREU(max_arr, MAX_##BITS(vmax0, vmax1));                          \
+      for (j = 0; j < lanes; j++) {                                       \
+         if (min_arr[j] < min) min = min_arr[j];                          \
+         if (max_arr[j] > max) max = max_arr[j];                          \
+      }                                                                   \
+   }                                                                      \
+                                                                          \
+   for (; i < count; i++) {                                               \
+      if (restart && indices[i] == restart_index)                         \
+         continue;                                                        \
+      if (indices[i] < min) min = indices[i];                             \
+      if (indices[i] > max) max = indices[i];                             \
+   }                                                                      \
+                                                                          \
+   /* Only restart indices: the minimum must stay ~0 for every type. */   \
+   *min_index = min == (TYPE) ~0u && max == 0 ? ~0u : min;                \
+   *max_index = max;                                                      \
+}                                                                         \
+                                                                          \
+static unsigned                                                           \
+FUNC(find_u##BITS)(const TYPE *indices, unsigned count, TYPE value)       \
+{                                                                         \
+   const unsigned lanes = VEC_BYTES / sizeof(TYPE);                       \
+   const VEC vvalue = SET1_##BITS(value);                                 \
+   unsigned i = 0;                                                        \
+                                                                          \
+   for (; i + lanes <= count; i += lanes) {                               \
+      unsigned mask = MOVEMASK(CMPEQ_##BITS(LOADU(indices + i), vvalue)); \
+      if (mask)                                                           \
+         return i + (ffs(mask) - 1) / sizeof(TYPE);                       \
+   }                                                                      \
+                                                                          \
+   for (; i < count; i++) {                                               \
+      if (indices[i] == value)                                            \
+         return i;                                                        \
+   }                                                                      \
+                                                                          \
+   return count;                                                          \
+}
+
+DEFINE_KERNELS(8, uint8_t)
+DEFINE_KERNELS(16, uint16_t)
+DEFINE_KERNELS(32, uint32_t)
+
+#undef DEFINE_KERNELS
+
+/**
+ * See _mesa_index_min_max().  \p restart_index must fit in the index type.
+ */
+void
+FUNC(index_min_max)(const void *indices, unsigned index_size, unsigned count,
+                    bool restart, unsigned restart_index,
+                    unsigned *min_index, unsigned *max_index)
+{
+   switch (index_size) {
+   case 1:
+      FUNC(min_max_u8)(indices, count, restart, restart_index,
+                       min_index, max_index);
+      break;
+   case 2:
+      FUNC(min_max_u16)(indices, count, restart, restart_index,
+                        min_index, max_index);
+      break;
+   default:
+      FUNC(min_max_u32)(indices, count, restart, restart_index,
+                        min_index, max_index);
+      break;
+   }
+}
+
+/**
+ * See _mesa_index_find().  \p value must fit in the index type.
+ */
+unsigned
+FUNC(index_find)(const void *indices, unsigned index_size, unsigned count,
+                 unsigned value)
+{
+   switch (index_size) {
+   case 1:
+      return FUNC(find_u8)(indices, count, value);
+   case 2:
+      return FUNC(find_u16)(indices, count, value);
+   default:
+      return FUNC(find_u32)(indices, count, value);
+   }
+}
@@ -0,0 +1,256 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/** \file marshal.c
+ *
+ * The state that the application thread tracks for the marshalling
+ * thread.  Draw calls are executed synchronously if they may read vertices
+ * or indices from application memory, because the application is free to
+ * change that memory as soon as the call returns.  To know that, the
+ * application thread follows the buffer bindings of the vertex array
+ * objects.  The tracking is conservative: when in doubt, a draw call is
+ * executed synchronously.
+ */
+
+#include "main/marshal.h"
+#include "util/hash_table.h"
+#include "util/ralloc.h"
+
+
+static struct glthread_vao *
+lookup_vao(struct gl_context *ctx, GLuint name)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   struct hash_entry *entry;
+   struct glthread_vao *vao;
+
+   if (name == 0)
+      return &glthread->default_vao;
+
+   entry = _mesa_hash_table_search(glthread->vaos, (void *) (uintptr_t) name);
+   if (entry)
+      return entry->data;
+
+   vao = rzalloc(glthread->vaos, struct glthread_vao);
+   vao->name = name;
+   _mesa_hash_table_insert(glthread->vaos, (void *) (uintptr_t) name, vao);
+   return vao;
+}
+
+
+void
+_mesa_glthread_BindBuffer(struct gl_context *ctx, GLenum target,
+                          GLuint buffer)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   switch (target) {
+   case GL_ARRAY_BUFFER:
+      glthread->array_buffer = buffer;
+      break;
+   case GL_ELEMENT_ARRAY_BUFFER:
+      glthread->vao->element_array_buffer = buffer;
+      break;
+   }
+}
+
+
+void
+_mesa_glthread_DeleteBuffers(struct gl_context *ctx, GLsizei n,
+                             const GLuint *buffers)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   GLsizei i;
+
+   if (n < 0 || !buffers)
+      return;
+
+   /* Deleting a bound buffer unbinds it from the context and from the
+    * bound vertex array object.
+    */
+   for (i = 0; i < n; i++) {
+      if (buffers[i] == 0)
+         continue;
+      if (buffers[i] == glthread->array_buffer)
+         glthread->array_buffer = 0;
+      if (buffers[i] == glthread->vao->element_array_buffer)
+         glthread->vao->element_array_buffer = 0;
+   }
+}
+
+
+void
+_mesa_glthread_BindVertexArray(struct gl_context *ctx, GLuint array)
+{
+   ctx->GLThread->vao = lookup_vao(ctx, array);
+}
+
+
+void
+_mesa_glthread_DeleteVertexArrays(struct gl_context *ctx, GLsizei n,
+                                  const GLuint *arrays)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   GLsizei i;
+
+   if (n < 0 || !arrays)
+      return;
+
+   for (i = 0; i < n; i++) {
+      struct hash_entry *entry;
+
+      if (arrays[i] == 0)
+         continue;
+
+      entry = _mesa_hash_table_search(glthread->vaos,
+                                      (void *) (uintptr_t) arrays[i]);
+      if (!entry)
+         continue;
+
+      /* Deleting the bound object binds the default one. */
+      if (glthread->vao == entry->data)
+         glthread->vao = &glthread->default_vao;
+
+      ralloc_free(entry->data);
+      _mesa_hash_table_remove(glthread->vaos, entry);
+   }
+}
+
+
+void
+_mesa_glthread_VertexArrayElementBuffer(struct gl_context *ctx,
+                                        GLuint vaobj, GLuint buffer)
+{
+   lookup_vao(ctx, vaobj)->element_array_buffer = buffer;
+}
+
+
+/**
+ * Called after the gl*Pointer functions.  Without a bound GL_ARRAY_BUFFER,
+ * the pointer is the address of the array in application memory.
+ */
+void
+_mesa_glthread_AttribPointer(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (glthread->array_buffer == 0)
+      glthread->vao->has_user_arrays = true;
+}
+
+
+void
+_mesa_glthread_BindVertexBuffer(struct gl_context *ctx, GLuint buffer)
+{
+   if (buffer == 0)
+      ctx->GLThread->vao->has_user_arrays = true;
+}
+
+
+void
+_mesa_glthread_VertexArrayVertexBuffer(struct gl_context *ctx, GLuint vaobj,
+                                       GLuint buffer)
+{
+   if (buffer == 0)
+      lookup_vao(ctx, vaobj)->has_user_arrays = true;
+}
+
+
+/**
+ * A NULL \p buffers unbinds all the bindings, which then source user
+ * arrays like a zero buffer does.
+ */
+static bool
+binds_user_arrays(GLsizei count, const GLuint *buffers)
+{
+   GLsizei i;
+
+   if (!buffers)
+      return count > 0;
+
+   for (i = 0; i < count; i++) {
+      if (buffers[i] == 0)
+         return true;
+   }
+   return false;
+}
+
+
+void
+_mesa_glthread_BindVertexBuffers(struct gl_context *ctx, GLsizei count,
+                                 const GLuint *buffers)
+{
+   if (binds_user_arrays(count, buffers))
+      ctx->GLThread->vao->has_user_arrays = true;
+}
+
+
+void
+_mesa_glthread_VertexArrayVertexBuffers(struct gl_context *ctx, GLuint vaobj,
+                                        GLsizei count, const GLuint *buffers)
+{
+   if (binds_user_arrays(count, buffers))
+      lookup_vao(ctx, vaobj)->has_user_arrays = true;
+}
+
+
+void
+_mesa_glthread_PushClientAttrib(struct gl_context *ctx, GLbitfield mask)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   struct glthread_client_attrib *attrib;
+
+   if (glthread->client_attrib_depth >= MAX_CLIENT_ATTRIB_STACK_DEPTH)
+      return;
+
+   attrib = &glthread->client_attrib_stack[glthread->client_attrib_depth++];
+   attrib->valid = (mask & GL_CLIENT_VERTEX_ARRAY_BIT) != 0;
+   attrib->vao = glthread->vao->name;
+   attrib->array_buffer = glthread->array_buffer;
+   attrib->element_array_buffer = glthread->vao->element_array_buffer;
+   attrib->has_user_arrays = glthread->vao->has_user_arrays;
+}
+
+
+/**
+ * glPopClientAttrib binds the saved vertex array object and buffers, and
+ * copies the saved arrays back into the object.
+ */
+void
+_mesa_glthread_PopClientAttrib(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   struct glthread_client_attrib *attrib;
+
+   if (glthread->client_attrib_depth == 0)
+      return;
+
+   attrib = &glthread->client_attrib_stack[--glthread->client_attrib_depth];
+   if (!attrib->valid)
+      return;
+
+   glthread->vao = lookup_vao(ctx, attrib->vao);
+   glthread->array_buffer = attrib->array_buffer;
+   glthread->vao->element_array_buffer = attrib->element_array_buffer;
+   glthread->vao->has_user_arrays |= attrib->has_user_arrays;
+}
@@ -0,0 +1,193 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/** \file marshal.h
+ *
+ * Declarations of functions related to marshalling GL calls from a client
+ * thread to a server thread.
+ */
+
+#ifndef MARSHAL_H
+#define MARSHAL_H
+
+#include <limits.h>
+
+#include "main/context.h"
+#include "main/glthread.h"
+#include "main/macros.h"
+#include "main/marshal_generated.h"
+
+struct marshal_cmd_base
+{
+   /** Type of command.  See enum marshal_dispatch_cmd_id. */
+   uint16_t cmd_id;
+
+   /** Size of the command, in bytes, including this header. */
+   uint16_t cmd_size;
+};
+
+static inline void *
+_mesa_glthread_allocate_command(struct gl_context *ctx,
+                                enum marshal_dispatch_cmd_id cmd_id,
+                                size_t size)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   struct glthread_batch *batch = &glthread->batches[glthread->next];
+   const size_t aligned_size = ALIGN(size, 8);
+   struct marshal_cmd_base *cmd_base;
+
+   if (unlikely(batch->used + aligned_size > MARSHAL_MAX_CMD_SIZE)) {
+      _mesa_glthread_flush_batch(ctx);
+      batch = &glthread->batches[glthread->next];
+   }
+
+   cmd_base = (struct marshal_cmd_base *)
+      ((uint8_t *) batch->buffer + batch->used);
+   batch->used += aligned_size;
+   cmd_base->cmd_id = cmd_id;
+   cmd_base->cmd_size = aligned_size;
+   glthread->stats.async_calls++;
+   return cmd_base;
+}
+
+/**
+ * Called after a synchronous call returns.  The call may have installed
+ * another dispatch table for this thread, e.g. the context lost table, but
+ * the application thread must keep marshalling.
+ */
+static inline void
+_mesa_glthread_finish_after(struct gl_context *ctx)
+{
+   if (ctx->GLThread)
+      _glapi_set_dispatch(ctx->MarshalExec);
+}
+
+/**
+ * Returns the size in bytes of \p count elements of \p size bytes, or -1
+ * if \p count is negative or the size doesn't fit in an int.  The call is
+ * then executed synchronously, which reports the error if there is one.
+ */
+static inline int
+safe_mul(GLsizeiptr count, int size)
+{
+   if (count < 0 || count > INT_MAX / size)
+      return -1;
+   return count * size;
+}
+
+/**
+ * Whether a draw call reads vertices from application memory, which may
+ * change as soon as the call returns.  Only the core profile forbids
+ * client-side arrays.
+ */
+static inline bool
+_mesa_glthread_draw_needs_sync(const struct gl_context *ctx)
+{
+   return ctx->API != API_OPENGL_CORE && ctx->GLThread->vao->has_user_arrays;
+}
+
+/**
+ * Whether an indexed draw call reads vertices or indices from application
+ * memory.
+ */
+static inline bool
+_mesa_glthread_draw_elements_needs_sync(const struct gl_context *ctx)
+{
+   return ctx->API != API_OPENGL_CORE &&
+          (ctx->GLThread->vao->has_user_arrays ||
+           ctx->GLThread->vao->element_array_buffer == 0);
+}
+
+/**
+ * Whether glEnable/glDisable of \p cap changes how the application gets
+ * debug messages.  Those calls are executed synchronously.
+ */
+static inline bool
+_mesa_glthread_is_debug_output_cap(GLenum cap)
+{
+   return cap == GL_DEBUG_OUTPUT || cap == GL_DEBUG_OUTPUT_SYNCHRONOUS;
+}
+
+/**
+ * Called after glEnable and glDisable.  Debug messages must reach the
+ * application's callback on the thread that made the call, and in order
+ * with GL_DEBUG_OUTPUT_SYNCHRONOUS, so once the application touches the
+ * debug output, the calls are executed directly.
+ */
+static inline void
+_mesa_glthread_EnableDisable(struct gl_context *ctx, GLenum cap)
+{
+   if (_mesa_glthread_is_debug_output_cap(cap))
+      _mesa_glthread_disable(ctx);
+}
+
+struct _glapi_table *
+_mesa_create_marshal_table(const struct gl_context *ctx);
+
+size_t
+_mesa_unmarshal_dispatch_cmd(struct gl_context *ctx, const void *cmd);
+
+void
+_mesa_glthread_BindBuffer(struct gl_context *ctx, GLenum target,
+                          GLuint buffer);
+
+void
+_mesa_glthread_DeleteBuffers(struct gl_context *ctx, GLsizei n,
+                             const GLuint *buffers);
+
+void
+_mesa_glthread_BindVertexArray(struct gl_context *ctx, GLuint array);
+
+void
+_mesa_glthread_DeleteVertexArrays(struct gl_context *ctx, GLsizei n,
+                                  const GLuint *arrays);
+
+void
+_mesa_glthread_VertexArrayElementBuffer(struct gl_context *ctx,
+                                        GLuint vaobj, GLuint buffer);
+
+void
+_mesa_glthread_AttribPointer(struct gl_context *ctx);
+
+void
+_mesa_glthread_BindVertexBuffer(struct gl_context *ctx, GLuint buffer);
+
+void
+_mesa_glthread_VertexArrayVertexBuffer(struct gl_context *ctx, GLuint vaobj,
+                                       GLuint buffer);
+
+void
+_mesa_glthread_BindVertexBuffers(struct gl_context *ctx, GLsizei count,
+                                 const GLuint *buffers);
+
+void
+_mesa_glthread_VertexArrayVertexBuffers(struct gl_context *ctx, GLuint vaobj,
+                                        GLsizei count, const GLuint *buffers);
+
+void
+_mesa_glthread_PushClientAttrib(struct gl_context *ctx, GLbitfield mask);
+
+void
+_mesa_glthread_PopClientAttrib(struct gl_context *ctx);
+
+#endif /* MARSHAL_H */
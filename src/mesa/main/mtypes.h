@@ -45,6 +45,7 @@
 #include "compiler/shader_enums.h"
 #include "main/formats.h"       /* MESA_FORMAT_COUNT */
 #include "compiler/glsl/list.h"
+#include "util/u_queue.h"
 
 
 #ifdef __cplusplus
@@ -80,12 +81,14 @@ struct gl_program_cache;
 struct gl_texture_object;
 struct gl_debug_state;
 struct gl_context;
+struct glthread_state;
 struct st_context;
 struct gl_uniform_storage;
 struct prog_instruction;
 struct gl_program_parameter_list;
 struct set;
 struct set_entry;
+struct util_index_range_tree;
 struct vbo_context;
 /*@}*/
 
@@ -957,6 +960,13 @@ struct gl_sampler_object
    GLenum CompareFunc;		/**< GL_ARB_shadow */
    GLenum sRGBDecode;           /**< GL_DECODE_EXT or GL_SKIP_DECODE_EXT */
    GLboolean CubeMapSeamless;   /**< GL_AMD_seamless_cubemap_per_texture */
+
+   /**
+    * Globally unique number which changes whenever any of the fields above
+    * do, see _mesa_sampler_state_changed().  Lets drivers tell whether
+    * state they derived from this object is still current.
+    */
+   GLuint StateSeqNo;
 };
 
 
@@ -1186,6 +1196,12 @@ struct gl_texture_attrib
    /** Largest index + 1 of texture units that have had any CurrentTex set. */
    GLint NumCurrentTexUsed;
 
+   /**
+    * Units whose texture or sampler binding changed, see
+    * _NEW_TEXTURE_BINDINGS.  Cleared by _mesa_update_state().
+    */
+   GLbitfield _DirtyUnits[(MAX_COMBINED_TEXTURE_IMAGE_UNITS + 31) / 32];
+
    struct gl_texture_unit Unit[MAX_COMBINED_TEXTURE_IMAGE_UNITS];
 };
 
@@ -1285,11 +1301,13 @@ struct gl_buffer_object
 
    struct gl_buffer_mapping Mappings[MAP_COUNT];
 
-   /** Memoization of min/max index computations for static index buffers */
-   struct hash_table *MinMaxCache;
+   /**
+    * Per-block min/max indices, for computing the index bounds of any range
+    * of the buffer.  Protected by Mutex.
+    */
+   struct util_index_range_tree *MinMaxCache;
    unsigned MinMaxCacheHitIndices;
    unsigned MinMaxCacheMissIndices;
-   bool MinMaxCacheDirty;
 };
 
 
@@ -2460,6 +2478,38 @@ struct gl_shader
    GLuint SourceChecksum;       /**< for debug/logging purposes */
    const GLchar *Source;  /**< Source code string */
 
+   /**
+    * SHA-1 of the compiled source and the context state affecting it,
+    * used as a key in the program cache (see program/shader_cache.h).
+    */
+   unsigned char sha1[20];
+
+   /**
+    * True if glCompileShader() was satisfied by the program cache without
+    * running the compiler, in which case \c ir is NULL and the shader must
+    * be compiled for real if a link misses the cache.
+    */
+   bool CompileSkipped;
+
+   /**
+    * The source that was compiled when CompileSkipped is set, if it has been
+    * replaced by glShaderSource() since.
+    */
+   const GLchar *FallbackSource;
+
+   /**
+    * Signalled when a compile done on the shader compiler queue completes
+    * (see GL_ARB_parallel_shader_compile).  Everything below, as well as
+    * CompileStatus, may only be accessed once it is.
+    */
+   struct util_queue_fence CompileFence;
+
+   /**
+    * Number of links on the shader compiler queue that read this shader.
+    * The shader may not be changed while this is non-zero.
+    */
+   int PendingLinks;
+
    GLchar *InfoLog;
 
    unsigned Version;       /**< GLSL version used for linking */
@@ -2839,6 +2889,20 @@ struct gl_shader_program
    unsigned NumAtomicBuffers;
 
    GLboolean LinkStatus;   /**< GL_LINK_STATUS */
+
+   /**
+    * Signalled when the part of a link done on the shader compiler queue
+    * completes.
+    */
+   struct util_queue_fence LinkFence;
+
+   /**
+    * True if the program was queued for linking, and the remaining part of
+    * the link (the driver back end) hasn't been done yet.  See
+    * _mesa_finish_link_program().
+    */
+   GLboolean LinkPending;
+
    GLboolean Validated;
    GLboolean _Used;        /**< Ever used for drawing? */
    GLboolean SamplersValidated; /**< Samplers validated against texture units? */
@@ -3216,6 +3280,14 @@ struct gl_framebuffer
    GLuint Name;
    GLint RefCount;
 
+   /**
+    * Whether the rows are stored top to bottom, i.e. whether Y has to be
+    * inverted when rendering into and reading from the buffers.  This is
+    * true for window system framebuffers unless the window system says
+    * otherwise, and false for FBOs.
+    */
+   GLboolean FlipY;
+
    GLchar *Label;       /**< GL_KHR_debug */
 
    GLboolean DeletePending;
@@ -4033,10 +4105,10 @@ struct gl_matrix_stack
 #define _NEW_POLYGONSTIPPLE    (1u << 13)  /**< gl_context::PolygonStipple */
 #define _NEW_SCISSOR           (1u << 14)  /**< gl_context::Scissor */
 #define _NEW_STENCIL           (1u << 15)  /**< gl_context::Stencil */
-#define _NEW_TEXTURE           (1u << 16)  /**< gl_context::Texture */
+#define _NEW_TEXTURE_STATE     (1u << 16)  /**< gl_context::Texture */
 #define _NEW_TRANSFORM         (1u << 17)  /**< gl_context::Transform */
 #define _NEW_VIEWPORT          (1u << 18)  /**< gl_context::Viewport */
-/* gap, re-use for core Mesa state only; use ctx->DriverFlags otherwise */
+#define _NEW_TEXTURE_BINDINGS  (1u << 19)  /**< gl_texture_attrib::_DirtyUnits */
 #define _NEW_ARRAY             (1u << 20)  /**< gl_context::Array */
 #define _NEW_RENDERMODE        (1u << 21)  /**< gl_context::RenderMode, etc */
 #define _NEW_BUFFERS           (1u << 22)  /**< gl_context::Visual, DrawBuffer, */
@@ -4050,6 +4122,14 @@ struct gl_matrix_stack
 /* gap, re-use for core Mesa state only; use ctx->DriverFlags otherwise */
 #define _NEW_VARYING_VP_INPUTS (1u << 31) /**< gl_context::varying_vp_inputs */
 #define _NEW_ALL ~0
+
+/**
+ * Any texture state.  Code which only changes the texture or sampler
+ * objects bound to some units flags _NEW_TEXTURE_BINDINGS and sets the
+ * units in gl_texture_attrib::_DirtyUnits instead, so that drivers can
+ * limit their updates to those units.
+ */
+#define _NEW_TEXTURE           (_NEW_TEXTURE_STATE | _NEW_TEXTURE_BINDINGS)
 /*@}*/
 
 
@@ -4353,11 +4433,20 @@ struct gl_context
    struct _glapi_table *ContextLost;
    /**
     * Tracks the current dispatch table out of the 4 above, so that it can be
-    * re-set on glXMakeCurrent().
+    * re-set on glXMakeCurrent().  With the marshalling thread, this is the
+    * table that the worker executes the calls through.
     */
    struct _glapi_table *CurrentDispatch;
+   /**
+    * The dispatch table installed on the application thread when the
+    * marshalling thread is running.  See glthread.h.
+    */
+   struct _glapi_table *MarshalExec;
    /*@}*/
 
+   /** The marshalling thread, or NULL. */
+   struct glthread_state *GLThread;
+
    struct gl_config Visual;
    struct gl_framebuffer *DrawBuffer;	/**< buffer for writing */
    struct gl_framebuffer *ReadBuffer;	/**< buffer for reading */
@@ -4484,6 +4573,16 @@ struct gl_context
     */
    struct gl_pipeline_object *_Shader;
 
+   /**
+    * Maximum number of threads to use for compiling and linking shaders in
+    * the background (GL_ARB_parallel_shader_compile).  Zero means shaders
+    * are compiled and linked synchronously.
+    */
+   GLuint MaxShaderCompilerThreads;
+
+   /** Compiles and links of this context on the shader queue. */
+   GLuint ShaderQueueJobs;
+
    struct gl_query_state Query;  /**< occlusion, timer queries */
 
    struct gl_transform_feedback_state TransformFeedback;
@@ -4520,6 +4619,14 @@ struct gl_context
    struct gl_uniform_buffer_binding
       UniformBufferBindings[MAX_COMBINED_UNIFORM_BUFFERS];
 
+   /**
+    * UniformBufferBindings[] which changed, set along with
+    * DriverFlags.NewUniformBuffer.  Changes that may affect any binding
+    * point set all bits.  Drivers which track the bindings one by one clear
+    * it once they have seen it; others can ignore it.
+    */
+   GLbitfield NewUniformBufferBindings[(MAX_COMBINED_UNIFORM_BUFFERS + 31) / 32];
+
    /**
     * Array of shader storage buffers for ARB_shader_storage_buffer_object
     * and GL 4.3. This is set up using glBindBufferRange() or
@@ -4529,6 +4636,9 @@ struct gl_context
    struct gl_shader_storage_buffer_binding
       ShaderStorageBufferBindings[MAX_COMBINED_SHADER_STORAGE_BUFFERS];
 
+   /** Like NewUniformBufferBindings, for ShaderStorageBufferBindings[]. */
+   GLbitfield NewShaderStorageBufferBindings[(MAX_COMBINED_SHADER_STORAGE_BUFFERS + 31) / 32];
+
    /**
     * Object currently associated with the GL_ATOMIC_COUNTER_BUFFER
     * target.
@@ -38,6 +38,8 @@
 #include "main/macros.h"
 #include "main/mtypes.h"
 #include "main/samplerobj.h"
+#include "main/texstate.h"
+#include "util/u_atomic.h"
 
 
 struct gl_sampler_object *
@@ -162,6 +164,7 @@ _mesa_init_sampler_object(struct gl_sampler_object *sampObj, GLuint name)
    sampObj->CompareFunc = GL_LEQUAL;
    sampObj->sRGBDecode = GL_DECODE_EXT;
    sampObj->CubeMapSeamless = GL_FALSE;
+   _mesa_sampler_state_changed(sampObj);
 }
 
 /**
@@ -250,7 +253,8 @@ _mesa_DeleteSamplers(GLsizei count, const GLuint *samplers)
             /* If the sampler is currently bound, unbind it. */
             for (j = 0; j < ctx->Const.MaxCombinedTextureImageUnits; j++) {
                if (ctx->Texture.Unit[j].Sampler == sampObj) {
-                  FLUSH_VERTICES(ctx, _NEW_TEXTURE);
+                  FLUSH_VERTICES(ctx, 0);
+                  _mesa_flag_texture_unit_binding(ctx, j);
                   _mesa_reference_sampler_object(ctx, &ctx->Texture.Unit[j].Sampler, NULL);
                }
             }
@@ -288,7 +292,8 @@ _mesa_bind_sampler(struct gl_context *ctx, GLuint unit,
                    struct gl_sampler_object *sampObj)
 {
    if (ctx->Texture.Unit[unit].Sampler != sampObj) {
-      FLUSH_VERTICES(ctx, _NEW_TEXTURE);
+      FLUSH_VERTICES(ctx, 0);
+      _mesa_flag_texture_unit_binding(ctx, unit);
    }
 
    _mesa_reference_sampler_object(ctx, &ctx->Texture.Unit[unit].Sampler,
@@ -404,7 +409,7 @@ _mesa_BindSamplers(GLuint first, GLsizei count, const GLuint *samplers)
             _mesa_reference_sampler_object(ctx,
                                            &ctx->Texture.Unit[unit].Sampler,
                                            sampObj);
-            ctx->NewState |= _NEW_TEXTURE;
+            _mesa_flag_texture_unit_binding(ctx, unit);
          }
       }
 
@@ -418,7 +423,7 @@ _mesa_BindSamplers(GLuint first, GLsizei count, const GLuint *samplers)
             _mesa_reference_sampler_object(ctx,
                                            &ctx->Texture.Unit[unit].Sampler,
                                            NULL);
-            ctx->NewState |= _NEW_TEXTURE;
+            _mesa_flag_texture_unit_binding(ctx, unit);
          }
       }
    }
@@ -454,13 +459,29 @@ validate_texture_wrap_mode(struct gl_context *ctx, GLenum wrap)
 }
 
 
+/**
+ * Assign a new sequence number to the sampler object.  The numbers come
+ * from a single counter shared by all sampler (and texture) objects, so an
+ * object allocated at the address of a deleted one never matches state
+ * cached for the old one.
+ */
+void
+_mesa_sampler_state_changed(struct gl_sampler_object *samp)
+{
+   static unsigned seq_no;
+
+   samp->StateSeqNo = p_atomic_inc_return(&seq_no);
+}
+
+
 /**
  * This is called just prior to changing any sampler object state.
  */
 static inline void
-flush(struct gl_context *ctx)
+flush(struct gl_context *ctx, struct gl_sampler_object *samp)
 {
    FLUSH_VERTICES(ctx, _NEW_TEXTURE);
+   _mesa_sampler_state_changed(samp);
 }
 
 void
@@ -474,7 +495,7 @@ _mesa_set_sampler_wrap(struct gl_context *ctx, struct gl_sampler_object *samp,
    if (samp->WrapS == s && samp->WrapT == t && samp->WrapR == r)
       return;
 
-   flush(ctx);
+   flush(ctx, samp);
    samp->WrapS = s;
    samp->WrapT = t;
    samp->WrapR = r;
@@ -491,7 +512,7 @@ set_sampler_wrap_s(struct gl_context *ctx, struct gl_sampler_object *samp,
    if (samp->WrapS == param)
       return GL_FALSE;
    if (validate_texture_wrap_mode(ctx, param)) {
-      flush(ctx);
+      flush(ctx, samp);
       samp->WrapS = param;
       return GL_TRUE;
    }
@@ -506,7 +527,7 @@ set_sampler_wrap_t(struct gl_context *ctx, struct gl_sampler_object *samp,
    if (samp->WrapT == param)
       return GL_FALSE;
    if (validate_texture_wrap_mode(ctx, param)) {
-      flush(ctx);
+      flush(ctx, samp);
       samp->WrapT = param;
       return GL_TRUE;
    }
@@ -521,7 +542,7 @@ set_sampler_wrap_r(struct gl_context *ctx, struct gl_sampler_object *samp,
    if (samp->WrapR == param)
       return GL_FALSE;
    if (validate_texture_wrap_mode(ctx, param)) {
-      flush(ctx);
+      flush(ctx, samp);
       samp->WrapR = param;
       return GL_TRUE;
    }
@@ -545,7 +566,7 @@ _mesa_set_sampler_filters(struct gl_context *ctx,
    if (samp->MinFilter == min_filter && samp->MagFilter == mag_filter)
       return;
 
-   flush(ctx);
+   flush(ctx, samp);
    samp->MinFilter = min_filter;
    samp->MagFilter = mag_filter;
 }
@@ -564,7 +585,7 @@ set_sampler_min_filter(struct gl_context *ctx, struct gl_sampler_object *samp,
    case GL_LINEAR_MIPMAP_NEAREST:
    case GL_NEAREST_MIPMAP_LINEAR:
    case GL_LINEAR_MIPMAP_LINEAR:
-      flush(ctx);
+      flush(ctx, samp);
       samp->MinFilter = param;
       return GL_TRUE;
    default:
@@ -583,7 +604,7 @@ set_sampler_mag_filter(struct gl_context *ctx, struct gl_sampler_object *samp,
    switch (param) {
    case GL_NEAREST:
    case GL_LINEAR:
-      flush(ctx);
+      flush(ctx, samp);
       samp->MagFilter = param;
       return GL_TRUE;
    default:
@@ -599,7 +620,7 @@ set_sampler_lod_bias(struct gl_context *ctx, struct gl_sampler_object *samp,
    if (samp->LodBias == param)
       return GL_FALSE;
 
-   flush(ctx);
+   flush(ctx, samp);
    samp->LodBias = param;
    return GL_TRUE;
 }
@@ -610,7 +631,7 @@ set_sampler_border_colorf(struct gl_context *ctx,
                           struct gl_sampler_object *samp,
                           const GLfloat params[4])
 {
-   flush(ctx);
+   flush(ctx, samp);
    samp->BorderColor.f[RCOMP] = params[0];
    samp->BorderColor.f[GCOMP] = params[1];
    samp->BorderColor.f[BCOMP] = params[2];
@@ -624,7 +645,7 @@ set_sampler_border_colori(struct gl_context *ctx,
                           struct gl_sampler_object *samp,
                           const GLint params[4])
 {
-   flush(ctx);
+   flush(ctx, samp);
    samp->BorderColor.i[RCOMP] = params[0];
    samp->BorderColor.i[GCOMP] = params[1];
    samp->BorderColor.i[BCOMP] = params[2];
@@ -638,7 +659,7 @@ set_sampler_border_colorui(struct gl_context *ctx,
                            struct gl_sampler_object *samp,
                            const GLuint params[4])
 {
-   flush(ctx);
+   flush(ctx, samp);
    samp->BorderColor.ui[RCOMP] = params[0];
    samp->BorderColor.ui[GCOMP] = params[1];
    samp->BorderColor.ui[BCOMP] = params[2];
@@ -654,7 +675,7 @@ set_sampler_min_lod(struct gl_context *ctx, struct gl_sampler_object *samp,
    if (samp->MinLod == param)
       return GL_FALSE;
 
-   flush(ctx);
+   flush(ctx, samp);
    samp->MinLod = param;
    return GL_TRUE;
 }
@@ -667,7 +688,7 @@ set_sampler_max_lod(struct gl_context *ctx, struct gl_sampler_object *samp,
    if (samp->MaxLod == param)
       return GL_FALSE;
 
-   flush(ctx);
+   flush(ctx, samp);
    samp->MaxLod = param;
    return GL_TRUE;
 }
@@ -689,7 +710,7 @@ set_sampler_compare_mode(struct gl_context *ctx,
 
    if (param == GL_NONE ||
        param == GL_COMPARE_R_TO_TEXTURE_ARB) {
-      flush(ctx);
+      flush(ctx, samp);
       samp->CompareMode = param;
       return GL_TRUE;
    }
@@ -721,7 +742,7 @@ set_sampler_compare_func(struct gl_context *ctx,
    case GL_GREATER:
    case GL_ALWAYS:
    case GL_NEVER:
-      flush(ctx);
+      flush(ctx, samp);
       samp->CompareFunc = param;
       return GL_TRUE;
    default:
@@ -743,7 +764,7 @@ set_sampler_max_anisotropy(struct gl_context *ctx,
    if (param < 1.0F)
       return INVALID_VALUE;
 
-   flush(ctx);
+   flush(ctx, samp);
    /* clamp to max, that's what NVIDIA does */
    samp->MaxAnisotropy = MIN2(param, ctx->Const.MaxTextureMaxAnisotropy);
    return GL_TRUE;
@@ -764,7 +785,7 @@ set_sampler_cube_map_seamless(struct gl_context *ctx,
    if (param != GL_TRUE && param != GL_FALSE)
       return INVALID_VALUE;
 
-   flush(ctx);
+   flush(ctx, samp);
    samp->CubeMapSeamless = param;
    return GL_TRUE;
 }
@@ -775,7 +796,7 @@ _mesa_set_sampler_srgb_decode(struct gl_context *ctx,
 {
    assert(param == GL_DECODE_EXT || param == GL_SKIP_DECODE_EXT);
 
-   flush(ctx);
+   flush(ctx, samp);
    samp->sRGBDecode = param;
 }
 
@@ -792,7 +813,7 @@ set_sampler_srgb_decode(struct gl_context *ctx,
    if (param != GL_DECODE_EXT && param != GL_SKIP_DECODE_EXT)
       return INVALID_VALUE;
 
-   flush(ctx);
+   flush(ctx, samp);
    samp->sRGBDecode = param;
    return GL_TRUE;
 }
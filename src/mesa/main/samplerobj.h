@@ -75,6 +75,9 @@ _mesa_lookup_samplerobj(struct gl_context *ctx, GLuint name);
 extern struct gl_sampler_object *
 _mesa_new_sampler_object(struct gl_context *ctx, GLuint name);
 
+extern void
+_mesa_sampler_state_changed(struct gl_sampler_object *samp);
+
 extern void
 _mesa_init_sampler_object_functions(struct dd_function_table *driver);
 
@@ -40,9 +40,11 @@
 #include <stdbool.h>
 #include "main/glheader.h"
 #include "main/context.h"
+#include "main/debug_output.h"
 #include "main/dispatch.h"
 #include "main/enums.h"
 #include "main/hash.h"
+#include "main/macros.h"
 #include "main/mtypes.h"
 #include "main/pipelineobj.h"
 #include "main/shaderapi.h"
@@ -56,15 +58,23 @@
 #include "program/program.h"
 #include "program/prog_print.h"
 #include "program/prog_parameter.h"
+#include "program/ir_to_mesa.h"
+#include "program/shader_cache.h"
 #include "util/ralloc.h"
 #include "util/hash_table.h"
 #include "util/mesa-sha1.h"
+#include "util/u_atomic.h"
+#include "util/u_queue.h"
 
 #ifdef _MSC_VER
 #include <stdlib.h>
 #define PATH_MAX _MAX_PATH
 #endif
 
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
 /**
  * Return mask of GLSL_x flags by examining the MESA_GLSL env var.
  */
@@ -124,6 +134,117 @@ _mesa_get_shader_capture_path(void)
    return path;
 }
 
+
+/**
+ * Return the number of shader compiler threads requested through the
+ * MESA_GLSL_COMPILER_THREADS env var, or 0.
+ */
+static GLuint
+get_compiler_threads_env(void)
+{
+   const char *env = getenv("MESA_GLSL_COMPILER_THREADS");
+   return env ? strtoul(env, NULL, 10) : 0;
+}
+
+
+/**
+ * Queue of shader compiles and links running in the background, shared by
+ * all contexts (GL_ARB_parallel_shader_compile).
+ */
+static struct util_queue shader_queue;
+static mtx_t shader_queue_mutex = _MTX_INITIALIZER_NP;
+
+/**
+ * Create the shader queue if needed.  MESA_GLSL_COMPILER_THREADS gives its
+ * number of threads, or else the count of the first context that uses it,
+ * up to one thread per CPU.
+ */
+static bool
+shader_queue_init(unsigned max_threads)
+{
+   bool initialized;
+
+   mtx_lock(&shader_queue_mutex);
+
+   if (!util_queue_is_initialized(&shader_queue)) {
+      unsigned num_threads = get_compiler_threads_env();
+
+      if (num_threads == 0) {
+#if defined(_SC_NPROCESSORS_ONLN)
+         long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+         num_threads = num_cpus > 0 ? MIN2((unsigned) num_cpus, max_threads) : 1;
+#else
+         num_threads = 1;
+#endif
+      }
+
+      util_queue_init(&shader_queue, "glsl", 256, num_threads);
+   }
+
+   initialized = util_queue_is_initialized(&shader_queue);
+   mtx_unlock(&shader_queue_mutex);
+
+   return initialized;
+}
+
+
+/**
+ * Whether glCompileShader and glLinkProgram may return before the work is
+ * done, in which case it is finished on the shader queue.
+ */
+static bool
+use_shader_queue(struct gl_context *ctx)
+{
+   /* The debug flags log the results as soon as they are available */
+   if (ctx->MaxShaderCompilerThreads == 0 || ctx->_Shader->Flags != 0)
+      return false;
+
+   /* The compiler's debug messages must reach the application's callback
+    * on the thread that made the call.
+    */
+   if (_mesa_debug_output_is_synchronous(ctx))
+      return false;
+
+   /* The queue is shared by all contexts, so the count of the context is
+    * enforced by limiting its jobs.  Past that, the application thread does
+    * the work.
+    */
+   if (p_atomic_read(&ctx->ShaderQueueJobs) >= ctx->MaxShaderCompilerThreads)
+      return false;
+
+   return shader_queue_init(ctx->MaxShaderCompilerThreads);
+}
+
+
+/**
+ * Wait for all shader compiles and links running in the background, in all
+ * contexts.
+ */
+void
+_mesa_finish_shader_queue(void)
+{
+   if (util_queue_is_initialized(&shader_queue))
+      util_queue_finish(&shader_queue);
+}
+
+
+/**
+ * Wait until the shader may be changed: its compile has completed, and no
+ * link in the background reads it anymore.
+ */
+static void
+wait_shader_idle(struct gl_shader *sh)
+{
+   util_queue_job_wait(&sh->CompileFence);
+
+   /* Relinking or recompiling a shader while a program it is attached to
+    * is being linked is rare enough to not bother tracking which link.
+    */
+   if (p_atomic_read(&sh->PendingLinks) != 0)
+      _mesa_finish_shader_queue();
+}
+
+
 /**
  * Initialize context's shader state.
  */
@@ -149,6 +270,8 @@ _mesa_init_shader_state(struct gl_context *ctx)
    if (ctx->Shader.Flags != 0)
       ctx->Const.GenerateTemporaryNames = true;
 
+   ctx->MaxShaderCompilerThreads = get_compiler_threads_env();
+
    /* Extended for ARB_separate_shader_objects */
    ctx->Shader.RefCount = 1;
    mtx_init(&ctx->Shader.Mutex, mtx_plain);
@@ -168,6 +291,10 @@ void
 _mesa_free_shader_state(struct gl_context *ctx)
 {
    int i;
+
+   /* Jobs on the shader queue may still use the context */
+   _mesa_finish_shader_queue();
+
    for (i = 0; i < MESA_SHADER_STAGES; i++) {
       _mesa_reference_shader_program(ctx, &ctx->Shader.CurrentProgram[i],
                                      NULL);
@@ -245,8 +372,9 @@ _mesa_validate_shader_target(const struct gl_context *ctx, GLenum type)
 static GLboolean
 is_program(struct gl_context *ctx, GLuint name)
 {
-   struct gl_shader_program *shProg = _mesa_lookup_shader_program(ctx, name);
-   return shProg ? GL_TRUE : GL_FALSE;
+   struct gl_shader_program *shProg = (struct gl_shader_program *)
+      _mesa_HashLookup(ctx->Shared->ShaderObjects, name);
+   return shProg && shProg->Type == GL_SHADER_PROGRAM_MESA;
 }
 
 
@@ -615,8 +743,21 @@ static void
 get_programiv(struct gl_context *ctx, GLuint program, GLenum pname,
               GLint *params)
 {
-   struct gl_shader_program *shProg
-      = _mesa_lookup_shader_program_err(ctx, program, "glGetProgramiv(program)");
+   struct gl_shader_program *shProg;
+
+   /* GL_ARB_parallel_shader_compile */
+   if (pname == GL_COMPLETION_STATUS_ARB && _mesa_is_desktop_gl(ctx)) {
+      shProg = _mesa_lookup_shader_program_err_no_wait(ctx, program,
+                                                       "glGetProgramiv(program)");
+      if (shProg) {
+         *params = !shProg->LinkPending ||
+                   util_queue_fence_is_signalled(&shProg->LinkFence);
+      }
+      return;
+   }
+
+   shProg = _mesa_lookup_shader_program_err(ctx, program,
+                                            "glGetProgramiv(program)");
 
    /* Is transform feedback available in this context?
     */
@@ -899,14 +1040,22 @@ get_shaderiv(struct gl_context *ctx, GLuint name, GLenum pname, GLint *params)
       *params = shader->DeletePending;
       break;
    case GL_COMPILE_STATUS:
+      util_queue_job_wait(&shader->CompileFence);
       *params = shader->CompileStatus;
       break;
    case GL_INFO_LOG_LENGTH:
+      util_queue_job_wait(&shader->CompileFence);
       *params = shader->InfoLog ? strlen(shader->InfoLog) + 1 : 0;
       break;
    case GL_SHADER_SOURCE_LENGTH:
       *params = shader->Source ? strlen((char *) shader->Source) + 1 : 0;
       break;
+   case GL_COMPLETION_STATUS_ARB:
+      if (_mesa_is_desktop_gl(ctx)) {
+         *params = util_queue_fence_is_signalled(&shader->CompileFence);
+         break;
+      }
+      /* fallthrough */
    default:
       _mesa_error(ctx, GL_INVALID_ENUM, "glGetShaderiv(pname)");
       return;
@@ -963,6 +1112,8 @@ get_shader_info_log(struct gl_context *ctx, GLuint shader, GLsizei bufSize,
       return;
    }
 
+   util_queue_job_wait(&sh->CompileFence);
+
    _mesa_copy_string(infoLog, bufSize, length, sh->InfoLog);
 }
 
@@ -998,8 +1149,18 @@ shader_source(struct gl_shader *sh, const GLchar *source)
 {
    assert(sh);
 
-   /* free old shader source string and install new one */
-   free((void *)sh->Source);
+   wait_shader_idle(sh);
+
+   /* A shader whose compile was skipped may still have to be compiled at
+    * link time, from the source it had when glCompileShader was called.
+    */
+   if (sh->CompileSkipped && !sh->FallbackSource) {
+      sh->FallbackSource = sh->Source;
+   } else {
+      free((void *)sh->Source);
+   }
+
+   /* install new shader source string */
    sh->Source = source;
 #ifdef DEBUG
    sh->SourceChecksum = _mesa_str_checksum(sh->Source);
@@ -1008,14 +1169,41 @@ shader_source(struct gl_shader *sh, const GLchar *source)
 
 
 /**
- * Compile a shader.
+ * A compile or link on the shader queue.
  */
-void
-_mesa_compile_shader(struct gl_context *ctx, struct gl_shader *sh)
+struct shader_job {
+   struct gl_context *ctx;
+   struct gl_shader *sh;
+   struct gl_shader_program *shProg;
+};
+
+
+static void
+free_shader_job(void *data, int thread_index)
+{
+   free(data);
+}
+
+
+static void
+compile_shader_job(void *data, int thread_index)
+{
+   struct shader_job *job = (struct shader_job *) data;
+
+   _mesa_glsl_compile_shader(job->ctx, job->sh, false, false);
+   p_atomic_dec(&job->ctx->ShaderQueueJobs);
+}
+
+
+static void
+compile_shader(struct gl_context *ctx, struct gl_shader *sh,
+               bool background)
 {
    if (!sh)
       return;
 
+   wait_shader_idle(sh);
+
    if (!sh->Source) {
       /* If the user called glCompileShader without first calling
        * glShaderSource, we should fail to compile, but not raise a GL_ERROR.
@@ -1028,10 +1216,29 @@ _mesa_compile_shader(struct gl_context *ctx, struct gl_shader *sh)
          _mesa_log("%s\n", sh->Source);
       }
 
-      /* this call will set the shader->CompileStatus field to indicate if
-       * compilation was successful.
-       */
-      _mesa_glsl_compile_shader(ctx, sh, false, false);
+      free((void *)sh->FallbackSource);
+      sh->FallbackSource = NULL;
+
+      if (!_mesa_shader_cache_skip_compile(ctx, sh)) {
+         struct shader_job *job = NULL;
+
+         if (background && use_shader_queue(ctx))
+            job = malloc(sizeof(*job));
+
+         if (job) {
+            job->ctx = ctx;
+            job->sh = sh;
+            p_atomic_inc(&ctx->ShaderQueueJobs);
+            util_queue_add_job(&shader_queue, job, &sh->CompileFence,
+                               compile_shader_job, free_shader_job);
+            return;
+         }
+
+         /* this call will set the shader->CompileStatus field to indicate if
+          * compilation was successful.
+          */
+         _mesa_glsl_compile_shader(ctx, sh, false, false);
+      }
 
       if (ctx->_Shader->Flags & GLSL_LOG) {
          _mesa_write_shader_to_file(sh);
@@ -1069,29 +1276,62 @@ _mesa_compile_shader(struct gl_context *ctx, struct gl_shader *sh)
 
 
 /**
- * Link a program's shaders.
+ * Compile a shader.
  */
 void
-_mesa_link_program(struct gl_context *ctx, struct gl_shader_program *shProg)
+_mesa_compile_shader(struct gl_context *ctx, struct gl_shader *sh)
 {
-   if (!shProg)
-      return;
+   compile_shader(ctx, sh, false);
+}
 
-   /* From the ARB_transform_feedback2 specification:
-    * "The error INVALID_OPERATION is generated by LinkProgram if <program> is
-    *  the name of a program being used by one or more transform feedback
-    *  objects, even if the objects are not currently bound or are paused."
+
+static void
+link_program_job(void *data, int thread_index)
+{
+   struct shader_job *job = (struct shader_job *) data;
+   struct gl_shader_program *shProg = job->shProg;
+   GLuint i;
+
+   /* The compiles were queued before, so they have at least started */
+   for (i = 0; i < shProg->NumShaders; i++)
+      util_queue_job_wait(&shProg->Shaders[i]->CompileFence);
+
+   _mesa_glsl_link_shader_front_end(job->ctx, shProg);
+
+   for (i = 0; i < shProg->NumShaders; i++)
+      p_atomic_dec(&shProg->Shaders[i]->PendingLinks);
+
+   p_atomic_dec(&job->ctx->ShaderQueueJobs);
+}
+
+
+/**
+ * Whether the program can be linked on the shader queue.
+ */
+static bool
+link_in_background(struct gl_context *ctx,
+                   const struct gl_shader_program *shProg)
+{
+   /* The program must not be in use anywhere, as that would see the
+    * partially linked program.  Only its name holds a reference then.
     */
-   if (_mesa_transform_feedback_is_using_program(ctx, shProg)) {
-      _mesa_error(ctx, GL_INVALID_OPERATION,
-                  "glLinkProgram(transform feedback is using the program)");
-      return;
-   }
+   if (shProg->DeletePending || shProg->RefCount != 1)
+      return false;
 
-   FLUSH_VERTICES(ctx, _NEW_PROGRAM);
+   /* Capturing reads the sources of the shaders once the link is done */
+   if (_mesa_get_shader_capture_path() != NULL)
+      return false;
+
+   return use_shader_queue(ctx);
+}
 
-   _mesa_glsl_link_shader(ctx, shProg);
 
+/**
+ * The last part of a link: report the result.
+ */
+static void
+link_program_done(struct gl_context *ctx, struct gl_shader_program *shProg)
+{
    /* Capture .shader_test files. */
    const char *capture_path = _mesa_get_shader_capture_path();
    if (shProg->Name != 0 && shProg->Name != ~0 && capture_path != NULL) {
@@ -1144,6 +1384,139 @@ _mesa_link_program(struct gl_context *ctx, struct gl_shader_program *shProg)
 }
 
 
+/**
+ * Queue the link of a program on the shader queue.  The GLSL linker runs in
+ * the background, once the attached shaders have been compiled, and the
+ * rest of the link is done by _mesa_finish_link_program().
+ */
+static void
+queue_link_program(struct gl_context *ctx, struct gl_shader_program *shProg)
+{
+   struct shader_job *job;
+   bool compiled = true;
+   GLuint i;
+
+   for (i = 0; i < shProg->NumShaders; i++) {
+      struct util_queue_fence *fence = &shProg->Shaders[i]->CompileFence;
+
+      /* Waiting on a signalled fence makes the results visible */
+      if (util_queue_fence_is_signalled(fence))
+         util_queue_job_wait(fence);
+      else
+         compiled = false;
+   }
+
+   if (!_mesa_glsl_link_shader_prepare(ctx, shProg, compiled)) {
+      link_program_done(ctx, shProg);
+      return;
+   }
+
+   if (!shProg->LinkStatus) {
+      _mesa_glsl_link_shader_finish(ctx, shProg);
+      link_program_done(ctx, shProg);
+      return;
+   }
+
+   /* Deleting the previous linked shaders may involve the driver, so don't
+    * leave that to the linker.
+    */
+   for (i = 0; i < MESA_SHADER_STAGES; i++) {
+      if (shProg->_LinkedShaders[i]) {
+         _mesa_delete_linked_shader(ctx, shProg->_LinkedShaders[i]);
+         shProg->_LinkedShaders[i] = NULL;
+      }
+   }
+
+   job = malloc(sizeof(*job));
+   if (!job) {
+      for (i = 0; i < shProg->NumShaders; i++)
+         util_queue_job_wait(&shProg->Shaders[i]->CompileFence);
+
+      _mesa_glsl_link_shader_front_end(ctx, shProg);
+      _mesa_glsl_link_shader_finish(ctx, shProg);
+      link_program_done(ctx, shProg);
+      return;
+   }
+
+   for (i = 0; i < shProg->NumShaders; i++)
+      p_atomic_inc(&shProg->Shaders[i]->PendingLinks);
+
+   job->ctx = ctx;
+   job->shProg = shProg;
+   shProg->LinkPending = GL_TRUE;
+   p_atomic_inc(&ctx->ShaderQueueJobs);
+   util_queue_add_job(&shader_queue, job, &shProg->LinkFence,
+                      link_program_job, free_shader_job);
+}
+
+
+static void
+link_program(struct gl_context *ctx, struct gl_shader_program *shProg,
+             bool background)
+{
+   GLuint i;
+
+   if (!shProg)
+      return;
+
+   /* From the ARB_transform_feedback2 specification:
+    * "The error INVALID_OPERATION is generated by LinkProgram if <program> is
+    *  the name of a program being used by one or more transform feedback
+    *  objects, even if the objects are not currently bound or are paused."
+    */
+   if (_mesa_transform_feedback_is_using_program(ctx, shProg)) {
+      _mesa_error(ctx, GL_INVALID_OPERATION,
+                  "glLinkProgram(transform feedback is using the program)");
+      return;
+   }
+
+   _mesa_finish_link_program(ctx, shProg);
+
+   FLUSH_VERTICES(ctx, _NEW_PROGRAM);
+
+   if (background && link_in_background(ctx, shProg)) {
+      queue_link_program(ctx, shProg);
+      return;
+   }
+
+   for (i = 0; i < shProg->NumShaders; i++)
+      util_queue_job_wait(&shProg->Shaders[i]->CompileFence);
+
+   _mesa_glsl_link_shader(ctx, shProg);
+   link_program_done(ctx, shProg);
+}
+
+
+/**
+ * Link a program's shaders.
+ */
+void
+_mesa_link_program(struct gl_context *ctx, struct gl_shader_program *shProg)
+{
+   link_program(ctx, shProg, false);
+}
+
+
+/**
+ * Complete the link of a program queued by glLinkProgram, if any.  This
+ * waits for the GLSL linker and runs the driver back end, which may only
+ * run on the application's thread.
+ */
+void
+_mesa_finish_link_program(struct gl_context *ctx,
+                          struct gl_shader_program *shProg)
+{
+   if (!shProg->LinkPending)
+      return;
+
+   util_queue_job_wait(&shProg->LinkFence);
+   shProg->LinkPending = GL_FALSE;
+
+   _mesa_glsl_link_shader_finish(ctx, shProg);
+   link_program_done(ctx, shProg);
+}
+
+
 /**
  * Print basic shader info (for debug).
  */
@@ -1343,8 +1716,8 @@ _mesa_CompileShader(GLuint shaderObj)
    GET_CURRENT_CONTEXT(ctx);
    if (MESA_VERBOSE & VERBOSE_API)
       _mesa_debug(ctx, "glCompileShader %u\n", shaderObj);
-   _mesa_compile_shader(ctx, _mesa_lookup_shader_err(ctx, shaderObj,
-                                                     "glCompileShader"));
+   compile_shader(ctx, _mesa_lookup_shader_err(ctx, shaderObj,
+                                               "glCompileShader"), true);
 }
 
 
@@ -1591,8 +1964,8 @@ _mesa_LinkProgram(GLuint programObj)
    GET_CURRENT_CONTEXT(ctx);
    if (MESA_VERBOSE & VERBOSE_API)
       _mesa_debug(ctx, "glLinkProgram %u\n", programObj);
-   _mesa_link_program(ctx, _mesa_lookup_shader_program_err(ctx, programObj,
-                                                           "glLinkProgram"));
+   link_program(ctx, _mesa_lookup_shader_program_err(ctx, programObj,
+                                                     "glLinkProgram"), true);
 }
 
 #if defined(HAVE_SHA1)
@@ -1934,10 +2307,26 @@ _mesa_GetShaderPrecisionFormat(GLenum shadertype, GLenum precisiontype,
 void GLAPIENTRY
 _mesa_ReleaseShaderCompiler(void)
 {
+   _mesa_finish_shader_queue();
    _mesa_destroy_shader_compiler_caches();
 }
 
 
+/**
+ * For GL_ARB_parallel_shader_compile
+ */
+void GLAPIENTRY
+_mesa_MaxShaderCompilerThreadsARB(GLuint count)
+{
+   GET_CURRENT_CONTEXT(ctx);
+
+   /* Limits the compiles and links of this context that are queued at
+    * once, see use_shader_queue().
+    */
+   ctx->MaxShaderCompilerThreads = count;
+}
+
+
 /**
  * For OpenGL ES 2.0, GL_ARB_ES2_compatibility
  */
@@ -92,6 +92,7 @@ static void
 _mesa_init_shader(struct gl_shader *shader)
 {
    shader->RefCount = 1;
+   util_queue_fence_init(&shader->CompileFence);
    shader->info.Geom.VerticesOut = -1;
    shader->info.Geom.InputType = GL_TRIANGLES;
    shader->info.Geom.OutputType = GL_TRIANGLE_STRIP;
@@ -136,7 +137,11 @@ _mesa_new_linked_shader(gl_shader_stage stage)
 void
 _mesa_delete_shader(struct gl_context *ctx, struct gl_shader *sh)
 {
+   util_queue_job_wait(&sh->CompileFence);
+   util_queue_fence_destroy(&sh->CompileFence);
+
    free((void *)sh->Source);
+   free((void *)sh->FallbackSource);
    free(sh->Label);
    ralloc_free(sh);
 }
@@ -255,6 +260,8 @@ init_shader_program(struct gl_shader_program *prog)
    prog->Type = GL_SHADER_PROGRAM_MESA;
    prog->RefCount = 1;
 
+   util_queue_fence_init(&prog->LinkFence);
+
    prog->AttributeBindings = string_to_uint_map_ctor();
    prog->FragDataBindings = string_to_uint_map_ctor();
    prog->FragDataIndexBindings = string_to_uint_map_ctor();
@@ -349,6 +356,10 @@ _mesa_free_shader_program_data(struct gl_context *ctx,
 
    assert(shProg->Type == GL_SHADER_PROGRAM_MESA);
 
+   /* The result of a background link is simply thrown away */
+   util_queue_job_wait(&shProg->LinkFence);
+   shProg->LinkPending = GL_FALSE;
+
    _mesa_clear_shader_program_data(shProg);
 
    if (shProg->AttributeBindings) {
@@ -404,6 +415,7 @@ _mesa_delete_shader_program(struct gl_context *ctx,
                             struct gl_shader_program *shProg)
 {
    _mesa_free_shader_program_data(ctx, shProg);
+   util_queue_fence_destroy(&shProg->LinkFence);
 
    ralloc_free(shProg);
 }
@@ -411,6 +423,9 @@ _mesa_delete_shader_program(struct gl_context *ctx,
 
 /**
  * Lookup a GLSL program object.
+ *
+ * If the program is being linked in the background, this waits for the
+ * link and completes it, so that the program can be used or queried.
  */
 struct gl_shader_program *
 _mesa_lookup_shader_program(struct gl_context *ctx, GLuint name)
@@ -426,6 +441,8 @@ _mesa_lookup_shader_program(struct gl_context *ctx, GLuint name)
       if (shProg && shProg->Type != GL_SHADER_PROGRAM_MESA) {
          return NULL;
       }
+      if (shProg)
+         _mesa_finish_link_program(ctx, shProg);
       return shProg;
    }
    return NULL;
@@ -438,6 +455,23 @@ _mesa_lookup_shader_program(struct gl_context *ctx, GLuint name)
 struct gl_shader_program *
 _mesa_lookup_shader_program_err(struct gl_context *ctx, GLuint name,
                                 const char *caller)
+{
+   struct gl_shader_program *shProg =
+      _mesa_lookup_shader_program_err_no_wait(ctx, name, caller);
+
+   if (shProg)
+      _mesa_finish_link_program(ctx, shProg);
+   return shProg;
+}
+
+
+/**
+ * As above, but don't wait for a background link of the program.  Only
+ * the fields of the program which a link doesn't change may be accessed.
+ */
+struct gl_shader_program *
+_mesa_lookup_shader_program_err_no_wait(struct gl_context *ctx, GLuint name,
+                                        const char *caller)
 {
    if (!name) {
       _mesa_error(ctx, GL_INVALID_VALUE, "%s", caller);
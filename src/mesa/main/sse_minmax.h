@@ -25,6 +25,39 @@
  *
  */
 
+#ifndef SSE_MINMAX_H
+#define SSE_MINMAX_H
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* SIMD index kernels, picked at runtime by main/index_scan.c. */
+
+void
+_mesa_sse41_index_min_max(const void *indices, unsigned index_size,
+                          unsigned count, bool restart,
+                          unsigned restart_index,
+                          unsigned *min_index, unsigned *max_index);
+
+unsigned
+_mesa_sse41_index_find(const void *indices, unsigned index_size,
+                       unsigned count, unsigned value);
+
 void
-_mesa_uint_array_min_max(const unsigned *ui_indices, unsigned *min_index,
-                         unsigned *max_index, const unsigned count);
+_mesa_avx2_index_min_max(const void *indices, unsigned index_size,
+                         unsigned count, bool restart,
+                         unsigned restart_index,
+                         unsigned *min_index, unsigned *max_index);
+
+unsigned
+_mesa_avx2_index_find(const void *indices, unsigned index_size,
+                      unsigned count, unsigned value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -487,6 +487,7 @@ _mesa_update_state_locked( struct gl_context *ctx )
    ctx->NewState = 0;
    ctx->Driver.UpdateState(ctx, new_state);
    ctx->Array.VAO->NewArrays = 0x0;
+   memset(ctx->Texture._DirtyUnits, 0, sizeof(ctx->Texture._DirtyUnits));
 }
 
 
@@ -955,6 +955,9 @@ const struct function common_desktop_functions_possible[] = {
    /* GL_EXT_window_rectangles */
    { "glWindowRectanglesEXT", 30, -1 },
 
+   /* GL_ARB_parallel_shader_compile */
+   { "glMaxShaderCompilerThreadsARB", 11, -1 },
+
    { NULL, 0, -1 }
 };
 
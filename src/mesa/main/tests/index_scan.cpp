@@ -0,0 +1,178 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "main/index_scan.h"
+#include "main/sse_minmax.h"
+
+extern "C" {
+#include "x86/common_x86_asm.h"
+}
+
+namespace {
+
+typedef void (*min_max_func)(const void *, unsigned, unsigned, bool,
+                             unsigned, unsigned *, unsigned *);
+typedef unsigned (*find_func)(const void *, unsigned, unsigned, unsigned);
+
+struct kernels {
+   const char *name;
+   min_max_func min_max;
+   find_func find;
+};
+
+std::vector<kernels>
+available_kernels()
+{
+   std::vector<kernels> list;
+   kernels dispatch = { "dispatch", _mesa_index_min_max, _mesa_index_find };
+
+   _mesa_get_x86_features();
+   list.push_back(dispatch);
+
+#if defined(USE_SSE41)
+   if (cpu_has_sse4_1) {
+      kernels sse41 = { "sse4.1", _mesa_sse41_index_min_max,
+                        _mesa_sse41_index_find };
+      list.push_back(sse41);
+   }
+#endif
+#if defined(USE_AVX2)
+   if (cpu_has_avx2) {
+      kernels avx2 = { "avx2", _mesa_avx2_index_min_max,
+                       _mesa_avx2_index_find };
+      list.push_back(avx2);
+   }
+#endif
+
+   return list;
+}
+
+unsigned
+read_index(const uint8_t *data, unsigned index_size, unsigned i)
+{
+   switch (index_size) {
+   case 1:
+      return data[i];
+   case 2:
+      return ((const uint16_t *) data)[i];
+   default:
+      return ((const uint32_t *) data)[i];
+   }
+}
+
+void
+write_index(uint8_t *data, unsigned index_size, unsigned i, unsigned value)
+{
+   switch (index_size) {
+   case 1:
+      data[i] = value;
+      break;
+   case 2:
+      ((uint16_t *) data)[i] = value;
+      break;
+   default:
+      ((uint32_t *) data)[i] = value;
+      break;
+   }
+}
+
+} /* anonymous namespace */
+
+/* Compares every kernel with a plain loop, for all index sizes, lengths
+ * around the vector sizes and misaligned starts.
+ */
+TEST(IndexScan, MinMaxAndFind)
+{
+   static const unsigned index_sizes[] = { 1, 2, 4 };
+   std::vector<kernels> list = available_kernels();
+   std::vector<uint32_t> storage(1024 + 16);
+   uint8_t *buffer = (uint8_t *) &storage[0];
+
+   srand(1);
+
+   for (unsigned s = 0; s < 3; s++) {
+      const unsigned index_size = index_sizes[s];
+      const unsigned type_max = index_size == 4 ? ~0u :
+                                (1u << (8 * index_size)) - 1;
+
+      for (unsigned iter = 0; iter < 400; iter++) {
+         const unsigned count = iter < 200 ? iter : rand() % 1024;
+         const unsigned skip = rand() % 4;
+         const uint8_t *indices = buffer + skip * index_size;
+         const unsigned restart_index = rand() % 2 ? type_max : 7;
+         const bool restart = rand() % 2;
+
+         for (unsigned i = 0; i < count + skip; i++) {
+            unsigned value = rand() % 3 ? rand() % 64 : rand();
+            if (rand() % 16 == 0)
+               value = restart_index;
+            write_index(buffer, index_size, i, value & type_max);
+         }
+
+         unsigned ref_min = ~0u, ref_max = 0, ref_pos = count;
+         for (unsigned i = 0; i < count; i++) {
+            unsigned value = read_index(indices, index_size, i);
+            if (value == restart_index && ref_pos == count)
+               ref_pos = i;
+            if (restart && value == restart_index)
+               continue;
+            ref_min = std::min(ref_min, value);
+            ref_max = std::max(ref_max, value);
+         }
+
+         for (unsigned k = 0; k < list.size(); k++) {
+            unsigned min, max;
+
+            list[k].min_max(indices, index_size, count, restart,
+                            restart_index, &min, &max);
+            EXPECT_EQ(ref_min, min) << list[k].name << " size " << index_size
+                                    << " count " << count;
+            EXPECT_EQ(ref_max, max) << list[k].name << " size " << index_size
+                                    << " count " << count;
+            EXPECT_EQ(ref_pos, list[k].find(indices, index_size, count,
+                                            restart_index))
+               << list[k].name << " size " << index_size
+               << " count " << count;
+         }
+      }
+   }
+}
+
+/* A restart index that doesn't fit in the index type never matches. */
+TEST(IndexScan, WideRestartIndex)
+{
+   const uint16_t indices[] = { 0xffff, 3, 0xffff, 9 };
+   unsigned min, max;
+
+   _mesa_get_x86_features();
+   _mesa_index_min_max(indices, 2, 4, true, 0xffffffff, &min, &max);
+   EXPECT_EQ(3u, min);
+   EXPECT_EQ(0xffffu, max);
+   EXPECT_EQ(4u, _mesa_index_find(indices, 2, 4, 0xffffffff));
+}
@@ -0,0 +1,205 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Measures the index min/max and restart search kernels used by vbo:
+ *
+ *    index_scan_bench [-n indices] [-i iterations]
+ *
+ * For every index size, the throughput of the scalar code and of each SIMD
+ * version the CPU supports is printed in Gindices/s, for min/max without
+ * and with a restart index, and for splitting the buffer at restart
+ * indices like vbo_sw_primitive_restart() does.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "main/sse_minmax.h"
+#include "x86/common_x86_asm.h"
+#include "util/u_index_range.h"
+#include "util/u_timer.h"
+
+/* Keeps the compiler from dropping the results. */
+volatile unsigned sink;
+
+typedef void (*min_max_func)(const void *, unsigned, unsigned, bool,
+                             unsigned, unsigned *, unsigned *);
+typedef unsigned (*find_func)(const void *, unsigned, unsigned, unsigned);
+
+struct kernels {
+   const char *name;
+   min_max_func min_max;
+   find_func find;
+};
+
+static unsigned
+scalar_find(const void *indices, unsigned index_size, unsigned count,
+            unsigned value)
+{
+   unsigned i;
+
+   for (i = 0; i < count; i++) {
+      unsigned index = index_size == 1 ? ((const uint8_t *) indices)[i] :
+                       index_size == 2 ? ((const uint16_t *) indices)[i] :
+                       ((const uint32_t *) indices)[i];
+      if (index == value)
+         return i;
+   }
+
+   return count;
+}
+
+/* Split the buffer into sub-primitives, like vbo_primitive_restart.c. */
+static unsigned
+split_restarts(const struct kernels *k, const uint8_t *indices,
+               unsigned index_size, unsigned count, unsigned restart_index)
+{
+   unsigned i, len, num = 0, min, max, sum = 0;
+
+   for (i = 0; i < count; i += len + 1) {
+      len = k->find(indices + i * index_size, index_size, count - i,
+                    restart_index);
+      if (len) {
+         k->min_max(indices + i * index_size, index_size, len, false, 0,
+                    &min, &max);
+         sum += min + max;
+         num++;
+      }
+   }
+
+   return num + (sum & 1);
+}
+
+int
+main(int argc, char **argv)
+{
+   static const unsigned index_sizes[] = { 1, 2, 4 };
+   struct kernels list[3];
+   unsigned num_kernels = 0;
+   unsigned count = 1 << 20, iterations = 200;
+   uint8_t *buffer;
+   unsigned i, s, k;
+
+   for (i = 1; i < (unsigned) argc; i++) {
+      if (strcmp(argv[i], "-n") == 0 && i + 1 < (unsigned) argc) {
+         count = atoi(argv[++i]);
+      } else if (strcmp(argv[i], "-i") == 0 && i + 1 < (unsigned) argc) {
+         iterations = atoi(argv[++i]);
+      } else {
+         fprintf(stderr, "usage: %s [-n indices] [-i iterations]\n", argv[0]);
+         return 1;
+      }
+   }
+
+   _mesa_get_x86_features();
+
+   list[num_kernels].name = "scalar";
+   list[num_kernels].min_max = util_index_range_scan;
+   list[num_kernels].find = scalar_find;
+   num_kernels++;
+#if defined(USE_SSE41)
+   if (cpu_has_sse4_1) {
+      list[num_kernels].name = "sse4.1";
+      list[num_kernels].min_max = _mesa_sse41_index_min_max;
+      list[num_kernels].find = _mesa_sse41_index_find;
+      num_kernels++;
+   }
+#endif
+#if defined(USE_AVX2)
+   if (cpu_has_avx2) {
+      list[num_kernels].name = "avx2";
+      list[num_kernels].min_max = _mesa_avx2_index_min_max;
+      list[num_kernels].find = _mesa_avx2_index_find;
+      num_kernels++;
+   }
+#endif
+
+   buffer = malloc(count * 4);
+   if (!buffer)
+      return 1;
+
+   printf("%u indices, Gindices/s\n\n", count);
+   printf("%-28s", "");
+   for (k = 0; k < num_kernels; k++)
+      printf("%8s", list[k].name);
+   printf("\n");
+
+   for (s = 0; s < 3; s++) {
+      const unsigned index_size = index_sizes[s];
+      const unsigned restart_index = index_size == 4 ? ~0u :
+                                     (1u << (8 * index_size)) - 1;
+      static const char *tests[] = { "min/max", "min/max, restart",
+                                     "split at restarts" };
+      unsigned t;
+
+      /* Strips of 8 to 40 vertices separated by restart indices. */
+      srand(1);
+      for (i = 0; i < count; i++) {
+         unsigned value = rand() % 60000 % restart_index;
+         if (rand() % 24 == 0)
+            value = restart_index;
+         if (index_size == 1)
+            buffer[i] = value;
+         else if (index_size == 2)
+            ((uint16_t *) buffer)[i] = value;
+         else
+            ((uint32_t *) buffer)[i] = value;
+      }
+
+      for (t = 0; t < 3; t++) {
+         char label[64];
+
+         snprintf(label, sizeof(label), "%-9s %s", index_size == 1 ? "ubyte" :
+                  index_size == 2 ? "ushort" : "uint", tests[t]);
+         printf("%-28s", label);
+
+         for (k = 0; k < num_kernels; k++) {
+            unsigned min, max;
+            int64_t start = util_timer_get_nano();
+            double secs;
+
+            for (i = 0; i < iterations; i++) {
+               if (t == 2) {
+                  sink += split_restarts(&list[k], buffer, index_size, count,
+                                         restart_index);
+               } else {
+                  list[k].min_max(buffer, index_size, count, t == 1,
+                                  restart_index, &min, &max);
+                  sink += min + max;
+               }
+            }
+
+            secs = (util_timer_get_nano() - start) / 1e9;
+            printf("%8.2f", (double) count * iterations / secs / 1e9);
+         }
+         printf("\n");
+      }
+   }
+
+   free(buffer);
+   return 0;
+}
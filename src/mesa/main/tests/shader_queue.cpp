@@ -0,0 +1,187 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/* Compiles shaders in the background (GL_ARB_parallel_shader_compile) and
+ * checks that the results are the same as compiling them synchronously, and
+ * that debug messages still reach the callback on the calling thread.
+ */
+
+#include <gtest/gtest.h>
+
+#include "GL/gl.h"
+#include "GL/glext.h"
+#include "main/compiler.h"
+#include "main/context.h"
+#include "main/debug_output.h"
+#include "main/shaderapi.h"
+#include "glapi/glapi.h"
+#include "drivers/common/driverfuncs.h"
+#include "c11/threads.h"
+#include "util/macros.h"
+
+static const char *const good_source =
+   "void main() { gl_Position = vec4(0.0); }\n";
+
+static const char *const bad_source =
+   "void main() { gl_Position = undeclared; }\n";
+
+class ShaderQueue_test : public ::testing::Test {
+public:
+   virtual void SetUp();
+   virtual void TearDown();
+
+   GLuint compile(const char *source);
+   GLint get_shader(GLuint shader, GLenum pname);
+
+   struct gl_config visual;
+   struct dd_function_table driver_functions;
+   struct gl_context ctx;
+};
+
+void
+ShaderQueue_test::SetUp()
+{
+   memset(&visual, 0, sizeof(visual));
+   memset(&driver_functions, 0, sizeof(driver_functions));
+   memset(&ctx, 0, sizeof(ctx));
+
+   _mesa_init_driver_functions(&driver_functions);
+   _mesa_initialize_context(&ctx, API_OPENGL_COMPAT, &visual, NULL,
+                            &driver_functions);
+   ctx.Extensions.ARB_vertex_shader = true;
+   ctx.Version = 21;
+
+   _glapi_set_context(&ctx);
+}
+
+void
+ShaderQueue_test::TearDown()
+{
+   _mesa_finish_shader_queue();
+   _glapi_set_context(NULL);
+   _mesa_free_context_data(&ctx);
+}
+
+GLuint
+ShaderQueue_test::compile(const char *source)
+{
+   GLuint shader = _mesa_CreateShader(GL_VERTEX_SHADER);
+
+   _mesa_ShaderSource(shader, 1, &source, NULL);
+   _mesa_CompileShader(shader);
+   return shader;
+}
+
+GLint
+ShaderQueue_test::get_shader(GLuint shader, GLenum pname)
+{
+   GLint value = -1;
+
+   _mesa_GetShaderiv(shader, pname, &value);
+   return value;
+}
+
+TEST_F(ShaderQueue_test, BackgroundCompileResults)
+{
+   GLuint shaders[16];
+
+   _mesa_MaxShaderCompilerThreadsARB(4);
+
+   /* More shaders than the count, so that some are compiled on this
+    * thread.
+    */
+   for (unsigned i = 0; i < ARRAY_SIZE(shaders); i++)
+      shaders[i] = compile(i % 2 ? bad_source : good_source);
+
+   for (unsigned i = 0; i < ARRAY_SIZE(shaders); i++) {
+      GLint status = get_shader(shaders[i], GL_COMPILE_STATUS);
+
+      EXPECT_EQ(i % 2 ? GL_FALSE : GL_TRUE, status) << "shader " << i;
+      EXPECT_EQ(GL_TRUE, get_shader(shaders[i], GL_COMPLETION_STATUS_ARB));
+      if (i % 2) {
+         EXPECT_LT(1, get_shader(shaders[i], GL_INFO_LOG_LENGTH));
+      }
+
+      _mesa_DeleteShader(shaders[i]);
+   }
+
+   EXPECT_EQ(0u, ctx.ShaderQueueJobs);
+}
+
+TEST_F(ShaderQueue_test, RecompileWhileQueued)
+{
+   GLuint shader;
+
+   _mesa_MaxShaderCompilerThreadsARB(1);
+
+   shader = compile(bad_source);
+   _mesa_ShaderSource(shader, 1, &good_source, NULL);
+   _mesa_CompileShader(shader);
+
+   EXPECT_EQ(GL_TRUE, get_shader(shader, GL_COMPILE_STATUS));
+   _mesa_DeleteShader(shader);
+}
+
+struct callback_data {
+   thrd_t thread;
+   unsigned num_messages;
+   unsigned num_other_thread;
+};
+
+static void GLAPIENTRY
+debug_callback(GLenum source, GLenum type, GLuint id, GLenum severity,
+               GLsizei length, const GLchar *message, const void *user_data)
+{
+   struct callback_data *data = (struct callback_data *) user_data;
+
+   data->num_messages++;
+   if (!thrd_equal(thrd_current(), data->thread))
+      data->num_other_thread++;
+}
+
+TEST_F(ShaderQueue_test, DebugCallbackOnCallingThread)
+{
+   struct callback_data data;
+   GLuint shader;
+
+   memset(&data, 0, sizeof(data));
+   data.thread = thrd_current();
+
+   _mesa_MaxShaderCompilerThreadsARB(4);
+   _mesa_set_debug_state_int(&ctx, GL_DEBUG_OUTPUT, GL_TRUE);
+   _mesa_DebugMessageCallback(debug_callback, &data);
+
+   /* The compile error is reported before glCompileShader returns. */
+   shader = compile(bad_source);
+   EXPECT_LT(0u, data.num_messages);
+   EXPECT_EQ(0u, data.num_other_thread);
+   EXPECT_EQ(GL_FALSE, get_shader(shader, GL_COMPILE_STATUS));
+   _mesa_DeleteShader(shader);
+
+   /* Only a callback or synchronous output keep the compiles here. */
+   _mesa_DebugMessageCallback(NULL, NULL);
+   EXPECT_FALSE(_mesa_debug_output_is_synchronous(&ctx));
+
+   _mesa_set_debug_state_int(&ctx, GL_DEBUG_OUTPUT_SYNCHRONOUS_ARB, GL_TRUE);
+   EXPECT_TRUE(_mesa_debug_output_is_synchronous(&ctx));
+}
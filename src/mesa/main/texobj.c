@@ -37,6 +37,7 @@
 #include "hash.h"
 #include "imports.h"
 #include "macros.h"
+#include "samplerobj.h"
 #include "shaderimage.h"
 #include "teximage.h"
 #include "texobj.h"
@@ -329,6 +330,7 @@ _mesa_initialize_texture_object( struct gl_context *ctx,
    obj->Swizzle[3] = GL_ALPHA;
    obj->_Swizzle = SWIZZLE_NOOP;
    obj->Sampler.sRGBDecode = GL_DECODE_EXT;
+   _mesa_sampler_state_changed(&obj->Sampler);
    obj->BufferObjectFormat = GL_R8;
    obj->_BufferObjectFormat = MESA_FORMAT_R_UNORM8;
    obj->ImageFormatCompatibilityType = GL_IMAGE_FORMAT_COMPATIBILITY_BY_SIZE;
@@ -364,6 +366,7 @@ finish_texture_init(struct gl_context *ctx, GLenum target,
          obj->Sampler.WrapR = GL_CLAMP_TO_EDGE;
          obj->Sampler.MinFilter = filter;
          obj->Sampler.MagFilter = filter;
+         _mesa_sampler_state_changed(&obj->Sampler);
          if (ctx->Driver.TexParameter) {
             static const GLfloat fparam_wrap[1] = {(GLfloat) GL_CLAMP_TO_EDGE};
             const GLfloat fparam_filter[1] = {(GLfloat) filter};
@@ -460,6 +463,7 @@ _mesa_copy_texture_object( struct gl_texture_object *dest,
    dest->DepthMode = src->DepthMode;
    dest->StencilSampling = src->StencilSampling;
    dest->Sampler.sRGBDecode = src->Sampler.sRGBDecode;
+   _mesa_sampler_state_changed(&dest->Sampler);
    dest->_MaxLevel = src->_MaxLevel;
    dest->_MaxLambda = src->_MaxLambda;
    dest->GenerateMipmap = src->GenerateMipmap;
@@ -1029,6 +1033,7 @@ _mesa_get_fallback_texture(struct gl_context *ctx, gl_texture_index tex)
       assert(texObj->RefCount == 1);
       texObj->Sampler.MinFilter = GL_NEAREST;
       texObj->Sampler.MagFilter = GL_NEAREST;
+      _mesa_sampler_state_changed(&texObj->Sampler);
 
       texFormat = ctx->Driver.ChooseTextureFormat(ctx, target,
                                                   GL_RGBA, GL_RGBA,
@@ -1414,7 +1419,7 @@ unbind_textures_from_unit(struct gl_context *ctx, GLuint unit)
          ctx->Driver.BindTexture(ctx, unit, 0, texObj);
 
       texUnit->_BoundTextures &= ~(1 << index);
-      ctx->NewState |= _NEW_TEXTURE;
+      _mesa_flag_texture_unit_binding(ctx, unit);
    }
 }
 
@@ -1635,7 +1640,8 @@ bind_texture(struct gl_context *ctx,
    }
 
    /* flush before changing binding */
-   FLUSH_VERTICES(ctx, _NEW_TEXTURE);
+   FLUSH_VERTICES(ctx, 0);
+   _mesa_flag_texture_unit_binding(ctx, unit);
 
    /* If the refcount on the previously bound texture is decremented to
     * zero, it'll be deleted here.
@@ -38,6 +38,7 @@
 #include "main/glformats.h"
 #include "main/macros.h"
 #include "main/mtypes.h"
+#include "main/samplerobj.h"
 #include "main/state.h"
 #include "main/texcompress.h"
 #include "main/texobj.h"
@@ -231,9 +232,10 @@ set_swizzle_component(GLuint *swizzle, GLuint comp, GLuint swz)
  * will not affect texture completeness.
  */
 static inline void
-flush(struct gl_context *ctx)
+flush(struct gl_context *ctx, struct gl_texture_object *texObj)
 {
    FLUSH_VERTICES(ctx, _NEW_TEXTURE);
+   _mesa_sampler_state_changed(&texObj->Sampler);
 }
 
 
@@ -287,7 +289,7 @@ set_tex_parameteri(struct gl_context *ctx,
       switch (params[0]) {
       case GL_NEAREST:
       case GL_LINEAR:
-         flush(ctx);
+         flush(ctx, texObj);
          texObj->Sampler.MinFilter = params[0];
          return GL_TRUE;
       case GL_NEAREST_MIPMAP_NEAREST:
@@ -296,7 +298,7 @@ set_tex_parameteri(struct gl_context *ctx,
       case GL_LINEAR_MIPMAP_LINEAR:
          if (texObj->Target != GL_TEXTURE_RECTANGLE_NV &&
              texObj->Target != GL_TEXTURE_EXTERNAL_OES) {
-            flush(ctx);
+            flush(ctx, texObj);
             texObj->Sampler.MinFilter = params[0];
             return GL_TRUE;
          }
@@ -315,7 +317,7 @@ set_tex_parameteri(struct gl_context *ctx,
       switch (params[0]) {
       case GL_NEAREST:
       case GL_LINEAR:
-         flush(ctx); /* does not effect completeness */
+         flush(ctx, texObj); /* does not effect completeness */
          texObj->Sampler.MagFilter = params[0];
          return GL_TRUE;
       default:
@@ -330,7 +332,7 @@ set_tex_parameteri(struct gl_context *ctx,
       if (texObj->Sampler.WrapS == params[0])
          return GL_FALSE;
       if (validate_texture_wrap_mode(ctx, texObj->Target, params[0])) {
-         flush(ctx);
+         flush(ctx, texObj);
          texObj->Sampler.WrapS = params[0];
          return GL_TRUE;
       }
@@ -343,7 +345,7 @@ set_tex_parameteri(struct gl_context *ctx,
       if (texObj->Sampler.WrapT == params[0])
          return GL_FALSE;
       if (validate_texture_wrap_mode(ctx, texObj->Target, params[0])) {
-         flush(ctx);
+         flush(ctx, texObj);
          texObj->Sampler.WrapT = params[0];
          return GL_TRUE;
       }
@@ -356,7 +358,7 @@ set_tex_parameteri(struct gl_context *ctx,
       if (texObj->Sampler.WrapR == params[0])
          return GL_FALSE;
       if (validate_texture_wrap_mode(ctx, texObj->Target, params[0])) {
-         flush(ctx);
+         flush(ctx, texObj);
          texObj->Sampler.WrapR = params[0];
          return GL_TRUE;
       }
@@ -445,7 +447,7 @@ set_tex_parameteri(struct gl_context *ctx,
             return GL_FALSE;
          if (params[0] == GL_NONE ||
              params[0] == GL_COMPARE_R_TO_TEXTURE_ARB) {
-            flush(ctx);
+            flush(ctx, texObj);
             texObj->Sampler.CompareMode = params[0];
             return GL_TRUE;
          }
@@ -471,7 +473,7 @@ set_tex_parameteri(struct gl_context *ctx,
          case GL_GREATER:
          case GL_ALWAYS:
          case GL_NEVER:
-            flush(ctx);
+            flush(ctx, texObj);
             texObj->Sampler.CompareFunc = params[0];
             return GL_TRUE;
          default:
@@ -491,7 +493,7 @@ set_tex_parameteri(struct gl_context *ctx,
              params[0] == GL_INTENSITY ||
              params[0] == GL_ALPHA ||
              (ctx->Extensions.ARB_texture_rg && params[0] == GL_RED)) {
-            flush(ctx);
+            flush(ctx, texObj);
             texObj->DepthMode = params[0];
             return GL_TRUE;
          }
@@ -538,7 +540,7 @@ set_tex_parameteri(struct gl_context *ctx,
          }
          assert(comp < 4);
 
-         flush(ctx);
+         flush(ctx, texObj);
          texObj->Swizzle[comp] = params[0];
          set_swizzle_component(&texObj->_Swizzle, comp, swz);
          return GL_TRUE;
@@ -549,7 +551,7 @@ set_tex_parameteri(struct gl_context *ctx,
       if ((_mesa_is_desktop_gl(ctx) && ctx->Extensions.EXT_texture_swizzle)
           || _mesa_is_gles3(ctx)) {
          GLuint comp;
-         flush(ctx);
+         flush(ctx, texObj);
          for (comp = 0; comp < 4; comp++) {
             const GLint swz = comp_to_swizzle(params[comp]);
             if (swz >= 0) {
@@ -576,7 +578,7 @@ set_tex_parameteri(struct gl_context *ctx,
 
 	 if (decode == GL_DECODE_EXT || decode == GL_SKIP_DECODE_EXT) {
 	    if (texObj->Sampler.sRGBDecode != decode) {
-	       flush(ctx);
+	       flush(ctx, texObj);
 	       texObj->Sampler.sRGBDecode = decode;
 	    }
 	    return GL_TRUE;
@@ -596,7 +598,7 @@ set_tex_parameteri(struct gl_context *ctx,
             goto invalid_param;
          }
          if (param != texObj->Sampler.CubeMapSeamless) {
-            flush(ctx);
+            flush(ctx, texObj);
             texObj->Sampler.CubeMapSeamless = param;
          }
          return GL_TRUE;
@@ -650,7 +652,7 @@ set_tex_parameterf(struct gl_context *ctx,
 
       if (texObj->Sampler.MinLod == params[0])
          return GL_FALSE;
-      flush(ctx);
+      flush(ctx, texObj);
       texObj->Sampler.MinLod = params[0];
       return GL_TRUE;
 
@@ -663,7 +665,7 @@ set_tex_parameterf(struct gl_context *ctx,
 
       if (texObj->Sampler.MaxLod == params[0])
          return GL_FALSE;
-      flush(ctx);
+      flush(ctx, texObj);
       texObj->Sampler.MaxLod = params[0];
       return GL_TRUE;
 
@@ -671,7 +673,7 @@ set_tex_parameterf(struct gl_context *ctx,
       if (ctx->API != API_OPENGL_COMPAT)
          goto invalid_pname;
 
-      flush(ctx);
+      flush(ctx, texObj);
       texObj->Priority = CLAMP(params[0], 0.0F, 1.0F);
       return GL_TRUE;
 
@@ -687,7 +689,7 @@ set_tex_parameterf(struct gl_context *ctx,
                         suffix);
             return GL_FALSE;
          }
-         flush(ctx);
+         flush(ctx, texObj);
          /* clamp to max, that's what NVIDIA does */
          texObj->Sampler.MaxAnisotropy = MIN2(params[0],
                                       ctx->Const.MaxTextureMaxAnisotropy);
@@ -709,7 +711,7 @@ set_tex_parameterf(struct gl_context *ctx,
          goto invalid_enum;
 
       if (texObj->Sampler.LodBias != params[0]) {
-	 flush(ctx);
+	 flush(ctx, texObj);
 	 texObj->Sampler.LodBias = params[0];
 	 return GL_TRUE;
       }
@@ -723,7 +725,7 @@ set_tex_parameterf(struct gl_context *ctx,
       if (!_mesa_target_allows_setting_sampler_parameters(texObj->Target))
          goto invalid_enum;
 
-      flush(ctx);
+      flush(ctx, texObj);
       /* ARB_texture_float disables clamping */
       if (ctx->Extensions.ARB_texture_float) {
          texObj->Sampler.BorderColor.f[RCOMP] = params[0];
@@ -983,7 +985,7 @@ _mesa_texture_parameterIiv(struct gl_context *ctx,
 {
    switch (pname) {
    case GL_TEXTURE_BORDER_COLOR:
-      FLUSH_VERTICES(ctx, _NEW_TEXTURE);
+      flush(ctx, texObj);
       /* set the integer-valued border color */
       COPY_4V(texObj->Sampler.BorderColor.i, params);
       break;
@@ -1001,7 +1003,7 @@ _mesa_texture_parameterIuiv(struct gl_context *ctx,
 {
    switch (pname) {
    case GL_TEXTURE_BORDER_COLOR:
-      FLUSH_VERTICES(ctx, _NEW_TEXTURE);
+      flush(ctx, texObj);
       /* set the unsigned integer-valued border color */
       COPY_4V(texObj->Sampler.BorderColor.ui, params);
       break;
@@ -566,6 +566,20 @@ update_single_program_texture(struct gl_context *ctx, struct gl_program *prog,
    return texObj;
 }
 
+/**
+ * Set the texture object a unit samples from, flagging the unit if it
+ * changed so that drivers only have to revisit that unit.
+ */
+static void
+set_current_texture(struct gl_context *ctx, GLuint unit,
+                    struct gl_texture_object *texObj)
+{
+   if (ctx->Texture.Unit[unit]._Current != texObj) {
+      _mesa_reference_texobj(&ctx->Texture.Unit[unit]._Current, texObj);
+      _mesa_flag_texture_unit_binding(ctx, unit);
+   }
+}
+
 static void
 update_program_texture_state(struct gl_context *ctx, struct gl_program **prog,
                              BITSET_WORD *enabled_texture_units)
@@ -588,7 +602,7 @@ update_program_texture_state(struct gl_context *ctx, struct gl_program **prog,
          texObj = update_single_program_texture(ctx, prog[i], s);
          if (texObj) {
             int unit = prog[i]->SamplerUnits[s];
-            _mesa_reference_texobj(&ctx->Texture.Unit[unit]._Current, texObj);
+            set_current_texture(ctx, unit, texObj);
             BITSET_SET(enabled_texture_units, unit);
             ctx->Texture._MaxEnabledTexImageUnit =
                MAX2(ctx->Texture._MaxEnabledTexImageUnit, (int)unit);
@@ -663,7 +677,7 @@ update_ff_texture_state(struct gl_context *ctx,
             _mesa_test_texobj_completeness(ctx, texObj);
          }
          if (_mesa_is_texture_complete(texObj, sampler)) {
-            _mesa_reference_texobj(&texUnit->_Current, texObj);
+            set_current_texture(ctx, unit, texObj);
             complete = true;
             break;
          }
@@ -711,8 +725,8 @@ update_texture_state( struct gl_context *ctx )
       }
    }
 
-   /* TODO: only set this if there are actual changes */
-   ctx->NewState |= _NEW_TEXTURE;
+   /* Units whose _Current changes are flagged by set_current_texture(). */
+   ctx->NewState |= _NEW_TEXTURE_BINDINGS;
 
    ctx->Texture._GenFlags = 0x0;
    ctx->Texture._TexMatEnabled = 0x0;
@@ -737,10 +751,10 @@ update_texture_state( struct gl_context *ctx )
    /* Now, clear out the _Current of any disabled texture units. */
    for (i = 0; i <= ctx->Texture._MaxEnabledTexImageUnit; i++) {
       if (!BITSET_TEST(enabled_texture_units, i))
-         _mesa_reference_texobj(&ctx->Texture.Unit[i]._Current, NULL);
+         set_current_texture(ctx, i, NULL);
    }
    for (i = ctx->Texture._MaxEnabledTexImageUnit + 1; i <= old_max_unit; i++) {
-      _mesa_reference_texobj(&ctx->Texture.Unit[i]._Current, NULL);
+      set_current_texture(ctx, i, NULL);
    }
 
    if (!prog[MESA_SHADER_FRAGMENT] || !prog[MESA_SHADER_VERTEX])
@@ -55,6 +55,19 @@ _mesa_get_current_tex_unit(struct gl_context *ctx)
    return _mesa_get_tex_unit(ctx, ctx->Texture.CurrentUnit);
 }
 
+/**
+ * Flag that the texture or sampler object bound to a unit changed.  No
+ * other texture state may have been changed, otherwise _NEW_TEXTURE has to
+ * be flagged too.
+ */
+static inline void
+_mesa_flag_texture_unit_binding(struct gl_context *ctx, GLuint unit)
+{
+   assert(unit < ARRAY_SIZE(ctx->Texture.Unit));
+   ctx->NewState |= _NEW_TEXTURE_BINDINGS;
+   ctx->Texture._DirtyUnits[unit / 32] |= 1u << (unit % 32);
+}
+
 static inline GLuint
 _mesa_max_tex_unit(struct gl_context *ctx)
 {
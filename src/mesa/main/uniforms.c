@@ -1021,6 +1021,9 @@ _mesa_UniformBlockBinding(GLuint program,
 
       FLUSH_VERTICES(ctx, 0);
       ctx->NewDriverState |= ctx->DriverFlags.NewUniformBuffer;
+      /* The block now reads from another binding point, flag all of them. */
+      memset(ctx->NewUniformBufferBindings, 0xff,
+             sizeof(ctx->NewUniformBufferBindings));
 
       shProg->UniformBlocks[uniformBlockIndex].Binding = uniformBlockBinding;
    }
@@ -1064,6 +1067,8 @@ _mesa_ShaderStorageBlockBinding(GLuint program,
 
       FLUSH_VERTICES(ctx, 0);
       ctx->NewDriverState |= ctx->DriverFlags.NewShaderStorageBuffer;
+      memset(ctx->NewShaderStorageBufferBindings, 0xff,
+             sizeof(ctx->NewShaderStorageBufferBindings));
 
       shProg->ShaderStorageBlocks[shaderStorageBlockIndex].Binding =
          shaderStorageBlockBinding;
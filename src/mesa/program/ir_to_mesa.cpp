@@ -52,6 +52,8 @@
 #include "program/prog_print.h"
 #include "program/program.h"
 #include "program/prog_parameter.h"
+#include "program/shader_cache.h"
+#include "util/compile_profile.h"
 
 
 static int swizzle_for_size(int size);
@@ -3044,11 +3046,38 @@ _mesa_ir_link_shader(struct gl_context *ctx, struct gl_shader_program *prog)
    return prog->LinkStatus;
 }
 
+static void
+print_link_status(struct gl_context *ctx, struct gl_shader_program *prog)
+{
+   if (ctx->_Shader->Flags & GLSL_DUMP) {
+      if (!prog->LinkStatus) {
+	 fprintf(stderr, "GLSL shader program %d failed to link\n", prog->Name);
+      }
+
+      if (prog->InfoLog && prog->InfoLog[0] != 0) {
+	 fprintf(stderr, "GLSL shader program %d info log:\n", prog->Name);
+	 fprintf(stderr, "%s\n", prog->InfoLog);
+      }
+   }
+}
+
+
 /**
- * Link a GLSL shader program.  Called via glLinkProgram().
+ * First part of _mesa_glsl_link_shader(), which has to run on the
+ * application's thread.
+ *
+ * \param compiled  whether all the attached shaders are known to have
+ *                  finished compiling.  If not, the program cache isn't
+ *                  looked up, and the compile status of the shaders is only
+ *                  checked by _mesa_glsl_link_shader_front_end().
+ *
+ * \return false if the program was restored from the program cache, in
+ *         which case the link is complete.
  */
-void
-_mesa_glsl_link_shader(struct gl_context *ctx, struct gl_shader_program *prog)
+bool
+_mesa_glsl_link_shader_prepare(struct gl_context *ctx,
+                               struct gl_shader_program *prog,
+                               bool compiled)
 {
    unsigned int i;
 
@@ -3056,32 +3085,97 @@ _mesa_glsl_link_shader(struct gl_context *ctx, struct gl_shader_program *prog)
 
    prog->LinkStatus = GL_TRUE;
 
+   if (compiled) {
+      for (i = 0; i < prog->NumShaders; i++) {
+         if (!prog->Shaders[i]->CompileStatus) {
+            linker_error(prog, "linking with uncompiled shader");
+         }
+      }
+
+      if (prog->LinkStatus && _mesa_shader_cache_read_program(ctx, prog)) {
+         print_link_status(ctx, prog);
+         return false;
+      }
+   }
+
+   /* Shaders whose compile was skipped are needed after all */
+   for (i = 0; i < prog->NumShaders && prog->LinkStatus; i++) {
+      if (prog->Shaders[i]->CompileSkipped) {
+         _mesa_shader_cache_compile_skipped(ctx, prog->Shaders[i]);
+         if (!prog->Shaders[i]->CompileStatus)
+            linker_error(prog, "linking with uncompiled shader");
+      }
+   }
+
+   return true;
+}
+
+
+/**
+ * Second part of _mesa_glsl_link_shader(): the GLSL linker.
+ *
+ * This only depends on the constant state of the context, so it may run on
+ * any thread, as long as the attached shaders have finished compiling and
+ * nothing else accesses the program.
+ */
+void
+_mesa_glsl_link_shader_front_end(struct gl_context *ctx,
+                                 struct gl_shader_program *prog)
+{
+   unsigned int i;
+
+   if (!prog->LinkStatus)
+      return;
+
    for (i = 0; i < prog->NumShaders; i++) {
       if (!prog->Shaders[i]->CompileStatus) {
-	 linker_error(prog, "linking with uncompiled shader");
+         linker_error(prog, "linking with uncompiled shader");
+         return;
       }
    }
 
-   if (prog->LinkStatus) {
-      link_shaders(ctx, prog);
-   }
+   compile_profile_shader_scope profile_shader("program %u", prog->Name);
+   compile_profile_scope profile("glsl", "link_shaders");
+
+   link_shaders(ctx, prog);
+}
+
 
+/**
+ * Last part of _mesa_glsl_link_shader(), which runs the driver back end and
+ * has to run on the application's thread.
+ */
+void
+_mesa_glsl_link_shader_finish(struct gl_context *ctx,
+                              struct gl_shader_program *prog)
+{
    if (prog->LinkStatus) {
+      compile_profile_shader_scope profile_shader("program %u", prog->Name);
+      compile_profile_scope profile("driver", "LinkShader");
+
       if (!ctx->Driver.LinkShader(ctx, prog)) {
 	 prog->LinkStatus = GL_FALSE;
       }
    }
 
-   if (ctx->_Shader->Flags & GLSL_DUMP) {
-      if (!prog->LinkStatus) {
-	 fprintf(stderr, "GLSL shader program %d failed to link\n", prog->Name);
-      }
+   if (prog->LinkStatus)
+      _mesa_shader_cache_write_program(ctx, prog);
 
-      if (prog->InfoLog && prog->InfoLog[0] != 0) {
-	 fprintf(stderr, "GLSL shader program %d info log:\n", prog->Name);
-	 fprintf(stderr, "%s\n", prog->InfoLog);
-      }
-   }
+   print_link_status(ctx, prog);
+}
+
+
+/**
+ * Link a GLSL shader program.  Called via glLinkProgram().
+ */
+void
+_mesa_glsl_link_shader(struct gl_context *ctx, struct gl_shader_program *prog)
+{
+   if (!_mesa_glsl_link_shader_prepare(ctx, prog, true))
+      return;
+
+   _mesa_glsl_link_shader_front_end(ctx, prog);
+   _mesa_glsl_link_shader_finish(ctx, prog);
 }
 
 } /* extern "C" */
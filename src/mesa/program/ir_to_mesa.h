@@ -23,6 +23,7 @@
 
 #pragma once
 
+#include <stdbool.h>
 #include "main/glheader.h"
 
 #ifdef __cplusplus
@@ -34,6 +35,13 @@ struct gl_shader;
 struct gl_shader_program;
 
 void _mesa_glsl_link_shader(struct gl_context *ctx, struct gl_shader_program *prog);
+bool _mesa_glsl_link_shader_prepare(struct gl_context *ctx,
+                                    struct gl_shader_program *prog,
+                                    bool compiled);
+void _mesa_glsl_link_shader_front_end(struct gl_context *ctx,
+                                      struct gl_shader_program *prog);
+void _mesa_glsl_link_shader_finish(struct gl_context *ctx,
+                                   struct gl_shader_program *prog);
 GLboolean _mesa_ir_link_shader(struct gl_context *ctx, struct gl_shader_program *prog);
 
 void
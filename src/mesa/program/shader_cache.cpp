@@ -0,0 +1,1461 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file shader_cache.cpp
+ *
+ * Serialization of linked programs to the on-disk cache.
+ *
+ * Everything pointing into other parts of the program (remap tables, block
+ * lists, program resources) is written as indices, and turned back into
+ * pointers when reading.  Strings and types are always written by value.
+ */
+
+#include <stdlib.h>
+#include "c11/threads.h"
+#include "main/compiler.h"
+#include "main/macros.h"
+#include "main/mtypes.h"
+#include "main/shaderobj.h"
+#include "main/uniforms.h"
+#include "compiler/glsl/blob.h"
+#include "compiler/glsl/ir_uniform.h"
+#include "compiler/glsl/program.h"
+#include "compiler/glsl_types.h"
+#include "program/hash_table.h"
+#include "program/ir_to_mesa.h"
+#include "program/prog_parameter.h"
+#include "program/program.h"
+#include "program/shader_cache.h"
+#include "util/disk_cache.h"
+#include "util/mesa-sha1.h"
+#include "util/ralloc.h"
+
+
+/**
+ * Must be bumped whenever the layout of cache entries changes.  Builds are
+ * told apart by timestamp anyway, this only matters for development trees.
+ */
+#define SHADER_CACHE_VERSION 1
+
+/**
+ * Default size limit, can be overridden with MESA_SHADER_CACHE_MAX_SIZE.
+ */
+#define SHADER_CACHE_DEFAULT_SIZE (64 * 1024 * 1024)
+
+/* Encodings of the remap table entries that aren't uniforms */
+#define REMAP_NULL     ~0u
+#define REMAP_INACTIVE (~0u - 1)
+
+/* Flags that make the compiler print or alter shaders */
+#define SHADER_CACHE_UNSAFE_FLAGS (GLSL_DUMP | GLSL_LOG | GLSL_OPT | \
+                                   GLSL_NO_OPT | GLSL_NOP_VERT | GLSL_NOP_FRAG)
+
+
+static struct disk_cache *shader_cache = NULL;
+static uint32_t shader_cache_timestamp = 0;
+static once_flag shader_cache_once_flag = ONCE_FLAG_INIT;
+
+
+static void
+shader_cache_init(void)
+{
+   /* Everything we store depends on the compiler, so never use entries
+    * written by a different build.
+    */
+   if (!disk_cache_get_function_timestamp((void *) shader_cache_init,
+                                          &shader_cache_timestamp))
+      return;
+
+   shader_cache = disk_cache_create("glsl", SHADER_CACHE_DEFAULT_SIZE);
+}
+
+
+static struct disk_cache *
+get_cache(struct gl_context *ctx)
+{
+   if (!ctx->Driver.ShaderCacheSerialize ||
+       !ctx->Driver.ShaderCacheDeserialize)
+      return NULL;
+
+   if (ctx->_Shader->Flags & SHADER_CACHE_UNSAFE_FLAGS)
+      return NULL;
+
+   call_once(&shader_cache_once_flag, shader_cache_init);
+   return shader_cache;
+}
+
+
+/**
+ * Hash everything, apart from the source, that the result of compiling and
+ * linking a shader depends on.
+ */
+static void
+compute_context_sha1(struct gl_context *ctx, unsigned char sha1[20])
+{
+   static const char magic[] = "mesa glsl program cache";
+   const uint32_t version = SHADER_CACHE_VERSION;
+   struct mesa_sha1 *sha1_ctx = _mesa_sha1_init();
+   struct gl_constants consts = ctx->Const;
+
+   /* The NIR options are only used by drivers which can't be cached */
+   for (unsigned i = 0; i < MESA_SHADER_STAGES; i++)
+      consts.ShaderCompilerOptions[i].NirOptions = NULL;
+
+   _mesa_sha1_update(sha1_ctx, magic, sizeof(magic));
+   _mesa_sha1_update(sha1_ctx, &version, sizeof(version));
+   _mesa_sha1_update(sha1_ctx, &shader_cache_timestamp,
+                     sizeof(shader_cache_timestamp));
+   _mesa_sha1_update(sha1_ctx, &ctx->API, sizeof(ctx->API));
+   _mesa_sha1_update(sha1_ctx, &ctx->Version, sizeof(ctx->Version));
+   _mesa_sha1_update(sha1_ctx, &consts, sizeof(consts));
+   _mesa_sha1_update(sha1_ctx, &ctx->Extensions,
+                     offsetof(struct gl_extensions, String));
+
+   if (ctx->Driver.GetString) {
+      static const GLenum names[] = { GL_VENDOR, GL_RENDERER };
+
+      for (unsigned i = 0; i < ARRAY_SIZE(names); i++) {
+         const char *str = (const char *) ctx->Driver.GetString(ctx, names[i]);
+         if (str)
+            _mesa_sha1_update(sha1_ctx, str, strlen(str) + 1);
+      }
+   }
+
+   _mesa_sha1_final(sha1_ctx, sha1);
+}
+
+
+static bool
+sha1_is_set(const unsigned char sha1[20])
+{
+   for (unsigned i = 0; i < 20; i++) {
+      if (sha1[i])
+         return true;
+   }
+   return false;
+}
+
+
+extern "C" bool
+_mesa_shader_cache_skip_compile(struct gl_context *ctx, struct gl_shader *sh)
+{
+   struct disk_cache *cache = get_cache(ctx);
+   unsigned char ctx_sha1[20];
+   struct mesa_sha1 *sha1_ctx;
+
+   sh->CompileSkipped = false;
+   memset(sh->sha1, 0, sizeof(sh->sha1));
+
+   if (!cache)
+      return false;
+
+   compute_context_sha1(ctx, ctx_sha1);
+
+   sha1_ctx = _mesa_sha1_init();
+   _mesa_sha1_update(sha1_ctx, ctx_sha1, sizeof(ctx_sha1));
+   _mesa_sha1_update(sha1_ctx, &sh->Stage, sizeof(sh->Stage));
+   _mesa_sha1_update(sha1_ctx, sh->Source, strlen(sh->Source));
+   _mesa_sha1_final(sha1_ctx, sh->sha1);
+
+   /* The shader SHA-1 is only stored once a program using the shader has
+    * been linked successfully, so the shader is known to compile.
+    */
+   if (!disk_cache_has_key(cache, sh->sha1))
+      return false;
+
+   ralloc_free(sh->ir);
+   sh->ir = NULL;
+   sh->symbols = NULL;
+
+   ralloc_free(sh->InfoLog);
+   sh->InfoLog = ralloc_strdup(sh, "");
+
+   sh->CompileStatus = GL_TRUE;
+   sh->CompileSkipped = true;
+   return true;
+}
+
+
+extern "C" void
+_mesa_shader_cache_compile_skipped(struct gl_context *ctx,
+                                   struct gl_shader *sh)
+{
+   const GLchar *source = sh->Source;
+
+   assert(sh->CompileSkipped);
+
+   if (sh->FallbackSource)
+      sh->Source = sh->FallbackSource;
+
+   _mesa_glsl_compile_shader(ctx, sh, false, false);
+
+   sh->Source = source;
+   free((void *) sh->FallbackSource);
+   sh->FallbackSource = NULL;
+   sh->CompileSkipped = false;
+}
+
+
+struct binding {
+   const char *name;
+   unsigned value;
+};
+
+struct binding_list {
+   struct binding *entries;
+   unsigned count;
+};
+
+static void
+add_binding(const char *name, unsigned value, void *closure)
+{
+   struct binding_list *list = (struct binding_list *) closure;
+
+   list->entries = reralloc(list->entries, list->entries, struct binding,
+                            list->count + 1);
+   list->entries[list->count].name = name;
+   list->entries[list->count].value = value;
+   list->count++;
+}
+
+static int
+compare_bindings(const void *a, const void *b)
+{
+   return strcmp(((const struct binding *) a)->name,
+                 ((const struct binding *) b)->name);
+}
+
+/**
+ * Hash the contents of a binding map, which don't come in a stable order.
+ */
+static void
+hash_bindings(struct mesa_sha1 *sha1_ctx, struct string_to_uint_map *map)
+{
+   struct binding_list list = { NULL, 0 };
+
+   if (map)
+      map->iterate(add_binding, &list);
+
+   if (list.count)
+      qsort(list.entries, list.count, sizeof(struct binding), compare_bindings);
+
+   _mesa_sha1_update(sha1_ctx, &list.count, sizeof(list.count));
+   for (unsigned i = 0; i < list.count; i++) {
+      _mesa_sha1_update(sha1_ctx, list.entries[i].name,
+                        strlen(list.entries[i].name) + 1);
+      _mesa_sha1_update(sha1_ctx, &list.entries[i].value,
+                        sizeof(list.entries[i].value));
+   }
+
+   ralloc_free(list.entries);
+}
+
+
+/**
+ * Compute the key of a program from its shaders and the state set through
+ * the API before linking.
+ *
+ * \return  false if the program can't be cached.
+ */
+static bool
+compute_program_key(struct gl_shader_program *prog, cache_key key)
+{
+   struct mesa_sha1 *sha1_ctx;
+
+   if (prog->NumShaders == 0)
+      return false;
+
+   for (unsigned i = 0; i < prog->NumShaders; i++) {
+      if (!sha1_is_set(prog->Shaders[i]->sha1))
+         return false;
+   }
+
+   sha1_ctx = _mesa_sha1_init();
+
+   _mesa_sha1_update(sha1_ctx, &prog->SeparateShader,
+                     sizeof(prog->SeparateShader));
+   _mesa_sha1_update(sha1_ctx, &prog->NumShaders, sizeof(prog->NumShaders));
+   for (unsigned i = 0; i < prog->NumShaders; i++) {
+      _mesa_sha1_update(sha1_ctx, prog->Shaders[i]->sha1,
+                        sizeof(prog->Shaders[i]->sha1));
+   }
+
+   hash_bindings(sha1_ctx, prog->AttributeBindings);
+   hash_bindings(sha1_ctx, prog->FragDataBindings);
+   hash_bindings(sha1_ctx, prog->FragDataIndexBindings);
+
+   _mesa_sha1_update(sha1_ctx, &prog->TransformFeedback.BufferMode,
+                     sizeof(prog->TransformFeedback.BufferMode));
+   _mesa_sha1_update(sha1_ctx, &prog->TransformFeedback.NumVarying,
+                     sizeof(prog->TransformFeedback.NumVarying));
+   for (unsigned i = 0; i < prog->TransformFeedback.NumVarying; i++) {
+      const char *name = prog->TransformFeedback.VaryingNames[i];
+      _mesa_sha1_update(sha1_ctx, name, strlen(name) + 1);
+   }
+
+   _mesa_sha1_final(sha1_ctx, key);
+   return true;
+}
+
+
+static void
+write_nullable_string(struct blob *blob, const char *str)
+{
+   blob_write_uint32(blob, str != NULL);
+   if (str)
+      blob_write_string(blob, str);
+}
+
+static char *
+read_string(struct blob_reader *blob, void *mem_ctx)
+{
+   const char *str = blob_read_string(blob);
+   return ralloc_strdup(mem_ctx, str ? str : "");
+}
+
+static char *
+read_nullable_string(struct blob_reader *blob, void *mem_ctx)
+{
+   if (!blob_read_uint32(blob))
+      return NULL;
+   return read_string(blob, mem_ctx);
+}
+
+
+/**
+ * Number of gl_constant_value slots used by the storage of a uniform.
+ */
+static unsigned
+uniform_storage_slots(const struct gl_uniform_storage *uni)
+{
+   const unsigned elements = MAX2(1, uni->array_elements);
+
+   if (uni->type->is_sampler())
+      return elements;
+   return uni->type->component_slots() * elements;
+}
+
+static uint32_t
+encode_remap_entry(struct gl_shader_program *prog,
+                   struct gl_uniform_storage *entry)
+{
+   if (entry == NULL)
+      return REMAP_NULL;
+   if (entry == INACTIVE_UNIFORM_EXPLICIT_LOCATION)
+      return REMAP_INACTIVE;
+   return entry - prog->UniformStorage;
+}
+
+static bool
+decode_remap_entry(struct gl_shader_program *prog, uint32_t index,
+                   struct gl_uniform_storage **entry)
+{
+   if (index == REMAP_NULL)
+      *entry = NULL;
+   else if (index == REMAP_INACTIVE)
+      *entry = INACTIVE_UNIFORM_EXPLICIT_LOCATION;
+   else if (index < prog->NumUniformStorage)
+      *entry = &prog->UniformStorage[index];
+   else
+      return false;
+   return true;
+}
+
+static void
+write_uniform_hash_entry(const char *name, unsigned value, void *closure)
+{
+   struct blob *blob = (struct blob *) closure;
+
+   blob_write_string(blob, name);
+   blob_write_uint32(blob, value);
+}
+
+static void
+count_uniform_hash_entry(const char *name, unsigned value, void *closure)
+{
+   (*(unsigned *) closure)++;
+}
+
+static void
+write_uniforms(struct blob *blob, struct gl_shader_program *prog)
+{
+   union gl_constant_value *data = NULL;
+   union gl_constant_value *data_end = NULL;
+   unsigned num_hash_entries = 0;
+
+   /* All the storage was allocated as a single array by the linker */
+   for (unsigned i = 0; i < prog->NumUniformStorage; i++) {
+      struct gl_uniform_storage *uni = &prog->UniformStorage[i];
+      union gl_constant_value *end;
+
+      if (!uni->storage)
+         continue;
+
+      end = uni->storage + uniform_storage_slots(uni);
+      if (!data || uni->storage < data)
+         data = uni->storage;
+      if (end > data_end)
+         data_end = end;
+   }
+
+   blob_write_uint32(blob, prog->NumUniformStorage);
+   blob_write_uint32(blob, prog->NumHiddenUniforms);
+   blob_write_uint32(blob, data_end - data);
+
+   for (unsigned i = 0; i < prog->NumUniformStorage; i++) {
+      struct gl_uniform_storage *uni = &prog->UniformStorage[i];
+
+      encode_type_to_blob(blob, uni->type);
+      blob_write_string(blob, uni->name);
+      blob_write_uint32(blob, uni->array_elements);
+      blob_write_bytes(blob, uni->opaque, sizeof(uni->opaque));
+      blob_write_uint32(blob, uni->storage ? uni->storage - data : ~0u);
+      blob_write_uint32(blob, uni->block_index);
+      blob_write_uint32(blob, uni->offset);
+      blob_write_uint32(blob, uni->matrix_stride);
+      blob_write_uint32(blob, uni->array_stride);
+      blob_write_uint32(blob, uni->row_major |
+                              uni->hidden << 1 |
+                              uni->builtin << 2 |
+                              uni->is_shader_storage << 3);
+      blob_write_uint32(blob, uni->atomic_buffer_index);
+      blob_write_uint32(blob, uni->remap_location);
+      blob_write_uint32(blob, uni->num_compatible_subroutines);
+      blob_write_uint32(blob, uni->top_level_array_size);
+      blob_write_uint32(blob, uni->top_level_array_stride);
+   }
+
+   /* Contains the initializers and the default sampler units */
+   blob_write_bytes(blob, data, (data_end - data) * sizeof(*data));
+
+   blob_write_uint32(blob, prog->NumUniformRemapTable);
+   for (unsigned i = 0; i < prog->NumUniformRemapTable; i++) {
+      blob_write_uint32(blob, encode_remap_entry(prog,
+                                                 prog->UniformRemapTable[i]));
+   }
+
+   prog->UniformHash->iterate(count_uniform_hash_entry, &num_hash_entries);
+   blob_write_uint32(blob, num_hash_entries);
+   prog->UniformHash->iterate(write_uniform_hash_entry, blob);
+}
+
+static bool
+read_uniforms(struct blob_reader *blob, struct gl_shader_program *prog)
+{
+   struct gl_uniform_storage *uniforms;
+   union gl_constant_value *data;
+   unsigned num_uniforms, num_slots, num_hash_entries;
+
+   num_uniforms = blob_read_uint32(blob);
+   prog->NumHiddenUniforms = blob_read_uint32(blob);
+   num_slots = blob_read_uint32(blob);
+   if (blob->overrun)
+      return false;
+
+   uniforms = rzalloc_array(prog, struct gl_uniform_storage, num_uniforms);
+   data = rzalloc_array(uniforms, union gl_constant_value, num_slots);
+   prog->UniformStorage = uniforms;
+   prog->NumUniformStorage = num_uniforms;
+
+   for (unsigned i = 0; i < num_uniforms; i++) {
+      struct gl_uniform_storage *uni = &uniforms[i];
+      uint32_t offset, flags;
+
+      uni->type = decode_type_from_blob(blob);
+      uni->name = read_string(blob, uniforms);
+      uni->array_elements = blob_read_uint32(blob);
+      blob_copy_bytes(blob, (uint8_t *) uni->opaque, sizeof(uni->opaque));
+      offset = blob_read_uint32(blob);
+      uni->block_index = blob_read_uint32(blob);
+      uni->offset = blob_read_uint32(blob);
+      uni->matrix_stride = blob_read_uint32(blob);
+      uni->array_stride = blob_read_uint32(blob);
+      flags = blob_read_uint32(blob);
+      uni->row_major = flags & 1;
+      uni->hidden = (flags >> 1) & 1;
+      uni->builtin = (flags >> 2) & 1;
+      uni->is_shader_storage = (flags >> 3) & 1;
+      uni->atomic_buffer_index = blob_read_uint32(blob);
+      uni->remap_location = blob_read_uint32(blob);
+      uni->num_compatible_subroutines = blob_read_uint32(blob);
+      uni->top_level_array_size = blob_read_uint32(blob);
+      uni->top_level_array_stride = blob_read_uint32(blob);
+
+      if (blob->overrun || uni->type == NULL)
+         return false;
+
+      if (offset != ~0u) {
+         if (offset + uniform_storage_slots(uni) > num_slots)
+            return false;
+         uni->storage = &data[offset];
+      }
+   }
+
+   blob_copy_bytes(blob, (uint8_t *) data, num_slots * sizeof(*data));
+
+   prog->NumUniformRemapTable = blob_read_uint32(blob);
+   if (blob->overrun)
+      return false;
+
+   prog->UniformRemapTable = rzalloc_array(prog, struct gl_uniform_storage *,
+                                           prog->NumUniformRemapTable);
+   for (unsigned i = 0; i < prog->NumUniformRemapTable; i++) {
+      if (!decode_remap_entry(prog, blob_read_uint32(blob),
+                              &prog->UniformRemapTable[i]))
+         return false;
+   }
+
+   prog->UniformHash = new string_to_uint_map;
+   num_hash_entries = blob_read_uint32(blob);
+   for (unsigned i = 0; i < num_hash_entries && !blob->overrun; i++) {
+      const char *name = blob_read_string(blob);
+      unsigned value = blob_read_uint32(blob);
+
+      if (name == NULL || value >= num_uniforms)
+         return false;
+      prog->UniformHash->put(value, name);
+   }
+
+   return !blob->overrun;
+}
+
+
+static void
+write_blocks(struct blob *blob, const struct gl_uniform_block *blocks,
+             unsigned num_blocks)
+{
+   blob_write_uint32(blob, num_blocks);
+
+   for (unsigned i = 0; i < num_blocks; i++) {
+      const struct gl_uniform_block *b = &blocks[i];
+
+      blob_write_string(blob, b->Name);
+      blob_write_uint32(blob, b->Binding);
+      blob_write_uint32(blob, b->UniformBufferSize);
+      blob_write_uint32(blob, b->stageref);
+      blob_write_uint32(blob, b->_Packing);
+
+      blob_write_uint32(blob, b->NumUniforms);
+      for (unsigned j = 0; j < b->NumUniforms; j++) {
+         const struct gl_uniform_buffer_variable *var = &b->Uniforms[j];
+
+         blob_write_string(blob, var->Name);
+         if (var->IndexName == var->Name)
+            write_nullable_string(blob, NULL);
+         else
+            write_nullable_string(blob, var->IndexName);
+         encode_type_to_blob(blob, var->Type);
+         blob_write_uint32(blob, var->Offset);
+         blob_write_uint32(blob, var->RowMajor);
+      }
+   }
+}
+
+static bool
+read_blocks(struct blob_reader *blob, struct gl_shader_program *prog,
+            struct gl_uniform_block **blocks_out, unsigned *num_blocks_out)
+{
+   const unsigned num_blocks = blob_read_uint32(blob);
+   struct gl_uniform_block *blocks;
+
+   if (blob->overrun)
+      return false;
+
+   blocks = rzalloc_array(prog, struct gl_uniform_block, num_blocks);
+   *blocks_out = blocks;
+   *num_blocks_out = num_blocks;
+
+   for (unsigned i = 0; i < num_blocks; i++) {
+      struct gl_uniform_block *b = &blocks[i];
+
+      b->Name = read_string(blob, blocks);
+      b->Binding = blob_read_uint32(blob);
+      b->UniformBufferSize = blob_read_uint32(blob);
+      b->stageref = blob_read_uint32(blob);
+      b->_Packing = (enum gl_uniform_block_packing) blob_read_uint32(blob);
+
+      b->NumUniforms = blob_read_uint32(blob);
+      if (blob->overrun)
+         return false;
+
+      b->Uniforms = rzalloc_array(blocks, struct gl_uniform_buffer_variable,
+                                  b->NumUniforms);
+      for (unsigned j = 0; j < b->NumUniforms; j++) {
+         struct gl_uniform_buffer_variable *var = &b->Uniforms[j];
+
+         var->Name = read_string(blob, blocks);
+         var->IndexName = read_nullable_string(blob, blocks);
+         if (var->IndexName == NULL)
+            var->IndexName = var->Name;
+         var->Type = decode_type_from_blob(blob);
+         var->Offset = blob_read_uint32(blob);
+         var->RowMajor = blob_read_uint32(blob);
+
+         if (var->Type == NULL)
+            return false;
+      }
+   }
+
+   return !blob->overrun;
+}
+
+
+static void
+write_atomic_buffers(struct blob *blob, struct gl_shader_program *prog)
+{
+   blob_write_uint32(blob, prog->NumAtomicBuffers);
+
+   for (unsigned i = 0; i < prog->NumAtomicBuffers; i++) {
+      const struct gl_active_atomic_buffer *ab = &prog->AtomicBuffers[i];
+
+      blob_write_uint32(blob, ab->Binding);
+      blob_write_uint32(blob, ab->MinimumSize);
+      blob_write_bytes(blob, ab->StageReferences, sizeof(ab->StageReferences));
+      blob_write_uint32(blob, ab->NumUniforms);
+      blob_write_bytes(blob, ab->Uniforms,
+                       ab->NumUniforms * sizeof(ab->Uniforms[0]));
+   }
+}
+
+static bool
+read_atomic_buffers(struct blob_reader *blob, struct gl_shader_program *prog)
+{
+   prog->NumAtomicBuffers = blob_read_uint32(blob);
+   if (blob->overrun)
+      return false;
+
+   prog->AtomicBuffers = rzalloc_array(prog, struct gl_active_atomic_buffer,
+                                       prog->NumAtomicBuffers);
+
+   for (unsigned i = 0; i < prog->NumAtomicBuffers; i++) {
+      struct gl_active_atomic_buffer *ab = &prog->AtomicBuffers[i];
+
+      ab->Binding = blob_read_uint32(blob);
+      ab->MinimumSize = blob_read_uint32(blob);
+      blob_copy_bytes(blob, (uint8_t *) ab->StageReferences,
+                      sizeof(ab->StageReferences));
+      ab->NumUniforms = blob_read_uint32(blob);
+      if (blob->overrun)
+         return false;
+
+      ab->Uniforms = rzalloc_array(prog->AtomicBuffers, GLuint,
+                                   ab->NumUniforms);
+      blob_copy_bytes(blob, (uint8_t *) ab->Uniforms,
+                      ab->NumUniforms * sizeof(ab->Uniforms[0]));
+   }
+
+   return !blob->overrun;
+}
+
+
+static void
+write_xfb(struct blob *blob, struct gl_shader_program *prog)
+{
+   const struct gl_transform_feedback_info *xfb =
+      &prog->LinkedTransformFeedback;
+
+   blob_write_uint32(blob, xfb->NumOutputs);
+   blob_write_uint32(blob, xfb->ActiveBuffers);
+   blob_write_bytes(blob, xfb->Outputs,
+                    xfb->NumOutputs * sizeof(xfb->Outputs[0]));
+
+   blob_write_uint32(blob, xfb->NumVarying);
+   for (int i = 0; i < xfb->NumVarying; i++) {
+      const struct gl_transform_feedback_varying_info *var = &xfb->Varyings[i];
+
+      blob_write_string(blob, var->Name);
+      blob_write_uint32(blob, var->Type);
+      blob_write_uint32(blob, var->BufferIndex);
+      blob_write_uint32(blob, var->Size);
+      blob_write_uint32(blob, var->Offset);
+   }
+
+   blob_write_bytes(blob, xfb->Buffers, sizeof(xfb->Buffers));
+}
+
+static bool
+read_xfb(struct blob_reader *blob, struct gl_shader_program *prog)
+{
+   struct gl_transform_feedback_info *xfb = &prog->LinkedTransformFeedback;
+
+   xfb->NumOutputs = blob_read_uint32(blob);
+   xfb->ActiveBuffers = blob_read_uint32(blob);
+   if (blob->overrun)
+      return false;
+
+   xfb->Outputs = rzalloc_array(prog, struct gl_transform_feedback_output,
+                                xfb->NumOutputs);
+   blob_copy_bytes(blob, (uint8_t *) xfb->Outputs,
+                   xfb->NumOutputs * sizeof(xfb->Outputs[0]));
+
+   xfb->NumVarying = blob_read_uint32(blob);
+   if (blob->overrun || xfb->NumVarying < 0)
+      return false;
+
+   xfb->Varyings = rzalloc_array(prog, struct gl_transform_feedback_varying_info,
+                                 xfb->NumVarying);
+   for (int i = 0; i < xfb->NumVarying; i++) {
+      struct gl_transform_feedback_varying_info *var = &xfb->Varyings[i];
+
+      var->Name = read_string(blob, xfb->Varyings);
+      var->Type = blob_read_uint32(blob);
+      var->BufferIndex = blob_read_uint32(blob);
+      var->Size = blob_read_uint32(blob);
+      var->Offset = blob_read_uint32(blob);
+   }
+
+   blob_copy_bytes(blob, (uint8_t *) xfb->Buffers, sizeof(xfb->Buffers));
+
+   return !blob->overrun;
+}
+
+
+static void
+write_block_list(struct blob *blob, struct gl_uniform_block **list,
+                 unsigned count, const struct gl_uniform_block *blocks)
+{
+   blob_write_uint32(blob, count);
+   for (unsigned i = 0; i < count; i++)
+      blob_write_uint32(blob, list[i] - blocks);
+}
+
+static bool
+read_block_list(struct blob_reader *blob, void *mem_ctx,
+                struct gl_uniform_block ***list, unsigned *count,
+                struct gl_uniform_block *blocks, unsigned num_blocks)
+{
+   *count = blob_read_uint32(blob);
+   if (blob->overrun)
+      return false;
+
+   *list = ralloc_array(mem_ctx, struct gl_uniform_block *, *count);
+   for (unsigned i = 0; i < *count; i++) {
+      const unsigned index = blob_read_uint32(blob);
+
+      if (index >= num_blocks)
+         return false;
+      (*list)[i] = &blocks[index];
+   }
+
+   return true;
+}
+
+static void
+write_linked_shader(struct blob *blob, struct gl_shader_program *prog,
+                    struct gl_linked_shader *sh)
+{
+   blob_write_uint32(blob, sh->num_samplers);
+   blob_write_uint32(blob, sh->active_samplers);
+   blob_write_uint32(blob, sh->shadow_samplers);
+   blob_write_bytes(blob, sh->SamplerUnits, sizeof(sh->SamplerUnits));
+   blob_write_bytes(blob, sh->SamplerTargets, sizeof(sh->SamplerTargets));
+   blob_write_uint32(blob, sh->num_uniform_components);
+   blob_write_uint32(blob, sh->num_combined_uniform_components);
+
+   write_block_list(blob, sh->UniformBlocks, sh->NumUniformBlocks,
+                    prog->UniformBlocks);
+   write_block_list(blob, sh->ShaderStorageBlocks, sh->NumShaderStorageBlocks,
+                    prog->ShaderStorageBlocks);
+
+   blob_write_bytes(blob, sh->ImageUnits, sizeof(sh->ImageUnits));
+   blob_write_bytes(blob, sh->ImageAccess, sizeof(sh->ImageAccess));
+   blob_write_uint32(blob, sh->NumImages);
+
+   blob_write_uint32(blob, sh->NumAtomicBuffers);
+   for (unsigned i = 0; i < sh->NumAtomicBuffers; i++)
+      blob_write_uint32(blob, sh->AtomicBuffers[i] - prog->AtomicBuffers);
+
+   blob_write_uint32(blob, sh->NumSubroutineUniformTypes);
+   blob_write_uint32(blob, sh->NumSubroutineUniforms);
+   blob_write_uint32(blob, sh->NumSubroutineUniformRemapTable);
+   for (unsigned i = 0; i < sh->NumSubroutineUniformRemapTable; i++) {
+      blob_write_uint32(blob,
+                        encode_remap_entry(prog,
+                                           sh->SubroutineUniformRemapTable[i]));
+   }
+
+   blob_write_uint32(blob, sh->NumSubroutineFunctions);
+   blob_write_uint32(blob, sh->MaxSubroutineFunctionIndex);
+   for (unsigned i = 0; i < sh->NumSubroutineFunctions; i++) {
+      const struct gl_subroutine_function *func = &sh->SubroutineFunctions[i];
+
+      blob_write_string(blob, func->name);
+      blob_write_uint32(blob, func->index);
+      blob_write_uint32(blob, func->num_compat_types);
+      for (int j = 0; j < func->num_compat_types; j++)
+         encode_type_to_blob(blob, func->types[j]);
+   }
+
+   blob_write_bytes(blob, &sh->info, sizeof(sh->info));
+}
+
+static bool
+read_linked_shader(struct blob_reader *blob, struct gl_shader_program *prog,
+                   struct gl_linked_shader *sh)
+{
+   sh->num_samplers = blob_read_uint32(blob);
+   sh->active_samplers = blob_read_uint32(blob);
+   sh->shadow_samplers = blob_read_uint32(blob);
+   blob_copy_bytes(blob, (uint8_t *) sh->SamplerUnits,
+                   sizeof(sh->SamplerUnits));
+   blob_copy_bytes(blob, (uint8_t *) sh->SamplerTargets,
+                   sizeof(sh->SamplerTargets));
+   sh->num_uniform_components = blob_read_uint32(blob);
+   sh->num_combined_uniform_components = blob_read_uint32(blob);
+
+   if (!read_block_list(blob, sh, &sh->UniformBlocks, &sh->NumUniformBlocks,
+                        prog->UniformBlocks, prog->NumUniformBlocks) ||
+       !read_block_list(blob, sh, &sh->ShaderStorageBlocks,
+                        &sh->NumShaderStorageBlocks,
+                        prog->ShaderStorageBlocks,
+                        prog->NumShaderStorageBlocks))
+      return false;
+
+   blob_copy_bytes(blob, (uint8_t *) sh->ImageUnits, sizeof(sh->ImageUnits));
+   blob_copy_bytes(blob, (uint8_t *) sh->ImageAccess, sizeof(sh->ImageAccess));
+   sh->NumImages = blob_read_uint32(blob);
+
+   sh->NumAtomicBuffers = blob_read_uint32(blob);
+   if (blob->overrun)
+      return false;
+
+   sh->AtomicBuffers = ralloc_array(sh, struct gl_active_atomic_buffer *,
+                                    sh->NumAtomicBuffers);
+   for (unsigned i = 0; i < sh->NumAtomicBuffers; i++) {
+      const unsigned index = blob_read_uint32(blob);
+
+      if (index >= prog->NumAtomicBuffers)
+         return false;
+      sh->AtomicBuffers[i] = &prog->AtomicBuffers[index];
+   }
+
+   sh->NumSubroutineUniformTypes = blob_read_uint32(blob);
+   sh->NumSubroutineUniforms = blob_read_uint32(blob);
+   sh->NumSubroutineUniformRemapTable = blob_read_uint32(blob);
+   if (blob->overrun)
+      return false;
+
+   sh->SubroutineUniformRemapTable =
+      ralloc_array(sh, struct gl_uniform_storage *,
+                   sh->NumSubroutineUniformRemapTable);
+   for (unsigned i = 0; i < sh->NumSubroutineUniformRemapTable; i++) {
+      if (!decode_remap_entry(prog, blob_read_uint32(blob),
+                              &sh->SubroutineUniformRemapTable[i]))
+         return false;
+   }
+
+   sh->NumSubroutineFunctions = blob_read_uint32(blob);
+   sh->MaxSubroutineFunctionIndex = blob_read_uint32(blob);
+   if (blob->overrun)
+      return false;
+
+   sh->SubroutineFunctions = rzalloc_array(sh, struct gl_subroutine_function,
+                                           sh->NumSubroutineFunctions);
+   for (unsigned i = 0; i < sh->NumSubroutineFunctions; i++) {
+      struct gl_subroutine_function *func = &sh->SubroutineFunctions[i];
+
+      func->name = read_string(blob, sh);
+      func->index = blob_read_uint32(blob);
+      func->num_compat_types = blob_read_uint32(blob);
+      if (blob->overrun || func->num_compat_types < 0)
+         return false;
+
+      func->types = ralloc_array(sh, const struct glsl_type *,
+                                 func->num_compat_types);
+      for (int j = 0; j < func->num_compat_types; j++) {
+         func->types[j] = decode_type_from_blob(blob);
+         if (func->types[j] == NULL)
+            return false;
+      }
+   }
+
+   blob_copy_bytes(blob, (uint8_t *) &sh->info, sizeof(sh->info));
+
+   return !blob->overrun;
+}
+
+
+/**
+ * Size of the structure derived from gl_program for \p target.  The
+ * derived fields are plain values, and are copied as a whole.
+ */
+static size_t
+program_struct_size(GLenum target)
+{
+   switch (target) {
+   case GL_VERTEX_PROGRAM_ARB:
+      return sizeof(struct gl_vertex_program);
+   case GL_TESS_CONTROL_PROGRAM_NV:
+      return sizeof(struct gl_tess_ctrl_program);
+   case GL_TESS_EVALUATION_PROGRAM_NV:
+      return sizeof(struct gl_tess_eval_program);
+   case GL_GEOMETRY_PROGRAM_NV:
+      return sizeof(struct gl_geometry_program);
+   case GL_FRAGMENT_PROGRAM_ARB:
+      return sizeof(struct gl_fragment_program);
+   case GL_COMPUTE_PROGRAM_NV:
+      return sizeof(struct gl_compute_program);
+   default:
+      unreachable("Unexpected program target");
+   }
+}
+
+/* The instruction counts are consecutive fields of gl_program */
+#define PROGRAM_COUNTS_OFFSET offsetof(struct gl_program, NumInstructions)
+#define PROGRAM_COUNTS_SIZE \
+   (offsetof(struct gl_program, NumNativeTexIndirections) + sizeof(GLuint) - \
+    PROGRAM_COUNTS_OFFSET)
+
+static void
+write_program(struct blob *blob, struct gl_program *glprog)
+{
+   const struct gl_program_parameter_list *params = glprog->Parameters;
+   const size_t size = program_struct_size(glprog->Target);
+
+   blob_write_uint64(blob, glprog->InputsRead);
+   blob_write_uint64(blob, glprog->DoubleInputsRead);
+   blob_write_uint64(blob, glprog->OutputsWritten);
+   blob_write_uint32(blob, glprog->PatchInputsRead);
+   blob_write_uint32(blob, glprog->PatchOutputsWritten);
+   blob_write_uint32(blob, glprog->SystemValuesRead);
+   blob_write_bytes(blob, glprog->TexturesUsed, sizeof(glprog->TexturesUsed));
+   blob_write_uint32(blob, glprog->SamplersUsed);
+   blob_write_uint32(blob, glprog->ShadowSamplers);
+   blob_write_uint32(blob, glprog->UsesGather);
+   blob_write_uint32(blob, glprog->ClipDistanceArraySize);
+   blob_write_uint32(blob, glprog->CullDistanceArraySize);
+   blob_write_bytes(blob, glprog->SamplerUnits, sizeof(glprog->SamplerUnits));
+   blob_write_uint32(blob, glprog->IndirectRegisterFiles);
+   blob_write_bytes(blob, (const uint8_t *) glprog + PROGRAM_COUNTS_OFFSET,
+                    PROGRAM_COUNTS_SIZE);
+
+   blob_write_bytes(blob, (const uint8_t *) glprog + sizeof(struct gl_program),
+                    size - sizeof(struct gl_program));
+
+   blob_write_uint32(blob, params->NumParameters);
+   blob_write_uint32(blob, params->StateFlags);
+   for (unsigned i = 0; i < params->NumParameters; i++) {
+      const struct gl_program_parameter *p = &params->Parameters[i];
+
+      write_nullable_string(blob, p->Name);
+      blob_write_uint32(blob, p->Type);
+      blob_write_uint32(blob, p->DataType);
+      blob_write_uint32(blob, p->Size);
+      blob_write_uint32(blob, p->Initialized);
+      blob_write_bytes(blob, p->StateIndexes, sizeof(p->StateIndexes));
+   }
+   blob_write_bytes(blob, params->ParameterValues,
+                    params->NumParameters * sizeof(params->ParameterValues[0]));
+}
+
+static bool
+read_program(struct blob_reader *blob, struct gl_program *glprog)
+{
+   struct gl_program_parameter_list *params;
+   const size_t size = program_struct_size(glprog->Target);
+   unsigned num_params;
+
+   glprog->InputsRead = blob_read_uint64(blob);
+   glprog->DoubleInputsRead = blob_read_uint64(blob);
+   glprog->OutputsWritten = blob_read_uint64(blob);
+   glprog->PatchInputsRead = blob_read_uint32(blob);
+   glprog->PatchOutputsWritten = blob_read_uint32(blob);
+   glprog->SystemValuesRead = blob_read_uint32(blob);
+   blob_copy_bytes(blob, (uint8_t *) glprog->TexturesUsed,
+                   sizeof(glprog->TexturesUsed));
+   glprog->SamplersUsed = blob_read_uint32(blob);
+   glprog->ShadowSamplers = blob_read_uint32(blob);
+   glprog->UsesGather = blob_read_uint32(blob);
+   glprog->ClipDistanceArraySize = blob_read_uint32(blob);
+   glprog->CullDistanceArraySize = blob_read_uint32(blob);
+   blob_copy_bytes(blob, (uint8_t *) glprog->SamplerUnits,
+                   sizeof(glprog->SamplerUnits));
+   glprog->IndirectRegisterFiles = blob_read_uint32(blob);
+   blob_copy_bytes(blob, (uint8_t *) glprog + PROGRAM_COUNTS_OFFSET,
+                   PROGRAM_COUNTS_SIZE);
+
+   blob_copy_bytes(blob, (uint8_t *) glprog + sizeof(struct gl_program),
+                   size - sizeof(struct gl_program));
+
+   num_params = blob_read_uint32(blob);
+   if (blob->overrun)
+      return false;
+
+   /* Leave room for the state references added for bitmap and drawpixels,
+    * as the linker does.
+    */
+   params = _mesa_new_parameter_list_sized(num_params + 8);
+   if (!params)
+      return false;
+   glprog->Parameters = params;
+
+   params->StateFlags = blob_read_uint32(blob);
+   for (unsigned i = 0; i < num_params; i++) {
+      struct gl_program_parameter *p = &params->Parameters[i];
+
+      if (blob_read_uint32(blob)) {
+         const char *name = blob_read_string(blob);
+         p->Name = strdup(name ? name : "");
+      }
+      p->Type = (gl_register_file) blob_read_uint32(blob);
+      p->DataType = blob_read_uint32(blob);
+      p->Size = blob_read_uint32(blob);
+      p->Initialized = blob_read_uint32(blob);
+      blob_copy_bytes(blob, (uint8_t *) p->StateIndexes,
+                      sizeof(p->StateIndexes));
+      params->NumParameters++;
+   }
+   blob_copy_bytes(blob, (uint8_t *) params->ParameterValues,
+                   num_params * sizeof(params->ParameterValues[0]));
+
+   return !blob->overrun;
+}
+
+
+static void
+write_shader_variable(struct blob *blob, const struct gl_shader_variable *var)
+{
+   encode_type_to_blob(blob, var->type);
+   encode_type_to_blob(blob, var->interface_type);
+   encode_type_to_blob(blob, var->outermost_struct_type);
+   blob_write_string(blob, var->name);
+   blob_write_uint32(blob, var->location);
+   blob_write_uint32(blob, var->component |
+                           var->index << 2 |
+                           var->patch << 3 |
+                           var->mode << 4 |
+                           var->interpolation << 8 |
+                           var->explicit_location << 10 |
+                           var->precision << 11);
+}
+
+static struct gl_shader_variable *
+read_shader_variable(struct blob_reader *blob, void *mem_ctx)
+{
+   struct gl_shader_variable *var = rzalloc(mem_ctx, struct gl_shader_variable);
+   uint32_t bits;
+
+   var->type = decode_type_from_blob(blob);
+   var->interface_type = decode_type_from_blob(blob);
+   var->outermost_struct_type = decode_type_from_blob(blob);
+   var->name = read_string(blob, var);
+   var->location = blob_read_uint32(blob);
+
+   bits = blob_read_uint32(blob);
+   var->component = bits & 0x3;
+   var->index = (bits >> 2) & 1;
+   var->patch = (bits >> 3) & 1;
+   var->mode = (bits >> 4) & 0xf;
+   var->interpolation = (bits >> 8) & 0x3;
+   var->explicit_location = (bits >> 10) & 1;
+   var->precision = (bits >> 11) & 0x3;
+
+   return var->type ? var : NULL;
+}
+
+static bool
+write_resource_list(struct blob *blob, struct gl_shader_program *prog)
+{
+   blob_write_uint32(blob, prog->NumProgramResourceList);
+
+   for (unsigned i = 0; i < prog->NumProgramResourceList; i++) {
+      const struct gl_program_resource *res = &prog->ProgramResourceList[i];
+      const void *data = res->Data;
+      uint32_t index;
+
+      blob_write_uint32(blob, res->Type);
+      blob_write_uint32(blob, res->StageReferences);
+
+      switch (res->Type) {
+      case GL_UNIFORM:
+      case GL_BUFFER_VARIABLE:
+      case GL_VERTEX_SUBROUTINE_UNIFORM:
+      case GL_TESS_CONTROL_SUBROUTINE_UNIFORM:
+      case GL_TESS_EVALUATION_SUBROUTINE_UNIFORM:
+      case GL_GEOMETRY_SUBROUTINE_UNIFORM:
+      case GL_FRAGMENT_SUBROUTINE_UNIFORM:
+      case GL_COMPUTE_SUBROUTINE_UNIFORM:
+         index = (const struct gl_uniform_storage *) data - prog->UniformStorage;
+         break;
+      case GL_UNIFORM_BLOCK:
+         index = (const struct gl_uniform_block *) data - prog->UniformBlocks;
+         break;
+      case GL_SHADER_STORAGE_BLOCK:
+         index = (const struct gl_uniform_block *) data -
+                 prog->ShaderStorageBlocks;
+         break;
+      case GL_ATOMIC_COUNTER_BUFFER:
+         index = (const struct gl_active_atomic_buffer *) data -
+                 prog->AtomicBuffers;
+         break;
+      case GL_TRANSFORM_FEEDBACK_VARYING:
+         index = (const struct gl_transform_feedback_varying_info *) data -
+                 prog->LinkedTransformFeedback.Varyings;
+         break;
+      case GL_TRANSFORM_FEEDBACK_BUFFER:
+         index = (const struct gl_transform_feedback_buffer *) data -
+                 prog->LinkedTransformFeedback.Buffers;
+         break;
+      case GL_VERTEX_SUBROUTINE:
+      case GL_TESS_CONTROL_SUBROUTINE:
+      case GL_TESS_EVALUATION_SUBROUTINE:
+      case GL_GEOMETRY_SUBROUTINE:
+      case GL_FRAGMENT_SUBROUTINE:
+      case GL_COMPUTE_SUBROUTINE: {
+         const gl_shader_stage stage =
+            _mesa_shader_stage_from_subroutine(res->Type);
+         index = (const struct gl_subroutine_function *) data -
+                 prog->_LinkedShaders[stage]->SubroutineFunctions;
+         break;
+      }
+      case GL_PROGRAM_INPUT:
+      case GL_PROGRAM_OUTPUT:
+         write_shader_variable(blob,
+                               (const struct gl_shader_variable *) data);
+         continue;
+      default:
+         return false;
+      }
+
+      blob_write_uint32(blob, index);
+   }
+
+   return true;
+}
+
+static bool
+read_resource_list(struct blob_reader *blob, struct gl_shader_program *prog)
+{
+   struct gl_program_resource *list;
+   unsigned num_resources = blob_read_uint32(blob);
+
+   if (blob->overrun)
+      return false;
+
+   list = rzalloc_array(prog, struct gl_program_resource, num_resources);
+   prog->ProgramResourceList = list;
+   prog->NumProgramResourceList = num_resources;
+
+   for (unsigned i = 0; i < num_resources; i++) {
+      struct gl_program_resource *res = &list[i];
+      unsigned index, count;
+      const void *base;
+      size_t elem_size;
+
+      res->Type = blob_read_uint32(blob);
+      res->StageReferences = blob_read_uint32(blob);
+
+      switch (res->Type) {
+      case GL_UNIFORM:
+      case GL_BUFFER_VARIABLE:
+      case GL_VERTEX_SUBROUTINE_UNIFORM:
+      case GL_TESS_CONTROL_SUBROUTINE_UNIFORM:
+      case GL_TESS_EVALUATION_SUBROUTINE_UNIFORM:
+      case GL_GEOMETRY_SUBROUTINE_UNIFORM:
+      case GL_FRAGMENT_SUBROUTINE_UNIFORM:
+      case GL_COMPUTE_SUBROUTINE_UNIFORM:
+         base = prog->UniformStorage;
+         count = prog->NumUniformStorage;
+         elem_size = sizeof(prog->UniformStorage[0]);
+         break;
+      case GL_UNIFORM_BLOCK:
+         base = prog->UniformBlocks;
+         count = prog->NumUniformBlocks;
+         elem_size = sizeof(prog->UniformBlocks[0]);
+         break;
+      case GL_SHADER_STORAGE_BLOCK:
+         base = prog->ShaderStorageBlocks;
+         count = prog->NumShaderStorageBlocks;
+         elem_size = sizeof(prog->ShaderStorageBlocks[0]);
+         break;
+      case GL_ATOMIC_COUNTER_BUFFER:
+         base = prog->AtomicBuffers;
+         count = prog->NumAtomicBuffers;
+         elem_size = sizeof(prog->AtomicBuffers[0]);
+         break;
+      case GL_TRANSFORM_FEEDBACK_VARYING:
+         base = prog->LinkedTransformFeedback.Varyings;
+         count = prog->LinkedTransformFeedback.NumVarying;
+         elem_size = sizeof(prog->LinkedTransformFeedback.Varyings[0]);
+         break;
+      case GL_TRANSFORM_FEEDBACK_BUFFER:
+         base = prog->LinkedTransformFeedback.Buffers;
+         count = ARRAY_SIZE(prog->LinkedTransformFeedback.Buffers);
+         elem_size = sizeof(prog->LinkedTransformFeedback.Buffers[0]);
+         break;
+      case GL_VERTEX_SUBROUTINE:
+      case GL_TESS_CONTROL_SUBROUTINE:
+      case GL_TESS_EVALUATION_SUBROUTINE:
+      case GL_GEOMETRY_SUBROUTINE:
+      case GL_FRAGMENT_SUBROUTINE:
+      case GL_COMPUTE_SUBROUTINE: {
+         struct gl_linked_shader *sh =
+            prog->_LinkedShaders[_mesa_shader_stage_from_subroutine(res->Type)];
+         if (!sh)
+            return false;
+         base = sh->SubroutineFunctions;
+         count = sh->NumSubroutineFunctions;
+         elem_size = sizeof(sh->SubroutineFunctions[0]);
+         break;
+      }
+      case GL_PROGRAM_INPUT:
+      case GL_PROGRAM_OUTPUT:
+         res->Data = read_shader_variable(blob, list);
+         if (!res->Data)
+            return false;
+         continue;
+      default:
+         return false;
+      }
+
+      index = blob_read_uint32(blob);
+      if (blob->overrun || index >= count)
+         return false;
+      res->Data = (const uint8_t *) base + index * elem_size;
+   }
+
+   return !blob->overrun;
+}
+
+
+/**
+ * Drop the linked state that _mesa_clear_shader_program_data() leaves
+ * behind, as the linker would before replacing it.
+ */
+static void
+clear_linked_state(struct gl_context *ctx, struct gl_shader_program *prog)
+{
+   for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
+      if (prog->_LinkedShaders[i]) {
+         _mesa_delete_linked_shader(ctx, prog->_LinkedShaders[i]);
+         prog->_LinkedShaders[i] = NULL;
+      }
+   }
+
+   ralloc_free(prog->LinkedTransformFeedback.Varyings);
+   ralloc_free(prog->LinkedTransformFeedback.Outputs);
+   memset(&prog->LinkedTransformFeedback, 0,
+          sizeof(prog->LinkedTransformFeedback));
+}
+
+static bool
+write_program_metadata(struct gl_context *ctx, struct blob *blob,
+                       struct gl_shader_program *prog, const cache_key key)
+{
+   uint32_t stages = 0;
+
+   blob_write_bytes(blob, key, CACHE_KEY_SIZE);
+   blob_write_string(blob, prog->InfoLog);
+
+   blob_write_uint32(blob, prog->Version);
+   blob_write_uint32(blob, prog->IsES);
+   blob_write_uint32(blob, prog->ARB_fragment_coord_conventions_enable);
+   blob_write_uint32(blob, prog->FragDepthLayout);
+   blob_write_bytes(blob, &prog->TessEval, sizeof(prog->TessEval));
+   blob_write_bytes(blob, &prog->Geom, sizeof(prog->Geom));
+   blob_write_bytes(blob, &prog->Vert, sizeof(prog->Vert));
+   blob_write_bytes(blob, &prog->Comp, sizeof(prog->Comp));
+   blob_write_bytes(blob, prog->TransformFeedback.BufferStride,
+                    sizeof(prog->TransformFeedback.BufferStride));
+   blob_write_uint32(blob, prog->LastClipDistanceArraySize);
+   blob_write_uint32(blob, prog->LastCullDistanceArraySize);
+
+   write_uniforms(blob, prog);
+   write_blocks(blob, prog->UniformBlocks, prog->NumUniformBlocks);
+   write_blocks(blob, prog->ShaderStorageBlocks, prog->NumShaderStorageBlocks);
+   write_atomic_buffers(blob, prog);
+   write_xfb(blob, prog);
+
+   for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
+      if (prog->_LinkedShaders[i])
+         stages |= 1 << i;
+   }
+   blob_write_uint32(blob, stages);
+
+   for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
+      struct gl_linked_shader *sh = prog->_LinkedShaders[i];
+
+      if (!sh)
+         continue;
+
+      if (!sh->Program)
+         return false;
+
+      write_linked_shader(blob, prog, sh);
+      write_program(blob, sh->Program);
+
+      if (!ctx->Driver.ShaderCacheSerialize(ctx, sh->Program, blob))
+         return false;
+   }
+
+   return write_resource_list(blob, prog);
+}
+
+static bool
+read_program_metadata(struct gl_context *ctx, struct blob_reader *blob,
+                      struct gl_shader_program *prog, const cache_key key)
+{
+   uint8_t entry_key[CACHE_KEY_SIZE];
+   uint32_t stages;
+
+   /* Catch SHA-1 collisions on the file name */
+   blob_copy_bytes(blob, entry_key, CACHE_KEY_SIZE);
+   if (blob->overrun || memcmp(entry_key, key, CACHE_KEY_SIZE) != 0)
+      return false;
+
+   ralloc_free(prog->InfoLog);
+   prog->InfoLog = read_string(blob, prog);
+
+   prog->Version = blob_read_uint32(blob);
+   prog->IsES = blob_read_uint32(blob);
+   prog->ARB_fragment_coord_conventions_enable = blob_read_uint32(blob);
+   prog->FragDepthLayout = (enum gl_frag_depth_layout) blob_read_uint32(blob);
+   blob_copy_bytes(blob, (uint8_t *) &prog->TessEval, sizeof(prog->TessEval));
+   blob_copy_bytes(blob, (uint8_t *) &prog->Geom, sizeof(prog->Geom));
+   blob_copy_bytes(blob, (uint8_t *) &prog->Vert, sizeof(prog->Vert));
+   blob_copy_bytes(blob, (uint8_t *) &prog->Comp, sizeof(prog->Comp));
+   blob_copy_bytes(blob, (uint8_t *) prog->TransformFeedback.BufferStride,
+                   sizeof(prog->TransformFeedback.BufferStride));
+   prog->LastClipDistanceArraySize = blob_read_uint32(blob);
+   prog->LastCullDistanceArraySize = blob_read_uint32(blob);
+
+   if (!read_uniforms(blob, prog) ||
+       !read_blocks(blob, prog, &prog->UniformBlocks,
+                    &prog->NumUniformBlocks) ||
+       !read_blocks(blob, prog, &prog->ShaderStorageBlocks,
+                    &prog->NumShaderStorageBlocks) ||
+       !read_atomic_buffers(blob, prog) ||
+       !read_xfb(blob, prog))
+      return false;
+
+   stages = blob_read_uint32(blob);
+   if (blob->overrun)
+      return false;
+
+   for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
+      struct gl_linked_shader *sh;
+      struct gl_program *glprog;
+
+      if (!(stages & (1 << i)))
+         continue;
+
+      sh = ctx->Driver.NewShader((gl_shader_stage) i);
+      if (!sh)
+         return false;
+      prog->_LinkedShaders[i] = sh;
+
+      if (!read_linked_shader(blob, prog, sh))
+         return false;
+
+      glprog = ctx->Driver.NewProgram(ctx, _mesa_shader_stage_to_program(i),
+                                      prog->Name);
+      if (!glprog)
+         return false;
+      _mesa_reference_program(ctx, &sh->Program, glprog);
+      _mesa_reference_program(ctx, &glprog, NULL);
+
+      if (!read_program(blob, sh->Program))
+         return false;
+
+      _mesa_update_shader_textures_used(prog, sh->Program);
+      _mesa_associate_uniform_storage(ctx, prog, sh->Program->Parameters);
+
+      if (!ctx->Driver.ShaderCacheDeserialize(ctx, prog, sh->Program, blob))
+         return false;
+   }
+
+   if (!read_resource_list(blob, prog))
+      return false;
+
+   return blob->current == blob->end;
+}
+
+
+extern "C" bool
+_mesa_shader_cache_read_program(struct gl_context *ctx,
+                                struct gl_shader_program *prog)
+{
+   struct disk_cache *cache = get_cache(ctx);
+   struct blob_reader blob;
+   cache_key key;
+   uint8_t *data;
+   size_t size;
+   bool ok;
+
+   if (!cache || !compute_program_key(prog, key))
+      return false;
+
+   data = (uint8_t *) disk_cache_get(cache, key, &size);
+   if (!data)
+      return false;
+
+   clear_linked_state(ctx, prog);
+
+   blob_reader_init(&blob, data, size);
+   ok = read_program_metadata(ctx, &blob, prog, key) && prog->LinkStatus;
+   free(data);
+
+   if (!ok) {
+      /* Leave the program as the linker expects to find it */
+      _mesa_clear_shader_program_data(prog);
+      clear_linked_state(ctx, prog);
+      prog->LinkStatus = GL_TRUE;
+
+      disk_cache_remove(cache, key);
+      return false;
+   }
+
+   prog->Validated = GL_FALSE;
+   prog->_Used = GL_FALSE;
+   return true;
+}
+
+
+extern "C" void
+_mesa_shader_cache_write_program(struct gl_context *ctx,
+                                 struct gl_shader_program *prog)
+{
+   struct disk_cache *cache = get_cache(ctx);
+   struct blob *blob;
+   cache_key key;
+
+   if (!cache || !compute_program_key(prog, key))
+      return;
+
+   blob = blob_create(NULL);
+   if (!blob)
+      return;
+
+   if (write_program_metadata(ctx, blob, prog, key)) {
+      disk_cache_put(cache, key, blob->data, blob->size);
+
+      /* Let the shaders skip compilation from now on */
+      for (unsigned i = 0; i < prog->NumShaders; i++) {
+         if (!disk_cache_has_key(cache, prog->Shaders[i]->sha1))
+            disk_cache_put(cache, prog->Shaders[i]->sha1, NULL, 0);
+      }
+   }
+
+   ralloc_free(blob);
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file shader_cache.h
+ * On-disk cache of linked GLSL programs.
+ *
+ * A linked program is stored under a SHA-1 of the SHA-1s of its shaders
+ * and the state glLinkProgram depends on (attribute bindings, transform
+ * feedback varyings, ...).  Each shader SHA-1 covers the source and every
+ * piece of context state that can change how it compiles, including the
+ * driver name and the build of Mesa.
+ *
+ * The entry holds the core Mesa program state (uniforms, blocks, program
+ * resources, gl_program fields, ...) and whatever the driver adds through
+ * ctx->Driver.ShaderCacheSerialize.  On a hit, glLinkProgram restores all
+ * of it instead of running the linker and the driver back end.
+ *
+ * To also skip the front end, glCompileShader doesn't compile a shader that
+ * was part of a successfully linked program before.  If the link then
+ * misses the cache, the shader is compiled at that point.
+ */
+
+#pragma once
+#ifndef SHADER_CACHE_H
+#define SHADER_CACHE_H
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct gl_context;
+struct gl_shader;
+struct gl_shader_program;
+
+/**
+ * Compute the SHA-1 of \p sh, and skip compiling it if it is known to have
+ * compiled successfully before.
+ *
+ * \return  true if the shader is marked as compiled and must not be
+ *          compiled now.
+ */
+bool
+_mesa_shader_cache_skip_compile(struct gl_context *ctx, struct gl_shader *sh);
+
+/**
+ * Compile a shader whose compile was skipped, as required before linking it.
+ */
+void
+_mesa_shader_cache_compile_skipped(struct gl_context *ctx,
+                                   struct gl_shader *sh);
+
+/**
+ * Look up \p prog in the cache and restore its linked state on a hit.
+ *
+ * \return  true on a hit, in which case the program is fully linked.
+ */
+bool
+_mesa_shader_cache_read_program(struct gl_context *ctx,
+                                struct gl_shader_program *prog);
+
+/**
+ * Store a successfully linked program in the cache.
+ */
+void
+_mesa_shader_cache_write_program(struct gl_context *ctx,
+                                 struct gl_shader_program *prog);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SHADER_CACHE_H */
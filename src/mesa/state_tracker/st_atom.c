@@ -109,6 +109,61 @@ static void check_attrib_edgeflag(struct st_context *st)
 }
 
 
+static bool
+mask_is_empty(const GLbitfield *mask, unsigned size)
+{
+   unsigned i;
+
+   for (i = 0; i < size; i++) {
+      if (mask[i])
+         return false;
+   }
+   return true;
+}
+
+
+/**
+ * Turn uniform and storage buffer binding changes into partial updates of
+ * the UBO and SSBO states, as long as core Mesa told us which bindings
+ * changed.
+ */
+static void
+update_buffer_slots(struct st_context *st)
+{
+   struct gl_context *ctx = st->ctx;
+   unsigned i, j;
+
+   if (ctx->NewDriverState & ST_NEW_UNIFORM_BUFFER &&
+       !mask_is_empty(ctx->NewUniformBufferBindings,
+                      ARRAY_SIZE(ctx->NewUniformBufferBindings))) {
+      ctx->NewDriverState &= ~ST_NEW_UNIFORM_BUFFER;
+      st->dirty_slots |= ST_NEW_UNIFORM_BUFFER;
+
+      for (i = 0; i < ST_NUM_PIPELINES; i++) {
+         for (j = 0; j < ARRAY_SIZE(ctx->NewUniformBufferBindings); j++)
+            st->slots[i].ubos[j] |= ctx->NewUniformBufferBindings[j];
+      }
+   }
+
+   if (ctx->NewDriverState & ST_NEW_STORAGE_BUFFER &&
+       !mask_is_empty(ctx->NewShaderStorageBufferBindings,
+                      ARRAY_SIZE(ctx->NewShaderStorageBufferBindings))) {
+      ctx->NewDriverState &= ~ST_NEW_STORAGE_BUFFER;
+      st->dirty_slots |= ST_NEW_STORAGE_BUFFER;
+
+      for (i = 0; i < ST_NUM_PIPELINES; i++) {
+         for (j = 0; j < ARRAY_SIZE(ctx->NewShaderStorageBufferBindings); j++)
+            st->slots[i].ssbos[j] |= ctx->NewShaderStorageBufferBindings[j];
+      }
+   }
+
+   memset(ctx->NewUniformBufferBindings, 0,
+          sizeof(ctx->NewUniformBufferBindings));
+   memset(ctx->NewShaderStorageBufferBindings, 0,
+          sizeof(ctx->NewShaderStorageBufferBindings));
+}
+
+
 /***********************************************************************
  * Update all derived state:
  */
@@ -120,6 +175,7 @@ void st_validate_state( struct st_context *st, enum st_pipeline pipeline )
    uint32_t dirty_lo, dirty_hi;
 
    /* Get Mesa driver state. */
+   update_buffer_slots(st);
    st->dirty |= st->ctx->NewDriverState & ST_ALL_STATES_MASK;
    st->ctx->NewDriverState = 0;
 
@@ -156,10 +212,12 @@ void st_validate_state( struct st_context *st, enum st_pipeline pipeline )
       unreachable("Invalid pipeline specified");
    }
 
-   dirty = st->dirty & pipeline_mask;
+   dirty = (st->dirty | st->dirty_slots) & pipeline_mask;
    if (!dirty)
       return;
 
+   st->cur_slots = &st->slots[pipeline];
+
    dirty_lo = dirty;
    dirty_hi = dirty >> 32;
 
@@ -174,4 +232,6 @@ void st_validate_state( struct st_context *st, enum st_pipeline pipeline )
 
    /* Clear the render or compute state bits. */
    st->dirty &= ~pipeline_mask;
+   st->dirty_slots &= ~pipeline_mask;
+   memset(&st->slots[pipeline], 0, sizeof(st->slots[pipeline]));
 }
@@ -44,6 +44,7 @@ struct st_context;
 enum st_pipeline {
    ST_PIPELINE_RENDER,
    ST_PIPELINE_COMPUTE,
+   ST_NUM_PIPELINES,
 };
 
 struct st_tracked_state {
@@ -51,6 +52,16 @@ struct st_tracked_state {
 };
 
 
+/**
+ * Whether a binding is flagged in one of the st_dirty_slots masks.
+ */
+static inline GLboolean
+st_slot_is_dirty(const GLbitfield *mask, unsigned slot)
+{
+   return (mask[slot / 32] >> (slot % 32)) & 1;
+}
+
+
 void st_init_atoms( struct st_context *st );
 void st_destroy_atoms( struct st_context *st );
 void st_validate_state( struct st_context *st, enum st_pipeline pipeline );
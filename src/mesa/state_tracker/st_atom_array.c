@@ -571,6 +571,7 @@ setup_non_interleaved_attribs(struct st_context *st,
          vbuffer[attr].buffer = NULL;
          vbuffer[attr].user_buffer = NULL;
          vbuffer[attr].buffer_offset = 0;
+         vbuffer[attr].stride = 0;
          continue;
       }
 
@@ -633,6 +634,55 @@ setup_non_interleaved_attribs(struct st_context *st,
    return TRUE;
 }
 
+static inline bool
+vertex_buffers_equal(const struct pipe_vertex_buffer *a,
+                     const struct pipe_vertex_buffer *b)
+{
+   return a->buffer == b->buffer &&
+          a->user_buffer == b->user_buffer &&
+          a->buffer_offset == b->buffer_offset &&
+          a->stride == b->stride;
+}
+
+/**
+ * Bind the vertex buffers, skipping the leading and trailing ones that are
+ * the same as last time.  Meta operations only touch the auxiliary slot,
+ * which they save and restore, so the driver still has the others bound.
+ */
+static void
+set_vertex_buffers(struct st_context *st,
+                   const struct pipe_vertex_buffer *vbuffer,
+                   unsigned num_vbuffers)
+{
+   unsigned first, last;
+
+   for (first = 0; first < num_vbuffers; first++) {
+      if (!vertex_buffers_equal(&vbuffer[first], &st->last_vbuffers[first]))
+         break;
+   }
+   for (last = num_vbuffers; last > first; last--) {
+      if (!vertex_buffers_equal(&vbuffer[last - 1],
+                                &st->last_vbuffers[last - 1]))
+         break;
+   }
+
+   if (first < last) {
+      cso_set_vertex_buffers(st->cso_context, first, last - first,
+                             vbuffer + first);
+      memcpy(&st->last_vbuffers[first], &vbuffer[first],
+             (last - first) * sizeof(vbuffer[0]));
+   }
+
+   if (st->last_num_vbuffers > num_vbuffers) {
+      /* Unbind remaining buffers, if any. */
+      cso_set_vertex_buffers(st->cso_context, num_vbuffers,
+                             st->last_num_vbuffers - num_vbuffers, NULL);
+      memset(&st->last_vbuffers[num_vbuffers], 0,
+             (st->last_num_vbuffers - num_vbuffers) * sizeof(vbuffer[0]));
+   }
+   st->last_num_vbuffers = num_vbuffers;
+}
+
 static void update_array(struct st_context *st)
 {
    struct gl_context *ctx = st->ctx;
@@ -678,13 +728,7 @@ static void update_array(struct st_context *st)
       num_vbuffers = vpv->num_inputs;
    }
 
-   cso_set_vertex_buffers(st->cso_context, 0, num_vbuffers, vbuffer);
-   if (st->last_num_vbuffers > num_vbuffers) {
-      /* Unbind remaining buffers, if any. */
-      cso_set_vertex_buffers(st->cso_context, num_vbuffers,
-                             st->last_num_vbuffers - num_vbuffers, NULL);
-   }
-   st->last_num_vbuffers = num_vbuffers;
+   set_vertex_buffers(st, vbuffer, num_vbuffers);
    cso_set_vertex_elements(st->cso_context, num_velements, velements);
 }
 
@@ -234,21 +234,30 @@ const struct st_tracked_state st_update_cs_constants = {
    update_cs_constants					/* update */
 };
 
+/**
+ * Bind the uniform buffers used by a shader.  Unless \p state is flagged
+ * in st->dirty, only the blocks whose binding point changed are updated.
+ */
 static void st_bind_ubos(struct st_context *st,
                            struct gl_linked_shader *shader,
-                           unsigned shader_type)
+                           unsigned shader_type, uint64_t state)
 {
    unsigned i;
    struct pipe_constant_buffer cb = { 0 };
+   const bool all = (st->dirty & state) != 0;
 
    if (!shader)
       return;
 
    for (i = 0; i < shader->NumUniformBlocks; i++) {
+      const unsigned index = shader->UniformBlocks[i]->Binding;
       struct gl_uniform_buffer_binding *binding;
       struct st_buffer_object *st_obj;
 
-      binding = &st->ctx->UniformBufferBindings[shader->UniformBlocks[i]->Binding];
+      if (!all && !st_slot_is_dirty(st->cur_slots->ubos, index))
+         continue;
+
+      binding = &st->ctx->UniformBufferBindings[index];
       st_obj = st_buffer_object(binding->BufferObject);
 
       cb.buffer = st_obj->buffer;
@@ -280,7 +289,8 @@ static void bind_vs_ubos(struct st_context *st)
    if (!prog)
       return;
 
-   st_bind_ubos(st, prog->_LinkedShaders[MESA_SHADER_VERTEX], PIPE_SHADER_VERTEX);
+   st_bind_ubos(st, prog->_LinkedShaders[MESA_SHADER_VERTEX], PIPE_SHADER_VERTEX,
+                ST_NEW_VS_UBOS);
 }
 
 const struct st_tracked_state st_bind_vs_ubos = {
@@ -295,7 +305,8 @@ static void bind_fs_ubos(struct st_context *st)
    if (!prog)
       return;
 
-   st_bind_ubos(st, prog->_LinkedShaders[MESA_SHADER_FRAGMENT], PIPE_SHADER_FRAGMENT);
+   st_bind_ubos(st, prog->_LinkedShaders[MESA_SHADER_FRAGMENT], PIPE_SHADER_FRAGMENT,
+                ST_NEW_FS_UBOS);
 }
 
 const struct st_tracked_state st_bind_fs_ubos = {
@@ -310,7 +321,8 @@ static void bind_gs_ubos(struct st_context *st)
    if (!prog)
       return;
 
-   st_bind_ubos(st, prog->_LinkedShaders[MESA_SHADER_GEOMETRY], PIPE_SHADER_GEOMETRY);
+   st_bind_ubos(st, prog->_LinkedShaders[MESA_SHADER_GEOMETRY], PIPE_SHADER_GEOMETRY,
+                ST_NEW_GS_UBOS);
 }
 
 const struct st_tracked_state st_bind_gs_ubos = {
@@ -325,7 +337,8 @@ static void bind_tcs_ubos(struct st_context *st)
    if (!prog)
       return;
 
-   st_bind_ubos(st, prog->_LinkedShaders[MESA_SHADER_TESS_CTRL], PIPE_SHADER_TESS_CTRL);
+   st_bind_ubos(st, prog->_LinkedShaders[MESA_SHADER_TESS_CTRL], PIPE_SHADER_TESS_CTRL,
+                ST_NEW_TCS_UBOS);
 }
 
 const struct st_tracked_state st_bind_tcs_ubos = {
@@ -340,7 +353,8 @@ static void bind_tes_ubos(struct st_context *st)
    if (!prog)
       return;
 
-   st_bind_ubos(st, prog->_LinkedShaders[MESA_SHADER_TESS_EVAL], PIPE_SHADER_TESS_EVAL);
+   st_bind_ubos(st, prog->_LinkedShaders[MESA_SHADER_TESS_EVAL], PIPE_SHADER_TESS_EVAL,
+                ST_NEW_TES_UBOS);
 }
 
 const struct st_tracked_state st_bind_tes_ubos = {
@@ -356,7 +370,7 @@ static void bind_cs_ubos(struct st_context *st)
       return;
 
    st_bind_ubos(st, prog->_LinkedShaders[MESA_SHADER_COMPUTE],
-                PIPE_SHADER_COMPUTE);
+                PIPE_SHADER_COMPUTE, ST_NEW_CS_UBOS);
 }
 
 const struct st_tracked_state st_bind_cs_ubos = {
@@ -49,6 +49,7 @@
 
 #include "cso_cache/cso_context.h"
 
+#include "util/bitscan.h"
 #include "util/u_format.h"
 
 
@@ -126,25 +127,48 @@ gl_filter_to_img_filter(GLenum filter)
 }
 
 
+/**
+ * Return the sampler view whose swizzle has to be applied to the border
+ * color, or NULL if the border color is used as is.
+ */
+static const struct pipe_sampler_view *
+get_border_color_view(const struct st_context *st,
+                      const struct st_texture_object *stobj,
+                      const struct gl_sampler_object *msamp)
+{
+   GLuint i;
+
+   if (!st->apply_texture_swizzle_to_border_color)
+      return NULL;
+
+   /* Black borders look the same with any swizzle. */
+   if (!msamp->BorderColor.ui[0] &&
+       !msamp->BorderColor.ui[1] &&
+       !msamp->BorderColor.ui[2] &&
+       !msamp->BorderColor.ui[3])
+      return NULL;
+
+   /* Just search for the first used view. We can do this because the
+      swizzle is per-texture, not per context. */
+   /* XXX: clean that up to not use the sampler view at all */
+   for (i = 0; i < stobj->num_sampler_views; ++i) {
+      if (stobj->sampler_views[i])
+         return stobj->sampler_views[i];
+   }
+   return NULL;
+}
+
+
 static void
 convert_sampler(struct st_context *st,
                 struct pipe_sampler_state *sampler,
+                const struct gl_texture_object *texobj,
+                const struct gl_sampler_object *msamp,
+                GLenum texBaseFormat,
+                const struct pipe_sampler_view *sv,
                 GLuint texUnit)
 {
-   const struct gl_texture_object *texobj;
    struct gl_context *ctx = st->ctx;
-   const struct gl_sampler_object *msamp;
-   GLenum texBaseFormat;
-
-   texobj = ctx->Texture.Unit[texUnit]._Current;
-   if (!texobj) {
-      texobj = _mesa_get_fallback_texture(ctx, TEXTURE_2D_INDEX);
-      msamp = &texobj->Sampler;
-   } else {
-      msamp = _mesa_get_samplerobj(ctx, texUnit);
-   }
-
-   texBaseFormat = _mesa_texture_base_format(texobj);
 
    memset(sampler, 0, sizeof(*sampler));
    sampler->wrap_s = gl_wrap_xlate(msamp->WrapS);
@@ -177,23 +201,10 @@ convert_sampler(struct st_context *st,
        msamp->BorderColor.ui[1] ||
        msamp->BorderColor.ui[2] ||
        msamp->BorderColor.ui[3]) {
-      const struct st_texture_object *stobj = st_texture_object_const(texobj);
       const GLboolean is_integer = texobj->_IsIntegerFormat;
-      const struct pipe_sampler_view *sv = NULL;
       union pipe_color_union border_color;
-      GLuint i;
-
-      /* Just search for the first used view. We can do this because the
-         swizzle is per-texture, not per context. */
-      /* XXX: clean that up to not use the sampler view at all */
-      for (i = 0; i < stobj->num_sampler_views; ++i) {
-         if (stobj->sampler_views[i]) {
-            sv = stobj->sampler_views[i];
-            break;
-         }
-      }
 
-      if (st->apply_texture_swizzle_to_border_color && sv) {
+      if (sv) {
          const unsigned char swz[4] =
          {
             sv->swizzle_r,
@@ -231,6 +242,81 @@ convert_sampler(struct st_context *st,
 }
 
 
+/**
+ * Return the sampler CSO for the texture unit and store its state in
+ * \p sampler.
+ *
+ * The CSO is cached per texture unit together with everything that went
+ * into the pipe_sampler_state, so binding an unchanged texture/sampler
+ * pair again skips both the conversion and the CSO hash lookup.
+ */
+static void *
+get_sampler(struct st_context *st,
+            struct pipe_sampler_state *sampler,
+            GLuint texUnit)
+{
+   struct gl_context *ctx = st->ctx;
+   struct gl_texture_object *texobj;
+   const struct gl_sampler_object *msamp;
+   struct st_sampler_cache *cache;
+   const struct pipe_sampler_view *sv;
+   unsigned generation = cso_get_sampler_generation(st->cso_context);
+   unsigned border_swizzle;
+   GLenum texBaseFormat;
+
+   texobj = ctx->Texture.Unit[texUnit]._Current;
+   if (!texobj) {
+      texobj = _mesa_get_fallback_texture(ctx, TEXTURE_2D_INDEX);
+      msamp = &texobj->Sampler;
+   } else {
+      msamp = _mesa_get_samplerobj(ctx, texUnit);
+   }
+
+   cache = &st->sampler_cache[texUnit];
+   texBaseFormat = _mesa_texture_base_format(texobj);
+
+   sv = get_border_color_view(st, st_texture_object(texobj), msamp);
+   border_swizzle = sv ? sv->swizzle_r | sv->swizzle_g << 4 |
+                         sv->swizzle_b << 8 | sv->swizzle_a << 12 : ~0u;
+
+   if (cache->sampler == msamp &&
+       cache->sampler_seq_no == msamp->StateSeqNo &&
+       cache->cso_generation == generation &&
+       cache->target == texobj->Target &&
+       cache->unit_lod_bias == ctx->Texture.Unit[texUnit].LodBias &&
+       cache->base_format == texBaseFormat &&
+       cache->is_integer == texobj->_IsIntegerFormat &&
+       cache->cube_map_seamless == ctx->Texture.CubeMapSeamless &&
+       cache->border_swizzle == border_swizzle) {
+      st->sampler_cache_hits++;
+      *sampler = cache->state;
+      return cache->handle;
+   }
+
+   st->sampler_cache_misses++;
+   convert_sampler(st, sampler, texobj, msamp, texBaseFormat, sv, texUnit);
+
+   cache->handle = cso_lookup_sampler(st->cso_context, sampler);
+   if (!cache->handle) {
+      cache->sampler = NULL;
+      return NULL;
+   }
+
+   /* The lookup may have evicted other samplers. */
+   cache->cso_generation = cso_get_sampler_generation(st->cso_context);
+   cache->sampler = msamp;
+   cache->sampler_seq_no = msamp->StateSeqNo;
+   cache->target = texobj->Target;
+   cache->unit_lod_bias = ctx->Texture.Unit[texUnit].LodBias;
+   cache->base_format = texBaseFormat;
+   cache->is_integer = texobj->_IsIntegerFormat;
+   cache->cube_map_seamless = ctx->Texture.CubeMapSeamless;
+   cache->border_swizzle = border_swizzle;
+   cache->state = *sampler;
+   return cache->handle;
+}
+
+
 /**
  * Update the gallium driver's sampler state for fragment, vertex or
  * geometry shader stage.
@@ -246,13 +332,34 @@ update_shader_samplers(struct st_context *st,
    GLuint unit;
    GLbitfield samplers_used;
    const GLuint old_max = *num_samplers;
-   const struct pipe_sampler_state *states[PIPE_MAX_SAMPLERS];
 
    samplers_used = prog->SamplersUsed;
 
    if (*num_samplers == 0 && samplers_used == 0x0)
       return;
 
+   if (!(st->dirty & ST_NEW_SAMPLERS)) {
+      /* Only some units have a different texture or sampler bound, the
+       * program and thus the set of used samplers didn't change.
+       */
+      while (samplers_used) {
+         GLuint texUnit;
+
+         unit = u_bit_scan(&samplers_used);
+         texUnit = prog->SamplerUnits[unit];
+
+         if (st_slot_is_dirty(st->cur_slots->texture_units, texUnit)) {
+            cso_single_sampler_handle(st->cso_context, shader_stage, unit,
+                                      get_sampler(st, samplers + unit,
+                                                  texUnit));
+            *num_samplers = MAX2(*num_samplers, unit + 1);
+         }
+      }
+
+      cso_single_sampler_done(st->cso_context, shader_stage);
+      return;
+   }
+
    *num_samplers = 0;
 
    /* loop over sampler units (aka tex image units) */
@@ -262,12 +369,12 @@ update_shader_samplers(struct st_context *st,
       if (samplers_used & 1) {
          const GLuint texUnit = prog->SamplerUnits[unit];
 
-         convert_sampler(st, sampler, texUnit);
-         states[unit] = sampler;
+         cso_single_sampler_handle(st->cso_context, shader_stage, unit,
+                                   get_sampler(st, sampler, texUnit));
          *num_samplers = unit + 1;
       }
       else if (samplers_used != 0 || unit < old_max) {
-         states[unit] = NULL;
+         cso_single_sampler_handle(st->cso_context, shader_stage, unit, NULL);
       }
       else {
          /* if we've reset all the old samplers and we have no more new ones */
@@ -275,7 +382,7 @@ update_shader_samplers(struct st_context *st,
       }
    }
 
-   cso_set_samplers(st->cso_context, shader_stage, *num_samplers, states);
+   cso_single_sampler_done(st->cso_context, shader_stage);
 }
 
 
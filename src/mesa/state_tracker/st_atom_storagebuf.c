@@ -40,11 +40,42 @@
 #include "st_atom.h"
 #include "st_program.h"
 
+static void
+fill_shader_buffer(struct st_context *st, struct pipe_shader_buffer *sb,
+                   unsigned index)
+{
+   struct gl_shader_storage_buffer_binding *binding =
+      &st->ctx->ShaderStorageBufferBindings[index];
+   struct st_buffer_object *st_obj = st_buffer_object(binding->BufferObject);
+
+   sb->buffer = st_obj->buffer;
+
+   if (sb->buffer) {
+      sb->buffer_offset = binding->Offset;
+      sb->buffer_size = sb->buffer->width0 - binding->Offset;
+
+      /* AutomaticSize is FALSE if the buffer was set with BindBufferRange.
+       * Take the minimum just to be sure.
+       */
+      if (!binding->AutomaticSize)
+         sb->buffer_size = MIN2(sb->buffer_size, (unsigned) binding->Size);
+   }
+   else {
+      sb->buffer_offset = 0;
+      sb->buffer_size = 0;
+   }
+}
+
+/**
+ * Bind the storage buffers used by a shader.  Unless \p state is flagged
+ * in st->dirty, only the range of blocks whose binding point changed is
+ * passed to the driver.
+ */
 static void
 st_bind_ssbos(struct st_context *st, struct gl_linked_shader *shader,
-              unsigned shader_type)
+              unsigned shader_type, uint64_t state)
 {
-   unsigned i;
+   unsigned i, first, last;
    struct pipe_shader_buffer buffers[MAX_SHADER_STORAGE_BUFFERS];
    struct gl_program_constants *c;
 
@@ -53,36 +84,38 @@ st_bind_ssbos(struct st_context *st, struct gl_linked_shader *shader,
 
    c = &st->ctx->Const.Program[shader->Stage];
 
-   for (i = 0; i < shader->NumShaderStorageBlocks; i++) {
-      struct gl_shader_storage_buffer_binding *binding;
-      struct st_buffer_object *st_obj;
-      struct pipe_shader_buffer *sb = &buffers[i];
+   if (st->dirty & state) {
+      first = 0;
+      last = shader->NumShaderStorageBlocks;
+   }
+   else {
+      first = shader->NumShaderStorageBlocks;
+      last = 0;
+
+      for (i = 0; i < shader->NumShaderStorageBlocks; i++) {
+         if (st_slot_is_dirty(st->cur_slots->ssbos,
+                              shader->ShaderStorageBlocks[i]->Binding)) {
+            first = MIN2(first, i);
+            last = i + 1;
+         }
+      }
 
-      binding = &st->ctx->ShaderStorageBufferBindings[
-            shader->ShaderStorageBlocks[i]->Binding];
-      st_obj = st_buffer_object(binding->BufferObject);
+      if (first >= last)
+         return;
+   }
 
-      sb->buffer = st_obj->buffer;
+   for (i = first; i < last; i++) {
+      fill_shader_buffer(st, &buffers[i],
+                         shader->ShaderStorageBlocks[i]->Binding);
+   }
 
-      if (sb->buffer) {
-         sb->buffer_offset = binding->Offset;
-         sb->buffer_size = sb->buffer->width0 - binding->Offset;
+   st->pipe->set_shader_buffers(st->pipe, shader_type,
+                                c->MaxAtomicBuffers + first,
+                                last - first, buffers + first);
 
-         /* AutomaticSize is FALSE if the buffer was set with BindBufferRange.
-          * Take the minimum just to be sure.
-          */
-         if (!binding->AutomaticSize)
-            sb->buffer_size = MIN2(sb->buffer_size, (unsigned) binding->Size);
-      }
-      else {
-         sb->buffer_offset = 0;
-         sb->buffer_size = 0;
-      }
-   }
-   st->pipe->set_shader_buffers(st->pipe, shader_type, c->MaxAtomicBuffers,
-                                shader->NumShaderStorageBlocks, buffers);
    /* clear out any stale shader buffers */
-   if (shader->NumShaderStorageBlocks < c->MaxShaderStorageBlocks)
+   if ((st->dirty & state) &&
+       shader->NumShaderStorageBlocks < c->MaxShaderStorageBlocks)
       st->pipe->set_shader_buffers(
             st->pipe, shader_type,
             c->MaxAtomicBuffers + shader->NumShaderStorageBlocks,
@@ -99,7 +132,7 @@ static void bind_vs_ssbos(struct st_context *st)
       return;
 
    st_bind_ssbos(st, prog->_LinkedShaders[MESA_SHADER_VERTEX],
-                 PIPE_SHADER_VERTEX);
+                 PIPE_SHADER_VERTEX, ST_NEW_VS_SSBOS);
 }
 
 const struct st_tracked_state st_bind_vs_ssbos = {
@@ -115,7 +148,7 @@ static void bind_fs_ssbos(struct st_context *st)
       return;
 
    st_bind_ssbos(st, prog->_LinkedShaders[MESA_SHADER_FRAGMENT],
-                 PIPE_SHADER_FRAGMENT);
+                 PIPE_SHADER_FRAGMENT, ST_NEW_FS_SSBOS);
 }
 
 const struct st_tracked_state st_bind_fs_ssbos = {
@@ -131,7 +164,7 @@ static void bind_gs_ssbos(struct st_context *st)
       return;
 
    st_bind_ssbos(st, prog->_LinkedShaders[MESA_SHADER_GEOMETRY],
-                 PIPE_SHADER_GEOMETRY);
+                 PIPE_SHADER_GEOMETRY, ST_NEW_GS_SSBOS);
 }
 
 const struct st_tracked_state st_bind_gs_ssbos = {
@@ -147,7 +180,7 @@ static void bind_tcs_ssbos(struct st_context *st)
       return;
 
    st_bind_ssbos(st, prog->_LinkedShaders[MESA_SHADER_TESS_CTRL],
-                 PIPE_SHADER_TESS_CTRL);
+                 PIPE_SHADER_TESS_CTRL, ST_NEW_TCS_SSBOS);
 }
 
 const struct st_tracked_state st_bind_tcs_ssbos = {
@@ -163,7 +196,7 @@ static void bind_tes_ssbos(struct st_context *st)
       return;
 
    st_bind_ssbos(st, prog->_LinkedShaders[MESA_SHADER_TESS_EVAL],
-                 PIPE_SHADER_TESS_EVAL);
+                 PIPE_SHADER_TESS_EVAL, ST_NEW_TES_SSBOS);
 }
 
 const struct st_tracked_state st_bind_tes_ssbos = {
@@ -179,7 +212,7 @@ static void bind_cs_ssbos(struct st_context *st)
       return;
 
    st_bind_ssbos(st, prog->_LinkedShaders[MESA_SHADER_COMPUTE],
-                 PIPE_SHADER_COMPUTE);
+                 PIPE_SHADER_COMPUTE, ST_NEW_CS_SSBOS);
 }
 
 const struct st_tracked_state st_bind_cs_ssbos = {
@@ -46,6 +46,7 @@
 #include "st_format.h"
 #include "st_cb_texture.h"
 #include "pipe/p_context.h"
+#include "util/bitscan.h"
 #include "util/u_format.h"
 #include "util/u_inlines.h"
 #include "cso_cache/cso_context.h"
@@ -418,11 +419,56 @@ update_single_texture(struct st_context *st,
 
 
 
+/**
+ * Update the sampler views of the units in st->cur_slots only.  The program
+ * didn't change since the last full update, so the set of used samplers is
+ * the same.
+ */
+static void
+update_dirty_textures(struct st_context *st,
+                      const struct gl_program *prog,
+                      unsigned glsl_version,
+                      unsigned shader_stage,
+                      struct pipe_sampler_view **sampler_views,
+                      unsigned *num_textures)
+{
+   GLbitfield samplers_used = prog->SamplersUsed;
+   bool changed = false;
+
+   while (samplers_used) {
+      const unsigned unit = u_bit_scan(&samplers_used);
+      const GLuint texUnit = prog->SamplerUnits[unit];
+      struct pipe_sampler_view *sampler_view = NULL;
+
+      if (!st_slot_is_dirty(st->cur_slots->texture_units, texUnit))
+         continue;
+
+      if (!update_single_texture(st, &sampler_view, texUnit, glsl_version))
+         continue;
+
+      *num_textures = MAX2(*num_textures, unit + 1);
+
+      if (sampler_view != sampler_views[unit]) {
+         pipe_sampler_view_reference(&sampler_views[unit], sampler_view);
+         changed = true;
+      }
+   }
+
+   if (changed) {
+      cso_set_sampler_views(st->cso_context,
+                            shader_stage,
+                            *num_textures,
+                            sampler_views);
+   }
+}
+
+
 static void
 update_textures(struct st_context *st,
                 gl_shader_stage mesa_shader,
                 const struct gl_program *prog,
                 unsigned max_units,
+                uint64_t state,
                 struct pipe_sampler_view **sampler_views,
                 unsigned *num_textures)
 {
@@ -437,6 +483,12 @@ update_textures(struct st_context *st,
    if (samplers_used == 0x0 && old_max == 0)
       return;
 
+   if (!(st->dirty & state)) {
+      update_dirty_textures(st, prog, glsl_version, shader_stage,
+                            sampler_views, num_textures);
+      return;
+   }
+
    *num_textures = 0;
 
    /* loop over sampler units (aka tex image units) */
@@ -480,6 +532,7 @@ update_vertex_textures(struct st_context *st)
                       MESA_SHADER_VERTEX,
                       &ctx->VertexProgram._Current->Base,
                       ctx->Const.Program[MESA_SHADER_VERTEX].MaxTextureImageUnits,
+                      ST_NEW_VS_SAMPLER_VIEWS,
                       st->state.sampler_views[PIPE_SHADER_VERTEX],
                       &st->state.num_sampler_views[PIPE_SHADER_VERTEX]);
    }
@@ -495,6 +548,7 @@ update_fragment_textures(struct st_context *st)
                    MESA_SHADER_FRAGMENT,
                    &ctx->FragmentProgram._Current->Base,
                    ctx->Const.Program[MESA_SHADER_FRAGMENT].MaxTextureImageUnits,
+                   ST_NEW_FS_SAMPLER_VIEWS,
                    st->state.sampler_views[PIPE_SHADER_FRAGMENT],
                    &st->state.num_sampler_views[PIPE_SHADER_FRAGMENT]);
 }
@@ -510,6 +564,7 @@ update_geometry_textures(struct st_context *st)
                       MESA_SHADER_GEOMETRY,
                       &ctx->GeometryProgram._Current->Base,
                       ctx->Const.Program[MESA_SHADER_GEOMETRY].MaxTextureImageUnits,
+                      ST_NEW_GS_SAMPLER_VIEWS,
                       st->state.sampler_views[PIPE_SHADER_GEOMETRY],
                       &st->state.num_sampler_views[PIPE_SHADER_GEOMETRY]);
    }
@@ -526,6 +581,7 @@ update_tessctrl_textures(struct st_context *st)
                       MESA_SHADER_TESS_CTRL,
                       &ctx->TessCtrlProgram._Current->Base,
                       ctx->Const.Program[MESA_SHADER_TESS_CTRL].MaxTextureImageUnits,
+                      ST_NEW_TCS_SAMPLER_VIEWS,
                       st->state.sampler_views[PIPE_SHADER_TESS_CTRL],
                       &st->state.num_sampler_views[PIPE_SHADER_TESS_CTRL]);
    }
@@ -542,6 +598,7 @@ update_tesseval_textures(struct st_context *st)
                       MESA_SHADER_TESS_EVAL,
                       &ctx->TessEvalProgram._Current->Base,
                       ctx->Const.Program[MESA_SHADER_TESS_EVAL].MaxTextureImageUnits,
+                      ST_NEW_TES_SAMPLER_VIEWS,
                       st->state.sampler_views[PIPE_SHADER_TESS_EVAL],
                       &st->state.num_sampler_views[PIPE_SHADER_TESS_EVAL]);
    }
@@ -558,6 +615,7 @@ update_compute_textures(struct st_context *st)
                       MESA_SHADER_COMPUTE,
                       &ctx->ComputeProgram._Current->Base,
                       ctx->Const.Program[MESA_SHADER_COMPUTE].MaxTextureImageUnits,
+                      ST_NEW_CS_SAMPLER_VIEWS,
                       st->state.sampler_views[PIPE_SHADER_COMPUTE],
                       &st->state.num_sampler_views[PIPE_SHADER_COMPUTE]);
    }
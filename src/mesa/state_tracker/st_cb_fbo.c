@@ -740,6 +740,35 @@ st_ReadBuffer(struct gl_context *ctx, GLenum buffer)
 
 
 
+/**
+ * Whether the rows of the given renderbuffer are stored top to bottom.
+ * That's never the case for user-created renderbuffers, and a window
+ * system renderbuffer has the orientation of the bound framebuffer it's
+ * attached to.
+ */
+static GLboolean
+renderbuffer_flip_y(const struct gl_context *ctx,
+                    const struct gl_renderbuffer *rb)
+{
+   const struct gl_framebuffer *fbs[2] = { ctx->DrawBuffer, ctx->ReadBuffer };
+   unsigned i, j;
+
+   if (rb->Name != 0)
+      return GL_FALSE;
+
+   for (i = 0; i < ARRAY_SIZE(fbs); i++) {
+      if (!fbs[i] || _mesa_is_user_fbo(fbs[i]))
+         continue;
+      for (j = 0; j < BUFFER_COUNT; j++) {
+         if (fbs[i]->Attachment[j].Renderbuffer == rb)
+            return fbs[i]->FlipY;
+      }
+   }
+
+   return GL_TRUE;
+}
+
+
 /**
  * Called via ctx->Driver.MapRenderbuffer.
  */
@@ -753,7 +782,7 @@ st_MapRenderbuffer(struct gl_context *ctx,
    struct st_context *st = st_context(ctx);
    struct st_renderbuffer *strb = st_renderbuffer(rb);
    struct pipe_context *pipe = st->pipe;
-   const GLboolean invert = rb->Name == 0;
+   const GLboolean invert = renderbuffer_flip_y(ctx, rb);
    unsigned usage;
    GLuint y2;
    GLubyte *map;
@@ -783,8 +812,9 @@ st_MapRenderbuffer(struct gl_context *ctx,
       usage |= PIPE_TRANSFER_DISCARD_RANGE;
 
    /* Note: y=0=bottom of buffer while y2=0=top of buffer.
-    * 'invert' will be true for window-system buffers and false for
-    * user-allocated renderbuffers and textures.
+    * 'invert' will be true for window-system buffers (unless the window
+    * system stores them bottom to top) and false for user-allocated
+    * renderbuffers and textures.
     */
    if (invert)
       y2 = strb->Base.Height - y - h;
@@ -36,9 +36,11 @@
 #include "main/shaderapi.h"
 #include "program/prog_instruction.h"
 #include "program/program.h"
+#include "compiler/glsl/blob.h"
 
 #include "cso_cache/cso_context.h"
 #include "draw/draw_context.h"
+#include "tgsi/tgsi_parse.h"
 
 #include "st_context.h"
 #include "st_debug.h"
@@ -290,6 +292,199 @@ st_new_ati_fs(struct gl_context *ctx, struct ati_fragment_shader *curProg)
    return prog;
 }
 
+
+static void
+write_tgsi_to_blob(struct blob *blob, const struct tgsi_token *tokens)
+{
+   const unsigned num_tokens = tgsi_num_tokens(tokens);
+
+   blob_write_uint32(blob, num_tokens);
+   blob_write_bytes(blob, tokens, num_tokens * sizeof(struct tgsi_token));
+}
+
+
+static const struct tgsi_token *
+read_tgsi_from_blob(struct blob_reader *blob)
+{
+   const unsigned num_tokens = blob_read_uint32(blob);
+   struct tgsi_token *tokens;
+
+   if (blob->overrun || num_tokens == 0)
+      return NULL;
+
+   tokens = tgsi_alloc_tokens(num_tokens);
+   if (!tokens)
+      return NULL;
+
+   blob_copy_bytes(blob, (uint8_t *) tokens,
+                   num_tokens * sizeof(struct tgsi_token));
+   if (blob->overrun) {
+      tgsi_free_tokens(tokens);
+      return NULL;
+   }
+   return tokens;
+}
+
+
+/**
+ * Called via ctx->Driver.ShaderCacheSerialize() to store the translated
+ * TGSI of a linked GLSL program in the program cache.
+ */
+static GLboolean
+st_shader_cache_serialize(struct gl_context *ctx, struct gl_program *prog,
+                          struct blob *blob)
+{
+   switch (prog->Target) {
+   case GL_VERTEX_PROGRAM_ARB: {
+      struct st_vertex_program *stvp = (struct st_vertex_program *) prog;
+
+      /* NIR programs are translated for each variant */
+      if (stvp->shader_program || !stvp->tgsi.tokens)
+         return GL_FALSE;
+
+      blob_write_uint32(blob, stvp->num_inputs);
+      blob_write_bytes(blob, stvp->index_to_input,
+                       sizeof(stvp->index_to_input));
+      blob_write_bytes(blob, stvp->result_to_output,
+                       sizeof(stvp->result_to_output));
+      blob_write_bytes(blob, &stvp->tgsi.stream_output,
+                       sizeof(stvp->tgsi.stream_output));
+      write_tgsi_to_blob(blob, stvp->tgsi.tokens);
+      return GL_TRUE;
+   }
+   case GL_FRAGMENT_PROGRAM_ARB: {
+      struct st_fragment_program *stfp = (struct st_fragment_program *) prog;
+
+      if (stfp->shader_program || stfp->ati_fs || !stfp->tgsi.tokens)
+         return GL_FALSE;
+
+      write_tgsi_to_blob(blob, stfp->tgsi.tokens);
+      return GL_TRUE;
+   }
+   case GL_GEOMETRY_PROGRAM_NV:
+   case GL_TESS_CONTROL_PROGRAM_NV:
+   case GL_TESS_EVALUATION_PROGRAM_NV: {
+      struct pipe_shader_state *tgsi;
+
+      if (prog->Target == GL_GEOMETRY_PROGRAM_NV)
+         tgsi = &((struct st_geometry_program *) prog)->tgsi;
+      else if (prog->Target == GL_TESS_CONTROL_PROGRAM_NV)
+         tgsi = &((struct st_tessctrl_program *) prog)->tgsi;
+      else
+         tgsi = &((struct st_tesseval_program *) prog)->tgsi;
+
+      if (!tgsi->tokens)
+         return GL_FALSE;
+
+      blob_write_bytes(blob, &tgsi->stream_output,
+                       sizeof(tgsi->stream_output));
+      write_tgsi_to_blob(blob, tgsi->tokens);
+      return GL_TRUE;
+   }
+   case GL_COMPUTE_PROGRAM_NV: {
+      struct st_compute_program *stcp = (struct st_compute_program *) prog;
+
+      if (stcp->tgsi.ir_type != PIPE_SHADER_IR_TGSI || !stcp->tgsi.prog)
+         return GL_FALSE;
+
+      write_tgsi_to_blob(blob, stcp->tgsi.prog);
+      return GL_TRUE;
+   }
+   default:
+      return GL_FALSE;
+   }
+}
+
+
+/**
+ * Called via ctx->Driver.ShaderCacheDeserialize() to restore what
+ * st_shader_cache_serialize() stored, instead of translating the program.
+ */
+static GLboolean
+st_shader_cache_deserialize(struct gl_context *ctx,
+                            struct gl_shader_program *shProg,
+                            struct gl_program *prog,
+                            struct blob_reader *blob)
+{
+   struct st_context *st = st_context(ctx);
+   gl_shader_stage stage = _mesa_program_enum_to_shader_stage(prog->Target);
+   const struct tgsi_token *tokens;
+
+   switch (prog->Target) {
+   case GL_VERTEX_PROGRAM_ARB: {
+      struct st_vertex_program *stvp = (struct st_vertex_program *) prog;
+
+      stvp->num_inputs = blob_read_uint32(blob);
+      blob_copy_bytes(blob, (uint8_t *) stvp->index_to_input,
+                      sizeof(stvp->index_to_input));
+      blob_copy_bytes(blob, (uint8_t *) stvp->result_to_output,
+                      sizeof(stvp->result_to_output));
+      blob_copy_bytes(blob, (uint8_t *) &stvp->tgsi.stream_output,
+                      sizeof(stvp->tgsi.stream_output));
+      tokens = read_tgsi_from_blob(blob);
+      if (!tokens)
+         return GL_FALSE;
+
+      stvp->tgsi.tokens = tokens;
+      break;
+   }
+   case GL_FRAGMENT_PROGRAM_ARB: {
+      struct st_fragment_program *stfp = (struct st_fragment_program *) prog;
+
+      tokens = read_tgsi_from_blob(blob);
+      if (!tokens)
+         return GL_FALSE;
+
+      stfp->tgsi.tokens = tokens;
+      break;
+   }
+   case GL_GEOMETRY_PROGRAM_NV:
+   case GL_TESS_CONTROL_PROGRAM_NV:
+   case GL_TESS_EVALUATION_PROGRAM_NV: {
+      struct pipe_shader_state *tgsi;
+
+      if (prog->Target == GL_GEOMETRY_PROGRAM_NV)
+         tgsi = &((struct st_geometry_program *) prog)->tgsi;
+      else if (prog->Target == GL_TESS_CONTROL_PROGRAM_NV)
+         tgsi = &((struct st_tessctrl_program *) prog)->tgsi;
+      else
+         tgsi = &((struct st_tesseval_program *) prog)->tgsi;
+
+      blob_copy_bytes(blob, (uint8_t *) &tgsi->stream_output,
+                      sizeof(tgsi->stream_output));
+      tokens = read_tgsi_from_blob(blob);
+      if (!tokens)
+         return GL_FALSE;
+
+      tgsi->tokens = tokens;
+      break;
+   }
+   case GL_COMPUTE_PROGRAM_NV: {
+      struct st_compute_program *stcp = (struct st_compute_program *) prog;
+
+      tokens = read_tgsi_from_blob(blob);
+      if (!tokens)
+         return GL_FALSE;
+
+      stcp->tgsi.ir_type = PIPE_SHADER_IR_TGSI;
+      stcp->tgsi.prog = tokens;
+      stcp->tgsi.req_local_mem = stcp->Base.SharedSize;
+      stcp->tgsi.req_private_mem = 0;
+      stcp->tgsi.req_input_mem = 0;
+      break;
+   }
+   default:
+      return GL_FALSE;
+   }
+
+   if (ST_DEBUG & DEBUG_PRECOMPILE ||
+       st->shader_has_one_variant[stage])
+      st_precompile_shader_variant(st, prog);
+
+   return GL_TRUE;
+}
+
+
 /**
  * Plug in the program and shader-related device driver functions.
  */
@@ -302,4 +497,6 @@ st_init_program_functions(struct dd_function_table *functions)
    functions->NewATIfs = st_new_ati_fs;
    
    functions->LinkShader = st_link_shader;
+   functions->ShaderCacheSerialize = st_shader_cache_serialize;
+   functions->ShaderCacheDeserialize = st_shader_cache_deserialize;
 }
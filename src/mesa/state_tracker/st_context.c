@@ -25,6 +25,7 @@
  * 
  **************************************************************************/
 
+#include <inttypes.h>  /* for PRIu64 macro */
 #include "main/imports.h"
 #include "main/accum.h"
 #include "main/api_exec.h"
@@ -203,10 +204,25 @@ void st_invalidate_state(struct gl_context * ctx, GLbitfield new_state)
    if (new_state & _NEW_PIXEL)
       st->dirty |= ST_NEW_PIXEL_TRANSFER;
 
-   if (new_state & _NEW_TEXTURE)
+   if (new_state & _NEW_TEXTURE_STATE) {
       st->dirty |= ST_NEW_SAMPLER_VIEWS |
                    ST_NEW_SAMPLERS |
                    ST_NEW_IMAGE_UNITS;
+   }
+   else if (new_state & _NEW_TEXTURE_BINDINGS) {
+      /* Only the units in _DirtyUnits have a different texture or sampler
+       * object bound.
+       */
+      unsigned i, j;
+
+      st->dirty_slots |= ST_NEW_SAMPLER_VIEWS |
+                         ST_NEW_SAMPLERS;
+
+      for (i = 0; i < ST_NUM_PIPELINES; i++) {
+         for (j = 0; j < ARRAY_SIZE(ctx->Texture._DirtyUnits); j++)
+            st->slots[i].texture_units[j] |= ctx->Texture._DirtyUnits[j];
+      }
+   }
 
    if (new_state & _NEW_CURRENT_ATTRIB)
       st->dirty |= ST_NEW_VERTEX_ARRAYS;
@@ -539,6 +555,11 @@ void st_destroy_context( struct st_context *st )
 
    _mesa_HashWalk(ctx->Shared->TexObjects, destroy_tex_sampler_cb, st);
 
+   if (ST_DEBUG & DEBUG_SAMPLERS) {
+      debug_printf("st: sampler cache: %"PRIu64" hits, %"PRIu64" misses\n",
+                   st->sampler_cache_hits, st->sampler_cache_misses);
+   }
+
    st_reference_fragprog(st, &st->fp, NULL);
    st_reference_geomprog(st, &st->gp, NULL);
    st_reference_vertprog(st, &st->vp, NULL);
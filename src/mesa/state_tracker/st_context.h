@@ -51,6 +51,28 @@ struct st_perf_monitor_group;
 struct u_upload_mgr;
 
 
+/**
+ * The last sampler state converted for a texture unit, see
+ * st_atom_sampler.c.  Everything besides \c state and \c handle is the key
+ * the entry is valid for.
+ */
+struct st_sampler_cache
+{
+   const struct gl_sampler_object *sampler; /**< texobj->Sampler or bound one */
+   GLuint sampler_seq_no;          /**< sampler->StateSeqNo at conversion */
+   unsigned cso_generation;        /**< cso_get_sampler_generation() */
+   GLenum target;                  /**< gl_texture_object::Target */
+   GLfloat unit_lod_bias;          /**< gl_texture_unit::LodBias */
+   GLenum base_format;             /**< _mesa_texture_base_format() */
+   GLboolean is_integer;           /**< gl_texture_object::_IsIntegerFormat */
+   GLboolean cube_map_seamless;    /**< gl_texture_attrib::CubeMapSeamless */
+   unsigned border_swizzle;        /**< view swizzle applied to the border */
+
+   struct pipe_sampler_state state;
+   void *handle;                   /**< from cso_lookup_sampler() */
+};
+
+
 /** For drawing quads for glClear, glDraw/CopyPixels, glBitmap, etc. */
 struct st_util_vertex
 {
@@ -140,6 +162,20 @@ struct st_context
 
    uint64_t dirty; /**< dirty states */
 
+   /**
+    * States that only need the bindings flagged in slots[pipeline] updated.
+    * A state that is also set in \c dirty gets a full update.
+    */
+   uint64_t dirty_slots;
+   struct st_dirty_slots {
+      GLbitfield texture_units[(MAX_COMBINED_TEXTURE_IMAGE_UNITS + 31) / 32];
+      GLbitfield ubos[(MAX_COMBINED_UNIFORM_BUFFERS + 31) / 32];
+      GLbitfield ssbos[(MAX_COMBINED_SHADER_STORAGE_BUFFERS + 31) / 32];
+   } slots[ST_NUM_PIPELINES];
+
+   /** The slots of the pipeline being validated */
+   const struct st_dirty_slots *cur_slots;
+
    /* If true, further analysis of states is required to know if something
     * has changed. Used mainly for shaders.
     */
@@ -239,10 +275,24 @@ struct st_context
 
    struct cso_context *cso_context;
 
+   /**
+    * Sampler CSO last used by each texture unit, so that binding the same
+    * texture and sampler again doesn't need to convert and hash the
+    * sampler state.  This is per context rather than on the texture
+    * objects, which may be shared with contexts in other threads.
+    */
+   struct st_sampler_cache sampler_cache[MAX_COMBINED_TEXTURE_IMAGE_UNITS];
+
+   /** st_sampler_cache statistics, printed with ST_DEBUG=samplers */
+   uint64_t sampler_cache_hits;
+   uint64_t sampler_cache_misses;
+
    void *winsys_drawable_handle;
 
    /* The number of vertex buffers from the last call of validate_arrays. */
    unsigned last_num_vbuffers;
+   /* The vertex buffers from the last call, only changed ones are rebound. */
+   struct pipe_vertex_buffer last_vbuffers[PIPE_MAX_SHADER_INPUTS];
 
    int32_t draw_stamp;
    int32_t read_stamp;
@@ -292,7 +342,7 @@ void st_invalidate_readpix_cache(struct st_context *st);
 static inline GLuint
 st_fb_orientation(const struct gl_framebuffer *fb)
 {
-   if (fb && _mesa_is_winsys_fbo(fb)) {
+   if (fb && fb->FlipY) {
       /* Drawing into a window (on-screen buffer).
        *
        * Negate Y scale to flip image vertically.
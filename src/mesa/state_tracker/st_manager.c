@@ -34,6 +34,7 @@
 #include "main/texstate.h"
 #include "main/errors.h"
 #include "main/framebuffer.h"
+#include "main/glthread.h"
 #include "main/fbobject.h"
 #include "main/renderbuffer.h"
 #include "main/version.h"
@@ -251,6 +252,17 @@ st_framebuffer_validate(struct st_framebuffer *stfb,
       pipe_resource_reference(&textures[i], NULL);
    }
 
+   if (stfb->Base.FlipY == stfb->iface->y_0_bottom) {
+      stfb->Base.FlipY = !stfb->iface->y_0_bottom;
+      changed = TRUE;
+
+      /* the viewport, rasterizer and scissor state and the WPOS transform
+       * depend on the orientation
+       */
+      st_invalidate_state(st->ctx, _NEW_BUFFERS | _NEW_PROGRAM_CONSTANTS);
+      st_invalidate_readpix_cache(st);
+   }
+
    if (changed) {
       ++stfb->stamp;
       _mesa_resize_framebuffer(st->ctx, &stfb->Base, width, height);
@@ -461,6 +473,7 @@ st_framebuffer_create(struct st_context *st,
    }
 
    _mesa_initialize_window_framebuffer(&stfb->Base, &mode);
+   stfb->Base.FlipY = !stfbi->y_0_bottom;
 
    stfb->iface = stfbi;
    stfb->iface_stamp = p_atomic_read(&stfbi->stamp) - 1;
@@ -499,6 +512,8 @@ st_context_flush(struct st_context_iface *stctxi, unsigned flags,
    struct st_context *st = (struct st_context *) stctxi;
    unsigned pipe_flags = 0;
 
+   _mesa_glthread_finish(st->ctx);
+
    if (flags & ST_FLUSH_END_OF_FRAME) {
       pipe_flags |= PIPE_FLUSH_END_OF_FRAME;
    }
@@ -524,6 +539,8 @@ st_context_teximage(struct st_context_iface *stctxi,
    GLuint width, height, depth;
    GLenum target;
 
+   _mesa_glthread_finish(ctx);
+
    switch (tex_type) {
    case ST_TEXTURE_1D:
       target = GL_TEXTURE_1D;
@@ -602,6 +619,8 @@ st_context_copy(struct st_context_iface *stctxi,
    struct st_context *st = (struct st_context *) stctxi;
    struct st_context *src = (struct st_context *) stsrci;
 
+   _mesa_glthread_finish(src->ctx);
+   _mesa_glthread_finish(st->ctx);
    _mesa_copy_context(src->ctx, st->ctx, mask);
 }
 
@@ -619,9 +638,28 @@ static void
 st_context_destroy(struct st_context_iface *stctxi)
 {
    struct st_context *st = (struct st_context *) stctxi;
+
+   /* The worker thread must be gone before the context is torn down. */
+   _mesa_glthread_destroy(st->ctx);
    st_destroy_context(st);
 }
 
+static void
+st_start_thread(struct st_context_iface *stctxi)
+{
+   struct st_context *st = (struct st_context *) stctxi;
+
+   _mesa_glthread_init(st->ctx);
+}
+
+static void
+st_thread_finish(struct st_context_iface *stctxi)
+{
+   struct st_context *st = (struct st_context *) stctxi;
+
+   _mesa_glthread_finish(st->ctx);
+}
+
 static struct st_context_iface *
 st_api_create_context(struct st_api *stapi, struct st_manager *smapi,
                       const struct st_context_attribs *attribs,
@@ -710,6 +748,8 @@ st_api_create_context(struct st_api *stapi, struct st_manager *smapi,
    st->iface.teximage = st_context_teximage;
    st->iface.copy = st_context_copy;
    st->iface.share = st_context_share;
+   st->iface.start_thread = st_start_thread;
+   st->iface.thread_finish = st_thread_finish;
    st->iface.st_context_private = (void *) smapi;
    st->iface.cso_context = st->cso_context;
    st->iface.pipe = st->pipe;
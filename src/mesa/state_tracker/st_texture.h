@@ -35,6 +35,7 @@
 #include "main/mtypes.h"
 
 
+struct cso_context;
 struct pipe_resource;
 
 
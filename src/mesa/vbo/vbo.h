@@ -183,6 +183,10 @@ vbo_sizeof_ib_type(GLenum type)
 void
 vbo_delete_minmax_cache(struct gl_buffer_object *bufferObj);
 
+void
+vbo_invalidate_minmax_cache(struct gl_buffer_object *bufferObj,
+                            GLintptr offset, GLsizeiptr size);
+
 void
 vbo_get_minmax_indices(struct gl_context *ctx, const struct _mesa_prim *prim,
                        const struct _mesa_index_buffer *ib,
@@ -30,45 +30,8 @@
 #include "main/context.h"
 #include "main/varray.h"
 #include "main/macros.h"
-#include "main/sse_minmax.h"
-#include "x86/common_x86_asm.h"
-#include "util/hash_table.h"
-
-
-struct minmax_cache_key {
-   GLintptr offset;
-   GLuint count;
-   GLenum type;
-};
-
-
-struct minmax_cache_entry {
-   struct minmax_cache_key key;
-   GLuint min;
-   GLuint max;
-};
-
-
-static uint32_t
-vbo_minmax_cache_hash(const struct minmax_cache_key *key)
-{
-   return _mesa_hash_data(key, sizeof(*key));
-}
-
-
-static bool
-vbo_minmax_cache_key_equal(const struct minmax_cache_key *a,
-                           const struct minmax_cache_key *b)
-{
-   return (a->offset == b->offset) && (a->count == b->count) && (a->type == b->type);
-}
-
-
-static void
-vbo_minmax_cache_delete_entry(struct hash_entry *entry)
-{
-   free(entry->data);
-}
+#include "main/index_scan.h"
+#include "util/u_index_range.h"
 
 
 static GLboolean
@@ -94,135 +57,138 @@ vbo_use_minmax_cache(struct gl_buffer_object *bufferObj)
 void
 vbo_delete_minmax_cache(struct gl_buffer_object *bufferObj)
 {
-   _mesa_hash_table_destroy(bufferObj->MinMaxCache, vbo_minmax_cache_delete_entry);
+   mtx_lock(&bufferObj->Mutex);
+   util_index_range_destroy(bufferObj->MinMaxCache);
    bufferObj->MinMaxCache = NULL;
+   mtx_unlock(&bufferObj->Mutex);
 }
 
 
+/**
+ * Called when [offset, offset + size) of the buffer is written, so that the
+ * blocks in that range are scanned again when they are next needed.
+ */
+void
+vbo_invalidate_minmax_cache(struct gl_buffer_object *bufferObj,
+                            GLintptr offset, GLsizeiptr size)
+{
+   mtx_lock(&bufferObj->Mutex);
+   if (bufferObj->MinMaxCache)
+      util_index_range_invalidate(bufferObj->MinMaxCache, offset, size);
+   mtx_unlock(&bufferObj->Mutex);
+}
+
+
+/**
+ * Get the index bounds of a range of the buffer from its min/max tree,
+ * creating the tree if needed.  Only blocks written since they were last
+ * scanned and the partial blocks at the ends of the range are read.
+ *
+ * The buffer mutex is only held while looking the range up in the tree and
+ * while storing the bounds of the blocks that were read, not while the
+ * buffer is mapped and scanned.
+ */
 static GLboolean
-vbo_get_minmax_cached(struct gl_buffer_object *bufferObj,
-                      GLenum type, GLintptr offset, GLuint count,
+vbo_get_minmax_cached(struct gl_context *ctx,
+                      struct gl_buffer_object *bufferObj,
+                      unsigned index_size, GLintptr offset, GLuint count,
+                      bool restart, unsigned restartIndex,
                       GLuint *min_index, GLuint *max_index)
 {
-   GLboolean found = GL_FALSE;
-   struct minmax_cache_key key;
-   uint32_t hash;
-   struct hash_entry *result;
+   struct util_index_range_query query;
+   struct util_index_range_tree *tree;
+   GLboolean found = GL_TRUE;
+   unsigned rebuilt;
 
-   if (!bufferObj->MinMaxCache)
-      return GL_FALSE;
    if (!vbo_use_minmax_cache(bufferObj))
       return GL_FALSE;
 
    mtx_lock(&bufferObj->Mutex);
 
-   if (bufferObj->MinMaxCacheDirty) {
-      /* Disable the cache permanently for this BO if the number of hits
-       * is asymptotically less than the number of misses. This happens when
-       * applications use the BO for streaming.
-       *
-       * However, some initial optimism allows applications that interleave
-       * draw calls with glBufferSubData during warmup.
-       */
-      unsigned optimism = bufferObj->Size;
-      if (bufferObj->MinMaxCacheMissIndices > optimism &&
-          bufferObj->MinMaxCacheHitIndices < bufferObj->MinMaxCacheMissIndices - optimism) {
-         bufferObj->UsageHistory |= USAGE_DISABLE_MINMAX_CACHE;
-         vbo_delete_minmax_cache(bufferObj);
-         goto out_disable;
-      }
-
-      _mesa_hash_table_clear(bufferObj->MinMaxCache, vbo_minmax_cache_delete_entry);
-      bufferObj->MinMaxCacheDirty = false;
-      goto out_invalidate;
+   tree = bufferObj->MinMaxCache;
+   if (!tree) {
+      tree = util_index_range_create(bufferObj->Size,
+                                     _mesa_index_min_max);
+      bufferObj->MinMaxCache = tree;
    }
 
-   key.type = type;
-   key.offset = offset;
-   key.count = count;
-   hash = vbo_minmax_cache_hash(&key);
-   result = _mesa_hash_table_search_pre_hashed(bufferObj->MinMaxCache, hash, &key);
-   if (result) {
-      struct minmax_cache_entry *entry = result->data;
-      *min_index = entry->min;
-      *max_index = entry->max;
-      found = GL_TRUE;
+   if (!tree ||
+       !util_index_range_query_begin(tree, index_size, restart,
+                                     restartIndex, offset, count, &query)) {
+      mtx_unlock(&bufferObj->Mutex);
+      return GL_FALSE;
    }
 
-out_invalidate:
-   if (found) {
-      /* The hit counter saturates so that we don't accidently disable the
-       * cache in a long-running program.
-       */
-      unsigned new_hit_count = bufferObj->MinMaxCacheHitIndices + count;
+   /* Indices of blocks that have to be scanned again count as misses, the
+    * others as hits.  The hit counter saturates so that we don't
+    * accidentally disable the cache in a long-running program.
+    */
+   rebuilt = MIN2(query.num_stale * UTIL_INDEX_RANGE_BLOCK_SIZE / index_size,
+                  count);
+   if (rebuilt < count) {
+      unsigned new_hit_count =
+         bufferObj->MinMaxCacheHitIndices + (count - rebuilt);
 
       if (new_hit_count >= bufferObj->MinMaxCacheHitIndices)
          bufferObj->MinMaxCacheHitIndices = new_hit_count;
       else
          bufferObj->MinMaxCacheHitIndices = ~(unsigned)0;
-   } else {
-      bufferObj->MinMaxCacheMissIndices += count;
+   }
+   bufferObj->MinMaxCacheMissIndices += rebuilt;
+
+   /* Disable the cache permanently for this BO if the number of hits
+    * is asymptotically less than the number of misses. This happens when
+    * applications use the BO for streaming, in which case the blocks are
+    * rescanned for every draw.
+    *
+    * However, some initial optimism allows the first scan of every block,
+    * and applications that interleave draw calls with glBufferSubData
+    * during warmup.
+    */
+   if (bufferObj->MinMaxCacheMissIndices > bufferObj->Size &&
+       bufferObj->MinMaxCacheHitIndices <
+       bufferObj->MinMaxCacheMissIndices - bufferObj->Size) {
+      bufferObj->UsageHistory |= USAGE_DISABLE_MINMAX_CACHE;
+      util_index_range_destroy(tree);
+      bufferObj->MinMaxCache = NULL;
+      tree = NULL;
    }
 
-out_disable:
    mtx_unlock(&bufferObj->Mutex);
-   return found;
-}
-
 
-static void
-vbo_minmax_cache_store(struct gl_context *ctx,
-                       struct gl_buffer_object *bufferObj,
-                       GLenum type, GLintptr offset, GLuint count,
-                       GLuint min, GLuint max)
-{
-   struct minmax_cache_entry *entry;
-   struct hash_entry *table_entry;
-   uint32_t hash;
+   if (util_index_range_query_needs_data(&query)) {
+      const void *indices;
 
-   if (!vbo_use_minmax_cache(bufferObj))
-      return;
-
-   mtx_lock(&bufferObj->Mutex);
-
-   if (!bufferObj->MinMaxCache) {
-      bufferObj->MinMaxCache =
-         _mesa_hash_table_create(NULL,
-                                 (uint32_t (*)(const void *))vbo_minmax_cache_hash,
-                                 (bool (*)(const void *, const void *))vbo_minmax_cache_key_equal);
-      if (!bufferObj->MinMaxCache)
-         goto out;
+      indices = ctx->Driver.MapBufferRange(ctx, query.offset, query.size,
+                                           GL_MAP_READ_BIT, bufferObj,
+                                           MAP_INTERNAL);
+      if (indices) {
+         util_index_range_query_scan(&query, indices);
+         ctx->Driver.UnmapBuffer(ctx, bufferObj, MAP_INTERNAL);
+      } else {
+         found = GL_FALSE;
+      }
    }
 
-   entry = MALLOC_STRUCT(minmax_cache_entry);
-   if (!entry)
-      goto out;
-
-   entry->key.offset = offset;
-   entry->key.count = count;
-   entry->key.type = type;
-   entry->min = min;
-   entry->max = max;
-   hash = vbo_minmax_cache_hash(&entry->key);
-
-   table_entry = _mesa_hash_table_search_pre_hashed(bufferObj->MinMaxCache,
-                                                    hash, &entry->key);
-   if (table_entry) {
-      /* It seems like this could happen when two contexts are rendering using
-       * the same buffer object from multiple threads.
+   if (query.num_stale && tree) {
+      /* The tree may have been replaced or invalidated meanwhile, in which
+       * case the bounds that were read aren't stored.  A replacement never
+       * has the generation the query began with, even if it got the old
+       * tree's address.
        */
-      _mesa_debug(ctx, "duplicate entry in minmax cache\n");
-      free(entry);
-      goto out;
+      mtx_lock(&bufferObj->Mutex);
+      util_index_range_query_end(bufferObj->MinMaxCache, &query);
+      mtx_unlock(&bufferObj->Mutex);
+   } else {
+      util_index_range_query_end(NULL, &query);
    }
 
-   table_entry = _mesa_hash_table_insert_pre_hashed(bufferObj->MinMaxCache,
-                                                    hash, &entry->key, entry);
-   if (!table_entry)
-      free(entry);
+   if (found) {
+      *min_index = query.min;
+      *max_index = query.max;
+   }
 
-out:
-   mtx_unlock(&bufferObj->Mutex);
+   return found;
 }
 
 
@@ -243,13 +209,13 @@ vbo_get_minmax_index(struct gl_context *ctx,
    const GLuint restartIndex = _mesa_primitive_restart_index(ctx, ib->type);
    const int index_size = vbo_sizeof_ib_type(ib->type);
    const char *indices;
-   GLuint i;
 
    indices = (char *) ib->ptr + prim->start * index_size;
    if (_mesa_is_bufferobj(ib->obj)) {
       GLsizeiptr size = MIN2(count * index_size, ib->obj->Size);
 
-      if (vbo_get_minmax_cached(ib->obj, ib->type, (GLintptr) indices, count,
+      if (vbo_get_minmax_cached(ctx, ib->obj, index_size, (GLintptr) indices,
+                                count, restart, restartIndex,
                                 min_index, max_index))
          return;
 
@@ -258,88 +224,11 @@ vbo_get_minmax_index(struct gl_context *ctx,
                                            MAP_INTERNAL);
    }
 
-   switch (ib->type) {
-   case GL_UNSIGNED_INT: {
-      const GLuint *ui_indices = (const GLuint *)indices;
-      GLuint max_ui = 0;
-      GLuint min_ui = ~0U;
-      if (restart) {
-         for (i = 0; i < count; i++) {
-            if (ui_indices[i] != restartIndex) {
-               if (ui_indices[i] > max_ui) max_ui = ui_indices[i];
-               if (ui_indices[i] < min_ui) min_ui = ui_indices[i];
-            }
-         }
-      }
-      else {
-#if defined(USE_SSE41)
-         if (cpu_has_sse4_1) {
-            _mesa_uint_array_min_max(ui_indices, &min_ui, &max_ui, count);
-         }
-         else
-#endif
-            for (i = 0; i < count; i++) {
-               if (ui_indices[i] > max_ui) max_ui = ui_indices[i];
-               if (ui_indices[i] < min_ui) min_ui = ui_indices[i];
-            }
-      }
-      *min_index = min_ui;
-      *max_index = max_ui;
-      break;
-   }
-   case GL_UNSIGNED_SHORT: {
-      const GLushort *us_indices = (const GLushort *)indices;
-      GLuint max_us = 0;
-      GLuint min_us = ~0U;
-      if (restart) {
-         for (i = 0; i < count; i++) {
-            if (us_indices[i] != restartIndex) {
-               if (us_indices[i] > max_us) max_us = us_indices[i];
-               if (us_indices[i] < min_us) min_us = us_indices[i];
-            }
-         }
-      }
-      else {
-         for (i = 0; i < count; i++) {
-            if (us_indices[i] > max_us) max_us = us_indices[i];
-            if (us_indices[i] < min_us) min_us = us_indices[i];
-         }
-      }
-      *min_index = min_us;
-      *max_index = max_us;
-      break;
-   }
-   case GL_UNSIGNED_BYTE: {
-      const GLubyte *ub_indices = (const GLubyte *)indices;
-      GLuint max_ub = 0;
-      GLuint min_ub = ~0U;
-      if (restart) {
-         for (i = 0; i < count; i++) {
-            if (ub_indices[i] != restartIndex) {
-               if (ub_indices[i] > max_ub) max_ub = ub_indices[i];
-               if (ub_indices[i] < min_ub) min_ub = ub_indices[i];
-            }
-         }
-      }
-      else {
-         for (i = 0; i < count; i++) {
-            if (ub_indices[i] > max_ub) max_ub = ub_indices[i];
-            if (ub_indices[i] < min_ub) min_ub = ub_indices[i];
-         }
-      }
-      *min_index = min_ub;
-      *max_index = max_ub;
-      break;
-   }
-   default:
-      unreachable("not reached");
-   }
+   _mesa_index_min_max(indices, index_size, count, restart, restartIndex,
+                       min_index, max_index);
 
-   if (_mesa_is_bufferobj(ib->obj)) {
-      vbo_minmax_cache_store(ctx, ib->obj, ib->type, prim->start, count,
-                             *min_index, *max_index);
+   if (_mesa_is_bufferobj(ib->obj))
       ctx->Driver.UnmapBuffer(ctx, ib->obj, MAP_INTERNAL);
-   }
 }
 
 /**
@@ -29,6 +29,7 @@
  */
 
 #include "main/imports.h"
+#include "main/index_scan.h"
 #include "main/bufferobj.h"
 #include "main/macros.h"
 #include "main/varray.h"
@@ -36,9 +37,6 @@
 #include "vbo.h"
 #include "vbo_context.h"
 
-#define UPDATE_MIN2(a, b) (a) = MIN2((a), (b))
-#define UPDATE_MAX2(a, b) (a) = MAX2((a), (b))
-
 /*
  * Notes on primitive restart:
  * The code below is used when the driver does not fully support primitive
@@ -82,9 +80,9 @@ find_sub_primitives(const void *elements, unsigned element_size,
                     unsigned *num_sub_prims)
 {
    const unsigned max_prims = end - start;
+   const char *bytes = elements;
    struct sub_primitive *sub_prims;
-   unsigned i, cur_start, cur_count;
-   GLuint scan_index;
+   unsigned i, count;
    unsigned scan_num;
 
    sub_prims =
@@ -95,58 +93,24 @@ find_sub_primitives(const void *elements, unsigned element_size,
       return NULL;
    }
 
-   cur_start = start;
-   cur_count = 0;
    scan_num = 0;
 
-#define IB_INDEX_READ(TYPE, INDEX) (((const GL##TYPE *) elements)[INDEX])
-
-#define SCAN_ELEMENTS(TYPE) \
-   sub_prims[scan_num].min_index = (GL##TYPE) 0xffffffff; \
-   sub_prims[scan_num].max_index = 0; \
-   for (i = start; i < end; i++) { \
-      scan_index = IB_INDEX_READ(TYPE, i); \
-      if (scan_index == restart_index) { \
-         if (cur_count > 0) { \
-            assert(scan_num < max_prims); \
-            sub_prims[scan_num].start = cur_start; \
-            sub_prims[scan_num].count = cur_count; \
-            scan_num++; \
-            sub_prims[scan_num].min_index = (GL##TYPE) 0xffffffff; \
-            sub_prims[scan_num].max_index = 0; \
-         } \
-         cur_start = i + 1; \
-         cur_count = 0; \
-      } \
-      else { \
-         UPDATE_MIN2(sub_prims[scan_num].min_index, scan_index); \
-         UPDATE_MAX2(sub_prims[scan_num].max_index, scan_index); \
-         cur_count++; \
-      } \
-   } \
-   if (cur_count > 0) { \
-      assert(scan_num < max_prims); \
-      sub_prims[scan_num].start = cur_start; \
-      sub_prims[scan_num].count = cur_count; \
-      scan_num++; \
-   }
-
-   switch (element_size) {
-   case 1:
-      SCAN_ELEMENTS(ubyte);
-      break;
-   case 2:
-      SCAN_ELEMENTS(ushort);
-      break;
-   case 4:
-      SCAN_ELEMENTS(uint);
-      break;
-   default:
-      assert(0 && "bad index_size in find_sub_primitives()");
+   for (i = start; i < end; i += count + 1) {
+      const void *cur = bytes + i * element_size;
+
+      /* The indices up to the next restart index form a sub-primitive. */
+      count = _mesa_index_find(cur, element_size, end - i, restart_index);
+      if (count > 0) {
+         assert(scan_num < max_prims);
+         sub_prims[scan_num].start = i;
+         sub_prims[scan_num].count = count;
+         _mesa_index_min_max(cur, element_size, count, false, 0,
+                             &sub_prims[scan_num].min_index,
+                             &sub_prims[scan_num].max_index);
+         scan_num++;
+      }
    }
 
-#undef SCAN_ELEMENTS
-
    *num_sub_prims = scan_num;
 
    return sub_prims;
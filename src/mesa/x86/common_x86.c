@@ -49,12 +49,24 @@
 #endif
 #if defined(USE_X86_64_ASM)
 #include <cpuid.h>
+#include <stdint.h>
 #if !defined(bit_SSE4_1) && defined(bit_SSE41)
 /* XXX: clang defines bit_SSE41 instead of bit_SSE4_1 */
 #define bit_SSE4_1 bit_SSE41
 #elif !defined(bit_SSE4_1) && !defined(bit_SSE41)
 #define bit_SSE4_1 0x00080000
 #endif
+
+/* Which register states the OS saves, XCR0. */
+static inline uint64_t
+xgetbv(void)
+{
+   uint32_t eax, edx;
+
+   __asm __volatile(".byte 0x0f, 0x01, 0xd0" /* xgetbv */
+                    : "=a" (eax), "=d" (edx) : "c" (0));
+   return ((uint64_t) edx << 32) | eax;
+}
 #endif
 
 #include "main/imports.h"
@@ -354,6 +366,16 @@ _mesa_get_x86_features(void)
 
       if (ecx & bit_SSE4_1)
          _mesa_x86_cpu_features |= X86_FEATURE_SSE4_1;
+
+      /* AVX2 also needs the OS to save the YMM registers. */
+      if ((ecx & (X86_CPU_OSXSAVE | X86_CPU_AVX)) ==
+          (X86_CPU_OSXSAVE | X86_CPU_AVX) &&
+          (xgetbv() & 6) == 6 &&
+          __get_cpuid_max(0, NULL) >= 7) {
+         __cpuid_count(7, 0, eax, ebx, ecx, edx);
+         if (ebx & X86_CPU_AVX2)
+            _mesa_x86_cpu_features |= X86_FEATURE_AVX2;
+      }
    }
 #endif /* USE_X86_64_ASM */
 
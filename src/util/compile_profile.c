@@ -0,0 +1,393 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c11/threads.h"
+#include "compile_profile.h"
+#include "hash_table.h"
+#include "ralloc.h"
+#include "u_timer.h"
+
+/** Time spent in one pass, for a shader or for the whole process */
+struct profile_entry {
+   const char *category;
+   const char *name;
+   unsigned calls;
+   unsigned progress;
+   int64_t time;
+};
+
+struct profile_shader {
+   char *name;
+   unsigned count;
+   int64_t start;
+   int64_t time;
+
+   /** Pass name -> struct profile_entry */
+   struct hash_table *passes;
+};
+
+struct profile_thread {
+   /** Nesting of compile_profile_shader_begin() */
+   unsigned depth;
+
+   /** The record being gathered while depth > 0, NULL if it is not needed */
+   struct profile_shader *shader;
+};
+
+static struct {
+   once_flag once;
+   bool enabled;
+   const char *path;
+   tss_t thread;
+
+   mtx_t mutex;
+   void *mem_ctx;
+   struct hash_table *passes;
+   struct hash_table *shaders;
+} profile = { ONCE_FLAG_INIT };
+
+static struct hash_table *
+create_entry_table(void *mem_ctx)
+{
+   return _mesa_hash_table_create(mem_ctx, _mesa_key_hash_string,
+                                  _mesa_key_string_equal);
+}
+
+static struct profile_entry *
+get_entry(struct hash_table *table, const char *category, const char *name)
+{
+   struct hash_entry *entry = _mesa_hash_table_search(table, name);
+   if (entry)
+      return entry->data;
+
+   struct profile_entry *e = rzalloc(table, struct profile_entry);
+   e->category = category;
+   e->name = name;
+   _mesa_hash_table_insert(table, name, e);
+   return e;
+}
+
+static void
+add_entry(struct hash_table *table, const struct profile_entry *add)
+{
+   struct profile_entry *e = get_entry(table, add->category, add->name);
+
+   e->calls += add->calls;
+   e->progress += add->progress;
+   e->time += add->time;
+}
+
+static void
+write_string(FILE *f, const char *s)
+{
+   fputc('"', f);
+   for (; *s; s++) {
+      if (*s == '"' || *s == '\\')
+         fprintf(f, "\\%c", *s);
+      else if ((unsigned char) *s < 0x20)
+         fprintf(f, "\\u%04x", *s);
+      else
+         fputc(*s, f);
+   }
+   fputc('"', f);
+}
+
+static int
+compare_entry_time(const void *a, const void *b)
+{
+   const struct profile_entry *ea = *(const struct profile_entry **) a;
+   const struct profile_entry *eb = *(const struct profile_entry **) b;
+
+   if (ea->time != eb->time)
+      return ea->time < eb->time ? 1 : -1;
+   return strcmp(ea->name, eb->name);
+}
+
+static int
+compare_shader_time(const void *a, const void *b)
+{
+   const struct profile_shader *sa = *(const struct profile_shader **) a;
+   const struct profile_shader *sb = *(const struct profile_shader **) b;
+
+   if (sa->time != sb->time)
+      return sa->time < sb->time ? 1 : -1;
+   return strcmp(sa->name, sb->name);
+}
+
+/** Returns the data of the table, sorted with \p compare */
+static void **
+sorted_entries(struct hash_table *table,
+               int (*compare)(const void *, const void *))
+{
+   void **array = ralloc_array(NULL, void *, table->entries);
+   unsigned count = 0;
+
+   struct hash_entry *entry;
+   hash_table_foreach(table, entry)
+      array[count++] = entry->data;
+
+   qsort(array, count, sizeof(*array), compare);
+   return array;
+}
+
+static void
+write_passes(FILE *f, struct hash_table *passes, const char *indent)
+{
+   struct profile_entry **sorted =
+      (struct profile_entry **) sorted_entries(passes, compare_entry_time);
+
+   fprintf(f, "[");
+   for (unsigned i = 0; i < passes->entries; i++) {
+      const struct profile_entry *e = sorted[i];
+
+      fprintf(f, "%s\n%s  { \"category\": ", i ? "," : "", indent);
+      write_string(f, e->category);
+      fprintf(f, ", \"name\": ");
+      write_string(f, e->name);
+      fprintf(f, ", \"calls\": %u, \"progress\": %u, \"time_ms\": %.6f }",
+              e->calls, e->progress, e->time / 1000000.0);
+   }
+   fprintf(f, "\n%s]", indent);
+
+   ralloc_free(sorted);
+}
+
+static void
+profile_write(void)
+{
+   mtx_lock(&profile.mutex);
+
+   FILE *f = fopen(profile.path, "w");
+   if (f == NULL) {
+      fprintf(stderr, "MESA_COMPILE_PROFILE: couldn't open %s\n",
+              profile.path);
+      mtx_unlock(&profile.mutex);
+      return;
+   }
+
+   int64_t total = 0;
+   struct hash_entry *entry;
+   hash_table_foreach(profile.shaders, entry)
+      total += ((struct profile_shader *) entry->data)->time;
+
+   fprintf(f, "{\n  \"shader_time_ms\": %.6f,\n  \"passes\": ",
+           total / 1000000.0);
+   write_passes(f, profile.passes, "  ");
+
+   struct profile_shader **sorted = (struct profile_shader **)
+      sorted_entries(profile.shaders, compare_shader_time);
+
+   fprintf(f, ",\n  \"shaders\": [");
+   for (unsigned i = 0; i < profile.shaders->entries; i++) {
+      const struct profile_shader *s = sorted[i];
+
+      fprintf(f, "%s\n    {\n      \"name\": ", i ? "," : "");
+      write_string(f, s->name);
+      fprintf(f, ",\n      \"count\": %u,\n      \"time_ms\": %.6f,\n"
+              "      \"passes\": ", s->count, s->time / 1000000.0);
+      write_passes(f, s->passes, "      ");
+      fprintf(f, "\n    }");
+   }
+   fprintf(f, "\n  ]\n}\n");
+
+   ralloc_free(sorted);
+   fclose(f);
+
+   mtx_unlock(&profile.mutex);
+}
+
+static void
+free_thread(void *data)
+{
+   struct profile_thread *thread = data;
+
+   if (thread)
+      ralloc_free(thread->shader);
+   free(thread);
+}
+
+static void
+profile_init(void)
+{
+   profile.path = getenv("MESA_COMPILE_PROFILE");
+   if (profile.path == NULL || profile.path[0] == '\0')
+      return;
+
+   if (tss_create(&profile.thread, free_thread) != thrd_success)
+      return;
+
+   mtx_init(&profile.mutex, mtx_plain);
+   profile.mem_ctx = ralloc_context(NULL);
+   profile.passes = create_entry_table(profile.mem_ctx);
+   profile.shaders = _mesa_hash_table_create(profile.mem_ctx,
+                                             _mesa_key_hash_string,
+                                             _mesa_key_string_equal);
+   profile.enabled = true;
+
+   atexit(profile_write);
+}
+
+bool
+compile_profile_enabled(void)
+{
+   call_once(&profile.once, profile_init);
+   return profile.enabled;
+}
+
+static struct profile_thread *
+get_thread(void)
+{
+   struct profile_thread *thread = tss_get(profile.thread);
+
+   if (thread == NULL) {
+      thread = calloc(1, sizeof(*thread));
+      if (thread == NULL)
+         return NULL;
+      tss_set(profile.thread, thread);
+   }
+
+   return thread;
+}
+
+void
+compile_profile_shader_vbegin(const char *format, va_list args)
+{
+   if (!compile_profile_enabled())
+      return;
+
+   struct profile_thread *thread = get_thread();
+   if (thread == NULL || thread->depth++ > 0)
+      return;
+
+   struct profile_shader *shader = rzalloc(NULL, struct profile_shader);
+   if (shader == NULL)
+      return;
+
+   shader->name = ralloc_vasprintf(shader, format, args);
+   shader->count = 1;
+   shader->passes = create_entry_table(shader);
+   shader->start = util_timer_get_nano();
+   thread->shader = shader;
+}
+
+void
+compile_profile_shader_begin(const char *format, ...)
+{
+   va_list args;
+
+   va_start(args, format);
+   compile_profile_shader_vbegin(format, args);
+   va_end(args);
+}
+
+void
+compile_profile_shader_end(void)
+{
+   if (!compile_profile_enabled())
+      return;
+
+   struct profile_thread *thread = get_thread();
+   if (thread == NULL || thread->depth == 0 || --thread->depth > 0)
+      return;
+
+   struct profile_shader *shader = thread->shader;
+   thread->shader = NULL;
+   if (shader == NULL)
+      return;
+
+   shader->time = util_timer_get_nano() - shader->start;
+
+   mtx_lock(&profile.mutex);
+
+   struct hash_entry *entry;
+   hash_table_foreach(shader->passes, entry)
+      add_entry(profile.passes, entry->data);
+
+   /* Shaders compiled more than once, such as back end variants, are
+    * reported once with their total time.
+    */
+   entry = _mesa_hash_table_search(profile.shaders, shader->name);
+   if (entry) {
+      struct profile_shader *total = entry->data;
+
+      total->count++;
+      total->time += shader->time;
+      hash_table_foreach(shader->passes, entry)
+         add_entry(total->passes, entry->data);
+
+      ralloc_free(shader);
+   } else {
+      ralloc_steal(profile.mem_ctx, shader);
+      _mesa_hash_table_insert(profile.shaders, shader->name, shader);
+   }
+
+   mtx_unlock(&profile.mutex);
+}
+
+void
+compile_profile_add(const char *category, const char *name,
+                    int64_t time, bool progress)
+{
+   if (!compile_profile_enabled())
+      return;
+
+   struct profile_entry add = { category, name, 1, progress, time };
+   struct profile_thread *thread = get_thread();
+
+   /* The process totals get the passes of a shader when it ends */
+   if (thread && thread->shader) {
+      add_entry(thread->shader->passes, &add);
+   } else {
+      mtx_lock(&profile.mutex);
+      add_entry(profile.passes, &add);
+      mtx_unlock(&profile.mutex);
+   }
+}
+
+void
+compile_profile_begin(struct compile_profile_timer *timer,
+                      const char *category, const char *name)
+{
+   if (!compile_profile_enabled()) {
+      timer->name = NULL;
+      return;
+   }
+
+   timer->category = category;
+   timer->name = name;
+   timer->start = util_timer_get_nano();
+}
+
+void
+compile_profile_end(struct compile_profile_timer *timer, bool progress)
+{
+   if (timer->name == NULL)
+      return;
+
+   compile_profile_add(timer->category, timer->name,
+                       util_timer_get_nano() - timer->start, progress);
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file compile_profile.h
+ *
+ * Built-in profiling of the shader compilers.
+ *
+ * When the MESA_COMPILE_PROFILE environment variable names a file, the
+ * compilers time their passes and stages, and a JSON report is written to
+ * that file at exit.  The report has the totals for the whole process and
+ * for each shader.  Otherwise the calls below return right away.
+ *
+ * A shader is whatever runs between the outermost
+ * compile_profile_shader_begin() and compile_profile_shader_end() on a
+ * thread: a GLSL compile, a link, or a back end compile triggered by a
+ * state change.  Times are inclusive, so a pass run from a stage counts in
+ * both.
+ */
+
+#ifndef COMPILE_PROFILE_H
+#define COMPILE_PROFILE_H
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "util/macros.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct compile_profile_timer {
+   const char *category;
+   const char *name;
+   int64_t start;
+};
+
+bool compile_profile_enabled(void);
+
+void compile_profile_shader_begin(const char *format, ...) PRINTFLIKE(1, 2);
+void compile_profile_shader_vbegin(const char *format, va_list args);
+void compile_profile_shader_end(void);
+
+/**
+ * Times a pass or stage.  \p category names the compiler, such as "glsl" or
+ * "nir", and \p name the pass.  Both must outlive the process, which
+ * string literals do.
+ */
+void compile_profile_begin(struct compile_profile_timer *timer,
+                           const char *category, const char *name);
+void compile_profile_end(struct compile_profile_timer *timer, bool progress);
+
+/** Adds a pass run that the caller already timed, in nanoseconds. */
+void compile_profile_add(const char *category, const char *name,
+                         int64_t time, bool progress);
+
+#ifdef __cplusplus
+}
+
+/** Times the rest of the enclosing C++ scope. */
+class compile_profile_scope {
+public:
+   compile_profile_scope(const char *category, const char *name)
+   {
+      compile_profile_begin(&timer, category, name);
+   }
+
+   ~compile_profile_scope()
+   {
+      compile_profile_end(&timer, false);
+   }
+
+private:
+   struct compile_profile_timer timer;
+};
+
+/** Makes the rest of the enclosing C++ scope a shader, unless it is in one. */
+class compile_profile_shader_scope {
+public:
+   compile_profile_shader_scope(const char *format, ...) PRINTFLIKE(2, 3)
+   {
+      va_list args;
+      va_start(args, format);
+      compile_profile_shader_vbegin(format, args);
+      va_end(args);
+   }
+
+   ~compile_profile_shader_scope()
+   {
+      compile_profile_shader_end();
+   }
+};
+#endif
+
+#endif /* COMPILE_PROFILE_H */
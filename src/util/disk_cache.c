@@ -0,0 +1,591 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "disk_cache.h"
+
+#ifndef _WIN32
+
+#include <ctype.h>
+#include <dirent.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pwd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "util/ralloc.h"
+#include "util/u_atomic.h"
+
+/* "MESA" followed by the format version, to catch stale or foreign files */
+#define CACHE_FILE_MAGIC 0x4d455341
+#define CACHE_FILE_VERSION 1
+
+struct cache_entry_header {
+   uint32_t magic;
+   uint32_t version;
+   uint64_t size;
+};
+
+struct disk_cache {
+   /* Root directory of this cache */
+   char *path;
+
+   /* Estimate of the total size of the files in the cache */
+   uint64_t size;
+
+   uint64_t max_size;
+};
+
+
+/**
+ * Create the directory \p path and all its missing parents.
+ */
+static bool
+mkdir_recursive(char *path)
+{
+   struct stat sb;
+   char *p;
+
+   if (stat(path, &sb) == 0)
+      return S_ISDIR(sb.st_mode);
+
+   for (p = path + 1; *p; p++) {
+      if (*p != '/')
+         continue;
+
+      *p = '\0';
+      if (mkdir(path, 0755) != 0 && errno != EEXIST) {
+         *p = '/';
+         return false;
+      }
+      *p = '/';
+   }
+
+   return mkdir(path, 0755) == 0 || errno == EEXIST;
+}
+
+
+static char *
+get_cache_root(void *mem_ctx)
+{
+   const char *path;
+   struct passwd pwd, *result;
+   char buf[1024];
+
+   path = getenv("MESA_SHADER_CACHE_DIR");
+   if (path)
+      return ralloc_strdup(mem_ctx, path);
+
+   path = getenv("XDG_CACHE_HOME");
+   if (path)
+      return ralloc_asprintf(mem_ctx, "%s/mesa", path);
+
+   path = getenv("HOME");
+   if (!path) {
+      if (getpwuid_r(getuid(), &pwd, buf, sizeof buf, &result) != 0 ||
+          !result)
+         return NULL;
+      path = pwd.pw_dir;
+   }
+
+   return ralloc_asprintf(mem_ctx, "%s/.cache/mesa", path);
+}
+
+
+static uint64_t
+parse_size(const char *str, uint64_t default_size)
+{
+   char *end;
+   uint64_t size;
+
+   if (!str)
+      return default_size;
+
+   size = strtoull(str, &end, 10);
+   if (end == str)
+      return default_size;
+
+   while (isspace((unsigned char) *end))
+      end++;
+
+   switch (*end) {
+   case 'G':
+   case 'g':
+      size *= 1024;
+      /* fallthrough */
+   case 'M':
+   case 'm':
+      size *= 1024;
+      /* fallthrough */
+   case 'K':
+   case 'k':
+      size *= 1024;
+      break;
+   default:
+      break;
+   }
+
+   return size;
+}
+
+
+/**
+ * Sum the size of all regular files in a directory.
+ */
+static uint64_t
+directory_size(const char *path)
+{
+   DIR *dir;
+   struct dirent *entry;
+   uint64_t size = 0;
+
+   dir = opendir(path);
+   if (!dir)
+      return 0;
+
+   while ((entry = readdir(dir)) != NULL) {
+      char *file;
+      struct stat sb;
+
+      if (entry->d_name[0] == '.')
+         continue;
+
+      file = ralloc_asprintf(NULL, "%s/%s", path, entry->d_name);
+      if (stat(file, &sb) == 0 && S_ISREG(sb.st_mode))
+         size += sb.st_blocks * 512;
+      ralloc_free(file);
+   }
+
+   closedir(dir);
+
+   return size;
+}
+
+
+struct disk_cache *
+disk_cache_create(const char *name, uint64_t default_max_size)
+{
+   struct disk_cache *cache;
+   char *root;
+   unsigned i;
+
+   if (getenv("MESA_SHADER_CACHE_DISABLE"))
+      return NULL;
+
+   cache = rzalloc(NULL, struct disk_cache);
+   if (!cache)
+      return NULL;
+
+   root = get_cache_root(cache);
+   if (!root)
+      goto fail;
+
+   cache->path = ralloc_asprintf(cache, "%s/%s", root, name);
+   if (!cache->path || !mkdir_recursive(cache->path))
+      goto fail;
+
+   cache->max_size = parse_size(getenv("MESA_SHADER_CACHE_MAX_SIZE"),
+                                default_max_size);
+
+   for (i = 0; i < 256; i++) {
+      char *dir = ralloc_asprintf(cache, "%s/%02x", cache->path, i);
+      cache->size += directory_size(dir);
+      ralloc_free(dir);
+   }
+
+   return cache;
+
+fail:
+   ralloc_free(cache);
+   return NULL;
+}
+
+
+void
+disk_cache_destroy(struct disk_cache *cache)
+{
+   ralloc_free(cache);
+}
+
+
+/**
+ * Entries are stored as <path>/<first byte of key>/<rest of key>, in
+ * hexadecimal, to avoid huge directories.
+ */
+static char *
+get_cache_file(struct disk_cache *cache, const cache_key key)
+{
+   static const char hex_digits[] = "0123456789abcdef";
+   char buf[2 * CACHE_KEY_SIZE + 1];
+   unsigned i;
+
+   for (i = 0; i < CACHE_KEY_SIZE; i++) {
+      buf[2 * i] = hex_digits[key[i] >> 4];
+      buf[2 * i + 1] = hex_digits[key[i] & 0x0f];
+   }
+   buf[2 * CACHE_KEY_SIZE] = '\0';
+
+   /* Not parented to the cache, as ralloc contexts aren't thread-safe */
+   return ralloc_asprintf(NULL, "%s/%c%c/%s",
+                          cache->path, buf[0], buf[1], buf + 2);
+}
+
+
+/**
+ * Evict the least recently accessed file of the directory \p dir_path.
+ * \return  false if the directory has no entries.
+ */
+static bool
+evict_lru_entry(struct disk_cache *cache, const char *dir_path)
+{
+   char *lru_path = NULL;
+   time_t lru_atime = 0;
+   off_t lru_size = 0;
+   struct dirent *entry;
+   DIR *dir;
+
+   dir = opendir(dir_path);
+   if (!dir)
+      return false;
+
+   while ((entry = readdir(dir)) != NULL) {
+      char *file;
+      struct stat sb;
+
+      if (entry->d_name[0] == '.')
+         continue;
+
+      file = ralloc_asprintf(NULL, "%s/%s", dir_path, entry->d_name);
+      if (stat(file, &sb) == 0 && S_ISREG(sb.st_mode) &&
+          (!lru_path || sb.st_atime < lru_atime)) {
+         ralloc_free(lru_path);
+         lru_path = file;
+         lru_atime = sb.st_atime;
+         lru_size = sb.st_blocks * 512;
+      }
+      else {
+         ralloc_free(file);
+      }
+   }
+
+   closedir(dir);
+
+   if (!lru_path)
+      return false;
+
+   if (unlink(lru_path) == 0)
+      p_atomic_add(&cache->size, -(int64_t) lru_size);
+
+   ralloc_free(lru_path);
+   return true;
+}
+
+
+/**
+ * Evict an entry from a random subdirectory, so that we don't need to keep
+ * a global LRU index which would have to be shared between processes.
+ */
+static void
+evict_random_entry(struct disk_cache *cache)
+{
+   unsigned start = rand() % 256;
+   unsigned i;
+
+   for (i = 0; i < 256; i++) {
+      char *dir_path = ralloc_asprintf(NULL, "%s/%02x", cache->path,
+                                       (start + i) % 256);
+      bool evicted = evict_lru_entry(cache, dir_path);
+
+      ralloc_free(dir_path);
+      if (evicted)
+         return;
+   }
+
+   /* Nothing left to evict, our size estimate must be stale */
+   cache->size = 0;
+}
+
+
+static bool
+write_all(int fd, const void *data, size_t size)
+{
+   const char *p = data;
+
+   while (size) {
+      ssize_t ret = write(fd, p, size);
+      if (ret < 0) {
+         if (errno == EINTR)
+            continue;
+         return false;
+      }
+      p += ret;
+      size -= ret;
+   }
+
+   return true;
+}
+
+
+static bool
+read_all(int fd, void *data, size_t size)
+{
+   char *p = data;
+
+   while (size) {
+      ssize_t ret = read(fd, p, size);
+      if (ret < 0) {
+         if (errno == EINTR)
+            continue;
+         return false;
+      }
+      if (ret == 0)
+         return false;
+      p += ret;
+      size -= ret;
+   }
+
+   return true;
+}
+
+
+void
+disk_cache_put(struct disk_cache *cache, const cache_key key,
+               const void *data, size_t size)
+{
+   struct cache_entry_header header;
+   char *filename, *tmp, *dir;
+   struct stat sb;
+   int fd;
+   unsigned tries;
+
+   if (!cache)
+      return;
+
+   /* Don't let a single entry flush the whole cache */
+   if (size + sizeof header > cache->max_size / 4)
+      return;
+
+   /* Make room first, so that we never evict the entry being added */
+   for (tries = 0; cache->size + size > cache->max_size && tries < 16; tries++)
+      evict_random_entry(cache);
+
+   filename = get_cache_file(cache, key);
+
+   dir = ralloc_strdup(filename, filename);
+   *strrchr(dir, '/') = '\0';
+   if (!mkdir_recursive(dir))
+      goto out;
+
+   /*
+    * Write to a temporary file first and rename it into place, so that
+    * readers never see partially written entries.  If another process is
+    * writing the same entry right now, just let it do the work.
+    */
+   tmp = ralloc_asprintf(filename, "%s.%d.tmp", filename, (int) getpid());
+   fd = open(tmp, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+   if (fd < 0)
+      goto out;
+
+   header.magic = CACHE_FILE_MAGIC;
+   header.version = CACHE_FILE_VERSION;
+   header.size = size;
+
+   if (!write_all(fd, &header, sizeof header) ||
+       !write_all(fd, data, size) ||
+       fstat(fd, &sb) != 0) {
+      close(fd);
+      unlink(tmp);
+      goto out;
+   }
+   close(fd);
+
+   if (rename(tmp, filename) != 0) {
+      unlink(tmp);
+      goto out;
+   }
+
+   p_atomic_add(&cache->size, (int64_t) sb.st_blocks * 512);
+
+out:
+   ralloc_free(filename);
+}
+
+
+void *
+disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
+{
+   struct cache_entry_header header;
+   char *filename;
+   void *data = NULL;
+   struct stat sb;
+   int fd;
+
+   if (size)
+      *size = 0;
+
+   if (!cache)
+      return NULL;
+
+   filename = get_cache_file(cache, key);
+
+   fd = open(filename, O_RDONLY | O_CLOEXEC);
+   if (fd < 0)
+      goto out;
+
+   if (fstat(fd, &sb) != 0 ||
+       !read_all(fd, &header, sizeof header) ||
+       header.magic != CACHE_FILE_MAGIC ||
+       header.version != CACHE_FILE_VERSION ||
+       header.size + sizeof header != (uint64_t) sb.st_size)
+      goto fail;
+
+   data = malloc(header.size);
+   if (!data)
+      goto fail;
+
+   if (!read_all(fd, data, header.size)) {
+      free(data);
+      data = NULL;
+      goto fail;
+   }
+
+   if (size)
+      *size = header.size;
+
+   close(fd);
+   goto out;
+
+fail:
+   close(fd);
+   /* Drop corrupt or truncated entries so they get regenerated */
+   if (!data)
+      unlink(filename);
+out:
+   ralloc_free(filename);
+   return data;
+}
+
+
+void
+disk_cache_remove(struct disk_cache *cache, const cache_key key)
+{
+   char *filename;
+   struct stat sb;
+
+   if (!cache)
+      return;
+
+   filename = get_cache_file(cache, key);
+
+   if (stat(filename, &sb) == 0 && unlink(filename) == 0)
+      p_atomic_add(&cache->size, -(int64_t) sb.st_blocks * 512);
+
+   ralloc_free(filename);
+}
+
+
+bool
+disk_cache_has_key(struct disk_cache *cache, const cache_key key)
+{
+   char *filename;
+   bool found;
+
+   if (!cache)
+      return false;
+
+   filename = get_cache_file(cache, key);
+   found = access(filename, F_OK) == 0;
+   ralloc_free(filename);
+
+   return found;
+}
+
+
+bool
+disk_cache_get_function_timestamp(void *ptr, uint32_t *timestamp)
+{
+   Dl_info info;
+   struct stat st;
+
+   if (!dladdr(ptr, &info) || !info.dli_fname)
+      return false;
+
+   if (stat(info.dli_fname, &st) != 0)
+      return false;
+
+   *timestamp = st.st_mtime;
+   return true;
+}
+
+#else /* _WIN32 */
+
+struct disk_cache *
+disk_cache_create(const char *name, uint64_t default_max_size)
+{
+   return NULL;
+}
+
+void
+disk_cache_destroy(struct disk_cache *cache)
+{
+}
+
+void
+disk_cache_put(struct disk_cache *cache, const cache_key key,
+               const void *data, size_t size)
+{
+}
+
+void *
+disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
+{
+   if (size)
+      *size = 0;
+   return NULL;
+}
+
+void
+disk_cache_remove(struct disk_cache *cache, const cache_key key)
+{
+}
+
+bool
+disk_cache_has_key(struct disk_cache *cache, const cache_key key)
+{
+   return false;
+}
+
+bool
+disk_cache_get_function_timestamp(void *ptr, uint32_t *timestamp)
+{
+   return false;
+}
+
+#endif /* _WIN32 */
@@ -0,0 +1,117 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file disk_cache.h
+ *
+ * A persistent cache of compiled shader binaries, stored as one file per
+ * entry under a per-user directory and addressed by a SHA-1 key.
+ *
+ * The cache directory is, in order of preference:
+ *
+ *   $MESA_SHADER_CACHE_DIR/<name>
+ *   $XDG_CACHE_HOME/mesa/<name>
+ *   <home directory>/.cache/mesa/<name>
+ *
+ * Setting MESA_SHADER_CACHE_DISABLE disables all caches, and
+ * MESA_SHADER_CACHE_MAX_SIZE (a number with an optional K, M or G suffix)
+ * overrides the maximum size of each cache.  When a cache grows beyond its
+ * maximum size, the least recently used entries of a random subdirectory
+ * are evicted.
+ *
+ * All functions are thread-safe, and several processes may share the same
+ * cache directory.
+ */
+
+#ifndef DISK_CACHE_H
+#define DISK_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CACHE_KEY_SIZE 20
+
+typedef uint8_t cache_key[CACHE_KEY_SIZE];
+
+struct disk_cache;
+
+/**
+ * Create a new cache object stored in the \p name subdirectory of the
+ * shader cache directory.
+ *
+ * \return  NULL if the cache is disabled or cannot be created.
+ */
+struct disk_cache *
+disk_cache_create(const char *name, uint64_t default_max_size);
+
+void
+disk_cache_destroy(struct disk_cache *cache);
+
+/**
+ * Store \p size bytes of \p data under \p key, replacing any existing entry.
+ */
+void
+disk_cache_put(struct disk_cache *cache, const cache_key key,
+               const void *data, size_t size);
+
+/**
+ * Retrieve the entry stored under \p key.
+ *
+ * \return  a malloc'ed buffer the caller must free, or NULL on miss.
+ */
+void *
+disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size);
+
+/**
+ * Remove the entry stored under \p key, if any.
+ */
+void
+disk_cache_remove(struct disk_cache *cache, const cache_key key);
+
+/**
+ * Check whether an entry is stored under \p key, without reading it.
+ *
+ * This is cheap enough to be used for small "seen this before" markers.
+ */
+bool
+disk_cache_has_key(struct disk_cache *cache, const cache_key key);
+
+/**
+ * Get the modification time of the shared object containing \p ptr, so
+ * that rebuilding the driver invalidates keys derived from it.
+ *
+ * \return  false if it cannot be determined.
+ */
+bool
+disk_cache_get_function_timestamp(void *ptr, uint32_t *timestamp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DISK_CACHE_H */
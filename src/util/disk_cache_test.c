@@ -0,0 +1,124 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "disk_cache.h"
+
+static int error = 0;
+
+static void
+expect_true(bool value, const char *test)
+{
+   if (!value) {
+      fprintf(stderr, "Error: Test '%s' failed: Expected true\n", test);
+      error = 1;
+   }
+}
+
+static void
+make_key(cache_key key, unsigned seed)
+{
+   unsigned i;
+
+   for (i = 0; i < CACHE_KEY_SIZE; i++)
+      key[i] = (uint8_t) (seed * 31 + i * 7);
+}
+
+int
+main(void)
+{
+   char dir[] = "/tmp/disk_cache_test.XXXXXX";
+   struct disk_cache *cache;
+   cache_key key, other;
+   char blob[1000];
+   size_t size;
+   void *data;
+   unsigned i;
+
+   if (!mkdtemp(dir)) {
+      perror("mkdtemp");
+      return 1;
+   }
+
+   setenv("MESA_SHADER_CACHE_DIR", dir, 1);
+   setenv("MESA_SHADER_CACHE_MAX_SIZE", "64K", 1);
+   unsetenv("MESA_SHADER_CACHE_DISABLE");
+
+   cache = disk_cache_create("test", 0);
+   expect_true(cache != NULL, "disk_cache_create");
+   if (!cache)
+      return error;
+
+   make_key(key, 1);
+   make_key(other, 2);
+
+   data = disk_cache_get(cache, key, &size);
+   expect_true(data == NULL && size == 0, "disk_cache_get of missing key");
+
+   memset(blob, 0xa5, sizeof blob);
+   disk_cache_put(cache, key, blob, sizeof blob);
+
+   data = disk_cache_get(cache, key, &size);
+   expect_true(data != NULL && size == sizeof blob &&
+               memcmp(data, blob, size) == 0, "disk_cache_get after put");
+   free(data);
+
+   expect_true(disk_cache_has_key(cache, key), "disk_cache_has_key after put");
+
+   data = disk_cache_get(cache, other, &size);
+   expect_true(data == NULL, "disk_cache_get of other key");
+   expect_true(!disk_cache_has_key(cache, other),
+               "disk_cache_has_key of other key");
+
+   disk_cache_remove(cache, key);
+   data = disk_cache_get(cache, key, &size);
+   expect_true(data == NULL, "disk_cache_get after remove");
+   expect_true(!disk_cache_has_key(cache, key),
+               "disk_cache_has_key after remove");
+
+   /* Overflow the cache and check we stay within bounds */
+   for (i = 0; i < 1000; i++) {
+      make_key(key, i + 100);
+      disk_cache_put(cache, key, blob, sizeof blob);
+   }
+
+   disk_cache_destroy(cache);
+
+   /* A new cache object sees the entries left by the previous one */
+   cache = disk_cache_create("test", 0);
+   expect_true(cache != NULL, "disk_cache_create again");
+   data = disk_cache_get(cache, key, &size);
+   expect_true(data != NULL && size == sizeof blob, "disk_cache_get persists");
+   free(data);
+   disk_cache_destroy(cache);
+
+   setenv("MESA_SHADER_CACHE_DISABLE", "1", 1);
+   cache = disk_cache_create("test", 0);
+   expect_true(cache == NULL, "MESA_SHADER_CACHE_DISABLE");
+
+   return error;
+}
@@ -407,6 +407,129 @@ bool ralloc_asprintf_append (char **str, const char *fmt, ...)
 bool ralloc_vasprintf_append(char **str, const char *fmt, va_list args);
 /// @}
 
+/**
+ * \defgroup linear Linear Allocator
+ *
+ * A bump allocator for large numbers of small objects which all die at the
+ * same time, such as the nodes of a syntax tree.
+ *
+ * A linear parent is allocated out of a ralloc context and carves its
+ * children out of 2KB (or larger) buffers, which are ralloc children of that
+ * context.  There is no per-allocation header, parent/child linkage or
+ * malloc() call.  In exchange, children can't be freed, stolen, resized in
+ * place or used as ralloc contexts: everything goes away at once when the
+ * linear parent is freed with linear_free_parent(), or when its ralloc
+ * context is freed.  Destructors are never run.
+ *
+ * The linear parent is itself a pointer to \p size usable bytes, so it can
+ * double as the state of whatever owns the children.
+ * @{
+ */
+
+/**
+ * Allocate a linear parent, and \p size bytes for its own use, out of the
+ * given ralloc context.
+ */
+void *linear_alloc_parent(void *ralloc_ctx, unsigned size) MALLOCLIKE;
+
+/**
+ * Allocate \p size bytes out of the given linear parent.
+ */
+void *linear_alloc_child(void *parent, unsigned size) MALLOCLIKE;
+
+/**
+ * Same as linear_alloc_parent(), but the memory is zeroed.
+ */
+void *linear_zalloc_parent(void *ralloc_ctx, unsigned size) MALLOCLIKE;
+
+/**
+ * Same as linear_alloc_child(), but the memory is zeroed.
+ */
+void *linear_zalloc_child(void *parent, unsigned size) MALLOCLIKE;
+
+/**
+ * Free a linear parent and all of its children.
+ */
+void linear_free_parent(void *ptr);
+
+/**
+ * Move a linear parent and all of its children to another ralloc context.
+ */
+void ralloc_steal_linear_parent(void *new_ralloc_ctx, void *ptr);
+
+/**
+ * Return the ralloc context of a linear parent.
+ */
+void *ralloc_parent_of_linear_parent(void *ptr);
+
+/**
+ * Resize a child of a linear parent, preserving data.
+ *
+ * This always allocates a new child; the old one stays allocated until the
+ * parent is freed.
+ */
+void *linear_realloc(void *parent, void *old, unsigned new_size);
+
+/**
+ * \def linear_alloc_child_array(parent, size, count)
+ * Allocate an array out of a linear parent.
+ */
+#define linear_alloc_child_array(parent, size, count) \
+   linear_alloc_child(parent, (size) * (count))
+
+/**
+ * \def linear_zalloc_child_array(parent, size, count)
+ * Allocate a zeroed array out of a linear parent.
+ */
+#define linear_zalloc_child_array(parent, size, count) \
+   linear_zalloc_child(parent, (size) * (count))
+
+/**
+ * Duplicate a string, allocating the memory from the given linear parent.
+ */
+char *linear_strdup(void *parent, const char *str) MALLOCLIKE;
+
+/**
+ * Print to a string, allocating the memory from the given linear parent.
+ */
+char *linear_asprintf(void *parent, const char *fmt, ...) PRINTFLIKE(2, 3) MALLOCLIKE;
+
+/**
+ * Print to a string, given a va_list, allocating the memory from the given
+ * linear parent.
+ */
+char *linear_vasprintf(void *parent, const char *fmt, va_list args) MALLOCLIKE;
+
+/**
+ * Linear parent version of ralloc_asprintf_append().
+ */
+bool linear_asprintf_append(void *parent, char **str, const char *fmt, ...)
+			    PRINTFLIKE(3, 4);
+
+/**
+ * Linear parent version of ralloc_vasprintf_append().
+ */
+bool linear_vasprintf_append(void *parent, char **str, const char *fmt,
+			     va_list args);
+
+/**
+ * Linear parent version of ralloc_asprintf_rewrite_tail().
+ */
+bool linear_asprintf_rewrite_tail(void *parent, char **str, size_t *start,
+				  const char *fmt, ...) PRINTFLIKE(4, 5);
+
+/**
+ * Linear parent version of ralloc_vasprintf_rewrite_tail().
+ */
+bool linear_vasprintf_rewrite_tail(void *parent, char **str, size_t *start,
+				   const char *fmt, va_list args);
+
+/**
+ * Linear parent version of ralloc_strcat().
+ */
+bool linear_strcat(void *parent, char **dest, const char *str);
+/// @}
+
 #ifdef __cplusplus
 } /* end of extern "C" */
 #endif
@@ -448,5 +571,35 @@ public:                                                                  \
       ralloc_free(p);                                                    \
    }
 
+/**
+ * Declare C++ new and delete operators which use the linear allocator.
+ *
+ * Placing this macro in the body of a class makes it possible to do:
+ *
+ * TYPE *var = new(linear_parent) TYPE(...);
+ *
+ * The destructor of TYPE is never called, and delete is a no-op: the memory
+ * is released with the linear parent.
+ */
+#define DECLARE_LINEAR_ALLOC_CXX_OPERATORS_TEMPLATE(TYPE, ALLOC_FUNC)    \
+public:                                                                  \
+   static void* operator new(size_t size, void *mem_ctx)                 \
+   {                                                                     \
+      void *p = ALLOC_FUNC(mem_ctx, size);                               \
+      assert(p != NULL);                                                 \
+      return p;                                                          \
+   }                                                                     \
+                                                                         \
+   static void operator delete(void *p)                                  \
+   {                                                                     \
+      /* The memory is freed with the linear parent. */                  \
+   }
+
+#define DECLARE_LINEAR_ALLOC_CXX_OPERATORS(TYPE) \
+   DECLARE_LINEAR_ALLOC_CXX_OPERATORS_TEMPLATE(TYPE, linear_alloc_child)
+
+#define DECLARE_LINEAR_ZALLOC_CXX_OPERATORS(TYPE) \
+   DECLARE_LINEAR_ALLOC_CXX_OPERATORS_TEMPLATE(TYPE, linear_zalloc_child)
+
 
 #endif
@@ -68,19 +68,50 @@
  * up front and stored in a 2-dimensional array, so that the cost of
  * coloring a node is constant with the number of registers.  We do
  * this during ra_set_finalize().
+ *
+ * Shaders with very many virtual registers make for large interference
+ * graphs, so two things are kept out of the O(n^2) range: simplification
+ * keeps worklists of trivially colorable nodes and a min-heap of the
+ * remaining ones keyed by q total instead of rescanning every node, and
+ * graphs with more than RA_DENSE_MAX_NODES nodes check for duplicate edges
+ * in their adjacency lists, or a hash set for nodes with many neighbors,
+ * rather than in a bitset per node.
  */
 
 #include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
 
 #include "ralloc.h"
 #include "main/imports.h"
 #include "main/macros.h"
 #include "main/mtypes.h"
 #include "util/bitset.h"
+#include "util/u_atomic.h"
 #include "register_allocate.h"
 
 #define NO_REG ~0U
 
+/**
+ * Graphs with more nodes than this don't get an adjacency bitset per node,
+ * which would take count^2 / 8 bytes in total.
+ */
+#define RA_DENSE_MAX_NODES 4096
+
+/**
+ * In graphs without adjacency bitsets, adjacency lists up to this long are
+ * searched for duplicate edges, and only the edges between two nodes with
+ * longer lists are kept in the edge set.
+ */
+#define RA_MAX_SCANNED_ADJACENCY 128
+
+#define RA_NO_EDGE ~0ULL
+#define NOT_IN_HEAP ~0U
+
 struct ra_reg {
    BITSET_WORD *conflicts;
    unsigned int *conflict_list;
@@ -96,6 +127,9 @@ struct ra_regs {
    unsigned int class_count;
 
    bool round_robin;
+
+   /** MESA_RA_RECORD_DIR, read once when the register set is created */
+   const char *record_dir;
 };
 
 struct ra_class {
@@ -126,6 +160,8 @@ struct ra_node {
     *
     * List of which nodes this node interferes with.  This should be
     * symmetric with the other node.
+    *
+    * The adjacency bitset is NULL in graphs using the edge set.
     */
    BITSET_WORD *adjacency;
    unsigned int *adjacency_list;
@@ -152,6 +188,12 @@ struct ra_node {
     */
    unsigned int q_total;
 
+   /**
+    * Position in the heap of not trivially colorable nodes during
+    * ra_simplify(), or NOT_IN_HEAP.
+    */
+   unsigned int heap_index;
+
    /* For an implementation that needs register spilling, this is the
     * approximate cost of spilling this node.
     */
@@ -174,6 +216,37 @@ struct ra_graph {
     * stack.
     */
    unsigned int stack_optimistic_start;
+
+   /**
+    * Open-addressed hash set of edges, as (low node << 32 | high node), for
+    * graphs too large for adjacency bitsets.  NULL otherwise.  Only edges
+    * between nodes with more than RA_MAX_SCANNED_ADJACENCY neighbors are
+    * stored.
+    */
+   uint64_t *edge_set;
+   unsigned int edge_set_size; /**< power of two */
+   unsigned int edge_count;
+
+   /** @{
+    * ra_simplify() state.
+    *
+    * Simplification used to walk all the nodes from the highest number
+    * down, over and over, and the order nodes end up on the stack in
+    * matters to ra_select().  To keep it, trivially colorable nodes below
+    * the one last pushed go in the worklist, a max-heap by node number, and
+    * the others wait in next_worklist for the following walk.  The nodes
+    * that aren't trivially colorable are in the heap, which is only ordered
+    * by q total once heap_ordered is set, when it is first needed.
+    */
+   unsigned int *worklist;
+   unsigned int worklist_count;
+   unsigned int *next_worklist;
+   unsigned int next_worklist_count;
+   unsigned int scan_node;
+   unsigned int *heap;
+   unsigned int heap_count;
+   bool heap_ordered;
+   /** @} */
 };
 
 /**
@@ -191,6 +264,7 @@ ra_alloc_reg_set(void *mem_ctx, unsigned int count, bool need_conflict_lists)
    regs = rzalloc(mem_ctx, struct ra_regs);
    regs->count = count;
    regs->regs = rzalloc_array(regs, struct ra_reg, count);
+   regs->record_dir = getenv("MESA_RA_RECORD_DIR");
 
    for (i = 0; i < count; i++) {
       regs->regs[i].conflicts = rzalloc_array(regs->regs, BITSET_WORD,
@@ -390,7 +464,8 @@ ra_set_finalize(struct ra_regs *regs, unsigned int **q_values)
 static void
 ra_add_node_adjacency(struct ra_graph *g, unsigned int n1, unsigned int n2)
 {
-   BITSET_SET(g->nodes[n1].adjacency, n2);
+   if (g->nodes[n1].adjacency)
+      BITSET_SET(g->nodes[n1].adjacency, n2);
 
    if (n1 != n2) {
       int n1_class = g->nodes[n1].class;
@@ -423,9 +498,17 @@ ra_alloc_interference_graph(struct ra_regs *regs, unsigned int count)
 
    g->stack = rzalloc_array(g, unsigned int, count);
 
+   if (count > RA_DENSE_MAX_NODES) {
+      g->edge_set_size = 1024;
+      g->edge_set = ralloc_array(g, uint64_t, g->edge_set_size);
+      memset(g->edge_set, 0xff, g->edge_set_size * sizeof(uint64_t));
+   }
+
    for (i = 0; i < count; i++) {
-      int bitset_count = BITSET_WORDS(count);
-      g->nodes[i].adjacency = rzalloc_array(g, BITSET_WORD, bitset_count);
+      if (!g->edge_set) {
+         int bitset_count = BITSET_WORDS(count);
+         g->nodes[i].adjacency = rzalloc_array(g, BITSET_WORD, bitset_count);
+      }
 
       g->nodes[i].adjacency_list_size = 4;
       g->nodes[i].adjacency_list =
@@ -447,13 +530,148 @@ ra_set_node_class(struct ra_graph *g,
    g->nodes[n].class = class;
 }
 
+static unsigned int
+ra_edge_hash(uint64_t key, unsigned int mask)
+{
+   return (unsigned int) ((key * 0x9e3779b97f4a7c15ULL) >> 32) & mask;
+}
+
+static void
+ra_edge_set_insert(uint64_t *set, unsigned int size, uint64_t key)
+{
+   unsigned int mask = size - 1;
+   unsigned int i;
+
+   for (i = ra_edge_hash(key, mask); set[i] != RA_NO_EDGE; i = (i + 1) & mask)
+      ;
+   set[i] = key;
+}
+
+static void
+ra_edge_set_grow(struct ra_graph *g)
+{
+   unsigned int size = g->edge_set_size * 2;
+   uint64_t *set = ralloc_array(g, uint64_t, size);
+   unsigned int i;
+
+   memset(set, 0xff, size * sizeof(uint64_t));
+   for (i = 0; i < g->edge_set_size; i++) {
+      if (g->edge_set[i] != RA_NO_EDGE)
+         ra_edge_set_insert(set, size, g->edge_set[i]);
+   }
+
+   ralloc_free(g->edge_set);
+   g->edge_set = set;
+   g->edge_set_size = size;
+}
+
+/**
+ * Returns the slot of the edge between n1 and n2 in the edge set, or the
+ * empty slot it would go in.
+ */
+static unsigned int
+ra_edge_set_find(struct ra_graph *g, unsigned int n1, unsigned int n2)
+{
+   uint64_t key = n1 < n2 ? ((uint64_t) n1 << 32) | n2 :
+                            ((uint64_t) n2 << 32) | n1;
+   unsigned int mask = g->edge_set_size - 1;
+   unsigned int i;
+
+   for (i = ra_edge_hash(key, mask); ; i = (i + 1) & mask) {
+      if (g->edge_set[i] == key || g->edge_set[i] == RA_NO_EDGE)
+         return i;
+   }
+}
+
+static void
+ra_edge_set_add(struct ra_graph *g, unsigned int n1, unsigned int n2)
+{
+   unsigned int i;
+
+   /* Keep the load factor under one half. */
+   if ((g->edge_count + 1) * 2 > g->edge_set_size)
+      ra_edge_set_grow(g);
+
+   i = ra_edge_set_find(g, n1, n2);
+   if (g->edge_set[i] == RA_NO_EDGE) {
+      g->edge_set[i] = n1 < n2 ? ((uint64_t) n1 << 32) | n2 :
+                                 ((uint64_t) n2 << 32) | n1;
+      g->edge_count++;
+   }
+}
+
+static bool
+ra_nodes_interfere(struct ra_graph *g, unsigned int n1, unsigned int n2)
+{
+   unsigned int n, other, i;
+
+   if (!g->edge_set)
+      return BITSET_TEST(g->nodes[n1].adjacency, n2);
+
+   if (n1 == n2)
+      return true;
+
+   /* Only edges between two nodes with long adjacency lists are in the
+    * set.  Scanning a short list is cheaper than a cache miss in the set.
+    */
+   if (g->nodes[n1].adjacency_count <= g->nodes[n2].adjacency_count) {
+      n = n1;
+      other = n2;
+   } else {
+      n = n2;
+      other = n1;
+   }
+
+   if (g->nodes[n].adjacency_count > RA_MAX_SCANNED_ADJACENCY) {
+      i = ra_edge_set_find(g, n1, n2);
+      return g->edge_set[i] != RA_NO_EDGE;
+   }
+
+   for (i = 0; i < g->nodes[n].adjacency_count; i++) {
+      if (g->nodes[n].adjacency_list[i] == other)
+         return true;
+   }
+
+   return false;
+}
+
+/**
+ * Called after an edge was added to n: once n's adjacency list is too long
+ * to scan, adds its edges to other such nodes to the edge set.
+ */
+static void
+ra_update_edge_set(struct ra_graph *g, unsigned int n)
+{
+   unsigned int i;
+
+   if (g->nodes[n].adjacency_count != RA_MAX_SCANNED_ADJACENCY + 1)
+      return;
+
+   for (i = 0; i < g->nodes[n].adjacency_count; i++) {
+      unsigned int n2 = g->nodes[n].adjacency_list[i];
+
+      if (n2 != n &&
+          g->nodes[n2].adjacency_count > RA_MAX_SCANNED_ADJACENCY)
+         ra_edge_set_add(g, n, n2);
+   }
+}
+
 void
 ra_add_node_interference(struct ra_graph *g,
                          unsigned int n1, unsigned int n2)
 {
-   if (!BITSET_TEST(g->nodes[n1].adjacency, n2)) {
+   if (!ra_nodes_interfere(g, n1, n2)) {
       ra_add_node_adjacency(g, n1, n2);
       ra_add_node_adjacency(g, n2, n1);
+
+      if (g->edge_set) {
+         ra_update_edge_set(g, n1);
+         ra_update_edge_set(g, n2);
+
+         if (g->nodes[n1].adjacency_count > RA_MAX_SCANNED_ADJACENCY &&
+             g->nodes[n2].adjacency_count > RA_MAX_SCANNED_ADJACENCY)
+            ra_edge_set_add(g, n1, n2);
+      }
    }
 }
 
@@ -465,6 +683,135 @@ pq_test(struct ra_graph *g, unsigned int n)
    return g->nodes[n].q_total < g->regs->classes[n_class]->p;
 }
 
+/**
+ * Heap order for optimistic coloring: lowest q total first, and the higher
+ * numbered node on ties, which is the one the allocator has always picked.
+ */
+static bool
+ra_heap_before(struct ra_graph *g, unsigned int n1, unsigned int n2)
+{
+   if (g->nodes[n1].q_total != g->nodes[n2].q_total)
+      return g->nodes[n1].q_total < g->nodes[n2].q_total;
+
+   return n1 > n2;
+}
+
+static void
+ra_heap_set(struct ra_graph *g, unsigned int i, unsigned int n)
+{
+   g->heap[i] = n;
+   g->nodes[n].heap_index = i;
+}
+
+static void
+ra_heap_sift_up(struct ra_graph *g, unsigned int i)
+{
+   unsigned int n = g->heap[i];
+
+   while (i > 0) {
+      unsigned int parent = (i - 1) / 2;
+
+      if (!ra_heap_before(g, n, g->heap[parent]))
+         break;
+
+      ra_heap_set(g, i, g->heap[parent]);
+      i = parent;
+   }
+   ra_heap_set(g, i, n);
+}
+
+static void
+ra_heap_sift_down(struct ra_graph *g, unsigned int i)
+{
+   unsigned int n = g->heap[i];
+
+   for (;;) {
+      unsigned int child = 2 * i + 1;
+
+      if (child >= g->heap_count)
+         break;
+
+      if (child + 1 < g->heap_count &&
+          ra_heap_before(g, g->heap[child + 1], g->heap[child]))
+         child++;
+
+      if (!ra_heap_before(g, g->heap[child], n))
+         break;
+
+      ra_heap_set(g, i, g->heap[child]);
+      i = child;
+   }
+   ra_heap_set(g, i, n);
+}
+
+static void
+ra_heap_remove(struct ra_graph *g, unsigned int n)
+{
+   unsigned int i = g->nodes[n].heap_index;
+   unsigned int last = g->heap[--g->heap_count];
+
+   g->nodes[n].heap_index = NOT_IN_HEAP;
+
+   if (last != n) {
+      ra_heap_set(g, i, last);
+      if (g->heap_ordered) {
+         ra_heap_sift_up(g, i);
+         ra_heap_sift_down(g, g->nodes[last].heap_index);
+      }
+   }
+}
+
+static void
+ra_worklist_sift_up(unsigned int *worklist, unsigned int i)
+{
+   unsigned int n = worklist[i];
+
+   while (i > 0 && worklist[(i - 1) / 2] < n) {
+      worklist[i] = worklist[(i - 1) / 2];
+      i = (i - 1) / 2;
+   }
+   worklist[i] = n;
+}
+
+static void
+ra_worklist_sift_down(unsigned int *worklist, unsigned int count,
+                      unsigned int i)
+{
+   unsigned int n = worklist[i];
+
+   for (;;) {
+      unsigned int child = 2 * i + 1;
+
+      if (child >= count)
+         break;
+
+      if (child + 1 < count && worklist[child + 1] > worklist[child])
+         child++;
+
+      if (worklist[child] < n)
+         break;
+
+      worklist[i] = worklist[child];
+      i = child;
+   }
+   worklist[i] = n;
+}
+
+static void
+ra_add_to_worklist(struct ra_graph *g, unsigned int n)
+{
+   if (n < g->scan_node) {
+      g->worklist[g->worklist_count] = n;
+      ra_worklist_sift_up(g->worklist, g->worklist_count++);
+   } else {
+      g->next_worklist[g->next_worklist_count++] = n;
+   }
+}
+
+/**
+ * Removes n's edges from the q totals of its neighbors still in the graph,
+ * moving those that become trivially colorable to a worklist.
+ */
 static void
 decrement_q(struct ra_graph *g, unsigned int n)
 {
@@ -478,10 +825,28 @@ decrement_q(struct ra_graph *g, unsigned int n)
       if (n != n2 && !g->nodes[n2].in_stack) {
          assert(g->nodes[n2].q_total >= g->regs->classes[n2_class]->q[n_class]);
          g->nodes[n2].q_total -= g->regs->classes[n2_class]->q[n_class];
+
+         if (g->nodes[n2].heap_index != NOT_IN_HEAP) {
+            if (pq_test(g, n2)) {
+               ra_heap_remove(g, n2);
+               ra_add_to_worklist(g, n2);
+            } else if (g->heap_ordered) {
+               ra_heap_sift_up(g, g->nodes[n2].heap_index);
+            }
+         }
       }
    }
 }
 
+static void
+ra_push_node(struct ra_graph *g, unsigned int n)
+{
+   decrement_q(g, n);
+   g->stack[g->stack_count] = n;
+   g->stack_count++;
+   g->nodes[n].in_stack = true;
+}
+
 /**
  * Simplifies the interference graph by pushing all
  * trivially-colorable nodes into a stack of nodes to be colored,
@@ -491,51 +856,93 @@ decrement_q(struct ra_graph *g, unsigned int n)
  * we optimistically choose a node and push it on the stack. We heuristically
  * push the node with the lowest total q value, since it has the fewest
  * neighbors and therefore is most likely to be allocated.
+ *
+ * Each node enters a worklist or the heap once, and only moves from the
+ * heap to a worklist, so this is O((nodes + edges) * log(nodes)).
  */
 static void
 ra_simplify(struct ra_graph *g)
 {
-   bool progress = true;
    unsigned int stack_optimistic_start = UINT_MAX;
-   int i;
+   unsigned int i;
 
-   while (progress) {
-      unsigned int best_optimistic_node = ~0;
-      unsigned int lowest_q_total = ~0;
+   g->worklist = ralloc_array(g, unsigned int, g->count);
+   g->worklist_count = 0;
+   g->next_worklist = ralloc_array(g, unsigned int, g->count);
+   g->next_worklist_count = 0;
+   g->scan_node = UINT_MAX;
+   g->heap = ralloc_array(g, unsigned int, g->count);
+   g->heap_count = 0;
+   g->heap_ordered = false;
 
-      progress = false;
+   for (i = 0; i < g->count; i++) {
+      g->nodes[i].heap_index = NOT_IN_HEAP;
 
-      for (i = g->count - 1; i >= 0; i--) {
-	 if (g->nodes[i].in_stack || g->nodes[i].reg != NO_REG)
-	    continue;
+      if (g->nodes[i].in_stack || g->nodes[i].reg != NO_REG)
+         continue;
 
-	 if (pq_test(g, i)) {
-	    decrement_q(g, i);
-	    g->stack[g->stack_count] = i;
-	    g->stack_count++;
-	    g->nodes[i].in_stack = true;
-	    progress = true;
-	 } else {
-	    unsigned int new_q_total = g->nodes[i].q_total;
-	    if (new_q_total < lowest_q_total) {
-	       best_optimistic_node = i;
-	       lowest_q_total = new_q_total;
-	    }
-	 }
+      if (pq_test(g, i)) {
+         g->worklist[g->worklist_count++] = i;
+      } else {
+         g->heap[g->heap_count] = i;
+         g->nodes[i].heap_index = g->heap_count++;
       }
+   }
+
+   for (i = g->worklist_count / 2; i-- > 0; )
+      ra_worklist_sift_down(g->worklist, g->worklist_count, i);
+
+   for (;;) {
+      while (g->worklist_count > 0 || g->next_worklist_count > 0) {
+         unsigned int *tmp;
 
-      if (!progress && best_optimistic_node != ~0U) {
-         if (stack_optimistic_start == UINT_MAX)
-            stack_optimistic_start = g->stack_count;
+         if (g->worklist_count == 0) {
+            /* Start the next walk over the nodes. */
+            tmp = g->worklist;
+            g->worklist = g->next_worklist;
+            g->worklist_count = g->next_worklist_count;
+            g->next_worklist = tmp;
+            g->next_worklist_count = 0;
 
-	 decrement_q(g, best_optimistic_node);
-	 g->stack[g->stack_count] = best_optimistic_node;
-	 g->stack_count++;
-	 g->nodes[best_optimistic_node].in_stack = true;
-	 progress = true;
+            for (i = g->worklist_count / 2; i-- > 0; )
+               ra_worklist_sift_down(g->worklist, g->worklist_count, i);
+         }
+
+         g->scan_node = g->worklist[0];
+         g->worklist[0] = g->worklist[--g->worklist_count];
+         if (g->worklist_count > 0)
+            ra_worklist_sift_down(g->worklist, g->worklist_count, 0);
+
+         ra_push_node(g, g->scan_node);
       }
+
+      if (g->heap_count == 0)
+         break;
+
+      if (stack_optimistic_start == UINT_MAX) {
+         stack_optimistic_start = g->stack_count;
+
+         /* Most graphs are colored without ever getting here, so the heap
+          * isn't kept in order until now.
+          */
+         for (i = g->heap_count / 2; i-- > 0; )
+            ra_heap_sift_down(g, i);
+         g->heap_ordered = true;
+      }
+
+      g->scan_node = UINT_MAX;
+      i = g->heap[0];
+      ra_heap_remove(g, i);
+      ra_push_node(g, i);
    }
 
+   ralloc_free(g->worklist);
+   ralloc_free(g->next_worklist);
+   ralloc_free(g->heap);
+   g->worklist = NULL;
+   g->next_worklist = NULL;
+   g->heap = NULL;
+
    g->stack_optimistic_start = stack_optimistic_start;
 }
 
@@ -607,9 +1014,96 @@ ra_select(struct ra_graph *g)
    return true;
 }
 
+#ifndef _WIN32
+/**
+ * Writes the register set and the graph, as it is before allocation, to a
+ * new file in the directory named by MESA_RA_RECORD_DIR, so that it can be
+ * replayed by register_allocate_test.
+ *
+ * The format is line based: "regs <count> <classes> <round robin>", then per
+ * class "class <p> <regs...>" and "q <q values...>", then "conflict <reg>
+ * <regs...>" for each register conflicting with others, then "nodes
+ * <count>" followed by "<class> <reg or -1> <spill cost>" per node, and
+ * "edges <count>" followed by "<n1> <n2>" per edge.
+ */
+static void
+ra_record_graph(struct ra_graph *g)
+{
+   static uint32_t graph_count;
+   struct ra_regs *regs = g->regs;
+   char path[4096];
+   unsigned int edges = 0;
+   unsigned int i, j;
+   FILE *f;
+
+   snprintf(path, sizeof(path), "%s/ra-%d-%u.txt", regs->record_dir,
+            (int) getpid(), p_atomic_inc_return(&graph_count));
+   f = fopen(path, "w");
+   if (!f)
+      return;
+
+   fprintf(f, "regs %u %u %u\n", regs->count, regs->class_count,
+           regs->round_robin);
+
+   for (i = 0; i < regs->class_count; i++) {
+      struct ra_class *class = regs->classes[i];
+
+      fprintf(f, "class %u", class->p);
+      for (j = 0; j < regs->count; j++) {
+         if (reg_belongs_to_class(j, class))
+            fprintf(f, " %u", j);
+      }
+      fprintf(f, "\nq");
+      for (j = 0; j < regs->class_count; j++)
+         fprintf(f, " %u", class->q[j]);
+      fprintf(f, "\n");
+   }
+
+   for (i = 0; i < regs->count; i++) {
+      bool any = false;
+
+      for (j = 0; j < regs->count; j++) {
+         if (j == i || !BITSET_TEST(regs->regs[i].conflicts, j))
+            continue;
+
+         if (!any)
+            fprintf(f, "conflict %u", i);
+         fprintf(f, " %u", j);
+         any = true;
+      }
+      if (any)
+         fprintf(f, "\n");
+   }
+
+   fprintf(f, "nodes %u\n", g->count);
+   for (i = 0; i < g->count; i++) {
+      fprintf(f, "%u %d %.9g\n", g->nodes[i].class, (int) g->nodes[i].reg,
+              g->nodes[i].spill_cost);
+      for (j = 0; j < g->nodes[i].adjacency_count; j++) {
+         if (g->nodes[i].adjacency_list[j] > i)
+            edges++;
+      }
+   }
+
+   fprintf(f, "edges %u\n", edges);
+   for (i = 0; i < g->count; i++) {
+      for (j = 0; j < g->nodes[i].adjacency_count; j++) {
+         if (g->nodes[i].adjacency_list[j] > i)
+            fprintf(f, "%u %u\n", i, g->nodes[i].adjacency_list[j]);
+      }
+   }
+
+   fclose(f);
+}
+#endif
+
 bool
 ra_allocate(struct ra_graph *g)
 {
+#ifndef _WIN32
+   if (g->regs->record_dir)
+      ra_record_graph(g);
+#endif
    ra_simplify(g);
    return ra_select(g);
 }
@@ -0,0 +1,561 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Tests and benchmarks the graph-coloring register allocator.
+ *
+ * Without arguments, checks the exact allocations of a few small graphs,
+ * then allocates synthetic graphs on both sides of the size where the
+ * allocator switches to its sparse edge set, and checks that no two
+ * interfering nodes got conflicting registers.
+ *
+ * With arguments, replays graphs recorded with MESA_RA_RECORD_DIR, checking
+ * each allocation the same way and printing the time taken:
+ *
+ *    register_allocate_test [-n iterations] graph...
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "macros.h"
+#include "ralloc.h"
+#include "register_allocate.h"
+
+struct graph_desc {
+   unsigned reg_count;
+   unsigned class_count;
+   unsigned round_robin;
+   unsigned **class_regs;
+   unsigned *class_size;
+   unsigned **q;
+   unsigned char *conflicts; /* reg_count * reg_count */
+
+   unsigned node_count;
+   unsigned *node_class;
+   int *node_reg;
+   float *node_spill_cost;
+
+   unsigned edge_count;
+   unsigned *edges; /* pairs of nodes */
+};
+
+static int error = 0;
+
+static double
+get_time(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+add_conflict(struct graph_desc *d, unsigned r1, unsigned r2)
+{
+   d->conflicts[r1 * d->reg_count + r2] = 1;
+   d->conflicts[r2 * d->reg_count + r1] = 1;
+}
+
+/**
+ * Allocates the graph described by d, returning whether it colored.
+ *
+ * On success, every pair of interfering nodes is checked for conflicting
+ * registers, and the registers are returned in node_regs if it isn't NULL.
+ * Otherwise the node picked for spilling is returned in spill_node if it
+ * isn't NULL.
+ */
+static bool
+allocate(const struct graph_desc *d, double *time,
+         unsigned *node_regs, int *spill_node)
+{
+   struct ra_regs *regs;
+   struct ra_graph *g;
+   unsigned i, j;
+   double start;
+   bool ok;
+
+   start = get_time();
+
+   regs = ra_alloc_reg_set(NULL, d->reg_count, false);
+   if (d->round_robin)
+      ra_set_allocate_round_robin(regs);
+
+   for (i = 0; i < d->reg_count; i++) {
+      for (j = i + 1; j < d->reg_count; j++) {
+         if (d->conflicts[i * d->reg_count + j])
+            ra_add_reg_conflict(regs, i, j);
+      }
+   }
+
+   for (i = 0; i < d->class_count; i++) {
+      unsigned c = ra_alloc_reg_class(regs);
+
+      for (j = 0; j < d->class_size[i]; j++)
+         ra_class_add_reg(regs, c, d->class_regs[i][j]);
+   }
+   ra_set_finalize(regs, d->q);
+
+   g = ra_alloc_interference_graph(regs, d->node_count);
+   for (i = 0; i < d->node_count; i++) {
+      ra_set_node_class(g, i, d->node_class[i]);
+      if (d->node_reg[i] >= 0)
+         ra_set_node_reg(g, i, d->node_reg[i]);
+      if (d->node_spill_cost[i] != 0.0f)
+         ra_set_node_spill_cost(g, i, d->node_spill_cost[i]);
+   }
+
+   for (i = 0; i < d->edge_count; i++)
+      ra_add_node_interference(g, d->edges[2 * i], d->edges[2 * i + 1]);
+
+   ok = ra_allocate(g);
+   if (!ok) {
+      int spill = ra_get_best_spill_node(g);
+
+      if (spill_node)
+         *spill_node = spill;
+   }
+
+   *time = get_time() - start;
+
+   if (ok) {
+      for (i = 0; i < d->edge_count; i++) {
+         unsigned r1 = ra_get_node_reg(g, d->edges[2 * i]);
+         unsigned r2 = ra_get_node_reg(g, d->edges[2 * i + 1]);
+
+         if (d->edges[2 * i] == d->edges[2 * i + 1])
+            continue;
+
+         if (r1 == r2 || d->conflicts[r1 * d->reg_count + r2]) {
+            fprintf(stderr, "Error: nodes %u and %u got conflicting "
+                    "registers %u and %u\n",
+                    d->edges[2 * i], d->edges[2 * i + 1], r1, r2);
+            error = 1;
+            break;
+         }
+      }
+
+      if (node_regs) {
+         for (i = 0; i < d->node_count; i++)
+            node_regs[i] = ra_get_node_reg(g, i);
+      }
+   }
+
+   ralloc_free(g);
+   ralloc_free(regs);
+
+   return ok;
+}
+
+/**
+ * Describes a register file like that of many GPUs: 64 registers, and 63
+ * aligned pairs each conflicting with its two registers.
+ */
+static void
+make_reg_file(struct graph_desc *d)
+{
+   unsigned i;
+
+   d->reg_count = 64 + 63;
+   d->class_count = 2;
+   d->round_robin = 0;
+   d->conflicts = rzalloc_array(d, unsigned char,
+                                d->reg_count * d->reg_count);
+   d->class_regs = ralloc_array(d, unsigned *, 2);
+   d->class_size = ralloc_array(d, unsigned, 2);
+   d->class_regs[0] = ralloc_array(d, unsigned, 64);
+   d->class_regs[1] = ralloc_array(d, unsigned, 63);
+   d->class_size[0] = 64;
+   d->class_size[1] = 63;
+
+   for (i = 0; i < 64; i++)
+      d->class_regs[0][i] = i;
+
+   for (i = 0; i < 63; i++) {
+      d->class_regs[1][i] = 64 + i;
+      add_conflict(d, 64 + i, i);
+      add_conflict(d, 64 + i, i + 1);
+      if (i > 0)
+         add_conflict(d, 64 + i, 64 + i - 1);
+   }
+
+   /* q(B, C): how many registers of B the worst register of C blocks. */
+   d->q = ralloc_array(d, unsigned *, 2);
+   d->q[0] = ralloc_array(d, unsigned, 2);
+   d->q[1] = ralloc_array(d, unsigned, 2);
+   d->q[0][0] = 1;
+   d->q[0][1] = 2;
+   d->q[1][0] = 2;
+   d->q[1][1] = 3;
+}
+
+/**
+ * Makes a graph of count live ranges, where range i starts at i and lasts
+ * up to max_length.  Every edge is added twice, once in each direction, to
+ * exercise duplicate detection.
+ */
+static struct graph_desc *
+make_synthetic_graph(unsigned count, unsigned max_length, unsigned seed)
+{
+   struct graph_desc *d = rzalloc(NULL, struct graph_desc);
+   unsigned *end;
+   unsigned edges_size = 16;
+   unsigned i, j;
+
+   srand(seed);
+   make_reg_file(d);
+
+   d->node_count = count;
+   d->node_class = ralloc_array(d, unsigned, count);
+   d->node_reg = ralloc_array(d, int, count);
+   d->node_spill_cost = ralloc_array(d, float, count);
+   d->edges = ralloc_array(d, unsigned, edges_size * 2);
+   end = ralloc_array(d, unsigned, count);
+
+   for (i = 0; i < count; i++) {
+      d->node_class[i] = rand() % 4 == 0;
+      d->node_reg[i] = -1;
+      d->node_spill_cost[i] = 1.0f + rand() % 10;
+      end[i] = i + 1 + rand() % max_length;
+   }
+
+   /* Pin the first node, like shader inputs often are. */
+   d->node_class[0] = 0;
+   d->node_reg[0] = 0;
+
+   for (i = 0; i < count; i++) {
+      for (j = i + 1; j < count && j < end[i]; j++) {
+         if (d->edge_count + 2 > edges_size) {
+            edges_size *= 2;
+            d->edges = reralloc(d, d->edges, unsigned, edges_size * 2);
+         }
+         d->edges[2 * d->edge_count] = i;
+         d->edges[2 * d->edge_count + 1] = j;
+         d->edge_count++;
+         d->edges[2 * d->edge_count] = j;
+         d->edges[2 * d->edge_count + 1] = i;
+         d->edge_count++;
+      }
+   }
+
+   return d;
+}
+
+/**
+ * Makes a graph with a single class of reg_count registers which don't
+ * conflict with each other, and the given edges between node_count nodes.
+ */
+static struct graph_desc *
+make_small_graph(unsigned reg_count, unsigned node_count,
+                 const unsigned *edges, unsigned edge_count)
+{
+   struct graph_desc *d = rzalloc(NULL, struct graph_desc);
+   unsigned i;
+
+   d->reg_count = reg_count;
+   d->class_count = 1;
+   d->conflicts = rzalloc_array(d, unsigned char, reg_count * reg_count);
+   d->class_regs = ralloc_array(d, unsigned *, 1);
+   d->class_size = ralloc_array(d, unsigned, 1);
+   d->class_regs[0] = ralloc_array(d, unsigned, reg_count);
+   d->class_size[0] = reg_count;
+   for (i = 0; i < reg_count; i++)
+      d->class_regs[0][i] = i;
+
+   d->q = ralloc_array(d, unsigned *, 1);
+   d->q[0] = ralloc_array(d, unsigned, 1);
+   d->q[0][0] = 1;
+
+   d->node_count = node_count;
+   d->node_class = rzalloc_array(d, unsigned, node_count);
+   d->node_reg = ralloc_array(d, int, node_count);
+   d->node_spill_cost = rzalloc_array(d, float, node_count);
+   for (i = 0; i < node_count; i++)
+      d->node_reg[i] = -1;
+
+   d->edge_count = edge_count;
+   d->edges = ralloc_array(d, unsigned, edge_count * 2);
+   memcpy(d->edges, edges, edge_count * 2 * sizeof(*edges));
+
+   return d;
+}
+
+static void
+check_regs(const char *name, const struct graph_desc *d,
+           const unsigned *expected)
+{
+   unsigned regs[16];
+   double time;
+   unsigned i;
+
+   assert(d->node_count <= ARRAY_SIZE(regs));
+
+   if (!allocate(d, &time, regs, NULL)) {
+      fprintf(stderr, "Error: %s: failed to color\n", name);
+      error = 1;
+      return;
+   }
+
+   for (i = 0; i < d->node_count; i++) {
+      if (regs[i] != expected[i]) {
+         fprintf(stderr, "Error: %s: node %u got register %u, expected %u\n",
+                 name, i, regs[i], expected[i]);
+         error = 1;
+      }
+   }
+}
+
+static void
+check_spill(const char *name, const struct graph_desc *d, int expected)
+{
+   double time;
+   int spill = -1;
+
+   if (allocate(d, &time, NULL, &spill)) {
+      fprintf(stderr, "Error: %s: colored, expected to spill\n", name);
+      error = 1;
+   } else if (spill != expected) {
+      fprintf(stderr, "Error: %s: spilled node %d, expected %d\n",
+              name, spill, expected);
+      error = 1;
+   }
+}
+
+/**
+ * Graphs small enough to work out the allocation by hand.  Trivially
+ * colorable nodes are simplified from the highest index down, so they are
+ * colored in index order, each taking the lowest register left.
+ */
+static void
+test_small_graphs(void)
+{
+   /* A triangle 0-1-2, and 3 interfering with 0 and 1. */
+   static const unsigned diamond[] = { 0, 1,  0, 2,  1, 2,  0, 3,  1, 3 };
+   /* 0-1-2-3 */
+   static const unsigned chain[] = { 0, 1,  1, 2,  2, 3 };
+   /* Every pair of four nodes interferes. */
+   static const unsigned k4[] = { 0, 1,  0, 2,  0, 3,  1, 2,  1, 3,  2, 3 };
+   struct graph_desc *d;
+
+   d = make_small_graph(3, 4, diamond, ARRAY_SIZE(diamond) / 2);
+   check_regs("diamond", d, (const unsigned []) { 0, 1, 2, 2 });
+
+   /* A node with a register already assigned keeps it. */
+   d->node_reg[2] = 0;
+   check_regs("diamond with node 2 in r0", d,
+              (const unsigned []) { 1, 2, 0, 0 });
+   ralloc_free(d);
+
+   /* Round robin starts each search after the last register picked. */
+   d = make_small_graph(3, 4, chain, ARRAY_SIZE(chain) / 2);
+   check_regs("chain", d, (const unsigned []) { 0, 1, 0, 1 });
+   d->round_robin = 1;
+   check_regs("chain round robin", d, (const unsigned []) { 0, 1, 2, 0 });
+   ralloc_free(d);
+
+   /* Four registers color K4, three don't, and the cheapest node spills. */
+   d = make_small_graph(4, 4, k4, ARRAY_SIZE(k4) / 2);
+   check_regs("k4", d, (const unsigned []) { 0, 1, 2, 3 });
+   ralloc_free(d);
+
+   d = make_small_graph(3, 4, k4, ARRAY_SIZE(k4) / 2);
+   d->node_spill_cost[0] = 4.0f;
+   d->node_spill_cost[1] = 4.0f;
+   d->node_spill_cost[2] = 1.0f;
+   d->node_spill_cost[3] = 4.0f;
+   check_spill("k4 with three registers", d, 2);
+   ralloc_free(d);
+}
+
+static bool
+read_uint(FILE *f, unsigned *value)
+{
+   return fscanf(f, "%u", value) == 1;
+}
+
+static struct graph_desc *
+read_graph(const char *path)
+{
+   struct graph_desc *d;
+   unsigned i, j;
+   char word[32];
+   FILE *f;
+
+   f = fopen(path, "r");
+   if (!f) {
+      fprintf(stderr, "Error: couldn't open %s\n", path);
+      return NULL;
+   }
+
+   d = rzalloc(NULL, struct graph_desc);
+
+   if (fscanf(f, "regs %u %u %u", &d->reg_count, &d->class_count,
+              &d->round_robin) != 3)
+      goto fail;
+
+   d->conflicts = rzalloc_array(d, unsigned char,
+                                d->reg_count * d->reg_count);
+   d->class_regs = ralloc_array(d, unsigned *, d->class_count);
+   d->class_size = ralloc_array(d, unsigned, d->class_count);
+   d->q = ralloc_array(d, unsigned *, d->class_count);
+
+   for (i = 0; i < d->class_count; i++) {
+      if (fscanf(f, " class %u", &d->class_size[i]) != 1)
+         goto fail;
+
+      d->class_regs[i] = ralloc_array(d, unsigned, d->class_size[i]);
+      for (j = 0; j < d->class_size[i]; j++) {
+         if (!read_uint(f, &d->class_regs[i][j]) ||
+             d->class_regs[i][j] >= d->reg_count)
+            goto fail;
+      }
+
+      if (fscanf(f, " %31s", word) != 1 || strcmp(word, "q") != 0)
+         goto fail;
+
+      d->q[i] = ralloc_array(d, unsigned, d->class_count);
+      for (j = 0; j < d->class_count; j++) {
+         if (!read_uint(f, &d->q[i][j]))
+            goto fail;
+      }
+   }
+
+   /* "conflict" lines, up to the "nodes" line. */
+   while (fscanf(f, " %31s", word) == 1 && strcmp(word, "nodes") != 0) {
+      unsigned r1, r2;
+
+      if (strcmp(word, "conflict") != 0 || !read_uint(f, &r1) ||
+          r1 >= d->reg_count)
+         goto fail;
+
+      while (fscanf(f, "%*[ ]%u", &r2) == 1) {
+         if (r2 >= d->reg_count)
+            goto fail;
+         add_conflict(d, r1, r2);
+      }
+   }
+
+   if (!read_uint(f, &d->node_count))
+      goto fail;
+
+   d->node_class = ralloc_array(d, unsigned, d->node_count);
+   d->node_reg = ralloc_array(d, int, d->node_count);
+   d->node_spill_cost = ralloc_array(d, float, d->node_count);
+   for (i = 0; i < d->node_count; i++) {
+      if (fscanf(f, "%u %d %f", &d->node_class[i], &d->node_reg[i],
+                 &d->node_spill_cost[i]) != 3 ||
+          d->node_class[i] >= d->class_count ||
+          d->node_reg[i] >= (int) d->reg_count)
+         goto fail;
+   }
+
+   if (fscanf(f, " edges %u", &d->edge_count) != 1)
+      goto fail;
+
+   d->edges = ralloc_array(d, unsigned, d->edge_count * 2);
+   for (i = 0; i < d->edge_count * 2; i++) {
+      if (!read_uint(f, &d->edges[i]) || d->edges[i] >= d->node_count)
+         goto fail;
+   }
+
+   fclose(f);
+   return d;
+
+fail:
+   fprintf(stderr, "Error: %s is not a recorded register allocation graph\n",
+           path);
+   fclose(f);
+   ralloc_free(d);
+   return NULL;
+}
+
+static void
+test_synthetic(unsigned count, unsigned max_length, bool expect_success)
+{
+   struct graph_desc *d = make_synthetic_graph(count, max_length, count);
+   double time;
+   bool ok;
+
+   ok = allocate(d, &time, NULL, NULL);
+   if (expect_success && !ok) {
+      fprintf(stderr, "Error: failed to color a %u node graph\n", count);
+      error = 1;
+   }
+
+   ralloc_free(d);
+}
+
+int
+main(int argc, char **argv)
+{
+   unsigned iterations = 1;
+   int i;
+
+   if (argc > 2 && strcmp(argv[1], "-n") == 0) {
+      iterations = atoi(argv[2]);
+      argc -= 2;
+      argv += 2;
+   }
+
+   if (argc == 1) {
+      /* Ranges of at most 8 nodes are always trivially colorable with this
+       * register file; longer ones need optimistic coloring and spill.
+       */
+      test_small_graphs();
+
+      test_synthetic(1000, 8, true);
+      test_synthetic(20000, 8, true);
+      test_synthetic(1000, 40, false);
+      test_synthetic(20000, 40, false);
+      return error;
+   }
+
+   for (i = 1; i < argc; i++) {
+      struct graph_desc *d = read_graph(argv[i]);
+      double time, total = 0.0;
+      unsigned j;
+      bool ok = false;
+
+      if (!d) {
+         error = 1;
+         continue;
+      }
+
+      for (j = 0; j < iterations; j++) {
+         ok = allocate(d, &time, NULL, NULL);
+         total += time;
+      }
+
+      printf("%s: %u nodes, %u edges, %s, %.3f ms\n", argv[i],
+             d->node_count, d->edge_count, ok ? "colored" : "spills",
+             total * 1000.0 / (iterations ? iterations : 1));
+
+      ralloc_free(d);
+   }
+
+   return error;
+}
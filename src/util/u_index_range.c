@@ -0,0 +1,459 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "macros.h"
+#include "u_atomic.h"
+#include "u_index_range.h"
+
+#define BLOCK_SIZE UTIL_INDEX_RANGE_BLOCK_SIZE
+
+static inline unsigned
+min_u(unsigned a, unsigned b)
+{
+   return a < b ? a : b;
+}
+
+static inline unsigned
+max_u(unsigned a, unsigned b)
+{
+   return a > b ? a : b;
+}
+
+#define SCAN_INDICES(type)                                      \
+   do {                                                         \
+      const type *ind = (const type *) indices;                 \
+      if (restart) {                                            \
+         for (i = 0; i < count; i++) {                          \
+            if (ind[i] != restart_index) {                      \
+               if (ind[i] > max) max = ind[i];                  \
+               if (ind[i] < min) min = ind[i];                  \
+            }                                                   \
+         }                                                      \
+      } else {                                                  \
+         for (i = 0; i < count; i++) {                          \
+            if (ind[i] > max) max = ind[i];                     \
+            if (ind[i] < min) min = ind[i];                     \
+         }                                                      \
+      }                                                         \
+   } while (0)
+
+void
+util_index_range_scan(const void *indices, unsigned index_size,
+                      unsigned count, bool restart, unsigned restart_index,
+                      unsigned *min_index, unsigned *max_index)
+{
+   unsigned min = ~0u, max = 0;
+   unsigned i;
+
+   switch (index_size) {
+   case 4:
+      SCAN_INDICES(uint32_t);
+      break;
+   case 2:
+      SCAN_INDICES(uint16_t);
+      break;
+   case 1:
+      SCAN_INDICES(uint8_t);
+      break;
+   default:
+      assert(!"bad index size");
+   }
+
+   *min_index = min;
+   *max_index = max;
+}
+
+/**
+ * Give the tree a new generation.  The numbers come from a single counter
+ * shared by all trees, so a tree created at the address of a destroyed one
+ * never matches a query begun on the old one.
+ */
+static void
+new_generation(struct util_index_range_tree *tree)
+{
+   static uint64_t generation;
+
+   tree->generation = p_atomic_inc_return(&generation);
+}
+
+static void
+mark_all_dirty(struct util_index_range_tree *tree)
+{
+   unsigned i;
+
+   new_generation(tree);
+
+   /* Inner nodes and the leaves of real blocks need to be computed. */
+   memset(tree->dirty, 1, tree->num_leaves + tree->num_blocks);
+
+   /* The leaves past the end of the buffer are empty ranges. */
+   for (i = tree->num_leaves + tree->num_blocks; i < 2 * tree->num_leaves;
+        i++) {
+      tree->dirty[i] = 0;
+      tree->nodes[i].min = ~0u;
+      tree->nodes[i].max = 0;
+   }
+}
+
+/**
+ * Creates the tree for a buffer of \p size bytes, or returns NULL if the
+ * buffer doesn't have a whole block.  \p scan is used to compute the bounds
+ * of each block, util_index_range_scan() if it is NULL.
+ */
+struct util_index_range_tree *
+util_index_range_create(unsigned size, util_index_scan_func scan)
+{
+   struct util_index_range_tree *tree;
+
+   if (size < BLOCK_SIZE)
+      return NULL;
+
+   tree = calloc(1, sizeof(*tree));
+   if (!tree)
+      return NULL;
+
+   tree->size = size;
+   tree->num_blocks = size / BLOCK_SIZE;
+   tree->num_leaves = 1;
+   while (tree->num_leaves < tree->num_blocks)
+      tree->num_leaves *= 2;
+
+   tree->nodes = malloc(2 * tree->num_leaves * sizeof(*tree->nodes));
+   tree->dirty = malloc(2 * tree->num_leaves);
+   if (!tree->nodes || !tree->dirty) {
+      util_index_range_destroy(tree);
+      return NULL;
+   }
+
+   tree->scan = scan ? scan : util_index_range_scan;
+   mark_all_dirty(tree);
+   return tree;
+}
+
+void
+util_index_range_destroy(struct util_index_range_tree *tree)
+{
+   if (!tree)
+      return;
+
+   free(tree->nodes);
+   free(tree->dirty);
+   free(tree);
+}
+
+/**
+ * Marks the blocks overlapping [offset, offset + size) as needing to be
+ * read again.  Nothing is read until they are queried.
+ */
+void
+util_index_range_invalidate(struct util_index_range_tree *tree,
+                            unsigned offset, unsigned size)
+{
+   unsigned first, last, i;
+
+   if (size == 0 || offset >= tree->num_blocks * BLOCK_SIZE)
+      return;
+
+   first = offset / BLOCK_SIZE;
+   last = min_u(DIV_ROUND_UP((uint64_t) offset + size, BLOCK_SIZE),
+               tree->num_blocks);
+
+   new_generation(tree);
+
+   for (i = first; i < last; i++) {
+      unsigned node = tree->num_leaves + i;
+
+      tree->dirty[node] = 1;
+
+      /* The ancestors of a dirty node are always dirty, so we can stop at
+       * the first one that already is.
+       */
+      for (node /= 2; node && !tree->dirty[node]; node /= 2)
+         tree->dirty[node] = 1;
+   }
+}
+
+/**
+ * Adds the bounds of the clean blocks of [first, last) below \p node, which
+ * covers blocks [node_first, node_last), to the query, and notes the dirty
+ * ones.  Returns false if memory ran out.
+ */
+static bool
+query_node(struct util_index_range_tree *tree,
+           struct util_index_range_query *q, unsigned node,
+           unsigned node_first, unsigned node_last,
+           unsigned first, unsigned last)
+{
+   struct util_index_range_node *n = &tree->nodes[node];
+   unsigned mid;
+
+   if (last <= node_first || node_last <= first)
+      return true;
+
+   if (first <= node_first && node_last <= last && !tree->dirty[node]) {
+      q->min = min_u(q->min, n->min);
+      q->max = max_u(q->max, n->max);
+      return true;
+   }
+
+   if (node >= tree->num_leaves) {
+      /* A dirty block inside the range, to be read by query_scan(). */
+      if (q->num_stale == q->stale_size) {
+         unsigned size = q->stale_size ? 2 * q->stale_size : 16;
+         unsigned *stale = realloc(q->stale, size * sizeof(*stale));
+
+         if (!stale)
+            return false;
+         q->stale = stale;
+         q->stale_size = size;
+      }
+      q->stale[q->num_stale++] = node_first;
+      return true;
+   }
+
+   mid = (node_first + node_last) / 2;
+   return query_node(tree, q, 2 * node, node_first, mid, first, last) &&
+          query_node(tree, q, 2 * node + 1, mid, node_last, first, last);
+}
+
+/**
+ * Starts a query of the bounds of \p count indices starting at byte
+ * \p offset of the buffer, ignoring \p restart_index if \p restart is set.
+ *
+ * The bounds of the blocks that are up to date are taken from the tree.
+ * If util_index_range_query_needs_data() then returns true, the caller
+ * maps the range and passes it to util_index_range_query_scan().  Either
+ * way, the query is finished with util_index_range_query_end().
+ *
+ * Only this function and util_index_range_query_end() access the tree, so
+ * the indices can be read without holding the owner's lock.
+ *
+ * Returns false if the range can't be handled (e.g. the offset isn't a
+ * multiple of the index size), in which case the caller needs to compute
+ * the bounds itself, and there is nothing to end.
+ */
+bool
+util_index_range_query_begin(struct util_index_range_tree *tree,
+                             unsigned index_size, bool restart,
+                             unsigned restart_index,
+                             unsigned offset, unsigned count,
+                             struct util_index_range_query *q)
+{
+   uint64_t end = (uint64_t) offset + (uint64_t) count * index_size;
+
+   if (count == 0 || offset % index_size != 0 || end > tree->size)
+      return false;
+
+   if (!restart)
+      restart_index = 0;
+
+   /* The bounds depend on the type of the indices and on the restart
+    * index.  Applications rarely mix them for one buffer, so only the last
+    * kind is kept.
+    */
+   if (index_size != tree->index_size || restart != tree->restart ||
+       restart_index != tree->restart_index) {
+      tree->index_size = index_size;
+      tree->restart = restart;
+      tree->restart_index = restart_index;
+      mark_all_dirty(tree);
+   }
+
+   memset(q, 0, sizeof(*q));
+   q->offset = offset;
+   q->size = end - offset;
+   q->first = DIV_ROUND_UP(offset, BLOCK_SIZE);
+   q->last = end / BLOCK_SIZE;
+   q->index_size = index_size;
+   q->restart = restart;
+   q->restart_index = restart_index;
+   q->scan = tree->scan;
+   q->generation = tree->generation;
+   q->min = ~0u;
+   q->max = 0;
+
+   if (q->first < q->last &&
+       !query_node(tree, q, 1, 0, tree->num_leaves, q->first, q->last)) {
+      free(q->stale);
+      return false;
+   }
+
+   return true;
+}
+
+/**
+ * Whether the query needs the indices of its range, because some of the
+ * blocks are dirty or the range doesn't start and end on block boundaries.
+ */
+bool
+util_index_range_query_needs_data(const struct util_index_range_query *q)
+{
+   return q->num_stale ||
+          q->first >= q->last ||
+          q->offset < q->first * BLOCK_SIZE ||
+          q->last * BLOCK_SIZE < q->offset + q->size;
+}
+
+static void
+scan_bytes(struct util_index_range_query *q, const uint8_t *data,
+           unsigned offset, unsigned size, unsigned *min, unsigned *max)
+{
+   q->scan(data + (offset - q->offset), q->index_size,
+           size / q->index_size, q->restart, q->restart_index, min, max);
+}
+
+/**
+ * Reads the indices the query needs from \p data, the mapping of the
+ * queried range.
+ */
+void
+util_index_range_query_scan(struct util_index_range_query *q,
+                            const void *data)
+{
+   unsigned end = q->offset + q->size;
+   unsigned min, max, i;
+
+   if (q->first >= q->last) {
+      /* No whole block; reading the indices is as fast as it gets. */
+      scan_bytes(q, data, q->offset, q->size, &q->min, &q->max);
+      return;
+   }
+
+   if (q->num_stale) {
+      q->stale_bounds = malloc(q->num_stale * sizeof(*q->stale_bounds));
+      if (!q->stale_bounds) {
+         /* The bounds can still be computed, they just won't be kept. */
+         scan_bytes(q, data, q->first * BLOCK_SIZE,
+                    (q->last - q->first) * BLOCK_SIZE, &q->min, &q->max);
+      }
+   }
+
+   if (q->offset < q->first * BLOCK_SIZE) {
+      scan_bytes(q, data, q->offset, q->first * BLOCK_SIZE - q->offset,
+                 &min, &max);
+      q->min = min_u(q->min, min);
+      q->max = max_u(q->max, max);
+   }
+
+   for (i = 0; q->stale_bounds && i < q->num_stale; i++) {
+      struct util_index_range_node *n = &q->stale_bounds[i];
+
+      scan_bytes(q, data, q->stale[i] * BLOCK_SIZE, BLOCK_SIZE, &min, &max);
+      n->min = min;
+      n->max = max;
+      q->min = min_u(q->min, min);
+      q->max = max_u(q->max, max);
+   }
+
+   if (q->last * BLOCK_SIZE < end) {
+      scan_bytes(q, data, q->last * BLOCK_SIZE, end - q->last * BLOCK_SIZE,
+                 &min, &max);
+      q->min = min_u(q->min, min);
+      q->max = max_u(q->max, max);
+   }
+}
+
+/**
+ * Stores the bounds of the blocks read by util_index_range_query_scan()
+ * in the tree, unless it was invalidated since the query began, and frees
+ * the query.  \p tree may be NULL if it was destroyed in the meantime.
+ */
+void
+util_index_range_query_end(struct util_index_range_tree *tree,
+                           struct util_index_range_query *q)
+{
+   unsigned i;
+
+   if (tree && q->stale_bounds && tree->generation == q->generation) {
+      for (i = 0; i < q->num_stale; i++) {
+         unsigned node = tree->num_leaves + q->stale[i];
+
+         tree->nodes[node] = q->stale_bounds[i];
+         tree->dirty[node] = 0;
+
+         /* Update the ancestors whose blocks are now all clean. */
+         for (node /= 2; node && tree->dirty[node]; node /= 2) {
+            const struct util_index_range_node *l = &tree->nodes[2 * node];
+            const struct util_index_range_node *r = &tree->nodes[2 * node + 1];
+
+            if (tree->dirty[2 * node] || tree->dirty[2 * node + 1])
+               break;
+
+            tree->nodes[node].min = min_u(l->min, r->min);
+            tree->nodes[node].max = max_u(l->max, r->max);
+            tree->dirty[node] = 0;
+         }
+      }
+   }
+
+   free(q->stale);
+   free(q->stale_bounds);
+   q->stale = NULL;
+   q->stale_bounds = NULL;
+}
+
+/**
+ * Computes the bounds of \p count indices starting at byte \p offset of the
+ * buffer in one go, reading the indices through \p map if needed, for
+ * owners that don't mind holding their lock meanwhile.
+ *
+ * Returns false if the range can't be handled or mapping failed, in which
+ * case the caller needs to compute the bounds itself.
+ */
+bool
+util_index_range_get_bounds(struct util_index_range_tree *tree,
+                            unsigned index_size, bool restart,
+                            unsigned restart_index,
+                            unsigned offset, unsigned count,
+                            util_index_map_func map, void *map_data,
+                            unsigned *min_index, unsigned *max_index)
+{
+   struct util_index_range_query q;
+   const void *data = NULL;
+   bool ok = true;
+
+   if (!util_index_range_query_begin(tree, index_size, restart,
+                                     restart_index, offset, count, &q))
+      return false;
+
+   if (util_index_range_query_needs_data(&q)) {
+      data = map(map_data, q.offset, q.size);
+      if (data)
+         util_index_range_query_scan(&q, data);
+      else
+         ok = false;
+   }
+
+   util_index_range_query_end(tree, &q);
+
+   if (!ok)
+      return false;
+
+   *min_index = q.min;
+   *max_index = q.max;
+   return true;
+}
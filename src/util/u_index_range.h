@@ -0,0 +1,181 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * A summary of the minimum and maximum index in each block of an index
+ * buffer, arranged as a binary tree, so that the index bounds of any range
+ * of the buffer can be found without reading most of it.
+ *
+ * The tree is built lazily: a block is only read the first time a query
+ * covers it, and again after the owner reports that it was overwritten with
+ * util_index_range_invalidate().  The owner is also responsible for
+ * serializing access.  Queries can be split so that the indices are read
+ * without holding the owner's lock, see util_index_range_query_begin().
+ */
+
+#ifndef U_INDEX_RANGE_H
+#define U_INDEX_RANGE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Bytes of index data summarized by each leaf of the tree. */
+#define UTIL_INDEX_RANGE_BLOCK_SIZE 1024
+
+/**
+ * Computes the bounds of \p count indices of \p index_size bytes, ignoring
+ * \p restart_index if \p restart is set.  If there are no indices left, the
+ * minimum is ~0 and the maximum 0.
+ */
+typedef void (*util_index_scan_func)(const void *indices,
+                                     unsigned index_size, unsigned count,
+                                     bool restart, unsigned restart_index,
+                                     unsigned *min_index,
+                                     unsigned *max_index);
+
+/**
+ * Returns a pointer to \p size bytes of the index buffer starting at
+ * \p offset.  It is called at most once per query, and the caller of the
+ * query is responsible for unmapping the buffer afterwards.
+ */
+typedef const void *(*util_index_map_func)(void *data, unsigned offset,
+                                           unsigned size);
+
+struct util_index_range_node {
+   uint32_t min;
+   uint32_t max;
+};
+
+struct util_index_range_tree {
+   /** Size of the buffer, in bytes. */
+   unsigned size;
+
+   /** Number of whole blocks in the buffer. */
+   unsigned num_blocks;
+
+   /**
+    * Number of leaves of the tree, a power of two.  Node 1 is the root, the
+    * children of node i are 2i and 2i+1, and block i is node num_leaves + i.
+    */
+   unsigned num_leaves;
+
+   struct util_index_range_node *nodes;
+
+   /**
+    * Whether a leaf needs to be read again, or whether an inner node may
+    * have such leaves below it, in which case its bounds are stale.
+    */
+   uint8_t *dirty;
+
+   /* The kind of indices the bounds were computed for. */
+   unsigned index_size;
+   bool restart;
+   unsigned restart_index;
+
+   util_index_scan_func scan;
+
+   /**
+    * Changed whenever blocks are marked dirty, to a value no other tree
+    * has had.
+    */
+   uint64_t generation;
+};
+
+/** A query in progress, see util_index_range_query_begin(). */
+struct util_index_range_query {
+   /* The range being queried, in bytes, and the whole blocks in it. */
+   unsigned offset;
+   unsigned size;
+   unsigned first;
+   unsigned last;
+
+   /* The kind of indices, copied from the tree. */
+   unsigned index_size;
+   bool restart;
+   unsigned restart_index;
+   util_index_scan_func scan;
+
+   /** The dirty blocks of the range, and their bounds once read. */
+   unsigned *stale;
+   unsigned num_stale;
+   unsigned stale_size;
+   struct util_index_range_node *stale_bounds;
+
+   /** tree->generation when the query began. */
+   uint64_t generation;
+
+   /** The bounds found so far. */
+   unsigned min;
+   unsigned max;
+};
+
+void
+util_index_range_scan(const void *indices, unsigned index_size,
+                      unsigned count, bool restart, unsigned restart_index,
+                      unsigned *min_index, unsigned *max_index);
+
+struct util_index_range_tree *
+util_index_range_create(unsigned size, util_index_scan_func scan);
+
+void
+util_index_range_destroy(struct util_index_range_tree *tree);
+
+void
+util_index_range_invalidate(struct util_index_range_tree *tree,
+                            unsigned offset, unsigned size);
+
+bool
+util_index_range_query_begin(struct util_index_range_tree *tree,
+                             unsigned index_size, bool restart,
+                             unsigned restart_index,
+                             unsigned offset, unsigned count,
+                             struct util_index_range_query *q);
+
+bool
+util_index_range_query_needs_data(const struct util_index_range_query *q);
+
+void
+util_index_range_query_scan(struct util_index_range_query *q,
+                            const void *data);
+
+void
+util_index_range_query_end(struct util_index_range_tree *tree,
+                           struct util_index_range_query *q);
+
+bool
+util_index_range_get_bounds(struct util_index_range_tree *tree,
+                            unsigned index_size, bool restart,
+                            unsigned restart_index,
+                            unsigned offset, unsigned count,
+                            util_index_map_func map, void *map_data,
+                            unsigned *min_index, unsigned *max_index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* U_INDEX_RANGE_H */
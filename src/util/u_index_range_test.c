@@ -0,0 +1,199 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/* Compares util_index_range_get_bounds() with a plain scan over random
+ * queries and writes, and checks that split queries don't keep bounds
+ * read before a write or from a destroyed tree.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "u_index_range.h"
+
+#define BUFFER_SIZE (37 * UTIL_INDEX_RANGE_BLOCK_SIZE + 100)
+
+static uint8_t buffer[BUFFER_SIZE];
+static unsigned num_maps;
+
+static const void *
+map_buffer(void *data, unsigned offset, unsigned size)
+{
+   (void) data;
+
+   if (offset + size > BUFFER_SIZE) {
+      fprintf(stderr, "mapped past the end of the buffer\n");
+      exit(1);
+   }
+
+   num_maps++;
+   return buffer + offset;
+}
+
+static void
+write_buffer(struct util_index_range_tree *tree, unsigned offset,
+             unsigned size)
+{
+   unsigned i;
+
+   for (i = offset; i < offset + size; i++)
+      buffer[i] = rand() & 0xff;
+
+   util_index_range_invalidate(tree, offset, size);
+}
+
+int
+main(int argc, char **argv)
+{
+   static const unsigned index_sizes[] = { 1, 2, 4 };
+   struct util_index_range_tree *tree;
+   struct util_index_range_query q, q2;
+   unsigned min, max, ref_min, ref_max;
+   unsigned i, failures = 0;
+
+   srand(42);
+   tree = util_index_range_create(BUFFER_SIZE, NULL);
+   write_buffer(tree, 0, BUFFER_SIZE);
+
+   for (i = 0; i < 20000; i++) {
+      unsigned index_size = index_sizes[(i / 1000) % 3];
+      bool restart = (i / 3000) % 2;
+      unsigned restart_index = index_size == 1 ? 0xff : 0xffff;
+      unsigned offset, count;
+
+      if (rand() % 8 == 0) {
+         offset = rand() % BUFFER_SIZE;
+         write_buffer(tree, offset, rand() % (BUFFER_SIZE - offset));
+      }
+
+      offset = rand() % BUFFER_SIZE / index_size * index_size;
+      count = rand() % ((BUFFER_SIZE - offset) / index_size + 1);
+      if (count == 0)
+         continue;
+
+      util_index_range_scan(buffer + offset, index_size, count, restart,
+                            restart_index, &ref_min, &ref_max);
+
+      num_maps = 0;
+      if (!util_index_range_get_bounds(tree, index_size, restart,
+                                       restart_index, offset, count,
+                                       map_buffer, NULL, &min, &max)) {
+         fprintf(stderr, "query %u failed\n", i);
+         failures++;
+      } else if (min != ref_min || max != ref_max) {
+         fprintf(stderr, "query %u: got [%u, %u], expected [%u, %u]\n",
+                 i, min, max, ref_min, ref_max);
+         failures++;
+      }
+
+      if (num_maps > 1) {
+         fprintf(stderr, "query %u mapped the buffer %u times\n", i, num_maps);
+         failures++;
+      }
+   }
+
+   /* Once built, a block-aligned query doesn't read anything. */
+   util_index_range_get_bounds(tree, 4, false, 0, 0, BUFFER_SIZE / 4,
+                               map_buffer, NULL, &i, &i);
+   num_maps = 0;
+   util_index_range_get_bounds(tree, 4, false, 0,
+                               UTIL_INDEX_RANGE_BLOCK_SIZE,
+                               30 * UTIL_INDEX_RANGE_BLOCK_SIZE / 4,
+                               map_buffer, NULL, &i, &i);
+   if (num_maps != 0) {
+      fprintf(stderr, "aligned query of a clean range mapped the buffer\n");
+      failures++;
+   }
+
+   /* Misaligned offsets are left to the caller. */
+   if (util_index_range_get_bounds(tree, 4, false, 0, 2, 10,
+                                   map_buffer, NULL, &i, &i)) {
+      fprintf(stderr, "misaligned query succeeded\n");
+      failures++;
+   }
+
+   /* A split query keeps the blocks it read... */
+   write_buffer(tree, 0, BUFFER_SIZE);
+   util_index_range_query_begin(tree, 4, false, 0, 0, BUFFER_SIZE / 4, &q);
+   util_index_range_query_scan(&q, buffer);
+   util_index_range_query_end(tree, &q);
+   util_index_range_query_begin(tree, 4, false, 0, 0,
+                                UTIL_INDEX_RANGE_BLOCK_SIZE / 4, &q);
+   if (util_index_range_query_needs_data(&q)) {
+      fprintf(stderr, "split query didn't keep the blocks it read\n");
+      failures++;
+   }
+   util_index_range_query_end(tree, &q);
+
+   /* ...unless the buffer was written between reading and storing them. */
+   write_buffer(tree, 0, UTIL_INDEX_RANGE_BLOCK_SIZE);
+   util_index_range_query_begin(tree, 4, false, 0, 0,
+                                UTIL_INDEX_RANGE_BLOCK_SIZE / 4, &q);
+   util_index_range_query_scan(&q, buffer);
+   write_buffer(tree, 0, UTIL_INDEX_RANGE_BLOCK_SIZE);
+   util_index_range_query_end(tree, &q);
+
+   util_index_range_scan(buffer, 4, UTIL_INDEX_RANGE_BLOCK_SIZE / 4, false, 0,
+                         &ref_min, &ref_max);
+   if (!util_index_range_get_bounds(tree, 4, false, 0, 0,
+                                    UTIL_INDEX_RANGE_BLOCK_SIZE / 4,
+                                    map_buffer, NULL, &min, &max) ||
+       min != ref_min || max != ref_max) {
+      fprintf(stderr, "split query kept bounds of overwritten indices\n");
+      failures++;
+   }
+
+   /* Nor if the tree was replaced by a new one, which may well live at the
+    * same address and have gone through as many changes.
+    */
+   util_index_range_destroy(tree);
+   tree = util_index_range_create(BUFFER_SIZE, NULL);
+   util_index_range_query_begin(tree, 4, false, 0, 0,
+                                UTIL_INDEX_RANGE_BLOCK_SIZE / 4, &q);
+   util_index_range_query_scan(&q, buffer);
+   util_index_range_destroy(tree);
+
+   for (i = 0; i < UTIL_INDEX_RANGE_BLOCK_SIZE; i++)
+      buffer[i] = rand() & 0xff;
+
+   tree = util_index_range_create(BUFFER_SIZE, NULL);
+   util_index_range_query_begin(tree, 4, false, 0, 0,
+                                UTIL_INDEX_RANGE_BLOCK_SIZE / 4, &q2);
+   util_index_range_query_end(tree, &q2);
+   util_index_range_query_end(tree, &q);
+
+   util_index_range_scan(buffer, 4, UTIL_INDEX_RANGE_BLOCK_SIZE / 4, false, 0,
+                         &ref_min, &ref_max);
+   if (!util_index_range_get_bounds(tree, 4, false, 0, 0,
+                                    UTIL_INDEX_RANGE_BLOCK_SIZE / 4,
+                                    map_buffer, NULL, &min, &max) ||
+       min != ref_min || max != ref_max) {
+      fprintf(stderr, "split query kept bounds read from another tree\n");
+      failures++;
+   }
+
+   util_index_range_destroy(tree);
+
+   return failures ? 1 : 0;
+}
@@ -33,14 +33,19 @@
 #ifndef U_QUEUE_H
 #define U_QUEUE_H
 
-#include "os/os_thread.h"
+#include <stdbool.h>
+#include "c11/threads.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 /* Job completion fence.
  * Put this into your job structure.
  */
 struct util_queue_fence {
-   pipe_mutex mutex;
-   pipe_condvar cond;
+   mtx_t mutex;
+   cnd_t cond;
    int signalled;
 };
 
@@ -56,11 +61,13 @@ struct util_queue_job {
 /* Put this into your context. */
 struct util_queue {
    const char *name;
-   pipe_mutex lock;
-   pipe_condvar has_queued_cond;
-   pipe_condvar has_space_cond;
-   pipe_thread *threads;
+   mtx_t lock;
+   cnd_t has_queued_cond;
+   cnd_t has_space_cond;
+   cnd_t idle_cond;
+   thrd_t *threads;
    int num_queued;
+   int num_running; /* jobs taken from the ring but not completed yet */
    unsigned num_threads;
    int kill_threads;
    int max_jobs;
@@ -85,6 +92,9 @@ void util_queue_add_job(struct util_queue *queue,
 
 void util_queue_job_wait(struct util_queue_fence *fence);
 
+/* wait until all jobs added so far have completed */
+void util_queue_finish(struct util_queue *queue);
+
 /* util_queue needs to be cleared to zeroes for this to work */
 static inline bool
 util_queue_is_initialized(struct util_queue *queue)
@@ -98,4 +108,8 @@ util_queue_fence_is_signalled(struct util_queue_fence *fence)
    return fence->signalled != 0;
 }
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif